@@ -0,0 +1,83 @@
+/**
+ * @file  bench_util.h
+ *
+ * @brief Provides timing and reporting utilities shared by the kmyth
+ *        benchmarks run from the 'kmyth-bench' application.
+ */
+
+#ifndef BENCH_UTIL_H
+#define BENCH_UTIL_H
+
+#include <stddef.h>
+
+/**
+ * @brief Returns the current value of a monotonic clock.
+ *
+ * @return time, in seconds, since an arbitrary (fixed) starting point
+ */
+double bench_now(void);
+
+/**
+ * @brief Prints a single line benchmark result: total time, time per
+ *        operation, operations per second, and (if byte_count is non-zero)
+ *        throughput.
+ *
+ * @param[in]  label       Description of the operation measured
+ *
+ * @param[in]  op_count    Number of operations performed
+ *
+ * @param[in]  byte_count  Number of bytes processed (0 if not applicable)
+ *
+ * @param[in]  elapsed     Elapsed time, in seconds
+ *
+ * @return None
+ */
+void bench_report(const char *label, size_t op_count, size_t byte_count,
+                  double elapsed);
+
+/**
+ * @brief Prints a single line latency distribution: the median, 90th,
+ *        99th percentile, and maximum of a set of samples.
+ *
+ * @param[in]  label       Description of the operation measured
+ *
+ * @param[in]  samples     Latency samples, in seconds (sorted in place)
+ *
+ * @param[in]  count       Number of samples
+ *
+ * @return None
+ */
+void bench_report_latency(const char *label, double *samples, size_t count);
+
+/**
+ * @brief Parses a size argument with an optional K, M, or G (binary) suffix.
+ *
+ * @param[in]  str         The string to be parsed (e.g., "64K")
+ *
+ * @param[out] size        The parsed size, in bytes
+ *
+ * @return 0 on success, 1 on error
+ */
+int bench_parse_size(const char *str, size_t * size);
+
+/**
+ * Function signature for work run by bench_run_isolated()
+ */
+typedef int (*bench_isolated_fn) (void *arg);
+
+/**
+ * @brief Runs a function in a forked child process, so that its peak
+ *        memory use can be measured independently of anything the caller
+ *        has already allocated.
+ *
+ * @param[in]  fn          Function to run (returns 0 on success)
+ *
+ * @param[in]  arg         Argument passed to fn
+ *
+ * @param[out] peak_kib    Peak resident set size of the child, in KiB
+ *
+ * @return 0 if the child ran fn successfully, 1 on error
+ */
+int bench_run_isolated(bench_isolated_fn fn, void *arg, long *peak_kib);
+
+#endif
@@ -0,0 +1,31 @@
+/**
+ * @file  envelope_bench.h
+ *
+ * @brief Benchmark comparing envelope (single TPM-sealed KEK) mode against
+ *        conventional per-file kmyth-seal/kmyth-unseal.
+ */
+
+#ifndef ENVELOPE_BENCH_H
+#define ENVELOPE_BENCH_H
+
+/**
+ * @brief Seals and unseals a set of files, first with a TPM-sealed wrapping
+ *        key per file (tpm2_kmyth_seal/tpm2_kmyth_unseal) and then in
+ *        envelope mode (one sealed KEK, HKDF derived data keys), and reports
+ *        the time taken by each.
+ *
+ * Options:
+ *   -n count   number of files (default 100)
+ *   -s size    size of each file, with optional K/M/G suffix (default 4K)
+ *
+ * Requires access to a TPM 2.0 (or simulator).
+ *
+ * @param[in]  argc        Argument count (argv[0] is the benchmark name)
+ *
+ * @param[in]  argv        Arguments
+ *
+ * @return 0 on success, 1 on error
+ */
+int envelope_bench(int argc, char **argv);
+
+#endif
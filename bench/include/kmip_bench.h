@@ -0,0 +1,45 @@
+/**
+ * @file  kmip_bench.h
+ *
+ * @brief KMIP key retrieval load test (throughput and latency percentiles),
+ *        intended to be run against the loopback kmip-server.
+ */
+
+#ifndef KMIP_BENCH_H
+#define KMIP_BENCH_H
+
+/**
+ * @brief Retrieves keys from a KMIP server over TLS, from several threads,
+ *        the way kmyth-getkey does, and reports the request throughput and
+ *        the latency distribution (p50/p90/p99/max) of the requests.
+ *
+ * Each thread opens one TLS connection and sends its requests over it,
+ * unless -r is given, in which case every request gets a new connection
+ * (and full handshake), as kmyth-getkey does for a single key.
+ *
+ * Options:
+ *   -c addr    server ip_address:port (default 127.0.0.1:5696)
+ *   -i key     client private key (unsealed PEM)
+ *   -l cert    client certificate
+ *   -s cert    certificate of the CA that issued the server certificate
+ *   -t threads number of concurrent clients (default 4)
+ *   -n count   requests per thread (default 100)
+ *   -b batch   keys per request; above 1, one KMIP batch Get (default 1)
+ *   -k keys    number of server keys (IDs key-0 ...) to cycle through
+ *              (default 1)
+ *   -r         reconnect for every request
+ *
+ * Requires a KMIP server holding keys key-0, key-1, ... (e.g.,
+ * 'kmip-server -n <keys>'). The same server can back the SGX demo
+ * tls_proxy, so that the enclave retrieval path is measured against a
+ * known server.
+ *
+ * @param[in]  argc        Argument count (argv[0] is the benchmark name)
+ *
+ * @param[in]  argv        Arguments
+ *
+ * @return 0 on success, 1 on error
+ */
+int kmip_bench(int argc, char **argv);
+
+#endif
@@ -0,0 +1,32 @@
+/**
+ * @file  parse_bench.h
+ *
+ * @brief Benchmark comparing the previous strncmp() delimiter scan with
+ *        the memchr() based block tokenizers.
+ */
+
+#ifndef PARSE_BENCH_H
+#define PARSE_BENCH_H
+
+/**
+ * @brief Locates the data block of a large block-delimited input using the
+ *        previous per-byte strncmp() scan, get_block_bytes(),
+ *        get_block_view(), and the streaming tokenizer (block_stream_t),
+ *        and reports the throughput of each.
+ *
+ * Options:
+ *   -s size    payload size, with optional K/M/G suffix (default 64M)
+ *   -p size    piece size fed to the streaming tokenizer (default 64K)
+ *   -r reps    repetitions of each measurement (default 4)
+ *
+ * Does not require a TPM.
+ *
+ * @param[in]  argc        Argument count (argv[0] is the benchmark name)
+ *
+ * @param[in]  argv        Arguments
+ *
+ * @return 0 on success, 1 on error
+ */
+int parse_bench(int argc, char **argv);
+
+#endif
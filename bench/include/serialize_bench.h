@@ -0,0 +1,33 @@
+/**
+ * @file  serialize_bench.h
+ *
+ * @brief Benchmark comparing the single-allocation block serializer with
+ *        the previous encode-then-concat() approach.
+ */
+
+#ifndef SERIALIZE_BENCH_H
+#define SERIALIZE_BENCH_H
+
+/**
+ * @brief Serializes a payload into block-delimited (.ski style) format over
+ *        a range of payload sizes, using encodeBase64Data() and concat(),
+ *        create_block_bytes(), and write_block_bytes_to_fd(), and reports
+ *        the throughput and peak memory of each.
+ *
+ * Options:
+ *   -f size    smallest payload, with optional K/M/G suffix (default 1K)
+ *   -t size    largest payload, with optional K/M/G suffix (default 4G)
+ *   -x factor  payload size multiplier between runs (default 16)
+ *
+ * Each measurement runs in its own process so peak memory is reported per
+ * serializer. Does not require a TPM.
+ *
+ * @param[in]  argc        Argument count (argv[0] is the benchmark name)
+ *
+ * @param[in]  argv        Arguments
+ *
+ * @return 0 on success, 1 on error
+ */
+int serialize_bench(int argc, char **argv);
+
+#endif
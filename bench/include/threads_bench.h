@@ -0,0 +1,34 @@
+/**
+ * @file  threads_bench.h
+ *
+ * @brief Multi-threaded seal/unseal stress and throughput benchmark.
+ */
+
+#ifndef THREADS_BENCH_H
+#define THREADS_BENCH_H
+
+/**
+ * @brief Runs concurrent tpm2_kmyth_seal()/tpm2_kmyth_unseal() round trips
+ *        from several threads, checks every result, and reports the
+ *        throughput against the same amount of work done by one thread.
+ *
+ * TPM commands are serialized by the library's TPM queue, so the speedup
+ * comes from the host-side work (parsing, encoding, symmetric crypto)
+ * running in parallel. Larger payloads make that work a larger share.
+ *
+ * Options:
+ *   -t threads number of concurrent threads (default 4)
+ *   -n count   round trips per thread (default 8)
+ *   -s size    payload size, with optional K/M/G suffix (default 1M)
+ *
+ * Requires access to a TPM 2.0 (or simulator).
+ *
+ * @param[in]  argc        Argument count (argv[0] is the benchmark name)
+ *
+ * @param[in]  argv        Arguments
+ *
+ * @return 0 on success, 1 on error
+ */
+int threads_bench(int argc, char **argv);
+
+#endif
@@ -0,0 +1,161 @@
+/**
+ * @file  bench_util.c
+ *
+ * @brief Implements timing and reporting utilities shared by the kmyth
+ *        benchmarks.
+ */
+
+#include "bench_util.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <sys/resource.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+//############################################################################
+// bench_now()
+//############################################################################
+double bench_now(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double) ts.tv_sec + ((double) ts.tv_nsec / 1e9);
+}
+
+//############################################################################
+// bench_report()
+//############################################################################
+void bench_report(const char *label, size_t op_count, size_t byte_count,
+                  double elapsed)
+{
+  double per_op_ms = (op_count > 0) ? (elapsed * 1e3) / op_count : 0.0;
+  double ops_per_sec = (elapsed > 0) ? op_count / elapsed : 0.0;
+
+  fprintf(stdout, "  %-36s %8zu ops %10.3f s %10.3f ms/op %10.1f ops/s",
+          label, op_count, elapsed, per_op_ms, ops_per_sec);
+  if (byte_count > 0 && elapsed > 0)
+  {
+    fprintf(stdout, " %10.1f MiB/s",
+            ((double) byte_count / (1024.0 * 1024.0)) / elapsed);
+  }
+  fprintf(stdout, "\n");
+}
+
+//############################################################################
+// compare_samples()
+//############################################################################
+static int compare_samples(const void *a, const void *b)
+{
+  double x = *(const double *) a;
+  double y = *(const double *) b;
+
+  return (x > y) - (x < y);
+}
+
+//############################################################################
+// bench_report_latency()
+//############################################################################
+void bench_report_latency(const char *label, double *samples, size_t count)
+{
+  if (count == 0)
+  {
+    return;
+  }
+  qsort(samples, count, sizeof(double), compare_samples);
+
+  // nearest-rank percentiles
+  double p50 = samples[(count * 50 + 99) / 100 - 1];
+  double p90 = samples[(count * 90 + 99) / 100 - 1];
+  double p99 = samples[(count * 99 + 99) / 100 - 1];
+
+  fprintf(stdout, "  %-36s p50 %9.3f ms  p90 %9.3f ms  p99 %9.3f ms  "
+          "max %9.3f ms\n", label, p50 * 1e3, p90 * 1e3, p99 * 1e3,
+          samples[count - 1] * 1e3);
+}
+
+//############################################################################
+// bench_parse_size()
+//############################################################################
+int bench_parse_size(const char *str, size_t * size)
+{
+  char *end = NULL;
+
+  errno = 0;
+  unsigned long long value = strtoull(str, &end, 10);
+
+  if (errno != 0 || end == str)
+  {
+    return 1;
+  }
+
+  switch (*end)
+  {
+  case '\0':
+    break;
+  case 'k':
+  case 'K':
+    value <<= 10;
+    end++;
+    break;
+  case 'm':
+  case 'M':
+    value <<= 20;
+    end++;
+    break;
+  case 'g':
+  case 'G':
+    value <<= 30;
+    end++;
+    break;
+  default:
+    return 1;
+  }
+
+  if (*end != '\0')
+  {
+    return 1;
+  }
+
+  *size = (size_t) value;
+  return 0;
+}
+
+//############################################################################
+// bench_run_isolated()
+//############################################################################
+int bench_run_isolated(bench_isolated_fn fn, void *arg, long *peak_kib)
+{
+  fflush(stdout);
+  fflush(stderr);
+
+  pid_t pid = fork();
+
+  if (pid < 0)
+  {
+    return 1;
+  }
+  if (pid == 0)
+  {
+    int rc = fn(arg);
+
+    fflush(stdout);
+    _exit((rc == 0) ? 0 : 1);
+  }
+
+  int status = 0;
+  struct rusage usage;
+
+  if (wait4(pid, &status, 0, &usage) != pid)
+  {
+    return 1;
+  }
+  *peak_kib = usage.ru_maxrss;
+
+  return (WIFEXITED(status) && WEXITSTATUS(status) == 0) ? 0 : 1;
+}
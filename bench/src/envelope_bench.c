@@ -0,0 +1,219 @@
+/**
+ * @file  envelope_bench.c
+ *
+ * @brief Benchmark comparing envelope (KEK) mode against per-file sealing.
+ */
+
+#include "envelope_bench.h"
+
+#include <getopt.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <openssl/rand.h>
+
+#include "bench_util.h"
+#include "kmyth.h"
+#include "memory_util.h"
+
+//############################################################################
+// free_buffers()
+//############################################################################
+static void free_buffers(uint8_t ** bufs, size_t *lens, size_t count)
+{
+  // unsealed outputs come from the secure arena, so these are released
+  // with kmyth_clear_and_free() (which also handles heap buffers)
+  for (size_t i = 0; i < count; i++)
+  {
+    kmyth_clear_and_free(bufs[i], lens[i]);
+    bufs[i] = NULL;
+  }
+}
+
+//############################################################################
+// run_per_file()
+//############################################################################
+static int run_per_file(uint8_t ** inputs, size_t *input_lens, size_t count,
+                        size_t size, uint8_t ** sealed, size_t *sealed_lens,
+                        uint8_t ** outputs, size_t *output_lens)
+{
+  double start = bench_now();
+
+  for (size_t i = 0; i < count; i++)
+  {
+    if (tpm2_kmyth_seal(inputs[i], input_lens[i], &sealed[i], &sealed_lens[i],
+                        NULL, 0, NULL, 0, NULL, 0, NULL))
+    {
+      fprintf(stderr, "per-file seal failed (index %zu)\n", i);
+      return 1;
+    }
+  }
+  bench_report("per-file seal", count, count * size, bench_now() - start);
+
+  start = bench_now();
+  for (size_t i = 0; i < count; i++)
+  {
+    if (tpm2_kmyth_unseal(sealed[i], sealed_lens[i],
+                          &outputs[i], &output_lens[i], NULL, 0, NULL, 0))
+    {
+      fprintf(stderr, "per-file unseal failed (index %zu)\n", i);
+      return 1;
+    }
+  }
+  bench_report("per-file unseal", count, count * size, bench_now() - start);
+
+  return 0;
+}
+
+//############################################################################
+// run_envelope()
+//############################################################################
+static int run_envelope(uint8_t ** inputs, size_t *input_lens, size_t count,
+                        size_t size, uint8_t ** sealed, size_t *sealed_lens,
+                        uint8_t ** outputs, size_t *output_lens)
+{
+  uint8_t *kek_ski = NULL;
+  size_t kek_ski_len = 0;
+
+  double start = bench_now();
+
+  if (tpm2_kmyth_create_kek(&kek_ski, &kek_ski_len, NULL, 0, NULL, 0,
+                            NULL, 0))
+  {
+    fprintf(stderr, "KEK creation failed\n");
+    return 1;
+  }
+  bench_report("envelope KEK create (one-time)", 1, 0, bench_now() - start);
+
+  start = bench_now();
+  if (tpm2_kmyth_envelope_seal(kek_ski, kek_ski_len, inputs, input_lens,
+                               count, sealed, sealed_lens, NULL, 0, NULL, 0,
+                               NULL))
+  {
+    fprintf(stderr, "envelope seal failed\n");
+    free(kek_ski);
+    return 1;
+  }
+  bench_report("envelope seal", count, count * size, bench_now() - start);
+
+  start = bench_now();
+  if (tpm2_kmyth_envelope_unseal(kek_ski, kek_ski_len, sealed, sealed_lens,
+                                 count, outputs, output_lens, NULL, 0, NULL,
+                                 0))
+  {
+    fprintf(stderr, "envelope unseal failed\n");
+    free(kek_ski);
+    return 1;
+  }
+  bench_report("envelope unseal", count, count * size, bench_now() - start);
+  free(kek_ski);
+
+  for (size_t i = 0; i < count; i++)
+  {
+    if (output_lens[i] != input_lens[i]
+        || memcmp(outputs[i], inputs[i], input_lens[i]))
+    {
+      fprintf(stderr, "envelope round trip mismatch (index %zu)\n", i);
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
+//############################################################################
+// envelope_bench()
+//############################################################################
+int envelope_bench(int argc, char **argv)
+{
+  size_t count = 100;
+  size_t size = 4096;
+  int opt;
+
+  optind = 1;
+  while ((opt = getopt(argc, argv, "n:s:")) != -1)
+  {
+    switch (opt)
+    {
+    case 'n':
+      count = strtoul(optarg, NULL, 10);
+      break;
+    case 's':
+      if (bench_parse_size(optarg, &size))
+      {
+        fprintf(stderr, "invalid size: %s\n", optarg);
+        return 1;
+      }
+      break;
+    default:
+      return 1;
+    }
+  }
+  if (count == 0 || size == 0)
+  {
+    fprintf(stderr, "file count and size must be non-zero\n");
+    return 1;
+  }
+
+  uint8_t **inputs = calloc(count, sizeof(uint8_t *));
+  size_t *input_lens = calloc(count, sizeof(size_t));
+  uint8_t **sealed = calloc(count, sizeof(uint8_t *));
+  size_t *sealed_lens = calloc(count, sizeof(size_t));
+  uint8_t **outputs = calloc(count, sizeof(uint8_t *));
+  size_t *output_lens = calloc(count, sizeof(size_t));
+
+  int retval = 0;
+
+  if (inputs == NULL || input_lens == NULL || sealed == NULL
+      || sealed_lens == NULL || outputs == NULL || output_lens == NULL)
+  {
+    fprintf(stderr, "unable to allocate benchmark buffers\n");
+    retval = 1;
+  }
+
+  for (size_t i = 0; retval == 0 && i < count; i++)
+  {
+    inputs[i] = malloc(size);
+    if (inputs[i] == NULL || !RAND_bytes(inputs[i], size))
+    {
+      fprintf(stderr, "unable to create benchmark input\n");
+      retval = 1;
+    }
+    input_lens[i] = size;
+  }
+
+  if (retval == 0)
+  {
+    fprintf(stdout, "envelope: %zu files of %zu bytes\n", count, size);
+
+    // Baseline: a TPM-sealed wrapping key per file
+    retval = run_per_file(inputs, input_lens, count, size,
+                          sealed, sealed_lens, outputs, output_lens);
+    free_buffers(sealed, sealed_lens, count);
+    free_buffers(outputs, output_lens, count);
+  }
+
+  if (retval == 0)
+  {
+    // Envelope mode: one TPM-sealed KEK, host-derived data keys
+    retval = run_envelope(inputs, input_lens, count, size,
+                          sealed, sealed_lens, outputs, output_lens);
+    free_buffers(sealed, sealed_lens, count);
+    free_buffers(outputs, output_lens, count);
+  }
+
+  if (inputs != NULL && input_lens != NULL)
+  {
+    free_buffers(inputs, input_lens, count);
+  }
+  free(inputs);
+  free(input_lens);
+  free(sealed);
+  free(sealed_lens);
+  free(outputs);
+  free(output_lens);
+
+  return retval;
+}
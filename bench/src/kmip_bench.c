@@ -0,0 +1,306 @@
+/**
+ * @file  kmip_bench.c
+ *
+ * @brief KMIP key retrieval load test (throughput and latency percentiles).
+ */
+
+#include "kmip_bench.h"
+
+#include <getopt.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <openssl/bio.h>
+#include <openssl/ssl.h>
+
+#include "bench_util.h"
+#include "file_io.h"
+#include "memory_util.h"
+#include "tls_util.h"
+
+/// Upper bound on the -t option
+#define KMIP_BENCH_MAX_THREADS 256
+
+/// Upper bound on the -b option
+#define KMIP_BENCH_MAX_BATCH 1024
+
+/**
+ * @brief Settings shared by every benchmark thread
+ */
+typedef struct
+{
+  char *address;
+  unsigned char *client_key;
+  size_t client_key_len;
+  char *client_cert;
+  char *ca_cert;
+  size_t count;
+  size_t batch;
+  size_t keys;
+  int reconnect;
+} kmip_bench_config_t;
+
+/**
+ * @brief Work assignment and results for one benchmark thread
+ */
+typedef struct
+{
+  kmip_bench_config_t *config;
+  size_t first_key;
+  double *latencies;
+  size_t failures;
+} kmip_bench_work_t;
+
+//############################################################################
+// connect_to_server()
+//############################################################################
+static int connect_to_server(kmip_bench_config_t * config, BIO ** bio,
+                             SSL_CTX ** ctx)
+{
+  // create_tls_connection() splits the address string in place
+  char *address = strdup(config->address);
+
+  *bio = NULL;
+  *ctx = NULL;
+
+  int result = (address == NULL)
+    || create_tls_connection(&address, config->client_key,
+                             config->client_key_len, config->client_cert,
+                             config->ca_cert, bio, ctx);
+
+  free(address);
+  return result;
+}
+
+//############################################################################
+// disconnect_from_server()
+//############################################################################
+static void disconnect_from_server(BIO * bio, SSL_CTX * ctx)
+{
+  if (bio != NULL)
+  {
+    BIO_ssl_shutdown(bio);
+    BIO_free_all(bio);
+  }
+  SSL_CTX_free(ctx);
+}
+
+//############################################################################
+// get_keys()
+//############################################################################
+static int get_keys(BIO * bio, kmip_bench_config_t * config, size_t first)
+{
+  char id_values[KMIP_BENCH_MAX_BATCH][32];
+  char *ids[KMIP_BENCH_MAX_BATCH];
+  unsigned char *keys[KMIP_BENCH_MAX_BATCH] = { 0 };
+  size_t key_sizes[KMIP_BENCH_MAX_BATCH] = { 0 };
+
+  for (size_t i = 0; i < config->batch; i++)
+  {
+    snprintf(id_values[i], sizeof(id_values[i]), "key-%zu",
+             (first + i) % config->keys);
+    ids[i] = id_values[i];
+  }
+
+  int result = (config->batch == 1)
+    ? get_key_from_kmip_server(bio, ids[0], strlen(ids[0]),
+                               &keys[0], &key_sizes[0])
+    : get_keys_from_kmip_server(bio, ids, config->batch, keys, key_sizes);
+
+  for (size_t i = 0; i < config->batch; i++)
+  {
+    kmyth_clear_and_free(keys[i], key_sizes[i]);
+  }
+
+  return result;
+}
+
+//############################################################################
+// requests()
+//############################################################################
+static void *requests(void *arg)
+{
+  kmip_bench_work_t *work = (kmip_bench_work_t *) arg;
+  kmip_bench_config_t *config = work->config;
+  BIO *bio = NULL;
+  SSL_CTX *ctx = NULL;
+
+  if (!config->reconnect && connect_to_server(config, &bio, &ctx))
+  {
+    work->failures = config->count;
+    disconnect_from_server(bio, ctx);
+    return NULL;
+  }
+
+  for (size_t i = 0; i < config->count; i++)
+  {
+    size_t first = work->first_key + i * config->batch;
+    double start = bench_now();
+
+    if (config->reconnect && connect_to_server(config, &bio, &ctx))
+    {
+      work->failures++;
+      disconnect_from_server(bio, ctx);
+      work->latencies[i] = bench_now() - start;
+      continue;
+    }
+
+    if (get_keys(bio, config, first))
+    {
+      work->failures++;
+    }
+
+    if (config->reconnect)
+    {
+      disconnect_from_server(bio, ctx);
+    }
+    work->latencies[i] = bench_now() - start;
+  }
+
+  if (!config->reconnect)
+  {
+    disconnect_from_server(bio, ctx);
+  }
+
+  return NULL;
+}
+
+//############################################################################
+// kmip_bench()
+//############################################################################
+int kmip_bench(int argc, char **argv)
+{
+  kmip_bench_config_t config = {
+    .address = "127.0.0.1:5696",
+    .count = 100,
+    .batch = 1,
+    .keys = 1,
+  };
+  char *client_key_path = NULL;
+  size_t thread_count = 4;
+  int opt;
+
+  optind = 1;
+  while ((opt = getopt(argc, argv, "c:i:l:s:t:n:b:k:r")) != -1)
+  {
+    switch (opt)
+    {
+    case 'c':
+      config.address = optarg;
+      break;
+    case 'i':
+      client_key_path = optarg;
+      break;
+    case 'l':
+      config.client_cert = optarg;
+      break;
+    case 's':
+      config.ca_cert = optarg;
+      break;
+    case 't':
+      thread_count = strtoul(optarg, NULL, 10);
+      break;
+    case 'n':
+      config.count = strtoul(optarg, NULL, 10);
+      break;
+    case 'b':
+      config.batch = strtoul(optarg, NULL, 10);
+      break;
+    case 'k':
+      config.keys = strtoul(optarg, NULL, 10);
+      break;
+    case 'r':
+      config.reconnect = 1;
+      break;
+    default:
+      return 1;
+    }
+  }
+  if (client_key_path == NULL || config.client_cert == NULL
+      || config.ca_cert == NULL)
+  {
+    fprintf(stderr, "client key (-i), client certificate (-l), and CA "
+            "certificate (-s) are required\n");
+    return 1;
+  }
+  if (thread_count == 0 || thread_count > KMIP_BENCH_MAX_THREADS
+      || config.count == 0 || config.batch == 0
+      || config.batch > KMIP_BENCH_MAX_BATCH || config.keys == 0)
+  {
+    fprintf(stderr, "invalid thread, request, batch, or key count\n");
+    return 1;
+  }
+
+  if (read_bytes_from_file(client_key_path, &config.client_key,
+                           &config.client_key_len))
+  {
+    fprintf(stderr, "unable to read client key: %s\n", client_key_path);
+    return 1;
+  }
+
+  size_t total = thread_count * config.count;
+  double *latencies = calloc(total, sizeof(double));
+  kmip_bench_work_t work[KMIP_BENCH_MAX_THREADS];
+  pthread_t threads[KMIP_BENCH_MAX_THREADS];
+  size_t started = 0;
+
+  if (latencies == NULL)
+  {
+    fprintf(stderr, "unable to allocate latency samples\n");
+    kmyth_clear_and_free(config.client_key, config.client_key_len);
+    return 1;
+  }
+
+  fprintf(stdout, "kmip: %zu threads x %zu requests, %zu keys/request, "
+          "%s\n", thread_count, config.count, config.batch,
+          config.reconnect ? "new connection per request"
+          : "one connection per thread");
+
+  double start = bench_now();
+
+  for (size_t t = 0; t < thread_count; t++)
+  {
+    work[t].config = &config;
+    work[t].first_key = t * config.count * config.batch;
+    work[t].latencies = latencies + t * config.count;
+    work[t].failures = 0;
+    if (pthread_create(&threads[t], NULL, requests, &work[t]))
+    {
+      fprintf(stderr, "unable to start thread %zu\n", t);
+      break;
+    }
+    started++;
+  }
+
+  size_t failures = 0;
+
+  for (size_t t = 0; t < started; t++)
+  {
+    pthread_join(threads[t], NULL);
+    failures += work[t].failures;
+  }
+
+  double elapsed = bench_now() - start;
+  int result = 0;
+
+  if (started != thread_count || failures)
+  {
+    fprintf(stderr, "kmip: %zu of %zu requests failed\n", failures,
+            started * config.count);
+    result = 1;
+  }
+  else
+  {
+    bench_report("requests", total, 0, elapsed);
+    bench_report("keys", total * config.batch, 0, elapsed);
+    bench_report_latency("request latency", latencies, total);
+  }
+
+  free(latencies);
+  kmyth_clear_and_free(config.client_key, config.client_key_len);
+
+  return result;
+}
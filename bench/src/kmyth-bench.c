@@ -0,0 +1,110 @@
+/**
+ * @file  kmyth-bench.c
+ *
+ * Top-level application to run kmyth performance benchmarks.
+ *
+ * usage: kmyth-bench <benchmark> [benchmark options]
+ *        kmyth-bench -l (lists the available benchmarks)
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "defines.h"
+#include "kmyth_log.h"
+
+#include "envelope_bench.h"
+#include "kmip_bench.h"
+#include "parse_bench.h"
+#include "serialize_bench.h"
+#include "threads_bench.h"
+
+/**
+ * Function signature that each benchmark entry point must match. argv[0]
+ * is the benchmark name, so benchmarks can parse their options with getopt().
+ */
+typedef int (*bench_fn) (int argc, char **argv);
+
+typedef struct
+{
+  const char *name;
+  const char *description;
+  bench_fn run;
+} bench_t;
+
+/**
+ * @brief List of available benchmarks (NULL name terminated)
+ */
+static const bench_t bench_list[] = {
+  {"envelope",
+   "envelope (KEK) mode vs. per-file sealing [-n count] [-s size]",
+   envelope_bench},
+  {"kmip",
+   "KMIP key retrieval load test [-c addr] [-i key] [-l cert] [-s ca] "
+   "[-t threads] [-n count] [-b batch] [-k keys] [-r]",
+   kmip_bench},
+  {"parse",
+   ".ski/.nkl block tokenizers [-s size] [-p piece] [-r reps]",
+   parse_bench},
+  {"serialize",
+   ".ski block serializers, 1K-4G payloads [-f min] [-t max] [-x factor]",
+   serialize_bench},
+  {"threads",
+   "concurrent seal/unseal stress and throughput [-t threads] [-n count] "
+   "[-s size]",
+   threads_bench},
+  {NULL, NULL, NULL}
+};
+
+static void usage(const char *prog)
+{
+  fprintf(stdout,
+          "\nusage: %s <benchmark> [options]\n"
+          "       %s -l (list available benchmarks)\n\n", prog, prog);
+}
+
+static void list_benchmarks(void)
+{
+  fprintf(stdout, "available benchmarks:\n");
+  for (size_t i = 0; bench_list[i].name != NULL; i++)
+  {
+    fprintf(stdout, "  %-12s %s\n", bench_list[i].name,
+            bench_list[i].description);
+  }
+}
+
+//----------------------------------------------------------------------------
+// main() - the requested benchmark is looked up and run here
+//----------------------------------------------------------------------------
+int main(int argc, char **argv)
+{
+  if (argc < 2 || !strcmp(argv[1], "-h"))
+  {
+    usage(argv[0]);
+    list_benchmarks();
+    return 0;
+  }
+  if (!strcmp(argv[1], "-l"))
+  {
+    list_benchmarks();
+    return 0;
+  }
+
+  // keep library log messages out of the benchmark results
+  set_app_name(KMYTH_APP_NAME);
+  set_app_version(KMYTH_VERSION);
+  set_applog_severity_threshold(LOG_ERR);
+  set_applog_output_mode(0);
+
+  for (size_t i = 0; bench_list[i].name != NULL; i++)
+  {
+    if (!strcmp(argv[1], bench_list[i].name))
+    {
+      return bench_list[i].run(argc - 1, argv + 1);
+    }
+  }
+
+  fprintf(stderr, "unknown benchmark: %s\n", argv[1]);
+  list_benchmarks();
+  return 1;
+}
@@ -0,0 +1,219 @@
+/**
+ * @file  parse_bench.c
+ *
+ * @brief Benchmark comparing the block-delimited (.ski/.nkl) tokenizers.
+ */
+
+#include "parse_bench.h"
+
+#include <getopt.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench_util.h"
+#include "formatting_tools.h"
+
+//############################################################################
+// strncmp_block_size()
+//############################################################################
+static int strncmp_block_size(uint8_t * contents, size_t remaining,
+                              char *next_delim, size_t *size)
+{
+  size_t next_delim_len = strlen(next_delim);
+
+  // the delimiter search previously used by get_block_bytes()
+  *size = 0;
+  while (strncmp((char *) contents + *size, next_delim, next_delim_len))
+  {
+    (*size)++;
+    if (*size + next_delim_len > remaining)
+    {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+//############################################################################
+// count_stream_bytes()
+//############################################################################
+static int count_stream_bytes(void *ctx, size_t block_index,
+                              uint8_t * data, size_t data_len)
+{
+  (void) block_index;
+  (void) data;
+  *(size_t *) ctx += data_len;
+  return 0;
+}
+
+//############################################################################
+// parse_bench()
+//############################################################################
+int parse_bench(int argc, char **argv)
+{
+  size_t size = (size_t) 64 << 20;
+  size_t piece = 64 * 1024;
+  size_t reps = 4;
+  int opt;
+
+  optind = 1;
+  while ((opt = getopt(argc, argv, "s:p:r:")) != -1)
+  {
+    switch (opt)
+    {
+    case 's':
+      if (bench_parse_size(optarg, &size))
+      {
+        fprintf(stderr, "invalid size: %s\n", optarg);
+        return 1;
+      }
+      break;
+    case 'p':
+      if (bench_parse_size(optarg, &piece))
+      {
+        fprintf(stderr, "invalid size: %s\n", optarg);
+        return 1;
+      }
+      break;
+    case 'r':
+      reps = strtoul(optarg, NULL, 10);
+      break;
+    default:
+      return 1;
+    }
+  }
+  if (size == 0 || piece == 0 || reps == 0)
+  {
+    fprintf(stderr, "size, piece size, and repetitions must be non-zero\n");
+    return 1;
+  }
+
+  // build a single block .nkl style input around a payload of 'size' bytes
+  uint8_t *payload = malloc(size);
+  uint8_t *input = NULL;
+  size_t input_len = 0;
+
+  if (payload == NULL)
+  {
+    fprintf(stderr, "unable to allocate %zu byte payload\n", size);
+    return 1;
+  }
+  for (size_t i = 0; i < size; i++)
+  {
+    payload[i] = (uint8_t) (i * 31);
+  }
+  if (create_nkl_bytes(payload, size, &input, &input_len))
+  {
+    fprintf(stderr, "unable to create benchmark input\n");
+    free(payload);
+    return 1;
+  }
+  free(payload);
+
+  size_t delim_len = strlen(KMYTH_DELIM_NKL_DATA);
+  size_t end_len = strlen(KMYTH_DELIM_END_NKL);
+  size_t expected = input_len - delim_len - end_len;
+  int retval = 0;
+
+  fprintf(stdout, "parse: %zu byte payload (%zu byte input), %zu reps\n",
+          size, input_len, reps);
+
+  double start = bench_now();
+
+  for (size_t r = 0; r < reps && retval == 0; r++)
+  {
+    size_t block_size = 0;
+
+    if (strncmp_block_size(input + delim_len, input_len - delim_len,
+                           KMYTH_DELIM_END_NKL, &block_size)
+        || block_size != expected)
+    {
+      retval = 1;
+    }
+  }
+  if (retval == 0)
+  {
+    bench_report("strncmp() scan (previous)", reps, reps * input_len,
+                 bench_now() - start);
+  }
+
+  start = bench_now();
+  for (size_t r = 0; r < reps && retval == 0; r++)
+  {
+    char *position = (char *) input;
+    size_t remaining = input_len;
+    uint8_t *block = NULL;
+    size_t block_size = 0;
+
+    if (get_block_bytes(&position, &remaining, &block, &block_size,
+                        KMYTH_DELIM_NKL_DATA, delim_len,
+                        KMYTH_DELIM_END_NKL, end_len)
+        || block_size != expected)
+    {
+      retval = 1;
+    }
+    free(block);
+  }
+  if (retval == 0)
+  {
+    bench_report("get_block_bytes() (copy)", reps, reps * input_len,
+                 bench_now() - start);
+  }
+
+  start = bench_now();
+  for (size_t r = 0; r < reps && retval == 0; r++)
+  {
+    uint8_t *position = input;
+    size_t remaining = input_len;
+    block_view_t view;
+
+    if (get_block_view(&position, &remaining, &view,
+                       KMYTH_DELIM_NKL_DATA, delim_len,
+                       KMYTH_DELIM_END_NKL, end_len) || view.size != expected)
+    {
+      retval = 1;
+    }
+  }
+  if (retval == 0)
+  {
+    bench_report("get_block_view()", reps, reps * input_len,
+                 bench_now() - start);
+  }
+
+  char *delims[] = { KMYTH_DELIM_NKL_DATA, KMYTH_DELIM_END_NKL };
+
+  start = bench_now();
+  for (size_t r = 0; r < reps && retval == 0; r++)
+  {
+    block_stream_t stream;
+    size_t streamed = 0;
+
+    retval = block_stream_init(&stream, delims, 2, count_stream_bytes,
+                               &streamed);
+    for (size_t i = 0; i < input_len && retval == 0; i += piece)
+    {
+      size_t len = (input_len - i < piece) ? input_len - i : piece;
+
+      retval = block_stream_update(&stream, input + i, len);
+    }
+    if (retval == 0 && (block_stream_final(&stream) || streamed != expected))
+    {
+      retval = 1;
+    }
+  }
+  if (retval == 0)
+  {
+    bench_report("block_stream_update()", reps, reps * input_len,
+                 bench_now() - start);
+  }
+
+  if (retval)
+  {
+    fprintf(stderr, "tokenizer returned an unexpected result\n");
+  }
+
+  free(input);
+  return retval;
+}
@@ -0,0 +1,248 @@
+/**
+ * @file  serialize_bench.c
+ *
+ * @brief Benchmark comparing the block-delimited (.ski/.nkl) serializers.
+ */
+
+#include "serialize_bench.h"
+
+#include <fcntl.h>
+#include <getopt.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "bench_util.h"
+#include "formatting_tools.h"
+
+/**
+ * @brief Serializer implementations measured by this benchmark
+ */
+typedef enum
+{
+  SERIALIZE_CONCAT,             // encode each block to a temporary, concat()
+  SERIALIZE_SINGLE_ALLOC,       // create_block_bytes()
+  SERIALIZE_FD,                 // write_block_bytes_to_fd() to /dev/null
+} serialize_mode_t;
+
+typedef struct
+{
+  serialize_mode_t mode;
+  size_t size;
+  size_t reps;
+} serialize_case_t;
+
+static const char *mode_name[] = {
+  "encode + concat()",
+  "create_block_bytes()",
+  "write_block_bytes_to_fd()",
+};
+
+//############################################################################
+// serialize_concat()
+//############################################################################
+static int serialize_concat(block_spec_t * blocks, size_t block_count,
+                            uint8_t ** output, size_t *output_len)
+{
+  uint8_t *out = NULL;
+  size_t out_len = 0;
+
+  for (size_t i = 0; i < block_count; i++)
+  {
+    concat(&out, &out_len, (uint8_t *) blocks[i].delim,
+           strlen(blocks[i].delim));
+    if (blocks[i].raw)
+    {
+      concat(&out, &out_len, blocks[i].data, blocks[i].data_len);
+      concat(&out, &out_len, (uint8_t *) "\n", 1);
+      continue;
+    }
+
+    uint8_t *data64 = NULL;
+    size_t data64_len = 0;
+
+    if (encodeBase64Data(blocks[i].data, blocks[i].data_len, &data64,
+                         &data64_len))
+    {
+      free(out);
+      return 1;
+    }
+    concat(&out, &out_len, data64, data64_len);
+    free(data64);
+  }
+  concat(&out, &out_len, (uint8_t *) KMYTH_DELIM_END_FILE,
+         strlen(KMYTH_DELIM_END_FILE));
+
+  *output = out;
+  *output_len = out_len;
+  return 0;
+}
+
+//############################################################################
+// run_case()
+//############################################################################
+static int run_case(void *arg)
+{
+  serialize_case_t *c = (serialize_case_t *) arg;
+  uint8_t *data = malloc(c->size);
+
+  if (data == NULL)
+  {
+    fprintf(stderr, "unable to allocate %zu byte payload\n", c->size);
+    return 1;
+  }
+  for (size_t i = 0; i < c->size; i++)
+  {
+    data[i] = (uint8_t) (i * 31);
+  }
+
+  block_spec_t blocks[] = {
+    {KMYTH_DELIM_CIPHER_SUITE, (uint8_t *) "AES/GCM/NoPadding/256", 21, true},
+    {KMYTH_DELIM_ENC_DATA, data, c->size, false},
+  };
+  size_t expected_len = 0;
+
+  get_block_bytes_size(blocks, 2, KMYTH_DELIM_END_FILE, &expected_len);
+
+  int fd = -1;
+
+  if (c->mode == SERIALIZE_FD && (fd = open("/dev/null", O_WRONLY)) < 0)
+  {
+    fprintf(stderr, "unable to open /dev/null\n");
+    free(data);
+    return 1;
+  }
+
+  int retval = 0;
+  double start = bench_now();
+
+  for (size_t r = 0; r < c->reps && retval == 0; r++)
+  {
+    uint8_t *out = NULL;
+    size_t out_len = 0;
+
+    switch (c->mode)
+    {
+    case SERIALIZE_CONCAT:
+      retval = serialize_concat(blocks, 2, &out, &out_len);
+      break;
+    case SERIALIZE_SINGLE_ALLOC:
+      retval = create_block_bytes(blocks, 2, KMYTH_DELIM_END_FILE, &out,
+                                  &out_len);
+      break;
+    case SERIALIZE_FD:
+      retval = write_block_bytes_to_fd(fd, blocks, 2, KMYTH_DELIM_END_FILE);
+      out_len = expected_len;
+      break;
+    }
+    if (retval == 0 && out_len != expected_len)
+    {
+      fprintf(stderr, "unexpected output size (%zu, expected %zu)\n",
+              out_len, expected_len);
+      retval = 1;
+    }
+    free(out);
+  }
+
+  if (retval == 0)
+  {
+    bench_report(mode_name[c->mode], c->reps, c->reps * c->size,
+                 bench_now() - start);
+  }
+
+  if (fd >= 0)
+  {
+    close(fd);
+  }
+  free(data);
+  return retval;
+}
+
+//############################################################################
+// serialize_bench()
+//############################################################################
+int serialize_bench(int argc, char **argv)
+{
+  size_t min_size = 1024;
+  size_t max_size = (size_t) 4 << 30;
+  size_t step = 16;
+  int opt;
+
+  optind = 1;
+  while ((opt = getopt(argc, argv, "f:t:x:")) != -1)
+  {
+    switch (opt)
+    {
+    case 'f':
+      if (bench_parse_size(optarg, &min_size))
+      {
+        fprintf(stderr, "invalid size: %s\n", optarg);
+        return 1;
+      }
+      break;
+    case 't':
+      if (bench_parse_size(optarg, &max_size))
+      {
+        fprintf(stderr, "invalid size: %s\n", optarg);
+        return 1;
+      }
+      break;
+    case 'x':
+      step = strtoul(optarg, NULL, 10);
+      break;
+    default:
+      return 1;
+    }
+  }
+  if (min_size == 0 || max_size < min_size || step < 2)
+  {
+    fprintf(stderr, "invalid size range or step\n");
+    return 1;
+  }
+
+  int retval = 0;
+  size_t size = min_size;
+
+  while (size <= max_size)
+  {
+    // repeat small payloads so each measurement covers ~256 MiB of input
+    size_t reps = ((size_t) 256 << 20) / size;
+
+    reps = (reps == 0) ? 1 : ((reps > 100000) ? 100000 : reps);
+    fprintf(stdout, "payload %zu bytes (%zu reps):\n", size, reps);
+
+    for (int mode = SERIALIZE_CONCAT; mode <= SERIALIZE_FD; mode++)
+    {
+      // the OpenSSL BIO used by encodeBase64Data() is limited to INT_MAX
+      if (mode == SERIALIZE_CONCAT && size > INT_MAX)
+      {
+        fprintf(stdout, "  %-36s skipped (payload > INT_MAX)\n",
+                mode_name[mode]);
+        continue;
+      }
+
+      serialize_case_t c = {.mode = mode,.size = size,.reps = reps };
+      long peak_kib = 0;
+
+      if (bench_run_isolated(run_case, &c, &peak_kib))
+      {
+        fprintf(stdout, "  %-36s failed\n", mode_name[mode]);
+        retval = 1;
+        continue;
+      }
+      fprintf(stdout, "  %-36s peak RSS %ld KiB (%.2fx payload)\n", "",
+              peak_kib, (double) peak_kib * 1024.0 / (double) size);
+    }
+
+    if (size > max_size / step)
+    {
+      break;
+    }
+    size *= step;
+  }
+
+  return retval;
+}
@@ -0,0 +1,170 @@
+/**
+ * @file  threads_bench.c
+ *
+ * @brief Multi-threaded seal/unseal stress and throughput benchmark.
+ */
+
+#include "threads_bench.h"
+
+#include <getopt.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <openssl/rand.h>
+
+#include "bench_util.h"
+#include "kmyth.h"
+#include "memory_util.h"
+
+/// Upper bound on the -t option
+#define THREADS_BENCH_MAX_THREADS 256
+
+/**
+ * @brief Work assignment for one benchmark thread
+ */
+typedef struct
+{
+  size_t count;
+  size_t size;
+  size_t failures;
+} threads_bench_work_t;
+
+//############################################################################
+// round_trips()
+//############################################################################
+static void *round_trips(void *arg)
+{
+  threads_bench_work_t *work = (threads_bench_work_t *) arg;
+  uint8_t *input = malloc(work->size);
+
+  if (input == NULL || RAND_bytes(input, (int) work->size) != 1)
+  {
+    work->failures = work->count;
+    free(input);
+    return NULL;
+  }
+
+  for (size_t i = 0; i < work->count; i++)
+  {
+    uint8_t *sealed = NULL;
+    size_t sealed_len = 0;
+    uint8_t *output = NULL;
+    size_t output_len = 0;
+
+    if (tpm2_kmyth_seal(input, work->size, &sealed, &sealed_len,
+                        NULL, 0, NULL, 0, NULL, 0, NULL)
+        || tpm2_kmyth_unseal(sealed, sealed_len, &output, &output_len,
+                             NULL, 0, NULL, 0)
+        || output_len != work->size || memcmp(output, input, work->size))
+    {
+      work->failures++;
+    }
+    free(sealed);
+    kmyth_clear_and_free(output, output_len);
+  }
+
+  free(input);
+  return NULL;
+}
+
+//############################################################################
+// run_threads()
+//############################################################################
+static int run_threads(const char *label, size_t thread_count, size_t count,
+                       size_t size)
+{
+  threads_bench_work_t work[THREADS_BENCH_MAX_THREADS];
+  pthread_t threads[THREADS_BENCH_MAX_THREADS];
+  size_t started = 0;
+
+  double start = bench_now();
+
+  for (size_t t = 0; t < thread_count; t++)
+  {
+    work[t].count = count;
+    work[t].size = size;
+    work[t].failures = 0;
+    if (pthread_create(&threads[t], NULL, round_trips, &work[t]))
+    {
+      fprintf(stderr, "unable to start thread %zu\n", t);
+      break;
+    }
+    started++;
+  }
+
+  size_t failures = 0;
+
+  for (size_t t = 0; t < started; t++)
+  {
+    pthread_join(threads[t], NULL);
+    failures += work[t].failures;
+  }
+
+  if (started != thread_count || failures)
+  {
+    fprintf(stderr, "%s: %zu of %zu round trips failed\n", label, failures,
+            started * count);
+    return 1;
+  }
+
+  bench_report(label, thread_count * count, thread_count * count * size,
+               bench_now() - start);
+  return 0;
+}
+
+//############################################################################
+// threads_bench()
+//############################################################################
+int threads_bench(int argc, char **argv)
+{
+  size_t thread_count = 4;
+  size_t count = 8;
+  size_t size = 1024 * 1024;
+  int opt;
+
+  optind = 1;
+  while ((opt = getopt(argc, argv, "t:n:s:")) != -1)
+  {
+    switch (opt)
+    {
+    case 't':
+      thread_count = strtoul(optarg, NULL, 10);
+      break;
+    case 'n':
+      count = strtoul(optarg, NULL, 10);
+      break;
+    case 's':
+      if (bench_parse_size(optarg, &size))
+      {
+        fprintf(stderr, "invalid size: %s\n", optarg);
+        return 1;
+      }
+      break;
+    default:
+      return 1;
+    }
+  }
+  if (thread_count == 0 || thread_count > THREADS_BENCH_MAX_THREADS
+      || count == 0 || size == 0 || size > INT32_MAX)
+  {
+    fprintf(stderr, "invalid thread count, round trip count, or size\n");
+    return 1;
+  }
+
+  fprintf(stdout, "threads: %zu threads x %zu seal/unseal round trips, "
+          "%zu byte payload\n", thread_count, count, size);
+
+  // the same total amount of work from one thread, then from all of them
+  if (run_threads("1 thread", 1, thread_count * count, size))
+  {
+    return 1;
+  }
+
+  char label[64];
+
+  snprintf(label, sizeof(label), "%zu threads", thread_count);
+  return run_threads(label, thread_count, count, size);
+}
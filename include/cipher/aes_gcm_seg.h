@@ -0,0 +1,102 @@
+/**
+ * @file aes_gcm_seg.h
+ *
+ * @brief Provides a segmented, multi-threaded AES GCM construction for
+ *        encrypting large payloads in kmyth.
+ */
+#ifndef AES_GCM_SEG_H
+#define AES_GCM_SEG_H
+
+#include <stdlib.h>
+
+#include "cipher/aes_gcm.h"
+
+/// Size, in bytes, of each plaintext segment (the final segment may be
+/// shorter). Each segment is encrypted and authenticated independently.
+#define GCM_SEG_SIZE (1024 * 1024)
+
+/// Length of the segmented ciphertext header:
+///   base IV (GCM_IV_LEN) || segment size (4 bytes) || plaintext length (8)
+#define GCM_SEG_HEADER_LEN (GCM_IV_LEN + 4 + 8)
+
+/// Upper bound on the number of worker threads used for one payload
+#define GCM_SEG_MAX_THREADS 64
+
+/**
+ * @brief This function encrypts data by splitting it into GCM_SEG_SIZE byte
+ *        segments and encrypting the segments with AES/GCM in parallel.
+ *
+ * <pre>
+ * The outData block has the form
+ *    header||segment_0||tag_0||...||segment_n-1||tag_n-1
+ * where
+ *      header is the random base IV, the segment size, and the total
+ *        plaintext length (GCM_SEG_HEADER_LEN bytes, integers big-endian),
+ *      segment_i is encrypted under the IV formed by XORing the 64-bit
+ *        big-endian segment index i into the last 8 bytes of the base IV,
+ *      tag_i is the GCM_TAG_LEN byte tag authenticating segment_i with
+ *        the header and the index i as additional authenticated data.
+ * </pre>
+ *
+ * Authenticating the header (which fixes the segment count) and the index
+ * with every segment prevents segments from being reordered, dropped, or
+ * appended without the decryption failing.
+ *
+ * @param[in]  key         The hex bytes containing the key -
+ *                         pass in pointer to key buffer
+ *
+ * @param[in]  key_len     The length of the key in bytes
+ *                         (must be 16, 24, or 32)
+ *
+ * @param[in]  inData      The plaintext data to be encrypted -
+ *                         pass in pointer to input plaintext data buffer
+ *
+ * @param[in]  inData_len  The length, in bytes, of the plaintext data
+ *
+ * @param[out] outData     The output ciphertext (including the header and
+ *                         tags) - pass in pointer to address of ciphertext
+ *                         buffer
+ *
+ * @param[out] outData_len The length in bytes of outData -
+ *                         pass as pointer to length value
+ *
+ * @return 0 on success, 1 on error
+ */
+int aes_gcm_seg_encrypt(unsigned char *key,
+                        size_t key_len,
+                        unsigned char *inData,
+                        size_t inData_len, unsigned char **outData,
+                        size_t * outData_len);
+
+/**
+ * @brief This function decrypts data produced by aes_gcm_seg_encrypt(),
+ *        decrypting and verifying the segments in parallel.
+ *
+ * @param[in]  key         The hex bytes containing the key -
+ *                         pass in pointer to key buffer
+ *
+ * @param[in]  key_len     The length of the key in bytes
+ *                         (must be 16, 24, or 32)
+ *
+ * @param[in]  inData      The header and segments, formatted as described
+ *                         for aes_gcm_seg_encrypt() -
+ *                         pass in pointer to input values
+ *
+ * @param[in]  inData_len  The length in bytes of inData
+ *
+ * @param[out] outData     The output plaintext -
+ *                         passed as pointer to address of output buffer
+ *
+ * @param[out] outData_len The length in bytes of outData
+ *                         passed as pointer to length value
+ *
+ * @return 0 on success, 1 on error (including any segment failing
+ *         authentication)
+ */
+int aes_gcm_seg_decrypt(unsigned char *key,
+                        size_t key_len,
+                        unsigned char *inData,
+                        size_t inData_len, unsigned char **outData,
+                        size_t * outData_len);
+
+#endif
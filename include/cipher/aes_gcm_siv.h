@@ -0,0 +1,99 @@
+/**
+ * @file aes_gcm_siv.h
+ *
+ * @brief Provides access to OpenSSL's AES-GCM-SIV (RFC 8452)
+ *        implementation for kmyth.
+ */
+#ifndef AES_GCM_SIV_H
+#define AES_GCM_SIV_H
+
+#include <stdlib.h>
+
+#include <openssl/opensslv.h>
+
+/// AES-GCM-SIV is provided by OpenSSL 3.2 and newer. With older versions
+/// the functions below are still defined but always fail, and the cipher is
+/// not offered in cipher_list.
+#if OPENSSL_VERSION_NUMBER >= 0x30200000L
+#define KMYTH_AES_GCM_SIV_SUPPORTED
+#endif
+
+/// Length of the AES-GCM-SIV tag.
+#define GCM_SIV_TAG_LEN 16
+
+/// Length of the AES-GCM-SIV nonce (fixed at 96 bits by RFC 8452)
+#define GCM_SIV_NONCE_LEN 12
+
+/**
+ * @brief This function uses the AES-GCM-SIV implementation from OpenSSL to
+ *        encrypt data. Unlike AES/GCM, accidentally repeating a nonce under
+ *        the same key only reveals whether two plaintexts are identical,
+ *        which makes it suitable for high-volume sealing under one key.
+ *
+ * <pre>
+ * The outData block has the form
+ *    nonce||data||tag
+ * where
+ *      the nonce is 12 (GCM_SIV_NONCE_LEN) bytes in length and
+ *      the tag is 16 (GCM_SIV_TAG_LEN) bytes in length.
+ * </pre>
+ *
+ * @param[in]  key         The hex bytes containing the key -
+ *                         pass in pointer to key buffer
+ *
+ * @param[in]  key_len     The length of the key in bytes
+ *                         (must be 16, 24, or 32)
+ *
+ * @param[in]  inData      The plaintext data to be encrypted -
+ *                         pass in pointer to input plaintext data buffer
+ *
+ * @param[in]  inData_len  The length, in bytes, of the plaintext data
+ *
+ * @param[out] outData     The output ciphertext (including the nonce and
+ *                         tag) - pass in pointer to address of ciphertext
+ *                         buffer
+ *
+ * @param[out] outData_len The length in bytes of outData -
+ *                         pass as pointer to length value
+ *
+ * @return 0 on success, 1 on error (including if AES-GCM-SIV is not
+ *         supported by the OpenSSL version in use)
+ */
+int aes_gcm_siv_encrypt(unsigned char *key,
+                        size_t key_len,
+                        unsigned char *inData,
+                        size_t inData_len, unsigned char **outData,
+                        size_t * outData_len);
+
+/**
+ * @brief This function uses the AES-GCM-SIV implementation from OpenSSL to
+ *        decrypt data.
+ *
+ * @param[in]  key         The hex bytes containing the key -
+ *                         pass in pointer to key buffer
+ *
+ * @param[in]  key_len     The length of the key in bytes
+ *                         (must be 16, 24, or 32)
+ *
+ * @param[in]  inData      The nonce, ciphertext, and tag,
+ *                         formatted nonce||ciphertext||tag -
+ *                         pass in pointer to input values
+ *
+ * @param[in]  inData_len  The length in bytes of inData
+ *
+ * @param[out] outData     The output plaintext -
+ *                         passed as pointer to address of output buffer
+ *
+ * @param[out] outData_len The length in bytes of outData
+ *                         passed as pointer to length value
+ *
+ * @return 0 on success, 1 on error (including if AES-GCM-SIV is not
+ *         supported by the OpenSSL version in use)
+ */
+int aes_gcm_siv_decrypt(unsigned char *key,
+                        size_t key_len,
+                        unsigned char *inData,
+                        size_t inData_len, unsigned char **outData,
+                        size_t * outData_len);
+
+#endif
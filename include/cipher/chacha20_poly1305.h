@@ -0,0 +1,86 @@
+/**
+ * @file chacha20_poly1305.h
+ *
+ * @brief Provides access to OpenSSL's ChaCha20-Poly1305 (RFC 8439)
+ *        implementation for kmyth.
+ */
+#ifndef CHACHA20_POLY1305_H
+#define CHACHA20_POLY1305_H
+
+#include <stdlib.h>
+
+/// Length of the ChaCha20-Poly1305 (Poly1305) tag.
+#define CHACHA20_POLY1305_TAG_LEN 16
+
+/// Length of the ChaCha20-Poly1305 nonce (96 bits, as specified in RFC 8439)
+#define CHACHA20_POLY1305_NONCE_LEN 12
+
+/**
+ * @brief This function uses the ChaCha20-Poly1305 implementation from
+ *        OpenSSL to encrypt data. It does not depend on AES hardware
+ *        support, so it is typically the fastest option on CPUs without
+ *        AES-NI.
+ *
+ * <pre>
+ * The outData block has the form
+ *    nonce||data||tag
+ * where
+ *      the nonce is 12 (CHACHA20_POLY1305_NONCE_LEN) bytes in length and
+ *      the tag is 16 (CHACHA20_POLY1305_TAG_LEN) bytes in length.
+ * </pre>
+ *
+ * @param[in]  key         The hex bytes containing the key -
+ *                         pass in pointer to key buffer
+ *
+ * @param[in]  key_len     The length of the key in bytes (must be 32)
+ *
+ * @param[in]  inData      The plaintext data to be encrypted -
+ *                         pass in pointer to input plaintext data buffer
+ *
+ * @param[in]  inData_len  The length, in bytes, of the plaintext data
+ *
+ * @param[out] outData     The output ciphertext (including the nonce and
+ *                         tag) - pass in pointer to address of ciphertext
+ *                         buffer
+ *
+ * @param[out] outData_len The length in bytes of outData -
+ *                         pass as pointer to length value
+ *
+ * @return 0 on success, 1 on error
+ */
+int chacha20_poly1305_encrypt(unsigned char *key,
+                              size_t key_len,
+                              unsigned char *inData,
+                              size_t inData_len, unsigned char **outData,
+                              size_t * outData_len);
+
+/**
+ * @brief This function uses the ChaCha20-Poly1305 implementation from
+ *        OpenSSL to decrypt data.
+ *
+ * @param[in]  key         The hex bytes containing the key -
+ *                         pass in pointer to key buffer
+ *
+ * @param[in]  key_len     The length of the key in bytes (must be 32)
+ *
+ * @param[in]  inData      The nonce, ciphertext, and tag,
+ *                         formatted nonce||ciphertext||tag -
+ *                         pass in pointer to input values
+ *
+ * @param[in]  inData_len  The length in bytes of inData
+ *
+ * @param[out] outData     The output plaintext -
+ *                         passed as pointer to address of output buffer
+ *
+ * @param[out] outData_len The length in bytes of outData
+ *                         passed as pointer to length value
+ *
+ * @return 0 on success, 1 on error
+ */
+int chacha20_poly1305_decrypt(unsigned char *key,
+                              size_t key_len,
+                              unsigned char *inData,
+                              size_t inData_len, unsigned char **outData,
+                              size_t * outData_len);
+
+#endif
@@ -21,6 +21,9 @@
  * are responsible for explicitly managing that information as part of
  * outData. See the AES/GCM implementation in aes_gcm.c/h for an example.
  *
+ * Decryption functions allocate their (plaintext) outData with
+ * kmyth_secure_alloc(), so callers release it with kmyth_clear_and_free().
+ *
  * @param[in]  key         The hex bytes containing the key -
  *                         pass in pointer to key buffer
  *
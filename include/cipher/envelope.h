@@ -0,0 +1,127 @@
+/**
+ * @file envelope.h
+ *
+ * @brief Provides the host-side portion of Kmyth's envelope (KEK) mode.
+ *
+ * In envelope mode, a single key encryption key (KEK) is TPM-sealed once.
+ * Each protected file then carries a random per-file salt in a lightweight
+ * header, and its data key is derived on the host from the KEK and that salt
+ * (HKDF, RFC 5869). Once the KEK has been unsealed, any number of envelope
+ * files can be encrypted or decrypted without further TPM operations.
+ *
+ * <pre>
+ * An envelope file has the form:
+ *    -----ENVELOPE SALT-----
+ *    base64(salt)
+ *    -----CIPHER SUITE-----
+ *    cipher name
+ *    -----ENC DATA-----
+ *    base64(encrypted data)
+ *    -----ENVELOPE END-----
+ * </pre>
+ */
+#ifndef ENVELOPE_H
+#define ENVELOPE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "cipher/cipher.h"
+
+/// Length, in bytes, of the key encryption key (KEK) created for envelope mode
+#define KMYTH_ENVELOPE_KEK_LEN 32
+
+/// Length, in bytes, of the random per-file salt stored in an envelope header
+#define KMYTH_ENVELOPE_SALT_LEN 32
+
+/// HKDF 'info' (context) prefix - the cipher name is appended to it so that a
+/// derived data key is bound to the cipher it is used with
+#define KMYTH_ENVELOPE_HKDF_INFO "kmyth envelope data key:"
+
+/**
+ * @brief Derives a per-file data key from the KEK and a per-file salt
+ *        using HKDF (RFC 5869) with the Kmyth hash (KMYTH_OPENSSL_HASH).
+ *
+ * @param[in]  kek         The key encryption key (HKDF input keying material)
+ *
+ * @param[in]  kek_len     The length of the KEK in bytes
+ *
+ * @param[in]  salt        The per-file salt
+ *
+ * @param[in]  salt_len    The length of the salt in bytes
+ *
+ * @param[in]  cipher_spec Struct (cipher_t) specifying the cipher the derived
+ *                         key will be used with. Determines the length of
+ *                         the derived key.
+ *
+ * @param[out] key         The derived data key -
+ *                         passed as pointer to address of output buffer
+ *
+ * @param[out] key_len     The length of the derived key in bytes -
+ *                         passed as pointer to length value
+ *
+ * @return 0 on success, 1 on error
+ */
+int derive_envelope_key(unsigned char *kek,
+                        size_t kek_len,
+                        unsigned char *salt,
+                        size_t salt_len,
+                        cipher_t cipher_spec,
+                        unsigned char **key, size_t * key_len);
+
+/**
+ * @brief Encrypts data under a key derived from the KEK and a new random
+ *        salt, and formats the result as an envelope file.
+ *
+ * @param[in]  kek         The key encryption key
+ *
+ * @param[in]  kek_len     The length of the KEK in bytes
+ *
+ * @param[in]  data        The plaintext data to be protected
+ *
+ * @param[in]  data_len    The length of the plaintext data in bytes
+ *
+ * @param[in]  cipher_spec Struct (cipher_t) specifying cipher to use
+ *
+ * @param[out] output      The resulting envelope file bytes -
+ *                         passed as pointer to address of output buffer
+ *
+ * @param[out] output_len  The length of output in bytes -
+ *                         passed as pointer to length value
+ *
+ * @return 0 on success, 1 on error
+ */
+int kmyth_envelope_encrypt(unsigned char *kek,
+                           size_t kek_len,
+                           uint8_t * data,
+                           size_t data_len,
+                           cipher_t cipher_spec,
+                           uint8_t ** output, size_t * output_len);
+
+/**
+ * @brief Parses an envelope file, re-derives its data key from the KEK and
+ *        the stored salt, and decrypts the enclosed data.
+ *
+ * @param[in]  kek         The key encryption key
+ *
+ * @param[in]  kek_len     The length of the KEK in bytes
+ *
+ * @param[in]  input       The envelope file bytes
+ *
+ * @param[in]  input_len   The length of input in bytes
+ *
+ * @param[out] output      The recovered plaintext -
+ *                         passed as pointer to address of output buffer
+ *
+ * @param[out] output_len  The length of output in bytes -
+ *                         passed as pointer to length value
+ *
+ * @return 0 on success, 1 on error
+ */
+int kmyth_envelope_decrypt(unsigned char *kek,
+                           size_t kek_len,
+                           uint8_t * input,
+                           size_t input_len,
+                           uint8_t ** output, size_t * output_len);
+
+#endif
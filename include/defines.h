@@ -60,6 +60,13 @@
  */
 #define KMYTH_APPLOG_PATH "/var/log/kmyth.log"
 
+/**
+ * @brief Environment variable through which kmyth-unseal --exec tells the
+ *        command it runs which (inherited) file descriptor holds the
+ *        sealed memfd containing the unsealed data
+ */
+#define KMYTH_MEMFD_ENV "KMYTH_SECRET_FD"
+
 /**
  * For TPM 2.0 Software Stack (TSS2) library calls where retries might be
  * applicable, we define an upper limit (MAX_RETRIES) to prevent infinite
@@ -308,4 +315,10 @@
  */
 #define KMYTH_GETKEY_RX_BUFFER_SIZE 256
 
+/**
+ * @brief Maximum size (in bytes) of a length-prefixed kmyth-getkey message
+ *        or response (get_framed_key_from_tls_server())
+ */
+#define KMYTH_GETKEY_MAX_FRAME_SIZE (64 * 1024 * 1024)
+
 #endif // DEFINES_H
@@ -3,6 +3,10 @@
  *
  * @brief Provides library headers for Kmyth seal/unseal functionality using
  *        TPM 2.0. Provides library headers for Kmyth logging.
+ *
+ *        Unsealed (plaintext) results are allocated in locked secure memory
+ *        (see kmyth_secure_alloc() in memory_util.h) and must be released
+ *        with kmyth_clear_and_free(), not free().
  */
 
 #ifndef KMYTH_H
@@ -92,6 +96,50 @@ extern "C"
                         uint8_t * auth_bytes, size_t auth_bytes_len,
                         uint8_t * owner_auth_bytes, size_t oa_bytes_len);
 
+/**
+ * @brief High-level function implementing kmyth-unseal of multiple .ski
+ *        inputs using TPM 2.0.
+ *
+ * A single TPM connection and a single policy authorization session are used
+ * to unseal all of the inputs. Between inputs, the session's policy is reset
+ * (TPM2_PolicyRestart) and re-applied, avoiding the creation of a new TPM
+ * session for each input.
+ *
+ * @param[in]  inputs            Array of .ski formatted inputs to be unsealed
+ *
+ * @param[in]  input_lens        Array containing the size, in bytes, of each
+ *                               of the inputs
+ *
+ * @param[in]  input_count       Number of elements in inputs and input_lens
+ *
+ * @param[out] outputs           Array (of at least input_count elements) to
+ *                               hold the unsealed results. On error, no
+ *                               results are returned (all are NULL).
+ *
+ * @param[out] output_lens       Array (of at least input_count elements) to
+ *                               hold the size of each unsealed result
+ *
+ * @param[in]  auth_bytes        Authorization bytes to be applied to the
+ *                               Kmyth TPM objects (i.e, storage key and sealed
+ *                               data) created by kmyth-seal
+ *
+ * @param[in]  auth_bytes_len    Number of bytes in auth_bytes
+ *
+ * @param[in]  owner_auth_bytes  TPM owner (storage) hierarchy password.
+ *                               EmptyAuth by default, but, if it has been
+ *                               changed (e.g., by tpm2_takeownership), user
+ *                               must provide via this parameter.
+ *
+ * @param[in] oa_bytes_len       Number of bytes in owner_auth_bytes
+ *
+ * @return 0 on success, 1 on error
+ */
+  int tpm2_kmyth_unseal_multi(uint8_t ** inputs, size_t * input_lens,
+                              size_t input_count,
+                              uint8_t ** outputs, size_t * output_lens,
+                              uint8_t * auth_bytes, size_t auth_bytes_len,
+                              uint8_t * owner_auth_bytes, size_t oa_bytes_len);
+
 /**
  * @brief High-level function implementing kmyth-seal for files using TPM 2.0.
  *        The kmyth-seal input data is read from the specified file.
@@ -166,6 +214,186 @@ extern "C"
                              uint8_t ** output, size_t * output_length,
                              uint8_t * auth_bytes, size_t auth_bytes_len,
                              uint8_t * owner_auth_bytes, size_t oa_bytes_len);
+
+/**
+ * @brief Creates a new random key encryption key (KEK) for envelope mode
+ *        and kmyth-seals it using TPM 2.0.
+ *
+ * The KEK is the only TPM-sealed object in envelope mode. Data protected
+ * with tpm2_kmyth_envelope_seal() is encrypted under keys derived (on the
+ * host) from this KEK, so any number of envelope files can be processed
+ * with a single TPM unseal of the KEK.
+ *
+ * @param[out] output            The sealed KEK as bytes in .ski format
+ *
+ * @param[out] output_len        The length, in bytes, of output
+ *
+ * @param[in]  auth_bytes        Authorization bytes to be applied to the
+ *                               Kmyth TPM objects (i.e, storage key and sealed
+ *                               wrapping key) created by kmyth-seal
+ *
+ * @param[in]  auth_bytes_len    Number of bytes in auth_bytes
+ *
+ * @param[in]  owner_auth_bytes  TPM owner (storage) hierarchy password.
+ *                               EmptyAuth by default, but, if it has been
+ *                               changed (e.g., by tpm2_takeownership), user
+ *                               must provide via this parameter.
+ *
+ * @param[in]  oa_bytes_len      Number of bytes in owner_auth_bytes
+ *
+ * @param[in]  pcrs              Array containing PCR index selections, if any,
+ *                               to apply to the authorization policy for the
+ *                               sealed KEK
+ *
+ * @param[in]  pcrs_len          The length of pcrs
+ *
+ * @return 0 on success, 1 on error
+ */
+  int tpm2_kmyth_create_kek(uint8_t ** output, size_t * output_len,
+                            uint8_t * auth_bytes, size_t auth_bytes_len,
+                            uint8_t * owner_auth_bytes, size_t oa_bytes_len,
+                            int *pcrs, size_t pcrs_len);
+
+/**
+ * @brief Protects multiple inputs in envelope mode: the sealed KEK is
+ *        unsealed once using TPM 2.0, then each input is encrypted under its
+ *        own data key, derived from the KEK and a random per-input salt.
+ *
+ * @param[in]  kek_ski           The sealed KEK (.ski format), as created by
+ *                               tpm2_kmyth_create_kek()
+ *
+ * @param[in]  kek_ski_len       The length, in bytes, of kek_ski
+ *
+ * @param[in]  inputs            Array of raw inputs to be protected
+ *
+ * @param[in]  input_lens        Array containing the size, in bytes, of each
+ *                               of the inputs
+ *
+ * @param[in]  input_count       Number of elements in inputs and input_lens
+ *
+ * @param[out] outputs           Array (of at least input_count elements) to
+ *                               hold the resulting envelopes. On error, no
+ *                               results are returned (all are NULL).
+ *
+ * @param[out] output_lens       Array (of at least input_count elements) to
+ *                               hold the size of each envelope
+ *
+ * @param[in]  auth_bytes        Authorization bytes applied to the sealed KEK
+ *
+ * @param[in]  auth_bytes_len    Number of bytes in auth_bytes
+ *
+ * @param[in]  owner_auth_bytes  TPM owner (storage) hierarchy password
+ *
+ * @param[in]  oa_bytes_len      Number of bytes in owner_auth_bytes
+ *
+ * @param[in]  cipher_string     String indicating the symmetric cipher to use
+ *                               for encrypting the inputs. Must be NULL
+ *                               or '\0' terminated
+ *
+ * @return 0 on success, 1 on error
+ */
+  int tpm2_kmyth_envelope_seal(uint8_t * kek_ski, size_t kek_ski_len,
+                               uint8_t ** inputs, size_t * input_lens,
+                               size_t input_count,
+                               uint8_t ** outputs, size_t * output_lens,
+                               uint8_t * auth_bytes, size_t auth_bytes_len,
+                               uint8_t * owner_auth_bytes,
+                               size_t oa_bytes_len, char *cipher_string);
+
+/**
+ * @brief Recovers multiple envelope mode inputs: the sealed KEK is unsealed
+ *        once using TPM 2.0, then each envelope is decrypted on the host.
+ *
+ * @param[in]  kek_ski           The sealed KEK (.ski format) the envelopes
+ *                               were created under
+ *
+ * @param[in]  kek_ski_len       The length, in bytes, of kek_ski
+ *
+ * @param[in]  inputs            Array of envelopes to be recovered
+ *
+ * @param[in]  input_lens        Array containing the size, in bytes, of each
+ *                               of the inputs
+ *
+ * @param[in]  input_count       Number of elements in inputs and input_lens
+ *
+ * @param[out] outputs           Array (of at least input_count elements) to
+ *                               hold the recovered plaintexts. On error, no
+ *                               results are returned (all are NULL).
+ *
+ * @param[out] output_lens       Array (of at least input_count elements) to
+ *                               hold the size of each recovered plaintext
+ *
+ * @param[in]  auth_bytes        Authorization bytes applied to the sealed KEK
+ *
+ * @param[in]  auth_bytes_len    Number of bytes in auth_bytes
+ *
+ * @param[in]  owner_auth_bytes  TPM owner (storage) hierarchy password
+ *
+ * @param[in]  oa_bytes_len      Number of bytes in owner_auth_bytes
+ *
+ * @return 0 on success, 1 on error
+ */
+  int tpm2_kmyth_envelope_unseal(uint8_t * kek_ski, size_t kek_ski_len,
+                                 uint8_t ** inputs, size_t * input_lens,
+                                 size_t input_count,
+                                 uint8_t ** outputs, size_t * output_lens,
+                                 uint8_t * auth_bytes, size_t auth_bytes_len,
+                                 uint8_t * owner_auth_bytes,
+                                 size_t oa_bytes_len);
+
+/**
+ * @brief Re-seals the wrapping key of one or more .ski inputs to a new PCR
+ *        selection (e.g., after a firmware or kernel update changes PCR
+ *        values) using TPM 2.0.
+ *
+ * Only the sealed wrapping key is processed: it is unsealed under the policy
+ * recorded in each input and re-sealed under a new storage key (SK) whose
+ * policy uses the new PCR selection. The encrypted data block is copied to
+ * the output without being decrypted. A single TPM connection, policy
+ * session, and new SK are shared by all of the inputs.
+ *
+ * @param[in]  inputs            Array of .ski formatted inputs to be re-sealed
+ *
+ * @param[in]  input_lens        Array containing the size, in bytes, of each
+ *                               of the inputs
+ *
+ * @param[in]  input_count       Number of elements in inputs and input_lens
+ *
+ * @param[out] outputs           Array (of at least input_count elements) to
+ *                               hold the re-sealed .ski results. On error, no
+ *                               results are returned (all are NULL).
+ *
+ * @param[out] output_lens       Array (of at least input_count elements) to
+ *                               hold the size of each re-sealed result
+ *
+ * @param[in]  auth_bytes        Authorization bytes applied to the Kmyth TPM
+ *                               objects (must match the value used when the
+ *                               inputs were sealed, also applied to the new
+ *                               objects)
+ *
+ * @param[in]  auth_bytes_len    Number of bytes in auth_bytes
+ *
+ * @param[in]  owner_auth_bytes  TPM owner (storage) hierarchy password.
+ *                               EmptyAuth by default, but, if it has been
+ *                               changed (e.g., by tpm2_takeownership), user
+ *                               must provide via this parameter.
+ *
+ * @param[in]  oa_bytes_len      Number of bytes in owner_auth_bytes
+ *
+ * @param[in]  pcrs              Array containing the new PCR index
+ *                               selections, if any, to apply to the
+ *                               authorization policy for the re-sealed objects
+ *
+ * @param[in]  pcrs_len          The length of pcrs
+ *
+ * @return 0 on success, 1 on error
+ */
+  int tpm2_kmyth_reseal(uint8_t ** inputs, size_t * input_lens,
+                        size_t input_count,
+                        uint8_t ** outputs, size_t * output_lens,
+                        uint8_t * auth_bytes, size_t auth_bytes_len,
+                        uint8_t * owner_auth_bytes, size_t oa_bytes_len,
+                        int *pcrs, size_t pcrs_len);
 #ifdef __cplusplus
 }
 #endif
@@ -7,9 +7,47 @@
 #ifndef SOCKET_UTIL_H
 #define SOCKET_UTIL_H
 
+#include <stddef.h>
+#include <netdb.h>
+#include <sys/uio.h>
+
+/**
+ * @brief Maximum number of buffers that send_socket_frame() gathers into
+ *        one logical message.
+ */
+#define SOCKET_FRAME_MAX_IOV 8
+
+/**
+ * @brief Delay (in milliseconds) before setup_client_socket() starts a
+ *        connection attempt to the next address while earlier attempts are
+ *        still outstanding (the RFC 8305 "Connection Attempt Delay").
+ */
+#ifndef SOCKET_CONNECT_ATTEMPT_DELAY_MS
+#define SOCKET_CONNECT_ATTEMPT_DELAY_MS 250
+#endif
+
+/**
+ * @brief Overall time limit (in milliseconds) for setup_client_socket() to
+ *        establish a connection to any of the addresses of the target.
+ */
+#ifndef SOCKET_CONNECT_TIMEOUT_MS
+#define SOCKET_CONNECT_TIMEOUT_MS 10000
+#endif
+
+/**
+ * @brief Maximum number of resolved addresses connect_client_socket() will
+ *        try; any further addresses are ignored.
+ */
+#define SOCKET_CONNECT_MAX_ADDRS 16
+
 /**
  * <pre>
  * This function sets up a client socket for sending messages.
+ *
+ * The target is resolved to all of its IPv4 and IPv6 addresses, which are
+ * then raced with connect_client_socket() using SOCKET_CONNECT_ATTEMPT_DELAY_MS
+ * and SOCKET_CONNECT_TIMEOUT_MS, so an unreachable address does not hold up
+ * the connection for the kernel's SYN timeout.
  * </pre>
  *
  * @param[in]  node       The IP address or hostname to connect to.
@@ -22,6 +60,38 @@
  */
 int setup_client_socket(const char *node, const char *service, int *socket_fd);
 
+/**
+ * <pre>
+ * This function connects a TCP client socket to the first of a list of
+ * addresses to answer, in the style of RFC 8305 ("Happy Eyeballs"):
+ *
+ *   - the addresses are reordered to alternate between address families,
+ *     starting with the family of the first address in the list;
+ *   - a non-blocking connection attempt is started to the first address,
+ *     and to each following address when attempt_delay_ms passes without
+ *     a connection, or as soon as an outstanding attempt fails;
+ *   - the first attempt to complete wins, and all others are abandoned;
+ *   - if no attempt completes within timeout_ms, the function fails.
+ *
+ * The winning socket is returned in blocking mode, with TCP_NODELAY set.
+ * </pre>
+ *
+ * @param[in]  addrs             The candidate addresses, in order of
+ *                               preference (e.g., from getaddrinfo()).
+ *
+ * @param[in]  attempt_delay_ms  Delay (in milliseconds) between starting
+ *                               successive connection attempts.
+ *
+ * @param[in]  timeout_ms        Overall time limit (in milliseconds).
+ *
+ * @param[out] socket_fd         The new socket file descriptor.
+ *
+ * @return 0 on success, 1 on error
+ */
+int connect_client_socket(const struct addrinfo *addrs,
+                          int attempt_delay_ms, int timeout_ms,
+                          int *socket_fd);
+
 /**
  * <pre>
  * This function sets up a server socket for receiving connections.
@@ -35,4 +105,143 @@ int setup_client_socket(const char *node, const char *service, int *socket_fd);
  */
 int setup_server_socket(const char *service, int *socket_fd);
 
+/**
+ * <pre>
+ * This function sets up a server socket for receiving connections on a
+ * single local address (e.g., "127.0.0.1" to accept only loopback
+ * connections).
+ * </pre>
+ *
+ * @param[in]  node       The local IP address to bind to (NULL for all
+ *                        local addresses).
+ *
+ * @param[in]  service    The port number to bind to ("0" for any free port).
+ *
+ * @param[out] socket_fd  The new socket file descriptor.
+ *
+ * @return 0 on success, 1 on error
+ */
+int setup_server_socket_on(const char *node, const char *service,
+                           int *socket_fd);
+
+/**
+ * <pre>
+ * This function sets up a Unix domain (stream) server socket, bound to a
+ * filesystem path and listening for connections. Any socket file already
+ * at the path is replaced. The socket file is only accessible to its owner
+ * (mode 0600).
+ * </pre>
+ *
+ * @param[in]  path       The filesystem path to bind to.
+ *
+ * @param[out] socket_fd  The new socket file descriptor.
+ *
+ * @return 0 on success, 1 on error
+ */
+int setup_unix_server_socket(const char *path, int *socket_fd);
+
+/**
+ * <pre>
+ * This function sets up a Unix domain (stream) client socket connected to
+ * the server socket bound to a filesystem path.
+ * </pre>
+ *
+ * @param[in]  path       The filesystem path of the server socket.
+ *
+ * @param[out] socket_fd  The new socket file descriptor.
+ *
+ * @return 0 on success, 1 on error
+ */
+int setup_unix_client_socket(const char *path, int *socket_fd);
+
+/**
+ * <pre>
+ * This function passes an open file descriptor to the peer of a connected
+ * Unix domain socket (SCM_RIGHTS). The peer receives its own descriptor
+ * for the same open file; the caller may close its copy afterwards.
+ * </pre>
+ *
+ * @param[in]  socket_fd  The connected Unix domain socket.
+ *
+ * @param[in]  fd         The file descriptor to pass.
+ *
+ * @return 0 on success, 1 on error
+ */
+int send_socket_fd(int socket_fd, int fd);
+
+/**
+ * <pre>
+ * This function receives a file descriptor passed (SCM_RIGHTS) by the peer
+ * of a connected Unix domain socket with send_socket_fd(). The received
+ * descriptor is close-on-exec.
+ * </pre>
+ *
+ * @param[in]  socket_fd  The connected Unix domain socket.
+ *
+ * @param[out] fd         The received file descriptor.
+ *
+ * @return 0 on success, 1 on error
+ */
+int recv_socket_fd(int socket_fd, int *fd);
+
+/**
+ * <pre>
+ * This function sends one logical message, gathered from several buffers
+ * (e.g., a length prefix followed by its payload), with as few system calls
+ * as possible: all of the buffers are handed to the kernel at once, so a
+ * small header and its payload leave in the same TCP segment instead of
+ * two. Partial writes and interrupted calls are retried until every byte
+ * has been sent.
+ * </pre>
+ *
+ * @param[in]  socket_fd  The connected socket.
+ *
+ * @param[in]  iov        The buffers to send, in order (not modified).
+ *
+ * @param[in]  iovcnt     Number of buffers (at most SOCKET_FRAME_MAX_IOV).
+ *
+ * @return 0 on success, 1 on error
+ */
+int send_socket_frame(int socket_fd, const struct iovec *iov, int iovcnt);
+
+/**
+ * <pre>
+ * This function receives exactly len bytes from a connected socket,
+ * retrying short reads (a message may arrive split across several
+ * segments) and interrupted calls. The peer closing the connection before
+ * len bytes have arrived is an error (logged only at debug level when no
+ * byte has arrived, as a peer closes between messages).
+ * </pre>
+ *
+ * @param[in]  socket_fd  The connected socket.
+ *
+ * @param[out] buf        Buffer of (at least) len bytes to fill.
+ *
+ * @param[in]  len        Number of bytes to receive.
+ *
+ * @return 0 on success, 1 on error
+ */
+int recv_socket_exact(int socket_fd, void *buf, size_t len);
+
+/**
+ * <pre>
+ * This function configures the latency-related options of a connected TCP
+ * socket. TCP_NODELAY disables Nagle's algorithm, so a small message is
+ * sent at once rather than held back until the previous one is
+ * acknowledged. TCP_QUICKACK (Linux only, ignored elsewhere) acknowledges
+ * received data at once rather than delaying the ACK; the kernel may leave
+ * quick-ACK mode on its own, so callers that want it throughout a
+ * conversation set it again before each receive.
+ * </pre>
+ *
+ * @param[in]  socket_fd  The connected TCP socket.
+ *
+ * @param[in]  nodelay    Non-zero to set TCP_NODELAY, zero to clear it.
+ *
+ * @param[in]  quickack   Non-zero to set TCP_QUICKACK, zero to clear it.
+ *
+ * @return 0 on success, 1 on error
+ */
+int set_socket_tcp_options(int socket_fd, int nodelay, int quickack);
+
 #endif
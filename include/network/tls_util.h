@@ -9,6 +9,7 @@
 
 /* // OpenSSL libraries for TLS connection */
 #include <openssl/bio.h>
+#include <openssl/ssl.h>
 
 /**
  * <pre>
@@ -47,6 +48,76 @@ int create_tls_connection(char **server_ip,
                           char *client_cert_path, char *ca_cert_path,
                           BIO ** tls_bio, SSL_CTX ** tls_ctx);
 
+/**
+ * <pre>
+ * This function creates a mutually authenticated TLS connection, offering
+ * the server a previous session for resumption (abbreviated handshake), and
+ * provides it back to the caller. If the server does not resume the session
+ * a full handshake is performed.
+ *</pre>
+ *
+ * @param[in]  server_ip               IP address and port of the server
+ *                                     (ip_address:port)
+ *
+ * @param[in]  client_private_key      client's private key
+ *
+ * @param[in]  client_private_key_len  length (in bytes) of client_private_key
+ *
+ * @param[in]  client_cert_path        path to the client's certificate
+ *
+ * @param[in]  ca_cert_path            path to the certificate for the
+ *                                     Certificate Authority (CA) that
+ *                                     issued the server certificate
+ *
+ * @param[in]  session                 the session to resume (e.g., from
+ *                                     tls_read_session()), may be NULL
+ *
+ * @param[out] tls_bio                 BIO containing the TLS connection
+ *
+ * @param[out] tls_ctx                 SSL_CTX containing TLS context info
+ *
+ * @return 0 on success, 1 on error
+ */
+int create_tls_connection_with_session(char **server_ip,
+                                       unsigned char *client_private_key,
+                                       size_t client_private_key_len,
+                                       char *client_cert_path,
+                                       char *ca_cert_path,
+                                       SSL_SESSION * session,
+                                       BIO ** tls_bio, SSL_CTX ** tls_ctx);
+
+/**
+ * <pre>
+ * This function reads a TLS session (ticket) cached by tls_write_session().
+ * A missing or expired cache file is not an error: no session is returned.
+ * </pre>
+ *
+ * @param[in]  session_path  path to the session cache file
+ *
+ * @param[out] session       the cached session (caller frees with
+ *                           SSL_SESSION_free()), or NULL if there is none
+ *
+ * @return 0 on success, 1 on error
+ */
+int tls_read_session(char *session_path, SSL_SESSION ** session);
+
+/**
+ * <pre>
+ * This function caches the current session of a TLS connection in a file
+ * (PEM, readable only by its owner), so that a later connection can resume
+ * it. With TLS 1.3 the server sends session tickets after the handshake,
+ * so call this after exchanging data over the connection.
+ * </pre>
+ *
+ * @param[in]  tls_bio       BIO containing the TLS connection
+ *
+ * @param[in]  session_path  path to the session cache file
+ *
+ * @return 0 on success (including when the server offered no resumable
+ *         session), 1 on error
+ */
+int tls_write_session(BIO * tls_bio, char *session_path);
+
 /**
  * <pre>
  * This function populates an SSL_CTX* structure with necessary data to 
@@ -85,6 +156,24 @@ int tls_set_context(unsigned char *client_private_key,
  */
 int tls_cleanup(void);
 
+/**
+ * <pre>
+ * This function reads exactly len bytes from a TLS connection, across as
+ * many TLS records (and BIO_read() calls) as needed. The connection closing
+ * or failing before len bytes have arrived is an error.
+ * </pre>
+ *
+ * @param[in]  bio             OpenSSL BIO structure with the connection
+ *                             already instantiated (e.g., an SSL BIO)
+ *
+ * @param[out] buf             Buffer of (at least) len bytes to fill
+ *
+ * @param[in]  len             Number of bytes to read
+ *
+ * @return 0 if success, 1 if error
+ */
+int tls_read_exact(BIO * bio, unsigned char *buf, size_t len);
+
 /**
  * <pre>
  * This function takes an existing TLS connection (in the form of OpenSSL BIO and SSL_CTX 
@@ -111,6 +200,36 @@ int get_key_from_tls_server(BIO * bio,
                             char *message, size_t message_length,
                             unsigned char **key, size_t * key_size);
 
+/**
+ * <pre>
+ * This function is the length-prefixed (framed) variant of
+ * get_key_from_tls_server(). The message is sent after its length, and the
+ * response is expected to start with its own length: in both directions,
+ * a 4-byte big-endian byte count precedes the data. Exactly the announced
+ * number of bytes is read, across as many TLS records as needed, so a
+ * response (e.g., a key bundle) may be as large as
+ * KMYTH_GETKEY_MAX_FRAME_SIZE.
+ * </pre>
+ *
+ * @param[in]  bio             OpenSSL BIO structure with the connection
+ *                             already instantiated
+ *
+ * @param[in]  message         optional message to send the server, can be null
+ *
+ * @param[in]  message_length  length of the message (0 if no message is given)
+ *
+ * @param[out] key             the response from the server, in a buffer of
+ *                             exactly key_size bytes (release with
+ *                             kmyth_clear_and_free())
+ *
+ * @param[out] key_size        size of the response
+ *
+ * @return 0 if success, 1 if error
+ */
+int get_framed_key_from_tls_server(BIO * bio,
+                                   char *message, size_t message_length,
+                                   unsigned char **key, size_t * key_size);
+
 /**
  * <pre>
  * This function takes an existing TLS connection (in the form of OpenSSL BIO and SSL_CTX
@@ -133,4 +252,29 @@ int get_key_from_tls_server(BIO * bio,
 int get_key_from_kmip_server(BIO * bio,
                              char *message, size_t message_length,
                              unsigned char **key, size_t * key_size);
+
+/**
+ * <pre>
+ * This function takes an existing TLS connection to a KMIP server and
+ * retrieves a set of symmetric keys in one round trip: a single request
+ * message carrying one Get batch item per key ID.
+ * </pre>
+ *
+ * @param[in]  bio             OpenSSL BIO structure with the connection
+ *                             already instantiated
+ *
+ * @param[in]  key_ids         the (NUL-terminated) key IDs to retrieve
+ *
+ * @param[in]  key_count       number of key IDs
+ *
+ * @param[out] keys            the retrieved keys, keys[i] for key_ids[i]
+ *                             (release each with kmyth_clear_and_free())
+ *
+ * @param[out] key_sizes       sizes of the retrieved keys
+ *
+ * @return 0 if success, 1 if error
+ */
+int get_keys_from_kmip_server(BIO * bio,
+                              char **key_ids, size_t key_count,
+                              unsigned char **keys, size_t *key_sizes);
 #endif
@@ -0,0 +1,217 @@
+/**
+ * @file agent_util.h
+ *
+ * @brief Message formats and client functions for the kmyth-agent protocol.
+ *
+ * kmyth-agent serves unsealed .ski contents to local processes over a Unix
+ * domain socket. Every message (request or response) is framed as
+ *
+ * <pre>
+ *    version (1 byte) || type (1 byte) || payload length (4 bytes, BE)
+ *    || payload
+ * </pre>
+ *
+ * where the type of a request is the operation (KMYTH_AGENT_OP_*) and the
+ * type of a response is its status (KMYTH_AGENT_STATUS_*). A connection may
+ * carry any number of request/response exchanges.
+ */
+
+#ifndef KMYTH_AGENT_UTIL_H
+#define KMYTH_AGENT_UTIL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/// Environment variable naming the agent's socket path
+#define KMYTH_AGENT_SOCK_ENV "KMYTH_AGENT_SOCK"
+
+/// Protocol version carried in every message header
+#define KMYTH_AGENT_PROTOCOL_VERSION 1
+
+/// Length of the message header (version, type, payload length)
+#define KMYTH_AGENT_HEADER_LEN 6
+
+/// Largest payload accepted in a message (bounds peer-driven allocations)
+#define KMYTH_AGENT_MAX_PAYLOAD_LEN (64 * 1024 * 1024)
+
+/**
+ * @brief Request: unseal a .ski (or return its cached contents).
+ *
+ * Payload: TTL in seconds (4 bytes, BE, 0 requests the agent default)
+ *          || authorization string length (4 bytes, BE)
+ *          || authorization string || .ski contents
+ *
+ * Response payload (KMYTH_AGENT_STATUS_OK): the unsealed data
+ */
+#define KMYTH_AGENT_OP_UNSEAL 1
+
+/**
+ * @brief Request: remove every cached entry (empty payload, empty response)
+ */
+#define KMYTH_AGENT_OP_FLUSH 2
+
+/// Response status: request completed
+#define KMYTH_AGENT_STATUS_OK 0
+
+/// Response status: request could not be completed (e.g., unseal failed)
+#define KMYTH_AGENT_STATUS_ERROR 1
+
+/// Response status: peer is not permitted to use the agent
+#define KMYTH_AGENT_STATUS_DENIED 2
+
+/// Response status: malformed or unsupported request
+#define KMYTH_AGENT_STATUS_BAD_REQUEST 3
+
+/**
+ * <pre>
+ * This function writes one framed message to a socket.
+ * </pre>
+ *
+ * @param[in]  socket_fd    the connected socket
+ *
+ * @param[in]  type         the message type (operation or status)
+ *
+ * @param[in]  payload      the message payload (may be NULL if payload_len
+ *                          is zero)
+ *
+ * @param[in]  payload_len  length (in bytes) of the payload
+ *
+ * @return 0 on success, 1 on error
+ */
+int send_agent_message(int socket_fd, uint8_t type,
+                       uint8_t * payload, size_t payload_len);
+
+/**
+ * <pre>
+ * This function reads one framed message from a socket.
+ * </pre>
+ *
+ * @param[in]  socket_fd    the connected socket
+ *
+ * @param[out] type         the message type (operation or status)
+ *
+ * @param[out] payload      the message payload (allocated with
+ *                          kmyth_secure_alloc(), caller frees with
+ *                          kmyth_clear_and_free(); NULL when the payload
+ *                          is empty)
+ *
+ * @param[out] payload_len  length (in bytes) of the payload
+ *
+ * @return 0 on success, 1 on error (including the peer closing the
+ *         connection before a complete message was read)
+ */
+int recv_agent_message(int socket_fd, uint8_t * type,
+                       uint8_t ** payload, size_t *payload_len);
+
+/**
+ * <pre>
+ * This function builds the payload of a KMYTH_AGENT_OP_UNSEAL request.
+ * </pre>
+ *
+ * @param[in]  ski          the .ski contents to be unsealed
+ *
+ * @param[in]  ski_len      length (in bytes) of the .ski contents
+ *
+ * @param[in]  auth         the authorization string (may be NULL)
+ *
+ * @param[in]  auth_len     length (in bytes) of the authorization string
+ *
+ * @param[in]  ttl          requested cache lifetime, in seconds (0 for the
+ *                          agent default)
+ *
+ * @param[out] request      the request payload (allocated, caller frees)
+ *
+ * @param[out] request_len  length (in bytes) of the request payload
+ *
+ * @return 0 on success, 1 on error
+ */
+int build_agent_unseal_request(uint8_t * ski, size_t ski_len,
+                               uint8_t * auth, size_t auth_len,
+                               uint32_t ttl,
+                               uint8_t ** request, size_t *request_len);
+
+/**
+ * <pre>
+ * This function parses the payload of a KMYTH_AGENT_OP_UNSEAL request.
+ * The returned .ski and authorization pointers refer into the request
+ * buffer (nothing is copied).
+ * </pre>
+ *
+ * @param[in]  request      the request payload
+ *
+ * @param[in]  request_len  length (in bytes) of the request payload
+ *
+ * @param[out] ski          the .ski contents
+ *
+ * @param[out] ski_len      length (in bytes) of the .ski contents
+ *
+ * @param[out] auth         the authorization string (NULL if empty)
+ *
+ * @param[out] auth_len     length (in bytes) of the authorization string
+ *
+ * @param[out] ttl          requested cache lifetime, in seconds
+ *
+ * @return 0 on success, 1 on error
+ */
+int parse_agent_unseal_request(uint8_t * request, size_t request_len,
+                               uint8_t ** ski, size_t *ski_len,
+                               uint8_t ** auth, size_t *auth_len,
+                               uint32_t * ttl);
+
+/**
+ * <pre>
+ * This function returns the agent socket path from the environment
+ * (KMYTH_AGENT_SOCK_ENV), or NULL if it is not set.
+ * </pre>
+ *
+ * @return the socket path, or NULL
+ */
+const char *get_agent_socket_path(void);
+
+/**
+ * <pre>
+ * This function asks a running kmyth-agent for the unsealed contents of a
+ * .ski. The agent unseals it with the TPM on the first request and serves
+ * later requests for the same .ski (and authorization string) from its
+ * cache until the entry expires.
+ * </pre>
+ *
+ * @param[in]  socket_path  the agent socket (NULL to use the environment)
+ *
+ * @param[in]  ski          the .ski contents to be unsealed
+ *
+ * @param[in]  ski_len      length (in bytes) of the .ski contents
+ *
+ * @param[in]  auth         the authorization string (may be NULL)
+ *
+ * @param[in]  auth_len     length (in bytes) of the authorization string
+ *
+ * @param[in]  ttl          requested cache lifetime, in seconds (0 for the
+ *                          agent default)
+ *
+ * @param[out] output       the unsealed data (allocated with
+ *                          kmyth_secure_alloc(), caller frees with
+ *                          kmyth_clear_and_free())
+ *
+ * @param[out] output_len   length (in bytes) of the unsealed data
+ *
+ * @return 0 on success, 1 on error
+ */
+int kmyth_agent_unseal(const char *socket_path,
+                       uint8_t * ski, size_t ski_len,
+                       uint8_t * auth, size_t auth_len, uint32_t ttl,
+                       uint8_t ** output, size_t *output_len);
+
+/**
+ * <pre>
+ * This function asks a running kmyth-agent to clear and remove every
+ * cached entry.
+ * </pre>
+ *
+ * @param[in]  socket_path  the agent socket (NULL to use the environment)
+ *
+ * @return 0 on success, 1 on error
+ */
+int kmyth_agent_flush(const char *socket_path);
+
+#endif
@@ -7,6 +7,21 @@
 #ifndef KMYTH_KMIP_UTIL_H
 #define KMYTH_KMIP_UTIL_H
 
+/**
+ * @brief Initial size (in bytes) of a KMIP encoding buffer
+ */
+#define KMIP_ENCODING_BLOCK_SIZE 1024
+
+/**
+ * @brief Size (in bytes) beyond which a KMIP encoding buffer is not grown
+ */
+#define KMIP_ENCODING_MAX_SIZE (16 * 1024 * 1024)
+
+/**
+ * @brief Maximum number of batch items in a KMIP message
+ */
+#define KMIP_MAX_BATCH_COUNT 4096
+
 /**
  * <pre>
  * This function builds a basic KMIP Get request message.
@@ -49,6 +64,67 @@ int parse_kmip_get_request(KMIP * ctx,
                            unsigned char *request, size_t request_len,
                            unsigned char **id, size_t *id_len);
 
+/**
+ * <pre>
+ * This function builds a KMIP request message with one Get batch item
+ * per ID. With more than one ID, batch item i is identified by i (a 4-byte
+ * big-endian unique batch item ID).
+ *
+ * The message is encoded into a caller-owned buffer that is allocated
+ * (or grown) as needed, so the same buffer can be reused for a series of
+ * messages. Release it with kmyth_clear_and_free(*buffer, *buffer_size).
+ * </pre>
+ *
+ * @param[in]     ctx          the KMIP context used to build the message
+ *
+ * @param[in]     ids          the IDs of the KMIP objects to retrieve
+ *
+ * @param[in]     id_lens      lengths (in bytes) of the IDs
+ *
+ * @param[in]     id_count     number of IDs (1 to KMIP_MAX_BATCH_COUNT)
+ *
+ * @param[in/out] buffer       the encoding buffer (NULL to allocate one),
+ *                             holding the request message on return
+ *
+ * @param[in/out] buffer_size  size (in bytes) of the encoding buffer
+ *
+ * @param[out]    request_len  length (in bytes) of the request message
+ *
+ * @return 0 on success, 1 on error
+ */
+int build_kmip_get_batch_request(KMIP * ctx,
+                                 unsigned char **ids, size_t *id_lens,
+                                 size_t id_count,
+                                 unsigned char **buffer, size_t *buffer_size,
+                                 size_t *request_len);
+
+/**
+ * <pre>
+ * This function parses a KMIP request message made of one or more Get
+ * batch items. The IDs are returned in batch item order, each
+ * NUL-terminated (not counted in its length).
+ * </pre>
+ *
+ * @param[in]  ctx          the KMIP context used to parse the message
+ *
+ * @param[in]  request      the KMIP Get request message
+ *
+ * @param[in]  request_len  length (in bytes) of the request message
+ *
+ * @param[out] ids          the IDs of the KMIP objects to retrieve (the
+ *                          caller frees each ID and the list)
+ *
+ * @param[out] id_lens      lengths (in bytes) of the IDs (caller frees)
+ *
+ * @param[out] id_count     number of IDs
+ *
+ * @return 0 on success, 1 on error
+ */
+int parse_kmip_get_batch_request(KMIP * ctx,
+                                 unsigned char *request, size_t request_len,
+                                 unsigned char ***ids, size_t **id_lens,
+                                 size_t *id_count);
+
 /**
  * <pre>
  * This function builds a KMIP Get response message.
@@ -75,6 +151,44 @@ int build_kmip_get_response(KMIP * ctx,
                             unsigned char *key, size_t key_len,
                             unsigned char **response, size_t *response_len);
 
+/**
+ * <pre>
+ * This function builds a KMIP response message with one Get batch item
+ * per ID, in the order of the (batch) request. A NULL key is reported as
+ * a failed item (Item Not Found).
+ *
+ * The encoding buffer is managed as by build_kmip_get_batch_request().
+ * It holds key material, so release it with kmyth_clear_and_free().
+ * </pre>
+ *
+ * @param[in]     ctx           the KMIP context used to build the message
+ *
+ * @param[in]     ids           the key IDs
+ *
+ * @param[in]     id_lens       lengths (in bytes) of the key IDs
+ *
+ * @param[in]     keys          the symmetric keys (NULL if not found)
+ *
+ * @param[in]     key_lens      lengths (in bytes) of the keys
+ *
+ * @param[in]     id_count      number of IDs (1 to KMIP_MAX_BATCH_COUNT)
+ *
+ * @param[in/out] buffer        the encoding buffer (NULL to allocate one),
+ *                              holding the response message on return
+ *
+ * @param[in/out] buffer_size   size (in bytes) of the encoding buffer
+ *
+ * @param[out]    response_len  length (in bytes) of the response message
+ *
+ * @return 0 on success, 1 on error
+ */
+int build_kmip_get_batch_response(KMIP * ctx,
+                                  unsigned char **ids, size_t *id_lens,
+                                  unsigned char **keys, size_t *key_lens,
+                                  size_t id_count,
+                                  unsigned char **buffer, size_t *buffer_size,
+                                  size_t *response_len);
+
 /**
  * <pre>
  * This function parses a KMIP Get response message.
@@ -101,4 +215,37 @@ int parse_kmip_get_response(KMIP * ctx,
                             unsigned char **id, size_t *id_len,
                             unsigned char **key, size_t *key_len);
 
+/**
+ * <pre>
+ * This function parses a KMIP response message to a batch Get request and
+ * maps each key back to its requested ID (by unique batch item ID when the
+ * server provides one, otherwise by position). Every Get must succeed.
+ * </pre>
+ *
+ * @param[in]  ctx           the KMIP context used to parse the message
+ *
+ * @param[in]  response      the KMIP Get response message
+ *
+ * @param[in]  response_len  length (in bytes) of the response message
+ *
+ * @param[in]  ids           the requested key IDs
+ *
+ * @param[in]  id_lens       lengths (in bytes) of the requested key IDs
+ *
+ * @param[in]  id_count      number of requested key IDs
+ *
+ * @param[out] keys          the retrieved keys, keys[i] for ids[i] (caller
+ *                           releases each with kmyth_clear_and_free())
+ *
+ * @param[out] key_lens      lengths (in bytes) of the retrieved keys
+ *
+ * @return 0 on success, 1 on error
+ */
+int parse_kmip_get_batch_response(KMIP * ctx,
+                                  unsigned char *response,
+                                  size_t response_len,
+                                  unsigned char **ids, size_t *id_lens,
+                                  size_t id_count,
+                                  unsigned char **keys, size_t *key_lens);
+
 #endif
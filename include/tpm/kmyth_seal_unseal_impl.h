@@ -15,6 +15,8 @@
 
 #include <tss2/tss2_sys.h>
 
+#include "tpm2_interface.h"
+
 /**
  * @brief Seal data using TPM 2.0.
  *
@@ -122,4 +124,58 @@ int tpm2_kmyth_unseal_data(TSS2_SYS_CONTEXT * sapi_ctx,
                            TPM2B_DIGEST authPolicy,
                            uint8_t ** result, size_t * result_size);
 
+/**
+ * @brief Unseal data using TPM 2.0, authorizing the required TPM commands
+ *        with a caller-supplied (already started) policy session.
+ *
+ * This allows one policy session to be re-used to unseal multiple objects.
+ * The session must either be newly started or have had its policy digest
+ * reset (see restart_policy_auth_session()) since it was last used. The
+ * session is not flushed by this function. The sealed data object is
+ * flushed from the TPM once it has been unsealed.
+ *
+ * @param[in]  sapi_ctx           System API (SAPI) context, must be
+ *                                initialized and passed in as a pointer to
+ *                                the SAPI context
+ *
+ * @param[in]  unsealData_session Pointer to the policy session used to
+ *                                authorize loading and unsealing the
+ *                                sealed data object
+ *
+ * @param[in]  sk_handle          The handle for the storage key that was used
+ *                                to encrypt the data
+ *
+ * @param[in]  sdo_public         The public portion of the sealed data object
+ *
+ * @param[in]  sdo_private        The private portion of the sealed data object
+ *
+ * @param[in]  authVal            Authorization value required to load and
+ *                                then unseal the input 'data' blob
+ *
+ * @param[in]  pcrList            PCR Selection structure indicating which PCR
+ *                                values must be included to authorize loading
+ *                                and unsealing the input 'data' blob
+ *
+ * @param[in]  authPolicy         Authorization policy digest used to authorize
+ *                                loading and unsealing the input 'data' blob
+ *
+ * @param[out] result             The kmyth-unsealed result
+ *                                (passed as pointer to byte buffer)
+ *
+ * @param[out] result_size        The size of the kmyth-unsealed result
+ *                                (passed as pointer to size value)
+ *
+ * @return 0 on success, 1 on error
+ */
+int tpm2_kmyth_unseal_data_with_session(TSS2_SYS_CONTEXT * sapi_ctx,
+                                        SESSION * unsealData_session,
+                                        TPM2_HANDLE sk_handle,
+                                        TPM2B_PUBLIC sdo_public,
+                                        TPM2B_PRIVATE sdo_private,
+                                        TPM2B_AUTH authVal,
+                                        TPML_PCR_SELECTION pcrList,
+                                        TPM2B_DIGEST authPolicy,
+                                        uint8_t ** result,
+                                        size_t * result_size);
+
 #endif /* KMYTH_SEAL_UNSEAL_IMPL_H */
@@ -79,11 +79,34 @@ typedef struct
 
 } SESSION;
 
+/**
+ * @brief Waits for, and takes, this thread's turn to use the TPM.
+ *
+ * Threads are granted the TPM in the order they call this function, so
+ * TPM commands from concurrent library calls are serialized fairly while
+ * host-side work (parsing, encoding, symmetric crypto) runs in parallel.
+ * init_tpm2_connection() calls this, and free_tpm2_resources() releases it,
+ * so most callers do not need to use it directly. A thread that already
+ * holds the TPM may acquire it again (each acquire needs a release).
+ */
+void acquire_tpm_queue(void);
+
+/**
+ * @brief Releases the TPM acquired by acquire_tpm_queue(), handing it to
+ *        the next waiting thread. Has no effect if the calling thread does
+ *        not hold the TPM.
+ */
+void release_tpm_queue(void);
+
 /**
  * @brief Initializes TPM 2.0 connection to resource manager. 
  *
  * Will error if resource manager is not running. 
  *
+ * Waits for the calling thread's turn to use the TPM (see
+ * acquire_tpm_queue()), which is held until free_tpm2_resources() is
+ * called for the returned context.
+ *
  * @param[out] sapi_ctx  System API context, must be initialized to NULL
  *
  * @return 0 if success, 1 if error
@@ -115,7 +138,8 @@ int init_tcti_abrmd(TSS2_TCTI_CONTEXT ** tcti_ctx);
 int init_sapi(TSS2_SYS_CONTEXT ** sapi_ctx, TSS2_TCTI_CONTEXT * tcti_ctx);
 
 /**
- * @brief Free any TPM 2.0 resources that have been allocated.
+ * @brief Free any TPM 2.0 resources that have been allocated, and release
+ *        the calling thread's turn to use the TPM.
  *
  * @param[in]  sapi_ctx  System API context, must be initialized (non-NULL)
  *
@@ -532,6 +556,27 @@ int apply_policy(TSS2_SYS_CONTEXT * sapi_ctx,
                  TPM2_HANDLE policySessionHandle,
                  TPML_PCR_SELECTION policySession_pcrList);
 
+/**
+ * @brief Resets the policy digest of an active policy session
+ *        (TPM2_PolicyRestart) so that the session can be re-used to
+ *        authorize another object without starting a new session.
+ *
+ * The session nonce state is left intact - the nonces continue to be rolled
+ * for each command authorized using the session (see init_policy_cmd_auth()
+ * and check_response_auth()). The caller must re-apply the policy (see
+ * apply_policy()) before the session is next used for authorization.
+ *
+ * @param[in]  sapi_ctx      System API (SAPI) context, must be initialized
+ *                           and passed in as pointer to the SAPI context
+ *
+ * @param[in]  policySession Pointer to the parameters structure for the
+ *                           (previously started) policy session to restart
+ *
+ * @return 0 if success, 1 if error.
+ */
+int restart_policy_auth_session(TSS2_SYS_CONTEXT * sapi_ctx,
+                                SESSION * policySession);
+
 /**
  * @brief Creates a random initial nonce value that the caller can send to the
  *        TPM to provide some protection against replay of TPM commands
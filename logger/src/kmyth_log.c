@@ -6,6 +6,7 @@
 
 #include "kmyth_log.h"
 
+#include <pthread.h>
 #include <stdarg.h>
 #include <stdbool.h>
 #include <stdio.h>
@@ -15,6 +16,14 @@
 #include <time.h>
 
 
+// log_settings may be changed by the set_*() functions while other threads
+// are logging, so it is only accessed while holding log_settings_mutex
+static pthread_mutex_t log_settings_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// serializes output so that concurrent messages are not interleaved (and
+// the process-global openlog()/setlogmask() state is not shared mid-message)
+static pthread_mutex_t log_output_mutex = PTHREAD_MUTEX_INITIALIZER;
+
 static struct log_params log_settings = {
   .app_name = DEFAULT_APP_NAME,
   .app_name_len = strlen(DEFAULT_APP_NAME),
@@ -34,6 +43,8 @@ static struct log_params log_settings = {
 //############################################################################
 void set_app_name(const char *new_app_name)
 {
+  pthread_mutex_lock(&log_settings_mutex);
+
   bool truncated = false;
   size_t temp_len = 0;
 
@@ -60,6 +71,8 @@ void set_app_name(const char *new_app_name)
     fprintf(stderr, "set_app_name(): input \"%s\" ", new_app_name);
     fprintf(stderr, "truncated to \"%s\"\n", log_settings.app_name);
   }
+
+  pthread_mutex_unlock(&log_settings_mutex);
 }
 
 //############################################################################
@@ -67,6 +80,8 @@ void set_app_name(const char *new_app_name)
 //############################################################################
 void set_app_version(const char *new_app_version)
 {
+  pthread_mutex_lock(&log_settings_mutex);
+
   bool truncated = false;
   size_t temp_len = 0;
 
@@ -94,6 +109,8 @@ void set_app_version(const char *new_app_version)
     fprintf(stderr, "set_app_version(): input \"%s\" ", new_app_version);
     fprintf(stderr, "truncated to \"%s\"\n", log_settings.app_version);
   }
+
+  pthread_mutex_unlock(&log_settings_mutex);
 }
 
 //############################################################################
@@ -101,6 +118,8 @@ void set_app_version(const char *new_app_version)
 //############################################################################
 void set_applog_path(const char *new_applog_path)
 {
+  pthread_mutex_lock(&log_settings_mutex);
+
   size_t temp_len = 0;
 
   temp_len = strnlen(new_applog_path, MAX_APPLOG_PATH_LEN + 1);
@@ -121,6 +140,8 @@ void set_applog_path(const char *new_applog_path)
     fprintf(stderr, "(%d) - application log path ", MAX_APPLOG_PATH_LEN);
     fprintf(stderr, "remains \"%s\"\n", log_settings.applog_path);
   }
+
+  pthread_mutex_unlock(&log_settings_mutex);
 }
 
 
@@ -130,6 +151,8 @@ void set_applog_path(const char *new_applog_path)
 //############################################################################
 void set_applog_max_msg_len(int new_max_log_msg_len)
 {
+  pthread_mutex_lock(&log_settings_mutex);
+
   if ((new_max_log_msg_len >= 0) && (new_max_log_msg_len <= 1024))
   {
     log_settings.applog_max_msg_len = new_max_log_msg_len;
@@ -141,6 +164,8 @@ void set_applog_max_msg_len(int new_max_log_msg_len)
     fprintf(stderr, "input (%d) invalid ", new_max_log_msg_len);
     fprintf(stderr, "- unchanged (%d)\n", log_settings.applog_max_msg_len);
   }
+
+  pthread_mutex_unlock(&log_settings_mutex);
 }
 
 //############################################################################
@@ -149,6 +174,8 @@ void set_applog_max_msg_len(int new_max_log_msg_len)
 //############################################################################
 void set_applog_output_mode(int new_output_mode)
 {
+  pthread_mutex_lock(&log_settings_mutex);
+
   if ((new_output_mode >= 0) && (new_output_mode <= 2))
   {
     log_settings.applog_output_mode = new_output_mode;
@@ -160,6 +187,8 @@ void set_applog_output_mode(int new_output_mode)
     fprintf(stderr, "input (%d) invalid ", new_output_mode);
     fprintf(stderr, "- unchanged (%d)\n", log_settings.applog_output_mode);
   }
+
+  pthread_mutex_unlock(&log_settings_mutex);
 }
 
 //############################################################################
@@ -168,6 +197,8 @@ void set_applog_output_mode(int new_output_mode)
 //############################################################################
 void set_applog_severity_threshold(int new_severity_threshold)
 {
+  pthread_mutex_lock(&log_settings_mutex);
+
   if ((new_severity_threshold >= 0) && (new_severity_threshold <= 7))
   {
     log_settings.applog_severity_threshold = new_severity_threshold;
@@ -179,6 +210,8 @@ void set_applog_severity_threshold(int new_severity_threshold)
     fprintf(stderr, "input (%d) invalid - unchanged ", new_severity_threshold);
     fprintf(stderr, "(%d)\n", log_settings.applog_severity_threshold);
   }
+
+  pthread_mutex_unlock(&log_settings_mutex);
 }
 
 //############################################################################
@@ -189,6 +222,8 @@ void set_applog_severity_threshold(int new_severity_threshold)
 //############################################################################
 void set_syslog_facility(int new_syslog_facility)
 {
+  pthread_mutex_lock(&log_settings_mutex);
+
   if ((LOG_FAC(new_syslog_facility) >= 0) &&
       (LOG_FAC(new_syslog_facility) <= (LOG_NFACILITIES - 1)))
   {
@@ -202,6 +237,8 @@ void set_syslog_facility(int new_syslog_facility)
     fprintf(stderr, "invalid - unchanged ");
     fprintf(stderr, "(%d)\n", LOG_FAC(log_settings.syslog_facility));
   }
+
+  pthread_mutex_unlock(&log_settings_mutex);
 }
 
 //############################################################################
@@ -210,6 +247,8 @@ void set_syslog_facility(int new_syslog_facility)
 //############################################################################
 void set_syslog_severity_threshold(int new_severity_threshold)
 {
+  pthread_mutex_lock(&log_settings_mutex);
+
   if ((new_severity_threshold >= 0) && (new_severity_threshold <= 7))
   {
     log_settings.syslog_severity_threshold = new_severity_threshold;
@@ -221,6 +260,8 @@ void set_syslog_severity_threshold(int new_severity_threshold)
     fprintf(stderr, "input (%d) invalid - unchanged ", new_severity_threshold);
     fprintf(stderr, "(%d)\n", log_settings.syslog_severity_threshold);
   }
+
+  pthread_mutex_unlock(&log_settings_mutex);
 }
 
 //############################################################################
@@ -293,26 +334,36 @@ void log_event(const char *src_file,
                const int src_line, int severity, const char *message, ...)
 {
 
+  // take a consistent snapshot of the settings, so a concurrent call to one
+  // of the set_*() functions cannot change them part way through a message
+  struct log_params settings;
+
+  pthread_mutex_lock(&log_settings_mutex);
+  settings = log_settings;
+  pthread_mutex_unlock(&log_settings_mutex);
+
   // format log message (vsnprintf() count parameter includes null terminator)
-  char out[log_settings.applog_max_msg_len + 1];
+  char out[settings.applog_max_msg_len + 1];
   va_list args;
 
   va_start(args, message);
-  vsnprintf(out, log_settings.applog_max_msg_len + 1, message, args);
+  vsnprintf(out, settings.applog_max_msg_len + 1, message, args);
   va_end(args);
 
   // force severity to a valid value by masking (only use three lowest bits)
   severity = LOG_PRI(severity);
 
+  pthread_mutex_lock(&log_output_mutex);
+
   // log to centralized syslog facility
-  setlogmask(LOG_UPTO(log_settings.syslog_severity_threshold));
-  openlog(log_settings.app_name,
-          LOG_CONS | LOG_PID | LOG_NDELAY, log_settings.syslog_facility);
+  setlogmask(LOG_UPTO(settings.syslog_severity_threshold));
+  openlog(settings.app_name,
+          LOG_CONS | LOG_PID | LOG_NDELAY, settings.syslog_facility);
   syslog(severity, "%s", out);
   closelog();
 
   // application logging
-  if (severity <= log_settings.applog_severity_threshold)
+  if (severity <= settings.applog_severity_threshold)
   {
     char *severity_string = NULL;
 
@@ -325,15 +376,17 @@ void log_event(const char *src_file,
 
     // Populate the timestamp string
     // yyyy-mm-dd hh:mm:ss
-    strftime(timestamp, 20, "%F %T", localtime(&ts));
+    struct tm ts_tm;
+
+    strftime(timestamp, 20, "%F %T", localtime_r(&ts, &ts_tm));
 
     // open log file for writing -- logfile is NULL if not available to user
-    FILE *logfile = fopen(log_settings.applog_path, "a");
+    FILE *logfile = fopen(settings.applog_path, "a");
 
     // This switch decides what to print and where.
     // When printing to logfile, timestamps are included, when printing to
     // stddest, they are not.
-    switch (log_settings.applog_output_mode)
+    switch (settings.applog_output_mode)
     {
       // output mode 0:
       //   print to both stddest (stdout/stderr) and log file (if available)
@@ -348,10 +401,10 @@ void log_event(const char *src_file,
       //       with source location information. User can turn on detailed
       //       logging by using the --verbose (or -v) command line option.
     case 0:
-      if (log_settings.applog_severity_threshold > LOG_INFO)
+      if (settings.applog_severity_threshold > LOG_INFO)
       {
         fprintf(stddest, "%s-%s %s - %s(%s:%d) %s\n",
-                log_settings.app_name, log_settings.app_version,
+                settings.app_name, settings.app_version,
                 severity_string, src_file, src_func, src_line, out);
       }
       else
@@ -362,7 +415,7 @@ void log_event(const char *src_file,
       if (logfile != NULL)
       {
         fprintf(logfile, "%s-%s %s %s - %s(%s:%d) %s\n",
-                log_settings.app_name, log_settings.app_version,
+                settings.app_name, settings.app_version,
                 severity_string, timestamp, src_file, src_func, src_line, out);
         fclose(logfile);
       }
@@ -394,10 +447,10 @@ void log_event(const char *src_file,
     default:
       if (logfile == NULL)
       {
-        if (log_settings.applog_severity_threshold > LOG_INFO)
+        if (settings.applog_severity_threshold > LOG_INFO)
         {
           fprintf(stddest, "%s-%s %s - %s(%s:%d) %s\n",
-                  log_settings.app_name, log_settings.app_version,
+                  settings.app_name, settings.app_version,
                   severity_string, src_file, src_func, src_line, out);
         }
         else
@@ -408,7 +461,7 @@ void log_event(const char *src_file,
       else
       {
         fprintf(logfile, "%s-%s %s %s - %s(%s:%d) %s\n",
-                log_settings.app_name, log_settings.app_version,
+                settings.app_name, settings.app_version,
                 severity_string, timestamp, src_file, src_func, src_line, out);
         fclose(logfile);
       }
@@ -417,4 +470,5 @@ void log_event(const char *src_file,
     // clean-up
     free(severity_string);
   }
+  pthread_mutex_unlock(&log_output_mutex);
 }
@@ -49,12 +49,59 @@ extern "C"
  */
 #define KMYTH_ECDH_KDF NULL
 
+/**
+ * @brief Key agreement suites supported for the ECDH handshake.
+ *
+ *        KMYTH_ECDH_SUITE_P384 uses ephemeral keys on KMYTH_EC_NID
+ *        (97-byte uncompressed point contributions). KMYTH_ECDH_SUITE_X25519
+ *        uses ephemeral X25519 keys (32-byte contributions).
+ *
+ *        The suite is chosen by the client: the server identifies it from
+ *        the length of the client's contribution (see get_ecdh_suite()) and
+ *        answers with a contribution of the same suite, so no extra
+ *        negotiation message is needed and the P-384 exchange is unchanged
+ *        on the wire. The signatures over the contributions are made with
+ *        the participants' long-term keys, which may be ECDSA or Ed25519
+ *        independently of the suite.
+ *
+ *        KMYTH_ECDH_SUITE selects the suite used by the enclave client and
+ *        may be overridden at build time, e.g.,
+ *        -DKMYTH_ECDH_SUITE=KMYTH_ECDH_SUITE_X25519.
+ */
+#define KMYTH_ECDH_SUITE_P384 0
+#define KMYTH_ECDH_SUITE_X25519 1
+
+#ifndef KMYTH_ECDH_SUITE
+#define KMYTH_ECDH_SUITE KMYTH_ECDH_SUITE_P384
+#endif
+
+/**
+ * @brief Length (in bytes) of an X25519 'public key' contribution
+ */
+#define KMYTH_X25519_PUBLIC_LEN 32
+
 /**
  * @brief Maximum size of an encrypted ECDH message.
  *        (This is the same value as the maximum fragment length in a TLS record.)
  */
 #define ECDH_MAX_MSG_SIZE 16384
 
+/**
+ * @brief TCP options applied to ECDH connections (see
+ *        set_socket_tcp_options()). Every ECDH exchange is a short
+ *        request/response, so by default Nagle's algorithm is disabled
+ *        (KMYTH_ECDH_TCP_NODELAY) and delayed ACKs are left to the kernel
+ *        (KMYTH_ECDH_TCP_QUICKACK). Either may be overridden at build time,
+ *        e.g., -DKMYTH_ECDH_TCP_QUICKACK=1.
+ */
+#ifndef KMYTH_ECDH_TCP_NODELAY
+#define KMYTH_ECDH_TCP_NODELAY 1
+#endif
+
+#ifndef KMYTH_ECDH_TCP_QUICKACK
+#define KMYTH_ECDH_TCP_QUICKACK 0
+#endif
+
 /**
  * @brief Custom message header prepended to encrypted messages
  *        sent over an ECDH connection. (Similar to TLS record headers.)
@@ -154,6 +201,78 @@ struct ECDHMessageHeader {
                                  unsigned char **shared_secret,
                                  size_t *shared_secret_len);
 
+/**
+ * @brief Identifies the key agreement suite of a received ephemeral
+ *        'public key' contribution from its length.
+ *
+ * @param[in]  ephemeral_pub_in      Received ephemeral 'public key' bytes
+ *
+ * @param[in]  ephemeral_pub_in_len  Length (in bytes) of the contribution
+ *
+ * @param[out] suite_out             KMYTH_ECDH_SUITE_* value identified
+ *
+ * @return 0 on success, 1 on error (length matches no supported suite)
+ */
+  int get_ecdh_suite(unsigned char *ephemeral_pub_in,
+                     size_t ephemeral_pub_in_len, int *suite_out);
+
+/**
+ * @brief Creates an ephemeral key pair for the specified key agreement
+ *        suite. For KMYTH_ECDH_SUITE_P384 this wraps
+ *        create_ecdh_ephemeral_key_pair().
+ *
+ * @param[in]  suite                  KMYTH_ECDH_SUITE_* value
+ *
+ * @param[out] ephemeral_keypair_out  Pointer to ephemeral key pair
+ *                                    (EVP_PKEY struct) generated
+ *
+ * @return 0 on success, 1 on error
+ */
+  int create_ecdh_suite_key_pair(int suite, EVP_PKEY ** ephemeral_keypair_out);
+
+/**
+ * @brief Creates the ephemeral 'public key' contribution to be sent to the
+ *        peer for a key pair made by create_ecdh_suite_key_pair()
+ *
+ * @param[in]  ephemeral_keypair_in      Ephemeral key pair
+ *
+ * @param[out] ephemeral_pub_out         Pointer to 'public key' bytes
+ *                                       generated (caller frees)
+ *
+ * @param[out] ephemeral_pub_out_len     Pointer to length (in bytes) of
+ *                                       the 'public key' bytes generated
+ *
+ * @return 0 on success, 1 on error
+ */
+  int create_ecdh_suite_public(EVP_PKEY * ephemeral_keypair_in,
+                               unsigned char **ephemeral_pub_out,
+                               size_t *ephemeral_pub_out_len);
+
+/**
+ * @brief Computes the shared secret from a local ephemeral key pair made
+ *        by create_ecdh_suite_key_pair() and the peer's contribution. The
+ *        peer's contribution must belong to the same suite.
+ *
+ * @param[in]  local_eph_keypair     Local ephemeral key pair
+ *
+ * @param[in]  remote_eph_pub        Remote 'public key' contribution bytes
+ *
+ * @param[in]  remote_eph_pub_len    Length (in bytes) of remote contribution
+ *
+ * @param[out] shared_secret         Pointer to shared secret computed
+ *                                   (caller frees)
+ *
+ * @param[out] shared_secret_len     Pointer to the length (in bytes) of the
+ *                                   shared secret result
+ *
+ * @return 0 on success, 1 on error
+ */
+  int compute_ecdh_suite_shared_secret(EVP_PKEY * local_eph_keypair,
+                                       unsigned char *remote_eph_pub,
+                                       size_t remote_eph_pub_len,
+                                       unsigned char **shared_secret,
+                                       size_t *shared_secret_len);
+
 /**
  * @brief Computes session key from a shared secret value input.
  *
@@ -178,7 +297,8 @@ struct ECDHMessageHeader {
 
 /**
  * @brief Generates a signature over the data in an input buffer passed
- *        in to the function, using a specified EC private key
+ *        in to the function, using a specified EC private key. ECDSA keys
+ *        sign a SHA-512 digest; Ed25519 keys sign the data directly.
  *
  * @param[in]  ec_sign_pkey       Pointer to EC_KEY containing an elliptic
  *                                curve private key to be used for signing
@@ -205,7 +325,8 @@ struct ECDHMessageHeader {
 
 /**
  * @brief Validates a signature over the data in an input buffer passed
- *        in to the function, using a specified EC private key
+ *        in to the function, using a specified EC public key (ECDSA with
+ *        SHA-512, or Ed25519)
  *
  * @param[in]  ec_sign_pkey       Pointer to EC_KEY containing an elliptic
  *                                curve public key to be used for signature
@@ -13,8 +13,7 @@ extern "C"
 {
 #endif
 
-// maximum log message size - can use to size buffer
-#define MAX_LOG_MSG_LEN 128
+#include "kmyth_log_event.h"
 
 //if 'syslog.h' is not included, define its 'priority' level macros here
 #ifndef LOG_EMERG
@@ -49,7 +48,8 @@ extern "C"
 #define	LOG_DEBUG	7
 #endif
 
-// macro for generic logging call
+// macro for generic logging call - within the enclave, log_event_ocall()
+// buffers the event (see kmyth_enclave_log.h) rather than exiting the enclave
 #define kmyth_sgx_log(severity, message)\
 {\
   const char *src_file = __FILE__;\
@@ -66,6 +66,7 @@ extern "C"
 
 #ifdef _KMYTH_LOCALE_TRUSTED_
 #include ENCLAVE_HEADER_TRUSTED
+#include "kmyth_enclave_log.h"
 #else
 #include "log_ocall.h"
 #include "memory_ocall.h"
@@ -0,0 +1,39 @@
+/**
+ * @file kmyth_log_event.h
+ *
+ * @brief Provides the fixed-size log event record used to pass buffered
+ *        enclave log events out to the untrusted logger in batches
+ */
+
+#ifndef _KMYTH_LOG_EVENT_H_
+#define _KMYTH_LOG_EVENT_H_
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+// maximum log message size - can use to size buffer
+#define MAX_LOG_MSG_LEN 128
+
+// maximum length of the source file and function names kept for an event
+#define MAX_LOG_SRC_LEN 64
+
+/**
+ * @brief A log event, copied (and, if necessary, truncated) into storage
+ *        of its own, so it can be passed out of the enclave by value.
+ */
+  typedef struct kmyth_log_event_s
+  {
+    char src_file[MAX_LOG_SRC_LEN];
+    char src_func[MAX_LOG_SRC_LEN];
+    int src_line;
+    int severity;
+    char message[MAX_LOG_MSG_LEN];
+  } kmyth_log_event_t;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
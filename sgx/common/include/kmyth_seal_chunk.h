@@ -0,0 +1,56 @@
+/**
+ * @file kmyth_seal_chunk.h
+ *
+ * @brief Provides the layout of chunked (streaming) SGX-sealed data, shared
+ *        by the enclave, which seals and unseals the chunks, and the
+ *        untrusted wrappers, which size and format them
+ */
+
+#ifndef _KMYTH_SEAL_CHUNK_H_
+#define _KMYTH_SEAL_CHUNK_H_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+// default number of plaintext bytes sealed into each chunk
+#define KMYTH_SEAL_CHUNK_SIZE (64 * 1024)
+
+// largest chunk size accepted, which bounds the enclave memory used: a
+// chunk is held in the enclave heap twice (plaintext and sealed) while it
+// is sealed, which must fit well within the enclaves' HeapMaxSize (1 MiB)
+#define KMYTH_SEAL_CHUNK_MAX_SIZE (256 * 1024)
+
+// value of the magic field of every chunk's additional MAC text
+#define KMYTH_SEAL_CHUNK_MAGIC "KMYTHCHK"
+
+// size of the magic field (KMYTH_SEAL_CHUNK_MAGIC, without its terminator)
+#define KMYTH_SEAL_CHUNK_MAGIC_LEN 8
+
+// size of the AES-GCM tag of a sealed chunk (SGX_SEAL_TAG_SIZE)
+#define KMYTH_SEAL_CHUNK_TAG_LEN 16
+
+/**
+ * @brief The additional MAC text sealed with each chunk. It binds the chunk
+ *        to its position in the stream and, through the tag of the chunk
+ *        before it, to every earlier chunk, so chunks cannot be reordered,
+ *        dropped, or spliced in from another stream, and the stream cannot
+ *        be truncated without the unseal failing.
+ */
+  typedef struct kmyth_seal_chunk_aad_s
+  {
+    uint8_t magic[KMYTH_SEAL_CHUNK_MAGIC_LEN];
+    uint64_t index;             // position of the chunk, from 0
+    uint32_t final;             // 1 for the last chunk, otherwise 0
+    uint32_t reserved;          // must be 0
+    uint8_t prev_tag[KMYTH_SEAL_CHUNK_TAG_LEN]; // all 0 for the first chunk
+  } kmyth_seal_chunk_aad_t;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -24,7 +24,9 @@ int unmarshal_ec_der_to_pkey(uint8_t ** ec_der_bytes_in,
   const unsigned char *buf_in = (const unsigned char *) *ec_der_bytes_in;
   long buf_len = (long) *ec_der_bytes_in_len;
 
-  *ec_pkey_out = d2i_PrivateKey(EVP_PKEY_EC, NULL, &buf_in, buf_len);
+  // the key type is detected from the encoding: a traditional EC key or
+  // a PKCS#8 key (the form i2d_PrivateKey() produces for Ed25519)
+  *ec_pkey_out = d2i_AutoPrivateKey(NULL, &buf_in, buf_len);
   if (*ec_pkey_out == NULL)
   {
     kmyth_sgx_log(LOG_ERR, "DER to PKEY format conversion failed");
@@ -178,6 +178,203 @@ int compute_ecdh_shared_secret(EC_KEY * local_eph_priv_key,
   return EXIT_SUCCESS;
 }
 
+/*****************************************************************************
+ * get_ecdh_suite()
+ ****************************************************************************/
+int get_ecdh_suite(unsigned char *ephemeral_pub_in,
+                   size_t ephemeral_pub_in_len, int *suite_out)
+{
+  if (ephemeral_pub_in == NULL || ephemeral_pub_in_len == 0)
+  {
+    kmyth_sgx_log(LOG_ERR, "empty ephemeral 'public key' contribution");
+    return EXIT_FAILURE;
+  }
+
+  // an X25519 contribution is exactly 32 bytes; anything else is treated
+  // as a P-384 point octet string and validated when it is decoded
+  if (ephemeral_pub_in_len == KMYTH_X25519_PUBLIC_LEN)
+  {
+    *suite_out = KMYTH_ECDH_SUITE_X25519;
+  }
+  else
+  {
+    *suite_out = KMYTH_ECDH_SUITE_P384;
+  }
+
+  return EXIT_SUCCESS;
+}
+
+/*****************************************************************************
+ * create_ecdh_suite_key_pair()
+ ****************************************************************************/
+int create_ecdh_suite_key_pair(int suite, EVP_PKEY ** ephemeral_keypair_out)
+{
+  *ephemeral_keypair_out = NULL;
+
+  if (suite == KMYTH_ECDH_SUITE_X25519)
+  {
+    EVP_PKEY_CTX *ctx = EVP_PKEY_CTX_new_id(EVP_PKEY_X25519, NULL);
+
+    if (ctx == NULL
+        || EVP_PKEY_keygen_init(ctx) != 1
+        || EVP_PKEY_keygen(ctx, ephemeral_keypair_out) != 1)
+    {
+      kmyth_sgx_log(LOG_ERR, "X25519 ephemeral key pair generation failed");
+      EVP_PKEY_CTX_free(ctx);
+      EVP_PKEY_free(*ephemeral_keypair_out);
+      *ephemeral_keypair_out = NULL;
+      return EXIT_FAILURE;
+    }
+    EVP_PKEY_CTX_free(ctx);
+    return EXIT_SUCCESS;
+  }
+
+  if (suite != KMYTH_ECDH_SUITE_P384)
+  {
+    kmyth_sgx_log(LOG_ERR, "unsupported ECDH key agreement suite");
+    return EXIT_FAILURE;
+  }
+
+  EC_KEY *ec_keypair = NULL;
+
+  if (create_ecdh_ephemeral_key_pair(KMYTH_EC_NID, &ec_keypair))
+  {
+    EC_KEY_free(ec_keypair);
+    return EXIT_FAILURE;
+  }
+
+  *ephemeral_keypair_out = EVP_PKEY_new();
+  if (*ephemeral_keypair_out == NULL
+      || EVP_PKEY_assign_EC_KEY(*ephemeral_keypair_out, ec_keypair) != 1)
+  {
+    kmyth_sgx_log(LOG_ERR, "failed to wrap ephemeral EC key pair");
+    EVP_PKEY_free(*ephemeral_keypair_out);
+    *ephemeral_keypair_out = NULL;
+    EC_KEY_free(ec_keypair);
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
+
+/*****************************************************************************
+ * create_ecdh_suite_public()
+ ****************************************************************************/
+int create_ecdh_suite_public(EVP_PKEY * ephemeral_keypair_in,
+                             unsigned char **ephemeral_pub_out,
+                             size_t *ephemeral_pub_out_len)
+{
+  if (EVP_PKEY_id(ephemeral_keypair_in) == EVP_PKEY_X25519)
+  {
+    *ephemeral_pub_out_len = KMYTH_X25519_PUBLIC_LEN;
+    *ephemeral_pub_out = malloc(*ephemeral_pub_out_len);
+    if (*ephemeral_pub_out == NULL)
+    {
+      kmyth_sgx_log(LOG_ERR, "malloc of 'public key' buffer failed");
+      return EXIT_FAILURE;
+    }
+    if (EVP_PKEY_get_raw_public_key(ephemeral_keypair_in,
+                                    *ephemeral_pub_out,
+                                    ephemeral_pub_out_len) != 1
+        || *ephemeral_pub_out_len != KMYTH_X25519_PUBLIC_LEN)
+    {
+      kmyth_sgx_log(LOG_ERR, "X25519 'public key' extraction failed");
+      free(*ephemeral_pub_out);
+      *ephemeral_pub_out = NULL;
+      return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+  }
+
+  EC_KEY *ec_keypair = (EC_KEY *) EVP_PKEY_get0_EC_KEY(ephemeral_keypair_in);
+
+  if (ec_keypair == NULL)
+  {
+    kmyth_sgx_log(LOG_ERR, "ephemeral key pair is not an EC key");
+    return EXIT_FAILURE;
+  }
+
+  return create_ecdh_ephemeral_public(ec_keypair,
+                                      ephemeral_pub_out,
+                                      ephemeral_pub_out_len);
+}
+
+/*****************************************************************************
+ * compute_ecdh_suite_shared_secret()
+ ****************************************************************************/
+int compute_ecdh_suite_shared_secret(EVP_PKEY * local_eph_keypair,
+                                     unsigned char *remote_eph_pub,
+                                     size_t remote_eph_pub_len,
+                                     unsigned char **shared_secret,
+                                     size_t *shared_secret_len)
+{
+  *shared_secret = NULL;
+  *shared_secret_len = 0;
+
+  if (EVP_PKEY_id(local_eph_keypair) == EVP_PKEY_X25519)
+  {
+    if (remote_eph_pub_len != KMYTH_X25519_PUBLIC_LEN)
+    {
+      kmyth_sgx_log(LOG_ERR, "remote contribution does not match X25519");
+      return EXIT_FAILURE;
+    }
+
+    EVP_PKEY *remote_pub = EVP_PKEY_new_raw_public_key(EVP_PKEY_X25519, NULL,
+                                                       remote_eph_pub,
+                                                       remote_eph_pub_len);
+    EVP_PKEY_CTX *ctx = EVP_PKEY_CTX_new(local_eph_keypair, NULL);
+    size_t secret_len = 0;
+
+    // OpenSSL rejects an all-zero X25519 result (small-order remote point)
+    // in EVP_PKEY_derive()
+    if (remote_pub == NULL || ctx == NULL
+        || EVP_PKEY_derive_init(ctx) != 1
+        || EVP_PKEY_derive_set_peer(ctx, remote_pub) != 1
+        || EVP_PKEY_derive(ctx, NULL, &secret_len) != 1
+        || (*shared_secret = OPENSSL_malloc(secret_len)) == NULL
+        || EVP_PKEY_derive(ctx, *shared_secret, &secret_len) != 1)
+    {
+      kmyth_sgx_log(LOG_ERR, "computation of X25519 shared secret failed");
+      // a failed derive may have written part of the secret
+      OPENSSL_clear_free(*shared_secret, secret_len);
+      *shared_secret = NULL;
+      EVP_PKEY_CTX_free(ctx);
+      EVP_PKEY_free(remote_pub);
+      return EXIT_FAILURE;
+    }
+    *shared_secret_len = secret_len;
+
+    EVP_PKEY_CTX_free(ctx);
+    EVP_PKEY_free(remote_pub);
+    return EXIT_SUCCESS;
+  }
+
+  EC_KEY *ec_keypair = (EC_KEY *) EVP_PKEY_get0_EC_KEY(local_eph_keypair);
+  EC_POINT *remote_eph_pub_pt = NULL;
+
+  if (ec_keypair == NULL)
+  {
+    kmyth_sgx_log(LOG_ERR, "ephemeral key pair is not an EC key");
+    return EXIT_FAILURE;
+  }
+
+  if (reconstruct_ecdh_ephemeral_public_point(KMYTH_EC_NID,
+                                              remote_eph_pub,
+                                              remote_eph_pub_len,
+                                              &remote_eph_pub_pt))
+  {
+    EC_POINT_free(remote_eph_pub_pt);
+    return EXIT_FAILURE;
+  }
+
+  int ret = compute_ecdh_shared_secret(ec_keypair, remote_eph_pub_pt,
+                                       shared_secret, shared_secret_len);
+
+  EC_POINT_clear_free(remote_eph_pub_pt);
+
+  return ret;
+}
+
 /*****************************************************************************
  * compute_ecdh_session_key()
  ****************************************************************************/
@@ -261,6 +458,39 @@ int sign_buffer(EVP_PKEY * ec_sign_pkey,
     return EXIT_FAILURE;
   }
 
+  // Ed25519 signs the message itself (no pre-hash), in one shot
+  if (EVP_PKEY_id(ec_sign_pkey) == EVP_PKEY_ED25519)
+  {
+    size_t sig_len = 0;
+
+    if (EVP_DigestSignInit(mdctx, NULL, NULL, NULL, ec_sign_pkey) != 1
+        || EVP_DigestSign(mdctx, NULL, &sig_len, buf_in, buf_in_len) != 1)
+    {
+      kmyth_sgx_log(LOG_ERR, "config of Ed25519 signature context failed");
+      EVP_MD_CTX_free(mdctx);
+      return EXIT_FAILURE;
+    }
+    *sig_out = OPENSSL_malloc(sig_len);
+    if (*sig_out == NULL)
+    {
+      kmyth_sgx_log(LOG_ERR, "malloc of signature buffer failed");
+      EVP_MD_CTX_free(mdctx);
+      return EXIT_FAILURE;
+    }
+    if (EVP_DigestSign(mdctx, *sig_out, &sig_len, buf_in, buf_in_len) != 1)
+    {
+      kmyth_sgx_log(LOG_ERR, "signature creation failed");
+      OPENSSL_free(*sig_out);
+      *sig_out = NULL;
+      *sig_out_len = 0;
+      EVP_MD_CTX_free(mdctx);
+      return EXIT_FAILURE;
+    }
+    *sig_out_len = (unsigned int) sig_len;
+    EVP_MD_CTX_free(mdctx);
+    return EXIT_SUCCESS;
+  }
+
   // configure signing context
   if (EVP_SignInit(mdctx, EVP_sha512()) != 1)
   {
@@ -299,6 +529,9 @@ int sign_buffer(EVP_PKEY * ec_sign_pkey,
                     (unsigned int *) sig_out_len, ec_sign_pkey) != 1)
   {
     kmyth_sgx_log(LOG_ERR, "signature creation failed");
+    OPENSSL_free(*sig_out);
+    *sig_out = NULL;
+    *sig_out_len = 0;
     EVP_MD_CTX_free(mdctx);
     return EXIT_FAILURE;
   }
@@ -325,6 +558,21 @@ int verify_buffer(EVP_PKEY * ec_verify_pkey,
     return EXIT_FAILURE;
   }
 
+  // Ed25519 verifies the message itself (no pre-hash), in one shot
+  if (EVP_PKEY_id(ec_verify_pkey) == EVP_PKEY_ED25519)
+  {
+    if (EVP_DigestVerifyInit(mdctx, NULL, NULL, NULL, ec_verify_pkey) != 1
+        || EVP_DigestVerify(mdctx, sig_in, sig_in_len,
+                            buf_in, buf_in_len) != 1)
+    {
+      kmyth_sgx_log(LOG_ERR, "signature verification failed");
+      EVP_MD_CTX_free(mdctx);
+      return EXIT_FAILURE;
+    }
+    EVP_MD_CTX_free(mdctx);
+    return EXIT_SUCCESS;
+  }
+
   // 'initialize' (e.g., load public key)
   if (EVP_DigestVerifyInit(mdctx, NULL, EVP_sha512(),
                            NULL, ec_verify_pkey) != 1)
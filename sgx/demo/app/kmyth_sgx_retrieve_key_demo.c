@@ -10,6 +10,7 @@
 #include <errno.h>
 #include <string.h>
 #include <unistd.h>
+#include <time.h>
 
 #include <openssl/bio.h>
 #include <openssl/pem.h>
@@ -19,6 +20,7 @@
 #include <openssl/err.h>
 
 #include "sgx_urts.h"
+#include "sgx_uswitchless.h"
 
 #include "ec_key_cert_marshal.h"
 #include "ec_key_cert_unmarshal.h"
@@ -54,6 +56,16 @@
 #define KEY_ID "7"
 #define KEY_ID_LEN 1
 
+/**
+ * Number of untrusted worker threads serving the switchless OCALLs
+ * (log_events_ocall, time_ocall, ecdh_send_ocall and ecdh_recv_ocall);
+ * zero creates the enclave without switchless support, so that every
+ * OCALL exits the enclave.
+ */
+#ifndef DEMO_SWITCHLESS_UWORKERS
+#define DEMO_SWITCHLESS_UWORKERS 1
+#endif
+
 /*****************************************************************************
  * initialize_enclave
  *
@@ -68,7 +80,25 @@ static sgx_status_t initialize_enclave(const char *enclave_fn,
 {
   sgx_status_t ret = SGX_ERROR_UNEXPECTED;
 
-  ret = sgx_create_enclave(enclave_fn, SGX_DEBUG_FLAG, NULL, NULL, eid, NULL);
+  if (DEMO_SWITCHLESS_UWORKERS == 0)
+  {
+    ret = sgx_create_enclave(enclave_fn, SGX_DEBUG_FLAG, NULL, NULL, eid,
+                             NULL);
+    return ret;
+  }
+
+  // switchless OCALLs are handed to untrusted worker threads; the enclave
+  // only falls back to a regular OCALL when no worker is available
+  sgx_uswitchless_config_t us_config = SGX_USWITCHLESS_CONFIG_INITIALIZER;
+  const void *enclave_ex_p[32] = { 0 };
+
+  us_config.num_uworkers = DEMO_SWITCHLESS_UWORKERS;
+  us_config.num_tworkers = 0;
+  enclave_ex_p[SGX_CREATE_ENCLAVE_EX_SWITCHLESS_BIT_IDX] = &us_config;
+
+  ret = sgx_create_enclave_ex(enclave_fn, SGX_DEBUG_FLAG, NULL, NULL, eid,
+                              NULL, SGX_CREATE_ENCLAVE_EX_SWITCHLESS,
+                              enclave_ex_p);
   return ret;
 }
 
@@ -188,6 +218,9 @@ int main(int argc, char **argv)
   int server_host_len = strlen(server_host) + 1;
   int server_port = SERVER_PORT;
 
+  struct timespec start_time, end_time;
+
+  clock_gettime(CLOCK_MONOTONIC, &start_time);
   sgx_ret = kmyth_enclave_retrieve_key_from_server(eid,
                                                    &retval,
                                                    client_priv_ec_key_bytes,
@@ -199,6 +232,10 @@ int main(int argc, char **argv)
                                                    server_port,
                                                    (unsigned char *) KEY_ID,
                                                    KEY_ID_LEN);
+  clock_gettime(CLOCK_MONOTONIC, &end_time);
+  demo_log(LOG_INFO, "key retrieval ECALL took %.3f ms",
+           (end_time.tv_sec - start_time.tv_sec) * 1e3 +
+           (end_time.tv_nsec - start_time.tv_nsec) / 1e6);
 
   free(client_priv_ec_key_bytes);
   free(server_pub_ec_cert_bytes);
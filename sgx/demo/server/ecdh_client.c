@@ -21,7 +21,16 @@ int main(int argc, char **argv)
   get_options(&ecdhconn, argc, argv);
   check_options(&ecdhconn);
 
-  client_main(&ecdhconn);
+  if (ecdhconn.bench_iterations > 0)
+  {
+    /* Keep per-message logging out of the measurements. */
+    set_applog_severity_threshold(LOG_WARNING);
+    client_bench(&ecdhconn);
+  }
+  else
+  {
+    client_main(&ecdhconn);
+  }
 
   cleanup(&ecdhconn);
 
@@ -13,6 +13,9 @@ void init(ECDHServer * ecdhconn)
   secure_memset(ecdhconn, 0, sizeof(ECDHServer));
   ecdhconn->socket_fd = UNSET_FD;
   ecdhconn->client_mode = false;
+  ecdhconn->tcp_nodelay = KMYTH_ECDH_TCP_NODELAY;
+  ecdhconn->tcp_quickack = KMYTH_ECDH_TCP_QUICKACK;
+  ecdhconn->ecdh_suite = KMYTH_ECDH_SUITE;
 }
 
 void cleanup(ECDHServer * ecdhconn)
@@ -40,7 +43,7 @@ void cleanup(ECDHServer * ecdhconn)
   {
     kmyth_clear(ecdhconn->local_ephemeral_keypair,
                 sizeof(ecdhconn->local_ephemeral_keypair));
-    EC_KEY_free(ecdhconn->local_ephemeral_keypair);
+    EVP_PKEY_free(ecdhconn->local_ephemeral_keypair);
   }
 
   if (ecdhconn->remote_ephemeral_pubkey != NULL)
@@ -76,6 +79,10 @@ static void usage(const char *prog)
           "  -i or --ip       The IP address or hostname of the server (only used by the client).\n"
           "Test Options --\n"
           "  -m or --maxconn  The number of connections the server will accept before exiting (unlimited by default, or if the value is not a positive integer).\n"
+          "  -b or --bench    Run the client handshake and key request this many times, then report its latency (only used by the client).\n"
+          "  -n or --nagle    Leave Nagle's algorithm enabled (TCP_NODELAY is set by default).\n"
+          "  -q or --quickack Set TCP_QUICKACK before each receive (Linux only).\n"
+          "  -x or --x25519   Use X25519 key agreement instead of P-384 (only used by the client; the server answers with the client's suite).\n"
           "Misc --\n"
           "  -h or --help     Help (displays this usage).\n\n", prog);
 }
@@ -93,7 +100,7 @@ void get_options(ECDHServer * ecdhconn, int argc, char **argv)
   int option_index = 0;
 
   while ((options =
-          getopt_long(argc, argv, "r:u:p:i:m:h", longopts, &option_index)) != -1)
+          getopt_long(argc, argv, "r:u:p:i:m:b:nqxh", longopts, &option_index)) != -1)
   {
     switch (options)
     {
@@ -115,6 +122,18 @@ void get_options(ECDHServer * ecdhconn, int argc, char **argv)
     case 'm':
       ecdhconn->maxconn = atoi(optarg);
       break;
+    case 'b':
+      ecdhconn->bench_iterations = atoi(optarg);
+      break;
+    case 'n':
+      ecdhconn->tcp_nodelay = false;
+      break;
+    case 'q':
+      ecdhconn->tcp_quickack = true;
+      break;
+    case 'x':
+      ecdhconn->ecdh_suite = KMYTH_ECDH_SUITE_X25519;
+      break;
     // Misc
     case 'h':
       usage(argv[0]);
@@ -156,12 +175,10 @@ void check_options(ECDHServer * ecdhconn)
   }
 }
 
-void ecdh_send_data(ECDHServer * ecdhconn, const void *buf, size_t len)
+void ecdh_send_frame(ECDHServer * ecdhconn, struct iovec *iov, int iovcnt)
 {
   /* Wrapper function to simplify error handling. */
-  ssize_t bytes_sent = write(ecdhconn->socket_fd, buf, len);
-
-  if (bytes_sent != len)
+  if (send_socket_frame(ecdhconn->socket_fd, iov, iovcnt))
   {
     kmyth_log(LOG_ERR, "Failed to send a message.");
     error(ecdhconn);
@@ -171,16 +188,15 @@ void ecdh_send_data(ECDHServer * ecdhconn, const void *buf, size_t len)
 void ecdh_recv_data(ECDHServer * ecdhconn, void *buf, size_t len)
 {
   /* Wrapper function to simplify error handling. */
-  ssize_t bytes_read = read(ecdhconn->socket_fd, buf, len);
-
-  if (bytes_read == 0)
+  if (ecdhconn->tcp_quickack)
   {
-    kmyth_log(LOG_ERR, "ECDH connection is closed.");
-    error(ecdhconn);
+    /* The kernel leaves quick-ACK mode on its own, so set it again. */
+    set_socket_tcp_options(ecdhconn->socket_fd, ecdhconn->tcp_nodelay, true);
   }
-  else if (bytes_read != len)
+
+  /* With these protocols, we should always receive exactly (len) bytes. */
+  if (recv_socket_exact(ecdhconn->socket_fd, buf, len))
   {
-    /* With these protocols, we should always receive exactly (len) bytes. */
     kmyth_log(LOG_ERR, "Failed to receive a message.");
     error(ecdhconn);
   }
@@ -189,6 +205,10 @@ void ecdh_recv_data(ECDHServer * ecdhconn, void *buf, size_t len)
 void ecdh_send_msg(ECDHServer * ecdhconn, unsigned char *buf, size_t len)
 {
   struct ECDHMessageHeader header;
+  struct iovec msg[2] = {
+    {.iov_base = &header,.iov_len = sizeof(header)},
+    {.iov_base = buf,.iov_len = len}
+  };
 
   if (len > ECDH_MAX_MSG_SIZE)
   {
@@ -198,8 +218,7 @@ void ecdh_send_msg(ECDHServer * ecdhconn, unsigned char *buf, size_t len)
 
   secure_memset(&header, 0, sizeof(header));
   header.msg_size = len;
-  ecdh_send_data(ecdhconn, &header, sizeof(header));
-  ecdh_send_data(ecdhconn, buf, len);
+  ecdh_send_frame(ecdhconn, msg, 2);
 }
 
 void ecdh_recv_msg(ECDHServer * ecdhconn, unsigned char **buf, size_t *len)
@@ -316,6 +335,7 @@ void create_server_socket(ECDHServer * ecdhconn)
     } else if (ret == 0) {
       /* child */
       close(listen_fd);
+      set_tcp_options(ecdhconn);
       return;
     } else {
       /* parent */
@@ -341,6 +361,17 @@ void create_client_socket(ECDHServer * ecdhconn)
     kmyth_log(LOG_ERR, "Failed to setup client socket.");
     error(ecdhconn);
   }
+  set_tcp_options(ecdhconn);
+}
+
+void set_tcp_options(ECDHServer * ecdhconn)
+{
+  /* The TCP options only affect latency, so failing to set them is not fatal. */
+  if (set_socket_tcp_options(ecdhconn->socket_fd, ecdhconn->tcp_nodelay,
+                             ecdhconn->tcp_quickack))
+  {
+    kmyth_log(LOG_WARNING, "Using default TCP options for the connection.");
+  }
 }
 
 void load_private_key(ECDHServer * ecdhconn)
@@ -407,15 +438,16 @@ void load_public_key(ECDHServer * ecdhconn)
 void make_ephemeral_keypair(ECDHServer * ecdhconn)
 {
   // create local ephemeral contribution (public/private key pair)
-  int ret = create_ecdh_ephemeral_key_pair(KMYTH_EC_NID,
-                                           &ecdhconn->local_ephemeral_keypair);
+  int ret = create_ecdh_suite_key_pair(ecdhconn->ecdh_suite,
+                                       &ecdhconn->local_ephemeral_keypair);
 
   if (ret != EXIT_SUCCESS)
   {
     kmyth_log(LOG_ERR, "creation of local ephemeral key pair failed");
     error(ecdhconn);
   }
-  kmyth_log(LOG_DEBUG, "created local ephemeral EC key pair");
+  kmyth_log(LOG_DEBUG, "created local ephemeral %s key pair",
+            ecdhconn->ecdh_suite == KMYTH_ECDH_SUITE_X25519 ? "X25519" : "EC");
 }
 
 void recv_ephemeral_public(ECDHServer * ecdhconn)
@@ -437,6 +469,16 @@ void recv_ephemeral_public(ECDHServer * ecdhconn)
   ecdh_recv_data(ecdhconn, ecdhconn->remote_ephemeral_pubkey,
            ecdhconn->remote_ephemeral_pubkey_len);
 
+  /* The client chooses the key agreement suite; the server follows it. */
+  if (!ecdhconn->client_mode
+      && get_ecdh_suite(ecdhconn->remote_ephemeral_pubkey,
+                        ecdhconn->remote_ephemeral_pubkey_len,
+                        &ecdhconn->ecdh_suite))
+  {
+    kmyth_log(LOG_ERR, "Received public key matches no supported suite.");
+    error(ecdhconn);
+  }
+
   kmyth_log(LOG_DEBUG, "Receiving ephemeral public key signature.");
   ecdh_recv_data(ecdhconn, &remote_pub_sig_len, sizeof(remote_pub_sig_len));
   if (remote_pub_sig_len > ECDH_MAX_MSG_SIZE)
@@ -469,8 +511,8 @@ void send_ephemeral_public(ECDHServer * ecdhconn)
   unsigned int local_pub_sig_len = 0;
   int ret;
 
-  ret = create_ecdh_ephemeral_public(ecdhconn->local_ephemeral_keypair,
-                                     &local_pub, &local_pub_len);
+  ret = create_ecdh_suite_public(ecdhconn->local_ephemeral_keypair,
+                                 &local_pub, &local_pub_len);
   if (ret != EXIT_SUCCESS)
   {
     kmyth_log(LOG_ERR, "creation of local epehemeral 'public key' failed");
@@ -489,12 +531,16 @@ void send_ephemeral_public(ECDHServer * ecdhconn)
   }
   kmyth_log(LOG_DEBUG, "signed local ephemeral ECDH 'public key'");
 
-  kmyth_log(LOG_DEBUG, "Sending ephemeral public key.");
-  ecdh_send_data(ecdhconn, &local_pub_len, sizeof(local_pub_len));
-  ecdh_send_data(ecdhconn, local_pub, local_pub_len);
-  kmyth_log(LOG_DEBUG, "Sending ephemeral public key signature.");
-  ecdh_send_data(ecdhconn, &local_pub_sig_len, sizeof(local_pub_sig_len));
-  ecdh_send_data(ecdhconn, local_pub_sig, local_pub_sig_len);
+  /* The public key and its signature, each after its length, leave as one message. */
+  struct iovec contribution[4] = {
+    {.iov_base = &local_pub_len,.iov_len = sizeof(local_pub_len)},
+    {.iov_base = local_pub,.iov_len = local_pub_len},
+    {.iov_base = &local_pub_sig_len,.iov_len = sizeof(local_pub_sig_len)},
+    {.iov_base = local_pub_sig,.iov_len = local_pub_sig_len}
+  };
+
+  kmyth_log(LOG_DEBUG, "Sending ephemeral public key and signature.");
+  ecdh_send_frame(ecdhconn, contribution, 4);
 
   kmyth_clear_and_free(local_pub, local_pub_len);
   kmyth_clear_and_free(local_pub_sig, local_pub_sig_len);
@@ -502,29 +548,16 @@ void send_ephemeral_public(ECDHServer * ecdhconn)
 
 void get_session_key(ECDHServer * ecdhconn)
 {
-  EC_POINT *remote_ephemeral_pub_pt = NULL;
   unsigned char *session_secret = NULL;
   size_t session_secret_len = 0;
   int ret;
 
-  // re-construct EVP_PKEY for client's public contribution
-  ret = reconstruct_ecdh_ephemeral_public_point(KMYTH_EC_NID,
-                                                ecdhconn->remote_ephemeral_pubkey,
-                                                ecdhconn->remote_ephemeral_pubkey_len,
-                                                &remote_ephemeral_pub_pt);
-  if (ret != EXIT_SUCCESS)
-  {
-    kmyth_log(LOG_ERR, "remote ephemeral public point reconstruction failed");
-    error(ecdhconn);
-  }
-  kmyth_log(LOG_DEBUG, "reconstructed remote 'public key' as EC_POINT");
-
-  // generate shared secret result for ECDH key agreement (server side)
-  ret = compute_ecdh_shared_secret(ecdhconn->local_ephemeral_keypair,
-                                   remote_ephemeral_pub_pt,
-                                   &session_secret, &session_secret_len);
-  EC_POINT_clear_free(remote_ephemeral_pub_pt);
-  remote_ephemeral_pub_pt = NULL;
+  // generate shared secret result for ECDH key agreement
+  //   (the remote contribution is decoded and validated for the local suite)
+  ret = compute_ecdh_suite_shared_secret(ecdhconn->local_ephemeral_keypair,
+                                         ecdhconn->remote_ephemeral_pubkey,
+                                         ecdhconn->remote_ephemeral_pubkey_len,
+                                         &session_secret, &session_secret_len);
   if (ret != EXIT_SUCCESS)
   {
     kmyth_log(LOG_ERR, "server computation of 'session secret' result failed");
@@ -707,6 +740,57 @@ void get_operational_key(ECDHServer * ecdhconn)
   kmyth_clear_and_free(op_key, op_key_len);
 }
 
+void reset_session(ECDHServer * ecdhconn)
+{
+  /* Release the per-connection state, keeping the long-term keys loaded. */
+  if (ecdhconn->socket_fd != UNSET_FD)
+  {
+    close(ecdhconn->socket_fd);
+    ecdhconn->socket_fd = UNSET_FD;
+  }
+
+  if (ecdhconn->local_ephemeral_keypair != NULL)
+  {
+    EVP_PKEY_free(ecdhconn->local_ephemeral_keypair);
+    ecdhconn->local_ephemeral_keypair = NULL;
+  }
+
+  if (ecdhconn->remote_ephemeral_pubkey != NULL)
+  {
+    kmyth_clear_and_free(ecdhconn->remote_ephemeral_pubkey,
+                         ecdhconn->remote_ephemeral_pubkey_len);
+    ecdhconn->remote_ephemeral_pubkey = NULL;
+    ecdhconn->remote_ephemeral_pubkey_len = 0;
+  }
+
+  if (ecdhconn->session_key != NULL)
+  {
+    kmyth_clear_and_free(ecdhconn->session_key, ecdhconn->session_key_len);
+    ecdhconn->session_key = NULL;
+    ecdhconn->session_key_len = 0;
+  }
+}
+
+static int compare_latency(const void *a, const void *b)
+{
+  double x = *(const double *) a;
+  double y = *(const double *) b;
+
+  return (x > y) - (x < y);
+}
+
+static double latency_percentile(double *sorted, int count, double p)
+{
+  /* nearest-rank percentile */
+  int rank = (int) (p * count + 0.999999);
+
+  if (rank < 1)
+  {
+    rank = 1;
+  }
+  return sorted[rank - 1];
+}
+
 void server_main(ECDHServer * ecdhconn)
 {
   create_server_socket(ecdhconn);
@@ -714,9 +798,10 @@ void server_main(ECDHServer * ecdhconn)
   load_private_key(ecdhconn);
   load_public_key(ecdhconn);
 
-  make_ephemeral_keypair(ecdhconn);
-
+  /* The client's contribution determines the suite of the server's key pair. */
   recv_ephemeral_public(ecdhconn);
+
+  make_ephemeral_keypair(ecdhconn);
   send_ephemeral_public(ecdhconn);
 
   get_session_key(ecdhconn);
@@ -740,3 +825,66 @@ void client_main(ECDHServer * ecdhconn)
 
   get_operational_key(ecdhconn);
 }
+
+void client_bench(ECDHServer * ecdhconn)
+{
+  struct timespec start, end, cpu_start, cpu_end;
+  double total = 0.0;
+  double handshake_cpu = 0.0;
+  double *latency = calloc(ecdhconn->bench_iterations, sizeof(double));
+
+  if (latency == NULL)
+  {
+    kmyth_log(LOG_ERR, "Failed to allocate the latency samples.");
+    error(ecdhconn);
+  }
+
+  load_private_key(ecdhconn);
+  load_public_key(ecdhconn);
+
+  /* Each iteration is a complete session: connect, key agreement, and one key request. */
+  for (int i = 0; i < ecdhconn->bench_iterations; i++)
+  {
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    create_client_socket(ecdhconn);
+
+    /* Process CPU time excludes the wait for the server's reply, leaving the
+     * cost of key generation, signing, verification, and key derivation. */
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &cpu_start);
+    make_ephemeral_keypair(ecdhconn);
+    send_ephemeral_public(ecdhconn);
+    recv_ephemeral_public(ecdhconn);
+    get_session_key(ecdhconn);
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &cpu_end);
+    handshake_cpu += (cpu_end.tv_sec - cpu_start.tv_sec) * 1e6
+      + (cpu_end.tv_nsec - cpu_start.tv_nsec) / 1e3;
+
+    get_operational_key(ecdhconn);
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    latency[i] = (end.tv_sec - start.tv_sec) * 1e3
+      + (end.tv_nsec - start.tv_nsec) / 1e6;
+    total += latency[i];
+
+    reset_session(ecdhconn);
+  }
+
+  qsort(latency, ecdhconn->bench_iterations, sizeof(double), compare_latency);
+  fprintf(stdout,
+          "ECDH handshake + key request latency (%d sessions, %s, TCP_NODELAY %s, TCP_QUICKACK %s):\n"
+          "  mean %.3f ms, p50 %.3f ms, p90 %.3f ms, p99 %.3f ms, max %.3f ms\n"
+          "  client handshake CPU time: mean %.1f us\n",
+          ecdhconn->bench_iterations,
+          ecdhconn->ecdh_suite == KMYTH_ECDH_SUITE_X25519 ? "X25519" : "P-384",
+          ecdhconn->tcp_nodelay ? "on" : "off",
+          ecdhconn->tcp_quickack ? "on" : "off",
+          total / ecdhconn->bench_iterations,
+          latency_percentile(latency, ecdhconn->bench_iterations, 0.50),
+          latency_percentile(latency, ecdhconn->bench_iterations, 0.90),
+          latency_percentile(latency, ecdhconn->bench_iterations, 0.99),
+          latency[ecdhconn->bench_iterations - 1],
+          handshake_cpu / ecdhconn->bench_iterations);
+
+  free(latency);
+}
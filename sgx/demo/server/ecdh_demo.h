@@ -15,6 +15,7 @@
 #include <stdio.h>
 #include <sys/socket.h>
 #include <sys/wait.h>
+#include <time.h>
 #include <unistd.h>
 
 #include <openssl/evp.h>
@@ -43,10 +44,14 @@ typedef struct ECDHServer
   char *port;
   char *ip;
   int maxconn;
+  int bench_iterations;
+  bool tcp_nodelay;
+  bool tcp_quickack;
   int socket_fd;
   EVP_PKEY *local_privkey;
   EVP_PKEY *remote_pubkey;
-  EC_KEY *local_ephemeral_keypair;
+  int ecdh_suite;
+  EVP_PKEY *local_ephemeral_keypair;
   unsigned char *remote_ephemeral_pubkey;
   size_t remote_ephemeral_pubkey_len;
   unsigned char *session_key;
@@ -62,6 +67,10 @@ static const struct option longopts[] = {
   {"ip", required_argument, 0, 'i'},
   // Test options
   {"maxconn", required_argument, 0, 'm'},
+  {"bench", required_argument, 0, 'b'},
+  {"nagle", no_argument, 0, 'n'},
+  {"quickack", no_argument, 0, 'q'},
+  {"x25519", no_argument, 0, 'x'},
   // Misc
   {"help", no_argument, 0, 'h'},
   {0, 0, 0, 0}
@@ -82,6 +91,7 @@ void ecdh_recv_decrypt(ECDHServer * ecdhconn, unsigned char **plaintext, size_t
 
 void create_server_socket(ECDHServer * ecdhconn);
 void create_client_socket(ECDHServer * ecdhconn);
+void set_tcp_options(ECDHServer * ecdhconn);
 
 void load_private_key(ECDHServer * ecdhconn);
 void load_public_key(ECDHServer * ecdhconn);
@@ -96,7 +106,10 @@ void get_session_key(ECDHServer * ecdhconn);
 void send_operational_key(ECDHServer * ecdhconn);
 void get_operational_key(ECDHServer * ecdhconn);
 
+void reset_session(ECDHServer * ecdhconn);
+
 void server_main(ECDHServer * ecdhconn);
 void client_main(ECDHServer * ecdhconn);
+void client_bench(ECDHServer * ecdhconn);
 
 #endif
@@ -71,8 +71,11 @@ static void proxy_usage(const char *prog)
     "  -C or --ca-path         Optional certificate file used to verify the remote server (if not specified, the default system CA chain will be used instead).\n"
     "  -R or --client-key      Local private key PEM file used for TLS connections.\n"
     "  -U or --client-cert     Local certificate PEM file used for TLS connections.\n"
+    "Pooled Mode --\n"
+    "  -N or --pool-size       Serve all ECDH clients from an event loop, forwarding their requests over this many persistent TLS connections (by default, each client is served by its own process and TLS connection).\n"
+    "  -W or --workers         Number of event loop processes in pooled mode, each with its own pool (default 1).\n"
     "Test Options --\n"
-    "  -m or --maxconn  The number of connections the server will accept before exiting (unlimited by default, or if the value is not a positive integer).\n"
+    "  -m or --maxconn  The number of connections the server will accept before exiting (unlimited by default, or if the value is not a positive integer; not used in pooled mode).\n"
     "Misc --\n"
     "  -h or --help     Help (displays this usage).\n\n", prog);
 }
@@ -90,7 +93,7 @@ static void proxy_get_options(TLSProxy * proxy, int argc, char **argv)
   int option_index = 0;
 
   while ((options =
-          getopt_long(argc, argv, "r:u:p:I:P:C:R:U:m:h", longopts, &option_index)) != -1)
+          getopt_long(argc, argv, "r:u:p:I:P:C:R:U:N:W:m:h", proxy_longopts, &option_index)) != -1)
   {
     switch (options)
     {
@@ -121,6 +124,13 @@ static void proxy_get_options(TLSProxy * proxy, int argc, char **argv)
     case 'U':
       proxy->tlsconn.client_cert_path = optarg;
       break;
+    // Pooled mode
+    case 'N':
+      proxy->pool_size = atoi(optarg);
+      break;
+    case 'W':
+      proxy->workers = atoi(optarg);
+      break;
     // Test
     case 'm':
       proxy->ecdhconn.maxconn = atoi(optarg);
@@ -151,6 +161,19 @@ void proxy_check_options(TLSProxy * proxy)
     fprintf(stderr, "Remote port number argument (-P) is required.\n");
     err = true;
   }
+  if (proxy->pool_size < 0 || proxy->pool_size > PROXY_MAX_POOL_SIZE)
+  {
+    fprintf(stderr, "Pool size argument (-N) must be between 1 and %d.\n",
+            PROXY_MAX_POOL_SIZE);
+    err = true;
+  }
+  if (proxy->workers < 0 || proxy->workers > PROXY_MAX_WORKERS
+      || (proxy->workers > 0 && proxy->pool_size == 0))
+  {
+    fprintf(stderr, "Workers argument (-W) must be between 1 and %d, "
+            "and requires a pool size (-N).\n", PROXY_MAX_WORKERS);
+    err = true;
+  }
   if (err)
   {
     kmyth_log(LOG_ERR, "Invalid command-line arguments.");
@@ -171,7 +194,7 @@ static void log_openssl_error(unsigned long err, const char* const label)
   }
 }
 
-static int tls_config_ctx(TLSConnection * tlsconn)
+int tls_config_ctx(TLSConnection * tlsconn)
 {
   int ret;
   unsigned long ssl_err;
@@ -254,7 +277,7 @@ static int tls_config_ctx(TLSConnection * tlsconn)
   return 0;
 }
 
-static int tls_config_conn(TLSConnection * tlsconn)
+int tls_config_conn(TLSConnection * tlsconn)
 {
   int ret;
   unsigned long ssl_err;
@@ -335,7 +358,7 @@ static void tls_get_verify_error(TLSConnection * tlsconn)
   }
 }
 
-static int tls_connect(TLSConnection * tlsconn)
+int tls_connect(TLSConnection * tlsconn)
 {
   int ret;
   unsigned long ssl_err;
@@ -362,9 +385,10 @@ static int setup_ecdhconn(TLSProxy * proxy)
   load_private_key(ecdhconn);
   load_public_key(ecdhconn);
 
-  make_ephemeral_keypair(ecdhconn);
-
+  /* The client's contribution determines the suite of the proxy's key pair. */
   recv_ephemeral_public(ecdhconn);
+
+  make_ephemeral_keypair(ecdhconn);
   send_ephemeral_public(ecdhconn);
 
   get_session_key(ecdhconn);
@@ -454,6 +478,12 @@ void proxy_start(TLSProxy * proxy)
 
 void proxy_main(TLSProxy * proxy)
 {
+  if (proxy->pool_size > 0)
+  {
+    proxy_pool_main(proxy);
+    return;
+  }
+
   // The ECDH setup must come first because it forks a new process to handle each new connection.
   setup_ecdhconn(proxy);
   setup_tlsconn(proxy);
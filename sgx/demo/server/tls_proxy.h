@@ -14,6 +14,12 @@
 
 #include "ecdh_demo.h"
 
+/**
+ * @brief Limits on the pooled (event loop) mode options.
+ */
+#define PROXY_MAX_POOL_SIZE 256
+#define PROXY_MAX_WORKERS 64
+
 typedef struct TLSConnection
 {
   char *host;
@@ -29,6 +35,8 @@ typedef struct TLSProxy
 {
   TLSConnection tlsconn;
   ECDHServer ecdhconn;
+  int pool_size;
+  int workers;
 } TLSProxy;
 
 static const struct option proxy_longopts[] = {
@@ -42,6 +50,9 @@ static const struct option proxy_longopts[] = {
   {"ca-path", required_argument, 0, 'C'},
   {"client-key", required_argument, 0, 'R'},
   {"client-cert", required_argument, 0, 'U'},
+  // Pooled mode
+  {"pool-size", required_argument, 0, 'N'},
+  {"workers", required_argument, 0, 'W'},
   // Test options
   {"maxconn", required_argument, 0, 'm'},
   // Misc
@@ -49,4 +60,13 @@ static const struct option proxy_longopts[] = {
   {0, 0, 0, 0}
 };
 
+void proxy_cleanup(TLSProxy * proxy);
+void proxy_error(TLSProxy * proxy);
+
+int tls_config_ctx(TLSConnection * tlsconn);
+int tls_config_conn(TLSConnection * tlsconn);
+int tls_connect(TLSConnection * tlsconn);
+
+void proxy_pool_main(TLSProxy * proxy);
+
 #endif
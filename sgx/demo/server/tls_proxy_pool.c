@@ -0,0 +1,1480 @@
+/**
+ * @file tls_proxy_pool.c
+ * @brief Pooled (event loop) mode for the ECDHE/TLS proxy application.
+ *
+ * In pooled mode one process serves many ECDH clients at once. Every
+ * socket is non-blocking and driven by a single epoll loop: client
+ * sessions perform the ECDH key agreement and then send encrypted KMIP
+ * requests, which are queued and forwarded, one at a time per connection,
+ * over a fixed pool of persistent (keep-alive) TLS connections to the
+ * remote server, whose connects and handshakes are also driven by the loop.
+ * Each response is returned to the session that sent the request, in the
+ * order that session sent its requests. Several
+ * loops (worker processes) may share the listening socket.
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+
+#include <openssl/err.h>
+#include <openssl/ssl.h>
+
+#include "ecdh_demo.h"
+#include "tls_proxy.h"
+
+#define PROXY_MAX_EVENTS 64
+#define PROXY_BUFFER_BLOCK_SIZE 4096
+
+// Most requests a single session may have queued or in flight.
+#define PROXY_MAX_SESSION_REQUESTS 16
+
+// Most client sessions a single loop serves at once; further clients wait
+// in the listen backlog (or are taken by another worker).
+#define PROXY_MAX_SESSIONS 1024
+
+// A KMIP message starts with an 8-byte TTLV header (tag, type, length).
+#define KMIP_HEADER_SIZE 8
+
+// The largest key agreement message a client may send.
+#define PROXY_MAX_CONTRIBUTION (sizeof(size_t) + sizeof(unsigned int) \
+                                + 2 * ECDH_MAX_MSG_SIZE)
+
+typedef enum ProxyHandleType
+{
+  HANDLE_LISTEN,
+  HANDLE_SIGNAL,
+  HANDLE_SESSION,
+  HANDLE_BACKEND
+} ProxyHandleType;
+
+// Every object registered with epoll starts with a handle, so that the
+// event data pointer identifies both the object and its type.
+typedef struct ProxyHandle
+{
+  ProxyHandleType type;
+  int fd;
+} ProxyHandle;
+
+typedef struct ProxyBuffer
+{
+  unsigned char *data;
+  size_t len;
+  size_t cap;
+} ProxyBuffer;
+
+typedef enum SessionState
+{
+  SESSION_KEY_AGREEMENT,
+  SESSION_ESTABLISHED
+} SessionState;
+
+typedef struct ProxySession
+{
+  ProxyHandle handle;
+  SessionState state;
+  ProxyBuffer in;
+  ProxyBuffer out;
+  bool want_write;
+  bool closed;
+  int pending;
+  unsigned int next_seq;        // sequence number of the next request
+  unsigned int next_reply;      // sequence number of the next response due
+  struct ProxyRequest *held;    // responses completed early, by seq
+  unsigned char *session_key;
+  unsigned int session_key_len;
+  struct ProxySession *prev;
+  struct ProxySession *next;
+} ProxySession;
+
+typedef struct ProxyRequest
+{
+  ProxySession *session;        // NULL once the session has closed
+  unsigned int seq;             // position among the session's requests
+  unsigned char *data;
+  size_t len;
+  int retries;
+  struct ProxyRequest *next;
+} ProxyRequest;
+
+typedef struct ProxyBackend
+{
+  ProxyHandle handle;
+  TLSConnection tlsconn;
+  SSL *ssl;
+  ProxyRequest *request;        // in flight, NULL if the connection is idle
+  bool connecting;              // TCP connect or TLS handshake under way
+  bool write_pending;
+  ProxyBuffer response;
+} ProxyBackend;
+
+typedef struct ProxyLoop
+{
+  TLSProxy *proxy;
+  int epoll_fd;
+  ProxyHandle listen_handle;
+  ProxyHandle signal_handle;
+  SSL_CTX *tls_ctx;
+  ProxyBackend *pool;
+  int pool_size;
+  ProxyRequest *queue_head;
+  ProxyRequest *queue_tail;
+  ProxySession *sessions;
+  ProxySession *closed;         // closed during the current batch of events
+  size_t session_count;
+  bool accepting;               // listening socket registered with epoll
+  bool running;
+} ProxyLoop;
+
+static void dispatch_requests(ProxyLoop * loop);
+
+/*****************************************************************************
+ * Buffers
+ ****************************************************************************/
+
+static int buffer_reserve(ProxyBuffer * buf, size_t extra)
+{
+  size_t cap = (buf->cap > 0) ? buf->cap : PROXY_BUFFER_BLOCK_SIZE;
+  unsigned char *data = NULL;
+
+  if (buf->len + extra <= buf->cap)
+  {
+    return 0;
+  }
+  while (cap < buf->len + extra)
+  {
+    cap *= 2;
+  }
+
+  // buffers hold key material, so move (and clear) rather than realloc
+  data = calloc(cap, sizeof(unsigned char));
+  if (data == NULL)
+  {
+    kmyth_log(LOG_ERR, "Failed to allocate a proxy buffer.");
+    return 1;
+  }
+  if (buf->data != NULL)
+  {
+    memcpy(data, buf->data, buf->len);
+    kmyth_clear_and_free(buf->data, buf->cap);
+  }
+  buf->data = data;
+  buf->cap = cap;
+
+  return 0;
+}
+
+static int buffer_append(ProxyBuffer * buf, const void *data, size_t len)
+{
+  if (buffer_reserve(buf, len))
+  {
+    return 1;
+  }
+  memcpy(buf->data + buf->len, data, len);
+  buf->len += len;
+
+  return 0;
+}
+
+static void buffer_consume(ProxyBuffer * buf, size_t len)
+{
+  memmove(buf->data, buf->data + len, buf->len - len);
+  buf->len -= len;
+  kmyth_clear(buf->data + buf->len, len);
+}
+
+static void buffer_free(ProxyBuffer * buf)
+{
+  if (buf->data != NULL)
+  {
+    kmyth_clear_and_free(buf->data, buf->cap);
+  }
+  secure_memset(buf, 0, sizeof(ProxyBuffer));
+}
+
+static size_t kmip_message_len(const unsigned char *header)
+{
+  return KMIP_HEADER_SIZE + (((size_t) header[4] << 24)
+                             | ((size_t) header[5] << 16)
+                             | ((size_t) header[6] << 8) | header[7]);
+}
+
+static void set_events(ProxyLoop * loop, ProxyHandle * handle,
+                       uint32_t events)
+{
+  struct epoll_event ev = {.events = events,.data.ptr = handle };
+
+  if (epoll_ctl(loop->epoll_fd, EPOLL_CTL_MOD, handle->fd, &ev))
+  {
+    kmyth_log(LOG_ERR, "epoll_ctl failed: %s", strerror(errno));
+  }
+}
+
+/*****************************************************************************
+ * Requests
+ ****************************************************************************/
+
+static void free_request(ProxyRequest * request)
+{
+  kmyth_clear_and_free(request->data, request->len);
+  free(request);
+}
+
+static void enqueue_request(ProxyLoop * loop, ProxyRequest * request)
+{
+  request->next = NULL;
+  if (loop->queue_tail == NULL)
+  {
+    loop->queue_head = request;
+  }
+  else
+  {
+    loop->queue_tail->next = request;
+  }
+  loop->queue_tail = request;
+}
+
+static void requeue_request(ProxyLoop * loop, ProxyRequest * request)
+{
+  request->next = loop->queue_head;
+  loop->queue_head = request;
+  if (loop->queue_tail == NULL)
+  {
+    loop->queue_tail = request;
+  }
+}
+
+static ProxyRequest *dequeue_request(ProxyLoop * loop)
+{
+  ProxyRequest *request = loop->queue_head;
+
+  if (request != NULL)
+  {
+    loop->queue_head = request->next;
+    if (loop->queue_head == NULL)
+    {
+      loop->queue_tail = NULL;
+    }
+    request->next = NULL;
+  }
+
+  return request;
+}
+
+/*****************************************************************************
+ * Client sessions
+ ****************************************************************************/
+
+static void session_close(ProxyLoop * loop, ProxySession * session)
+{
+  if (session->closed)
+  {
+    return;
+  }
+  session->closed = true;
+
+  epoll_ctl(loop->epoll_fd, EPOLL_CTL_DEL, session->handle.fd, NULL);
+  close(session->handle.fd);
+
+  // Detach the session from its outstanding requests: queued ones are
+  // dropped and responses to in-flight ones are discarded.
+  for (ProxyRequest * r = loop->queue_head; r != NULL; r = r->next)
+  {
+    if (r->session == session)
+    {
+      r->session = NULL;
+    }
+  }
+  for (int i = 0; i < loop->pool_size; i++)
+  {
+    if (loop->pool[i].request != NULL
+        && loop->pool[i].request->session == session)
+    {
+      loop->pool[i].request->session = NULL;
+    }
+  }
+
+  // Unlink now, free once the current batch of events has been handled.
+  if (session->prev != NULL)
+  {
+    session->prev->next = session->next;
+  }
+  else
+  {
+    loop->sessions = session->next;
+  }
+  if (session->next != NULL)
+  {
+    session->next->prev = session->prev;
+  }
+  session->prev = NULL;
+  session->next = loop->closed;
+  loop->closed = session;
+  loop->session_count--;
+
+  kmyth_log(LOG_DEBUG, "Closed ECDH session (%zu open)", loop->session_count);
+}
+
+static void free_closed_sessions(ProxyLoop * loop)
+{
+  while (loop->closed != NULL)
+  {
+    ProxySession *session = loop->closed;
+
+    loop->closed = session->next;
+    buffer_free(&session->in);
+    buffer_free(&session->out);
+    while (session->held != NULL)
+    {
+      ProxyRequest *held = session->held;
+
+      session->held = held->next;
+      free_request(held);
+    }
+    if (session->session_key != NULL)
+    {
+      kmyth_clear_and_free(session->session_key, session->session_key_len);
+    }
+    free(session);
+  }
+}
+
+static int session_flush(ProxyLoop * loop, ProxySession * session)
+{
+  while (session->out.len > 0)
+  {
+    ssize_t sent = send(session->handle.fd, session->out.data,
+                        session->out.len, MSG_NOSIGNAL);
+
+    if (sent > 0)
+    {
+      buffer_consume(&session->out, sent);
+      continue;
+    }
+    if (sent < 0 && errno == EINTR)
+    {
+      continue;
+    }
+    if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+    {
+      break;
+    }
+    return 1;
+  }
+
+  // only ask for EPOLLOUT while there is something left to send
+  if (session->want_write != (session->out.len > 0))
+  {
+    session->want_write = (session->out.len > 0);
+    set_events(loop, &session->handle,
+               EPOLLIN | (session->want_write ? EPOLLOUT : 0));
+  }
+
+  return 0;
+}
+
+static int session_send(ProxyLoop * loop, ProxySession * session,
+                        unsigned char *plaintext, size_t plaintext_len)
+{
+  struct ECDHMessageHeader header;
+  unsigned char *ciphertext = NULL;
+  size_t ciphertext_len = 0;
+  int ret;
+
+  if (aes_gcm_encrypt(session->session_key, session->session_key_len,
+                      plaintext, plaintext_len,
+                      &ciphertext, &ciphertext_len))
+  {
+    kmyth_log(LOG_ERR, "Failed to encrypt a message.");
+    return 1;
+  }
+  if (ciphertext_len > ECDH_MAX_MSG_SIZE)
+  {
+    kmyth_log(LOG_ERR, "Response too large for an ECDH message.");
+    kmyth_clear_and_free(ciphertext, ciphertext_len);
+    return 1;
+  }
+
+  secure_memset(&header, 0, sizeof(header));
+  header.msg_size = ciphertext_len;
+  ret = buffer_append(&session->out, &header, sizeof(header))
+    || buffer_append(&session->out, ciphertext, ciphertext_len);
+  kmyth_clear_and_free(ciphertext, ciphertext_len);
+
+  return ret || session_flush(loop, session);
+}
+
+/*
+ * Requests of one session may complete out of order, on different backend
+ * connections. A response that is not the next one due is held, in place
+ * of its request data, until the responses before it have been sent.
+ */
+static int session_hold_response(ProxySession * session,
+                                 ProxyRequest * request,
+                                 unsigned char *response, size_t response_len)
+{
+  unsigned char *copy = malloc(response_len);
+  ProxyRequest **link = &session->held;
+
+  if (copy == NULL)
+  {
+    kmyth_log(LOG_ERR, "Failed to allocate a held response.");
+    return 1;
+  }
+  memcpy(copy, response, response_len);
+  kmyth_clear_and_free(request->data, request->len);
+  request->data = copy;
+  request->len = response_len;
+
+  while (*link != NULL && (int) ((*link)->seq - request->seq) < 0)
+  {
+    link = &(*link)->next;
+  }
+  request->next = *link;
+  *link = request;
+
+  return 0;
+}
+
+static int session_send_held(ProxyLoop * loop, ProxySession * session)
+{
+  while (session->held != NULL && session->held->seq == session->next_reply)
+  {
+    ProxyRequest *held = session->held;
+    int ret;
+
+    session->held = held->next;
+    session->pending--;
+    session->next_reply++;
+    ret = session_send(loop, session, held->data, held->len);
+    free_request(held);
+    if (ret)
+    {
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
+/*
+ * Each of the following returns 1 if it consumed a complete message from
+ * the session input, 0 if more input is needed, and -1 on error.
+ */
+static int session_key_agreement(ProxyLoop * loop, ProxySession * session)
+{
+  ECDHServer *ecdhconn = &loop->proxy->ecdhconn;
+  ProxyBuffer *in = &session->in;
+  size_t remote_pub_len = 0;
+  unsigned int remote_sig_len = 0;
+  size_t sig_offset = 0;
+  int suite = KMYTH_ECDH_SUITE_P384;
+  EVP_PKEY *local_keypair = NULL;
+  unsigned char *secret = NULL;
+  size_t secret_len = 0;
+  unsigned char *local_pub = NULL;
+  size_t local_pub_len = 0;
+  unsigned char *local_sig = NULL;
+  unsigned int local_sig_len = 0;
+  int ret = -1;
+
+  if (in->len < sizeof(remote_pub_len))
+  {
+    return 0;
+  }
+  memcpy(&remote_pub_len, in->data, sizeof(remote_pub_len));
+  if (remote_pub_len > ECDH_MAX_MSG_SIZE)
+  {
+    kmyth_log(LOG_ERR, "Received invalid public key size.");
+    return -1;
+  }
+
+  sig_offset = sizeof(remote_pub_len) + remote_pub_len;
+  if (in->len < sig_offset + sizeof(remote_sig_len))
+  {
+    return 0;
+  }
+  memcpy(&remote_sig_len, in->data + sig_offset, sizeof(remote_sig_len));
+  if (remote_sig_len > ECDH_MAX_MSG_SIZE)
+  {
+    kmyth_log(LOG_ERR, "Received invalid public key signature size.");
+    return -1;
+  }
+  sig_offset += sizeof(remote_sig_len);
+  if (in->len < sig_offset + remote_sig_len)
+  {
+    return 0;
+  }
+
+  if (verify_buffer(ecdhconn->remote_pubkey,
+                    in->data + sizeof(remote_pub_len), remote_pub_len,
+                    in->data + sig_offset, remote_sig_len) != EXIT_SUCCESS)
+  {
+    kmyth_log(LOG_ERR, "signature of ECDH remote 'public key' invalid");
+    return -1;
+  }
+
+  // answer with a contribution of the suite the client chose
+  if (get_ecdh_suite(in->data + sizeof(remote_pub_len), remote_pub_len,
+                     &suite) != EXIT_SUCCESS
+      || create_ecdh_suite_key_pair(suite, &local_keypair) != EXIT_SUCCESS
+      || compute_ecdh_suite_shared_secret(local_keypair,
+                                          in->data + sizeof(remote_pub_len),
+                                          remote_pub_len,
+                                          &secret, &secret_len)
+      != EXIT_SUCCESS
+      || compute_ecdh_session_key(secret, secret_len,
+                                  &session->session_key,
+                                  &session->session_key_len) != EXIT_SUCCESS)
+  {
+    kmyth_log(LOG_ERR, "ECDH session key computation failed");
+    goto cleanup;
+  }
+
+  if (create_ecdh_suite_public(local_keypair,
+                               &local_pub, &local_pub_len) != EXIT_SUCCESS
+      || sign_buffer(ecdhconn->local_privkey, local_pub, local_pub_len,
+                     &local_sig, &local_sig_len) != EXIT_SUCCESS)
+  {
+    kmyth_log(LOG_ERR, "creation of signed local 'public key' failed");
+    goto cleanup;
+  }
+
+  // the client's contribution came first, reply with ours
+  if (buffer_append(&session->out, &local_pub_len, sizeof(local_pub_len))
+      || buffer_append(&session->out, local_pub, local_pub_len)
+      || buffer_append(&session->out, &local_sig_len, sizeof(local_sig_len))
+      || buffer_append(&session->out, local_sig, local_sig_len))
+  {
+    goto cleanup;
+  }
+
+  buffer_consume(in, sig_offset + remote_sig_len);
+  session->state = SESSION_ESTABLISHED;
+  ret = 1;
+
+cleanup:
+  EVP_PKEY_free(local_keypair);
+  if (secret != NULL)
+  {
+    kmyth_clear_and_free(secret, secret_len);
+  }
+  if (local_pub != NULL)
+  {
+    kmyth_clear_and_free(local_pub, local_pub_len);
+  }
+  if (local_sig != NULL)
+  {
+    kmyth_clear_and_free(local_sig, local_sig_len);
+  }
+
+  return ret;
+}
+
+static int session_request(ProxyLoop * loop, ProxySession * session)
+{
+  ProxyBuffer *in = &session->in;
+  struct ECDHMessageHeader header;
+  unsigned char *plaintext = NULL;
+  size_t plaintext_len = 0;
+  ProxyRequest *request = NULL;
+
+  if (in->len < sizeof(header))
+  {
+    return 0;
+  }
+  memcpy(&header, in->data, sizeof(header));
+  if (header.msg_size > ECDH_MAX_MSG_SIZE)
+  {
+    kmyth_log(LOG_ERR, "Received invalid ECDH message header.");
+    return -1;
+  }
+  if (in->len < sizeof(header) + header.msg_size)
+  {
+    return 0;
+  }
+
+  if (aes_gcm_decrypt(session->session_key, session->session_key_len,
+                      in->data + sizeof(header), header.msg_size,
+                      &plaintext, &plaintext_len))
+  {
+    kmyth_log(LOG_ERR, "Failed to decrypt a message.");
+    return -1;
+  }
+  buffer_consume(in, sizeof(header) + header.msg_size);
+
+  // each message must carry exactly one KMIP request
+  if (plaintext_len < KMIP_HEADER_SIZE
+      || kmip_message_len(plaintext) != plaintext_len)
+  {
+    kmyth_log(LOG_ERR, "ECDH message is not a single KMIP request.");
+    kmyth_clear_and_free(plaintext, plaintext_len);
+    return -1;
+  }
+  if (session->pending >= PROXY_MAX_SESSION_REQUESTS)
+  {
+    kmyth_log(LOG_ERR, "Too many outstanding requests on an ECDH session.");
+    kmyth_clear_and_free(plaintext, plaintext_len);
+    return -1;
+  }
+
+  request = calloc(1, sizeof(ProxyRequest));
+  if (request == NULL)
+  {
+    kmyth_log(LOG_ERR, "Failed to allocate a proxy request.");
+    kmyth_clear_and_free(plaintext, plaintext_len);
+    return -1;
+  }
+  request->session = session;
+  request->seq = session->next_seq++;
+  request->data = plaintext;
+  request->len = plaintext_len;
+  enqueue_request(loop, request);
+  session->pending++;
+
+  return 1;
+}
+
+static void session_readable(ProxyLoop * loop, ProxySession * session)
+{
+  int ret = 0;
+
+  while (!session->closed)
+  {
+    if (buffer_reserve(&session->in, PROXY_BUFFER_BLOCK_SIZE))
+    {
+      session_close(loop, session);
+      return;
+    }
+
+    ssize_t received = recv(session->handle.fd,
+                            session->in.data + session->in.len,
+                            session->in.cap - session->in.len, 0);
+
+    if (received == 0)
+    {
+      session_close(loop, session);
+      return;
+    }
+    if (received < 0)
+    {
+      if (errno == EINTR)
+      {
+        continue;
+      }
+      if (errno != EAGAIN && errno != EWOULDBLOCK)
+      {
+        kmyth_log(LOG_ERR, "ECDH session read failed: %s", strerror(errno));
+        session_close(loop, session);
+      }
+      break;
+    }
+    session->in.len += received;
+
+    // consume every complete message, so at most a partial one is left
+    do
+    {
+      ret = (session->state == SESSION_KEY_AGREEMENT)
+        ? session_key_agreement(loop, session)
+        : session_request(loop, session);
+    }
+    while (ret == 1);
+
+    if (ret < 0 || session->in.len > PROXY_MAX_CONTRIBUTION)
+    {
+      session_close(loop, session);
+      return;
+    }
+  }
+
+  if (!session->closed && session_flush(loop, session))
+  {
+    session_close(loop, session);
+  }
+}
+
+static void session_event(ProxyLoop * loop, ProxySession * session,
+                          uint32_t events)
+{
+  if (session->closed)
+  {
+    return;
+  }
+
+  if (events & (EPOLLIN | EPOLLERR | EPOLLHUP))
+  {
+    session_readable(loop, session);
+  }
+  if (!session->closed && (events & EPOLLOUT))
+  {
+    if (session_flush(loop, session))
+    {
+      session_close(loop, session);
+    }
+  }
+}
+
+static void set_accepting(ProxyLoop * loop, bool accepting)
+{
+  // With several workers on one listening socket, wake only one of them
+  // per new connection. An EPOLLEXCLUSIVE registration cannot be modified,
+  // so it is removed while the loop is full and added back afterwards.
+  struct epoll_event ev = {.events = EPOLLIN | EPOLLEXCLUSIVE,
+    .data.ptr = &loop->listen_handle
+  };
+  int op = accepting ? EPOLL_CTL_ADD : EPOLL_CTL_DEL;
+
+  if (epoll_ctl(loop->epoll_fd, op, loop->listen_handle.fd, &ev))
+  {
+    kmyth_log(LOG_ERR, "epoll_ctl failed: %s", strerror(errno));
+    return;
+  }
+  loop->accepting = accepting;
+  if (!accepting)
+  {
+    kmyth_log(LOG_WARNING, "Session limit (%d) reached, pausing accepts",
+              PROXY_MAX_SESSIONS);
+  }
+}
+
+static void accept_sessions(ProxyLoop * loop)
+{
+  ECDHServer *ecdhconn = &loop->proxy->ecdhconn;
+
+  while (loop->session_count < PROXY_MAX_SESSIONS)
+  {
+    int fd = accept4(loop->listen_handle.fd, NULL, NULL,
+                     SOCK_NONBLOCK | SOCK_CLOEXEC);
+
+    if (fd == -1)
+    {
+      if (errno == EINTR || errno == ECONNABORTED)
+      {
+        continue;
+      }
+      if (errno != EAGAIN && errno != EWOULDBLOCK)
+      {
+        kmyth_log(LOG_ERR, "Socket accept failed: %s", strerror(errno));
+      }
+      return;
+    }
+
+    // the TCP options only affect latency, so failing to set them is not fatal
+    set_socket_tcp_options(fd, ecdhconn->tcp_nodelay, ecdhconn->tcp_quickack);
+
+    ProxySession *session = calloc(1, sizeof(ProxySession));
+    struct epoll_event ev = {.events = EPOLLIN };
+
+    if (session == NULL)
+    {
+      kmyth_log(LOG_ERR, "Failed to allocate an ECDH session.");
+      close(fd);
+      continue;
+    }
+    session->handle.type = HANDLE_SESSION;
+    session->handle.fd = fd;
+    session->state = SESSION_KEY_AGREEMENT;
+
+    ev.data.ptr = &session->handle;
+    if (epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, fd, &ev))
+    {
+      kmyth_log(LOG_ERR, "epoll_ctl failed: %s", strerror(errno));
+      close(fd);
+      free(session);
+      continue;
+    }
+
+    session->next = loop->sessions;
+    if (loop->sessions != NULL)
+    {
+      loop->sessions->prev = session;
+    }
+    loop->sessions = session;
+    loop->session_count++;
+
+    kmyth_log(LOG_DEBUG, "Accepted ECDH session (%zu open)",
+              loop->session_count);
+  }
+
+  // full: leave further clients in the backlog until a session closes
+  set_accepting(loop, false);
+}
+
+/*****************************************************************************
+ * Backend (TLS) connections
+ ****************************************************************************/
+
+static void fail_request(ProxyLoop * loop, ProxyRequest * request)
+{
+  // The client expects exactly one response per request: closing the
+  // session is how it learns that none is coming.
+  if (request->session != NULL)
+  {
+    session_close(loop, request->session);
+  }
+  free_request(request);
+}
+
+static int backend_handshake(ProxyLoop * loop, ProxyBackend * backend)
+{
+  TLSConnection *tlsconn = &backend->tlsconn;
+  int index = (int) (backend - loop->pool);
+  int ret;
+
+  ERR_clear_error();
+  ret = BIO_do_connect(tlsconn->conn);
+  if (ret <= 0 && !BIO_should_retry(tlsconn->conn))
+  {
+    long verify = SSL_get_verify_result(backend->ssl);
+
+    // both connection and certificate verification failures end up here
+    kmyth_log(LOG_ERR, "Pooled TLS connection %d failed: %s", index,
+              ERR_error_string(ERR_get_error(), NULL));
+    if (verify != X509_V_OK)
+    {
+      kmyth_log(LOG_ERR, "SSL_get_verify_result: %s",
+                X509_verify_cert_error_string(verify));
+    }
+    return 1;
+  }
+
+  // the socket exists once the first connect attempt has been made
+  if (backend->handle.fd == -1)
+  {
+    struct epoll_event ev = {.events = EPOLLOUT,.data.ptr = &backend->handle };
+    int fd = BIO_get_fd(tlsconn->conn, NULL);
+
+    if (fd < 0 || epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, fd, &ev))
+    {
+      kmyth_log(LOG_ERR, "Failed to register the TLS connection.");
+      return 1;
+    }
+    backend->handle.fd = fd;
+    set_socket_tcp_options(fd, true, false);
+  }
+
+  if (ret <= 0)
+  {
+    // a pending TCP connect (BIO_should_io_special) waits for writability
+    set_events(loop, &backend->handle,
+               BIO_should_read(tlsconn->conn) ? EPOLLIN : EPOLLOUT);
+    return 0;
+  }
+
+  backend->connecting = false;
+  set_events(loop, &backend->handle, EPOLLIN);
+  kmyth_log(LOG_DEBUG, "Connected pooled TLS connection %d", index);
+
+  return 0;
+}
+
+static int backend_connect(ProxyLoop * loop, ProxyBackend * backend)
+{
+  TLSConnection *tlsconn = &backend->tlsconn;
+
+  // Each connection shares the loop's SSL_CTX. The connect and handshake
+  // are non-blocking and finished by backend_event(); only the host name
+  // lookup blocks.
+  *tlsconn = loop->proxy->tlsconn;
+  tlsconn->ctx = loop->tls_ctx;
+  tlsconn->conn = NULL;
+  backend->handle.type = HANDLE_BACKEND;
+  backend->handle.fd = -1;
+
+  if (tls_config_conn(tlsconn))
+  {
+    goto error;
+  }
+  BIO_get_ssl(tlsconn->conn, &backend->ssl);
+  if (backend->ssl == NULL || BIO_set_nbio(tlsconn->conn, 1) != 1)
+  {
+    kmyth_log(LOG_ERR, "Failed to configure the TLS connection.");
+    goto error;
+  }
+
+  backend->connecting = true;
+  if (backend_handshake(loop, backend))
+  {
+    goto error;
+  }
+
+  return 0;
+
+error:
+  if (backend->handle.fd != -1)
+  {
+    epoll_ctl(loop->epoll_fd, EPOLL_CTL_DEL, backend->handle.fd, NULL);
+    backend->handle.fd = -1;
+  }
+  if (tlsconn->conn != NULL)
+  {
+    BIO_free_all(tlsconn->conn);
+    tlsconn->conn = NULL;
+  }
+  backend->ssl = NULL;
+  backend->connecting = false;
+  return 1;
+}
+
+static void backend_close(ProxyLoop * loop, ProxyBackend * backend)
+{
+  ProxyRequest *request = backend->request;
+
+  if (backend->tlsconn.conn != NULL)
+  {
+    if (backend->handle.fd != -1)
+    {
+      epoll_ctl(loop->epoll_fd, EPOLL_CTL_DEL, backend->handle.fd, NULL);
+      backend->handle.fd = -1;
+    }
+    BIO_free_all(backend->tlsconn.conn);
+    backend->tlsconn.conn = NULL;
+  }
+  backend->ssl = NULL;
+  backend->connecting = false;
+  backend->request = NULL;
+  backend->write_pending = false;
+  buffer_free(&backend->response);
+
+  if (request == NULL)
+  {
+    return;
+  }
+
+  // The server may have closed an idle keep-alive connection just as the
+  // request was sent: try once more on another connection.
+  if (request->retries == 0 && request->session != NULL)
+  {
+    request->retries++;
+    requeue_request(loop, request);
+  }
+  else
+  {
+    fail_request(loop, request);
+  }
+}
+
+static int backend_write(ProxyLoop * loop, ProxyBackend * backend)
+{
+  int ret;
+  int err;
+
+  ERR_clear_error();
+  ret = SSL_write(backend->ssl, backend->request->data,
+                  backend->request->len);
+  if (ret > 0)
+  {
+    if (backend->write_pending)
+    {
+      backend->write_pending = false;
+      set_events(loop, &backend->handle, EPOLLIN);
+    }
+    return 0;
+  }
+
+  // a non-blocking SSL_write is retried later with the same arguments
+  err = SSL_get_error(backend->ssl, ret);
+  if (err == SSL_ERROR_WANT_WRITE || err == SSL_ERROR_WANT_READ)
+  {
+    backend->write_pending = true;
+    set_events(loop, &backend->handle,
+               EPOLLIN | ((err == SSL_ERROR_WANT_WRITE) ? EPOLLOUT : 0));
+    return 0;
+  }
+
+  kmyth_log(LOG_ERR, "TLS write error");
+  return 1;
+}
+
+static void backend_deliver(ProxyLoop * loop, ProxyBackend * backend,
+                            size_t response_len)
+{
+  ProxyRequest *request = backend->request;
+  ProxySession *session = request->session;
+
+  backend->request = NULL;
+  if (session != NULL && request->seq != session->next_reply)
+  {
+    if (session_hold_response(session, request, backend->response.data,
+                              response_len))
+    {
+      session_close(loop, session);
+      free_request(request);
+    }
+    buffer_consume(&backend->response, response_len);
+    return;
+  }
+  if (session != NULL)
+  {
+    session->pending--;
+    session->next_reply++;
+    if (session_send(loop, session, backend->response.data, response_len)
+        || session_send_held(loop, session))
+    {
+      session_close(loop, session);
+    }
+  }
+  free_request(request);
+  buffer_consume(&backend->response, response_len);
+}
+
+static int backend_read(ProxyLoop * loop, ProxyBackend * backend)
+{
+  ProxyBuffer *response = &backend->response;
+
+  while (true)
+  {
+    if (buffer_reserve(response, PROXY_BUFFER_BLOCK_SIZE))
+    {
+      return 1;
+    }
+
+    ERR_clear_error();
+    int ret = SSL_read(backend->ssl, response->data + response->len,
+                       response->cap - response->len);
+
+    if (ret <= 0)
+    {
+      int err = SSL_get_error(backend->ssl, ret);
+
+      if (err == SSL_ERROR_WANT_READ || err == SSL_ERROR_WANT_WRITE)
+      {
+        return 0;
+      }
+      if (err == SSL_ERROR_ZERO_RETURN)
+      {
+        kmyth_log(LOG_INFO, "Pooled TLS connection %d closed by the server",
+                  (int) (backend - loop->pool));
+      }
+      else
+      {
+        kmyth_log(LOG_ERR, "TLS read error");
+      }
+      return 1;
+    }
+    response->len += ret;
+
+    // a connection carries one request at a time, so any data is (part
+    // of) the response to it
+    if (backend->request == NULL)
+    {
+      kmyth_log(LOG_ERR, "Unexpected data on a pooled TLS connection.");
+      return 1;
+    }
+    if (response->len < KMIP_HEADER_SIZE)
+    {
+      continue;
+    }
+
+    size_t response_len = kmip_message_len(response->data);
+
+    if (response_len > ECDH_MAX_MSG_SIZE || response->len > response_len)
+    {
+      kmyth_log(LOG_ERR, "Invalid KMIP response on a pooled TLS connection.");
+      return 1;
+    }
+    if (response->len == response_len)
+    {
+      backend_deliver(loop, backend, response_len);
+      return 0;
+    }
+  }
+}
+
+static void backend_event(ProxyLoop * loop, ProxyBackend * backend)
+{
+  // ignore events for a connection closed earlier in this batch
+  if (backend->ssl == NULL)
+  {
+    return;
+  }
+
+  if (backend->connecting)
+  {
+    // once the handshake is done, send the request waiting for it (if any)
+    if (backend_handshake(loop, backend)
+        || (!backend->connecting && backend->request != NULL
+            && backend_write(loop, backend)))
+    {
+      backend_close(loop, backend);
+    }
+    dispatch_requests(loop);
+    return;
+  }
+
+  if (backend->write_pending)
+  {
+    if (backend_write(loop, backend))
+    {
+      backend_close(loop, backend);
+      dispatch_requests(loop);
+      return;
+    }
+    if (backend->write_pending)
+    {
+      return;
+    }
+  }
+
+  if (backend_read(loop, backend))
+  {
+    backend_close(loop, backend);
+  }
+
+  // the connection may be free for the next request
+  dispatch_requests(loop);
+}
+
+static ProxyBackend *idle_backend(ProxyLoop * loop)
+{
+  ProxyBackend *connecting = NULL;
+  ProxyBackend *unconnected = NULL;
+
+  // prefer a connection that is already up, then one on its way up
+  for (int i = 0; i < loop->pool_size; i++)
+  {
+    if (loop->pool[i].request == NULL)
+    {
+      if (loop->pool[i].ssl == NULL)
+      {
+        if (unconnected == NULL)
+        {
+          unconnected = &loop->pool[i];
+        }
+      }
+      else if (!loop->pool[i].connecting)
+      {
+        return &loop->pool[i];
+      }
+      else if (connecting == NULL)
+      {
+        connecting = &loop->pool[i];
+      }
+    }
+  }
+
+  return (connecting != NULL) ? connecting : unconnected;
+}
+
+static void dispatch_requests(ProxyLoop * loop)
+{
+  ProxyBackend *backend = NULL;
+
+  while (loop->queue_head != NULL)
+  {
+    if (loop->queue_head->session == NULL)
+    {
+      // nobody is waiting for the response any more
+      free_request(dequeue_request(loop));
+      continue;
+    }
+
+    backend = idle_backend(loop);
+    if (backend == NULL)
+    {
+      return;
+    }
+
+    ProxyRequest *request = dequeue_request(loop);
+
+    if (backend->ssl == NULL && backend_connect(loop, backend))
+    {
+      kmyth_log(LOG_ERR, "Failed to connect to the remote server.");
+      fail_request(loop, request);
+      continue;
+    }
+
+    // a connection still handshaking sends the request when it is up
+    backend->request = request;
+    if (!backend->connecting && backend_write(loop, backend))
+    {
+      backend_close(loop, backend);
+    }
+  }
+}
+
+/*****************************************************************************
+ * Event loop
+ ****************************************************************************/
+
+static int proxy_loop_init(ProxyLoop * loop, TLSProxy * proxy, int listen_fd,
+                           sigset_t * signals)
+{
+  TLSConnection ctxconn = proxy->tlsconn;
+  struct epoll_event ev;
+
+  secure_memset(loop, 0, sizeof(ProxyLoop));
+  loop->proxy = proxy;
+  loop->epoll_fd = -1;
+  loop->signal_handle.fd = -1;
+  loop->listen_handle.type = HANDLE_LISTEN;
+  loop->listen_handle.fd = listen_fd;
+  loop->signal_handle.type = HANDLE_SIGNAL;
+
+  ctxconn.ctx = NULL;
+  ctxconn.conn = NULL;
+  if (tls_config_ctx(&ctxconn))
+  {
+    SSL_CTX_free(ctxconn.ctx);
+    return 1;
+  }
+  loop->tls_ctx = ctxconn.ctx;
+
+  loop->pool_size = proxy->pool_size;
+  loop->pool = calloc(loop->pool_size, sizeof(ProxyBackend));
+  if (loop->pool == NULL)
+  {
+    kmyth_log(LOG_ERR, "Failed to allocate the TLS connection pool.");
+    return 1;
+  }
+
+  loop->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+  loop->signal_handle.fd = signalfd(-1, signals, SFD_NONBLOCK | SFD_CLOEXEC);
+  if (loop->epoll_fd == -1 || loop->signal_handle.fd == -1)
+  {
+    kmyth_log(LOG_ERR, "Failed to set up the event loop: %s",
+              strerror(errno));
+    return 1;
+  }
+
+  set_accepting(loop, true);
+  if (!loop->accepting)
+  {
+    return 1;
+  }
+  ev.events = EPOLLIN;
+  ev.data.ptr = &loop->signal_handle;
+  if (epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, loop->signal_handle.fd, &ev))
+  {
+    kmyth_log(LOG_ERR, "epoll_ctl failed: %s", strerror(errno));
+    return 1;
+  }
+
+  // Open the pool up front so the first requests don't pay for the TLS
+  // handshakes (which complete in the loop); a connection that fails here
+  // is retried when needed.
+  for (int i = 0; i < loop->pool_size; i++)
+  {
+    if (backend_connect(loop, &loop->pool[i]))
+    {
+      kmyth_log(LOG_WARNING, "Pooled TLS connection %d is not up yet", i);
+    }
+  }
+
+  loop->running = true;
+  return 0;
+}
+
+static void proxy_loop_cleanup(ProxyLoop * loop)
+{
+  while (loop->sessions != NULL)
+  {
+    session_close(loop, loop->sessions);
+  }
+  free_closed_sessions(loop);
+
+  while (loop->queue_head != NULL)
+  {
+    free_request(dequeue_request(loop));
+  }
+
+  if (loop->pool != NULL)
+  {
+    for (int i = 0; i < loop->pool_size; i++)
+    {
+      backend_close(loop, &loop->pool[i]);
+    }
+    free_closed_sessions(loop);
+    while (loop->queue_head != NULL)
+    {
+      free_request(dequeue_request(loop));
+    }
+    free(loop->pool);
+  }
+
+  if (loop->tls_ctx != NULL)
+  {
+    SSL_CTX_free(loop->tls_ctx);
+  }
+  if (loop->signal_handle.fd != -1)
+  {
+    close(loop->signal_handle.fd);
+  }
+  if (loop->epoll_fd != -1)
+  {
+    close(loop->epoll_fd);
+  }
+
+  secure_memset(loop, 0, sizeof(ProxyLoop));
+}
+
+static void proxy_loop_run(ProxyLoop * loop)
+{
+  struct epoll_event events[PROXY_MAX_EVENTS];
+  struct signalfd_siginfo info;
+
+  kmyth_log(LOG_DEBUG, "Starting pooled proxy loop (%d TLS connections)",
+            loop->pool_size);
+
+  while (loop->running)
+  {
+    int count = epoll_wait(loop->epoll_fd, events, PROXY_MAX_EVENTS, -1);
+
+    if (count < 0)
+    {
+      if (errno == EINTR)
+      {
+        continue;
+      }
+      kmyth_log(LOG_ERR, "epoll_wait failed: %s", strerror(errno));
+      break;
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+      ProxyHandle *handle = events[i].data.ptr;
+
+      switch (handle->type)
+      {
+      case HANDLE_LISTEN:
+        accept_sessions(loop);
+        break;
+      case HANDLE_SIGNAL:
+        if (read(handle->fd, &info, sizeof(info)) == sizeof(info))
+        {
+          kmyth_log(LOG_INFO, "Received signal %u, stopping the proxy",
+                    info.ssi_signo);
+          loop->running = false;
+        }
+        break;
+      case HANDLE_SESSION:
+        session_event(loop, (ProxySession *) handle, events[i].events);
+        break;
+      case HANDLE_BACKEND:
+        backend_event(loop, (ProxyBackend *) handle);
+        break;
+      }
+    }
+
+    dispatch_requests(loop);
+    free_closed_sessions(loop);
+
+    if (!loop->accepting && loop->session_count < PROXY_MAX_SESSIONS)
+    {
+      set_accepting(loop, true);
+    }
+  }
+}
+
+static int proxy_worker(TLSProxy * proxy, int listen_fd, sigset_t * signals)
+{
+  ProxyLoop loop;
+  int ret = EXIT_FAILURE;
+
+  if (proxy_loop_init(&loop, proxy, listen_fd, signals) == 0)
+  {
+    proxy_loop_run(&loop);
+    ret = EXIT_SUCCESS;
+  }
+  proxy_loop_cleanup(&loop);
+
+  return ret;
+}
+
+void proxy_pool_main(TLSProxy * proxy)
+{
+  ECDHServer *ecdhconn = &proxy->ecdhconn;
+  int listen_fd = UNSET_FD;
+  int workers = (proxy->workers > 0) ? proxy->workers : 1;
+  pid_t pids[PROXY_MAX_WORKERS];
+  sigset_t signals;
+  int ret = EXIT_SUCCESS;
+
+  load_private_key(ecdhconn);
+  load_public_key(ecdhconn);
+
+  kmyth_log(LOG_DEBUG, "Setting up server socket");
+  if (setup_server_socket(ecdhconn->port, &listen_fd))
+  {
+    kmyth_log(LOG_ERR, "Failed to set up server socket.");
+    proxy_error(proxy);
+  }
+  if (listen(listen_fd, SOMAXCONN)
+      || fcntl(listen_fd, F_SETFL, fcntl(listen_fd, F_GETFL) | O_NONBLOCK))
+  {
+    kmyth_log(LOG_ERR, "Socket listen failed.");
+    close(listen_fd);
+    proxy_error(proxy);
+  }
+
+  // Signals are taken synchronously: by each event loop through a
+  // signalfd, and by the parent of several workers with sigwait().
+  sigemptyset(&signals);
+  sigaddset(&signals, SIGINT);
+  sigaddset(&signals, SIGTERM);
+  if (workers > 1)
+  {
+    sigaddset(&signals, SIGCHLD);
+  }
+  sigprocmask(SIG_BLOCK, &signals, NULL);
+
+  if (workers == 1)
+  {
+    ret = proxy_worker(proxy, listen_fd, &signals);
+    close(listen_fd);
+    if (ret != EXIT_SUCCESS)
+    {
+      proxy_error(proxy);
+    }
+    return;
+  }
+
+  for (int i = 0; i < workers; i++)
+  {
+    pids[i] = fork();
+    if (pids[i] == -1)
+    {
+      kmyth_log(LOG_ERR, "Worker fork failed.");
+      workers = i;
+      ret = EXIT_FAILURE;
+      break;
+    }
+    if (pids[i] == 0)
+    {
+      sigdelset(&signals, SIGCHLD);
+      ret = proxy_worker(proxy, listen_fd, &signals);
+      close(listen_fd);
+      proxy_cleanup(proxy);
+      exit(ret);
+    }
+  }
+  kmyth_log(LOG_DEBUG, "Started %d pooled proxy workers", workers);
+
+  // Run until interrupted or until a worker exits, then stop them all.
+  if (ret == EXIT_SUCCESS)
+  {
+    int sig = 0;
+
+    sigwait(&signals, &sig);
+    if (sig == SIGCHLD)
+    {
+      kmyth_log(LOG_ERR, "A pooled proxy worker exited.");
+      ret = EXIT_FAILURE;
+    }
+  }
+  for (int i = 0; i < workers; i++)
+  {
+    kill(pids[i], SIGTERM);
+  }
+  while (wait(NULL) > 0);
+
+  close(listen_fd);
+  if (ret != EXIT_SUCCESS)
+  {
+    proxy_error(proxy);
+  }
+}
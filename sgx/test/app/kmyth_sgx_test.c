@@ -233,6 +233,372 @@ void test_seal_unseal_nkl(void)
   return;
 }
 
+void test_seal_unseal_nkl_batch(void)
+{
+  const char *data[] = { "first batch secret", "second",
+    "third batch secret, a little longer than the others"
+  };
+  size_t num_inputs = sizeof(data) / sizeof(data[0]);
+  uint8_t *inputs[3];
+  size_t input_lens[3];
+  uint8_t *outputs[3];
+  size_t output_lens[3];
+  uint64_t handle;
+  uint16_t key_policy = SGX_KEYPOLICY_MRSIGNER;
+  sgx_attributes_t attribute_mask;
+
+  attribute_mask.flags = 0;
+  attribute_mask.xfrm = 0;
+
+  int sgx_ret_int;
+  size_t sgx_ret_size;
+  uint32_t sealed_size = 0;
+
+  // The host-side size computation must agree with the enclave's.
+  for (size_t i = 0; i < num_inputs; i++)
+  {
+    inputs[i] = (uint8_t *) data[i];
+    input_lens[i] = strlen(data[i]);
+    enc_get_sealed_size(eid, &sgx_ret_int, input_lens[i], &sealed_size);
+    CU_ASSERT(sgx_ret_int == 0);
+    CU_ASSERT(kmyth_sgx_calc_sealed_size(input_lens[i]) == sealed_size);
+  }
+  CU_ASSERT(kmyth_sgx_calc_sealed_size(UINT32_MAX) == UINT32_MAX);
+
+  CU_ASSERT(kmyth_sgx_seal_nkl_batch
+            (eid, num_inputs, inputs, input_lens, outputs, output_lens,
+             key_policy, attribute_mask) == 0);
+
+  kmyth_unsealed_data_table_initialize(eid, &sgx_ret_int);
+  CU_ASSERT(sgx_ret_int == 0);
+
+  // Each output must be a complete .nkl blob for its own input.
+  for (size_t i = 0; i < num_inputs; i++)
+  {
+    CU_ASSERT(kmyth_sgx_unseal_nkl(eid, outputs[i], output_lens[i], &handle)
+              == 0);
+
+    uint8_t *decrypted = (uint8_t *) malloc(input_lens[i]);
+
+    kmyth_sgx_test_export_from_enclave(eid, &sgx_ret_size, handle,
+                                       input_lens[i], decrypted);
+    CU_ASSERT(sgx_ret_size == input_lens[i]);
+    CU_ASSERT(memcmp(decrypted, data[i], input_lens[i]) == 0);
+    free(decrypted);
+    free(outputs[i]);
+  }
+
+  kmyth_sgx_test_get_unseal_table_size(eid, &sgx_ret_size);
+  CU_ASSERT(sgx_ret_size == 0);
+
+  // An empty input fails the whole batch.
+  input_lens[1] = 0;
+  CU_ASSERT(kmyth_sgx_seal_nkl_batch
+            (eid, num_inputs, inputs, input_lens, outputs, output_lens,
+             key_policy, attribute_mask) == 1);
+  CU_ASSERT(outputs[0] == NULL);
+
+  kmyth_unsealed_data_table_cleanup(eid, &sgx_ret_int);
+  CU_ASSERT(sgx_ret_int == 0);
+  return;
+}
+
+void test_unseal_nkl_batch(void)
+{
+  const char *data[] = { "first batch secret", "second",
+    "third batch secret, a little longer than the others", "fourth"
+  };
+  size_t num_inputs = sizeof(data) / sizeof(data[0]);
+  uint8_t *inputs[4];
+  size_t input_lens[4];
+  uint8_t *sealed[4];
+  size_t sealed_lens[4];
+  uint64_t handles[4];
+  uint16_t key_policy = SGX_KEYPOLICY_MRSIGNER;
+  sgx_attributes_t attribute_mask;
+
+  attribute_mask.flags = 0;
+  attribute_mask.xfrm = 0;
+
+  int sgx_ret_int;
+  size_t sgx_ret_size;
+
+  for (size_t i = 0; i < num_inputs; i++)
+  {
+    inputs[i] = (uint8_t *) data[i];
+    input_lens[i] = strlen(data[i]);
+  }
+  CU_ASSERT(kmyth_sgx_seal_nkl_batch
+            (eid, num_inputs, inputs, input_lens, sealed, sealed_lens,
+             key_policy, attribute_mask) == 0);
+
+  kmyth_unsealed_data_table_initialize(eid, &sgx_ret_int);
+  CU_ASSERT(sgx_ret_int == 0);
+
+  CU_ASSERT(kmyth_sgx_unseal_nkl_batch
+            (eid, num_inputs, sealed, sealed_lens, handles) == 0);
+
+  kmyth_sgx_test_get_unseal_table_size(eid, &sgx_ret_size);
+  CU_ASSERT(sgx_ret_size == num_inputs);
+
+  for (size_t i = 0; i < num_inputs; i++)
+  {
+    uint8_t *decrypted = (uint8_t *) malloc(input_lens[i]);
+
+    kmyth_sgx_test_export_from_enclave(eid, &sgx_ret_size, handles[i],
+                                       input_lens[i], decrypted);
+    CU_ASSERT(sgx_ret_size == input_lens[i]);
+    CU_ASSERT(memcmp(decrypted, data[i], input_lens[i]) == 0);
+    free(decrypted);
+  }
+
+  // A single corrupted blob fails the whole batch, and nothing is
+  // added to the table.
+  sealed[2][0] = 'X';
+  CU_ASSERT(kmyth_sgx_unseal_nkl_batch
+            (eid, num_inputs, sealed, sealed_lens, handles) == 1);
+  kmyth_sgx_test_get_unseal_table_size(eid, &sgx_ret_size);
+  CU_ASSERT(sgx_ret_size == 0);
+
+  kmyth_unsealed_data_table_cleanup(eid, &sgx_ret_int);
+  CU_ASSERT(sgx_ret_int == 0);
+
+  for (size_t i = 0; i < num_inputs; i++)
+  {
+    free(sealed[i]);
+  }
+  return;
+}
+
+void test_unseal_table_budget(void)
+{
+  const char *data[] = { "first budget secret", "second budget secret",
+    "third budget secret", "fourth budget secret"
+  };
+  size_t num_inputs = sizeof(data) / sizeof(data[0]);
+  uint8_t *inputs[4];
+  size_t input_lens[4];
+  uint8_t *sealed[4];
+  size_t sealed_lens[4];
+  uint64_t handles[4];
+  uint16_t key_policy = SGX_KEYPOLICY_MRSIGNER;
+  sgx_attributes_t attribute_mask;
+
+  attribute_mask.flags = 0;
+  attribute_mask.xfrm = 0;
+
+  int sgx_ret_int;
+  size_t sgx_ret_size;
+  uint64_t hits, misses, evictions;
+  size_t resident;
+  size_t total_size = 0;
+
+  for (size_t i = 0; i < num_inputs; i++)
+  {
+    inputs[i] = (uint8_t *) data[i];
+    input_lens[i] = strlen(data[i]);
+    total_size += input_lens[i];
+  }
+  CU_ASSERT(kmyth_sgx_seal_nkl_batch
+            (eid, num_inputs, inputs, input_lens, sealed, sealed_lens,
+             key_policy, attribute_mask) == 0);
+
+  kmyth_unsealed_data_table_initialize(eid, &sgx_ret_int);
+  CU_ASSERT(sgx_ret_int == 0);
+
+  // Leave room for only the two most recently added entries.
+  kmyth_unsealed_data_table_set_budget(eid, &sgx_ret_int,
+                                       input_lens[2] + input_lens[3]);
+  CU_ASSERT(sgx_ret_int == 0);
+
+  for (size_t i = 0; i < num_inputs; i++)
+  {
+    CU_ASSERT(kmyth_sgx_unseal_nkl
+              (eid, sealed[i], sealed_lens[i], &handles[i]) == 0);
+  }
+
+  kmyth_unsealed_data_table_get_stats(eid, &sgx_ret_int, &hits, &misses,
+                                      &evictions, &resident);
+  CU_ASSERT(sgx_ret_int == 0);
+  CU_ASSERT(evictions == 2);
+  CU_ASSERT(resident == input_lens[2] + input_lens[3]);
+
+  // Evicted entries are still in the table, and are unsealed again when
+  // they are retrieved.
+  kmyth_sgx_test_get_unseal_table_size(eid, &sgx_ret_size);
+  CU_ASSERT(sgx_ret_size == num_inputs);
+
+  for (size_t i = 0; i < num_inputs; i++)
+  {
+    uint8_t *decrypted = (uint8_t *) malloc(input_lens[i]);
+
+    kmyth_sgx_test_export_from_enclave(eid, &sgx_ret_size, handles[i],
+                                       input_lens[i], decrypted);
+    CU_ASSERT(sgx_ret_size == input_lens[i]);
+    CU_ASSERT(memcmp(decrypted, data[i], input_lens[i]) == 0);
+    free(decrypted);
+  }
+
+  kmyth_unsealed_data_table_get_stats(eid, &sgx_ret_int, &hits, &misses,
+                                      &evictions, &resident);
+  CU_ASSERT(hits == 2);
+  CU_ASSERT(misses == 2);
+  CU_ASSERT(resident == 0);
+
+  // With no limit, nothing is evicted.
+  kmyth_unsealed_data_table_set_budget(eid, &sgx_ret_int, 0);
+  CU_ASSERT(sgx_ret_int == 0);
+  CU_ASSERT(kmyth_sgx_unseal_nkl_batch
+            (eid, num_inputs, sealed, sealed_lens, handles) == 0);
+  kmyth_unsealed_data_table_get_stats(eid, &sgx_ret_int, &hits, &misses,
+                                      &evictions, &resident);
+  CU_ASSERT(evictions == 2);
+  CU_ASSERT(resident == total_size);
+
+  kmyth_unsealed_data_table_cleanup(eid, &sgx_ret_int);
+  CU_ASSERT(sgx_ret_int == 0);
+
+  for (size_t i = 0; i < num_inputs; i++)
+  {
+    free(sealed[i]);
+  }
+  return;
+}
+
+void test_seal_unseal_nkl_chunked(void)
+{
+  size_t data_len = 3500;
+  uint32_t chunk_size = 1000;
+  uint8_t *data = (uint8_t *) malloc(data_len);
+  uint8_t *output = NULL;
+  size_t output_len = 0;
+  uint64_t handle = 0;
+  uint16_t key_policy = SGX_KEYPOLICY_MRSIGNER;
+  sgx_attributes_t attribute_mask;
+
+  attribute_mask.flags = 0;
+  attribute_mask.xfrm = 0;
+
+  int sgx_ret_int;
+  size_t sgx_ret_size;
+
+  for (size_t i = 0; i < data_len; i++)
+  {
+    data[i] = (uint8_t) (i * 31 + 7);
+  }
+
+  CU_ASSERT(kmyth_sgx_seal_nkl_chunked
+            (eid, data, data_len, chunk_size, &output, &output_len,
+             key_policy, attribute_mask) == 0);
+
+  kmyth_unsealed_data_table_initialize(eid, &sgx_ret_int);
+  CU_ASSERT(sgx_ret_int == 0);
+
+  CU_ASSERT(kmyth_sgx_unseal_nkl_chunked(eid, output, output_len, &handle)
+            == 0);
+
+  uint8_t *decrypted = (uint8_t *) malloc(data_len);
+
+  kmyth_sgx_test_export_from_enclave(eid, &sgx_ret_size, handle, data_len,
+                                     decrypted);
+  CU_ASSERT(sgx_ret_size == data_len);
+  CU_ASSERT(memcmp(decrypted, data, data_len) == 0);
+  free(decrypted);
+
+  // Dropping the last chunk must make the unseal fail.
+  size_t chunk_delim_len = strlen(KMYTH_DELIM_NKL_CHUNK);
+  size_t end_delim_len = strlen(KMYTH_DELIM_END_NKL);
+  size_t last_chunk = 0;
+
+  for (size_t i = 0; i + chunk_delim_len <= output_len; i++)
+  {
+    if (memcmp(output + i, KMYTH_DELIM_NKL_CHUNK, chunk_delim_len) == 0)
+    {
+      last_chunk = i;
+    }
+  }
+  CU_ASSERT(last_chunk > 0);
+  memcpy(output + last_chunk, KMYTH_DELIM_END_NKL, end_delim_len);
+  CU_ASSERT(kmyth_sgx_unseal_nkl_chunked
+            (eid, output, last_chunk + end_delim_len, &handle) == 1);
+  kmyth_sgx_test_get_unseal_table_size(eid, &sgx_ret_size);
+  CU_ASSERT(sgx_ret_size == 0);
+
+  kmyth_unsealed_data_table_cleanup(eid, &sgx_ret_int);
+  CU_ASSERT(sgx_ret_int == 0);
+
+  free(output);
+  free(data);
+  return;
+}
+
+void test_seal_unseal_nkl_chunked_default(void)
+{
+  // more than one chunk of the default size
+  size_t data_len = KMYTH_SEAL_CHUNK_SIZE + KMYTH_SEAL_CHUNK_SIZE / 2;
+  uint8_t *data = (uint8_t *) malloc(data_len);
+  uint8_t *output = NULL;
+  size_t output_len = 0;
+  uint64_t handle = 0;
+  uint16_t key_policy = SGX_KEYPOLICY_MRSIGNER;
+  sgx_attributes_t attribute_mask;
+
+  attribute_mask.flags = 0;
+  attribute_mask.xfrm = 0;
+
+  int sgx_ret_int;
+  size_t sgx_ret_size;
+
+  for (size_t i = 0; i < data_len; i++)
+  {
+    data[i] = (uint8_t) (i * 13 + 5);
+  }
+
+  // A chunk size larger than the maximum is rejected.
+  CU_ASSERT(kmyth_sgx_seal_nkl_chunked
+            (eid, data, data_len, KMYTH_SEAL_CHUNK_MAX_SIZE + 1, &output,
+             &output_len, key_policy, attribute_mask) == 1);
+
+  // A chunk size of 0 selects KMYTH_SEAL_CHUNK_SIZE, which must fit in the
+  // enclave heap.
+  CU_ASSERT(kmyth_sgx_seal_nkl_chunked
+            (eid, data, data_len, 0, &output, &output_len,
+             key_policy, attribute_mask) == 0);
+
+  size_t chunk_delim_len = strlen(KMYTH_DELIM_NKL_CHUNK);
+  size_t chunk_count = 0;
+
+  for (size_t i = 0; i + chunk_delim_len <= output_len; i++)
+  {
+    if (memcmp(output + i, KMYTH_DELIM_NKL_CHUNK, chunk_delim_len) == 0)
+    {
+      chunk_count++;
+    }
+  }
+  CU_ASSERT(chunk_count == 2);
+
+  kmyth_unsealed_data_table_initialize(eid, &sgx_ret_int);
+  CU_ASSERT(sgx_ret_int == 0);
+
+  CU_ASSERT(kmyth_sgx_unseal_nkl_chunked(eid, output, output_len, &handle)
+            == 0);
+
+  uint8_t *decrypted = (uint8_t *) malloc(data_len);
+
+  kmyth_sgx_test_export_from_enclave(eid, &sgx_ret_size, handle, data_len,
+                                     decrypted);
+  CU_ASSERT(sgx_ret_size == data_len);
+  CU_ASSERT(memcmp(decrypted, data, data_len) == 0);
+  free(decrypted);
+
+  kmyth_unsealed_data_table_cleanup(eid, &sgx_ret_int);
+  CU_ASSERT(sgx_ret_int == 0);
+
+  free(output);
+  free(data);
+  return;
+}
+
 int main(void)
 {
 
@@ -270,6 +636,39 @@ int main(void)
     return CU_get_error();
   }
 
+  if (NULL == CU_add_test(kmyth_sgx_test_suite, "Test batch seal nkl",
+                          test_seal_unseal_nkl_batch))
+  {
+    CU_cleanup_registry();
+    return CU_get_error();
+  }
+
+  if (NULL == CU_add_test(kmyth_sgx_test_suite, "Test batch unseal nkl",
+                          test_unseal_nkl_batch))
+  {
+    CU_cleanup_registry();
+    return CU_get_error();
+  }
+  if (NULL == CU_add_test(kmyth_sgx_test_suite, "Test unseal table budget",
+                          test_unseal_table_budget))
+  {
+    CU_cleanup_registry();
+    return CU_get_error();
+  }
+  if (NULL == CU_add_test(kmyth_sgx_test_suite, "Test chunked seal/unseal nkl",
+                          test_seal_unseal_nkl_chunked))
+  {
+    CU_cleanup_registry();
+    return CU_get_error();
+  }
+  if (NULL == CU_add_test(kmyth_sgx_test_suite,
+                          "Test chunked seal/unseal nkl (default chunk size)",
+                          test_seal_unseal_nkl_chunked_default))
+  {
+    CU_cleanup_registry();
+    return CU_get_error();
+  }
+
   CU_basic_run_tests();
 
   CU_cleanup_registry();
@@ -24,11 +24,25 @@ extern "C"
 
 #include ENCLAVE_HEADER_TRUSTED
 
+/**
+ * @brief Default budget (in bytes) for the unsealed data held in the
+ *        kmyth_unsealed_data_table, 0 meaning unlimited. Keeping the table
+ *        well within the EPC avoids EPC paging; see
+ *        kmyth_unsealed_data_table_set_budget().
+ */
+#ifndef KMYTH_UNSEALED_DATA_TABLE_BUDGET
+#define KMYTH_UNSEALED_DATA_TABLE_BUDGET 0
+#endif
+
   typedef struct unseal_data_s
   {
     uint64_t handle;
     size_t data_size;
-    uint8_t *data;
+    uint8_t *data;              // NULL while the entry is evicted
+    uint8_t *stash;             // untrusted, sealed copy of an evicted entry
+    size_t stash_size;
+    uint64_t stash_counter;     // eviction number bound into the stash
+    struct unseal_data_s *prev;
     struct unseal_data_s *next;
   } unseal_data_t;
 
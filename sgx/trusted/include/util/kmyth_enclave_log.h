@@ -0,0 +1,75 @@
+/**
+ * @file  kmyth_enclave_log.h
+ *
+ * @brief Provides buffered logging for code running within the kmyth SGX
+ *        enclave. Log events are collected in an in-enclave buffer and
+ *        passed out to the untrusted logger in batches (a single
+ *        log_events_ocall), instead of one enclave exit per event.
+ */
+
+#ifndef _KMYTH_ENCLAVE_LOG_H_
+#define _KMYTH_ENCLAVE_LOG_H_
+
+#include "kmyth_log_event.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/**
+ * @brief Number of log events the in-enclave buffer holds. The buffer is
+ *        flushed when it fills.
+ */
+#ifndef KMYTH_ENCLAVE_LOG_BUFFER_EVENTS
+#define KMYTH_ENCLAVE_LOG_BUFFER_EVENTS 32
+#endif
+
+/**
+ * @brief Events at this severity or more severe (numerically lower) flush
+ *        the buffer immediately, so that errors are never held back.
+ */
+#ifndef KMYTH_ENCLAVE_LOG_FLUSH_SEVERITY
+#define KMYTH_ENCLAVE_LOG_FLUSH_SEVERITY LOG_ERR
+#endif
+
+/**
+ * @brief Buffers a log event raised within the enclave. This is the
+ *        enclave's implementation of the function the kmyth_sgx_log()
+ *        macro calls (outside the enclave, log_event_ocall() logs the
+ *        event directly), so code shared between the enclave and
+ *        untrusted applications logs the same way in both.
+ *
+ * @param[in] src_file_ptr     Pointer to source code filename string
+ *
+ * @param[in] src_func_ptr     Pointer to function name string
+ *
+ * @param[in] src_line_ptr     Pointer to source code line number integer
+ *
+ * @param[in] severity_ptr     Pointer to integer representing the severity
+ *                             level of the event to be logged.
+ *
+ * @param[in] message_ptr      Pointer to string containing the message to
+ *                             be logged.
+ *
+ * @return                     None
+ */
+  void log_event_ocall(const char **src_file_ptr,
+                       const char **src_func_ptr,
+                       const int *src_line_ptr,
+                       int *severity_ptr, const char **message_ptr);
+
+/**
+ * @brief Passes any buffered log events out of the enclave (with a single
+ *        log_events_ocall) and empties the buffer. Ecalls that log call
+ *        this before returning; it is also exposed as an ecall.
+ *
+ * @return                     None
+ */
+  void kmyth_enclave_log_flush(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -10,16 +10,14 @@
 
 #include ENCLAVE_HEADER_TRUSTED
 
-// This is the function that gets converted into the ecall.
-int kmyth_enclave_retrieve_key_from_server(uint8_t * client_private_bytes,
-                                           size_t client_private_bytes_len,
-                                           uint8_t * server_cert_bytes,
-                                           size_t server_cert_bytes_len,
-                                           const char *server_host,
-                                           int server_host_len,
-                                           int server_port,
-                                           unsigned char *key_id,
-                                           size_t key_id_len)
+static int retrieve_key_from_server(uint8_t * client_private_bytes,
+                                    size_t client_private_bytes_len,
+                                    uint8_t * server_cert_bytes,
+                                    size_t server_cert_bytes_len,
+                                    const char *server_host,
+                                    int server_host_len,
+                                    int server_port,
+                                    unsigned char *key_id, size_t key_id_len)
 {
   // unmarshal client private signing key
   EVP_PKEY *client_sign_privkey = NULL;
@@ -105,3 +103,26 @@ int kmyth_enclave_retrieve_key_from_server(uint8_t * client_private_bytes,
 
   return EXIT_SUCCESS;
 }
+
+// This is the function that gets converted into the ecall.
+int kmyth_enclave_retrieve_key_from_server(uint8_t * client_private_bytes,
+                                           size_t client_private_bytes_len,
+                                           uint8_t * server_cert_bytes,
+                                           size_t server_cert_bytes_len,
+                                           const char *server_host,
+                                           int server_host_len,
+                                           int server_port,
+                                           unsigned char *key_id,
+                                           size_t key_id_len)
+{
+  int ret_val = retrieve_key_from_server(client_private_bytes,
+                                         client_private_bytes_len,
+                                         server_cert_bytes,
+                                         server_cert_bytes_len,
+                                         server_host, server_host_len,
+                                         server_port, key_id, key_id_len);
+
+  // pass the events logged during the retrieval out in one batch
+  kmyth_enclave_log_flush();
+  return ret_val;
+}
@@ -7,8 +7,36 @@
 #include "sgx_utils.h"
 #include "sgx_attributes.h"
 
+#include "kmyth_enclave_memory_util.h"
+#include "kmyth_seal_chunk.h"
+
 #include ENCLAVE_HEADER_TRUSTED
 
+// Fills in the default attribute mask and, for KSS-enabled enclaves, the
+// extra key policy bits used when sealing.
+static void apply_seal_policy_defaults(uint16_t * key_policy,
+                                       sgx_attributes_t * attribute_mask)
+{
+  // This combination is recommended by the SGX Developer Guide, so
+  // we use it as default.
+  if (attribute_mask->flags == 0)
+  {
+    attribute_mask->flags = SGX_FLAGS_INITTED | SGX_FLAGS_DEBUG;
+  }
+
+  // If the enclave uses the key separation and sharing (KSS) features
+  // we need that to be reflected in the policy of the sealing key
+  // as well.
+  const sgx_report_t *report = sgx_self_report();
+
+  if (report->body.attributes.flags & SGX_FLAGS_KSS)
+  {
+    *key_policy |=
+      (SGX_KEYPOLICY_CONFIGID | SGX_KEYPOLICY_ISVFAMILYID |
+       SGX_KEYPOLICY_ISVEXTPRODID);
+  }
+}
+
 // EDL checks that `size` is outside the enclave (speculative-safe)
 int enc_get_sealed_size(uint32_t in_size, uint32_t * size)
 {
@@ -58,24 +86,7 @@ int enc_seal_data(const uint8_t * in_data, uint32_t in_size, uint8_t * out_data,
   // Retire validity check of `out_data` and checks in `malloc` against `sealedsz`, influenced by `in_size`
   sgx_lfence();
 
-  // This combination is recommended by the SGX Developer Guide, so
-  // we use it as default.
-  if (attribute_mask.flags == 0)
-  {
-    attribute_mask.flags = SGX_FLAGS_INITTED | SGX_FLAGS_DEBUG;
-  }
-
-  // If the enclave uses the key separation and sharing (KSS) features
-  // we need that to be reflected in the policy of the sealing key
-  // as well.
-  const sgx_report_t *report = sgx_self_report();
-
-  if (report->body.attributes.flags & SGX_FLAGS_KSS)
-  {
-    key_policy |=
-      (SGX_KEYPOLICY_CONFIGID | SGX_KEYPOLICY_ISVFAMILYID |
-       SGX_KEYPOLICY_ISVEXTPRODID);
-  }
+  apply_seal_policy_defaults(&key_policy, &attribute_mask);
 
   // This 0 value is currently unused by SGX.
   const sgx_misc_select_t misc_mask = 0;
@@ -95,3 +106,179 @@ Out:
     free(buf);
   return ret;
 }
+
+// EDL checks that `in_data` and `in_lens` are outside the enclave
+// (speculative-safe). `out_data` is user_check.
+int enc_seal_data_batch(const uint8_t * in_data, uint32_t in_size,
+                        const uint32_t * in_lens, size_t count,
+                        uint8_t * out_data, uint32_t out_size,
+                        uint16_t key_policy, sgx_attributes_t attribute_mask)
+{
+  if (in_data == NULL || in_lens == NULL || out_data == NULL || count == 0)
+  {
+    return SGX_ERROR_INVALID_PARAMETER;
+  }
+  if (!sgx_is_outside_enclave(out_data, out_size))
+    return SGX_ERROR_INVALID_PARAMETER;
+
+  // The plaintexts are packed back to back in `in_data` and the sealed
+  // blobs are written back to back in `out_data`, so validate the whole
+  // layout (and find the largest blob) before sealing anything.
+  uint64_t in_total = 0;
+  uint64_t out_total = 0;
+  uint32_t max_sealedsz = 0;
+
+  for (size_t i = 0; i < count; i++)
+  {
+    uint32_t sealedsz = sgx_calc_sealed_data_size(0, in_lens[i]);
+
+    if (sealedsz == UINT32_MAX)
+      return SGX_ERROR_INVALID_PARAMETER;
+    in_total += in_lens[i];
+    out_total += sealedsz;
+    if (sealedsz > max_sealedsz)
+      max_sealedsz = sealedsz;
+  }
+  if (in_total != in_size || out_total > out_size)
+    return SGX_ERROR_INVALID_PARAMETER;
+
+  // Each blob is sealed into enclave memory and then copied out, as in
+  // enc_seal_data(), reusing one buffer sized for the largest blob.
+  sgx_sealed_data_t *buf = (sgx_sealed_data_t *) malloc(max_sealedsz);
+
+  if (buf == NULL)
+    return SGX_ERROR_OUT_OF_MEMORY;
+
+  // Retire validity check of `out_data` and the layout checks above,
+  // influenced by `in_lens`
+  sgx_lfence();
+
+  apply_seal_policy_defaults(&key_policy, &attribute_mask);
+
+  // This 0 value is currently unused by SGX.
+  const sgx_misc_select_t misc_mask = 0;
+
+  const uint8_t *in_ptr = in_data;
+  uint8_t *out_ptr = out_data;
+  int ret = 0;
+
+  for (size_t i = 0; i < count; i++)
+  {
+    uint32_t sealedsz = sgx_calc_sealed_data_size(0, in_lens[i]);
+    sgx_status_t sgx_ret = sgx_seal_data_ex(key_policy, attribute_mask,
+                                            misc_mask, 0, NULL, in_lens[i],
+                                            in_ptr, sealedsz, buf);
+
+    if (sgx_ret != SGX_SUCCESS)
+    {
+      ret = sgx_ret;
+      break;
+    }
+    memcpy(out_ptr, buf, sealedsz);
+    in_ptr += in_lens[i];
+    out_ptr += sealedsz;
+  }
+
+  memset(buf, 0, max_sealedsz);
+  free(buf);
+  return ret;
+}
+
+// `in_data` and `out_data` are user_check. Each chunk is copied in, sealed
+// into enclave memory and copied out, so the enclave memory used depends on
+// `chunk_size` only.
+int enc_seal_data_chunked(const uint8_t * in_data, size_t in_size,
+                          uint32_t chunk_size, uint8_t * out_data,
+                          size_t out_size, uint16_t key_policy,
+                          sgx_attributes_t attribute_mask)
+{
+  if (in_data == NULL || out_data == NULL || in_size == 0 || chunk_size == 0
+      || chunk_size > KMYTH_SEAL_CHUNK_MAX_SIZE)
+  {
+    return SGX_ERROR_INVALID_PARAMETER;
+  }
+  if (!sgx_is_outside_enclave(in_data, in_size)
+      || !sgx_is_outside_enclave(out_data, out_size))
+    return SGX_ERROR_INVALID_PARAMETER;
+
+  // Every chunk adds the same overhead (the header and the additional MAC
+  // text) to its plaintext.
+  const uint32_t aad_size = sizeof(kmyth_seal_chunk_aad_t);
+  uint32_t overhead = sgx_calc_sealed_data_size(aad_size, 0);
+  uint32_t max_sealedsz = sgx_calc_sealed_data_size(aad_size, chunk_size);
+
+  if (overhead == UINT32_MAX || max_sealedsz == UINT32_MAX)
+    return SGX_ERROR_UNEXPECTED;
+
+  uint64_t chunk_count = (in_size - 1) / chunk_size + 1;
+
+  if (chunk_count > (SIZE_MAX - in_size) / overhead
+      || chunk_count * overhead + in_size > out_size)
+    return SGX_ERROR_INVALID_PARAMETER;
+
+  uint8_t *chunk = (uint8_t *) malloc(chunk_size);
+  sgx_sealed_data_t *buf = (sgx_sealed_data_t *) malloc(max_sealedsz);
+
+  if (chunk == NULL || buf == NULL)
+  {
+    free(chunk);
+    free(buf);
+    return SGX_ERROR_OUT_OF_MEMORY;
+  }
+
+  // Retire validity checks of `in_data` and `out_data` and the size checks
+  // above, influenced by `in_size` and `chunk_size`
+  sgx_lfence();
+
+  apply_seal_policy_defaults(&key_policy, &attribute_mask);
+
+  // This 0 value is currently unused by SGX.
+  const sgx_misc_select_t misc_mask = 0;
+
+  kmyth_seal_chunk_aad_t aad;
+
+  memset(&aad, 0, sizeof(aad));
+  memcpy(aad.magic, KMYTH_SEAL_CHUNK_MAGIC, KMYTH_SEAL_CHUNK_MAGIC_LEN);
+
+  size_t in_offset = 0;
+  size_t out_offset = 0;
+  int ret = 0;
+
+  for (uint64_t i = 0; i < chunk_count; i++)
+  {
+    uint32_t len = chunk_size;
+
+    if (in_size - in_offset < chunk_size)
+    {
+      len = (uint32_t) (in_size - in_offset);
+    }
+
+    uint32_t sealedsz = sgx_calc_sealed_data_size(aad_size, len);
+
+    aad.index = i;
+    aad.final = (i == chunk_count - 1);
+    memcpy(chunk, in_data + in_offset, len);
+
+    sgx_status_t sgx_ret = sgx_seal_data_ex(key_policy, attribute_mask,
+                                            misc_mask, aad_size,
+                                            (const uint8_t *) &aad, len,
+                                            chunk, sealedsz, buf);
+
+    if (sgx_ret != SGX_SUCCESS)
+    {
+      ret = sgx_ret;
+      break;
+    }
+    memcpy(out_data + out_offset, buf, sealedsz);
+
+    // chain the next chunk to this one
+    memcpy(aad.prev_tag, buf->aes_data.payload_tag, KMYTH_SEAL_CHUNK_TAG_LEN);
+    in_offset += len;
+    out_offset += sealedsz;
+  }
+
+  kmyth_enclave_clear_and_free(chunk, chunk_size);
+  memset(buf, 0, max_sealedsz);
+  free(buf);
+  return ret;
+}
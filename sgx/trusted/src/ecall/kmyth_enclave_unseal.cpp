@@ -7,14 +7,45 @@
 #include "sgx_trts.h"
 #include "sgx_tseal.h"
 #include "sgx_thread.h"
+#include "sgx_lfence.h"
 
 #include "kmyth_enclave_trusted.h"
+#include "kmyth_seal_chunk.h"
 #include ENCLAVE_HEADER_TRUSTED
 
 unseal_data_t *kmyth_unsealed_data_table = NULL;
 static bool kmyth_unsealed_data_table_initialized = false;
 static sgx_thread_mutex_t kmyth_unsealed_data_table_lock;
 
+// Budget (in bytes) for the unsealed data held in the table, where 0 means
+// unlimited, and the accounting used to enforce it. All of these are
+// protected by kmyth_unsealed_data_table_lock.
+static size_t kmyth_unsealed_data_table_budget =
+  KMYTH_UNSEALED_DATA_TABLE_BUDGET;
+static size_t kmyth_unsealed_data_table_resident = 0;
+static uint64_t kmyth_unsealed_data_table_hits = 0;
+static uint64_t kmyth_unsealed_data_table_misses = 0;
+static uint64_t kmyth_unsealed_data_table_evictions = 0;
+
+// The least recently used resident entry. Entries are added at the head of
+// the table and only this one is ever evicted, so every entry after it has
+// been evicted already, and the next one to evict is the entry before it.
+static unseal_data_t *kmyth_unsealed_data_table_lru = NULL;
+
+// Numbers every eviction, so that each stashed copy is distinct. Never
+// reset, so a stash cannot be replayed into a later eviction either.
+static uint64_t kmyth_unsealed_data_table_stash_counter = 0;
+
+/**
+ * @brief Additional MAC text of an evicted entry's sealed copy, binding the
+ *        copy to the entry (and to the one eviction) it was made for.
+ */
+typedef struct
+{
+  uint64_t handle;
+  uint64_t counter;
+} stash_aad_t;
+
 /**
  * @brief Derives the data handle by taking the first 64 bits of the
  *        SHA-384 hash of the input data.
@@ -64,17 +95,342 @@ static bool derive_handle(uint32_t data_size, uint8_t * data, uint64_t * handle)
     free(digest);
     return false;
   }
+  EVP_MD_CTX_free(ctx);
   memcpy(handle, digest, sizeof(uint64_t));
   free(digest);
   return true;
 }
 
+/**
+ * @brief Unseals one SGX-sealed blob into a newly allocated buffer.
+ *
+ * @param[in]  data_size            The size (in bytes) of the sealed blob.
+ *
+ * @param[in]  data                 A pointer to the sealed blob.
+ *
+ * @param[out] plaintext_data       The unsealed data (caller frees).
+ *
+ * @param[out] plaintext_data_size  The size (in bytes) of the unsealed data.
+ *
+ * @returns true on success, false on failure. The return value MUST be checked.
+ */
+static bool unseal_blob(uint32_t data_size, uint8_t * data,
+                        uint8_t ** plaintext_data,
+                        uint32_t * plaintext_data_size)
+{
+  if (data_size < sizeof(sgx_sealed_data_t) || data == NULL)
+  {
+    return false;
+  }
+
+  uint32_t plaintext_size = sgx_get_encrypt_txt_len((sgx_sealed_data_t *) data);
+  uint32_t mac_len = sgx_get_add_mac_txt_len((sgx_sealed_data_t *) data);
+
+  // UINT32_MAX is the error return value of sgx_get_encrypt_txt_len and
+  // sgx_calc_sealed_data_size.
+  if (plaintext_size == UINT32_MAX || mac_len == UINT32_MAX
+      || sgx_calc_sealed_data_size(mac_len, plaintext_size) > data_size)
+  {
+    return false;
+  }
+
+  uint32_t plaintext_alloc_size = plaintext_size;
+  uint8_t *plaintext = (uint8_t *) malloc(plaintext_alloc_size);
+
+  if (plaintext == NULL)
+  {
+    return false;
+  }
+
+  if (sgx_unseal_data
+      ((sgx_sealed_data_t *) data, NULL, &mac_len, plaintext,
+       &plaintext_size) != SGX_SUCCESS)
+  {
+    kmyth_enclave_clear_and_free(plaintext, plaintext_alloc_size);
+    return false;
+  }
+
+  *plaintext_data = plaintext;
+  *plaintext_data_size = plaintext_size;
+  return true;
+}
+
+/**
+ * @brief Reads the sizes of a chunk sealed by enc_seal_data_chunked() from
+ *        a copy of its header, and checks that the chunk fits in the data
+ *        that remains.
+ *
+ * @param[in]  data         A pointer to the start of the sealed chunk.
+ *
+ * @param[in]  remaining    The number of bytes from data to the end of the
+ *                          sealed chunks.
+ *
+ * @param[out] sealed_size  The size (in bytes) of the sealed chunk.
+ *
+ * @param[out] chunk_size   The size (in bytes) of the chunk's plaintext.
+ *
+ * @returns true on success, false if the header is not that of a chunk.
+ */
+static bool read_chunk_header(const uint8_t * data, size_t remaining,
+                              uint32_t * sealed_size, uint32_t * chunk_size)
+{
+  sgx_sealed_data_t header;
+
+  if (remaining < sizeof(header))
+  {
+    return false;
+  }
+  memcpy(&header, data, sizeof(header));
+
+  uint32_t mac_len = sgx_get_add_mac_txt_len(&header);
+  uint32_t plaintext_size = sgx_get_encrypt_txt_len(&header);
+
+  if (mac_len != sizeof(kmyth_seal_chunk_aad_t) || plaintext_size == 0
+      || plaintext_size > KMYTH_SEAL_CHUNK_MAX_SIZE)
+  {
+    return false;
+  }
+
+  uint32_t size = sgx_calc_sealed_data_size(mac_len, plaintext_size);
+
+  if (size == UINT32_MAX || size > remaining)
+  {
+    return false;
+  }
+  *sealed_size = size;
+  *chunk_size = plaintext_size;
+  return true;
+}
+
+/**
+ * @brief Builds (but does not link in) a kmyth_unsealed_data_table entry
+ *        that takes ownership of the data.
+ *
+ * @param[in] data      The unsealed data.
+ *
+ * @param[in] data_size The size (in bytes) of the unsealed data.
+ *
+ * @returns The new entry, or NULL on failure.
+ */
+static unseal_data_t *new_unseal_slot(uint8_t * data, uint32_t data_size)
+{
+  // UINT32_MAX is an invalid data size for the plaintext of an
+  // SGX-sealed blob.
+  if (data_size == 0 || data_size == UINT32_MAX || data == NULL)
+  {
+    return NULL;
+  }
+
+  unseal_data_t *new_slot = (unseal_data_t *) malloc(sizeof(unseal_data_t));
+
+  if (new_slot == NULL)
+  {
+    return NULL;
+  }
+
+  if (!derive_handle(data_size, data, &new_slot->handle))
+  {
+    free(new_slot);
+    return NULL;
+  }
+
+  new_slot->data_size = data_size;
+  new_slot->data = data;
+  new_slot->stash = NULL;
+  new_slot->stash_size = 0;
+  new_slot->stash_counter = 0;
+  new_slot->prev = NULL;
+  new_slot->next = NULL;
+  return new_slot;
+}
+
+/**
+ * @brief Evicts a table entry: its data is sealed (to this enclave, with
+ *        the entry's handle and a fresh eviction number as additional MAC
+ *        text), the sealed copy is handed to untrusted memory, and the
+ *        unsealed data is cleared and freed. The entry keeps its handle and
+ *        size, and retrieve_from_unseal_table() transparently unseals it
+ *        again. Must be called with kmyth_unsealed_data_table_lock held.
+ *
+ *        The lock stays held across stash_sealed_data_ocall(): the ocall
+ *        only copies the sealed data into untrusted memory and makes no
+ *        ecall back into the enclave, so it cannot deadlock on the lock,
+ *        and holding it keeps the entry from being retrieved (and freed)
+ *        while its data is being stashed.
+ *
+ * @param[in] slot      The (resident) entry to evict.
+ *
+ * @returns true on success, false on failure (the entry stays resident).
+ */
+static bool evict_unseal_slot(unseal_data_t * slot)
+{
+  stash_aad_t aad;
+
+  aad.handle = slot->handle;
+  aad.counter = ++kmyth_unsealed_data_table_stash_counter;
+
+  uint32_t sealed_size =
+    sgx_calc_sealed_data_size(sizeof(aad), slot->data_size);
+
+  if (sealed_size == UINT32_MAX)
+  {
+    return false;
+  }
+
+  sgx_sealed_data_t *sealed = (sgx_sealed_data_t *) malloc(sealed_size);
+
+  if (sealed == NULL)
+  {
+    return false;
+  }
+
+  // The sealed copy only ever needs to be unsealed by this enclave.
+  sgx_attributes_t attribute_mask;
+
+  attribute_mask.flags = SGX_FLAGS_INITTED | SGX_FLAGS_DEBUG;
+  attribute_mask.xfrm = 0;
+
+  uint8_t *stash = NULL;
+  int ret = -1;
+
+  if (sgx_seal_data_ex(SGX_KEYPOLICY_MRENCLAVE, attribute_mask, 0,
+                       sizeof(aad), (const uint8_t *) &aad,
+                       slot->data_size, slot->data, sealed_size,
+                       sealed) == SGX_SUCCESS)
+  {
+    stash_sealed_data_ocall(&ret, (uint8_t *) sealed, sealed_size, &stash);
+  }
+  free(sealed);
+
+  if (ret != 0 || stash == NULL
+      || !sgx_is_outside_enclave(stash, sealed_size))
+  {
+    // a stash returned along with an error is not used, but still released
+    if (stash != NULL)
+    {
+      free_stashed_data_ocall(stash);
+    }
+    return false;
+  }
+
+  kmyth_enclave_clear_and_free(slot->data, slot->data_size);
+  slot->data = NULL;
+  slot->stash = stash;
+  slot->stash_size = sealed_size;
+  slot->stash_counter = aad.counter;
+  if (slot == kmyth_unsealed_data_table_lru)
+  {
+    kmyth_unsealed_data_table_lru = slot->prev;
+  }
+  kmyth_unsealed_data_table_resident -= slot->data_size;
+  kmyth_unsealed_data_table_evictions++;
+  return true;
+}
+
+/**
+ * @brief Unseals the stashed copy of an evicted table entry, checking that
+ *        it was sealed for this entry and eviction (additional MAC text)
+ *        and that its data still derives the entry's handle, so the host
+ *        cannot substitute another stash or replay an older one.
+ *
+ * @param[in]  slot                 The (evicted, unlinked) entry.
+ *
+ * @param[out] plaintext_data       The unsealed data (caller frees).
+ *
+ * @returns true on success, false on failure (nothing is returned).
+ */
+static bool unseal_stash(unseal_data_t * slot, uint8_t ** plaintext_data)
+{
+  if (slot->stash_size < sizeof(sgx_sealed_data_t)
+      || slot->stash_size > UINT32_MAX)
+  {
+    return false;
+  }
+
+  // copy the sealed data into the enclave, so it cannot change while
+  // being checked and unsealed
+  uint32_t sealed_size = (uint32_t) slot->stash_size;
+  uint8_t *sealed = (uint8_t *) malloc(sealed_size);
+
+  if (sealed == NULL)
+  {
+    return false;
+  }
+  memcpy(sealed, slot->stash, sealed_size);
+
+  uint32_t mac_len = sgx_get_add_mac_txt_len((sgx_sealed_data_t *) sealed);
+  uint32_t plaintext_size =
+    sgx_get_encrypt_txt_len((sgx_sealed_data_t *) sealed);
+  uint8_t *plaintext = NULL;
+  stash_aad_t aad;
+  bool ok = false;
+
+  if (mac_len == sizeof(aad) && plaintext_size == slot->data_size
+      && sgx_calc_sealed_data_size(mac_len, plaintext_size) == sealed_size)
+  {
+    plaintext = (uint8_t *) malloc(plaintext_size);
+  }
+  if (plaintext != NULL
+      && sgx_unseal_data((sgx_sealed_data_t *) sealed, (uint8_t *) & aad,
+                         &mac_len, plaintext, &plaintext_size) == SGX_SUCCESS
+      && mac_len == sizeof(aad) && plaintext_size == slot->data_size
+      && aad.handle == slot->handle && aad.counter == slot->stash_counter)
+  {
+    uint64_t handle = 0;
+
+    ok = derive_handle(plaintext_size, plaintext, &handle)
+      && handle == slot->handle;
+  }
+  free(sealed);
+
+  if (!ok)
+  {
+    kmyth_enclave_clear_and_free(plaintext, slot->data_size);
+    return false;
+  }
+  *plaintext_data = plaintext;
+  return true;
+}
+
+/**
+ * @brief Evicts the least recently used entries until the unsealed data
+ *        held in the table, plus incoming_size bytes about to be added,
+ *        fits within the budget (or no entry is left to evict). The
+ *        victims are taken from kmyth_unsealed_data_table_lru, without
+ *        rescanning the table. Must be called with
+ *        kmyth_unsealed_data_table_lock held.
+ *
+ * @param[in] incoming_size The size (in bytes) of data about to be added.
+ */
+static void enforce_unsealed_data_budget(size_t incoming_size)
+{
+  if (kmyth_unsealed_data_table_budget == 0)
+  {
+    return;
+  }
+
+  while (kmyth_unsealed_data_table_resident + incoming_size >
+         kmyth_unsealed_data_table_budget)
+  {
+    unseal_data_t *victim = kmyth_unsealed_data_table_lru;
+
+    if (victim == NULL || !evict_unseal_slot(victim))
+    {
+      return;
+    }
+  }
+}
+
 int kmyth_unsealed_data_table_initialize(void)
 {
   if (sgx_thread_mutex_init(&kmyth_unsealed_data_table_lock, NULL))
   {
     return -1;
   }
+  kmyth_unsealed_data_table_resident = 0;
+  kmyth_unsealed_data_table_hits = 0;
+  kmyth_unsealed_data_table_misses = 0;
+  kmyth_unsealed_data_table_evictions = 0;
   kmyth_unsealed_data_table_initialized = true;
   return 0;
 }
@@ -88,14 +444,57 @@ int kmyth_unsealed_data_table_cleanup(void)
   while (slot != NULL)
   {
     next_slot = slot->next;
-    free(slot->data);
+    if (slot->data != NULL)
+    {
+      kmyth_enclave_clear_and_free(slot->data, slot->data_size);
+    }
+    if (slot->stash != NULL)
+    {
+      free_stashed_data_ocall(slot->stash);
+    }
     free(slot);
     slot = next_slot;
   }
+  kmyth_unsealed_data_table = NULL;
+  kmyth_unsealed_data_table_lru = NULL;
+  kmyth_unsealed_data_table_resident = 0;
+  kmyth_unsealed_data_table_initialized = false;
   sgx_thread_mutex_unlock(&kmyth_unsealed_data_table_lock);
   return sgx_thread_mutex_destroy(&kmyth_unsealed_data_table_lock);
 }
 
+int kmyth_unsealed_data_table_set_budget(size_t budget)
+{
+  if (!kmyth_unsealed_data_table_initialized)
+  {
+    return -1;
+  }
+
+  sgx_thread_mutex_lock(&kmyth_unsealed_data_table_lock);
+  kmyth_unsealed_data_table_budget = budget;
+  enforce_unsealed_data_budget(0);
+  sgx_thread_mutex_unlock(&kmyth_unsealed_data_table_lock);
+  return 0;
+}
+
+int kmyth_unsealed_data_table_get_stats(uint64_t * hits, uint64_t * misses,
+                                        uint64_t * evictions,
+                                        size_t *resident)
+{
+  if (!kmyth_unsealed_data_table_initialized)
+  {
+    return -1;
+  }
+
+  sgx_thread_mutex_lock(&kmyth_unsealed_data_table_lock);
+  *hits = kmyth_unsealed_data_table_hits;
+  *misses = kmyth_unsealed_data_table_misses;
+  *evictions = kmyth_unsealed_data_table_evictions;
+  *resident = kmyth_unsealed_data_table_resident;
+  sgx_thread_mutex_unlock(&kmyth_unsealed_data_table_lock);
+  return 0;
+}
+
 bool kmyth_unseal_into_enclave(uint32_t data_size, uint8_t * data,
                                uint64_t * handle)
 {
@@ -105,80 +504,279 @@ bool kmyth_unseal_into_enclave(uint32_t data_size, uint8_t * data,
     return false;
   }
 
-  if (data_size == 0 || data == NULL)
+  uint8_t *plaintext_data = NULL;
+  uint32_t plaintext_data_size = 0;
+
+  if (!unseal_blob(data_size, data, &plaintext_data, &plaintext_data_size))
   {
     return false;
   }
 
-  uint32_t plaintext_data_size =
-    sgx_get_encrypt_txt_len((sgx_sealed_data_t *) data);
-
-  // UINT32_MAX is the error return value of sgx_get_encrypt_txt_len.
-  if (plaintext_data_size == UINT32_MAX)
+  // handle gets set in insert_into_unseal_table
+  if (!insert_into_unseal_table
+      (plaintext_data, plaintext_data_size, handle))
   {
+    kmyth_enclave_clear_and_free(plaintext_data, plaintext_data_size);
     return false;
   }
+  return true;
+}
 
-  uint8_t *plaintext_data = (uint8_t *) malloc(plaintext_data_size);
+bool kmyth_unseal_into_enclave_batch(uint8_t * data, uint32_t data_size,
+                                     const uint32_t * data_lens, size_t count,
+                                     uint64_t * handles)
+{
+  if (!kmyth_unsealed_data_table_initialized)
+  {
+    return false;
+  }
 
-  if (plaintext_data == NULL)
+  if (data == NULL || data_lens == NULL || handles == NULL || count == 0)
   {
     return false;
   }
 
-  uint32_t mac_len = sgx_get_add_mac_txt_len((sgx_sealed_data_t *) data);
+  // The sealed blobs are packed back to back in `data`.
+  uint64_t total = 0;
 
-  if (sgx_unseal_data
-      ((sgx_sealed_data_t *) data, NULL, &mac_len, plaintext_data,
-       (uint32_t *) & plaintext_data_size) != SGX_SUCCESS)
+  for (size_t i = 0; i < count; i++)
+  {
+    total += data_lens[i];
+  }
+  if (total != data_size)
   {
-    free(plaintext_data);
     return false;
   }
 
-  // handle gets set in insert_into_unseal_table
-  return insert_into_unseal_table(plaintext_data, plaintext_data_size, handle);
+  // Unseal every blob before touching the table, so that the batch is
+  // all or nothing and the lock is taken only once.
+  unseal_data_t *batch_head = NULL;
+  unseal_data_t *batch_tail = NULL;
+  size_t batch_size = 0;
+  uint8_t *blob = data;
+
+  for (size_t i = 0; i < count; i++)
+  {
+    uint8_t *plaintext_data = NULL;
+    uint32_t plaintext_data_size = 0;
+    unseal_data_t *new_slot = NULL;
+
+    if (unseal_blob(data_lens[i], blob, &plaintext_data,
+                    &plaintext_data_size))
+    {
+      new_slot = new_unseal_slot(plaintext_data, plaintext_data_size);
+      if (new_slot == NULL)
+      {
+        kmyth_enclave_clear_and_free(plaintext_data, plaintext_data_size);
+      }
+    }
+    if (new_slot == NULL)
+    {
+      while (batch_head != NULL)
+      {
+        unseal_data_t *next_slot = batch_head->next;
+
+        kmyth_enclave_clear_and_free(batch_head->data, batch_head->data_size);
+        free(batch_head);
+        batch_head = next_slot;
+      }
+      return false;
+    }
+
+    handles[i] = new_slot->handle;
+    if (batch_tail == NULL)
+    {
+      batch_head = new_slot;
+    }
+    else
+    {
+      batch_tail->next = new_slot;
+      new_slot->prev = batch_tail;
+    }
+    batch_tail = new_slot;
+    batch_size += plaintext_data_size;
+    blob += data_lens[i];
+  }
+
+  // The batch is linked in before the budget is enforced, so that a batch
+  // larger than the budget has its own oldest entries evicted as well.
+  sgx_thread_mutex_lock(&kmyth_unsealed_data_table_lock);
+  batch_tail->next = kmyth_unsealed_data_table;
+  if (kmyth_unsealed_data_table != NULL)
+  {
+    kmyth_unsealed_data_table->prev = batch_tail;
+  }
+  kmyth_unsealed_data_table = batch_head;
+  if (kmyth_unsealed_data_table_lru == NULL)
+  {
+    kmyth_unsealed_data_table_lru = batch_tail;
+  }
+  kmyth_unsealed_data_table_resident += batch_size;
+  enforce_unsealed_data_budget(0);
+  sgx_thread_mutex_unlock(&kmyth_unsealed_data_table_lock);
+  return true;
 }
 
-bool insert_into_unseal_table(uint8_t * data, uint32_t data_size,
-                              uint64_t * handle)
+bool kmyth_unseal_into_enclave_chunked(const uint8_t * data,
+                                       size_t data_size, uint64_t * handle)
 {
   if (!kmyth_unsealed_data_table_initialized)
   {
     return false;
   }
 
-  // UINT32_MAX is an invalid data size for the plaintext of an
-  // SGX-sealed blob.
-  if (data_size == 0 || data_size == UINT32_MAX || data == NULL)
+  if (data == NULL || data_size == 0 || handle == NULL
+      || !sgx_is_outside_enclave(data, data_size))
   {
     return false;
   }
 
-  unseal_data_t *new_slot = (unseal_data_t *) malloc(sizeof(unseal_data_t));
+  // Size the unsealed data from the chunk headers. The chunks are read
+  // again, one copy at a time, to unseal them, and each copy must match
+  // the size found here, so changing the data in between only makes the
+  // unseal fail.
+  size_t plaintext_size = 0;
+  uint32_t max_sealed_size = 0;
+  size_t offset = 0;
 
-  if (new_slot == NULL)
+  while (offset < data_size)
+  {
+    uint32_t sealed_size = 0;
+    uint32_t chunk_size = 0;
+
+    if (!read_chunk_header(data + offset, data_size - offset,
+                           &sealed_size, &chunk_size))
+    {
+      return false;
+    }
+    plaintext_size += chunk_size;
+    if (plaintext_size >= UINT32_MAX)
+    {
+      return false;
+    }
+    if (sealed_size > max_sealed_size)
+    {
+      max_sealed_size = sealed_size;
+    }
+    offset += sealed_size;
+  }
+
+  uint8_t *plaintext = (uint8_t *) malloc(plaintext_size);
+  uint8_t *sealed = (uint8_t *) malloc(max_sealed_size);
+
+  if (plaintext == NULL || sealed == NULL)
   {
+    free(plaintext);
+    free(sealed);
     return false;
   }
 
-  if (!derive_handle(data_size, data, &new_slot->handle))
+  // Retire validity check of `data` and the size checks above, influenced
+  // by the chunk headers
+  sgx_lfence();
+
+  kmyth_seal_chunk_aad_t expected;
+  kmyth_seal_chunk_aad_t aad;
+
+  memset(&expected, 0, sizeof(expected));
+  memcpy(expected.magic, KMYTH_SEAL_CHUNK_MAGIC, KMYTH_SEAL_CHUNK_MAGIC_LEN);
+
+  size_t plaintext_offset = 0;
+  bool ok = true;
+
+  offset = 0;
+  for (uint64_t i = 0; offset < data_size; i++)
   {
-    free(new_slot);
+    uint32_t sealed_size = 0;
+    uint32_t chunk_size = 0;
+    uint32_t copy_sealed_size = 0;
+    uint32_t copy_chunk_size = 0;
+
+    if (!read_chunk_header(data + offset, data_size - offset,
+                           &sealed_size, &chunk_size)
+        || sealed_size > max_sealed_size
+        || chunk_size > plaintext_size - plaintext_offset)
+    {
+      ok = false;
+      break;
+    }
+    memcpy(sealed, data + offset, sealed_size);
+    if (!read_chunk_header(sealed, sealed_size, &copy_sealed_size,
+                           &copy_chunk_size)
+        || copy_sealed_size != sealed_size || copy_chunk_size != chunk_size)
+    {
+      ok = false;
+      break;
+    }
+
+    uint32_t mac_len = sizeof(aad);
+    uint32_t unsealed_size = chunk_size;
+
+    if (sgx_unseal_data((sgx_sealed_data_t *) sealed,
+                        (uint8_t *) & aad, &mac_len,
+                        plaintext + plaintext_offset,
+                        &unsealed_size) != SGX_SUCCESS
+        || mac_len != sizeof(aad) || unsealed_size != chunk_size)
+    {
+      ok = false;
+      break;
+    }
+
+    // the chunk must be the next one in this chain, and marked final
+    // exactly when it is the last one present
+    expected.index = i;
+    expected.final = (offset + sealed_size == data_size);
+    if (memcmp(&aad, &expected, sizeof(aad)))
+    {
+      ok = false;
+      break;
+    }
+    memcpy(expected.prev_tag,
+           ((sgx_sealed_data_t *) sealed)->aes_data.payload_tag,
+           KMYTH_SEAL_CHUNK_TAG_LEN);
+    plaintext_offset += chunk_size;
+    offset += sealed_size;
+  }
+  free(sealed);
+
+  if (!ok || plaintext_offset != plaintext_size
+      || !insert_into_unseal_table(plaintext, (uint32_t) plaintext_size,
+                                   handle))
+  {
+    kmyth_enclave_clear_and_free(plaintext, plaintext_size);
     return false;
   }
+  return true;
+}
 
-  new_slot->data_size = data_size;
-  new_slot->data = data;
-  if (new_slot->data == NULL)
+bool insert_into_unseal_table(uint8_t * data, uint32_t data_size,
+                              uint64_t * handle)
+{
+  if (!kmyth_unsealed_data_table_initialized)
+  {
+    return false;
+  }
+
+  unseal_data_t *new_slot = new_unseal_slot(data, data_size);
+
+  if (new_slot == NULL)
   {
-    free(new_slot);
     return false;
   }
 
   sgx_thread_mutex_lock(&kmyth_unsealed_data_table_lock);
+  enforce_unsealed_data_budget(data_size);
   new_slot->next = kmyth_unsealed_data_table;
+  if (kmyth_unsealed_data_table != NULL)
+  {
+    kmyth_unsealed_data_table->prev = new_slot;
+  }
   kmyth_unsealed_data_table = new_slot;
+  if (kmyth_unsealed_data_table_lru == NULL)
+  {
+    kmyth_unsealed_data_table_lru = new_slot;
+  }
+  kmyth_unsealed_data_table_resident += data_size;
   sgx_thread_mutex_unlock(&kmyth_unsealed_data_table_lock);
   *handle = new_slot->handle;
   return true;
@@ -191,13 +789,12 @@ size_t retrieve_from_unseal_table(uint64_t handle, uint8_t ** buf)
     return 0;
   }
 
+  sgx_thread_mutex_lock(&kmyth_unsealed_data_table_lock);
+
   unseal_data_t *slot = kmyth_unsealed_data_table;
-  unseal_data_t *prev_slot = NULL;
 
-  sgx_thread_mutex_lock(&kmyth_unsealed_data_table_lock);
   while (slot != NULL && slot->handle != handle)
   {
-    prev_slot = slot;
     slot = slot->next;
   }
 
@@ -207,20 +804,56 @@ size_t retrieve_from_unseal_table(uint64_t handle, uint8_t ** buf)
     return 0;
   }
 
-  if (prev_slot != NULL)
+  if (slot->prev != NULL)
   {
-    prev_slot->next = slot->next;
+    slot->prev->next = slot->next;
   }
   else
   {
     kmyth_unsealed_data_table = slot->next;
   }
+  if (slot->next != NULL)
+  {
+    slot->next->prev = slot->prev;
+  }
+  if (slot == kmyth_unsealed_data_table_lru)
+  {
+    kmyth_unsealed_data_table_lru = slot->prev;
+  }
+  if (slot->data != NULL)
+  {
+    kmyth_unsealed_data_table_resident -= slot->data_size;
+    kmyth_unsealed_data_table_hits++;
+  }
+  else
+  {
+    kmyth_unsealed_data_table_misses++;
+  }
   sgx_thread_mutex_unlock(&kmyth_unsealed_data_table_lock);
-  *buf = (uint8_t *) malloc(slot->data_size);
-  memcpy(*buf, slot->data, slot->data_size);
-  size_t data_size = slot->data_size;
 
-  free(slot->data);
+  size_t data_size = 0;
+
+  if (slot->data != NULL)
+  {
+    *buf = (uint8_t *) malloc(slot->data_size);
+    if (*buf != NULL)
+    {
+      memcpy(*buf, slot->data, slot->data_size);
+      data_size = slot->data_size;
+    }
+    kmyth_enclave_clear_and_free(slot->data, slot->data_size);
+  }
+  else
+  {
+    // The entry was evicted: unseal its stashed copy again. A stash that
+    // fails the checks is discarded along with the entry.
+    if (unseal_stash(slot, buf))
+    {
+      data_size = slot->data_size;
+    }
+    free_stashed_data_ocall(slot->stash);
+  }
+
   free(slot);
   return data_size;
 }
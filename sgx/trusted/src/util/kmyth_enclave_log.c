@@ -0,0 +1,115 @@
+/**
+ * kmyth_enclave_log.c:
+ *
+ * C library providing buffered logging for the kmyth SGX enclave
+ */
+
+#include "kmyth_enclave_log.h"
+
+#include <string.h>
+
+#include "sgx_thread.h"
+
+#include "kmyth_enclave_trusted.h"
+
+static kmyth_log_event_t log_buffer[KMYTH_ENCLAVE_LOG_BUFFER_EVENTS];
+static size_t log_buffer_count = 0;
+static sgx_thread_mutex_t log_buffer_lock = SGX_THREAD_MUTEX_INITIALIZER;
+
+//############################################################################
+// copy_log_string()
+//############################################################################
+static void copy_log_string(char *dst, size_t dst_len, const char *src,
+                            bool keep_tail)
+{
+  if (src == NULL)
+  {
+    dst[0] = '\0';
+    return;
+  }
+
+  size_t src_len = strlen(src);
+
+  // long source file paths keep their (more informative) end
+  if (keep_tail && src_len >= dst_len)
+  {
+    src += src_len - (dst_len - 1);
+    src_len = dst_len - 1;
+  }
+  else if (src_len >= dst_len)
+  {
+    src_len = dst_len - 1;
+  }
+  memcpy(dst, src, src_len);
+  dst[src_len] = '\0';
+}
+
+//############################################################################
+// take_log_buffer()
+//
+// Moves the buffered events into 'events' (which holds
+// KMYTH_ENCLAVE_LOG_BUFFER_EVENTS) and empties the buffer. The caller must
+// hold log_buffer_lock.
+//############################################################################
+static size_t take_log_buffer(kmyth_log_event_t * events)
+{
+  size_t count = log_buffer_count;
+
+  memcpy(events, log_buffer, count * sizeof(kmyth_log_event_t));
+  log_buffer_count = 0;
+  return count;
+}
+
+//############################################################################
+// log_event_ocall()
+//############################################################################
+void log_event_ocall(const char **src_file_ptr,
+                     const char **src_func_ptr,
+                     const int *src_line_ptr,
+                     int *severity_ptr, const char **message_ptr)
+{
+  kmyth_log_event_t events[KMYTH_ENCLAVE_LOG_BUFFER_EVENTS];
+  size_t count = 0;
+
+  sgx_thread_mutex_lock(&log_buffer_lock);
+
+  kmyth_log_event_t *event = &log_buffer[log_buffer_count++];
+
+  copy_log_string(event->src_file, MAX_LOG_SRC_LEN, *src_file_ptr, true);
+  copy_log_string(event->src_func, MAX_LOG_SRC_LEN, *src_func_ptr, false);
+  event->src_line = *src_line_ptr;
+  event->severity = *severity_ptr;
+  copy_log_string(event->message, MAX_LOG_MSG_LEN, *message_ptr, false);
+
+  if (log_buffer_count == KMYTH_ENCLAVE_LOG_BUFFER_EVENTS
+      || *severity_ptr <= KMYTH_ENCLAVE_LOG_FLUSH_SEVERITY)
+  {
+    count = take_log_buffer(events);
+  }
+
+  sgx_thread_mutex_unlock(&log_buffer_lock);
+
+  // the ocall is made without holding the lock
+  if (count > 0)
+  {
+    log_events_ocall(events, count);
+  }
+}
+
+//############################################################################
+// kmyth_enclave_log_flush()
+//############################################################################
+void kmyth_enclave_log_flush(void)
+{
+  kmyth_log_event_t events[KMYTH_ENCLAVE_LOG_BUFFER_EVENTS];
+
+  sgx_thread_mutex_lock(&log_buffer_lock);
+  size_t count = take_log_buffer(events);
+
+  sgx_thread_mutex_unlock(&log_buffer_lock);
+
+  if (count > 0)
+  {
+    log_events_ocall(events, count);
+  }
+}
@@ -6,6 +6,8 @@
 
 #include "sgx_retrieve_key_impl.h"
 
+#include "sgx_trts.h"
+
 #include "cipher/aes_gcm.h"
 
 #include "kmip_util.h"
@@ -26,15 +28,28 @@ int enclave_retrieve_key(EVP_PKEY * enclave_sign_privkey, X509 * peer_cert,
   char msg[MAX_LOG_MSG_LEN] = { 0 };
 
   int socket_fd = -1;
+  unsigned char *msg_buffer = NULL;
+  size_t msg_buffer_len = 0;
 
   ret_ocall = setup_socket_ocall(&ret_val, server_host, server_host_len,
-                                 server_port, &socket_fd);
+                                 server_port, &socket_fd,
+                                 &msg_buffer, &msg_buffer_len);
   if (ret_ocall != SGX_SUCCESS || ret_val != EXIT_SUCCESS)
   {
     kmyth_sgx_log(LOG_ERR, "Client socket setup failed.");
     return EXIT_FAILURE;
   }
 
+  // the message buffer is read and written directly (user_check), so it
+  // must lie entirely outside the enclave
+  if (msg_buffer == NULL
+      || !sgx_is_outside_enclave(msg_buffer, msg_buffer_len))
+  {
+    kmyth_sgx_log(LOG_ERR, "Invalid ECDH message buffer.");
+    close_socket_ocall(socket_fd, NULL);
+    return EXIT_FAILURE;
+  }
+
   // recover public key from certificate
   EVP_PKEY *server_sign_pubkey = NULL;
 
@@ -43,40 +58,41 @@ int enclave_retrieve_key(EVP_PKEY * enclave_sign_privkey, X509 * peer_cert,
   {
     kmyth_sgx_log(LOG_ERR,
                   "public key extraction from server certificate failed");
-    close_socket_ocall(socket_fd);
+    close_socket_ocall(socket_fd, msg_buffer);
     return EXIT_FAILURE;
   }
   kmyth_sgx_log(LOG_DEBUG,
                 "extracted server signature verification key from cert");
 
-  // create client's ephemeral contribution to the session key
-  EC_KEY *client_ephemeral_keypair = NULL;
+  // create client's ephemeral contribution to the session key (the client
+  // chooses the key agreement suite; the server answers in kind)
+  EVP_PKEY *client_ephemeral_keypair = NULL;
   unsigned char *client_ephemeral_pub = NULL;
   size_t client_ephemeral_pub_len = 0;
 
-  ret_val = create_ecdh_ephemeral_key_pair(KMYTH_EC_NID,
-                                           &client_ephemeral_keypair);
+  ret_val = create_ecdh_suite_key_pair(KMYTH_ECDH_SUITE,
+                                       &client_ephemeral_keypair);
 
   if (ret_val != EXIT_SUCCESS)
   {
     kmyth_sgx_log(LOG_ERR, "client ECDH ephemeral key pair creation failed");
     EVP_PKEY_free(server_sign_pubkey);
-    EC_KEY_free(client_ephemeral_keypair);
-    close_socket_ocall(socket_fd);
+    EVP_PKEY_free(client_ephemeral_keypair);
+    close_socket_ocall(socket_fd, msg_buffer);
     return EXIT_FAILURE;
   }
 
-  ret_val = create_ecdh_ephemeral_public(client_ephemeral_keypair,
-                                         &client_ephemeral_pub,
-                                         &client_ephemeral_pub_len);
+  ret_val = create_ecdh_suite_public(client_ephemeral_keypair,
+                                     &client_ephemeral_pub,
+                                     &client_ephemeral_pub_len);
   if (ret_val != EXIT_SUCCESS)
   {
     kmyth_sgx_log(LOG_ERR,
                   "client ECDH 'public key' octet string creation failed");
     EVP_PKEY_free(server_sign_pubkey);
-    EC_KEY_free(client_ephemeral_keypair);
+    EVP_PKEY_free(client_ephemeral_keypair);
     free(client_ephemeral_pub);
-    close_socket_ocall(socket_fd);
+    close_socket_ocall(socket_fd, msg_buffer);
     return EXIT_FAILURE;
   }
   kmyth_sgx_log(LOG_DEBUG,
@@ -95,10 +111,10 @@ int enclave_retrieve_key(EVP_PKEY * enclave_sign_privkey, X509 * peer_cert,
   {
     kmyth_sgx_log(LOG_ERR, "error signing client ephemeral 'public key' bytes");
     EVP_PKEY_free(server_sign_pubkey);
-    EC_KEY_free(client_ephemeral_keypair);
+    EVP_PKEY_free(client_ephemeral_keypair);
     free(client_ephemeral_pub);
     free(client_eph_pub_signature);
-    close_socket_ocall(socket_fd);
+    close_socket_ocall(socket_fd, msg_buffer);
     return EXIT_FAILURE;
   }
   kmyth_sgx_log(LOG_DEBUG,
@@ -123,12 +139,12 @@ int enclave_retrieve_key(EVP_PKEY * enclave_sign_privkey, X509 * peer_cert,
   {
     kmyth_sgx_log(LOG_ERR, "ECDH ephemeral 'public key' exchange unsuccessful");
     EVP_PKEY_free(server_sign_pubkey);
-    EC_KEY_free(client_ephemeral_keypair);
+    EVP_PKEY_free(client_ephemeral_keypair);
     free(client_ephemeral_pub);
     free(client_eph_pub_signature);
     OPENSSL_free_ocall((void **) &server_ephemeral_pub);
     OPENSSL_free_ocall((void **) &server_eph_pub_signature);
-    close_socket_ocall(socket_fd);
+    close_socket_ocall(socket_fd, msg_buffer);
     return EXIT_FAILURE;
   }
   kmyth_sgx_log(LOG_DEBUG,
@@ -148,10 +164,10 @@ int enclave_retrieve_key(EVP_PKEY * enclave_sign_privkey, X509 * peer_cert,
   {
     kmyth_sgx_log(LOG_ERR, "client ephemeral 'public key' signature invalid");
     EVP_PKEY_free(server_sign_pubkey);
-    EC_KEY_free(client_ephemeral_keypair);
+    EVP_PKEY_free(client_ephemeral_keypair);
     OPENSSL_free_ocall((void **) &server_ephemeral_pub);
     OPENSSL_free_ocall((void **) &server_eph_pub_signature);
-    close_socket_ocall(socket_fd);
+    close_socket_ocall(socket_fd, msg_buffer);
     return EXIT_FAILURE;
   }
   kmyth_sgx_log(LOG_DEBUG,
@@ -161,44 +177,29 @@ int enclave_retrieve_key(EVP_PKEY * enclave_sign_privkey, X509 * peer_cert,
   EVP_PKEY_free(server_sign_pubkey);
   OPENSSL_free_ocall((void **) &server_eph_pub_signature);
 
-  // convert server's ephemeral public octet string to an EC_POINT struct
-  EC_POINT *server_ephemeral_pub_pt = NULL;
+  // generate shared secret value result for ECDH key agreement (client side)
+  //   - the server's contribution is decoded (and validated) according to
+  //     the client's suite, so a server answering with a different suite
+  //     fails here
+  unsigned char *session_secret = NULL;
+  size_t session_secret_len = 0;
 
-  ret_val = reconstruct_ecdh_ephemeral_public_point(KMYTH_EC_NID,
-                                                    server_ephemeral_pub,
-                                                    server_ephemeral_pub_len,
-                                                    &server_ephemeral_pub_pt);
-  if (ret_val != EXIT_SUCCESS)
-  {
-    kmyth_sgx_log(LOG_ERR,
-                  "reconstruct client ephemeral 'public key' point failed");
-    EC_KEY_free(client_ephemeral_keypair);
-    free(server_ephemeral_pub);
-    EC_POINT_free(server_ephemeral_pub_pt);
-    close_socket_ocall(socket_fd);
-    return EXIT_FAILURE;
-  }
-  kmyth_sgx_log(LOG_DEBUG,
-                "reconstructed server ECDH ephemeral 'public key' point");
+  ret_val = compute_ecdh_suite_shared_secret(client_ephemeral_keypair,
+                                             server_ephemeral_pub,
+                                             server_ephemeral_pub_len,
+                                             &session_secret,
+                                             &session_secret_len);
 
   // done with server_ephemeral_pub
   OPENSSL_free_ocall((void **) &server_ephemeral_pub);
 
-  // generate shared secret value result for ECDH key agreement (client side)
-  unsigned char *session_secret = NULL;
-  size_t session_secret_len = 0;
-
-  ret_val = compute_ecdh_shared_secret(client_ephemeral_keypair,
-                                       server_ephemeral_pub_pt,
-                                       &session_secret, &session_secret_len);
   if (ret_val)
   {
     kmyth_sgx_log(LOG_ERR,
                   "mutually agreed upon shared secret computation failed");
-    EC_KEY_free(client_ephemeral_keypair);
-    EC_POINT_free(server_ephemeral_pub_pt);
+    EVP_PKEY_free(client_ephemeral_keypair);
     free(session_secret);
-    close_socket_ocall(socket_fd);
+    close_socket_ocall(socket_fd, msg_buffer);
     return EXIT_FAILURE;
   }
   snprintf(msg, MAX_LOG_MSG_LEN,
@@ -209,10 +210,7 @@ int enclave_retrieve_key(EVP_PKEY * enclave_sign_privkey, X509 * peer_cert,
   kmyth_sgx_log(LOG_DEBUG, msg);
 
   // done with inputs to shared secret contribution
-  kmyth_enclave_clear(client_ephemeral_keypair,
-                      sizeof(client_ephemeral_keypair));
-  EC_KEY_free(client_ephemeral_keypair);
-  EC_POINT_free(server_ephemeral_pub_pt);
+  EVP_PKEY_free(client_ephemeral_keypair);
 
   // generate session key result for ECDH key agreement (client side)
   unsigned char *session_key = NULL;
@@ -227,7 +225,7 @@ int enclave_retrieve_key(EVP_PKEY * enclave_sign_privkey, X509 * peer_cert,
     kmyth_sgx_log(LOG_ERR,
                   "mutually agreed upon session key computation failed");
     kmyth_enclave_clear_and_free(session_key, session_key_len);
-    close_socket_ocall(socket_fd);
+    close_socket_ocall(socket_fd, msg_buffer);
     return EXIT_FAILURE;
   }
   snprintf(msg, MAX_LOG_MSG_LEN,
@@ -252,7 +250,7 @@ int enclave_retrieve_key(EVP_PKEY * enclave_sign_privkey, X509 * peer_cert,
     kmyth_sgx_log(LOG_ERR, "Failed to build the KMIP Get request.");
     kmip_destroy(&kmip_context);
     kmyth_enclave_clear_and_free(session_key, session_key_len);
-    close_socket_ocall(socket_fd);
+    close_socket_ocall(socket_fd, msg_buffer);
     return EXIT_FAILURE;
   }
 
@@ -268,16 +266,25 @@ int enclave_retrieve_key(EVP_PKEY * enclave_sign_privkey, X509 * peer_cert,
     kmyth_sgx_log(LOG_ERR, "Failed to encrypt the KMIP key request.");
     kmip_destroy(&kmip_context);
     kmyth_enclave_clear_and_free(session_key, session_key_len);
-    close_socket_ocall(socket_fd);
+    close_socket_ocall(socket_fd, msg_buffer);
     return EXIT_FAILURE;
   }
 
-  // send request and get response from key server
-  unsigned char *encrypted_response = NULL;
-  size_t encrypted_response_len = 0;
+  // send request and get response from key server, by way of the
+  // connection's message buffer
+  if (encrypted_request_len > msg_buffer_len)
+  {
+    kmyth_sgx_log(LOG_ERR, "The KMIP key request is too large to send.");
+    kmyth_enclave_clear_and_free(encrypted_request, encrypted_request_len);
+    kmip_destroy(&kmip_context);
+    kmyth_enclave_clear_and_free(session_key, session_key_len);
+    close_socket_ocall(socket_fd, msg_buffer);
+    return EXIT_FAILURE;
+  }
+  memcpy(msg_buffer, encrypted_request, encrypted_request_len);
 
   ret_ocall = ecdh_send_ocall(&ret_val,
-                              encrypted_request,
+                              msg_buffer,
                               encrypted_request_len,
                               socket_fd);
   kmyth_enclave_clear_and_free(encrypted_request, encrypted_request_len);
@@ -286,18 +293,39 @@ int enclave_retrieve_key(EVP_PKEY * enclave_sign_privkey, X509 * peer_cert,
     kmyth_sgx_log(LOG_ERR, "Failed to send the KMIP key request.");
     kmip_destroy(&kmip_context);
     kmyth_enclave_clear_and_free(session_key, session_key_len);
-    close_socket_ocall(socket_fd);
+    close_socket_ocall(socket_fd, msg_buffer);
     return EXIT_FAILURE;
   }
 
+  unsigned char *encrypted_response = NULL;
+  size_t encrypted_response_len = 0;
+
   ret_ocall = ecdh_recv_ocall(&ret_val,
-                              &encrypted_response,
+                              msg_buffer,
+                              msg_buffer_len,
                               &encrypted_response_len,
                               socket_fd);
-  close_socket_ocall(socket_fd);
-  if (ret_ocall != SGX_SUCCESS || ret_val != EXIT_SUCCESS)
+  if (ret_ocall != SGX_SUCCESS || ret_val != EXIT_SUCCESS
+      || encrypted_response_len > msg_buffer_len)
   {
-    kmyth_sgx_log(LOG_ERR, "Failed to send the KMIP key request.");
+    kmyth_sgx_log(LOG_ERR, "Failed to receive the KMIP key response.");
+    kmip_destroy(&kmip_context);
+    kmyth_enclave_clear_and_free(session_key, session_key_len);
+    close_socket_ocall(socket_fd, msg_buffer);
+    return EXIT_FAILURE;
+  }
+
+  // copy the response in once, so the untrusted side cannot change it
+  // while it is being authenticated and decrypted
+  encrypted_response = (unsigned char *) malloc(encrypted_response_len);
+  if (encrypted_response != NULL)
+  {
+    memcpy(encrypted_response, msg_buffer, encrypted_response_len);
+  }
+  close_socket_ocall(socket_fd, msg_buffer);
+  if (encrypted_response == NULL)
+  {
+    kmyth_sgx_log(LOG_ERR, "Failed to allocate the KMIP key response.");
     kmip_destroy(&kmip_context);
     kmyth_enclave_clear_and_free(session_key, session_key_len);
     return EXIT_FAILURE;
@@ -310,7 +338,7 @@ int enclave_retrieve_key(EVP_PKEY * enclave_sign_privkey, X509 * peer_cert,
   ret_val = aes_gcm_decrypt(session_key, session_key_len,
                             encrypted_response, encrypted_response_len,
                             &response, &response_len);
-  OPENSSL_free_ocall((void **) &encrypted_response);
+  free(encrypted_response);
   kmyth_enclave_clear_and_free(session_key, session_key_len);
   if (ret_val)
   {
@@ -49,21 +49,35 @@ extern "C"
  *                                        number for a socket connected to
  *                                        the remote key server.
  *
+ * @param[out] msg_buffer                 Pointer used to return the address
+ *                                        of an allocated buffer
+ *                                        (ECDH_MAX_MSG_SIZE bytes) that ECDH
+ *                                        messages on this connection are
+ *                                        sent from and received into.
+ *
+ * @param[out] msg_buffer_len             Pointer to the length (in bytes)
+ *                                        of msg_buffer.
+ *
  * @return 0 on success, 1 on failure
  */
   int setup_socket_ocall(const char *server_host, int server_host_len,
-                         int server_port, int *socket_fd);
+                         int server_port, int *socket_fd,
+                         unsigned char **msg_buffer, size_t *msg_buffer_len);
 
 /**
- * @brief Closes a socket connected to the external key server.
+ * @brief Closes a socket connected to the external key server,
+ *        and releases its message buffer.
  *
  * @param[in] socket_fd                   File descriptor
  *                                        number for a socket connected to
  *                                        the remote key server.
  *
+ * @param[in] msg_buffer                  The message buffer returned by
+ *                                        setup_socket_ocall (may be NULL).
+ *
  * @return None
  */
-  void close_socket_ocall(int socket_fd);
+  void close_socket_ocall(int socket_fd, unsigned char *msg_buffer);
 
 /**
  * @brief Gets the current calendar time.
@@ -136,7 +150,9 @@ extern "C"
 /**
  * @brief Send a message over the ECDH network connection.
  *
- * @param[in]  encrypted_msg              Pointer to the encrypted message.
+ * @param[in] msg_buffer                  The message buffer returned by
+ *                                        setup_socket_ocall, holding the
+ *                                        encrypted message.
  *
  * @param[in] encrypted_msg_len           Length (in bytes)
  *                                        of the encrypted message.
@@ -147,16 +163,19 @@ extern "C"
  *
  * @return 0 on success, 1 on failure
  */
-  int ecdh_send_ocall(unsigned char *encrypted_msg,
+  int ecdh_send_ocall(unsigned char *msg_buffer,
                       size_t encrypted_msg_len,
                       int socket_fd);
 
 /**
  * @brief Receive a message over the ECDH network connection.
  *
- * @param[out]  encrypted_msg             Pointer used to return the address
- *                                        of an allocated buffer containing
- *                                        the received encrypted message.
+ * @param[in] msg_buffer                  The message buffer returned by
+ *                                        setup_socket_ocall, which the
+ *                                        encrypted message is received into.
+ *
+ * @param[in] msg_buffer_len              Length (in bytes)
+ *                                        of msg_buffer.
  *
  * @param[out] encrypted_msg_len          Pointer to length (in bytes)
  *                                        of the encrypted message.
@@ -167,7 +186,8 @@ extern "C"
  *
  * @return 0 on success, 1 on failure
  */
-  int ecdh_recv_ocall(unsigned char **encrypted_msg,
+  int ecdh_recv_ocall(unsigned char *msg_buffer,
+                      size_t msg_buffer_len,
                       size_t *encrypted_msg_len,
                       int socket_fd);
 
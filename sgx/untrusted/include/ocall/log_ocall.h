@@ -8,8 +8,12 @@
 #ifndef _KMYTH_LOG_OCALL_H_
 #define _KMYTH_LOG_OCALL_H_
 
+#include <stddef.h>
+
 #include <kmyth/kmyth_log.h>
 
+#include "kmyth_log_event.h"
+
 #ifdef __cplusplus
 extern "C"
 {
@@ -39,6 +43,20 @@ extern "C"
                        const int *src_line_ptr,
                        int *severity_ptr, const char **message_ptr);
 
+/**
+ * @brief Supports calling logger from within enclave for a batch of events
+ *        buffered within the enclave, so that many events are logged with
+ *        a single enclave exit.
+ *
+ * @param[in] events           Array of log events to be logged, in the
+ *                             order they were raised.
+ *
+ * @param[in] event_count      Number of events in the array.
+ *
+ * @return                     None
+ */
+  void log_events_ocall(const kmyth_log_event_t * events, size_t event_count);
+
 #ifdef __cplusplus
 }
 #endif
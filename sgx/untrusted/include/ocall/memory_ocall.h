@@ -8,7 +8,9 @@
 #ifndef _KMYTH_MEMORY_OCALL_H_
 #define _KMYTH_MEMORY_OCALL_H_
 
+#include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 #include <openssl/crypto.h>
 
 #ifdef __cplusplus
@@ -26,6 +28,30 @@ extern "C"
  */
   void OPENSSL_free_ocall(void **mem_block_ptr);
 
+/**
+ * @brief Copies sealed data from the enclave into untrusted memory, where
+ *        it is kept on behalf of the enclave.
+ *
+ * @param[in]  sealed_data      The sealed data
+ *
+ * @param[in]  sealed_data_len  Length (in bytes) of the sealed data
+ *
+ * @param[out] stash            Pointer to the untrusted copy
+ *
+ * @return                     0 on success, 1 on failure
+ */
+  int stash_sealed_data_ocall(uint8_t * sealed_data, size_t sealed_data_len,
+                              uint8_t ** stash);
+
+/**
+ * @brief Releases a copy made by stash_sealed_data_ocall().
+ *
+ * @param[in] stash             Pointer to the untrusted copy
+ *
+ * @return                     None
+ */
+  void free_stashed_data_ocall(uint8_t * stash);
+
 #ifdef __cplusplus
 }
 #endif
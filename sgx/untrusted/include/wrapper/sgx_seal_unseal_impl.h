@@ -10,8 +10,15 @@
 #include <kmyth/kmyth_log.h>
 #include <kmyth/formatting_tools.h>
 
+#include "kmyth_seal_chunk.h"
+
 #include ENCLAVE_HEADER_UNTRUSTED
 
+/**
+ * @brief Maximum number of threads used to decode a batch of .nkl blobs
+ */
+#define NKL_DECODE_MAX_THREADS 16
+
 #ifdef __cplusplus
 extern "C"
 {
@@ -40,6 +47,46 @@ extern "C"
                          size_t *output_len,
                          uint16_t key_policy, sgx_attributes_t attribute_mask);
 
+  /**
+   * @brief Computes the size of the blob produced by sgx-sealing input_len
+   *        bytes, without entering the enclave (the same result as the
+   *        enc_get_sealed_size ecall).
+   *
+   * @param[in]  input_len         Number of plaintext bytes
+   *
+   * @return The sealed size in bytes, or UINT32_MAX if input_len is too large
+   */
+  uint32_t kmyth_sgx_calc_sealed_size(uint32_t input_len);
+
+  /**
+   * @brief High-level function implementing sgx-seal for a batch of inputs
+   *        with a single enclave transition. The sealed sizes are computed
+   *        host-side and every input is sealed into one arena by the
+   *        enc_seal_data_batch ecall, after which each sealed blob is
+   *        formatted as for kmyth_sgx_seal_nkl().
+   *
+   * @param[in]  count             Number of inputs to be sgx-sealed
+   *
+   * @param[in]  inputs            Raw bytes of each input
+   *
+   * @param[in]  input_lens        Number of bytes in each input
+   *
+   * @param[out] outputs           Bytes in nkl format of each sealed input
+   *                               (outputs[i] for inputs[i])
+   *
+   * @param[out] output_lens       Number of bytes in each output
+   *
+   * @return 0 on success, 1 on error (no outputs are returned)
+   */
+  int kmyth_sgx_seal_nkl_batch(sgx_enclave_id_t eid,
+                               size_t count,
+                               uint8_t ** inputs,
+                               size_t *input_lens,
+                               uint8_t ** outputs,
+                               size_t *output_lens,
+                               uint16_t key_policy,
+                               sgx_attributes_t attribute_mask);
+
   /**
    * @brief High-level function implementing sgx-unseal using SGX
    *
@@ -55,6 +102,79 @@ extern "C"
                            uint8_t * input,
                            size_t input_len, uint64_t * handle);
 
+  /**
+   * @brief High-level function implementing sgx-unseal for a batch of .nkl
+   *        blobs with a single enclave transition. The blobs are parsed and
+   *        Base64 decoded in parallel (up to NKL_DECODE_MAX_THREADS threads)
+   *        and then unsealed into the enclave by the
+   *        kmyth_unseal_into_enclave_batch ecall, which takes the unsealed
+   *        data table lock once for the whole batch.
+   *
+   * @param[in]  count             Number of blobs to be sgx-unsealed
+   *
+   * @param[in]  inputs            Raw data of each blob
+   *
+   * @param[in]  input_lens        The size of each blob in bytes
+   *
+   * @param[out] handles           The handle result of sgx-unseal for each
+   *                               blob (handles[i] for inputs[i])
+   *
+   * @return 0 on success, 1 on error (no blob is unsealed)
+   */
+  int kmyth_sgx_unseal_nkl_batch(sgx_enclave_id_t eid,
+                                 size_t count,
+                                 uint8_t ** inputs,
+                                 size_t *input_lens, uint64_t * handles);
+
+  /**
+   * @brief High-level function implementing sgx-seal for data of any size.
+   *        The input is sealed as a chain of chunks by the
+   *        enc_seal_data_chunked ecall, which reads and writes the chunks in
+   *        place, so the enclave memory used depends on the chunk size
+   *        only. Each sealed chunk is written as its own .nkl block.
+   *
+   * @param[in]  input             Raw bytes to be sgx-sealed
+   *
+   * @param[in]  input_len         Number of bytes in input
+   *
+   * @param[in]  chunk_size        Number of input bytes sealed into each
+   *                               chunk (0 for KMYTH_SEAL_CHUNK_SIZE), at most
+   *                               KMYTH_SEAL_CHUNK_MAX_SIZE
+   *
+   * @param[out] output            Bytes in chunked nkl format of sealed data
+   *
+   * @param[out] output_len        Number of bytes in output
+   *
+   * @return 0 on success, 1 on error
+   */
+  int kmyth_sgx_seal_nkl_chunked(sgx_enclave_id_t eid,
+                                 uint8_t * input,
+                                 size_t input_len,
+                                 uint32_t chunk_size,
+                                 uint8_t ** output,
+                                 size_t *output_len,
+                                 uint16_t key_policy,
+                                 sgx_attributes_t attribute_mask);
+
+  /**
+   * @brief High-level function implementing sgx-unseal for the output of
+   *        kmyth_sgx_seal_nkl_chunked(). The chunks are decoded and then
+   *        unsealed into the enclave, one at a time, by the
+   *        kmyth_unseal_into_enclave_chunked ecall, which checks that every
+   *        chunk of the chain is present and in order.
+   *
+   * @param[in]  input             Raw data to be sgx-unsealed
+   *
+   * @param[in]  input_len         The size of input in bytes
+   *
+   * @param[out] handle            The handle result of sgx-unseal
+   *
+   * @return 0 on success, 1 on error
+   */
+  int kmyth_sgx_unseal_nkl_chunked(sgx_enclave_id_t eid,
+                                   uint8_t * input,
+                                   size_t input_len, uint64_t * handle);
+
 #ifdef __cplusplus
 }
 #endif
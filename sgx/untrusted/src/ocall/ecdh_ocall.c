@@ -10,13 +10,30 @@
 
 #define UNSET_FD -1
 
+/*****************************************************************************
+ * rearm_quickack()
+ *
+ * The kernel leaves quick-ACK mode on its own, so (when configured) it is
+ * set again before each receive.
+ ****************************************************************************/
+static void rearm_quickack(int socket_fd)
+{
+  if (KMYTH_ECDH_TCP_QUICKACK)
+  {
+    set_socket_tcp_options(socket_fd, KMYTH_ECDH_TCP_NODELAY, 1);
+  }
+}
+
 /*****************************************************************************
  * setup_socket_ocall()
  ****************************************************************************/
 int setup_socket_ocall(const char *server_host, int server_host_len,
-                       int server_port, int *socket_fd)
+                       int server_port, int *socket_fd,
+                       unsigned char **msg_buffer, size_t *msg_buffer_len)
 {
   *socket_fd = UNSET_FD;
+  *msg_buffer = NULL;
+  *msg_buffer_len = 0;
 
   // create "service" string from integer port number
   char server_service[6]; // max port is 65535, so max string is 5 char + '\0'
@@ -32,18 +49,38 @@ int setup_socket_ocall(const char *server_host, int server_host_len,
     return EXIT_FAILURE;
   }
 
+  // the ECDH exchange is latency bound, configure the connection for it
+  if (set_socket_tcp_options(*socket_fd, KMYTH_ECDH_TCP_NODELAY,
+                             KMYTH_ECDH_TCP_QUICKACK))
+  {
+    kmyth_log(LOG_WARNING, "Using default TCP options for the connection.");
+  }
+
+  // every message on the connection is sent from and received into this
+  // one buffer, which the enclave reads and writes directly
+  *msg_buffer = malloc(ECDH_MAX_MSG_SIZE);
+  if (*msg_buffer == NULL)
+  {
+    kmyth_log(LOG_ERR, "Failed to allocate the ECDH message buffer.");
+    close(*socket_fd);
+    *socket_fd = UNSET_FD;
+    return EXIT_FAILURE;
+  }
+  *msg_buffer_len = ECDH_MAX_MSG_SIZE;
+
   return EXIT_SUCCESS;
 }
 
 /*****************************************************************************
  * close_socket_ocall()
  ****************************************************************************/
-void close_socket_ocall(int socket_fd)
+void close_socket_ocall(int socket_fd, unsigned char *msg_buffer)
 {
   if (socket_fd != UNSET_FD)
   {
     close(socket_fd);
   }
+  free(msg_buffer);
 }
 
 /*****************************************************************************
@@ -67,46 +104,33 @@ int ecdh_exchange_ocall(unsigned char *enclave_ephemeral_public,
                         unsigned int *remote_eph_pub_signature_len,
                         int socket_fd)
 {
-  int num_bytes;
+  // the public key and its signature, each after its length, leave as one
+  // message (wire format unchanged)
+  struct iovec contribution[4] = {
+    {.iov_base = &enclave_ephemeral_public_len,
+     .iov_len = sizeof(enclave_ephemeral_public_len)},
+    {.iov_base = enclave_ephemeral_public,
+     .iov_len = enclave_ephemeral_public_len},
+    {.iov_base = &enclave_eph_pub_signature_len,
+     .iov_len = sizeof(enclave_eph_pub_signature_len)},
+    {.iov_base = enclave_eph_pub_signature,
+     .iov_len = enclave_eph_pub_signature_len}
+  };
 
-  kmyth_log(LOG_DEBUG, "Sending ephemeral public key.");
-  num_bytes =
-    write(socket_fd, &enclave_ephemeral_public_len,
-          sizeof(enclave_ephemeral_public_len));
-  if (num_bytes != sizeof(enclave_ephemeral_public_len))
-  {
-    kmyth_log(LOG_ERR, "Failed to send a message.");
-    return EXIT_FAILURE;
-  }
-  num_bytes =
-    write(socket_fd, enclave_ephemeral_public, enclave_ephemeral_public_len);
-  if (num_bytes != enclave_ephemeral_public_len)
-  {
-    kmyth_log(LOG_ERR, "Failed to send a message.");
-    return EXIT_FAILURE;
-  }
+  *remote_ephemeral_public = NULL;
+  *remote_eph_pub_signature = NULL;
 
-  kmyth_log(LOG_DEBUG, "Sending ephemeral public key signature.");
-  num_bytes =
-    write(socket_fd, &enclave_eph_pub_signature_len,
-          sizeof(enclave_eph_pub_signature_len));
-  if (num_bytes != sizeof(enclave_eph_pub_signature_len))
-  {
-    kmyth_log(LOG_ERR, "Failed to send a message.");
-    return EXIT_FAILURE;
-  }
-  num_bytes =
-    write(socket_fd, enclave_eph_pub_signature, enclave_eph_pub_signature_len);
-  if (num_bytes != enclave_eph_pub_signature_len)
+  kmyth_log(LOG_DEBUG, "Sending ephemeral public key and signature.");
+  if (send_socket_frame(socket_fd, contribution, 4))
   {
     kmyth_log(LOG_ERR, "Failed to send a message.");
     return EXIT_FAILURE;
   }
 
   kmyth_log(LOG_DEBUG, "Receiving ephemeral public key.");
-  num_bytes = read(socket_fd, remote_ephemeral_public_len,
-                   sizeof(*remote_ephemeral_public_len));
-  if (num_bytes != sizeof(*remote_ephemeral_public_len))
+  rearm_quickack(socket_fd);
+  if (recv_socket_exact(socket_fd, remote_ephemeral_public_len,
+                        sizeof(*remote_ephemeral_public_len)))
   {
     kmyth_log(LOG_ERR, "Failed to receive a message.");
     return EXIT_FAILURE;
@@ -124,69 +148,74 @@ int ecdh_exchange_ocall(unsigned char *enclave_ephemeral_public,
     return EXIT_FAILURE;
   }
 
-  num_bytes =
-    read(socket_fd, *remote_ephemeral_public, *remote_ephemeral_public_len);
-  if (num_bytes != *remote_ephemeral_public_len)
+  if (recv_socket_exact(socket_fd, *remote_ephemeral_public,
+                        *remote_ephemeral_public_len))
   {
     kmyth_log(LOG_ERR, "Failed to receive a message.");
-    return EXIT_FAILURE;
+    goto error;
   }
 
   kmyth_log(LOG_DEBUG, "Receiving ephemeral public key signature.");
-  num_bytes = read(socket_fd, remote_eph_pub_signature_len,
-                   sizeof(*remote_eph_pub_signature_len));
-  if (num_bytes != sizeof(*remote_eph_pub_signature_len))
+  if (recv_socket_exact(socket_fd, remote_eph_pub_signature_len,
+                        sizeof(*remote_eph_pub_signature_len)))
   {
     kmyth_log(LOG_ERR, "Failed to receive a message.");
-    return EXIT_FAILURE;
+    goto error;
   }
   if (*remote_eph_pub_signature_len > ECDH_MAX_MSG_SIZE)
   {
     kmyth_log(LOG_ERR, "Received invalid public key signature size.");
-    return EXIT_FAILURE;
+    goto error;
   }
 
   *remote_eph_pub_signature = OPENSSL_zalloc(*remote_eph_pub_signature_len);
   if (*remote_eph_pub_signature == NULL)
   {
     kmyth_log(LOG_ERR, "Failed to allocate the remote ephemeral public key.");
-    return EXIT_FAILURE;
+    goto error;
   }
 
-  num_bytes = read(socket_fd, *remote_eph_pub_signature,
-                   *remote_eph_pub_signature_len);
-  if (num_bytes != *remote_eph_pub_signature_len)
+  if (recv_socket_exact(socket_fd, *remote_eph_pub_signature,
+                        *remote_eph_pub_signature_len))
   {
     kmyth_log(LOG_ERR, "Failed to receive a message.");
-    return EXIT_FAILURE;
+    goto error;
   }
 
   return EXIT_SUCCESS;
+
+error:
+  OPENSSL_free(*remote_ephemeral_public);
+  *remote_ephemeral_public = NULL;
+  OPENSSL_free(*remote_eph_pub_signature);
+  *remote_eph_pub_signature = NULL;
+  return EXIT_FAILURE;
 }
 
 /*****************************************************************************
  * ecdh_send_ocall()
  ****************************************************************************/
-int ecdh_send_ocall(unsigned char *encrypted_msg,
+int ecdh_send_ocall(unsigned char *msg_buffer,
                     size_t encrypted_msg_len,
                     int socket_fd)
 {
-  ssize_t write_result;
   struct ECDHMessageHeader header;
+  struct iovec msg[2] = {
+    {.iov_base = &header,.iov_len = sizeof(header)},
+    {.iov_base = msg_buffer,.iov_len = encrypted_msg_len}
+  };
 
   kmyth_log(LOG_DEBUG, "Sending ecdh message.");
 
-  secure_memset(&header, 0, sizeof(header));
-  header.msg_size = encrypted_msg_len;
-  write_result = write(socket_fd, &header, sizeof(header));
-  if (write_result != sizeof(header))
+  if (encrypted_msg_len > ECDH_MAX_MSG_SIZE)
   {
-    kmyth_log(LOG_ERR, "Failed to send an ECDH message header.");
+    kmyth_log(LOG_ERR, "Invalid ECDH message length.");
     return EXIT_FAILURE;
   }
 
-  write_result = write(socket_fd, encrypted_msg, encrypted_msg_len);
-  if (write_result != encrypted_msg_len)
+  secure_memset(&header, 0, sizeof(header));
+  header.msg_size = encrypted_msg_len;
+  if (send_socket_frame(socket_fd, msg, 2))
   {
     kmyth_log(LOG_ERR, "Failed to send an ECDH message.");
     return EXIT_FAILURE;
@@ -198,38 +227,34 @@ int ecdh_send_ocall(unsigned char *encrypted_msg,
 /*****************************************************************************
  * ecdh_recv_ocall()
  ****************************************************************************/
-int ecdh_recv_ocall(unsigned char **encrypted_msg,
+int ecdh_recv_ocall(unsigned char *msg_buffer,
+                    size_t msg_buffer_len,
                     size_t *encrypted_msg_len,
                     int socket_fd)
 {
-  ssize_t read_result;
   struct ECDHMessageHeader header;
 
   kmyth_log(LOG_DEBUG, "Receiving ecdh message.");
 
   secure_memset(&header, 0, sizeof(header));
-  read_result = read(socket_fd, &header, sizeof(header));
-  if (read_result != sizeof(header))
+  rearm_quickack(socket_fd);
+  if (recv_socket_exact(socket_fd, &header, sizeof(header)))
   {
     kmyth_log(LOG_ERR, "Failed to read an ECDH message header.");
     return EXIT_FAILURE;
   }
-
-  *encrypted_msg = OPENSSL_zalloc(header.msg_size);
-  if (*encrypted_msg == NULL)
+  if (header.msg_size > ECDH_MAX_MSG_SIZE || header.msg_size > msg_buffer_len)
   {
-    kmyth_log(LOG_ERR, "Failed to allocate the encrypted response buffer.");
+    kmyth_log(LOG_ERR, "Received invalid ECDH message header.");
     return EXIT_FAILURE;
   }
 
-  read_result = read(socket_fd, *encrypted_msg, header.msg_size);
-  if (read_result != header.msg_size)
+  if (recv_socket_exact(socket_fd, msg_buffer, header.msg_size))
   {
     kmyth_log(LOG_ERR, "Failed to read an ECDH message.");
-    kmyth_clear_and_free(*encrypted_msg, header.msg_size);
     return EXIT_FAILURE;
   }
-  *encrypted_msg_len = read_result;
+  *encrypted_msg_len = header.msg_size;
 
   return EXIT_SUCCESS;
 }
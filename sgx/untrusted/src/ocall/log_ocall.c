@@ -18,3 +18,15 @@ void log_event_ocall(const char **src_file_ptr,
   log_event(*src_file_ptr, *src_func_ptr, *src_line_ptr, *severity_ptr,
             *message_ptr);
 }
+
+/*****************************************************************************
+ * log_events_ocall
+ ****************************************************************************/
+void log_events_ocall(const kmyth_log_event_t * events, size_t event_count)
+{
+  for (size_t i = 0; i < event_count; i++)
+  {
+    log_event(events[i].src_file, events[i].src_func, events[i].src_line,
+              events[i].severity, "%s", events[i].message);
+  }
+}
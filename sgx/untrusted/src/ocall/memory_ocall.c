@@ -15,3 +15,32 @@ void OPENSSL_free_ocall(void **mem_block_ptr)
 {
   OPENSSL_free(*mem_block_ptr);
 }
+
+/*****************************************************************************
+ * stash_sealed_data_ocall
+ ****************************************************************************/
+int stash_sealed_data_ocall(uint8_t * sealed_data, size_t sealed_data_len,
+                            uint8_t ** stash)
+{
+  *stash = NULL;
+  if (sealed_data == NULL || sealed_data_len == 0)
+  {
+    return 1;
+  }
+
+  *stash = (uint8_t *) malloc(sealed_data_len);
+  if (*stash == NULL)
+  {
+    return 1;
+  }
+  memcpy(*stash, sealed_data, sealed_data_len);
+  return 0;
+}
+
+/*****************************************************************************
+ * free_stashed_data_ocall
+ ****************************************************************************/
+void free_stashed_data_ocall(uint8_t * stash)
+{
+  free(stash);
+}
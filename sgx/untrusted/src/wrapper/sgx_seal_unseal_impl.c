@@ -12,9 +12,12 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
+#include <pthread.h>
+#include <unistd.h>
 
 #include <kmyth/kmyth_log.h>
 #include <kmyth/formatting_tools.h>
+#include <kmyth/memory_util.h>
 
 #include ENCLAVE_HEADER_UNTRUSTED
 
@@ -54,16 +57,156 @@ int kmyth_sgx_seal_nkl(sgx_enclave_id_t eid, uint8_t * input, size_t input_len,
 }
 
 //############################################################################
-// kmyth_sgx_unseal_nkl()
+// kmyth_sgx_calc_sealed_size()
 //############################################################################
-int kmyth_sgx_unseal_nkl(sgx_enclave_id_t eid, uint8_t * input,
-                         size_t input_len, uint64_t * handle)
+uint32_t kmyth_sgx_calc_sealed_size(uint32_t input_len)
+{
+  // Mirrors sgx_calc_sealed_data_size(0, input_len), which is only
+  // available inside the enclave: a sealed blob is its header followed
+  // by the (same length) ciphertext, with no additional MAC text.
+  if (input_len > UINT32_MAX - sizeof(sgx_sealed_data_t))
+  {
+    return UINT32_MAX;
+  }
+  return (uint32_t) (sizeof(sgx_sealed_data_t) + input_len);
+}
+
+//############################################################################
+// kmyth_sgx_seal_nkl_batch()
+//############################################################################
+int kmyth_sgx_seal_nkl_batch(sgx_enclave_id_t eid, size_t count,
+                             uint8_t ** inputs, size_t *input_lens,
+                             uint8_t ** outputs, size_t *output_lens,
+                             uint16_t key_policy,
+                             sgx_attributes_t attribute_mask)
+{
+  if (count == 0 || inputs == NULL || input_lens == NULL || outputs == NULL
+      || output_lens == NULL)
+  {
+    kmyth_log(LOG_ERR, "invalid batch seal parameters ... exiting");
+    return 1;
+  }
+
+  for (size_t i = 0; i < count; i++)
+  {
+    outputs[i] = NULL;
+    output_lens[i] = 0;
+  }
+
+  // Lay out the batch host-side: the plaintexts packed back to back, and
+  // an arena holding every sealed blob back to back.
+  uint32_t *in_lens = (uint32_t *) malloc(count * sizeof(uint32_t));
+  size_t *sealed_lens = (size_t *) malloc(count * sizeof(size_t));
+  size_t in_size = 0;
+  size_t arena_size = 0;
+
+  if (in_lens == NULL || sealed_lens == NULL)
+  {
+    kmyth_log(LOG_ERR, "error allocating batch seal lengths ... exiting");
+    free(in_lens);
+    free(sealed_lens);
+    return 1;
+  }
+
+  for (size_t i = 0; i < count; i++)
+  {
+    uint32_t sealed_len = UINT32_MAX;
+
+    if (inputs[i] != NULL && input_lens[i] != 0
+        && input_lens[i] < UINT32_MAX)
+    {
+      sealed_len = kmyth_sgx_calc_sealed_size((uint32_t) input_lens[i]);
+    }
+    if (sealed_len == UINT32_MAX
+        || in_size + input_lens[i] > UINT32_MAX
+        || arena_size + sealed_len > UINT32_MAX)
+    {
+      kmyth_log(LOG_ERR, "invalid size for batch input %zu ... exiting", i);
+      free(in_lens);
+      free(sealed_lens);
+      return 1;
+    }
+    in_lens[i] = (uint32_t) input_lens[i];
+    sealed_lens[i] = sealed_len;
+    in_size += input_lens[i];
+    arena_size += sealed_len;
+  }
+
+  uint8_t *in_data = (uint8_t *) malloc(in_size);
+  uint8_t *arena = (uint8_t *) malloc(arena_size);
+
+  if (in_data == NULL || arena == NULL)
+  {
+    kmyth_log(LOG_ERR, "error allocating batch seal buffers ... exiting");
+    free(in_data);
+    free(arena);
+    free(in_lens);
+    free(sealed_lens);
+    return 1;
+  }
+
+  uint8_t *in_ptr = in_data;
+
+  for (size_t i = 0; i < count; i++)
+  {
+    memcpy(in_ptr, inputs[i], input_lens[i]);
+    in_ptr += input_lens[i];
+  }
+
+  int ret = 1;
+  sgx_status_t sgx_ret = enc_seal_data_batch(eid, &ret, in_data,
+                                             (uint32_t) in_size, in_lens,
+                                             count, arena,
+                                             (uint32_t) arena_size,
+                                             key_policy, attribute_mask);
+
+  kmyth_clear_and_free(in_data, in_size);
+  free(in_lens);
+  if (sgx_ret != SGX_SUCCESS || ret != 0)
+  {
+    kmyth_log(LOG_ERR, "error to seal batch of %zu buffers ... exiting",
+              count);
+    free(arena);
+    free(sealed_lens);
+    return 1;
+  }
+
+  uint8_t *arena_ptr = arena;
+
+  for (size_t i = 0; i < count; i++)
+  {
+    if (create_nkl_bytes(arena_ptr, sealed_lens[i], &outputs[i],
+                         &output_lens[i]))
+    {
+      kmyth_log(LOG_ERR, "error writing data to .nkl format ... exiting");
+      for (size_t j = 0; j < i; j++)
+      {
+        free(outputs[j]);
+        outputs[j] = NULL;
+        output_lens[j] = 0;
+      }
+      free(arena);
+      free(sealed_lens);
+      return 1;
+    }
+    arena_ptr += sealed_lens[i];
+  }
+
+  free(arena);
+  free(sealed_lens);
+  return 0;
+}
+
+//############################################################################
+// decode_nkl()
+//############################################################################
+static int decode_nkl(uint8_t * input, size_t input_len, uint8_t ** data,
+                      size_t *data_size)
 {
-  uint8_t *block = NULL;
-  size_t blocksize = 0;
+  block_view_t block = {.data = NULL,.size = 0 };
 
-  if (get_block_bytes
-      ((char **) &input, &input_len, &block, &blocksize,
+  if (get_block_view
+      (&input, &input_len, &block,
        (char *) KMYTH_DELIM_NKL_DATA, strlen(KMYTH_DELIM_NKL_DATA),
        (char *) KMYTH_DELIM_END_NKL, strlen(KMYTH_DELIM_END_NKL)))
   {
@@ -71,18 +214,31 @@ int kmyth_sgx_unseal_nkl(sgx_enclave_id_t eid, uint8_t * input,
     return 1;
   }
 
+  if (decodeBase64Data(block.data, block.size, (unsigned char **) data,
+                       data_size))
+  {
+    kmyth_log(LOG_ERR, "error Base64 decode of block bytes ... exiting");
+    return 1;
+  }
+
+  return 0;
+}
+
+//############################################################################
+// kmyth_sgx_unseal_nkl()
+//############################################################################
+int kmyth_sgx_unseal_nkl(sgx_enclave_id_t eid, uint8_t * input,
+                         size_t input_len, uint64_t * handle)
+{
   uint8_t *data = NULL;
   size_t data_size = 0;
   bool ret;
 
-  if (decodeBase64Data(block, blocksize, (unsigned char **) &data, &data_size))
+  if (decode_nkl(input, input_len, &data, &data_size))
   {
-    kmyth_log(LOG_ERR, "error Base64 decode of block bytes ... exiting");
-    free(block);
     return 1;
   }
 
-  free(block);
   kmyth_unseal_into_enclave(eid, &ret, data_size, data, handle);
   if (ret == false)
   {
@@ -94,3 +250,386 @@ int kmyth_sgx_unseal_nkl(sgx_enclave_id_t eid, uint8_t * input,
   free(data);
   return 0;
 }
+
+/**
+ * @brief A contiguous range of .nkl blobs decoded by one thread of
+ *        kmyth_sgx_unseal_nkl_batch().
+ */
+typedef struct nkl_decode_work_s
+{
+  uint8_t **inputs;
+  size_t *input_lens;
+  uint8_t **blobs;
+  size_t *blob_lens;
+  size_t first;
+  size_t last;
+  int status;
+} nkl_decode_work_t;
+
+//############################################################################
+// decode_nkl_range()
+//############################################################################
+static void *decode_nkl_range(void *arg)
+{
+  nkl_decode_work_t *work = (nkl_decode_work_t *) arg;
+
+  work->status = 0;
+  for (size_t i = work->first; i < work->last; i++)
+  {
+    if (decode_nkl(work->inputs[i], work->input_lens[i], &work->blobs[i],
+                   &work->blob_lens[i]))
+    {
+      work->status = 1;
+      break;
+    }
+  }
+  return NULL;
+}
+
+//############################################################################
+// decode_nkl_batch()
+//############################################################################
+static int decode_nkl_batch(size_t count, uint8_t ** inputs,
+                            size_t *input_lens, uint8_t ** blobs,
+                            size_t *blob_lens)
+{
+  long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+  size_t thread_count = (cpus > 0) ? (size_t) cpus : 1;
+
+  if (thread_count > NKL_DECODE_MAX_THREADS)
+  {
+    thread_count = NKL_DECODE_MAX_THREADS;
+  }
+  if (thread_count > count)
+  {
+    thread_count = count;
+  }
+
+  nkl_decode_work_t work[NKL_DECODE_MAX_THREADS];
+  pthread_t threads[NKL_DECODE_MAX_THREADS];
+  bool started[NKL_DECODE_MAX_THREADS] = { false };
+
+  // split the blobs into contiguous, near-equal ranges
+  for (size_t t = 0; t < thread_count; t++)
+  {
+    work[t].inputs = inputs;
+    work[t].input_lens = input_lens;
+    work[t].blobs = blobs;
+    work[t].blob_lens = blob_lens;
+    work[t].first = (count * t) / thread_count;
+    work[t].last = (count * (t + 1)) / thread_count;
+    work[t].status = 1;
+  }
+
+  // the calling thread decodes the first range itself
+  for (size_t t = 1; t < thread_count; t++)
+  {
+    if (pthread_create(&threads[t], NULL, decode_nkl_range, &work[t]) == 0)
+    {
+      started[t] = true;
+    }
+  }
+  decode_nkl_range(&work[0]);
+
+  int retval = work[0].status;
+
+  for (size_t t = 1; t < thread_count; t++)
+  {
+    if (started[t])
+    {
+      pthread_join(threads[t], NULL);
+    }
+    else
+    {
+      // thread creation failed, so decode this range here instead
+      decode_nkl_range(&work[t]);
+    }
+    retval |= work[t].status;
+  }
+
+  return retval;
+}
+
+//############################################################################
+// kmyth_sgx_unseal_nkl_batch()
+//############################################################################
+int kmyth_sgx_unseal_nkl_batch(sgx_enclave_id_t eid, size_t count,
+                               uint8_t ** inputs, size_t *input_lens,
+                               uint64_t * handles)
+{
+  if (count == 0 || inputs == NULL || input_lens == NULL || handles == NULL)
+  {
+    kmyth_log(LOG_ERR, "invalid batch unseal parameters ... exiting");
+    return 1;
+  }
+
+  uint8_t **blobs = (uint8_t **) calloc(count, sizeof(uint8_t *));
+  size_t *blob_lens = (size_t *) calloc(count, sizeof(size_t));
+  uint32_t *data_lens = (uint32_t *) malloc(count * sizeof(uint32_t));
+  uint8_t *data = NULL;
+  size_t data_size = 0;
+  uint8_t *data_ptr = NULL;
+  bool ret = false;
+  sgx_status_t sgx_ret;
+  int retval = 1;
+
+  if (blobs == NULL || blob_lens == NULL || data_lens == NULL)
+  {
+    kmyth_log(LOG_ERR, "error allocating batch unseal buffers ... exiting");
+    goto cleanup;
+  }
+
+  // Parse and decode every blob (in parallel) before entering the enclave.
+  if (decode_nkl_batch(count, inputs, input_lens, blobs, blob_lens))
+  {
+    kmyth_log(LOG_ERR, "error decoding batch of .nkl blobs ... exiting");
+    goto cleanup;
+  }
+
+  for (size_t i = 0; i < count; i++)
+  {
+    if (blob_lens[i] > UINT32_MAX || data_size + blob_lens[i] > UINT32_MAX)
+    {
+      kmyth_log(LOG_ERR, "invalid size for batch input %zu ... exiting", i);
+      goto cleanup;
+    }
+    data_lens[i] = (uint32_t) blob_lens[i];
+    data_size += blob_lens[i];
+  }
+
+  // The ecall takes the sealed blobs packed back to back.
+  data = (uint8_t *) malloc(data_size);
+  if (data == NULL)
+  {
+    kmyth_log(LOG_ERR, "error allocating batch unseal buffers ... exiting");
+    goto cleanup;
+  }
+
+  data_ptr = data;
+  for (size_t i = 0; i < count; i++)
+  {
+    memcpy(data_ptr, blobs[i], blob_lens[i]);
+    data_ptr += blob_lens[i];
+  }
+
+  sgx_ret = kmyth_unseal_into_enclave_batch(eid, &ret, data,
+                                            (uint32_t) data_size, data_lens,
+                                            count, handles);
+
+  if (sgx_ret != SGX_SUCCESS || ret == false)
+  {
+    kmyth_log(LOG_ERR, "error to unseal batch of %zu blobs ... exiting",
+              count);
+    goto cleanup;
+  }
+
+  retval = 0;
+
+cleanup:
+  if (blobs != NULL)
+  {
+    for (size_t i = 0; i < count; i++)
+    {
+      free(blobs[i]);
+    }
+  }
+  free(blobs);
+  free(blob_lens);
+  free(data_lens);
+  free(data);
+  return retval;
+}
+
+//############################################################################
+// kmyth_sgx_seal_nkl_chunked()
+//############################################################################
+int kmyth_sgx_seal_nkl_chunked(sgx_enclave_id_t eid, uint8_t * input,
+                               size_t input_len, uint32_t chunk_size,
+                               uint8_t ** output, size_t *output_len,
+                               uint16_t key_policy,
+                               sgx_attributes_t attribute_mask)
+{
+  if (chunk_size == 0)
+  {
+    chunk_size = KMYTH_SEAL_CHUNK_SIZE;
+  }
+  if (input == NULL || input_len == 0
+      || chunk_size > KMYTH_SEAL_CHUNK_MAX_SIZE)
+  {
+    kmyth_log(LOG_ERR, "invalid chunked seal parameters ... exiting");
+    return 1;
+  }
+
+  // Each sealed chunk is its header and additional MAC text (the same for
+  // every chunk) followed by the ciphertext, as sized by the enclave.
+  size_t overhead = sizeof(sgx_sealed_data_t) + sizeof(kmyth_seal_chunk_aad_t);
+  size_t chunk_count = (input_len - 1) / chunk_size + 1;
+
+  if (chunk_count > (SIZE_MAX - input_len) / overhead)
+  {
+    kmyth_log(LOG_ERR, "input too large to seal ... exiting");
+    return 1;
+  }
+
+  size_t sealed_size = chunk_count * overhead + input_len;
+  uint8_t *sealed = (uint8_t *) malloc(sealed_size);
+  block_spec_t *blocks =
+    (block_spec_t *) malloc(chunk_count * sizeof(block_spec_t));
+
+  if (sealed == NULL || blocks == NULL)
+  {
+    kmyth_log(LOG_ERR, "error allocating chunked seal buffers ... exiting");
+    free(sealed);
+    free(blocks);
+    return 1;
+  }
+
+  int ret = 1;
+  sgx_status_t sgx_ret = enc_seal_data_chunked(eid, &ret, input, input_len,
+                                               chunk_size, sealed,
+                                               sealed_size, key_policy,
+                                               attribute_mask);
+
+  if (sgx_ret != SGX_SUCCESS || ret != 0)
+  {
+    kmyth_log(LOG_ERR, "error to seal %zu chunks ... exiting", chunk_count);
+    free(sealed);
+    free(blocks);
+    return 1;
+  }
+
+  // one .nkl block for each sealed chunk
+  uint8_t *sealed_ptr = sealed;
+  size_t remaining = input_len;
+
+  for (size_t i = 0; i < chunk_count; i++)
+  {
+    size_t len = (remaining < chunk_size) ? remaining : chunk_size;
+
+    blocks[i].delim = (char *) KMYTH_DELIM_NKL_CHUNK;
+    blocks[i].data = sealed_ptr;
+    blocks[i].data_len = overhead + len;
+    blocks[i].raw = false;
+    sealed_ptr += overhead + len;
+    remaining -= len;
+  }
+
+  int retval = 0;
+
+  if (create_block_bytes(blocks, chunk_count, (char *) KMYTH_DELIM_END_NKL,
+                         output, output_len))
+  {
+    kmyth_log(LOG_ERR, "error writing data to .nkl format ... exiting");
+    retval = 1;
+  }
+
+  free(sealed);
+  free(blocks);
+  return retval;
+}
+
+//############################################################################
+// next_nkl_chunk()
+//############################################################################
+static int next_nkl_chunk(uint8_t ** contents, size_t *remaining,
+                          block_view_t * block)
+{
+  // A chunk ends where the next delimiter (of another chunk, or the end of
+  // the file) starts, and Base64 data never contains a '-'.
+  return get_block_view(contents, remaining, block,
+                        (char *) KMYTH_DELIM_NKL_CHUNK,
+                        strlen(KMYTH_DELIM_NKL_CHUNK), (char *) "-----",
+                        strlen("-----"));
+}
+
+//############################################################################
+// kmyth_sgx_unseal_nkl_chunked()
+//############################################################################
+int kmyth_sgx_unseal_nkl_chunked(sgx_enclave_id_t eid, uint8_t * input,
+                                 size_t input_len, uint64_t * handle)
+{
+  size_t chunk_delim_len = strlen(KMYTH_DELIM_NKL_CHUNK);
+  size_t end_delim_len = strlen(KMYTH_DELIM_END_NKL);
+  block_view_t block = {.data = NULL,.size = 0 };
+  uint8_t *position = input;
+  size_t remaining = input_len;
+  size_t decoded_bound = 0;
+
+  if (input == NULL || handle == NULL)
+  {
+    kmyth_log(LOG_ERR, "invalid chunked unseal parameters ... exiting");
+    return 1;
+  }
+
+  // First pass: check the layout and bound the size of the decoded chunks.
+  do
+  {
+    if (next_nkl_chunk(&position, &remaining, &block))
+    {
+      kmyth_log(LOG_ERR, "error getting chunk bytes ... exiting");
+      return 1;
+    }
+    decoded_bound += (block.size / 4 + 1) * 3;
+  }
+  while (remaining >= chunk_delim_len
+         && !memcmp(position, KMYTH_DELIM_NKL_CHUNK, chunk_delim_len));
+
+  if (remaining < end_delim_len
+      || memcmp(position, KMYTH_DELIM_END_NKL, end_delim_len))
+  {
+    kmyth_log(LOG_ERR, "unexpected delimiter ... exiting");
+    return 1;
+  }
+
+  // Second pass: decode the chunks back to back, for the enclave to read
+  // in place.
+  uint8_t *data = (uint8_t *) malloc(decoded_bound);
+  size_t data_size = 0;
+
+  if (data == NULL)
+  {
+    kmyth_log(LOG_ERR, "error allocating chunked unseal buffer ... exiting");
+    return 1;
+  }
+
+  position = input;
+  remaining = input_len;
+  while (remaining >= chunk_delim_len
+         && !memcmp(position, KMYTH_DELIM_NKL_CHUNK, chunk_delim_len))
+  {
+    uint8_t *chunk = NULL;
+    size_t chunk_len = 0;
+
+    if (next_nkl_chunk(&position, &remaining, &block)
+        || decodeBase64Data(block.data, block.size, &chunk, &chunk_len))
+    {
+      kmyth_log(LOG_ERR, "error Base64 decode of chunk bytes ... exiting");
+      free(data);
+      return 1;
+    }
+    if (chunk_len > decoded_bound - data_size)
+    {
+      kmyth_log(LOG_ERR, "unexpected chunk size ... exiting");
+      free(chunk);
+      free(data);
+      return 1;
+    }
+    memcpy(data + data_size, chunk, chunk_len);
+    data_size += chunk_len;
+    free(chunk);
+  }
+
+  bool ret = false;
+  sgx_status_t sgx_ret = kmyth_unseal_into_enclave_chunked(eid, &ret, data,
+                                                           data_size,
+                                                           handle);
+
+  free(data);
+  if (sgx_ret != SGX_SUCCESS || ret == false)
+  {
+    kmyth_log(LOG_ERR, "error to unseal chunked data ... exiting");
+    return 1;
+  }
+
+  return 0;
+}
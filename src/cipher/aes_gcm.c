@@ -171,7 +171,7 @@ int aes_gcm_decrypt(unsigned char *key,
   // should be sized as the input minus the lengths of the IV and tag fields
   *outData_len = inData_len - (GCM_IV_LEN + GCM_TAG_LEN);
   *outData = NULL;
-  *outData = malloc(*outData_len);
+  *outData = kmyth_secure_alloc(*outData_len);
   if (*outData == NULL)
   {
     return 1;
@@ -195,7 +195,7 @@ int aes_gcm_decrypt(unsigned char *key,
 
   if (!(ctx = EVP_CIPHER_CTX_new()))
   {
-    free(*outData);
+    kmyth_clear_and_free(*outData, *outData_len);
     return 1;
   }
   int init_result = 0;
@@ -216,7 +216,7 @@ int aes_gcm_decrypt(unsigned char *key,
   }
   if (!init_result)
   {
-    free(*outData);
+    kmyth_clear_and_free(*outData, *outData_len);
     EVP_CIPHER_CTX_free(ctx);
     return 1;
   }
@@ -224,7 +224,7 @@ int aes_gcm_decrypt(unsigned char *key,
   // set tag to expected tag passed in with input data
   if (!EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_TAG, GCM_TAG_LEN, tag))
   {
-    free(*outData);
+    kmyth_clear_and_free(*outData, *outData_len);
     EVP_CIPHER_CTX_free(ctx);
     return 1;
   }
@@ -232,7 +232,7 @@ int aes_gcm_decrypt(unsigned char *key,
   // set the IV length in the cipher context
   if (!EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_IVLEN, GCM_IV_LEN, NULL))
   {
-    free(*outData);
+    kmyth_clear_and_free(*outData, *outData_len);
     EVP_CIPHER_CTX_free(ctx);
     return 1;
   }
@@ -240,7 +240,7 @@ int aes_gcm_decrypt(unsigned char *key,
   // set the key and IV in the cipher context
   if (!EVP_DecryptInit_ex(ctx, NULL, NULL, key, iv))
   {
-    free(*outData);
+    kmyth_clear_and_free(*outData, *outData_len);
     EVP_CIPHER_CTX_free(ctx);
     return 1;
   }
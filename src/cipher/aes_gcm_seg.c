@@ -0,0 +1,438 @@
+/**
+ * @file  aes_gcm_seg.c
+ *
+ * @brief Implements segmented, multi-threaded AES GCM for kmyth.
+ */
+
+#include "cipher/aes_gcm_seg.h"
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <openssl/evp.h>
+#include <openssl/rand.h>
+
+#include "memory_util.h"
+
+/**
+ * @brief Work assignment (a contiguous range of segments) for one thread
+ */
+typedef struct
+{
+  unsigned char *key;
+  size_t key_len;
+  bool encrypt;
+  unsigned char *header;
+  unsigned char *pt;
+  unsigned char *ct;
+  size_t pt_len;
+  size_t segment_size;
+  size_t first_segment;
+  size_t last_segment;
+  int status;
+} gcm_seg_work_t;
+
+//############################################################################
+// store_be()
+//############################################################################
+static void store_be(unsigned char *dest, uint64_t value, size_t len)
+{
+  for (size_t i = 0; i < len; i++)
+  {
+    dest[len - 1 - i] = (unsigned char) (value >> (8 * i));
+  }
+}
+
+//############################################################################
+// load_be()
+//############################################################################
+static uint64_t load_be(unsigned char *src, size_t len)
+{
+  uint64_t value = 0;
+
+  for (size_t i = 0; i < len; i++)
+  {
+    value = (value << 8) | src[i];
+  }
+  return value;
+}
+
+//############################################################################
+// get_segment_count()
+//############################################################################
+static size_t get_segment_count(size_t pt_len, size_t segment_size)
+{
+  // an empty payload is still carried (and authenticated) by one segment
+  if (pt_len == 0)
+  {
+    return 1;
+  }
+  return (pt_len / segment_size) + ((pt_len % segment_size) ? 1 : 0);
+}
+
+//############################################################################
+// get_thread_count()
+//############################################################################
+static size_t get_thread_count(size_t segment_count)
+{
+  long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+  size_t thread_count = (cpus > 0) ? (size_t) cpus : 1;
+
+  if (thread_count > GCM_SEG_MAX_THREADS)
+  {
+    thread_count = GCM_SEG_MAX_THREADS;
+  }
+  if (thread_count > segment_count)
+  {
+    thread_count = segment_count;
+  }
+  return thread_count;
+}
+
+//############################################################################
+// init_gcm_ctx()
+//############################################################################
+static EVP_CIPHER_CTX *init_gcm_ctx(unsigned char *key, size_t key_len,
+                                    bool encrypt)
+{
+  const EVP_CIPHER *evp_cipher = NULL;
+
+  switch (key_len)
+  {
+  case 16:
+    evp_cipher = EVP_aes_128_gcm();
+    break;
+  case 24:
+    evp_cipher = EVP_aes_192_gcm();
+    break;
+  case 32:
+    evp_cipher = EVP_aes_256_gcm();
+    break;
+  default:
+    return NULL;
+  }
+
+  EVP_CIPHER_CTX *ctx = EVP_CIPHER_CTX_new();
+
+  if (ctx == NULL)
+  {
+    return NULL;
+  }
+
+  // the key is set once, each segment then only re-initializes the IV
+  if (!EVP_CipherInit_ex(ctx, evp_cipher, NULL, NULL, NULL, encrypt)
+      || !EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_IVLEN, GCM_IV_LEN, NULL)
+      || !EVP_CipherInit_ex(ctx, NULL, NULL, key, NULL, encrypt))
+  {
+    EVP_CIPHER_CTX_free(ctx);
+    return NULL;
+  }
+  return ctx;
+}
+
+//############################################################################
+// process_segment()
+//############################################################################
+static int process_segment(EVP_CIPHER_CTX * ctx, gcm_seg_work_t * work,
+                           size_t index)
+{
+  size_t pt_offset = index * work->segment_size;
+  size_t seg_len = work->pt_len - pt_offset;
+
+  if (seg_len > work->segment_size)
+  {
+    seg_len = work->segment_size;
+  }
+
+  unsigned char *pt = work->pt + pt_offset;
+  unsigned char *ct = work->ct + index * (work->segment_size + GCM_TAG_LEN);
+  unsigned char *tag = ct + seg_len;
+
+  // segment IV: base IV with the segment index XORed into its last 8 bytes
+  unsigned char iv[GCM_IV_LEN];
+  unsigned char index_bytes[8];
+
+  memcpy(iv, work->header, GCM_IV_LEN);
+  store_be(index_bytes, (uint64_t) index, 8);
+  for (size_t i = 0; i < 8; i++)
+  {
+    iv[GCM_IV_LEN - 8 + i] ^= index_bytes[i];
+  }
+
+  // AAD: header||index, binding the segment position and the segment count
+  unsigned char aad[GCM_SEG_HEADER_LEN + 8];
+
+  memcpy(aad, work->header, GCM_SEG_HEADER_LEN);
+  memcpy(aad + GCM_SEG_HEADER_LEN, index_bytes, 8);
+
+  int len = 0;
+
+  if (!EVP_CipherInit_ex(ctx, NULL, NULL, NULL, iv, work->encrypt))
+  {
+    return 1;
+  }
+  if (!EVP_CipherUpdate(ctx, NULL, &len, aad, sizeof(aad)))
+  {
+    return 1;
+  }
+
+  if (work->encrypt)
+  {
+    if (!EVP_EncryptUpdate(ctx, ct, &len, pt, (int) seg_len)
+        || (size_t) len != seg_len)
+    {
+      return 1;
+    }
+    if (!EVP_EncryptFinal_ex(ctx, tag, &len))
+    {
+      return 1;
+    }
+    if (!EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_GET_TAG, GCM_TAG_LEN, tag))
+    {
+      return 1;
+    }
+    return 0;
+  }
+
+  if (!EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_TAG, GCM_TAG_LEN, tag))
+  {
+    return 1;
+  }
+  if (!EVP_DecryptUpdate(ctx, pt, &len, ct, (int) seg_len)
+      || (size_t) len != seg_len)
+  {
+    return 1;
+  }
+  if (EVP_DecryptFinal_ex(ctx, pt + len, &len) <= 0)
+  {
+    return 1;
+  }
+  return 0;
+}
+
+//############################################################################
+// process_segments()
+//############################################################################
+static void *process_segments(void *arg)
+{
+  gcm_seg_work_t *work = (gcm_seg_work_t *) arg;
+  EVP_CIPHER_CTX *ctx = init_gcm_ctx(work->key, work->key_len, work->encrypt);
+
+  work->status = 1;
+  if (ctx == NULL)
+  {
+    return NULL;
+  }
+
+  size_t i = work->first_segment;
+
+  while (i < work->last_segment && process_segment(ctx, work, i) == 0)
+  {
+    i++;
+  }
+  if (i == work->last_segment)
+  {
+    work->status = 0;
+  }
+
+  EVP_CIPHER_CTX_free(ctx);
+  return NULL;
+}
+
+//############################################################################
+// run_segments()
+//############################################################################
+static int run_segments(gcm_seg_work_t * template, size_t segment_count)
+{
+  size_t thread_count = get_thread_count(segment_count);
+  gcm_seg_work_t work[GCM_SEG_MAX_THREADS];
+  pthread_t threads[GCM_SEG_MAX_THREADS];
+  bool started[GCM_SEG_MAX_THREADS] = { false };
+
+  // split the segments into contiguous, near-equal ranges
+  for (size_t t = 0; t < thread_count; t++)
+  {
+    work[t] = *template;
+    work[t].first_segment = (segment_count * t) / thread_count;
+    work[t].last_segment = (segment_count * (t + 1)) / thread_count;
+    work[t].status = 1;
+  }
+
+  // the calling thread processes the first range itself
+  for (size_t t = 1; t < thread_count; t++)
+  {
+    if (pthread_create(&threads[t], NULL, process_segments, &work[t]) == 0)
+    {
+      started[t] = true;
+    }
+  }
+  process_segments(&work[0]);
+
+  int retval = work[0].status;
+
+  for (size_t t = 1; t < thread_count; t++)
+  {
+    if (started[t])
+    {
+      pthread_join(threads[t], NULL);
+    }
+    else
+    {
+      // thread creation failed, so process this range here instead
+      process_segments(&work[t]);
+    }
+    retval |= work[t].status;
+  }
+
+  return retval;
+}
+
+//############################################################################
+// aes_gcm_seg_encrypt()
+//############################################################################
+int aes_gcm_seg_encrypt(unsigned char *key,
+                        size_t key_len,
+                        unsigned char *inData, size_t inData_len,
+                        unsigned char **outData, size_t * outData_len)
+{
+  // validate non-NULL and non-empty encryption key specified
+  if (key == NULL || key_len == 0)
+  {
+    return 1;
+  }
+
+  // validate non-NULL input plaintext buffer specified
+  if (inData == NULL)
+  {
+    return 1;
+  }
+
+  size_t segment_count = get_segment_count(inData_len, GCM_SEG_SIZE);
+
+  if (inData_len > SIZE_MAX - GCM_SEG_HEADER_LEN - segment_count * GCM_TAG_LEN)
+  {
+    return 1;
+  }
+
+  // output data buffer (outData) will contain the concatenation of:
+  //   - GCM_SEG_HEADER_LEN byte header (base IV, segment size, PT length)
+  //   - each ciphertext segment followed by its GCM_TAG_LEN (16) byte tag
+  *outData_len = GCM_SEG_HEADER_LEN + inData_len + segment_count * GCM_TAG_LEN;
+  *outData = NULL;
+  *outData = malloc(*outData_len);
+  if (*outData == NULL)
+  {
+    return 1;
+  }
+
+  unsigned char *header = *outData;
+
+  // create the base IV
+  if (RAND_bytes(header, GCM_IV_LEN) != 1)
+  {
+    free(*outData);
+    *outData = NULL;
+    return 1;
+  }
+  store_be(header + GCM_IV_LEN, GCM_SEG_SIZE, 4);
+  store_be(header + GCM_IV_LEN + 4, (uint64_t) inData_len, 8);
+
+  gcm_seg_work_t work = {
+    .key = key,
+    .key_len = key_len,
+    .encrypt = true,
+    .header = header,
+    .pt = inData,
+    .ct = header + GCM_SEG_HEADER_LEN,
+    .pt_len = inData_len,
+    .segment_size = GCM_SEG_SIZE,
+  };
+
+  if (run_segments(&work, segment_count))
+  {
+    free(*outData);
+    *outData = NULL;
+    return 1;
+  }
+
+  return 0;
+}
+
+//############################################################################
+// aes_gcm_seg_decrypt()
+//############################################################################
+int aes_gcm_seg_decrypt(unsigned char *key,
+                        size_t key_len,
+                        unsigned char *inData, size_t inData_len,
+                        unsigned char **outData, size_t * outData_len)
+{
+  // validate non-NULL and non-empty decryption key specified
+  if (key == NULL || key_len == 0)
+  {
+    return 1;
+  }
+
+  // validate non-NULL input ciphertext buffer holding at least one segment
+  if (inData == NULL || inData_len < GCM_SEG_HEADER_LEN + GCM_TAG_LEN)
+  {
+    return 1;
+  }
+
+  unsigned char *header = inData;
+  size_t segment_size = (size_t) load_be(header + GCM_IV_LEN, 4);
+  uint64_t pt_len = load_be(header + GCM_IV_LEN + 4, 8);
+
+  // segments must be small enough for the OpenSSL int length arguments
+  if (segment_size == 0 || segment_size > INT32_MAX)
+  {
+    return 1;
+  }
+  if (pt_len > inData_len - GCM_SEG_HEADER_LEN)
+  {
+    return 1;
+  }
+
+  // the header fixes the segment count, so the input must match it exactly
+  size_t segment_count = get_segment_count((size_t) pt_len, segment_size);
+
+  if (segment_count > (inData_len / GCM_TAG_LEN)
+      || inData_len - GCM_SEG_HEADER_LEN - pt_len !=
+      segment_count * GCM_TAG_LEN)
+  {
+    return 1;
+  }
+
+  *outData_len = (size_t) pt_len;
+  *outData = NULL;
+
+  // allocate at least one byte so an empty payload still yields a buffer
+  *outData = kmyth_secure_alloc((*outData_len > 0) ? *outData_len : 1);
+  if (*outData == NULL)
+  {
+    return 1;
+  }
+
+  gcm_seg_work_t work = {
+    .key = key,
+    .key_len = key_len,
+    .encrypt = false,
+    .header = header,
+    .pt = *outData,
+    .ct = inData + GCM_SEG_HEADER_LEN,
+    .pt_len = *outData_len,
+    .segment_size = segment_size,
+  };
+
+  if (run_segments(&work, segment_count))
+  {
+    kmyth_clear_and_free(*outData, *outData_len);
+    *outData = NULL;
+    *outData_len = 0;
+    return 1;
+  }
+
+  return 0;
+}
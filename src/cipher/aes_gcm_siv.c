@@ -0,0 +1,197 @@
+/**
+ * @file  aes_gcm_siv.c
+ *
+ * @brief Implements AES-GCM-SIV for kmyth.
+ */
+
+#include "cipher/aes_gcm_siv.h"
+
+#include <limits.h>
+
+#include <openssl/evp.h>
+#include <openssl/rand.h>
+
+#include "memory_util.h"
+
+#ifdef KMYTH_AES_GCM_SIV_SUPPORTED
+
+//############################################################################
+// fetch_gcm_siv()
+//############################################################################
+static EVP_CIPHER *fetch_gcm_siv(size_t key_len)
+{
+  switch (key_len)
+  {
+  case 16:
+    return EVP_CIPHER_fetch(NULL, "AES-128-GCM-SIV", NULL);
+  case 24:
+    return EVP_CIPHER_fetch(NULL, "AES-192-GCM-SIV", NULL);
+  case 32:
+    return EVP_CIPHER_fetch(NULL, "AES-256-GCM-SIV", NULL);
+  default:
+    return NULL;
+  }
+}
+
+#endif
+
+//############################################################################
+// aes_gcm_siv_encrypt()
+//############################################################################
+int aes_gcm_siv_encrypt(unsigned char *key,
+                        size_t key_len,
+                        unsigned char *inData, size_t inData_len,
+                        unsigned char **outData, size_t * outData_len)
+{
+#ifndef KMYTH_AES_GCM_SIV_SUPPORTED
+  return 1;
+#else
+  // validate non-NULL and non-empty encryption key specified
+  if (key == NULL || key_len == 0)
+  {
+    return 1;
+  }
+
+  // validate non-NULL input plaintext buffer (OpenSSL lengths are int)
+  if (inData == NULL || inData_len > INT_MAX)
+  {
+    return 1;
+  }
+
+  EVP_CIPHER *evp_cipher = fetch_gcm_siv(key_len);
+
+  if (evp_cipher == NULL)
+  {
+    return 1;
+  }
+
+  // output data buffer (outData) will contain the concatenation of:
+  //   - GCM_SIV_NONCE_LEN (12) byte nonce
+  //   - resultant ciphertext (same length as the input plaintext)
+  //   - GCM_SIV_TAG_LEN (16) byte tag
+  *outData_len = GCM_SIV_NONCE_LEN + inData_len + GCM_SIV_TAG_LEN;
+  *outData = NULL;
+  *outData = malloc(*outData_len);
+  if (*outData == NULL)
+  {
+    EVP_CIPHER_free(evp_cipher);
+    return 1;
+  }
+  unsigned char *nonce = *outData;
+  unsigned char *ciphertext = nonce + GCM_SIV_NONCE_LEN;
+  unsigned char *tag = ciphertext + inData_len;
+
+  // variable to hold length of resulting CT - OpenSSL insists this be an int
+  int ciphertext_len = 0;
+
+  EVP_CIPHER_CTX *ctx = EVP_CIPHER_CTX_new();
+
+  // GCM-SIV is two-pass, so the whole plaintext must be passed in one update
+  if (ctx == NULL
+      || RAND_bytes(nonce, GCM_SIV_NONCE_LEN) != 1
+      || !EVP_EncryptInit_ex(ctx, evp_cipher, NULL, key, nonce)
+      || !EVP_EncryptUpdate(ctx, ciphertext, &ciphertext_len, inData,
+                            (int) inData_len)
+      || ciphertext_len != (int) inData_len
+      || !EVP_EncryptFinal_ex(ctx, tag, &ciphertext_len)
+      || !EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_AEAD_GET_TAG, GCM_SIV_TAG_LEN,
+                              tag))
+  {
+    free(*outData);
+    *outData = NULL;
+    EVP_CIPHER_CTX_free(ctx);
+    EVP_CIPHER_free(evp_cipher);
+    return 1;
+  }
+
+  EVP_CIPHER_CTX_free(ctx);
+  EVP_CIPHER_free(evp_cipher);
+
+  return 0;
+#endif
+}
+
+//############################################################################
+// aes_gcm_siv_decrypt()
+//############################################################################
+int aes_gcm_siv_decrypt(unsigned char *key,
+                        size_t key_len,
+                        unsigned char *inData, size_t inData_len,
+                        unsigned char **outData, size_t * outData_len)
+{
+#ifndef KMYTH_AES_GCM_SIV_SUPPORTED
+  return 1;
+#else
+  // validate non-NULL and non-empty decryption key specified
+  if (key == NULL || key_len == 0)
+  {
+    return 1;
+  }
+
+  // validate input holds at least a nonce and tag (OpenSSL lengths are int)
+  if (inData == NULL || inData_len > INT_MAX
+      || inData_len < GCM_SIV_NONCE_LEN + GCM_SIV_TAG_LEN)
+  {
+    return 1;
+  }
+
+  EVP_CIPHER *evp_cipher = fetch_gcm_siv(key_len);
+
+  if (evp_cipher == NULL)
+  {
+    return 1;
+  }
+
+  // output data buffer (outData) will contain only the plaintext
+  *outData_len = inData_len - (GCM_SIV_NONCE_LEN + GCM_SIV_TAG_LEN);
+  *outData = NULL;
+  *outData = kmyth_secure_alloc((*outData_len > 0) ? *outData_len : 1);
+  if (*outData == NULL)
+  {
+    EVP_CIPHER_free(evp_cipher);
+    return 1;
+  }
+
+  unsigned char *nonce = inData;
+  unsigned char *ciphertext = inData + GCM_SIV_NONCE_LEN;
+  unsigned char *tag = ciphertext + *outData_len;
+
+  // variables to hold/accumulate length returned by EVP library calls
+  int len = 0;
+  int plaintext_len = 0;
+
+  EVP_CIPHER_CTX *ctx = EVP_CIPHER_CTX_new();
+
+  // the expected tag must be set before the (single) decrypt update
+  if (ctx == NULL
+      || !EVP_DecryptInit_ex(ctx, evp_cipher, NULL, key, nonce)
+      || !EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_AEAD_SET_TAG, GCM_SIV_TAG_LEN,
+                              tag)
+      || !EVP_DecryptUpdate(ctx, *outData, &len, ciphertext,
+                            (int) *outData_len))
+  {
+    kmyth_clear_and_free(*outData, *outData_len);
+    *outData = NULL;
+    EVP_CIPHER_CTX_free(ctx);
+    EVP_CIPHER_free(evp_cipher);
+    return 1;
+  }
+  plaintext_len += len;
+
+  // 'Finalize' Decrypt: validate the tag and the resultant plaintext length
+  if (EVP_DecryptFinal_ex(ctx, *outData + plaintext_len, &len) <= 0
+      || (size_t) (plaintext_len + len) != *outData_len)
+  {
+    kmyth_clear_and_free(*outData, *outData_len);
+    *outData = NULL;
+    EVP_CIPHER_CTX_free(ctx);
+    EVP_CIPHER_free(evp_cipher);
+    return 1;
+  }
+
+  EVP_CIPHER_CTX_free(ctx);
+  EVP_CIPHER_free(evp_cipher);
+
+  return 0;
+#endif
+}
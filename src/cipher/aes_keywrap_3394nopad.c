@@ -9,6 +9,7 @@
 #include <openssl/evp.h>
 
 #include "defines.h"
+#include "memory_util.h"
 
 //############################################################################
 // aes_keywrap_3394nopad_encrypt()
@@ -168,7 +169,7 @@ int aes_keywrap_3394nopad_decrypt(unsigned char *key,
   // should be the same size as the input ciphertext data (original plaintext
   // plus prepended 8-byte integrity check value)
   *outData = NULL;
-  *outData = malloc(inData_len);
+  *outData = kmyth_secure_alloc(inData_len);
   if (*outData == NULL)
   {
     return 1;
@@ -181,7 +182,7 @@ int aes_keywrap_3394nopad_decrypt(unsigned char *key,
 
   if (!(ctx = EVP_CIPHER_CTX_new()))
   {
-    free(*outData);
+    kmyth_clear_and_free(*outData, inData_len);
     return 1;
   }
   EVP_CIPHER_CTX_set_flags(ctx, EVP_CIPHER_CTX_FLAG_WRAP_ALLOW);
@@ -203,7 +204,7 @@ int aes_keywrap_3394nopad_decrypt(unsigned char *key,
   }
   if (!init_result)
   {
-    free(*outData);
+    kmyth_clear_and_free(*outData, inData_len);
     EVP_CIPHER_CTX_free(ctx);
     return 1;
   }
@@ -211,7 +212,7 @@ int aes_keywrap_3394nopad_decrypt(unsigned char *key,
   // set the decryption key in the cipher context
   if (!EVP_DecryptInit_ex(ctx, NULL, NULL, key, NULL))
   {
-    free(*outData);
+    kmyth_clear_and_free(*outData, inData_len);
     EVP_CIPHER_CTX_free(ctx);
     return 1;
   }
@@ -225,7 +226,7 @@ int aes_keywrap_3394nopad_decrypt(unsigned char *key,
   // check value validated and removed) in the output plaintext buffer
   if (!EVP_DecryptUpdate(ctx, *outData, &tmp_len, inData, inData_len))
   {
-    free(*outData);
+    kmyth_clear_and_free(*outData, inData_len);
     EVP_CIPHER_CTX_free(ctx);
     return 1;
   }
@@ -234,7 +235,7 @@ int aes_keywrap_3394nopad_decrypt(unsigned char *key,
   // "finalize" decryption
   if (!EVP_DecryptFinal_ex(ctx, *outData + *outData_len, &tmp_len))
   {
-    free(*outData);
+    kmyth_clear_and_free(*outData, inData_len);
     EVP_CIPHER_CTX_free(ctx);
     return 1;
   }
@@ -244,7 +245,7 @@ int aes_keywrap_3394nopad_decrypt(unsigned char *key,
   // the length of the 8-byte integrity check value
   if (*outData_len != inData_len - 8)
   {
-    free(*outData);
+    kmyth_clear_and_free(*outData, inData_len);
     EVP_CIPHER_CTX_free(ctx);
     return 1;
   }
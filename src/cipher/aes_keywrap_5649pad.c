@@ -9,6 +9,7 @@
 #include <openssl/evp.h>
 
 #include "defines.h"
+#include "memory_util.h"
 
 //##########################################################################
 // aes_keywrap_5649pad_encrypt()
@@ -176,7 +177,7 @@ int aes_keywrap_5649pad_decrypt(unsigned char *key,
   // plus prepended 4-byte integrity check value and 4-byte semiblock count
   // plus any appended padding bytes)
   *outData = NULL;
-  *outData = malloc(inData_len);
+  *outData = kmyth_secure_alloc(inData_len);
   if (*outData == NULL)
   {
     return 1;
@@ -188,7 +189,7 @@ int aes_keywrap_5649pad_decrypt(unsigned char *key,
 
   if (!(ctx = EVP_CIPHER_CTX_new()))
   {
-    free(*outData);
+    kmyth_clear_and_free(*outData, inData_len);
     return 1;
   }
   EVP_CIPHER_CTX_set_flags(ctx, EVP_CIPHER_CTX_FLAG_WRAP_ALLOW);
@@ -215,14 +216,14 @@ int aes_keywrap_5649pad_decrypt(unsigned char *key,
 
   if (!init_result)
   {
-    free(*outData);
+    kmyth_clear_and_free(*outData, inData_len);
     EVP_CIPHER_CTX_free(ctx);
     return 1;
   }
 
   if (!EVP_DecryptInit_ex(ctx, NULL, NULL, key, NULL))
   {
-    free(*outData);
+    kmyth_clear_and_free(*outData, inData_len);
     EVP_CIPHER_CTX_free(ctx);
     return 1;
   }
@@ -231,7 +232,7 @@ int aes_keywrap_5649pad_decrypt(unsigned char *key,
 
   if (!EVP_DecryptUpdate(ctx, *outData, &tmp_len, inData, inData_len))
   {
-    free(*outData);
+    kmyth_clear_and_free(*outData, inData_len);
     EVP_CIPHER_CTX_free(ctx);
     return 1;
   }
@@ -239,7 +240,7 @@ int aes_keywrap_5649pad_decrypt(unsigned char *key,
   *outData_len = tmp_len;
   if (!EVP_DecryptFinal_ex(ctx, *outData + *outData_len, &tmp_len))
   {
-    free(*outData);
+    kmyth_clear_and_free(*outData, inData_len);
     EVP_CIPHER_CTX_free(ctx);
     return 1;
   }
@@ -0,0 +1,167 @@
+/**
+ * @file  chacha20_poly1305.c
+ *
+ * @brief Implements ChaCha20-Poly1305 for kmyth.
+ */
+
+#include "cipher/chacha20_poly1305.h"
+
+#include <limits.h>
+
+#include <openssl/evp.h>
+#include <openssl/rand.h>
+
+#include "memory_util.h"
+
+//############################################################################
+// chacha20_poly1305_encrypt()
+//############################################################################
+int chacha20_poly1305_encrypt(unsigned char *key,
+                              size_t key_len,
+                              unsigned char *inData, size_t inData_len,
+                              unsigned char **outData, size_t * outData_len)
+{
+  // validate encryption key is the 256-bit size ChaCha20 requires
+  if (key == NULL || key_len != 32)
+  {
+    return 1;
+  }
+
+  // validate non-NULL input plaintext buffer (OpenSSL lengths are int)
+  if (inData == NULL || inData_len > INT_MAX)
+  {
+    return 1;
+  }
+
+  // output data buffer (outData) will contain the concatenation of:
+  //   - CHACHA20_POLY1305_NONCE_LEN (12) byte nonce
+  //   - resultant ciphertext (same length as the input plaintext)
+  //   - CHACHA20_POLY1305_TAG_LEN (16) byte tag
+  *outData_len = CHACHA20_POLY1305_NONCE_LEN + inData_len +
+    CHACHA20_POLY1305_TAG_LEN;
+  *outData = NULL;
+  *outData = malloc(*outData_len);
+  if (*outData == NULL)
+  {
+    return 1;
+  }
+  unsigned char *nonce = *outData;
+  unsigned char *ciphertext = nonce + CHACHA20_POLY1305_NONCE_LEN;
+  unsigned char *tag = ciphertext + inData_len;
+
+  // variable to hold length of resulting CT - OpenSSL insists this be an int
+  int ciphertext_len = 0;
+
+  EVP_CIPHER_CTX *ctx = EVP_CIPHER_CTX_new();
+
+  if (ctx == NULL)
+  {
+    free(*outData);
+    return 1;
+  }
+
+  // create the nonce, then configure the cipher context, encrypt, and
+  // append the Poly1305 tag to the output ciphertext
+  if (RAND_bytes(nonce, CHACHA20_POLY1305_NONCE_LEN) != 1
+      || !EVP_EncryptInit_ex(ctx, EVP_chacha20_poly1305(), NULL, NULL, NULL)
+      || !EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_AEAD_SET_IVLEN,
+                              CHACHA20_POLY1305_NONCE_LEN, NULL)
+      || !EVP_EncryptInit_ex(ctx, NULL, NULL, key, nonce)
+      || !EVP_EncryptUpdate(ctx, ciphertext, &ciphertext_len, inData,
+                            (int) inData_len)
+      || ciphertext_len != (int) inData_len
+      || !EVP_EncryptFinal_ex(ctx, tag, &ciphertext_len)
+      || !EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_AEAD_GET_TAG,
+                              CHACHA20_POLY1305_TAG_LEN, tag))
+  {
+    free(*outData);
+    *outData = NULL;
+    EVP_CIPHER_CTX_free(ctx);
+    return 1;
+  }
+
+  EVP_CIPHER_CTX_free(ctx);
+
+  return 0;
+}
+
+//############################################################################
+// chacha20_poly1305_decrypt()
+//############################################################################
+int chacha20_poly1305_decrypt(unsigned char *key,
+                              size_t key_len,
+                              unsigned char *inData, size_t inData_len,
+                              unsigned char **outData, size_t * outData_len)
+{
+  // validate decryption key is the 256-bit size ChaCha20 requires
+  if (key == NULL || key_len != 32)
+  {
+    return 1;
+  }
+
+  // validate input holds at least a nonce and tag (OpenSSL lengths are int)
+  if (inData == NULL || inData_len > INT_MAX
+      || inData_len < CHACHA20_POLY1305_NONCE_LEN + CHACHA20_POLY1305_TAG_LEN)
+  {
+    return 1;
+  }
+
+  // output data buffer (outData) will contain only the plaintext
+  *outData_len = inData_len - (CHACHA20_POLY1305_NONCE_LEN +
+                               CHACHA20_POLY1305_TAG_LEN);
+  *outData = NULL;
+  *outData = kmyth_secure_alloc((*outData_len > 0) ? *outData_len : 1);
+  if (*outData == NULL)
+  {
+    return 1;
+  }
+
+  unsigned char *nonce = inData;
+  unsigned char *ciphertext = inData + CHACHA20_POLY1305_NONCE_LEN;
+  unsigned char *tag = ciphertext + *outData_len;
+
+  // variables to hold/accumulate length returned by EVP library calls
+  int len = 0;
+  int plaintext_len = 0;
+
+  EVP_CIPHER_CTX *ctx = EVP_CIPHER_CTX_new();
+
+  if (ctx == NULL)
+  {
+    kmyth_clear_and_free(*outData, *outData_len);
+    *outData = NULL;
+    return 1;
+  }
+
+  // configure the cipher context with the expected tag, then decrypt
+  if (!EVP_DecryptInit_ex(ctx, EVP_chacha20_poly1305(), NULL, NULL, NULL)
+      || !EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_AEAD_SET_IVLEN,
+                              CHACHA20_POLY1305_NONCE_LEN, NULL)
+      || !EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_AEAD_SET_TAG,
+                              CHACHA20_POLY1305_TAG_LEN, tag)
+      || !EVP_DecryptInit_ex(ctx, NULL, NULL, key, nonce)
+      || !EVP_DecryptUpdate(ctx, *outData, &len, ciphertext,
+                            (int) *outData_len))
+  {
+    kmyth_clear_and_free(*outData, *outData_len);
+    *outData = NULL;
+    EVP_CIPHER_CTX_free(ctx);
+    return 1;
+  }
+  plaintext_len += len;
+
+  // 'Finalize' Decrypt: validate that the computed tag matches the expected
+  // tag passed in, and that the plaintext length matches the ciphertext
+  if (EVP_DecryptFinal_ex(ctx, *outData + plaintext_len, &len) <= 0
+      || (size_t) (plaintext_len + len) != *outData_len)
+  {
+    kmyth_clear_and_free(*outData, *outData_len);
+    *outData = NULL;
+    EVP_CIPHER_CTX_free(ctx);
+    return 1;
+  }
+
+  EVP_CIPHER_CTX_free(ctx);
+
+  return 0;
+}
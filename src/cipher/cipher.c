@@ -12,8 +12,11 @@
 
 #include "defines.h"
 #include "cipher/aes_gcm.h"
+#include "cipher/aes_gcm_seg.h"
+#include "cipher/aes_gcm_siv.h"
 #include "cipher/aes_keywrap_3394nopad.h"
 #include "cipher/aes_keywrap_5649pad.h"
+#include "cipher/chacha20_poly1305.h"
 
 // Check for supported OpenSSL version
 //   - OpenSSL v1.1.x required for AES KeyWrap RFC5649 w/ padding
@@ -41,6 +44,24 @@ const cipher_t cipher_list[] = {
    .encrypt_fn = aes_gcm_encrypt,
    .decrypt_fn = aes_gcm_decrypt},
 
+  {.cipher_name = "AES/GCM-SEG/NoPadding/256",
+   .encrypt_fn = aes_gcm_seg_encrypt,
+   .decrypt_fn = aes_gcm_seg_decrypt},
+
+  {.cipher_name = "ChaCha20/Poly1305/NoPadding/256",
+   .encrypt_fn = chacha20_poly1305_encrypt,
+   .decrypt_fn = chacha20_poly1305_decrypt},
+
+#ifdef KMYTH_AES_GCM_SIV_SUPPORTED
+  {.cipher_name = "AES/GCM-SIV/NoPadding/256",
+   .encrypt_fn = aes_gcm_siv_encrypt,
+   .decrypt_fn = aes_gcm_siv_decrypt},
+
+  {.cipher_name = "AES/GCM-SIV/NoPadding/128",
+   .encrypt_fn = aes_gcm_siv_encrypt,
+   .decrypt_fn = aes_gcm_siv_decrypt},
+#endif
+
   {.cipher_name = "AES/KeyWrap/RFC3394NoPadding/256",
    .encrypt_fn = aes_keywrap_3394nopad_encrypt,
    .decrypt_fn = aes_keywrap_3394nopad_decrypt},
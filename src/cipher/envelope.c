@@ -0,0 +1,292 @@
+/**
+ * @file  envelope.c
+ *
+ * @brief Implements the host-side (HKDF derived data key) portion of Kmyth's
+ *        envelope (KEK) mode.
+ */
+
+#include "cipher/envelope.h"
+
+#include <string.h>
+
+#include <openssl/evp.h>
+#include <openssl/kdf.h>
+#include <openssl/rand.h>
+
+#include "defines.h"
+#include "formatting_tools.h"
+#include "memory_util.h"
+
+//############################################################################
+// derive_envelope_key()
+//############################################################################
+int derive_envelope_key(unsigned char *kek,
+                        size_t kek_len,
+                        unsigned char *salt,
+                        size_t salt_len,
+                        cipher_t cipher_spec,
+                        unsigned char **key, size_t * key_len)
+{
+  if (kek == NULL || kek_len == 0)
+  {
+    kmyth_log(LOG_ERR, "no KEK specified ... exiting");
+    return 1;
+  }
+  if (salt == NULL || salt_len == 0)
+  {
+    kmyth_log(LOG_ERR, "no salt specified ... exiting");
+    return 1;
+  }
+  if (cipher_spec.cipher_name == NULL)
+  {
+    kmyth_log(LOG_ERR, "no cipher specified ... exiting");
+    return 1;
+  }
+
+  size_t out_len = get_key_len_from_cipher(cipher_spec) / 8;
+
+  if (out_len == 0)
+  {
+    kmyth_log(LOG_ERR, "invalid key length for cipher %s ... exiting",
+              cipher_spec.cipher_name);
+    return 1;
+  }
+
+  // info = KMYTH_ENVELOPE_HKDF_INFO || cipher name
+  size_t prefix_len = strlen(KMYTH_ENVELOPE_HKDF_INFO);
+  size_t name_len = strlen(cipher_spec.cipher_name);
+  size_t info_len = prefix_len + name_len;
+  unsigned char *info = malloc(info_len);
+
+  if (info == NULL)
+  {
+    kmyth_log(LOG_ERR, "unable to allocate HKDF info ... exiting");
+    return 1;
+  }
+  memcpy(info, KMYTH_ENVELOPE_HKDF_INFO, prefix_len);
+  memcpy(info + prefix_len, cipher_spec.cipher_name, name_len);
+
+  unsigned char *out = kmyth_secure_alloc(out_len);
+
+  if (out == NULL)
+  {
+    kmyth_log(LOG_ERR, "unable to allocate derived key ... exiting");
+    free(info);
+    return 1;
+  }
+
+  EVP_PKEY_CTX *ctx = EVP_PKEY_CTX_new_id(EVP_PKEY_HKDF, NULL);
+
+  if (ctx == NULL
+      || EVP_PKEY_derive_init(ctx) <= 0
+      || EVP_PKEY_CTX_set_hkdf_md(ctx, KMYTH_OPENSSL_HASH) <= 0
+      || EVP_PKEY_CTX_set1_hkdf_salt(ctx, salt, salt_len) <= 0
+      || EVP_PKEY_CTX_set1_hkdf_key(ctx, kek, kek_len) <= 0
+      || EVP_PKEY_CTX_add1_hkdf_info(ctx, info, info_len) <= 0
+      || EVP_PKEY_derive(ctx, out, &out_len) <= 0)
+  {
+    kmyth_log(LOG_ERR, "HKDF data key derivation failed ... exiting");
+    EVP_PKEY_CTX_free(ctx);
+    kmyth_clear_and_free(out, out_len);
+    free(info);
+    return 1;
+  }
+
+  EVP_PKEY_CTX_free(ctx);
+  free(info);
+
+  *key = out;
+  *key_len = out_len;
+
+  return 0;
+}
+
+//############################################################################
+// kmyth_envelope_encrypt()
+//############################################################################
+int kmyth_envelope_encrypt(unsigned char *kek,
+                           size_t kek_len,
+                           uint8_t * data,
+                           size_t data_len,
+                           cipher_t cipher_spec,
+                           uint8_t ** output, size_t * output_len)
+{
+  if (data == NULL || data_len == 0)
+  {
+    kmyth_log(LOG_ERR, "no input data ... exiting");
+    return 1;
+  }
+  if (cipher_spec.cipher_name == NULL)
+  {
+    kmyth_log(LOG_ERR, "no cipher specified ... exiting");
+    return 1;
+  }
+
+  // create a random per-file salt and derive this file's data key from it
+  unsigned char salt[KMYTH_ENVELOPE_SALT_LEN];
+
+  if (!RAND_bytes(salt, KMYTH_ENVELOPE_SALT_LEN))
+  {
+    kmyth_log(LOG_ERR, "unable to create envelope salt ... exiting");
+    return 1;
+  }
+
+  unsigned char *key = NULL;
+  size_t key_len = 0;
+
+  if (derive_envelope_key(kek, kek_len, salt, KMYTH_ENVELOPE_SALT_LEN,
+                          cipher_spec, &key, &key_len))
+  {
+    kmyth_log(LOG_ERR, "unable to derive envelope data key ... exiting");
+    return 1;
+  }
+
+  unsigned char *enc_data = NULL;
+  size_t enc_data_len = 0;
+
+  if (cipher_spec.encrypt_fn(key, key_len, data, data_len,
+                             &enc_data, &enc_data_len))
+  {
+    kmyth_log(LOG_ERR, "unable to encrypt envelope data ... exiting");
+    kmyth_clear_and_free(key, key_len);
+    return 1;
+  }
+  kmyth_clear_and_free(key, key_len);
+
+  block_spec_t blocks[] = {
+    {KMYTH_DELIM_ENVELOPE_SALT, salt, KMYTH_ENVELOPE_SALT_LEN, false},
+    {KMYTH_DELIM_CIPHER_SUITE, (uint8_t *) cipher_spec.cipher_name,
+     strlen(cipher_spec.cipher_name), true},
+    {KMYTH_DELIM_ENC_DATA, enc_data, enc_data_len, false},
+  };
+
+  if (create_block_bytes(blocks, sizeof(blocks) / sizeof(blocks[0]),
+                         KMYTH_DELIM_END_ENVELOPE, output, output_len))
+  {
+    kmyth_log(LOG_ERR, "unable to create envelope ... exiting");
+    free(enc_data);
+    return 1;
+  }
+  free(enc_data);
+
+  return 0;
+}
+
+//############################################################################
+// kmyth_envelope_decrypt()
+//############################################################################
+int kmyth_envelope_decrypt(unsigned char *kek,
+                           size_t kek_len,
+                           uint8_t * input,
+                           size_t input_len,
+                           uint8_t ** output, size_t * output_len)
+{
+  if (input == NULL || input_len == 0)
+  {
+    kmyth_log(LOG_ERR, "no input envelope ... exiting");
+    return 1;
+  }
+
+  uint8_t *position = input;
+  size_t remaining = input_len;
+
+  // locate each block (views into input - nothing is copied)
+  block_view_t salt64 = {.data = NULL,.size = 0 };
+  block_view_t cipher_str = {.data = NULL,.size = 0 };
+  block_view_t enc64_data = {.data = NULL,.size = 0 };
+
+  if (get_block_view(&position, &remaining, &salt64,
+                     KMYTH_DELIM_ENVELOPE_SALT,
+                     strlen(KMYTH_DELIM_ENVELOPE_SALT),
+                     KMYTH_DELIM_CIPHER_SUITE,
+                     strlen(KMYTH_DELIM_CIPHER_SUITE)))
+  {
+    kmyth_log(LOG_ERR, "get envelope salt error ... exiting");
+    return 1;
+  }
+
+  if (get_block_view(&position, &remaining, &cipher_str,
+                     KMYTH_DELIM_CIPHER_SUITE,
+                     strlen(KMYTH_DELIM_CIPHER_SUITE),
+                     KMYTH_DELIM_ENC_DATA, strlen(KMYTH_DELIM_ENC_DATA)))
+  {
+    kmyth_log(LOG_ERR, "get cipher string error ... exiting");
+    return 1;
+  }
+
+  if (get_block_view(&position, &remaining, &enc64_data,
+                     KMYTH_DELIM_ENC_DATA, strlen(KMYTH_DELIM_ENC_DATA),
+                     KMYTH_DELIM_END_ENVELOPE,
+                     strlen(KMYTH_DELIM_END_ENVELOPE)))
+  {
+    kmyth_log(LOG_ERR, "get encrypted data error ... exiting");
+    return 1;
+  }
+
+  if (remaining != strlen(KMYTH_DELIM_END_ENVELOPE)
+      || memcmp(position, KMYTH_DELIM_END_ENVELOPE, remaining))
+  {
+    kmyth_log(LOG_ERR, "unable to find the end of envelope ... exiting");
+    return 1;
+  }
+
+  // the cipher suite block ends with a newline, replaced by the terminator
+  char *cipher_name = strndup((char *) cipher_str.data, cipher_str.size - 1);
+
+  if (cipher_name == NULL)
+  {
+    kmyth_log(LOG_ERR, "unable to allocate cipher string ... exiting");
+    return 1;
+  }
+
+  cipher_t cipher_spec = kmyth_get_cipher_t_from_string(cipher_name);
+
+  free(cipher_name);
+  if (cipher_spec.cipher_name == NULL)
+  {
+    kmyth_log(LOG_ERR, "cipher_t init error ... exiting");
+    return 1;
+  }
+
+  uint8_t *salt = NULL;
+  size_t salt_len = 0;
+  uint8_t *enc_data = NULL;
+  size_t enc_data_len = 0;
+
+  if (decodeBase64Data(salt64.data, salt64.size, &salt, &salt_len)
+      || decodeBase64Data(enc64_data.data, enc64_data.size, &enc_data,
+                          &enc_data_len))
+  {
+    kmyth_log(LOG_ERR, "error base64 decoding envelope ... exiting");
+    free(salt);
+    free(enc_data);
+    return 1;
+  }
+
+  unsigned char *key = NULL;
+  size_t key_len = 0;
+
+  if (derive_envelope_key(kek, kek_len, salt, salt_len, cipher_spec,
+                          &key, &key_len))
+  {
+    kmyth_log(LOG_ERR, "unable to derive envelope data key ... exiting");
+    free(salt);
+    free(enc_data);
+    return 1;
+  }
+  free(salt);
+
+  if (kmyth_decrypt_data(enc_data, enc_data_len, cipher_spec, key, key_len,
+                         output, output_len))
+  {
+    kmyth_log(LOG_ERR, "unable to decrypt envelope data ... exiting");
+    kmyth_clear_and_free(key, key_len);
+    free(enc_data);
+    return 1;
+  }
+
+  kmyth_clear_and_free(key, key_len);
+  free(enc_data);
+
+  return 0;
+}
@@ -0,0 +1,690 @@
+/*
+ * Kmyth Agent - caches unsealed .ski contents for local processes
+ */
+
+#include <errno.h>
+#include <getopt.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <sys/mman.h>
+#include <sys/prctl.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+
+#include <openssl/evp.h>
+#include <openssl/sha.h>
+
+#include "agent_util.h"
+#include "defines.h"
+#include "formatting_tools.h"
+#include "kmyth.h"
+#include "kmyth_log.h"
+#include "memory_util.h"
+#include "socket_util.h"
+
+/// Default lifetime, in seconds, of a cached entry
+#define AGENT_DEFAULT_TTL 300
+
+/// Default maximum number of cached entries
+#define AGENT_DEFAULT_MAX_ENTRIES 64
+
+/// Seconds a connected peer may stay silent mid-message
+#define AGENT_RECV_TIMEOUT 30
+
+/// Maximum number of connections served at once; further clients wait in
+/// the listen backlog until a connection closes
+#define AGENT_MAX_CONNECTIONS 32
+
+/**
+ * @brief One cached, unsealed .ski
+ *
+ * The data buffer is mapped separately for each entry (whole pages) so it
+ * can be locked into memory, excluded from core dumps, and unlocked again
+ * without affecting any other allocation.
+ */
+typedef struct agent_entry
+{
+  uint8_t id[SHA256_DIGEST_LENGTH];
+  uint8_t *data;
+  size_t data_len;
+  size_t map_len;
+  time_t expires;
+  struct agent_entry *next;
+} agent_entry_t;
+
+static pthread_mutex_t cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+static agent_entry_t *cache_head = NULL;
+static size_t cache_count = 0;
+
+static size_t max_entries = AGENT_DEFAULT_MAX_ENTRIES;
+static uint32_t max_ttl = AGENT_DEFAULT_TTL;
+static uid_t allowed_uid;
+static uint8_t *owner_auth = NULL;
+static size_t owner_auth_len = 0;
+
+static pthread_mutex_t conn_mutex = PTHREAD_MUTEX_INITIALIZER;
+static size_t active_connections = 0;
+
+static volatile sig_atomic_t stop_requested = 0;
+
+static void usage(const char *prog)
+{
+  fprintf(stdout,
+          "\nusage: %s [options]\n\n"
+          "options are: \n\n"
+          " -a or --socket        Path of the agent's Unix domain socket. Defaults to a new, private\n"
+          "                       directory under /tmp.\n"
+          " -t or --ttl           Maximum (and default) lifetime of a cached entry, in seconds. Defaults to %d.\n"
+          " -m or --max_entries   Maximum number of cached entries. Defaults to %d.\n"
+          " -u or --allow_uid     Also serve this user ID (the agent's own user and root are always served).\n"
+          " -w or --owner_auth    TPM 2.0 storage (owner) hierarchy authorization. Defaults to emptyAuth to match TPM default.\n"
+          " -d or --foreground    Stay in the foreground (do not fork into the background).\n"
+          " -v or --verbose       Enable detailed logging.\n"
+          " -h or --help          Help (displays this usage).\n\n"
+          "The agent prints the %s setting for its socket; kmyth-unseal --agent and\n"
+          "kmyth_agent_unseal() use it to find the agent.\n", prog,
+          AGENT_DEFAULT_TTL, AGENT_DEFAULT_MAX_ENTRIES, KMYTH_AGENT_SOCK_ENV);
+}
+
+const struct option longopts[] = {
+  {"socket", required_argument, 0, 'a'},
+  {"ttl", required_argument, 0, 't'},
+  {"max_entries", required_argument, 0, 'm'},
+  {"allow_uid", required_argument, 0, 'u'},
+  {"owner_auth", required_argument, 0, 'w'},
+  {"foreground", no_argument, 0, 'd'},
+  {"verbose", no_argument, 0, 'v'},
+  {"help", no_argument, 0, 'h'},
+  {0, 0, 0, 0}
+};
+
+//############################################################################
+// now_seconds()
+//############################################################################
+static time_t now_seconds(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec;
+}
+
+//############################################################################
+// compute_entry_id()
+//############################################################################
+static int compute_entry_id(uint8_t * ski, size_t ski_len,
+                            uint8_t * auth, size_t auth_len, uint8_t * id)
+{
+  // the authorization string is part of the ID, so the cached contents of a
+  // .ski are only served to requests presenting the same authorization
+  uint8_t len_bytes[4] = {
+    (uint8_t) (auth_len >> 24), (uint8_t) (auth_len >> 16),
+    (uint8_t) (auth_len >> 8), (uint8_t) auth_len
+  };
+  EVP_MD_CTX *ctx = EVP_MD_CTX_new();
+  int ok = (ctx != NULL)
+    && EVP_DigestInit_ex(ctx, EVP_sha256(), NULL)
+    && EVP_DigestUpdate(ctx, len_bytes, sizeof(len_bytes))
+    && (auth_len == 0 || EVP_DigestUpdate(ctx, auth, auth_len))
+    && EVP_DigestUpdate(ctx, ski, ski_len)
+    && EVP_DigestFinal_ex(ctx, id, NULL);
+
+  EVP_MD_CTX_free(ctx);
+  return ok ? 0 : 1;
+}
+
+//############################################################################
+// free_entry()
+//############################################################################
+static void free_entry(agent_entry_t * entry)
+{
+  kmyth_clear(entry->data, entry->map_len);
+  munlock(entry->data, entry->map_len);
+  munmap(entry->data, entry->map_len);
+  kmyth_clear(entry->id, sizeof(entry->id));
+  free(entry);
+}
+
+//############################################################################
+// new_entry()
+//############################################################################
+static agent_entry_t *new_entry(uint8_t * id, uint8_t * data,
+                                size_t data_len, uint32_t ttl)
+{
+  agent_entry_t *entry = calloc(1, sizeof(agent_entry_t));
+
+  if (entry == NULL)
+  {
+    return NULL;
+  }
+
+  size_t page = (size_t) sysconf(_SC_PAGESIZE);
+
+  entry->map_len = ((data_len + page) / page) * page;
+  entry->data = mmap(NULL, entry->map_len, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (entry->data == MAP_FAILED)
+  {
+    free(entry);
+    return NULL;
+  }
+  if (mlock(entry->data, entry->map_len))
+  {
+    // caching unlocked plaintext could leave it in swap
+    kmyth_log(LOG_ERR, "unable to lock cache entry in memory (%s)",
+              strerror(errno));
+    munmap(entry->data, entry->map_len);
+    free(entry);
+    return NULL;
+  }
+  madvise(entry->data, entry->map_len, MADV_DONTDUMP);
+
+  memcpy(entry->id, id, sizeof(entry->id));
+  memcpy(entry->data, data, data_len);
+  entry->data_len = data_len;
+  entry->expires = now_seconds() + ttl;
+
+  return entry;
+}
+
+//############################################################################
+// cache_lookup()
+//############################################################################
+static int cache_lookup(uint8_t * id, uint8_t ** data, size_t *data_len)
+{
+  int retval = 1;
+  time_t now = now_seconds();
+
+  pthread_mutex_lock(&cache_mutex);
+  for (agent_entry_t * entry = cache_head; entry != NULL; entry = entry->next)
+  {
+    if (entry->expires > now && memcmp(entry->id, id, sizeof(entry->id)) == 0)
+    {
+      *data = kmyth_secure_alloc(entry->data_len);
+      if (*data != NULL)
+      {
+        memcpy(*data, entry->data, entry->data_len);
+        *data_len = entry->data_len;
+        retval = 0;
+      }
+      break;
+    }
+  }
+  pthread_mutex_unlock(&cache_mutex);
+
+  return retval;
+}
+
+//############################################################################
+// cache_insert()
+//############################################################################
+static void cache_insert(agent_entry_t * entry)
+{
+  pthread_mutex_lock(&cache_mutex);
+
+  // replace an entry for the same .ski (e.g., one unsealed concurrently),
+  // otherwise make room by evicting the entry closest to expiring
+  agent_entry_t **victim = NULL;
+
+  for (agent_entry_t ** link = &cache_head; *link != NULL;
+       link = &(*link)->next)
+  {
+    if (memcmp((*link)->id, entry->id, sizeof(entry->id)) == 0)
+    {
+      victim = link;
+      break;
+    }
+    if (cache_count >= max_entries
+        && (victim == NULL || (*link)->expires < (*victim)->expires))
+    {
+      victim = link;
+    }
+  }
+  if (victim != NULL)
+  {
+    agent_entry_t *old = *victim;
+
+    *victim = old->next;
+    free_entry(old);
+    cache_count--;
+  }
+
+  entry->next = cache_head;
+  cache_head = entry;
+  cache_count++;
+
+  pthread_mutex_unlock(&cache_mutex);
+}
+
+//############################################################################
+// cache_sweep()
+//############################################################################
+static void cache_sweep(bool remove_all)
+{
+  time_t now = now_seconds();
+
+  pthread_mutex_lock(&cache_mutex);
+  agent_entry_t **link = &cache_head;
+
+  while (*link != NULL)
+  {
+    agent_entry_t *entry = *link;
+
+    if (remove_all || entry->expires <= now)
+    {
+      *link = entry->next;
+      free_entry(entry);
+      cache_count--;
+    }
+    else
+    {
+      link = &entry->next;
+    }
+  }
+  pthread_mutex_unlock(&cache_mutex);
+}
+
+//############################################################################
+// peer_allowed()
+//############################################################################
+static bool peer_allowed(int socket_fd)
+{
+  struct ucred cred;
+  socklen_t cred_len = sizeof(cred);
+
+  if (getsockopt(socket_fd, SOL_SOCKET, SO_PEERCRED, &cred, &cred_len))
+  {
+    kmyth_log(LOG_ERR, "unable to get peer credentials");
+    return false;
+  }
+  if (cred.uid == geteuid() || cred.uid == 0 || cred.uid == allowed_uid)
+  {
+    return true;
+  }
+  kmyth_log(LOG_WARNING, "refused peer (pid %d, uid %u)", (int) cred.pid,
+            (unsigned int) cred.uid);
+  return false;
+}
+
+//############################################################################
+// handle_unseal()
+//############################################################################
+static uint8_t handle_unseal(uint8_t * request, size_t request_len,
+                             uint8_t ** response, size_t *response_len)
+{
+  uint8_t *ski = NULL;
+  size_t ski_len = 0;
+  uint8_t *auth = NULL;
+  size_t auth_len = 0;
+  uint32_t ttl = 0;
+  uint8_t id[SHA256_DIGEST_LENGTH];
+
+  if (parse_agent_unseal_request(request, request_len, &ski, &ski_len,
+                                 &auth, &auth_len, &ttl)
+      || compute_entry_id(ski, ski_len, auth, auth_len, id))
+  {
+    return KMYTH_AGENT_STATUS_BAD_REQUEST;
+  }
+
+  if (cache_lookup(id, response, response_len) == 0)
+  {
+    kmyth_log(LOG_DEBUG, "served cached entry");
+    return KMYTH_AGENT_STATUS_OK;
+  }
+
+  // not cached (or expired) - unseal with the TPM, outside the cache lock
+  if (tpm2_kmyth_unseal(ski, ski_len, response, response_len,
+                        auth, auth_len, owner_auth, owner_auth_len))
+  {
+    kmyth_log(LOG_ERR, "unable to unseal requested .ski");
+    return KMYTH_AGENT_STATUS_ERROR;
+  }
+
+  if (ttl == 0 || ttl > max_ttl)
+  {
+    ttl = max_ttl;
+  }
+
+  agent_entry_t *entry = new_entry(id, *response, *response_len, ttl);
+
+  if (entry == NULL)
+  {
+    // still answer the request, just without caching the result
+    kmyth_log(LOG_WARNING, "unable to cache unsealed entry");
+  }
+  else
+  {
+    cache_insert(entry);
+    kmyth_log(LOG_DEBUG, "cached unsealed entry (ttl = %u s)", ttl);
+  }
+
+  return KMYTH_AGENT_STATUS_OK;
+}
+
+//############################################################################
+// release_connection()
+//############################################################################
+static void release_connection(int socket_fd)
+{
+  close(socket_fd);
+  pthread_mutex_lock(&conn_mutex);
+  active_connections--;
+  pthread_mutex_unlock(&conn_mutex);
+}
+
+//############################################################################
+// serve_connection()
+//############################################################################
+static void *serve_connection(void *arg)
+{
+  int socket_fd = (int) (intptr_t) arg;
+
+  if (!peer_allowed(socket_fd))
+  {
+    send_agent_message(socket_fd, KMYTH_AGENT_STATUS_DENIED, NULL, 0);
+    release_connection(socket_fd);
+    return NULL;
+  }
+
+  struct timeval timeout = {.tv_sec = AGENT_RECV_TIMEOUT,.tv_usec = 0 };
+  setsockopt(socket_fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+  uint8_t op = 0;
+  uint8_t *request = NULL;
+  size_t request_len = 0;
+
+  while (recv_agent_message(socket_fd, &op, &request, &request_len) == 0)
+  {
+    uint8_t status = KMYTH_AGENT_STATUS_BAD_REQUEST;
+    uint8_t *response = NULL;
+    size_t response_len = 0;
+
+    switch (op)
+    {
+    case KMYTH_AGENT_OP_UNSEAL:
+      status = handle_unseal(request, request_len, &response, &response_len);
+      break;
+    case KMYTH_AGENT_OP_FLUSH:
+      cache_sweep(true);
+      kmyth_log(LOG_DEBUG, "flushed cache");
+      status = KMYTH_AGENT_STATUS_OK;
+      break;
+    default:
+      kmyth_log(LOG_ERR, "unsupported agent request (%u)", op);
+      break;
+    }
+
+    // requests and responses may carry auth strings or plaintext
+    kmyth_clear_and_free(request, request_len);
+    request = NULL;
+
+    int rc = send_agent_message(socket_fd, status, response, response_len);
+
+    kmyth_clear_and_free(response, response_len);
+    if (rc)
+    {
+      break;
+    }
+  }
+
+  release_connection(socket_fd);
+  return NULL;
+}
+
+//############################################################################
+// request_stop()
+//############################################################################
+static void request_stop(int signum)
+{
+  (void) signum;
+  stop_requested = 1;
+}
+
+//############################################################################
+// create_default_socket_path()
+//############################################################################
+static int create_default_socket_path(char *dir, size_t dir_size,
+                                      char *path, size_t path_size)
+{
+  snprintf(dir, dir_size, "/tmp/kmyth-XXXXXX");
+  if (mkdtemp(dir) == NULL)
+  {
+    kmyth_log(LOG_ERR, "unable to create socket directory ... exiting");
+    return 1;
+  }
+  snprintf(path, path_size, "%s/agent.%d", dir, (int) getpid());
+  return 0;
+}
+
+int main(int argc, char **argv)
+{
+  // Configure logging messages
+  set_app_name(KMYTH_APP_NAME);
+  set_app_version(KMYTH_VERSION);
+  set_applog_path(KMYTH_APPLOG_PATH);
+
+  char *socketPath = NULL;
+  char *ownerAuthPasswd = "";
+  bool foreground = false;
+  int options;
+  int option_index;
+  unsigned long value = 0;
+
+  allowed_uid = geteuid();
+
+  while ((options = getopt_long(argc, argv, "a:t:m:u:w:dvh", longopts,
+                                &option_index)) != -1)
+  {
+    switch (options)
+    {
+    case 'a':
+      socketPath = optarg;
+      break;
+    case 't':
+      if (parse_unsigned_string(optarg, 1, UINT32_MAX, &value))
+      {
+        kmyth_log(LOG_ERR, "invalid TTL (-t) ... exiting");
+        return 1;
+      }
+      max_ttl = (uint32_t) value;
+      break;
+    case 'm':
+      if (parse_unsigned_string(optarg, 1, SIZE_MAX, &value))
+      {
+        kmyth_log(LOG_ERR, "invalid maximum entries (-m) ... exiting");
+        return 1;
+      }
+      max_entries = (size_t) value;
+      break;
+    case 'u':
+      // (uid_t) -1 is reserved and never names a user
+      if (parse_unsigned_string(optarg, 0, UINT32_MAX - 1, &value))
+      {
+        kmyth_log(LOG_ERR, "invalid user ID (-u) ... exiting");
+        return 1;
+      }
+      allowed_uid = (uid_t) value;
+      break;
+    case 'w':
+      ownerAuthPasswd = optarg;
+      break;
+    case 'd':
+      foreground = true;
+      break;
+    case 'v':
+      // always display all log messages (severity threshold = LOG_DEBUG)
+      // to stdout or stderr (output mode = 0)
+      set_applog_severity_threshold(LOG_DEBUG);
+      set_applog_output_mode(0);
+      break;
+    case 'h':
+      usage(argv[0]);
+      return 0;
+    default:
+      return 1;
+    }
+  }
+
+  // keep the owner authorization for the lifetime of the agent, and clear
+  // the copy in the argument list
+  owner_auth_len = strlen(ownerAuthPasswd);
+  if (owner_auth_len > 0)
+  {
+    owner_auth = malloc(owner_auth_len);
+    if (owner_auth == NULL)
+    {
+      kmyth_log(LOG_ERR, "unable to allocate memory ... exiting");
+      return 1;
+    }
+    memcpy(owner_auth, ownerAuthPasswd, owner_auth_len);
+    kmyth_clear(ownerAuthPasswd, owner_auth_len);
+  }
+
+  // other processes of the same user must not be able to read the cache by
+  // attaching to the agent or from a core dump
+  prctl(PR_SET_DUMPABLE, 0);
+
+  char socketDir[64] = { 0 };
+  char defaultPath[128] = { 0 };
+
+  if (socketPath == NULL)
+  {
+    if (create_default_socket_path(socketDir, sizeof(socketDir),
+                                   defaultPath, sizeof(defaultPath)))
+    {
+      kmyth_clear_and_free(owner_auth, owner_auth_len);
+      return 1;
+    }
+    socketPath = defaultPath;
+  }
+
+  int listen_fd = -1;
+
+  if (setup_unix_server_socket(socketPath, &listen_fd))
+  {
+    kmyth_log(LOG_ERR, "unable to create agent socket ... exiting");
+    if (strlen(socketDir) > 0)
+    {
+      rmdir(socketDir);
+    }
+    kmyth_clear_and_free(owner_auth, owner_auth_len);
+    return 1;
+  }
+
+  pid_t agent_pid = getpid();
+
+  if (!foreground)
+  {
+    agent_pid = fork();
+    if (agent_pid < 0)
+    {
+      kmyth_log(LOG_ERR, "unable to fork agent process ... exiting");
+      close(listen_fd);
+      unlink(socketPath);
+      kmyth_clear_and_free(owner_auth, owner_auth_len);
+      return 1;
+    }
+    if (agent_pid > 0)
+    {
+      // parent: tell the caller how to reach the agent, then exit
+      fprintf(stdout, "%s=%s; export %s;\necho Agent pid %d;\n",
+              KMYTH_AGENT_SOCK_ENV, socketPath, KMYTH_AGENT_SOCK_ENV,
+              (int) agent_pid);
+      close(listen_fd);
+      kmyth_clear_and_free(owner_auth, owner_auth_len);
+      return 0;
+    }
+    setsid();
+    if (freopen("/dev/null", "r", stdin) == NULL
+        || freopen("/dev/null", "w", stdout) == NULL)
+    {
+      kmyth_log(LOG_WARNING, "unable to detach from the terminal");
+    }
+  }
+  else
+  {
+    fprintf(stdout, "%s=%s; export %s;\necho Agent pid %d;\n",
+            KMYTH_AGENT_SOCK_ENV, socketPath, KMYTH_AGENT_SOCK_ENV,
+            (int) agent_pid);
+    fflush(stdout);
+  }
+
+  struct sigaction sa;
+
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_handler = request_stop;
+  sigaction(SIGINT, &sa, NULL);
+  sigaction(SIGTERM, &sa, NULL);
+  sigaction(SIGHUP, &sa, NULL);
+  signal(SIGPIPE, SIG_IGN);
+
+  kmyth_log(LOG_INFO, "kmyth-agent listening on %s", socketPath);
+
+  // accept connections, sweeping expired entries at least once a second;
+  // while every connection slot is busy, stop watching the listening socket
+  // and check back for a free slot every 100 ms
+  struct pollfd pfd = {.fd = listen_fd,.events = POLLIN };
+
+  while (!stop_requested)
+  {
+    pthread_mutex_lock(&conn_mutex);
+    bool full = (active_connections >= AGENT_MAX_CONNECTIONS);
+
+    pthread_mutex_unlock(&conn_mutex);
+
+    pfd.events = full ? 0 : POLLIN;
+    int ready = poll(&pfd, 1, full ? 100 : 1000);
+
+    cache_sweep(false);
+    if (ready <= 0 || full)
+    {
+      continue;
+    }
+
+    int client_fd = accept(listen_fd, NULL, NULL);
+
+    if (client_fd < 0)
+    {
+      continue;
+    }
+
+    pthread_mutex_lock(&conn_mutex);
+    active_connections++;
+    pthread_mutex_unlock(&conn_mutex);
+
+    pthread_t thread;
+    pthread_attr_t attr;
+
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    if (pthread_create(&thread, &attr, serve_connection,
+                       (void *) (intptr_t) client_fd))
+    {
+      kmyth_log(LOG_ERR, "unable to start connection thread");
+      release_connection(client_fd);
+    }
+    pthread_attr_destroy(&attr);
+  }
+
+  kmyth_log(LOG_INFO, "kmyth-agent shutting down");
+  close(listen_fd);
+  unlink(socketPath);
+  if (strlen(socketDir) > 0)
+  {
+    rmdir(socketDir);
+  }
+  cache_sweep(true);
+  kmyth_clear_and_free(owner_auth, owner_auth_len);
+
+  return 0;
+}
@@ -8,7 +8,9 @@
  */
 
 #include <getopt.h>
+#include <stdio.h>
 #include <string.h>
+#include <time.h>
 
 #include <openssl/bio.h>
 #include <openssl/ssl.h>
@@ -29,14 +31,21 @@ static void usage(const char *prog)
           "  -i or --input         Path to file containing the kmyth-sealed client's certificate private key.\n"
           "  -l or --client        Path to file containing the client's certificate.\n\n"
           "Server Information --\n"
-          "  -t or --type          The type of the key server. Valid values include 'kmip' and 'simple'.\n"
+          "  -t or --type          The type of the key server. Valid values include 'kmip', 'simple', and\n"
+          "                        'framed' (a simple server that length-prefixes messages and responses).\n"
           "                        Defaults to 'simple'.\n"
           "  -s or --server        Path to file containing the certificate\n"
           "                        for the CA that issued the server cert.\n"
           "  -c or --conn_addr     The ip_address:port for the TLS connection.\n"
-          "  -m or --message       An optional message to send the key server.\n\n"
+          "  -m or --message       An optional message to send the key server.\n"
+          "  -k or --key_ids       Path to a file listing key IDs (one per line) to retrieve, in turn,\n"
+          "                        over a single TLS connection (a KMIP server gets them all in\n"
+          "                        one batch request). Replaces --message.\n"
+          "  -e or --session       Path to a file caching the TLS session, so that later runs can resume\n"
+          "                        it instead of performing a full handshake. Created if not present.\n\n"
           "Output Parameters --\n"
-          "  -o or --output        Output file path to write the key. If none is selected, key will be sent to stdout.\n\n"
+          "  -o or --output        Output file path to write the key. If none is selected, key will be sent to stdout.\n"
+          "                        With --key_ids, one '<key ID> <hex key>' line is written per key.\n\n"
           "Sealed Key Parameters --\n"
           "  -a or --auth_string   String used to create 'authVal' digest. Defaults to empty string (all-zero digest)\n"
           "  -w or --owner_auth    TPM 2.0 storage (owner) hierarchy authorization. Defaults to emptyAuth to match TPM default.\n\n"
@@ -64,6 +73,8 @@ const struct option longopts[] = {
   {"server", required_argument, 0, 's'},
   {"conn_addr", required_argument, 0, 'c'},
   {"message", required_argument, 0, 'm'},
+  {"key_ids", required_argument, 0, 'k'},
+  {"session", required_argument, 0, 'e'},
   // Output info
   {"output", required_argument, 0, 'o'},
   // Sealed Key info
@@ -75,6 +86,130 @@ const struct option longopts[] = {
   {0, 0, 0, 0}
 };
 
+//############################################################################
+// read_key_ids()
+//############################################################################
+static int read_key_ids(char *path, char **buffer, char ***key_ids,
+                        size_t *key_count)
+{
+  uint8_t *data = NULL;
+  size_t data_len = 0;
+
+  if (read_bytes_from_file(path, &data, &data_len))
+  {
+    kmyth_log(LOG_ERR, "unable to read key ID list %s ... exiting", path);
+    return 1;
+  }
+
+  // copy into a NUL terminated buffer, split in place below
+  *buffer = malloc(data_len + 1);
+  *key_ids = malloc((data_len / 2 + 1) * sizeof(char *));
+  if (*buffer == NULL || *key_ids == NULL)
+  {
+    kmyth_log(LOG_ERR, "unable to allocate key ID list ... exiting");
+    free(data);
+    free(*buffer);
+    free(*key_ids);
+    return 1;
+  }
+  if (data_len > 0)
+  {
+    memcpy(*buffer, data, data_len);
+  }
+  (*buffer)[data_len] = '\0';
+  free(data);
+
+  // one key ID per line, ignoring blank lines and trailing whitespace
+  *key_count = 0;
+  char *line = *buffer;
+
+  while (line != NULL && *line != '\0')
+  {
+    char *next = strchr(line, '\n');
+
+    if (next != NULL)
+    {
+      *next++ = '\0';
+    }
+
+    size_t line_len = strlen(line);
+
+    while (line_len > 0 && strchr(" \t\r", line[line_len - 1]) != NULL)
+    {
+      line[--line_len] = '\0';
+    }
+    if (line_len > 0)
+    {
+      (*key_ids)[(*key_count)++] = line;
+    }
+    line = next;
+  }
+
+  if (*key_count == 0)
+  {
+    kmyth_log(LOG_ERR, "no key IDs in %s ... exiting", path);
+    free(*buffer);
+    free(*key_ids);
+    return 1;
+  }
+
+  return 0;
+}
+
+//############################################################################
+// elapsed_seconds()
+//############################################################################
+static double elapsed_seconds(struct timespec *start)
+{
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (double) (now.tv_sec - start->tv_sec)
+    + (double) (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+//############################################################################
+// format_keys()
+//############################################################################
+static int format_keys(char **key_ids, unsigned char **keys, size_t *key_sizes,
+                       size_t key_count, char **output, size_t *output_len)
+{
+  static const char hex[] = "0123456789abcdef";
+
+  *output_len = 0;
+  for (size_t i = 0; i < key_count; i++)
+  {
+    *output_len += strlen(key_ids[i]) + 2 * key_sizes[i] + 2;
+  }
+
+  // the hex encoded keys are as sensitive as the keys themselves
+  *output = kmyth_secure_alloc(*output_len);
+  if (*output == NULL)
+  {
+    kmyth_log(LOG_ERR, "unable to allocate key output ... exiting");
+    return 1;
+  }
+
+  char *cursor = *output;
+
+  for (size_t i = 0; i < key_count; i++)
+  {
+    size_t id_len = strlen(key_ids[i]);
+
+    memcpy(cursor, key_ids[i], id_len);
+    cursor += id_len;
+    *cursor++ = ' ';
+    for (size_t j = 0; j < key_sizes[i]; j++)
+    {
+      *cursor++ = hex[keys[i][j] >> 4];
+      *cursor++ = hex[keys[i][j] & 0x0f];
+    }
+    *cursor++ = '\n';
+  }
+
+  return 0;
+}
+
 int main(int argc, char **argv)
 {
   // Exit early if there are no arguments
@@ -97,6 +232,8 @@ int main(int argc, char **argv)
   char *serverCertPath = NULL;
   char *address = NULL;
   char *message = NULL;
+  char *keyIdsPath = NULL;
+  char *sessionPath = NULL;
   char *authString = NULL;
   char *ownerAuthPasswd = "";
 
@@ -104,7 +241,7 @@ int main(int argc, char **argv)
   int option_index;
 
   while ((options =
-          getopt_long(argc, argv, "i:l:t:s:c:m:o:a:w:vh", longopts,
+          getopt_long(argc, argv, "i:l:t:s:c:m:k:e:o:a:w:vh", longopts,
                       &option_index)) != -1)
     switch (options)
     {
@@ -129,6 +266,12 @@ int main(int argc, char **argv)
     case 'm':
       message = optarg;
       break;
+    case 'k':
+      keyIdsPath = optarg;
+      break;
+    case 'e':
+      sessionPath = optarg;
+      break;
 
       // Output info
     case 'o':
@@ -192,6 +335,14 @@ int main(int argc, char **argv)
     return 1;
   }
 
+  if (keyIdsPath != NULL && message != NULL)
+  {
+    kmyth_log(LOG_ERR, "--key_ids and --message are exclusive ... exiting");
+    kmyth_clear(authString, auth_string_len);
+    kmyth_clear(ownerAuthPasswd, oa_passwd_len);
+    return 1;
+  }
+
   // If configured to write to an output file, verify that path
   if (outPath != NULL)
   {
@@ -208,6 +359,7 @@ int main(int argc, char **argv)
   size_t serverTypeLen = strlen(serverType);
 
   if (!check_string_arg(serverType, serverTypeLen, "simple", strlen("simple"))
+      && !check_string_arg(serverType, serverTypeLen, "framed", strlen("framed"))
       && !check_string_arg(serverType, serverTypeLen, "kmip", strlen("kmip")))
   {
     kmyth_log(LOG_ERR, "invalid key server type ... exiting");
@@ -238,12 +390,19 @@ int main(int argc, char **argv)
     return 1;
   }
 
-  // Compute size of user-specified optional message parameter
-  size_t message_length = 0;
+  // The key IDs to retrieve: the list, or the (optional) single message
+  char *keyIdsBuffer = NULL;
+  char **keyIds = &message;
+  size_t keyCount = 1;
 
-  if (message != NULL)
+  if (keyIdsPath != NULL)
   {
-    message_length = strlen(message);
+    if (read_key_ids(keyIdsPath, &keyIdsBuffer, &keyIds, &keyCount))
+    {
+      kmyth_clear(authString, auth_string_len);
+      kmyth_clear(ownerAuthPasswd, oa_passwd_len);
+      return 1;
+    }
   }
 
   // Use kmyth-unseal to recover the Client Authentication Private Key (CAPK)
@@ -261,6 +420,11 @@ int main(int argc, char **argv)
     free(sdo_orig_fn);
     kmyth_clear(authString, auth_string_len);
     kmyth_clear(ownerAuthPasswd, oa_passwd_len);
+    free(keyIdsBuffer);
+    if (keyIdsPath != NULL)
+    {
+      free(keyIds);
+    }
     return 1;
   }
 
@@ -270,84 +434,144 @@ int main(int argc, char **argv)
   kmyth_clear(authString, auth_string_len);
   kmyth_clear(ownerAuthPasswd, oa_passwd_len);
 
+  // A cached TLS session lets the server skip the full handshake (a missing
+  // or unusable cache only costs a full handshake)
+  SSL_SESSION *session = NULL;
+
+  if (sessionPath != NULL && tls_read_session(sessionPath, &session))
+  {
+    kmyth_log(LOG_WARNING, "ignoring TLS session cache %s", sessionPath);
+    session = NULL;
+  }
+
   // Create TLS connection to the key server, using the CAPK
   BIO *bio = NULL;
   SSL_CTX *ctx = NULL;
+  struct timespec start;
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
 
-  if (create_tls_connection(&address,
-                            clientPrivateKey_data,
-                            clientPrivateKey_size,
-                            clientCertPath, serverCertPath, &bio, &ctx) == 1)
+  int tls_result = create_tls_connection_with_session(&address,
+                                                      clientPrivateKey_data,
+                                                      clientPrivateKey_size,
+                                                      clientCertPath,
+                                                      serverCertPath,
+                                                      session, &bio, &ctx);
+
+  double connect_time = elapsed_seconds(&start);
+
+  // (a session offered to the connection holds its own reference)
+  SSL_SESSION_free(session);
+
+  // Done with unsealed key buffer, so clear and free this memory
+  kmyth_clear_and_free(clientPrivateKey_data, clientPrivateKey_size);
+
+  if (tls_result == 1)
   {
     kmyth_log(LOG_ERR, "error creating TLS connection ... exiting");
     BIO_ssl_shutdown(bio);
     tls_cleanup();
     BIO_free_all(bio);
     SSL_CTX_free(ctx);
-    kmyth_clear_and_free(clientPrivateKey_data, clientPrivateKey_size);
+    free(keyIdsBuffer);
+    if (keyIdsPath != NULL)
+    {
+      free(keyIds);
+    }
     return 1;
   }
 
-  // Done with unsealed key buffer, so clear and free this memory
-  kmyth_clear_and_free(clientPrivateKey_data, clientPrivateKey_size);
-
-  // Now that we have a secure connection to the key server, retrieve the key
-  size_t key_size = 0;
-  unsigned char *key = NULL;
+  SSL *ssl = NULL;
+  int resumed = (BIO_get_ssl(bio, &ssl) > 0 && ssl != NULL
+                 && SSL_session_reused(ssl));
 
-  int server_result = 1;
+  // Now that we have a secure connection to the key server, retrieve the
+  // keys, one request after another over the same connection
+  unsigned char **keys = calloc(keyCount, sizeof(unsigned char *));
+  size_t *key_sizes = calloc(keyCount, sizeof(size_t));
+  size_t retrieved = 0;
 
-  if (check_string_arg(serverType, serverTypeLen, "kmip", strlen("kmip")))
+  if (keys == NULL || key_sizes == NULL)
   {
-    server_result = get_key_from_kmip_server(bio,
-                                             message, message_length,
-                                             &key, &key_size);
-  }
-  else
-  {
-    // The "simple" key server is the default.
-    server_result = get_key_from_tls_server(bio,
-                                            message, message_length,
-                                            &key, &key_size);
+    kmyth_log(LOG_ERR, "unable to allocate key list ... exiting");
   }
 
-  if (server_result)
+  int kmip_server = check_string_arg(serverType, serverTypeLen,
+                                     "kmip", strlen("kmip"));
+  int kmip_batch = kmip_server && keyIdsPath != NULL;
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  // A KMIP server returns a whole key list in one (batch) round trip
+  if (keys != NULL && key_sizes != NULL && kmip_batch)
   {
-    kmyth_log(LOG_ERR, "error obtaining key from server ... exiting");
-    BIO_ssl_shutdown(bio);
-    tls_cleanup();
-    if (BIO_reset(bio) != 0)
+    if (get_keys_from_kmip_server(bio, keyIds, keyCount, keys, key_sizes))
     {
-      kmyth_log(LOG_ERR, "error resetting TLS BIO");
+      kmyth_log(LOG_ERR, "error obtaining keys from server ... exiting");
+    }
+    else
+    {
+      retrieved = keyCount;
     }
-    BIO_free_all(bio);
-    SSL_CTX_free(ctx);
-    kmyth_clear_and_free(key, key_size);
-    return 1;
   }
 
-  if (outPath == NULL)
+  while (keys != NULL && key_sizes != NULL && !kmip_batch
+         && retrieved < keyCount)
   {
-    if (print_to_stdout(key, key_size) != 0)
+    char *key_id = keyIds[retrieved];
+    size_t key_id_len = (key_id == NULL) ? 0 : strlen(key_id);
+    int server_result = 1;
+
+    if (kmip_server)
     {
-      kmyth_log(LOG_ERR, "error printing to stdout ... exiting");
+      server_result = get_key_from_kmip_server(bio,
+                                               key_id, key_id_len,
+                                               &keys[retrieved],
+                                               &key_sizes[retrieved]);
     }
-  }
-  else
-  {
-    if (write_bytes_to_file(outPath, key, key_size))
+    else if (check_string_arg(serverType, serverTypeLen,
+                              "framed", strlen("framed")))
+    {
+      // A "framed" key server length-prefixes its responses, so they may
+      // be of any size (e.g., key bundles)
+      server_result = get_framed_key_from_tls_server(bio,
+                                                     key_id, key_id_len,
+                                                     &keys[retrieved],
+                                                     &key_sizes[retrieved]);
+    }
+    else
     {
-      kmyth_log(LOG_ERR, "Error writing file: %s", outPath);
+      // The "simple" key server is the default.
+      server_result = get_key_from_tls_server(bio,
+                                              key_id, key_id_len,
+                                              &keys[retrieved],
+                                              &key_sizes[retrieved]);
     }
+    if (server_result)
+    {
+      kmyth_log(LOG_ERR, "error obtaining key from server ... exiting");
+      break;
+    }
+    retrieved++;
   }
 
-  // Done with memory holding key, clear and free it
-  kmyth_clear_and_free(key, key_size);
+  double fetch_time = elapsed_seconds(&start);
+  int retval = (retrieved == keyCount) ? 0 : 1;
 
-  kmyth_log(LOG_INFO, "retrieved key from %s", address);
+  // Cache the session (TLS 1.3 tickets arrive after the handshake, so this
+  // is done once the keys have been exchanged)
+  if (retval == 0 && sessionPath != NULL
+      && tls_write_session(bio, sessionPath))
+  {
+    kmyth_log(LOG_WARNING, "unable to cache TLS session in %s", sessionPath);
+  }
 
   // Cleanup TLS connection
   BIO_ssl_shutdown(bio);
+  if (retval != 0)
+  {
+    tls_cleanup();
+  }
   if (BIO_reset(bio) != 0)
   {
     kmyth_log(LOG_ERR, "error resetting TLS BIO");
@@ -355,5 +579,70 @@ int main(int argc, char **argv)
   BIO_free_all(bio);
   SSL_CTX_free(ctx);
 
-  return 0;
+  if (retval == 0 && keyIdsPath == NULL)
+  {
+    if (outPath == NULL)
+    {
+      if (print_to_stdout(keys[0], key_sizes[0]) != 0)
+      {
+        kmyth_log(LOG_ERR, "error printing to stdout ... exiting");
+      }
+    }
+    else
+    {
+      if (write_bytes_to_file(outPath, keys[0], key_sizes[0]))
+      {
+        kmyth_log(LOG_ERR, "Error writing file: %s", outPath);
+      }
+    }
+    kmyth_log(LOG_INFO, "retrieved key from %s", address);
+  }
+  else if (retval == 0)
+  {
+    char *output = NULL;
+    size_t output_len = 0;
+
+    retval = format_keys(keyIds, keys, key_sizes, keyCount,
+                         &output, &output_len);
+    if (retval == 0 && outPath == NULL)
+    {
+      if (print_to_stdout((unsigned char *) output, output_len) != 0)
+      {
+        kmyth_log(LOG_ERR, "error printing to stdout ... exiting");
+        retval = 1;
+      }
+    }
+    else if (retval == 0)
+    {
+      if (write_bytes_to_file(outPath, (uint8_t *) output, output_len))
+      {
+        kmyth_log(LOG_ERR, "Error writing file: %s", outPath);
+        retval = 1;
+      }
+    }
+    kmyth_clear_and_free(output, output_len);
+
+    // stdout may carry the keys, so the report goes to stderr
+    fprintf(stderr,
+            "TLS connection (%s handshake) in %.3f s\n"
+            "%zu keys in %.3f s (%.1f keys/sec)\n",
+            resumed ? "resumed" : "full", connect_time, keyCount,
+            fetch_time, (fetch_time > 0) ? keyCount / fetch_time : 0.0);
+    kmyth_log(LOG_INFO, "retrieved %zu keys from %s", keyCount, address);
+  }
+
+  // Done with memory holding the keys, clear and free it
+  for (size_t i = 0; keys != NULL && key_sizes != NULL && i < keyCount; i++)
+  {
+    kmyth_clear_and_free(keys[i], key_sizes[i]);
+  }
+  free(keys);
+  free(key_sizes);
+  free(keyIdsBuffer);
+  if (keyIdsPath != NULL)
+  {
+    free(keyIds);
+  }
+
+  return retval;
 }
@@ -0,0 +1,853 @@
+/*
+ * KMIP mock server - serves symmetric keys from an in-memory store over
+ * loopback TLS, for benchmarking and testing kmyth-getkey and other KMIP
+ * clients without a real key server
+ */
+
+#include <errno.h>
+#include <getopt.h>
+#include <limits.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+
+#include <kmip/kmip.h>
+#include <openssl/err.h>
+#include <openssl/rand.h>
+#include <openssl/ssl.h>
+
+#include "defines.h"
+#include "file_io.h"
+#include "formatting_tools.h"
+#include "kmip_util.h"
+#include "kmyth_log.h"
+#include "memory_util.h"
+#include "socket_util.h"
+#include "tls_util.h"
+
+/// Default (loopback) port: the IANA-registered KMIP port
+#define KMIP_SERVER_DEFAULT_PORT "5696"
+
+/// Default number of worker threads
+#define KMIP_SERVER_DEFAULT_THREADS 4
+
+/// Upper bound on the -t option
+#define KMIP_SERVER_MAX_THREADS 256
+
+/// Upper bound on the -l and -j options (one hour, in milliseconds)
+#define KMIP_SERVER_MAX_DELAY_MS 3600000
+
+/// Size (in bytes) of generated keys
+#define KMIP_SERVER_KEY_SIZE 32
+
+/// Seconds a connected client may stay silent mid-message
+#define KMIP_SERVER_RECV_TIMEOUT 30
+
+/**
+ * @brief One key in the (read-only, sorted by ID) in-memory store
+ */
+typedef struct
+{
+  char *id;
+  size_t id_len;
+  unsigned char *key;
+  size_t key_len;
+} store_entry_t;
+
+static store_entry_t *store = NULL;
+static size_t store_count = 0;
+
+static SSL_CTX *server_ctx = NULL;
+static int listen_fd = -1;
+static unsigned int latency_ms = 0;
+static unsigned int jitter_ms = 0;
+
+// each worker's connected client socket (-1 when idle), so that a stop
+// can wake workers blocked reading from a client, and a condition that a
+// stop broadcasts to wake workers sleeping in inject_delay()
+static pthread_mutex_t client_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t stop_cond = PTHREAD_COND_INITIALIZER;
+static int client_fds[KMIP_SERVER_MAX_THREADS];
+
+static volatile sig_atomic_t stop_requested = 0;
+
+static void usage(const char *prog)
+{
+  fprintf(stdout,
+          "\nusage: %s [options]\n\n"
+          "options are: \n\n"
+          "Server Information --\n"
+          " -r or --priv          Path to the file containing the server's private key (PEM).\n"
+          " -c or --cert          Path to the file containing the server's certificate (PEM).\n"
+          " -a or --ca            Path to the file containing the CA certificate used to verify client\n"
+          "                       certificates. If none is given, clients are not asked for one.\n"
+          " -p or --port          Loopback (127.0.0.1) port to listen on. Defaults to %s; 0 picks a free port.\n"
+          " -t or --threads       Number of worker threads (connections served at once). Defaults to %d.\n\n"
+          "Key Store --\n"
+          " -s or --store         Path to a file of '<key ID> <hex key>' lines (as written by kmyth-getkey --key_ids).\n"
+          " -n or --generate      Number of random %d-byte keys to generate, with IDs key-0, key-1, ...\n\n"
+          "Fault Injection --\n"
+          " -l or --latency       Delay, in milliseconds, added to every response.\n"
+          " -j or --jitter        Random additional delay, from 0 up to this many milliseconds.\n"
+          "                       Latency and jitter are each limited to one hour.\n\n"
+          "Misc --\n"
+          " -v or --verbose       Enable detailed logging.\n"
+          " -h or --help          Help (displays this usage).\n\n"
+          "The server prints the port it is listening on, and serves until interrupted.\n",
+          prog, KMIP_SERVER_DEFAULT_PORT, KMIP_SERVER_DEFAULT_THREADS,
+          KMIP_SERVER_KEY_SIZE);
+}
+
+const struct option longopts[] = {
+  // Server info
+  {"priv", required_argument, 0, 'r'},
+  {"cert", required_argument, 0, 'c'},
+  {"ca", required_argument, 0, 'a'},
+  {"port", required_argument, 0, 'p'},
+  {"threads", required_argument, 0, 't'},
+  // Key store
+  {"store", required_argument, 0, 's'},
+  {"generate", required_argument, 0, 'n'},
+  // Fault injection
+  {"latency", required_argument, 0, 'l'},
+  {"jitter", required_argument, 0, 'j'},
+  // Misc
+  {"verbose", no_argument, 0, 'v'},
+  {"help", no_argument, 0, 'h'},
+  {0, 0, 0, 0}
+};
+
+//############################################################################
+// compare_entries()
+//############################################################################
+static int compare_entries(const void *a, const void *b)
+{
+  const store_entry_t *x = (const store_entry_t *) a;
+  const store_entry_t *y = (const store_entry_t *) b;
+  size_t len = (x->id_len < y->id_len) ? x->id_len : y->id_len;
+  int result = memcmp(x->id, y->id, len);
+
+  if (result != 0)
+  {
+    return result;
+  }
+  return (x->id_len > y->id_len) - (x->id_len < y->id_len);
+}
+
+//############################################################################
+// store_add()
+//############################################################################
+static int store_add(const char *id, size_t id_len,
+                     unsigned char *key, size_t key_len)
+{
+  store_entry_t *grown = realloc(store,
+                                 (store_count + 1) * sizeof(store_entry_t));
+
+  if (grown == NULL)
+  {
+    return 1;
+  }
+  store = grown;
+
+  store_entry_t *entry = &store[store_count];
+
+  entry->id = malloc(id_len + 1);
+  entry->key = kmyth_secure_alloc(key_len);
+  if (entry->id == NULL || entry->key == NULL)
+  {
+    free(entry->id);
+    kmyth_clear_and_free(entry->key, key_len);
+    return 1;
+  }
+  memcpy(entry->id, id, id_len);
+  entry->id[id_len] = '\0';
+  entry->id_len = id_len;
+  memcpy(entry->key, key, key_len);
+  entry->key_len = key_len;
+  store_count++;
+
+  return 0;
+}
+
+//############################################################################
+// store_free()
+//############################################################################
+static void store_free(void)
+{
+  for (size_t i = 0; i < store_count; i++)
+  {
+    free(store[i].id);
+    kmyth_clear_and_free(store[i].key, store[i].key_len);
+  }
+  free(store);
+  store = NULL;
+  store_count = 0;
+}
+
+//############################################################################
+// hex_value()
+//############################################################################
+static int hex_value(char c)
+{
+  if (c >= '0' && c <= '9')
+    return c - '0';
+  if (c >= 'a' && c <= 'f')
+    return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F')
+    return c - 'A' + 10;
+  return -1;
+}
+
+//############################################################################
+// store_load()
+//############################################################################
+static int store_load(char *path)
+{
+  uint8_t *data = NULL;
+  size_t data_len = 0;
+
+  if (read_bytes_from_file(path, &data, &data_len))
+  {
+    kmyth_log(LOG_ERR, "unable to read key store %s ... exiting", path);
+    return 1;
+  }
+
+  unsigned char key[KMYTH_GETKEY_RX_BUFFER_SIZE];
+  size_t line_number = 0;
+  size_t pos = 0;
+  int result = 0;
+
+  while (pos < data_len && result == 0)
+  {
+    size_t end = pos;
+
+    while (end < data_len && data[end] != '\n')
+    {
+      end++;
+    }
+    line_number++;
+
+    // '<key ID> <hex key>', ignoring blank lines and trailing whitespace
+    char *line = (char *) data + pos;
+    size_t line_len = end - pos;
+
+    while (line_len > 0 && strchr(" \t\r", line[line_len - 1]) != NULL)
+    {
+      line_len--;
+    }
+    pos = end + 1;
+    if (line_len == 0)
+    {
+      continue;
+    }
+
+    char *space = memchr(line, ' ', line_len);
+    size_t id_len = (space == NULL) ? 0 : (size_t) (space - line);
+    size_t hex_len = (space == NULL) ? 0 : line_len - id_len - 1;
+    size_t key_len = hex_len / 2;
+
+    if (id_len == 0 || hex_len == 0 || hex_len % 2 != 0
+        || key_len > sizeof(key))
+    {
+      kmyth_log(LOG_ERR, "invalid key store entry (%s:%zu) ... exiting",
+                path, line_number);
+      result = 1;
+      break;
+    }
+    for (size_t i = 0; i < key_len; i++)
+    {
+      int high = hex_value(space[1 + 2 * i]);
+      int low = hex_value(space[2 + 2 * i]);
+
+      if (high < 0 || low < 0)
+      {
+        kmyth_log(LOG_ERR, "invalid key store entry (%s:%zu) ... exiting",
+                  path, line_number);
+        result = 1;
+        break;
+      }
+      key[i] = (unsigned char) ((high << 4) | low);
+    }
+    if (result == 0 && store_add(line, id_len, key, key_len))
+    {
+      kmyth_log(LOG_ERR, "unable to allocate key store ... exiting");
+      result = 1;
+    }
+  }
+
+  kmyth_clear(key, sizeof(key));
+  kmyth_clear_and_free(data, data_len);
+
+  return result;
+}
+
+//############################################################################
+// store_generate()
+//############################################################################
+static int store_generate(size_t count)
+{
+  unsigned char key[KMIP_SERVER_KEY_SIZE];
+  char id[32];
+  int result = 0;
+
+  for (size_t i = 0; i < count && result == 0; i++)
+  {
+    int id_len = snprintf(id, sizeof(id), "key-%zu", i);
+
+    if (RAND_bytes(key, sizeof(key)) != 1
+        || store_add(id, (size_t) id_len, key, sizeof(key)))
+    {
+      kmyth_log(LOG_ERR, "unable to generate key store ... exiting");
+      result = 1;
+    }
+  }
+  kmyth_clear(key, sizeof(key));
+
+  return result;
+}
+
+//############################################################################
+// store_lookup()
+//############################################################################
+static store_entry_t *store_lookup(unsigned char *id, size_t id_len)
+{
+  store_entry_t target = {.id = (char *) id,.id_len = id_len };
+
+  return bsearch(&target, store, store_count, sizeof(store_entry_t),
+                 compare_entries);
+}
+
+//############################################################################
+// inject_delay()
+//############################################################################
+static void inject_delay(unsigned int *seed)
+{
+  unsigned int delay_ms = latency_ms;
+
+  if (jitter_ms > 0)
+  {
+    delay_ms += (unsigned int) rand_r(seed) % (jitter_ms + 1);
+  }
+  if (delay_ms == 0)
+  {
+    return;
+  }
+
+  // the workers block the stop signals, so a sleep is never interrupted by
+  // one: wait on the stop condition instead, which stop_clients() signals
+  struct timespec deadline;
+
+  clock_gettime(CLOCK_REALTIME, &deadline);
+  deadline.tv_sec += delay_ms / 1000;
+  deadline.tv_nsec += (long) (delay_ms % 1000) * 1000000L;
+  if (deadline.tv_nsec >= 1000000000L)
+  {
+    deadline.tv_sec++;
+    deadline.tv_nsec -= 1000000000L;
+  }
+
+  pthread_mutex_lock(&client_mutex);
+  while (!stop_requested
+         && pthread_cond_timedwait(&stop_cond, &client_mutex,
+                                   &deadline) != ETIMEDOUT)
+  {
+  }
+  pthread_mutex_unlock(&client_mutex);
+}
+
+//############################################################################
+// recv_kmip_message()
+//############################################################################
+static int recv_kmip_message(BIO * bio, unsigned char **message,
+                             size_t *message_len)
+{
+  // a KMIP message is one TTLV item: 8 header bytes (tag, type, and a
+  // big-endian length) followed by the encoded value
+  unsigned char header[8];
+
+  if (tls_read_exact(bio, header, sizeof(header)))
+  {
+    return 1;
+  }
+
+  size_t value_len = ((size_t) header[4] << 24) | ((size_t) header[5] << 16)
+    | ((size_t) header[6] << 8) | (size_t) header[7];
+
+  *message_len = sizeof(header) + value_len;
+  if (*message_len > KMIP_ENCODING_MAX_SIZE)
+  {
+    kmyth_log(LOG_ERR, "KMIP request too large (%zu bytes)", *message_len);
+    return 1;
+  }
+
+  *message = malloc(*message_len);
+  if (*message == NULL)
+  {
+    kmyth_log(LOG_ERR, "unable to allocate KMIP request buffer");
+    return 1;
+  }
+  memcpy(*message, header, sizeof(header));
+  if (tls_read_exact(bio, *message + sizeof(header), value_len))
+  {
+    free(*message);
+    *message = NULL;
+    return 1;
+  }
+
+  return 0;
+}
+
+//############################################################################
+// handle_request()
+//############################################################################
+static int handle_request(KMIP * ctx, unsigned char *request,
+                          size_t request_len, unsigned char **buffer,
+                          size_t *buffer_size, size_t *response_len)
+{
+  unsigned char **ids = NULL;
+  size_t *id_lens = NULL;
+  size_t id_count = 0;
+
+  if (parse_kmip_get_batch_request(ctx, request, request_len,
+                                   &ids, &id_lens, &id_count))
+  {
+    kmyth_log(LOG_ERR, "invalid KMIP request");
+    return 1;
+  }
+
+  unsigned char **keys = calloc(id_count, sizeof(unsigned char *));
+  size_t *key_lens = calloc(id_count, sizeof(size_t));
+  int result = 1;
+
+  if (keys != NULL && key_lens != NULL)
+  {
+    // the store is read-only while serving, so no locking is needed
+    for (size_t i = 0; i < id_count; i++)
+    {
+      store_entry_t *entry = store_lookup(ids[i], id_lens[i]);
+
+      if (entry != NULL)
+      {
+        keys[i] = entry->key;
+        key_lens[i] = entry->key_len;
+      }
+      else
+      {
+        kmyth_log(LOG_DEBUG, "unknown key ID: %s", (char *) ids[i]);
+      }
+    }
+    result = build_kmip_get_batch_response(ctx, ids, id_lens, keys, key_lens,
+                                           id_count, buffer, buffer_size,
+                                           response_len);
+  }
+
+  for (size_t i = 0; i < id_count; i++)
+  {
+    free(ids[i]);
+  }
+  free(ids);
+  free(id_lens);
+  free(keys);
+  free(key_lens);
+
+  return result;
+}
+
+//############################################################################
+// serve_connection()
+//############################################################################
+static void serve_connection(int socket_fd, KMIP * ctx, unsigned char **buffer,
+                             size_t *buffer_size, unsigned int *seed)
+{
+  struct timeval timeout = {.tv_sec = KMIP_SERVER_RECV_TIMEOUT,.tv_usec = 0 };
+  setsockopt(socket_fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+  SSL *ssl = SSL_new(server_ctx);
+
+  if (ssl == NULL || SSL_set_fd(ssl, socket_fd) != 1 || SSL_accept(ssl) != 1)
+  {
+    kmyth_log(LOG_DEBUG, "TLS handshake failed: %s",
+              ERR_error_string(ERR_get_error(), NULL));
+    SSL_free(ssl);
+    return;
+  }
+
+  // requests are read through an SSL BIO, as the clients read responses
+  // (tls_read_exact()); the BIO does not take ownership of the connection
+  BIO *bio = BIO_new(BIO_f_ssl());
+
+  if (bio == NULL)
+  {
+    kmyth_log(LOG_ERR, "unable to create SSL BIO");
+    SSL_shutdown(ssl);
+    SSL_free(ssl);
+    return;
+  }
+  BIO_set_ssl(bio, ssl, BIO_NOCLOSE);
+
+  // serve requests until the client closes the connection
+  unsigned char *request = NULL;
+  size_t request_len = 0;
+
+  while (!stop_requested
+         && recv_kmip_message(bio, &request, &request_len) == 0)
+  {
+    size_t response_len = 0;
+    int result = handle_request(ctx, request, request_len,
+                                buffer, buffer_size, &response_len);
+
+    free(request);
+    request = NULL;
+    if (result)
+    {
+      break;
+    }
+
+    inject_delay(seed);
+
+    if (response_len > INT_MAX
+        || BIO_write(bio, *buffer, (int) response_len) != (int) response_len)
+    {
+      kmyth_log(LOG_DEBUG, "unable to send KMIP response");
+      break;
+    }
+  }
+
+  BIO_free(bio);
+  SSL_shutdown(ssl);
+  SSL_free(ssl);
+}
+
+//############################################################################
+// set_client_fd()
+//############################################################################
+static bool set_client_fd(size_t slot, int socket_fd)
+{
+  bool registered = true;
+
+  pthread_mutex_lock(&client_mutex);
+  if (socket_fd >= 0 && stop_requested)
+  {
+    // stop_clients() has already run (or is waiting for the lock)
+    registered = false;
+  }
+  else
+  {
+    client_fds[slot] = socket_fd;
+  }
+  pthread_mutex_unlock(&client_mutex);
+
+  return registered;
+}
+
+//############################################################################
+// stop_clients()
+//############################################################################
+static void stop_clients(void)
+{
+  pthread_mutex_lock(&client_mutex);
+  for (size_t t = 0; t < KMIP_SERVER_MAX_THREADS; t++)
+  {
+    if (client_fds[t] >= 0)
+    {
+      // fails any blocked or later SSL_read()/SSL_write() on the connection
+      shutdown(client_fds[t], SHUT_RDWR);
+    }
+  }
+  pthread_cond_broadcast(&stop_cond);
+  pthread_mutex_unlock(&client_mutex);
+}
+
+//############################################################################
+// worker()
+//############################################################################
+static void *worker(void *arg)
+{
+  size_t slot = (size_t) (uintptr_t) arg;
+  unsigned int seed = (unsigned int) time(NULL) ^ (unsigned int) slot;
+  KMIP ctx = { 0 };
+  kmip_init(&ctx, NULL, 0, KMIP_1_0);
+
+  // the encoding buffer (which holds keys) is reused for every response
+  unsigned char *buffer = NULL;
+  size_t buffer_size = 0;
+
+  // the workers are the thread pool: each accepts and serves one
+  // connection at a time
+  while (!stop_requested)
+  {
+    int socket_fd = accept(listen_fd, NULL, NULL);
+
+    if (socket_fd < 0)
+    {
+      if (errno == EINTR || errno == ECONNABORTED)
+      {
+        continue;
+      }
+      break;
+    }
+    if (set_client_fd(slot, socket_fd))
+    {
+      serve_connection(socket_fd, &ctx, &buffer, &buffer_size, &seed);
+      set_client_fd(slot, -1);
+    }
+    close(socket_fd);
+  }
+
+  kmyth_clear_and_free(buffer, buffer_size);
+  kmip_destroy(&ctx);
+
+  return NULL;
+}
+
+//############################################################################
+// create_server_context()
+//############################################################################
+static SSL_CTX *create_server_context(char *key_path, char *cert_path,
+                                      char *ca_path)
+{
+  SSL_CTX *ctx = SSL_CTX_new(TLS_server_method());
+
+  if (ctx == NULL)
+  {
+    kmyth_log(LOG_ERR, "error creating new SSL context: %s",
+              ERR_error_string(ERR_get_error(), NULL));
+    return NULL;
+  }
+
+  if (SSL_CTX_use_certificate_file(ctx, cert_path, SSL_FILETYPE_PEM) != 1
+      || SSL_CTX_use_PrivateKey_file(ctx, key_path, SSL_FILETYPE_PEM) != 1
+      || SSL_CTX_check_private_key(ctx) != 1)
+  {
+    kmyth_log(LOG_ERR, "unable to load server key/certificate: %s",
+              ERR_error_string(ERR_get_error(), NULL));
+    SSL_CTX_free(ctx);
+    return NULL;
+  }
+
+  // mutual authentication, as with a production key server
+  if (ca_path != NULL)
+  {
+    if (SSL_CTX_load_verify_locations(ctx, ca_path, NULL) != 1)
+    {
+      kmyth_log(LOG_ERR, "trust store load error: %s",
+                ERR_error_string(ERR_get_error(), NULL));
+      SSL_CTX_free(ctx);
+      return NULL;
+    }
+    SSL_CTX_set_verify(ctx, SSL_VERIFY_PEER | SSL_VERIFY_FAIL_IF_NO_PEER_CERT,
+                       NULL);
+  }
+
+  // session tickets (enabled by default) let clients resume sessions,
+  // e.g., kmyth-getkey --session
+
+  return ctx;
+}
+
+int main(int argc, char **argv)
+{
+  // Configure logging messages
+  set_app_name(KMYTH_APP_NAME);
+  set_app_version(KMYTH_VERSION);
+  set_applog_path(KMYTH_APPLOG_PATH);
+
+  char *keyPath = NULL;
+  char *certPath = NULL;
+  char *caPath = NULL;
+  char *port = KMIP_SERVER_DEFAULT_PORT;
+  char *storePath = NULL;
+  size_t generateCount = 0;
+  size_t threadCount = KMIP_SERVER_DEFAULT_THREADS;
+  unsigned long value = 0;
+  int options;
+  int option_index;
+
+  while ((options = getopt_long(argc, argv, "r:c:a:p:t:s:n:l:j:vh", longopts,
+                                &option_index)) != -1)
+  {
+    switch (options)
+    {
+      // Server info
+    case 'r':
+      keyPath = optarg;
+      break;
+    case 'c':
+      certPath = optarg;
+      break;
+    case 'a':
+      caPath = optarg;
+      break;
+    case 'p':
+      port = optarg;
+      break;
+    case 't':
+      if (parse_unsigned_string(optarg, 1, KMIP_SERVER_MAX_THREADS, &value))
+      {
+        kmyth_log(LOG_ERR, "thread count must be 1 to %d ... exiting",
+                  KMIP_SERVER_MAX_THREADS);
+        return 1;
+      }
+      threadCount = (size_t) value;
+      break;
+      // Key store
+    case 's':
+      storePath = optarg;
+      break;
+    case 'n':
+      if (parse_unsigned_string(optarg, 1, SIZE_MAX, &value))
+      {
+        kmyth_log(LOG_ERR, "invalid key count (-n) ... exiting");
+        return 1;
+      }
+      generateCount = (size_t) value;
+      break;
+      // Fault injection
+    case 'l':
+      if (parse_unsigned_string(optarg, 0, KMIP_SERVER_MAX_DELAY_MS, &value))
+      {
+        kmyth_log(LOG_ERR, "invalid latency (-l) ... exiting");
+        return 1;
+      }
+      latency_ms = (unsigned int) value;
+      break;
+    case 'j':
+      if (parse_unsigned_string(optarg, 0, KMIP_SERVER_MAX_DELAY_MS, &value))
+      {
+        kmyth_log(LOG_ERR, "invalid jitter (-j) ... exiting");
+        return 1;
+      }
+      jitter_ms = (unsigned int) value;
+      break;
+      // Misc
+    case 'v':
+      // always display all log messages (severity threshold = LOG_DEBUG)
+      // to stdout or stderr (output mode = 0)
+      set_applog_severity_threshold(LOG_DEBUG);
+      set_applog_output_mode(0);
+      break;
+    case 'h':
+      usage(argv[0]);
+      return 0;
+    default:
+      return 1;
+    }
+  }
+
+  if (keyPath == NULL || certPath == NULL)
+  {
+    kmyth_log(LOG_ERR, "server key and certificate are required ... exiting");
+    usage(argv[0]);
+    return 1;
+  }
+  if ((storePath == NULL) == (generateCount == 0))
+  {
+    kmyth_log(LOG_ERR, "specify exactly one of --store or --generate "
+              "... exiting");
+    return 1;
+  }
+
+  // Populate the key store, sorted by ID for lookups
+  if ((storePath != NULL) ? store_load(storePath)
+      : store_generate(generateCount))
+  {
+    store_free();
+    return 1;
+  }
+  qsort(store, store_count, sizeof(store_entry_t), compare_entries);
+
+  server_ctx = create_server_context(keyPath, certPath, caPath);
+  if (server_ctx == NULL)
+  {
+    store_free();
+    return 1;
+  }
+
+  // Listen on the loopback interface only
+  if (setup_server_socket_on("127.0.0.1", port, &listen_fd)
+      || listen(listen_fd, SOMAXCONN))
+  {
+    kmyth_log(LOG_ERR, "unable to listen on 127.0.0.1:%s ... exiting", port);
+    if (listen_fd >= 0)
+    {
+      close(listen_fd);
+    }
+    SSL_CTX_free(server_ctx);
+    store_free();
+    return 1;
+  }
+
+  struct sockaddr_in addr;
+  socklen_t addr_len = sizeof(addr);
+
+  if (getsockname(listen_fd, (struct sockaddr *) &addr, &addr_len) == 0)
+  {
+    fprintf(stdout, "kmip-server listening on 127.0.0.1:%u (%zu keys, "
+            "%zu threads)\n", (unsigned int) ntohs(addr.sin_port),
+            store_count, threadCount);
+    fflush(stdout);
+  }
+
+  // the workers inherit a mask blocking the stop signals, so that they are
+  // delivered to (and waited for by) the main thread
+  sigset_t stop_signals;
+
+  sigemptyset(&stop_signals);
+  sigaddset(&stop_signals, SIGINT);
+  sigaddset(&stop_signals, SIGTERM);
+  pthread_sigmask(SIG_BLOCK, &stop_signals, NULL);
+  signal(SIGPIPE, SIG_IGN);
+
+  pthread_t threads[KMIP_SERVER_MAX_THREADS];
+  size_t started = 0;
+
+  for (size_t t = 0; t < KMIP_SERVER_MAX_THREADS; t++)
+  {
+    client_fds[t] = -1;
+  }
+
+  for (size_t t = 0; t < threadCount; t++)
+  {
+    if (pthread_create(&threads[t], NULL, worker, (void *) (uintptr_t) t))
+    {
+      kmyth_log(LOG_ERR, "unable to start worker thread %zu", t);
+      break;
+    }
+    started++;
+  }
+
+  // wait for a stop signal, then wake the workers blocked in accept() or
+  // reading from a connected client
+  int signum = 0;
+
+  if (started > 0)
+  {
+    sigwait(&stop_signals, &signum);
+  }
+  stop_requested = 1;
+  shutdown(listen_fd, SHUT_RDWR);
+  stop_clients();
+
+  for (size_t t = 0; t < started; t++)
+  {
+    pthread_join(threads[t], NULL);
+  }
+
+  kmyth_log(LOG_INFO, "kmip-server shutting down");
+  close(listen_fd);
+  SSL_CTX_free(server_ctx);
+  store_free();
+
+  return (started == threadCount) ? 0 : 1;
+}
@@ -0,0 +1,467 @@
+/**
+ * Kmyth Re-sealing Interface - TPM 2.0 version
+ *
+ * Re-wraps the symmetric wrapping key of one or more .ski files under a new
+ * PCR selection (and a new storage key) without decrypting the data itself.
+ */
+
+#include <getopt.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include "defines.h"
+#include "file_io.h"
+#include "formatting_tools.h"
+#include "kmyth.h"
+#include "kmyth_log.h"
+#include "memory_util.h"
+
+/**
+ * @brief Maximum number of .ski files passed to tpm2_kmyth_reseal() at once
+ *        when re-sealing a directory. This bounds the memory held for a
+ *        batch while still sharing the TPM session and new SK across it.
+ */
+#define KMYTH_RESEAL_BATCH_SIZE 16
+
+static void usage(const char *prog)
+{
+  fprintf(stdout,
+          "\nusage: %s [options] \n\n"
+          "options are: \n\n"
+          " -a or --auth_string   String used to create 'authVal' digest. Must match the value used to seal the input(s).\n"
+          "                       Defaults to empty string (all-zero digest).\n"
+          " -i or --input         Path to a .ski file, or to a directory of .ski files, to be re-sealed.\n"
+          " -o or --output        Destination for the re-sealed result (a file for a file input, an existing directory\n"
+          "                       for a directory input). If omitted, the input(s) are replaced in place (requires -f).\n"
+          " -f or --force         Force the overwrite of existing output files.\n"
+          " -p or --pcrs_list     New list of TPM platform configuration registers (PCRs) to apply to authorization policy.\n"
+          "                       Defaults to no PCRs specified. Encapsulate in quotes (e.g. \"0, 1, 2\").\n"
+          " -w or --owner_auth    TPM 2.0 storage (owner) hierarchy authorization. Defaults to emptyAuth to match TPM default.\n"
+          " -v or --verbose       Enable detailed logging.\n"
+          " -h or --help          Help (displays this usage).\n", prog);
+}
+
+const struct option longopts[] = {
+  {"auth_string", required_argument, 0, 'a'},
+  {"input", required_argument, 0, 'i'},
+  {"output", required_argument, 0, 'o'},
+  {"force", no_argument, 0, 'f'},
+  {"pcrs_list", required_argument, 0, 'p'},
+  {"owner_auth", required_argument, 0, 'w'},
+  {"verbose", no_argument, 0, 'v'},
+  {"help", no_argument, 0, 'h'},
+  {0, 0, 0, 0}
+};
+
+//############################################################################
+// join_path()
+//############################################################################
+static char *join_path(const char *dir, const char *name)
+{
+  size_t dir_len = strlen(dir);
+  size_t name_len = strlen(name);
+  char *path = malloc(dir_len + name_len + 2);
+
+  if (path == NULL)
+  {
+    return NULL;
+  }
+  memcpy(path, dir, dir_len);
+  if (dir_len == 0 || dir[dir_len - 1] != '/')
+  {
+    path[dir_len++] = '/';
+  }
+  memcpy(path + dir_len, name, name_len + 1);
+  return path;
+}
+
+//############################################################################
+// free_path_list()
+//############################################################################
+static void free_path_list(char **paths, size_t count)
+{
+  if (paths == NULL)
+  {
+    return;
+  }
+  for (size_t i = 0; i < count; i++)
+  {
+    free(paths[i]);
+  }
+  free(paths);
+}
+
+//############################################################################
+// collect_paths()
+//############################################################################
+static int collect_paths(char *inPath, char *outPath,
+                         char ***in_paths, char ***out_paths, size_t *count)
+{
+  struct stat st = { 0 };
+
+  *in_paths = NULL;
+  *out_paths = NULL;
+  *count = 0;
+
+  if (stat(inPath, &st))
+  {
+    kmyth_log(LOG_ERR, "invalid input path (%s) ... exiting", inPath);
+    return 1;
+  }
+
+  // single .ski file: output is either the specified file or the input itself
+  if (!S_ISDIR(st.st_mode))
+  {
+    *in_paths = malloc(sizeof(char *));
+    *out_paths = malloc(sizeof(char *));
+    if (*in_paths == NULL || *out_paths == NULL)
+    {
+      kmyth_log(LOG_ERR, "failed to allocate path list ... exiting");
+      free(*in_paths);
+      free(*out_paths);
+      *in_paths = NULL;
+      *out_paths = NULL;
+      return 1;
+    }
+    (*in_paths)[0] = strdup(inPath);
+    (*out_paths)[0] = strdup((outPath == NULL) ? inPath : outPath);
+    *count = 1;
+    if ((*in_paths)[0] == NULL || (*out_paths)[0] == NULL)
+    {
+      kmyth_log(LOG_ERR, "failed to allocate path ... exiting");
+      free_path_list(*in_paths, *count);
+      free_path_list(*out_paths, *count);
+      *in_paths = NULL;
+      *out_paths = NULL;
+      *count = 0;
+      return 1;
+    }
+    return 0;
+  }
+
+  // directory: every regular file with a .ski extension is re-sealed
+  if (outPath != NULL && (stat(outPath, &st) || !S_ISDIR(st.st_mode)))
+  {
+    kmyth_log(LOG_ERR, "output (%s) must be an existing directory when the "
+              "input is a directory ... exiting", outPath);
+    return 1;
+  }
+
+  DIR *dir = opendir(inPath);
+
+  if (dir == NULL)
+  {
+    kmyth_log(LOG_ERR, "unable to open input directory (%s) ... exiting",
+              inPath);
+    return 1;
+  }
+
+  size_t capacity = 0;
+  struct dirent *entry = NULL;
+  int retval = 0;
+
+  while (retval == 0 && (entry = readdir(dir)) != NULL)
+  {
+    size_t name_len = strlen(entry->d_name);
+
+    if (name_len <= 4 || strcmp(entry->d_name + name_len - 4, ".ski") != 0)
+    {
+      continue;
+    }
+
+    char *in_file = join_path(inPath, entry->d_name);
+
+    if (in_file == NULL || stat(in_file, &st) || !S_ISREG(st.st_mode))
+    {
+      free(in_file);
+      continue;
+    }
+
+    if (*count == capacity)
+    {
+      size_t new_capacity = (capacity == 0) ? 16 : capacity * 2;
+      char **new_in = realloc(*in_paths, new_capacity * sizeof(char *));
+
+      if (new_in != NULL)
+      {
+        *in_paths = new_in;
+      }
+      char **new_out = realloc(*out_paths, new_capacity * sizeof(char *));
+
+      if (new_out != NULL)
+      {
+        *out_paths = new_out;
+      }
+      if (new_in == NULL || new_out == NULL)
+      {
+        kmyth_log(LOG_ERR, "failed to grow path list ... exiting");
+        free(in_file);
+        retval = 1;
+        continue;
+      }
+      capacity = new_capacity;
+    }
+
+    char *out_file = join_path((outPath == NULL) ? inPath : outPath,
+                               entry->d_name);
+
+    if (out_file == NULL)
+    {
+      kmyth_log(LOG_ERR, "failed to allocate path ... exiting");
+      free(in_file);
+      retval = 1;
+      continue;
+    }
+    (*in_paths)[*count] = in_file;
+    (*out_paths)[*count] = out_file;
+    (*count)++;
+  }
+  closedir(dir);
+
+  if (retval)
+  {
+    free_path_list(*in_paths, *count);
+    free_path_list(*out_paths, *count);
+    *in_paths = NULL;
+    *out_paths = NULL;
+    *count = 0;
+    return 1;
+  }
+
+  if (*count == 0)
+  {
+    kmyth_log(LOG_ERR, "no .ski files found in %s ... exiting", inPath);
+    return 1;
+  }
+
+  return 0;
+}
+
+//############################################################################
+// reseal_batch()
+//############################################################################
+static int reseal_batch(char **in_paths, char **out_paths, size_t count,
+                        uint8_t * auth_bytes, size_t auth_bytes_len,
+                        uint8_t * owner_auth_bytes, size_t oa_bytes_len,
+                        int *pcrs, size_t pcrs_len)
+{
+  uint8_t *inputs[KMYTH_RESEAL_BATCH_SIZE] = { 0 };
+  size_t input_lens[KMYTH_RESEAL_BATCH_SIZE] = { 0 };
+  uint8_t *outputs[KMYTH_RESEAL_BATCH_SIZE] = { 0 };
+  size_t output_lens[KMYTH_RESEAL_BATCH_SIZE] = { 0 };
+  int retval = 0;
+
+  for (size_t i = 0; i < count && retval == 0; i++)
+  {
+    if (read_bytes_from_file(in_paths[i], &inputs[i], &input_lens[i]))
+    {
+      kmyth_log(LOG_ERR, "unable to read %s ... exiting", in_paths[i]);
+      retval = 1;
+    }
+  }
+
+  if (retval == 0)
+  {
+    retval = tpm2_kmyth_reseal(inputs, input_lens, count,
+                               outputs, output_lens,
+                               auth_bytes, auth_bytes_len,
+                               owner_auth_bytes, oa_bytes_len, pcrs, pcrs_len);
+    if (retval)
+    {
+      kmyth_log(LOG_ERR, "unable to re-seal batch starting at %s ... exiting",
+                in_paths[0]);
+    }
+  }
+
+  // outputs are only written once the whole batch has been re-sealed, and
+  // each replaces its file atomically (in place, the file being replaced
+  // is the only sealed copy of the data)
+  for (size_t i = 0; i < count && retval == 0; i++)
+  {
+    if (write_bytes_to_file_atomic(out_paths[i], outputs[i], output_lens[i]))
+    {
+      kmyth_log(LOG_ERR, "error writing re-sealed data to %s ... exiting",
+                out_paths[i]);
+      retval = 1;
+    }
+    else
+    {
+      kmyth_log(LOG_DEBUG, "re-sealed %s to %s", in_paths[i], out_paths[i]);
+    }
+  }
+
+  for (size_t i = 0; i < count; i++)
+  {
+    free(inputs[i]);
+    free(outputs[i]);
+  }
+
+  return retval;
+}
+
+int main(int argc, char **argv)
+{
+  // If no command line arguments provided, provide usage help and exit early
+  if (argc == 1)
+  {
+    usage(argv[0]);
+    return 0;
+  }
+
+  // Configure logging messages
+  set_app_name(KMYTH_APP_NAME);
+  set_app_version(KMYTH_VERSION);
+  set_applog_path(KMYTH_APPLOG_PATH);
+
+  // Initialize parameters that might be modified by command line options
+  char *inPath = NULL;
+  char *outPath = NULL;
+  char *authString = NULL;
+  char *ownerAuthPasswd = "";
+  char *pcrsString = NULL;
+  bool forceOverwrite = false;
+
+  // Parse and apply command line options
+  int options;
+  int option_index;
+
+  while ((options =
+          getopt_long(argc, argv, "a:i:o:p:w:fhv", longopts,
+                      &option_index)) != -1)
+  {
+    switch (options)
+    {
+    case 'a':
+      authString = optarg;
+      break;
+    case 'i':
+      inPath = optarg;
+      break;
+    case 'o':
+      outPath = optarg;
+      break;
+    case 'f':
+      forceOverwrite = true;
+      break;
+    case 'p':
+      pcrsString = optarg;
+      break;
+    case 'w':
+      ownerAuthPasswd = optarg;
+      break;
+    case 'v':
+      // always display all log messages (severity threshold = LOG_DEBUG)
+      // to stdout or stderr (output mode = 0)
+      set_applog_severity_threshold(LOG_DEBUG);
+      set_applog_output_mode(0);
+      break;
+    case 'h':
+      usage(argv[0]);
+      return 0;
+    default:
+      return 1;
+    }
+  }
+
+  //Since these originate in main() we know they are null terminated
+  size_t auth_string_len = (authString == NULL) ? 0 : strlen(authString);
+  size_t oa_passwd_len =
+    (ownerAuthPasswd == NULL) ? 0 : strlen(ownerAuthPasswd);
+
+  // Check that input path was specified, and that replacing the input(s)
+  // in place was explicitly requested if no output was given
+  if (inPath == NULL || (outPath == NULL && !forceOverwrite))
+  {
+    kmyth_log(LOG_ERR, "input must be specified, and either an output "
+              "specified or in-place replacement forced (-f) ... exiting");
+    kmyth_clear(authString, auth_string_len);
+    kmyth_clear(ownerAuthPasswd, oa_passwd_len);
+    return 1;
+  }
+
+  char **in_paths = NULL;
+  char **out_paths = NULL;
+  size_t path_count = 0;
+
+  if (collect_paths(inPath, outPath, &in_paths, &out_paths, &path_count))
+  {
+    kmyth_log(LOG_ERR, "unable to determine files to re-seal ... exiting");
+    kmyth_clear(authString, auth_string_len);
+    kmyth_clear(ownerAuthPasswd, oa_passwd_len);
+    return 1;
+  }
+
+  // If 'force overwrite' flag not set, make sure no output file exists
+  if (!forceOverwrite)
+  {
+    struct stat st = { 0 };
+
+    for (size_t i = 0; i < path_count; i++)
+    {
+      if (!stat(out_paths[i], &st))
+      {
+        kmyth_log(LOG_ERR, "output filename (%s) already exists ... exiting",
+                  out_paths[i]);
+        kmyth_clear(authString, auth_string_len);
+        kmyth_clear(ownerAuthPasswd, oa_passwd_len);
+        free_path_list(in_paths, path_count);
+        free_path_list(out_paths, path_count);
+        return 1;
+      }
+    }
+  }
+
+  int *pcrs = NULL;
+  int pcrs_len = 0;
+
+  if (parse_pcrs_string(pcrsString, &pcrs, &pcrs_len) != 0)
+  {
+    kmyth_log(LOG_ERR, "failed to parse PCR string %s ... exiting", pcrsString);
+    kmyth_clear(authString, auth_string_len);
+    kmyth_clear(ownerAuthPasswd, oa_passwd_len);
+    free_path_list(in_paths, path_count);
+    free_path_list(out_paths, path_count);
+    return 1;
+  }
+
+  // Re-seal in fixed-size batches - each batch shares one TPM session and
+  // one new storage key, and a failed batch leaves its files untouched
+  size_t failed = 0;
+
+  for (size_t i = 0; i < path_count; i += KMYTH_RESEAL_BATCH_SIZE)
+  {
+    size_t batch_count = path_count - i;
+
+    if (batch_count > KMYTH_RESEAL_BATCH_SIZE)
+    {
+      batch_count = KMYTH_RESEAL_BATCH_SIZE;
+    }
+    if (reseal_batch(&in_paths[i], &out_paths[i], batch_count,
+                     (uint8_t *) authString, auth_string_len,
+                     (uint8_t *) ownerAuthPasswd, oa_passwd_len,
+                     pcrs, pcrs_len))
+    {
+      failed += batch_count;
+    }
+  }
+
+  kmyth_clear(authString, auth_string_len);
+  kmyth_clear(ownerAuthPasswd, oa_passwd_len);
+  free(pcrs);
+  free_path_list(in_paths, path_count);
+  free_path_list(out_paths, path_count);
+
+  if (failed)
+  {
+    kmyth_log(LOG_ERR, "kmyth-reseal failed for %zu of %zu file(s) ... exiting",
+              failed, path_count);
+    return 1;
+  }
+
+  kmyth_log(LOG_INFO, "re-sealed %zu file(s)", path_count);
+  return 0;
+}
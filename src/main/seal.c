@@ -3,15 +3,18 @@
  */
 
 #include <getopt.h>
+#include <malloc.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
 #include <sys/stat.h>
+#include <time.h>
 
 #include "defines.h"
 #include "file_io.h"
+#include "formatting_tools.h"
 #include "kmyth.h"
 #include "kmyth_log.h"
 #include "memory_util.h"
@@ -24,105 +27,6 @@
  */
 extern const cipher_t cipher_list[];
 
-//############################################################################
-// parse_pcrs_string()
-//############################################################################
-static int parse_pcrs_string(char *pcrs_string, int **pcrs, int *pcrs_len)
-{
-  *pcrs_len = 0;
-
-  if (pcrs_string == NULL)
-  {
-    return 0;
-  }
-
-  kmyth_log(LOG_DEBUG, "parsing PCR selection string");
-
-  *pcrs = NULL;
-  *pcrs = malloc(24 * sizeof(int));
-  size_t pcrs_array_size = 24;
-
-  if (pcrs == NULL)
-  {
-    kmyth_log(LOG_ERR,
-              "failed to allocate memory to parse PCR string ... exiting");
-    return 1;
-  }
-
-  char *pcrs_string_cur = pcrs_string;
-  char *pcrs_string_next = NULL;
-
-  long pcrIndex;
-
-  while (*pcrs_string_cur != '\0')
-  {
-    pcrIndex = strtol(pcrs_string_cur, &pcrs_string_next, 10);
-
-    // Check for overflow or underflow on the strtol call. There
-    // really shouldn't be, because the number of PCRs is small.
-    if ((pcrIndex == LONG_MIN) || (pcrIndex == LONG_MAX))
-    {
-      kmyth_log(LOG_ERR, "invalid PCR value specified ... exiting");
-      free(*pcrs);
-      *pcrs_len = 0;
-      return 1;
-    }
-
-    // Check that strtol didn't fail to parse an integer, which is the only
-    // condition that would cause the pointers to match.
-    if (pcrs_string_cur == pcrs_string_next)
-    {
-      kmyth_log(LOG_ERR, "error parsing PCR string ... exiting");
-      free(*pcrs);
-      *pcrs_len = 0;
-      return 1;
-    }
-
-    // Look at the first invalid character from the last call to strtol
-    // and confirm it's a blank, a comma, or '\0'. If not there's a disallowed
-    // character in the PCR string.
-    if (!isblank(*pcrs_string_next) && (*pcrs_string_next != ',')
-        && (*pcrs_string_next != '\0'))
-    {
-      kmyth_log(LOG_ERR, "invalid character (%c) in PCR string ... exiting",
-                *pcrs_string_next);
-      free(*pcrs);
-      *pcrs_len = 0;
-      return 1;
-    }
-
-    // Step past the invalid characters, checking not to skip past the
-    // end of the string.
-    while ((*pcrs_string_next != '\0')
-           && (isblank(*pcrs_string_next) || (*pcrs_string_next == ',')))
-    {
-      pcrs_string_next++;
-    }
-
-    if (*pcrs_len == pcrs_array_size)
-    {
-      int *new_pcrs = NULL;
-
-      new_pcrs = realloc(*pcrs, pcrs_array_size * 2);
-      if (new_pcrs == NULL)
-      {
-        kmyth_log(LOG_ERR, "Ran out of memory ... exiting");
-        free(*pcrs);
-        *pcrs_len = 0;
-        return 1;
-      }
-      *pcrs = new_pcrs;
-      pcrs_array_size *= 2;
-    }
-    (*pcrs)[*pcrs_len] = (int) pcrIndex;
-    (*pcrs_len)++;
-    pcrs_string_cur = pcrs_string_next;
-    pcrs_string_next = NULL;
-  }
-
-  return 0;
-}
-
 static void usage(const char *prog)
 {
   fprintf(stdout,
@@ -136,6 +40,7 @@ static void usage(const char *prog)
           "                       Defaults to no PCRs specified. Encapsulate in quotes (e.g. \"0, 1, 2\").\n"
           " -c or --cipher        Specifies the cipher type to use. Defaults to \'%s\'\n"
           " -l or --list_ciphers  Lists all valid ciphers and exits.\n"
+          " -b or --bench-ciphers Measures each valid cipher on this CPU, recommends one, and exits.\n"
           " -w or --owner_auth    TPM 2.0 storage (owner) hierarchy authorization. Defaults to emptyAuth to match TPM default.\n"
           " -v or --verbose       Enable detailed logging.\n"
           " -h or --help          Help (displays this usage).\n", prog,
@@ -160,6 +65,145 @@ static void list_ciphers(void)
           "using a 256-bit key.\n");
 }
 
+/**
+ * @brief Size of the payload each cipher is measured against by
+ *        bench_ciphers() (key wrap modes, which are far slower, use a
+ *        smaller one), and the minimum time spent measuring each cipher
+ */
+#define BENCH_CIPHERS_DATA_SIZE (16 * 1024 * 1024)
+#define BENCH_CIPHERS_KEYWRAP_DATA_SIZE (256 * 1024)
+#define BENCH_CIPHERS_MIN_SECONDS 0.5
+
+static double bench_ciphers_now(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double) ts.tv_sec + (double) ts.tv_nsec / 1e9;
+}
+
+static int bench_ciphers(void)
+{
+  size_t data_len = BENCH_CIPHERS_DATA_SIZE;
+  unsigned char *data = malloc(data_len);
+  unsigned char key[64] = { 0 };
+  const char *recommended = NULL;
+  double recommended_rate = 0.0;
+
+  if (data == NULL)
+  {
+    kmyth_log(LOG_ERR, "unable to allocate benchmark data ... exiting");
+    return 1;
+  }
+  for (size_t i = 0; i < data_len; i++)
+  {
+    data[i] = (unsigned char) (i * 31);
+  }
+
+  // keep the encrypt/decrypt buffers on the heap so that every cipher is
+  // measured without the page faults of freshly mmap()ed allocations
+  mallopt(M_MMAP_THRESHOLD, 4 * BENCH_CIPHERS_DATA_SIZE);
+  mallopt(M_TRIM_THRESHOLD, 8 * BENCH_CIPHERS_DATA_SIZE);
+
+  // let the CPU reach a steady clock speed before the first measurement
+  double warmup_start = bench_ciphers_now();
+
+  while (bench_ciphers_now() - warmup_start < BENCH_CIPHERS_MIN_SECONDS)
+  {
+    unsigned char *enc = NULL;
+    size_t enc_len = 0;
+
+    if (cipher_list[0].encrypt_fn(key, get_key_len_from_cipher(cipher_list[0])
+                                  / 8, data, data_len, &enc, &enc_len))
+    {
+      break;
+    }
+    free(enc);
+  }
+
+  fprintf(stdout, "Measuring kmyth ciphers on %d MiB of data "
+          "(%d KiB for key wrap modes):\n", BENCH_CIPHERS_DATA_SIZE >> 20,
+          BENCH_CIPHERS_KEYWRAP_DATA_SIZE >> 10);
+  fprintf(stdout, "  %-36s %12s %12s\n", "cipher", "encrypt", "decrypt");
+
+  for (size_t i = 0; cipher_list[i].cipher_name != NULL; i++)
+  {
+    cipher_t c = cipher_list[i];
+    size_t key_len = get_key_len_from_cipher(c) / 8;
+    bool keywrap = (strstr(c.cipher_name, "KeyWrap") != NULL);
+    double elapsed[2] = { 0.0, 0.0 };
+    size_t reps = 0;
+    bool failed = (key_len == 0 || key_len > sizeof(key));
+
+    data_len = keywrap ? BENCH_CIPHERS_KEYWRAP_DATA_SIZE :
+      BENCH_CIPHERS_DATA_SIZE;
+
+    // the first (untimed) pass warms up the allocator and the cipher
+    bool warm = false;
+
+    while (!failed && elapsed[0] + elapsed[1] < BENCH_CIPHERS_MIN_SECONDS)
+    {
+      unsigned char *enc = NULL;
+      unsigned char *dec = NULL;
+      size_t enc_len = 0;
+      size_t dec_len = 0;
+      double start = bench_ciphers_now();
+
+      failed = c.encrypt_fn(key, key_len, data, data_len, &enc, &enc_len);
+      elapsed[0] += bench_ciphers_now() - start;
+      if (!failed)
+      {
+        start = bench_ciphers_now();
+        failed = c.decrypt_fn(key, key_len, enc, enc_len, &dec, &dec_len)
+          || dec_len != data_len || memcmp(dec, data, data_len);
+        elapsed[1] += bench_ciphers_now() - start;
+      }
+      free(enc);
+      kmyth_clear_and_free(dec, dec_len);
+      if (!warm)
+      {
+        elapsed[0] = elapsed[1] = 0.0;
+        warm = true;
+        continue;
+      }
+      reps++;
+    }
+
+    if (failed)
+    {
+      fprintf(stdout, "  %-36s %12s %12s\n", c.cipher_name, "failed", "");
+      continue;
+    }
+
+    double mib = (double) (reps * data_len) / (1024.0 * 1024.0);
+    double enc_rate = mib / elapsed[0];
+    double dec_rate = mib / elapsed[1];
+
+    fprintf(stdout, "  %-36s %7.0f MiB/s %7.0f MiB/s\n", c.cipher_name,
+            enc_rate, dec_rate);
+
+    // recommend from the bulk data ciphers with kmyth's default 256-bit
+    // strength (key wrap modes are intended for key material)
+    double rate = 2.0 / (1.0 / enc_rate + 1.0 / dec_rate);
+
+    if (!keywrap && key_len == 32 && rate > recommended_rate)
+    {
+      recommended = c.cipher_name;
+      recommended_rate = rate;
+    }
+  }
+  free(data);
+
+  if (recommended == NULL)
+  {
+    kmyth_log(LOG_ERR, "no cipher completed the benchmark ... exiting");
+    return 1;
+  }
+  fprintf(stdout, "Recommended cipher on this CPU: '%s' (use '-c %s')\n",
+          recommended, recommended);
+  return 0;
+}
+
 const struct option longopts[] = {
   {"auth_string", required_argument, 0, 'a'},
   {"input", required_argument, 0, 'i'},
@@ -171,6 +215,8 @@ const struct option longopts[] = {
   {"verbose", no_argument, 0, 'v'},
   {"help", no_argument, 0, 'h'},
   {"list_ciphers", no_argument, 0, 'l'},
+  {"bench-ciphers", no_argument, 0, 'b'},
+  {"bench_ciphers", no_argument, 0, 'b'},
   {0, 0, 0, 0}
 };
 
@@ -203,7 +249,7 @@ int main(int argc, char **argv)
   int option_index;
 
   while ((options =
-          getopt_long(argc, argv, "a:i:o:c:p:w:fhlv", longopts,
+          getopt_long(argc, argv, "a:i:o:c:p:w:bfhlv", longopts,
                       &option_index)) != -1)
   {
     switch (options)
@@ -249,6 +295,8 @@ int main(int argc, char **argv)
     case 'l':
       list_ciphers();
       return 0;
+    case 'b':
+      return bench_ciphers();
     default:
       return 1;
     }
@@ -2,33 +2,86 @@
  * Kmyth Unsealing Interface - TPM 2.0
  */
 
+#include <fcntl.h>
 #include <getopt.h>
 #include <stdbool.h>
 #include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 #include <sys/stat.h>
 
+#include "agent_util.h"
 #include "defines.h"
 #include "file_io.h"
 #include "kmyth.h"
 #include "kmyth_log.h"
 #include "memory_util.h"
+#include "socket_util.h"
 
 static void usage(const char *prog)
 {
   fprintf(stdout,
-          "\nusage: %s [options]\n\n"
+          "\nusage: %s [options] [-x command [args]]\n\n"
           "options are: \n\n"
           " -a or --auth_string   String used to create 'authVal' digest. Defaults to empty string (all-zero digest).\n"
           " -i or --input         Path to file containing data the to be unsealed\n"
-          " -o or --output        Destination path for unsealed file. This or -s must be specified. Will not overwrite any\n"
+          " -o or --output        Destination path for unsealed file. This, -s, -x or -u must be specified. Will not overwrite any\n"
           "                       existing files unless the 'force' option is selected.\n"
           " -f or --force         Force the overwrite of an existing output file\n"
           " -s or --stdout        Output unencrypted result to stdout instead of file.\n"
+          " -x or --exec          Run the command following the options, handing it the unencrypted result in a\n"
+          "                       sealed (read-only) memfd. The descriptor is inherited by the command, and its\n"
+          "                       number is given in the %s environment variable.\n"
+          " -u or --send_fd       Pass the unencrypted result, in a sealed (read-only) memfd, to the process\n"
+          "                       listening on this Unix domain socket path (SCM_RIGHTS).\n"
           " -w or --owner_auth    TPM 2.0 storage (owner) hierarchy authorization. Defaults to emptyAuth to match TPM default.\n"
+          " -g or --agent         Unseal through a running kmyth-agent, which caches the result. The agent\n"
+          "                       socket may be given (-g<path> or --agent=<path>); otherwise it is taken from\n"
+          "                       the %s environment variable. The agent's own owner auth is used.\n"
           " -v or --verbose       Enable detailed logging.\n"
-          " -h or --help          Help (displays this usage).\n", prog);
+          " -h or --help          Help (displays this usage).\n", prog,
+          KMYTH_MEMFD_ENV, KMYTH_AGENT_SOCK_ENV);
+}
+
+/**
+ * <pre>
+ * Replaces this process with the given command, which inherits the sealed
+ * memfd holding the unsealed data. The descriptor number is passed in the
+ * KMYTH_MEMFD_ENV environment variable.
+ * </pre>
+ *
+ * @param[in]  memfd   the sealed memfd
+ *
+ * @param[in]  command the command and its arguments (NULL terminated)
+ *
+ * @return 1 (only returns if the command could not be run)
+ */
+static int exec_with_memfd(int memfd, char **command)
+{
+  char fd_str[16];
+
+  snprintf(fd_str, sizeof(fd_str), "%d", memfd);
+
+  // the memfd is created close-on-exec so that nothing else inherits it
+  int flags = fcntl(memfd, F_GETFD);
+
+  if (flags < 0 || fcntl(memfd, F_SETFD, flags & ~FD_CLOEXEC) < 0
+      || setenv(KMYTH_MEMFD_ENV, fd_str, 1))
+  {
+    kmyth_log(LOG_ERR, "unable to pass memfd to %s ... exiting", command[0]);
+    close(memfd);
+    return 1;
+  }
+
+  kmyth_log(LOG_DEBUG, "running %s with %s=%s", command[0], KMYTH_MEMFD_ENV,
+            fd_str);
+  execvp(command[0], command);
+
+  kmyth_log(LOG_ERR, "unable to run %s ... exiting", command[0]);
+  close(memfd);
+  return 1;
 }
 
 const struct option longopts[] = {
@@ -37,7 +90,10 @@ const struct option longopts[] = {
   {"output", required_argument, 0, 'o'},
   {"force", no_argument, 0, 'f'},
   {"owner_auth", required_argument, 0, 'w'},
+  {"agent", optional_argument, 0, 'g'},
   {"standard", no_argument, 0, 's'},
+  {"exec", no_argument, 0, 'x'},
+  {"send_fd", required_argument, 0, 'u'},
   {"verbose", no_argument, 0, 'v'},
   {"help", no_argument, 0, 'h'},
   {0, 0, 0, 0}
@@ -64,11 +120,16 @@ int main(int argc, char **argv)
   char *authString = NULL;
   char *ownerAuthPasswd = "";
   bool forceOverwrite = false;
+  bool useAgent = false;
+  char *agentPath = NULL;
+  bool execCommand = false;
+  char *sendFdPath = NULL;
   int options;
   int option_index;
 
-  // Parse and apply command line options
-  while ((options = getopt_long(argc, argv, "a:i:o:w:fhsv", longopts,
+  // Parse and apply command line options (stopping at the first non-option,
+  // so that a command run with -x can have options of its own)
+  while ((options = getopt_long(argc, argv, "+a:i:o:w:g::u:fhsvx", longopts,
                                 &option_index)) != -1)
   {
     switch (options)
@@ -88,6 +149,10 @@ int main(int argc, char **argv)
     case 'w':
       ownerAuthPasswd = optarg;
       break;
+    case 'g':
+      useAgent = true;
+      agentPath = optarg;
+      break;
     case 'v':
       // always display all log messages (severity threshold = LOG_DEBUG)
       // to stdout or stderr (output mode = 0)
@@ -97,6 +162,12 @@ int main(int argc, char **argv)
     case 's':
       stdout_flag = true;
       break;
+    case 'x':
+      execCommand = true;
+      break;
+    case 'u':
+      sendFdPath = optarg;
+      break;
     case 'h':
       usage(argv[0]);
       return 0;
@@ -110,11 +181,17 @@ int main(int argc, char **argv)
   size_t oa_passwd_len =
     (ownerAuthPasswd == NULL) ? 0 : strlen(ownerAuthPasswd);
 
-  // Check that input path (file to be sealed) was specified
-  if (inPath == NULL || (outPath == NULL && stdout_flag == false))
+  // Check that input path (file to be sealed) and exactly one destination
+  // (output file, stdout, a command to exec, or a socket to send to) were
+  // specified
+  int destinations = (outPath != NULL) + (stdout_flag == true)
+    + (execCommand == true) + (sendFdPath != NULL);
+
+  if (inPath == NULL || destinations != 1 || execCommand != (optind < argc))
   {
     kmyth_log(LOG_ERR,
-              "Input file and output file (or stdout) must both be specified ... exiting");
+              "Input file and exactly one of output file, stdout, command "
+              "(-x) or socket (-u) must be specified ... exiting");
     kmyth_clear(authString, auth_string_len);
     kmyth_clear(ownerAuthPasswd, oa_passwd_len);
     return 1;
@@ -130,7 +207,7 @@ int main(int argc, char **argv)
     }
   }
   // If output to be written to file - validate that path
-  if (stdout_flag == false)
+  if (outPath != NULL)
   {
     // Verify output path
     if (verifyOutputFilePath(outPath))
@@ -156,13 +233,33 @@ int main(int argc, char **argv)
     }
   }
 
-  // Call top-level "kmyth-unseal" function
+  // Call top-level "kmyth-unseal" function (or ask kmyth-agent to)
   uint8_t *output = NULL;
   size_t output_length = 0;
+  int result = 0;
 
-  if (tpm2_kmyth_unseal_file(inPath, &output, &output_length,
-                             (uint8_t *) authString, auth_string_len,
-                             (uint8_t *) ownerAuthPasswd, oa_passwd_len))
+  if (useAgent)
+  {
+    uint8_t *ski = NULL;
+    size_t ski_length = 0;
+
+    result = read_bytes_from_file(inPath, &ski, &ski_length);
+    if (result == 0)
+    {
+      result = kmyth_agent_unseal(agentPath, ski, ski_length,
+                                  (uint8_t *) authString, auth_string_len, 0,
+                                  &output, &output_length);
+    }
+    free(ski);
+  }
+  else
+  {
+    result = tpm2_kmyth_unseal_file(inPath, &output, &output_length,
+                                    (uint8_t *) authString, auth_string_len,
+                                    (uint8_t *) ownerAuthPasswd,
+                                    oa_passwd_len);
+  }
+  if (result)
   {
     kmyth_clear_and_free(output, output_length);
     kmyth_log(LOG_ERR, "kmyth-unseal failed ... exiting");
@@ -174,6 +271,51 @@ int main(int argc, char **argv)
   kmyth_clear(authString, auth_string_len);
   kmyth_clear(ownerAuthPasswd, oa_passwd_len);
 
+  // The sealed memfd destinations hand the data over without it ever being
+  // written to a file (or copied through a pipe) on the way
+  if (execCommand || sendFdPath != NULL)
+  {
+    int memfd = -1;
+
+    // fixed name: the memfd name is limited to 249 bytes and is visible in
+    // /proc/<pid>/fd of every process holding it, so don't use inPath
+    result = write_bytes_to_memfd("kmyth-unseal", output, output_length,
+                                  &memfd);
+    kmyth_clear_and_free(output, output_length);
+    if (result)
+    {
+      kmyth_log(LOG_ERR, "unable to create sealed memfd ... exiting");
+      return 1;
+    }
+
+    if (execCommand)
+    {
+      return exec_with_memfd(memfd, argv + optind);
+    }
+
+    int socket_fd = -1;
+
+    if (setup_unix_client_socket(sendFdPath, &socket_fd)
+        || send_socket_fd(socket_fd, memfd))
+    {
+      kmyth_log(LOG_ERR, "unable to send memfd to %s ... exiting",
+                sendFdPath);
+      result = 1;
+    }
+    else
+    {
+      kmyth_log(LOG_DEBUG, "sent unsealed contents of %s to %s", inPath,
+                sendFdPath);
+    }
+    if (socket_fd >= 0)
+    {
+      close(socket_fd);
+    }
+    close(memfd);
+
+    return result;
+  }
+
   if (stdout_flag == true)
   {
     if (print_to_stdout(output, output_length))
@@ -1,23 +1,34 @@
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/uio.h>
 #include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <string.h>
+#include <time.h>
 #include <unistd.h>
 
 #include "defines.h"
+#include "socket_util.h"
 
 //
 // setup_client_socket()
 //
 int setup_client_socket(const char *node, const char *service, int *socket_fd)
 {
-  // Setup socket settings and lookup the target Internet address.
+  // Setup socket settings and lookup the target Internet addresses (both
+  // IPv4 and IPv6, in the resolver's order of preference).
   *socket_fd = -1;
 
   struct addrinfo hints = { 0 };
   struct addrinfo *result = NULL;
-  struct addrinfo *rp = NULL;
 
-  hints.ai_family = AF_INET;
+  hints.ai_family = AF_UNSPEC;
   hints.ai_socktype = SOCK_STREAM;
   hints.ai_flags = 0;
   hints.ai_protocol = 0;
@@ -31,39 +42,262 @@ int setup_client_socket(const char *node, const char *service, int *socket_fd)
     return 1;
   }
 
-  // Scan through the set of possible Internet addresses until we find the
-  // right one.
-  for (rp = result; rp != NULL; rp = rp->ai_next)
+  // Race the possible Internet addresses for the first to connect.
+  int rc = connect_client_socket(result, SOCKET_CONNECT_ATTEMPT_DELAY_MS,
+                                 SOCKET_CONNECT_TIMEOUT_MS, socket_fd);
+
+  // Cleanup address information and handle errors.
+  freeaddrinfo(result);
+  if (rc)
   {
-    *socket_fd = socket(rp->ai_family, rp->ai_socktype, rp->ai_protocol);
-    if (*socket_fd == -1)
+    kmyth_log(LOG_ERR, "Failed to establish socket connection.");
+    return 1;
+  }
+
+  return 0;
+}
+
+//
+// monotonic_ms()
+//
+static long long monotonic_ms(void)
+{
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (long long) now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+//
+// start_connect_attempt()
+//
+// Returns 0 with the connection complete, 1 with the connection in
+// progress, or -1 (with *socket_fd closed) if the attempt failed at once.
+//
+static int start_connect_attempt(const struct addrinfo *addr, int *socket_fd)
+{
+  *socket_fd = socket(addr->ai_family, addr->ai_socktype, addr->ai_protocol);
+  if (*socket_fd == -1)
+  {
+    return -1;
+  }
+
+  int flags = fcntl(*socket_fd, F_GETFL, 0);
+
+  if (flags == -1 || fcntl(*socket_fd, F_SETFL, flags | O_NONBLOCK) == -1)
+  {
+    close(*socket_fd);
+    *socket_fd = -1;
+    return -1;
+  }
+
+  if (connect(*socket_fd, addr->ai_addr, addr->ai_addrlen) == 0)
+  {
+    return 0;
+  }
+  if (errno == EINPROGRESS)
+  {
+    return 1;
+  }
+
+  kmyth_log(LOG_DEBUG, "Connection attempt failed: %s", strerror(errno));
+  close(*socket_fd);
+  *socket_fd = -1;
+  return -1;
+}
+
+//
+// connect_client_socket()
+//
+int connect_client_socket(const struct addrinfo *addrs,
+                          int attempt_delay_ms, int timeout_ms,
+                          int *socket_fd)
+{
+  const struct addrinfo *order[SOCKET_CONNECT_MAX_ADDRS];
+  struct pollfd attempts[SOCKET_CONNECT_MAX_ADDRS];
+  size_t count = 0;
+  size_t next = 0;
+  size_t active = 0;
+  int winner = -1;
+
+  *socket_fd = -1;
+  if (addrs == NULL)
+  {
+    kmyth_log(LOG_ERR, "no addresses to connect to");
+    return 1;
+  }
+
+  // Interleave the address families, starting with the preferred (first)
+  // one, so a broken family only costs one attempt delay.
+  const struct addrinfo *primary = addrs;
+  const struct addrinfo *secondary = addrs;
+
+  while (count < SOCKET_CONNECT_MAX_ADDRS
+         && (primary != NULL || secondary != NULL))
+  {
+    while (primary != NULL && primary->ai_family != addrs->ai_family)
     {
-      // Socket creation failed, try the next address.
+      primary = primary->ai_next;
+    }
+    if (primary != NULL)
+    {
+      order[count++] = primary;
+      primary = primary->ai_next;
+    }
+
+    while (secondary != NULL && secondary->ai_family == addrs->ai_family)
+    {
+      secondary = secondary->ai_next;
+    }
+    if (secondary != NULL && count < SOCKET_CONNECT_MAX_ADDRS)
+    {
+      order[count++] = secondary;
+      secondary = secondary->ai_next;
+    }
+  }
+
+  for (size_t i = 0; i < count; i++)
+  {
+    attempts[i].fd = -1;
+    attempts[i].events = POLLOUT;
+    attempts[i].revents = 0;
+  }
+
+  long long now = monotonic_ms();
+  long long deadline = now + timeout_ms;
+  long long next_start = now;
+
+  while (winner == -1)
+  {
+    now = monotonic_ms();
+    if (now >= deadline)
+    {
+      kmyth_log(LOG_ERR, "Timed out connecting after %d ms.", timeout_ms);
+      break;
+    }
+
+    // Start the next attempt when its turn comes (at once if nothing is
+    // outstanding).
+    if (next < count && (active == 0 || now >= next_start))
+    {
+      int rc = start_connect_attempt(order[next], &attempts[next].fd);
+
+      if (rc == 0)
+      {
+        winner = attempts[next].fd;
+        attempts[next].fd = -1;
+      }
+      else if (rc == 1)
+      {
+        active++;
+        next_start = now + attempt_delay_ms;
+      }
+      else
+      {
+        next_start = now;
+      }
+      next++;
       continue;
     }
-    if (connect(*socket_fd, rp->ai_addr, rp->ai_addrlen) != -1)
+
+    if (active == 0)
     {
-      // Socket connection succeeded, use this socket.
+      // every address has been tried and failed
       break;
     }
-    close(*socket_fd);
+
+    long long wait_until = deadline;
+
+    if (next < count && next_start < wait_until)
+    {
+      wait_until = next_start;
+    }
+
+    int ready = poll(attempts, count, (int) (wait_until - now));
+
+    if (ready < 0)
+    {
+      if (errno == EINTR)
+      {
+        continue;
+      }
+      kmyth_log(LOG_ERR, "Failed to wait for connection: %s",
+                strerror(errno));
+      break;
+    }
+
+    for (size_t i = 0; i < count && ready > 0; i++)
+    {
+      if (attempts[i].fd == -1 || attempts[i].revents == 0)
+      {
+        continue;
+      }
+      ready--;
+
+      int error = 0;
+      socklen_t error_len = sizeof(error);
+
+      if (getsockopt(attempts[i].fd, SOL_SOCKET, SO_ERROR,
+                     &error, &error_len) == 0 && error == 0)
+      {
+        winner = attempts[i].fd;
+        attempts[i].fd = -1;
+        break;
+      }
+
+      // This attempt failed, so start the next one without waiting.
+      kmyth_log(LOG_DEBUG, "Connection attempt failed: %s",
+                strerror(error));
+      close(attempts[i].fd);
+      attempts[i].fd = -1;
+      active--;
+      next_start = now;
+    }
   }
 
-  // Cleanup address information and handle errors.
-  freeaddrinfo(result);
-  if (rp == NULL)
+  // Abandon the attempts that lost the race.
+  for (size_t i = 0; i < count; i++)
+  {
+    if (attempts[i].fd != -1)
+    {
+      close(attempts[i].fd);
+    }
+  }
+
+  if (winner == -1)
   {
-    kmyth_log(LOG_ERR, "Failed to establish socket connection.");
     return 1;
   }
 
+  // Callers expect a blocking socket.
+  int flags = fcntl(winner, F_GETFL, 0);
+
+  if (flags == -1 || fcntl(winner, F_SETFL, flags & ~O_NONBLOCK) == -1)
+  {
+    kmyth_log(LOG_ERR, "Failed to restore blocking mode: %s",
+              strerror(errno));
+    close(winner);
+    return 1;
+  }
+
+  // Kmyth's exchanges are small request/response messages.
+  int optval = 1;
+
+  if (setsockopt(winner, IPPROTO_TCP, TCP_NODELAY, &optval, sizeof(optval)))
+  {
+    kmyth_log(LOG_WARNING, "Failed to set TCP_NODELAY: %s", strerror(errno));
+  }
+
+  *socket_fd = winner;
+
   return 0;
 }
 
 //
-// setup_server_socket()
+// setup_server_socket_on()
 //
-int setup_server_socket(const char *service, int *socket_fd)
+int setup_server_socket_on(const char *node, const char *service,
+                           int *socket_fd)
 {
   struct addrinfo hints = { 0 };
   struct addrinfo *result = NULL;
@@ -81,7 +315,7 @@ int setup_server_socket(const char *service, int *socket_fd)
   hints.ai_addr = NULL;
   hints.ai_next = NULL;
 
-  int s = getaddrinfo(NULL, service, &hints, &result);
+  int s = getaddrinfo(node, service, &hints, &result);
 
   if (s != 0)
   {
@@ -127,3 +361,311 @@ int setup_server_socket(const char *service, int *socket_fd)
 
   return 0;
 }
+
+//
+// setup_server_socket()
+//
+int setup_server_socket(const char *service, int *socket_fd)
+{
+  return setup_server_socket_on(NULL, service, socket_fd);
+}
+
+//
+// set_unix_address()
+//
+static int set_unix_address(const char *path, struct sockaddr_un *addr)
+{
+  if (path == NULL || strlen(path) == 0
+      || strlen(path) >= sizeof(addr->sun_path))
+  {
+    kmyth_log(LOG_ERR, "invalid Unix domain socket path");
+    return 1;
+  }
+
+  memset(addr, 0, sizeof(struct sockaddr_un));
+  addr->sun_family = AF_UNIX;
+  strncpy(addr->sun_path, path, sizeof(addr->sun_path) - 1);
+
+  return 0;
+}
+
+//
+// setup_unix_server_socket()
+//
+int setup_unix_server_socket(const char *path, int *socket_fd)
+{
+  struct sockaddr_un addr;
+
+  *socket_fd = -1;
+  if (set_unix_address(path, &addr))
+  {
+    return 1;
+  }
+
+  *socket_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (*socket_fd == -1)
+  {
+    kmyth_log(LOG_ERR, "Failed to create Unix domain socket.");
+    return 1;
+  }
+
+  // Replace a stale socket left behind by a previous server, and create the
+  // new one without group/other permissions from the start.
+  unlink(path);
+
+  mode_t old_mask = umask(S_IRWXG | S_IRWXO);
+  int rc = bind(*socket_fd, (struct sockaddr *) &addr, sizeof(addr));
+
+  umask(old_mask);
+  if (rc != 0)
+  {
+    kmyth_log(LOG_ERR, "Failed to bind Unix domain socket (%s).", path);
+    close(*socket_fd);
+    *socket_fd = -1;
+    return 1;
+  }
+
+  if (listen(*socket_fd, SOMAXCONN))
+  {
+    kmyth_log(LOG_ERR, "Failed to listen on Unix domain socket (%s).", path);
+    close(*socket_fd);
+    *socket_fd = -1;
+    unlink(path);
+    return 1;
+  }
+
+  return 0;
+}
+
+//
+// setup_unix_client_socket()
+//
+int setup_unix_client_socket(const char *path, int *socket_fd)
+{
+  struct sockaddr_un addr;
+
+  *socket_fd = -1;
+  if (set_unix_address(path, &addr))
+  {
+    return 1;
+  }
+
+  *socket_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (*socket_fd == -1)
+  {
+    kmyth_log(LOG_ERR, "Failed to create Unix domain socket.");
+    return 1;
+  }
+
+  if (connect(*socket_fd, (struct sockaddr *) &addr, sizeof(addr)))
+  {
+    kmyth_log(LOG_ERR, "Failed to connect to Unix domain socket (%s).",
+              path);
+    close(*socket_fd);
+    *socket_fd = -1;
+    return 1;
+  }
+
+  return 0;
+}
+
+//
+// send_socket_fd()
+//
+int send_socket_fd(int socket_fd, int fd)
+{
+  // one byte of ordinary data carries the control message
+  char data = 0;
+  struct iovec iov = {.iov_base = &data,.iov_len = 1 };
+  union
+  {
+    char buf[CMSG_SPACE(sizeof(int))];
+    struct cmsghdr align;
+  } control;
+  struct msghdr msg = { 0 };
+
+  memset(&control, 0, sizeof(control));
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control.buf;
+  msg.msg_controllen = sizeof(control.buf);
+
+  struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type = SCM_RIGHTS;
+  cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+  memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+
+  if (sendmsg(socket_fd, &msg, MSG_NOSIGNAL) != 1)
+  {
+    kmyth_log(LOG_ERR, "Failed to pass file descriptor over socket.");
+    return 1;
+  }
+
+  return 0;
+}
+
+//
+// recv_socket_fd()
+//
+int recv_socket_fd(int socket_fd, int *fd)
+{
+  char data = 0;
+  struct iovec iov = {.iov_base = &data,.iov_len = 1 };
+  union
+  {
+    char buf[CMSG_SPACE(sizeof(int))];
+    struct cmsghdr align;
+  } control;
+  struct msghdr msg = { 0 };
+
+  *fd = -1;
+  memset(&control, 0, sizeof(control));
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control.buf;
+  msg.msg_controllen = sizeof(control.buf);
+
+  if (recvmsg(socket_fd, &msg, MSG_CMSG_CLOEXEC) != 1)
+  {
+    kmyth_log(LOG_ERR, "Failed to receive file descriptor over socket.");
+    return 1;
+  }
+
+  struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+
+  if (cmsg == NULL || (msg.msg_flags & MSG_CTRUNC)
+      || cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS
+      || cmsg->cmsg_len != CMSG_LEN(sizeof(int)))
+  {
+    kmyth_log(LOG_ERR, "No file descriptor received over socket.");
+    return 1;
+  }
+  memcpy(fd, CMSG_DATA(cmsg), sizeof(int));
+
+  return 0;
+}
+
+//
+// send_socket_frame()
+//
+int send_socket_frame(int socket_fd, const struct iovec *iov, int iovcnt)
+{
+  struct iovec pending[SOCKET_FRAME_MAX_IOV];
+  struct msghdr msg = { 0 };
+  size_t remaining = 0;
+
+  if (iov == NULL || iovcnt <= 0 || iovcnt > SOCKET_FRAME_MAX_IOV)
+  {
+    kmyth_log(LOG_ERR, "invalid socket frame");
+    return 1;
+  }
+
+  // work on a copy, advanced past whatever each call manages to send
+  memcpy(pending, iov, iovcnt * sizeof(struct iovec));
+  for (int i = 0; i < iovcnt; i++)
+  {
+    remaining += pending[i].iov_len;
+  }
+  msg.msg_iov = pending;
+  msg.msg_iovlen = iovcnt;
+
+  while (remaining > 0)
+  {
+    ssize_t sent = sendmsg(socket_fd, &msg, MSG_NOSIGNAL);
+
+    if (sent < 0)
+    {
+      if (errno == EINTR)
+      {
+        continue;
+      }
+      kmyth_log(LOG_ERR, "Failed to send a message: %s", strerror(errno));
+      return 1;
+    }
+    remaining -= sent;
+
+    while (msg.msg_iovlen > 0 && (size_t) sent >= msg.msg_iov->iov_len)
+    {
+      sent -= msg.msg_iov->iov_len;
+      msg.msg_iov++;
+      msg.msg_iovlen--;
+    }
+    if (sent > 0)
+    {
+      msg.msg_iov->iov_base = (char *) msg.msg_iov->iov_base + sent;
+      msg.msg_iov->iov_len -= sent;
+    }
+  }
+
+  return 0;
+}
+
+//
+// recv_socket_exact()
+//
+int recv_socket_exact(int socket_fd, void *buf, size_t len)
+{
+  unsigned char *next = buf;
+
+  while (len > 0)
+  {
+    ssize_t received = recv(socket_fd, next, len, 0);
+
+    if (received < 0)
+    {
+      if (errno == EINTR)
+      {
+        continue;
+      }
+      kmyth_log(LOG_ERR, "Failed to receive a message: %s", strerror(errno));
+      return 1;
+    }
+    if (received == 0)
+    {
+      // a close between messages is how a peer ends the conversation
+      if (next == (unsigned char *) buf)
+      {
+        kmyth_log(LOG_DEBUG, "Connection closed by the peer.");
+      }
+      else
+      {
+        kmyth_log(LOG_ERR,
+                  "Connection closed before the message was received.");
+      }
+      return 1;
+    }
+    next += received;
+    len -= received;
+  }
+
+  return 0;
+}
+
+//
+// set_socket_tcp_options()
+//
+int set_socket_tcp_options(int socket_fd, int nodelay, int quickack)
+{
+  int optval = (nodelay != 0);
+
+  if (setsockopt(socket_fd, IPPROTO_TCP, TCP_NODELAY,
+                 &optval, sizeof(optval)))
+  {
+    kmyth_log(LOG_ERR, "Failed to set TCP_NODELAY: %s", strerror(errno));
+    return 1;
+  }
+
+#ifdef TCP_QUICKACK
+  optval = (quickack != 0);
+  if (setsockopt(socket_fd, IPPROTO_TCP, TCP_QUICKACK,
+                 &optval, sizeof(optval)))
+  {
+    kmyth_log(LOG_ERR, "Failed to set TCP_QUICKACK: %s", strerror(errno));
+    return 1;
+  }
+#endif
+
+  return 0;
+}
@@ -6,17 +6,26 @@
 
 #include "tls_util.h"
 
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <time.h>
+#include <unistd.h>
 
 #include <kmip/kmip.h>
 #include <kmip/kmip_bio.h>
 #include <openssl/bio.h>
 #include <openssl/err.h>
+#include <openssl/pem.h>
 #include <openssl/ssl.h>
 #include <openssl/x509v3.h>
 
 #include "defines.h"
+#include "kmip_util.h"
 #include "memory_util.h"
+#include "socket_util.h"
 
 // Check for supported OpenSSL version
 //   - OpenSSL v1.1.1 is a LTS version supported until 2023-09-11
@@ -44,15 +53,17 @@ const char *PREFERRED_CIPHERS = "ECDHE-ECDSA-AES256-GCM-SHA384:"
  *
  * @param[in]  ctx         the context to use
  *
+ * @param[in]  session     a previous session to offer the server for
+ *                         resumption (may be NULL)
+ *
  * @param[out] ssl_bio     the BIO structure used to interface with the
  *                         connection
  *
- * @param[in]  verbose     if true, print extra debugging messages
- *
  * @return 0 on success, 1 on error
  */
 static int tls_ctx_connect(char *server_ip, char *server_port,
-                           SSL_CTX * ctx, BIO ** ssl_bio)
+                           SSL_CTX * ctx, SSL_SESSION * session,
+                           BIO ** ssl_bio)
 {
   if (server_ip == NULL)
   {
@@ -75,7 +86,7 @@ static int tls_ctx_connect(char *server_ip, char *server_port,
     return 1;
   }
 
-  *ssl_bio = BIO_new_ssl_connect(ctx);
+  *ssl_bio = BIO_new_ssl(ctx, 1);
   if (*ssl_bio == NULL)
   {
     kmyth_log(LOG_ERR, "error getting new BIO chain: %s ... exiting",
@@ -91,18 +102,29 @@ static int tls_ctx_connect(char *server_ip, char *server_port,
               ERR_error_string(ERR_get_error(), NULL));
     return 1;
   }
-  if (BIO_set_conn_address(*ssl_bio, server_ip) != 1)
+
+  // initiate IP socket connection with the server
+  //   - setup_client_socket() races all of the server's addresses under an
+  //     overall deadline (a connect BIO would block on each in turn), and
+  //     the TLS BIO is then layered over the connected socket
+  int socket_fd = -1;
+
+  if (setup_client_socket(server_ip, server_port, &socket_fd))
   {
-    kmyth_log(LOG_ERR, "error setting connection address: %s ... exiting",
-              ERR_error_string(ERR_get_error(), NULL));
+    kmyth_log(LOG_ERR, "TCP/IP socket connection error ... exiting");
     return 1;
   }
-  if (BIO_set_conn_port(*ssl_bio, server_port) != 1)
+
+  BIO *socket_bio = BIO_new_socket(socket_fd, BIO_CLOSE);
+
+  if (socket_bio == NULL)
   {
-    kmyth_log(LOG_ERR, "error setting connection port: %s ... exiting",
+    kmyth_log(LOG_ERR, "error getting new socket BIO: %s ... exiting",
               ERR_error_string(ERR_get_error(), NULL));
+    close(socket_fd);
     return 1;
   }
+  BIO_push(*ssl_bio, socket_bio);
 
   // set the list of ciphers available for negotiation with the server
   if (SSL_set_cipher_list(ssl, PREFERRED_CIPHERS) != 1)
@@ -112,6 +134,14 @@ static int tls_ctx_connect(char *server_ip, char *server_port,
     return 1;
   }
 
+  // offer the cached session (the server falls back to a full handshake
+  // if it will not resume it)
+  if (session != NULL && SSL_set_session(ssl, session) != 1)
+  {
+    kmyth_log(LOG_WARNING, "unable to offer cached TLS session: %s",
+              ERR_error_string(ERR_get_error(), NULL));
+  }
+
   // verify server's X509 certificate
   X509 *cert = SSL_get_peer_certificate(ssl);
 
@@ -126,13 +156,6 @@ static int tls_ctx_connect(char *server_ip, char *server_port,
     X509_free(cert);
   }
 
-  // initiate IP socket connection with the server
-  if (BIO_do_connect(*ssl_bio) <= 0)
-  {
-    kmyth_log(LOG_ERR, "TCP/IP socket connection error ... exiting");
-    return 1;
-  }
-
   // initiate SSL/TLS handshake with the server
   if (BIO_do_handshake(*ssl_bio) <= 0)
   {
@@ -140,6 +163,12 @@ static int tls_ctx_connect(char *server_ip, char *server_port,
     return 1;
   }
 
+  if (session != NULL)
+  {
+    kmyth_log(LOG_DEBUG, "TLS session %s",
+              SSL_session_reused(ssl) ? "resumed" : "not resumed");
+  }
+
   return 0;
 }
 
@@ -151,6 +180,24 @@ int create_tls_connection(char **server_ip,
                           size_t client_private_key_len,
                           char *client_cert_path, char *ca_cert_path,
                           BIO ** tls_bio, SSL_CTX ** tls_ctx)
+{
+  return create_tls_connection_with_session(server_ip,
+                                            client_private_key,
+                                            client_private_key_len,
+                                            client_cert_path, ca_cert_path,
+                                            NULL, tls_bio, tls_ctx);
+}
+
+//############################################################################
+// create_tls_connection_with_session()
+//############################################################################
+int create_tls_connection_with_session(char **server_ip,
+                                       unsigned char *client_private_key,
+                                       size_t client_private_key_len,
+                                       char *client_cert_path,
+                                       char *ca_cert_path,
+                                       SSL_SESSION * session,
+                                       BIO ** tls_bio, SSL_CTX ** tls_ctx)
 {
   if (server_ip == NULL)
   {
@@ -212,7 +259,8 @@ int create_tls_connection(char **server_ip,
     return 1;
   }
 
-  if (tls_ctx_connect(*server_ip, server_port, *tls_ctx, tls_bio) != 0)
+  if (tls_ctx_connect(*server_ip, server_port, *tls_ctx, session, tls_bio)
+      != 0)
   {
     kmyth_log(LOG_ERR, "error connecting to server ... exiting");
     return 1;
@@ -385,6 +433,156 @@ int tls_set_context(unsigned char *client_private_key,
   return 0;
 }
 
+//############################################################################
+// tls_read_session()
+//############################################################################
+int tls_read_session(char *session_path, SSL_SESSION ** session)
+{
+  if (session_path == NULL || session == NULL)
+  {
+    kmyth_log(LOG_ERR, "no TLS session path or variable ... exiting");
+    return 1;
+  }
+  *session = NULL;
+
+  // no cached session yet is not an error (a full handshake is done)
+  if (access(session_path, F_OK) != 0)
+  {
+    kmyth_log(LOG_DEBUG, "no cached TLS session (%s)", session_path);
+    return 0;
+  }
+
+  BIO *file_bio = BIO_new_file(session_path, "r");
+
+  if (file_bio == NULL)
+  {
+    kmyth_log(LOG_ERR, "unable to open TLS session file %s ... exiting",
+              session_path);
+    return 1;
+  }
+  *session = PEM_read_bio_SSL_SESSION(file_bio, NULL, NULL, NULL);
+  BIO_free(file_bio);
+  if (*session == NULL)
+  {
+    kmyth_log(LOG_ERR, "invalid TLS session file %s: %s ... exiting",
+              session_path, ERR_error_string(ERR_get_error(), NULL));
+    return 1;
+  }
+
+  // an expired ticket would only be refused by the server
+  if (SSL_SESSION_get_time(*session) + SSL_SESSION_get_timeout(*session)
+      < (long) time(NULL))
+  {
+    kmyth_log(LOG_DEBUG, "cached TLS session (%s) has expired",
+              session_path);
+    SSL_SESSION_free(*session);
+    *session = NULL;
+  }
+
+  return 0;
+}
+
+//############################################################################
+// tls_write_session()
+//############################################################################
+int tls_write_session(BIO * tls_bio, char *session_path)
+{
+  if (tls_bio == NULL || session_path == NULL)
+  {
+    kmyth_log(LOG_ERR, "no TLS BIO or session path ... exiting");
+    return 1;
+  }
+
+  SSL *ssl = NULL;
+
+  if (BIO_get_ssl(tls_bio, &ssl) <= 0 || ssl == NULL)
+  {
+    kmyth_log(LOG_ERR, "error retrieving the BIO SSL pointer ... exiting");
+    return 1;
+  }
+
+  // with TLS 1.3 this is the most recent ticket the server sent (tickets
+  // arrive after the handshake, so this is called after the exchanges)
+  SSL_SESSION *session = SSL_get1_session(ssl);
+
+  if (session == NULL || !SSL_SESSION_is_resumable(session))
+  {
+    kmyth_log(LOG_DEBUG, "server provided no resumable TLS session");
+    SSL_SESSION_free(session);
+    return 0;
+  }
+
+  // the session holds a resumption secret, so only the owner may read it:
+  // write it to a new file (mkstemp() creates it with O_EXCL and mode
+  // 0600) and rename that into place, rather than reusing an existing
+  // file that may have a more permissive mode
+  char *temp_path = NULL;
+  int fd = -1;
+
+  if (asprintf(&temp_path, "%s.XXXXXX", session_path) < 0)
+  {
+    temp_path = NULL;
+  }
+  else
+  {
+    fd = mkstemp(temp_path);
+  }
+
+  FILE *fp = (fd < 0) ? NULL : fdopen(fd, "w");
+
+  if (fp == NULL)
+  {
+    kmyth_log(LOG_ERR, "unable to write TLS session file %s: %s ... exiting",
+              session_path, strerror(errno));
+    if (fd >= 0)
+    {
+      close(fd);
+      unlink(temp_path);
+    }
+    free(temp_path);
+    SSL_SESSION_free(session);
+    return 1;
+  }
+
+  int written = PEM_write_SSL_SESSION(fp, session);
+
+  SSL_SESSION_free(session);
+  if (fclose(fp) != 0 || written != 1 || rename(temp_path, session_path))
+  {
+    kmyth_log(LOG_ERR, "error writing TLS session file %s ... exiting",
+              session_path);
+    unlink(temp_path);
+    free(temp_path);
+    return 1;
+  }
+  free(temp_path);
+  kmyth_log(LOG_DEBUG, "cached TLS session in %s", session_path);
+
+  return 0;
+}
+
+//############################################################################
+// tls_read_exact()
+//############################################################################
+int tls_read_exact(BIO * bio, unsigned char *buf, size_t len)
+{
+  size_t received = 0;
+
+  while (received < len)
+  {
+    int chunk = (len - received > INT_MAX) ? INT_MAX : (int) (len - received);
+    int result = BIO_read(bio, buf + received, chunk);
+
+    if (result <= 0)
+    {
+      return 1;
+    }
+    received += (size_t) result;
+  }
+
+  return 0;
+}
+
 //############################################################################
 // get_key_from_tls_server()
 //############################################################################
@@ -410,40 +608,113 @@ int get_key_from_tls_server(BIO * bio,
     if (BIO_flush(bio) != 1)
       kmyth_log(LOG_ERR, "error flushing server message BIO");
   }
-  size_t buf_size = KMYTH_GETKEY_RX_BUFFER_SIZE;
-  char *buf = calloc(buf_size, sizeof(char));
 
-  if (buf == NULL)
+  // the response is read directly into the returned (arena) buffer, which
+  // is released, whole, by kmyth_clear_and_free()
+  *key = kmyth_secure_alloc(KMYTH_GETKEY_RX_BUFFER_SIZE);
+  if (*key == NULL)
   {
     kmyth_log(LOG_ERR,
               "error allocating memory for server response ... exiting");
     return 1;
   }
 
-  int recv = BIO_read(bio, buf, buf_size);
+  int recv = BIO_read(bio, *key, KMYTH_GETKEY_RX_BUFFER_SIZE);
 
   if (0 >= recv)
   {
     kmyth_log(LOG_ERR, "no data received: %s ... exiting",
               ERR_error_string(ERR_get_error(), NULL));
-    free(buf);
+    kmyth_clear_and_free(*key, KMYTH_GETKEY_RX_BUFFER_SIZE);
+    *key = NULL;
     return 1;
   }
 
   *key_size = recv;
 
-  (*key) = malloc(recv);
-  if (*key == NULL)
+  return 0;
+}
+
+//############################################################################
+// get_framed_key_from_tls_server()
+//############################################################################
+int get_framed_key_from_tls_server(BIO * bio,
+                                   char *message, size_t message_length,
+                                   unsigned char **key, size_t * key_size)
+{
+  // validate input
+  if (bio == NULL || key == NULL || key_size == NULL)
+  {
+    kmyth_log(LOG_ERR, "no valid BIO object or key variables ... exiting");
+    return 1;
+  }
+  if (message == NULL && message_length > 0)
+  {
+    kmyth_log(LOG_ERR, "no message to send ... exiting");
+    return 1;
+  }
+  if (message_length > KMYTH_GETKEY_MAX_FRAME_SIZE)
+  {
+    kmyth_log(LOG_ERR, "message length (%zu bytes) exceeds maximum (%d bytes)"
+              " ... exiting", message_length, KMYTH_GETKEY_MAX_FRAME_SIZE);
+    return 1;
+  }
+
+  // write the (possibly empty) message to the server, after its length
+  unsigned char prefix[4] = {
+    (unsigned char) (message_length >> 24),
+    (unsigned char) (message_length >> 16),
+    (unsigned char) (message_length >> 8),
+    (unsigned char) message_length
+  };
+
+  if (BIO_write(bio, prefix, sizeof(prefix)) != sizeof(prefix)
+      || (message_length > 0
+          && BIO_write(bio, message, (int) message_length)
+          != (int) message_length))
+  {
+    kmyth_log(LOG_ERR, "error writing message to server ... exiting");
+    return 1;
+  }
+  if (BIO_flush(bio) != 1)
+    kmyth_log(LOG_ERR, "error flushing server message BIO");
+
+  // read the announced length, then exactly that many bytes (across as
+  // many TLS records as it takes) into a right-sized secure buffer
+  if (tls_read_exact(bio, prefix, sizeof(prefix)))
   {
-    kmyth_log(LOG_ERR, "error allocating fresh memory for key ... exiting");
-    buf = secure_memset(buf, 0, buf_size);
-    free(buf);
+    kmyth_log(LOG_ERR, "no response length received: %s ... exiting",
+              ERR_error_string(ERR_get_error(), NULL));
     return 1;
   }
-  memcpy((*key), buf, recv);
 
-  buf = secure_memset(buf, 0, buf_size);
-  free(buf);
+  size_t response_len = ((size_t) prefix[0] << 24)
+    | ((size_t) prefix[1] << 16) | ((size_t) prefix[2] << 8)
+    | (size_t) prefix[3];
+
+  if (response_len == 0 || response_len > KMYTH_GETKEY_MAX_FRAME_SIZE)
+  {
+    kmyth_log(LOG_ERR, "invalid response length (%zu bytes) ... exiting",
+              response_len);
+    return 1;
+  }
+
+  *key = kmyth_secure_alloc(response_len);
+  if (*key == NULL)
+  {
+    kmyth_log(LOG_ERR,
+              "error allocating memory for server response ... exiting");
+    return 1;
+  }
+  if (tls_read_exact(bio, *key, response_len))
+  {
+    kmyth_log(LOG_ERR, "incomplete response received: %s ... exiting",
+              ERR_error_string(ERR_get_error(), NULL));
+    kmyth_clear_and_free(*key, response_len);
+    *key = NULL;
+    return 1;
+  }
+  *key_size = response_len;
 
   return 0;
 }
@@ -503,3 +774,128 @@ int get_key_from_kmip_server(BIO * bio,
   kmip_destroy(&kmip_context);
   return 0;
 }
+
+//############################################################################
+// get_keys_from_kmip_server()
+//############################################################################
+int get_keys_from_kmip_server(BIO * bio,
+                              char **key_ids, size_t key_count,
+                              unsigned char **keys, size_t *key_sizes)
+{
+  // validate input
+  if (bio == NULL || key_ids == NULL || keys == NULL || key_sizes == NULL)
+  {
+    kmyth_log(LOG_ERR, "no valid BIO object or key lists ... exiting");
+    return 1;
+  }
+
+  size_t *id_lens = calloc(key_count, sizeof(size_t));
+
+  if (id_lens == NULL)
+  {
+    kmyth_log(LOG_ERR, "error allocating key ID lengths ... exiting");
+    return 1;
+  }
+  for (size_t i = 0; i < key_count; i++)
+  {
+    id_lens[i] = strlen(key_ids[i]);
+  }
+
+  KMIP kmip_context = { 0 };
+  kmip_init(&kmip_context, NULL, 0, KMIP_1_0);
+
+  // the whole key set comes back in one response message
+  kmip_context.max_message_size = KMIP_ENCODING_MAX_SIZE;
+
+  // one message carries a Get for every key ID
+  unsigned char *buffer = NULL;
+  size_t buffer_size = 0;
+  size_t request_len = 0;
+
+  if (build_kmip_get_batch_request(&kmip_context,
+                                   (unsigned char **) key_ids, id_lens,
+                                   key_count, &buffer, &buffer_size,
+                                   &request_len))
+  {
+    kmyth_log(LOG_ERR, "error building KMIP batch request ... exiting");
+    kmyth_clear_and_free(buffer, buffer_size);
+    kmip_destroy(&kmip_context);
+    free(id_lens);
+    return 1;
+  }
+
+  if (request_len > INT_MAX
+      || BIO_write(bio, buffer, (int) request_len) != (int) request_len)
+  {
+    kmyth_log(LOG_ERR, "error writing KMIP request to server ... exiting");
+    kmyth_clear_and_free(buffer, buffer_size);
+    kmip_destroy(&kmip_context);
+    free(id_lens);
+    return 1;
+  }
+  if (BIO_flush(bio) != 1)
+    kmyth_log(LOG_ERR, "error flushing server message BIO");
+  kmyth_clear_and_free(buffer, buffer_size);
+
+  // the response is a single TTLV item: 8 header bytes (tag, type, and a
+  // big-endian length) followed by the encoded value
+  unsigned char header[8] = { 0 };
+
+  if (tls_read_exact(bio, header, sizeof(header)))
+  {
+    kmyth_log(LOG_ERR, "no KMIP response received: %s ... exiting",
+              ERR_error_string(ERR_get_error(), NULL));
+    kmip_destroy(&kmip_context);
+    free(id_lens);
+    return 1;
+  }
+
+  size_t value_len = ((size_t) header[4] << 24) | ((size_t) header[5] << 16)
+    | ((size_t) header[6] << 8) | (size_t) header[7];
+  size_t response_len = sizeof(header) + value_len;
+
+  if (response_len > (size_t) kmip_context.max_message_size)
+  {
+    kmyth_log(LOG_ERR, "KMIP response too large (%zu bytes) ... exiting",
+              response_len);
+    kmip_destroy(&kmip_context);
+    free(id_lens);
+    return 1;
+  }
+
+  unsigned char *response = kmyth_secure_alloc(response_len);
+
+  if (response == NULL)
+  {
+    kmyth_log(LOG_ERR, "error allocating KMIP response buffer ... exiting");
+    kmip_destroy(&kmip_context);
+    free(id_lens);
+    return 1;
+  }
+  memcpy(response, header, sizeof(header));
+  if (tls_read_exact(bio, response + sizeof(header), value_len))
+  {
+    kmyth_log(LOG_ERR, "incomplete KMIP response received ... exiting");
+    kmyth_clear_and_free(response, response_len);
+    kmip_destroy(&kmip_context);
+    free(id_lens);
+    return 1;
+  }
+
+  int result = parse_kmip_get_batch_response(&kmip_context,
+                                             response, response_len,
+                                             (unsigned char **) key_ids,
+                                             id_lens, key_count,
+                                             keys, key_sizes);
+
+  if (result)
+  {
+    kmyth_log(LOG_ERR, "error retrieving keys from KMIP server");
+  }
+
+  kmyth_clear_and_free(response, response_len);
+  kmip_destroy(&kmip_context);
+  free(id_lens);
+
+  return result;
+}
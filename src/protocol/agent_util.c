@@ -0,0 +1,310 @@
+/**
+ * @file  agent_util.c
+ *
+ * @brief Implements the kmyth-agent message formats and client functions.
+ */
+
+#include "agent_util.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sys/socket.h>
+
+#include "defines.h"
+#include "memory_util.h"
+#include "socket_util.h"
+
+//
+// store_be32()
+//
+static void store_be32(uint8_t * dest, uint32_t value)
+{
+  dest[0] = (uint8_t) (value >> 24);
+  dest[1] = (uint8_t) (value >> 16);
+  dest[2] = (uint8_t) (value >> 8);
+  dest[3] = (uint8_t) value;
+}
+
+//
+// load_be32()
+//
+static uint32_t load_be32(uint8_t * src)
+{
+  return ((uint32_t) src[0] << 24) | ((uint32_t) src[1] << 16)
+    | ((uint32_t) src[2] << 8) | (uint32_t) src[3];
+}
+
+//
+// send_agent_message()
+//
+int send_agent_message(int socket_fd, uint8_t type,
+                       uint8_t * payload, size_t payload_len)
+{
+  if (payload_len > KMYTH_AGENT_MAX_PAYLOAD_LEN
+      || (payload == NULL && payload_len > 0))
+  {
+    kmyth_log(LOG_ERR, "invalid agent message payload");
+    return 1;
+  }
+
+  uint8_t header[KMYTH_AGENT_HEADER_LEN];
+
+  header[0] = KMYTH_AGENT_PROTOCOL_VERSION;
+  header[1] = type;
+  store_be32(header + 2, (uint32_t) payload_len);
+
+  // the header and payload leave together, in one call where possible
+  struct iovec iov[2] = {
+    {.iov_base = header,.iov_len = sizeof(header)},
+    {.iov_base = payload,.iov_len = payload_len}
+  };
+
+  if (send_socket_frame(socket_fd, iov, (payload_len > 0) ? 2 : 1))
+  {
+    kmyth_log(LOG_ERR, "failed to send agent message");
+    return 1;
+  }
+
+  return 0;
+}
+
+//
+// recv_agent_message()
+//
+int recv_agent_message(int socket_fd, uint8_t * type,
+                       uint8_t ** payload, size_t *payload_len)
+{
+  uint8_t header[KMYTH_AGENT_HEADER_LEN];
+
+  *payload = NULL;
+  *payload_len = 0;
+
+  if (recv_socket_exact(socket_fd, header, sizeof(header)))
+  {
+    // the peer closing the connection between messages is not an error
+    return 1;
+  }
+
+  if (header[0] != KMYTH_AGENT_PROTOCOL_VERSION)
+  {
+    kmyth_log(LOG_ERR, "unsupported agent protocol version (%u)", header[0]);
+    return 1;
+  }
+
+  size_t len = load_be32(header + 2);
+
+  if (len > KMYTH_AGENT_MAX_PAYLOAD_LEN)
+  {
+    kmyth_log(LOG_ERR, "agent message payload too large (%zu bytes)", len);
+    return 1;
+  }
+
+  // payloads carry authorization strings and unsealed data, so they are
+  // held in the secure arena (locked, excluded from core dumps)
+  if (len > 0)
+  {
+    *payload = kmyth_secure_alloc(len);
+    if (*payload == NULL)
+    {
+      kmyth_log(LOG_ERR, "unable to allocate agent message payload");
+      return 1;
+    }
+    if (recv_socket_exact(socket_fd, *payload, len))
+    {
+      kmyth_log(LOG_ERR, "failed to receive agent message payload");
+      kmyth_clear_and_free(*payload, len);
+      *payload = NULL;
+      return 1;
+    }
+  }
+
+  *type = header[1];
+  *payload_len = len;
+
+  return 0;
+}
+
+//
+// build_agent_unseal_request()
+//
+int build_agent_unseal_request(uint8_t * ski, size_t ski_len,
+                               uint8_t * auth, size_t auth_len,
+                               uint32_t ttl,
+                               uint8_t ** request, size_t *request_len)
+{
+  if (ski == NULL || ski_len == 0 || (auth == NULL && auth_len > 0))
+  {
+    kmyth_log(LOG_ERR, "invalid agent unseal request parameters");
+    return 1;
+  }
+  if (ski_len > KMYTH_AGENT_MAX_PAYLOAD_LEN
+      || auth_len > KMYTH_AGENT_MAX_PAYLOAD_LEN - 8 - ski_len)
+  {
+    kmyth_log(LOG_ERR, "agent unseal request too large");
+    return 1;
+  }
+
+  *request_len = 8 + auth_len + ski_len;
+  *request = malloc(*request_len);
+  if (*request == NULL)
+  {
+    kmyth_log(LOG_ERR, "unable to allocate agent unseal request");
+    *request_len = 0;
+    return 1;
+  }
+
+  store_be32(*request, ttl);
+  store_be32(*request + 4, (uint32_t) auth_len);
+  if (auth_len > 0)
+  {
+    memcpy(*request + 8, auth, auth_len);
+  }
+  memcpy(*request + 8 + auth_len, ski, ski_len);
+
+  return 0;
+}
+
+//
+// parse_agent_unseal_request()
+//
+int parse_agent_unseal_request(uint8_t * request, size_t request_len,
+                               uint8_t ** ski, size_t *ski_len,
+                               uint8_t ** auth, size_t *auth_len,
+                               uint32_t * ttl)
+{
+  if (request == NULL || request_len < 8)
+  {
+    kmyth_log(LOG_ERR, "agent unseal request too short");
+    return 1;
+  }
+
+  size_t len = load_be32(request + 4);
+
+  // the .ski that follows the authorization string must not be empty
+  if (len >= request_len - 8)
+  {
+    kmyth_log(LOG_ERR, "invalid agent unseal request lengths");
+    return 1;
+  }
+
+  *ttl = load_be32(request);
+  *auth_len = len;
+  *auth = (len > 0) ? request + 8 : NULL;
+  *ski = request + 8 + len;
+  *ski_len = request_len - 8 - len;
+
+  return 0;
+}
+
+//
+// get_agent_socket_path()
+//
+const char *get_agent_socket_path(void)
+{
+  const char *path = getenv(KMYTH_AGENT_SOCK_ENV);
+
+  if (path == NULL || strlen(path) == 0)
+  {
+    return NULL;
+  }
+  return path;
+}
+
+//
+// agent_exchange()
+//
+static int agent_exchange(const char *socket_path, uint8_t op,
+                          uint8_t * request, size_t request_len,
+                          uint8_t ** response, size_t *response_len)
+{
+  if (socket_path == NULL)
+  {
+    socket_path = get_agent_socket_path();
+  }
+  if (socket_path == NULL)
+  {
+    kmyth_log(LOG_ERR, "no agent socket (%s not set) ... exiting",
+              KMYTH_AGENT_SOCK_ENV);
+    return 1;
+  }
+
+  int socket_fd = -1;
+
+  if (setup_unix_client_socket(socket_path, &socket_fd))
+  {
+    kmyth_log(LOG_ERR, "unable to connect to kmyth-agent ... exiting");
+    return 1;
+  }
+
+  uint8_t status = KMYTH_AGENT_STATUS_ERROR;
+
+  if (send_agent_message(socket_fd, op, request, request_len)
+      || recv_agent_message(socket_fd, &status, response, response_len))
+  {
+    kmyth_log(LOG_ERR, "kmyth-agent request failed ... exiting");
+    close(socket_fd);
+    return 1;
+  }
+  close(socket_fd);
+
+  if (status != KMYTH_AGENT_STATUS_OK)
+  {
+    kmyth_log(LOG_ERR, "kmyth-agent refused request (status %u) ... exiting",
+              status);
+    kmyth_clear_and_free(*response, *response_len);
+    *response = NULL;
+    *response_len = 0;
+    return 1;
+  }
+
+  return 0;
+}
+
+//
+// kmyth_agent_unseal()
+//
+int kmyth_agent_unseal(const char *socket_path,
+                       uint8_t * ski, size_t ski_len,
+                       uint8_t * auth, size_t auth_len, uint32_t ttl,
+                       uint8_t ** output, size_t *output_len)
+{
+  uint8_t *request = NULL;
+  size_t request_len = 0;
+
+  *output = NULL;
+  *output_len = 0;
+
+  if (build_agent_unseal_request(ski, ski_len, auth, auth_len, ttl,
+                                 &request, &request_len))
+  {
+    return 1;
+  }
+
+  int retval = agent_exchange(socket_path, KMYTH_AGENT_OP_UNSEAL,
+                              request, request_len, output, output_len);
+
+  // the request carries the authorization string
+  kmyth_clear_and_free(request, request_len);
+
+  return retval;
+}
+
+//
+// kmyth_agent_flush()
+//
+int kmyth_agent_flush(const char *socket_path)
+{
+  uint8_t *response = NULL;
+  size_t response_len = 0;
+
+  if (agent_exchange(socket_path, KMYTH_AGENT_OP_FLUSH, NULL, 0,
+                     &response, &response_len))
+  {
+    return 1;
+  }
+  kmyth_clear_and_free(response, response_len);
+
+  return 0;
+}
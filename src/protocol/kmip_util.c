@@ -7,6 +7,7 @@
 #include "defines.h"
 #include "memory_util.h"
 #include "aes_gcm.h"
+#include "kmip_util.h"
 
 #ifdef KMYTH_SGX
   #define time(ret_ptr) time_sgx((ret_ptr))
@@ -24,6 +25,109 @@
   }
 #endif
 
+//
+// encode_kmip_message()
+//
+// Encodes a request (is_request != 0) or response message into the caller's
+// encoding buffer, doubling the buffer (starting from
+// KMIP_ENCODING_BLOCK_SIZE) until the message fits. The buffer is left
+// allocated so that it can be reused for subsequent messages.
+//
+static int encode_kmip_message(KMIP * ctx, int is_request, void *message,
+                               unsigned char **buffer, size_t *buffer_size,
+                               size_t *message_len)
+{
+  if (*buffer == NULL)
+  {
+    *buffer_size = KMIP_ENCODING_BLOCK_SIZE;
+    *buffer = calloc(*buffer_size, sizeof(unsigned char));
+    if (*buffer == NULL)
+    {
+      kmyth_log(LOG_ERR, "Failed to allocate the KMIP encoding buffer.");
+      *buffer_size = 0;
+      return 1;
+    }
+  }
+
+  while (1)
+  {
+    kmip_reset(ctx);
+    kmip_set_buffer(ctx, *buffer, *buffer_size);
+
+    int result = is_request ?
+      kmip_encode_request_message(ctx, (RequestMessage *) message) :
+      kmip_encode_response_message(ctx, (ResponseMessage *) message);
+
+    if (result == KMIP_OK)
+    {
+      break;
+    }
+    if (result != KMIP_ERROR_BUFFER_FULL
+        || *buffer_size >= KMIP_ENCODING_MAX_SIZE)
+    {
+      kmyth_log(LOG_ERR, "Failed to encode the KMIP message.");
+      kmip_set_buffer(ctx, NULL, 0);
+      return 1;
+    }
+
+    // Grow into a fresh buffer (rather than realloc) so that a partial
+    // encoding, which may hold key material, is cleared.
+    size_t grown_size = 2 * (*buffer_size);
+    unsigned char *grown = calloc(grown_size, sizeof(unsigned char));
+
+    if (grown == NULL)
+    {
+      kmyth_log(LOG_ERR, "Failed to grow the KMIP encoding buffer.");
+      kmip_set_buffer(ctx, NULL, 0);
+      return 1;
+    }
+    kmyth_clear_and_free(*buffer, *buffer_size);
+    *buffer = grown;
+    *buffer_size = grown_size;
+  }
+
+  *message_len = ctx->index - ctx->buffer;
+  kmip_set_buffer(ctx, NULL, 0);
+
+  return 0;
+}
+
+//
+// copy_kmip_message()
+//
+// Copies an encoded message out of a (larger) encoding buffer.
+//
+static int copy_kmip_message(unsigned char *encoding, size_t encoding_len,
+                             unsigned char **message, size_t *message_len)
+{
+  *message = calloc(encoding_len, sizeof(unsigned char));
+  if (*message == NULL)
+  {
+    kmyth_log(LOG_ERR, "Failed to allocate the KMIP message buffer.");
+    return 1;
+  }
+  memcpy(*message, encoding, encoding_len);
+  *message_len = encoding_len;
+
+  return 0;
+}
+
+//
+// set_kmip_batch_item_id()
+//
+// Batch item i is identified by i, as a 4-byte big-endian value.
+//
+static void set_kmip_batch_item_id(ByteString * batch_item_id,
+                                   unsigned char *value, size_t index)
+{
+  value[0] = (unsigned char) (index >> 24);
+  value[1] = (unsigned char) (index >> 16);
+  value[2] = (unsigned char) (index >> 8);
+  value[3] = (unsigned char) index;
+  batch_item_id->value = value;
+  batch_item_id->size = 4;
+}
+
 //
 // build_kmip_get_request()
 //
@@ -31,20 +135,56 @@ int build_kmip_get_request(KMIP * ctx,
                            unsigned char *id, size_t id_len,
                            unsigned char **request, size_t *request_len)
 {
-  // Set up the encoding buffer.
-  size_t buffer_blocks = 1;
-  size_t buffer_block_size = 1024;
-  size_t buffer_total_size = buffer_blocks * buffer_block_size;
+  unsigned char *encoding = NULL;
+  size_t encoding_size = 0;
+  size_t encoding_len = 0;
+
+  if (build_kmip_get_batch_request(ctx, &id, &id_len, 1,
+                                   &encoding, &encoding_size, &encoding_len))
+  {
+    kmyth_log(LOG_ERR, "Failed to encode the KMIP key request.");
+    kmyth_clear_and_free(encoding, encoding_size);
+    return 1;
+  }
+
+  // Set up the official request buffer and clean up.
+  int result = copy_kmip_message(encoding, encoding_len, request, request_len);
+
+  kmyth_clear_and_free(encoding, encoding_size);
 
-  uint8 *encoding = calloc(buffer_blocks, buffer_block_size);
+  return result;
+}
 
-  if (encoding == NULL)
+//
+// build_kmip_get_batch_request()
+//
+int build_kmip_get_batch_request(KMIP * ctx,
+                                 unsigned char **ids, size_t *id_lens,
+                                 size_t id_count,
+                                 unsigned char **buffer, size_t *buffer_size,
+                                 size_t *request_len)
+{
+  if (id_count == 0 || id_count > KMIP_MAX_BATCH_COUNT)
   {
-    kmyth_log(LOG_ERR, "Failed to allocate the KMIP encoding buffer.");
+    kmyth_log(LOG_ERR, "Invalid number of KMIP Get requests (%zu).",
+              id_count);
     return 1;
   }
-  kmip_reset(ctx);
-  kmip_set_buffer(ctx, encoding, buffer_total_size);
+
+  TextString *key_ids = calloc(id_count, sizeof(TextString));
+  GetRequestPayload *payloads = calloc(id_count, sizeof(GetRequestPayload));
+  ByteString *batch_item_ids = calloc(id_count, sizeof(ByteString));
+  unsigned char *batch_item_id_values = calloc(id_count, 4);
+  RequestBatchItem *batch_items = calloc(id_count, sizeof(RequestBatchItem));
+
+  int result = 1;
+
+  if (key_ids == NULL || payloads == NULL || batch_item_ids == NULL
+      || batch_item_id_values == NULL || batch_items == NULL)
+  {
+    kmyth_log(LOG_ERR, "Failed to allocate the KMIP batch items.");
+    goto cleanup;
+  }
 
   // Build the KMIP Get request.
   ProtocolVersion protocol_version = { 0 };
@@ -56,51 +196,43 @@ int build_kmip_get_request(KMIP * ctx,
   header.protocol_version = &protocol_version;
   header.maximum_response_size = ctx->max_message_size;
   header.time_stamp = time(NULL);
-  header.batch_count = 1;
+  header.batch_count = (int32) id_count;
 
-  TextString key_id = { 0 };
-  key_id.value = (char *) id;
-  key_id.size = id_len;
+  for (size_t i = 0; i < id_count; i++)
+  {
+    key_ids[i].value = (char *) ids[i];
+    key_ids[i].size = id_lens[i];
+    payloads[i].unique_identifier = &key_ids[i];
 
-  GetRequestPayload payload = { 0 };
-  payload.unique_identifier = &key_id;
+    kmip_init_request_batch_item(&batch_items[i]);
+    batch_items[i].operation = KMIP_OP_GET;
+    batch_items[i].request_payload = &payloads[i];
 
-  RequestBatchItem batch_item = { 0 };
-  kmip_init_request_batch_item(&batch_item);
-  batch_item.operation = KMIP_OP_GET;
-  batch_item.request_payload = &payload;
+    // Batch item IDs are required when a message has more than one item.
+    if (id_count > 1)
+    {
+      set_kmip_batch_item_id(&batch_item_ids[i],
+                             &batch_item_id_values[4 * i], i);
+      batch_items[i].unique_batch_item_id = &batch_item_ids[i];
+    }
+  }
 
   RequestMessage message = { 0 };
   message.request_header = &header;
-  message.batch_items = &batch_item;
-  message.batch_count = 1;
-
-  int result = kmip_encode_request_message(ctx, &message);
-
-  if (result != KMIP_OK)
-  {
-    kmyth_log(LOG_ERR, "Failed to encode the KMIP key request.");
-    kmyth_clear_and_free(encoding, buffer_total_size);
-    kmip_set_buffer(ctx, NULL, 0);
-    return 1;
-  }
+  message.batch_items = batch_items;
+  message.batch_count = id_count;
 
-  // Set up the official request buffer and clean up.
-  *request_len = ctx->index - ctx->buffer;
-  *request = calloc(*request_len, sizeof(unsigned char));
-  if (request == NULL)
-  {
-    kmyth_log(LOG_ERR, "Failed to allocate the KMIP request buffer.");
-    kmyth_clear_and_free(encoding, buffer_total_size);
-    kmip_set_buffer(ctx, NULL, 0);
-    return 1;
-  }
-  memcpy(*request, encoding, *request_len);
+  result = encode_kmip_message(ctx, 1, &message,
+                               buffer, buffer_size, request_len);
 
-  kmyth_clear_and_free(encoding, buffer_total_size);
-  kmip_set_buffer(ctx, NULL, 0);
+cleanup:
+  free(key_ids);
+  free(payloads);
+  free(batch_item_ids);
+  free(batch_item_id_values);
+  free(batch_items);
 
-  return 0;
+  return result;
 }
 
 //
@@ -164,6 +296,105 @@ int parse_kmip_get_request(KMIP * ctx,
   return 0;
 }
 
+//
+// parse_kmip_get_batch_request()
+//
+int parse_kmip_get_batch_request(KMIP * ctx,
+                                 unsigned char *request, size_t request_len,
+                                 unsigned char ***ids, size_t **id_lens,
+                                 size_t *id_count)
+{
+  // Set up the decoding buffer and data structures.
+  kmip_reset(ctx);
+  kmip_set_buffer(ctx, request, request_len);
+  RequestMessage message = { 0 };
+
+  *ids = NULL;
+  *id_lens = NULL;
+  *id_count = 0;
+
+  // Parse the request message and handle errors.
+  int result = kmip_decode_request_message(ctx, &message);
+
+  if (result != KMIP_OK)
+  {
+    kmyth_log(LOG_ERR, "Failed to decode the KMIP request message.");
+    kmip_free_request_message(ctx, &message);
+    kmip_set_buffer(ctx, NULL, 0);
+    return 1;
+  }
+
+  size_t count = message.batch_count;
+
+  if (count == 0 || count > KMIP_MAX_BATCH_COUNT)
+  {
+    kmyth_log(LOG_ERR, "Received invalid number of requests (%zu).", count);
+    kmip_free_request_message(ctx, &message);
+    kmip_set_buffer(ctx, NULL, 0);
+    return 1;
+  }
+
+  *ids = calloc(count, sizeof(unsigned char *));
+  *id_lens = calloc(count, sizeof(size_t));
+  if (*ids == NULL || *id_lens == NULL)
+  {
+    kmyth_log(LOG_ERR, "Failed to allocate the ID list.");
+    free(*ids);
+    free(*id_lens);
+    *ids = NULL;
+    *id_lens = NULL;
+    kmip_free_request_message(ctx, &message);
+    kmip_set_buffer(ctx, NULL, 0);
+    return 1;
+  }
+
+  for (size_t i = 0; i < count; i++)
+  {
+    RequestBatchItem *batch_item = &message.batch_items[i];
+    GetRequestPayload *payload =
+      (GetRequestPayload *) batch_item->request_payload;
+
+    if (batch_item->operation != KMIP_OP_GET || payload == NULL
+        || payload->unique_identifier == NULL)
+    {
+      kmyth_log(LOG_ERR, "Did not receive a KMIP Get request (item %zu).", i);
+      result = 1;
+      break;
+    }
+
+    (*ids)[i] = calloc(payload->unique_identifier->size + 1,
+                       sizeof(unsigned char));
+    if ((*ids)[i] == NULL)
+    {
+      kmyth_log(LOG_ERR, "Failed to allocate the ID buffer.");
+      result = 1;
+      break;
+    }
+    (*id_lens)[i] = payload->unique_identifier->size;
+    memcpy((*ids)[i], payload->unique_identifier->value, (*id_lens)[i]);
+    (*id_count)++;
+  }
+
+  kmip_free_request_message(ctx, &message);
+  kmip_set_buffer(ctx, NULL, 0);
+
+  if (result != KMIP_OK)
+  {
+    for (size_t i = 0; i < *id_count; i++)
+    {
+      free((*ids)[i]);
+    }
+    free(*ids);
+    free(*id_lens);
+    *ids = NULL;
+    *id_lens = NULL;
+    *id_count = 0;
+    return 1;
+  }
+
+  return 0;
+}
+
 //
 // build_kmip_get_response()
 //
@@ -172,20 +403,66 @@ int build_kmip_get_response(KMIP * ctx,
                             unsigned char *key, size_t key_len,
                             unsigned char **response, size_t *response_len)
 {
-  // Set up the encoding buffer
-  size_t buffer_blocks = 1;
-  size_t buffer_block_size = 1024;
-  size_t buffer_total_size = buffer_blocks * buffer_block_size;
+  unsigned char *encoding = NULL;
+  size_t encoding_size = 0;
+  size_t encoding_len = 0;
+
+  if (build_kmip_get_batch_response(ctx, &id, &id_len, &key, &key_len, 1,
+                                    &encoding, &encoding_size, &encoding_len))
+  {
+    kmyth_log(LOG_ERR, "Failed to encode the KMIP Get response.");
+    kmyth_clear_and_free(encoding, encoding_size);
+    return 1;
+  }
+
+  // Set up the official response buffer and clean up.
+  int result = copy_kmip_message(encoding, encoding_len,
+                                 response, response_len);
 
-  uint8 *encoding = calloc(buffer_blocks, buffer_block_size);
+  kmyth_clear_and_free(encoding, encoding_size);
 
-  if (encoding == NULL)
+  return result;
+}
+
+//
+// build_kmip_get_batch_response()
+//
+int build_kmip_get_batch_response(KMIP * ctx,
+                                  unsigned char **ids, size_t *id_lens,
+                                  unsigned char **keys, size_t *key_lens,
+                                  size_t id_count,
+                                  unsigned char **buffer, size_t *buffer_size,
+                                  size_t *response_len)
+{
+  if (id_count == 0 || id_count > KMIP_MAX_BATCH_COUNT)
   {
-    kmyth_log(LOG_ERR, "Failed to allocate the KMIP encoding buffer.");
+    kmyth_log(LOG_ERR, "Invalid number of KMIP Get responses (%zu).",
+              id_count);
     return 1;
   }
-  kmip_reset(ctx);
-  kmip_set_buffer(ctx, encoding, buffer_total_size);
+
+  ByteString *byte_strings = calloc(id_count, sizeof(ByteString));
+  KeyValue *key_values = calloc(id_count, sizeof(KeyValue));
+  KeyBlock *key_blocks = calloc(id_count, sizeof(KeyBlock));
+  SymmetricKey *symmetric_keys = calloc(id_count, sizeof(SymmetricKey));
+  TextString *key_ids = calloc(id_count, sizeof(TextString));
+  GetResponsePayload *payloads = calloc(id_count,
+                                        sizeof(GetResponsePayload));
+  ByteString *batch_item_ids = calloc(id_count, sizeof(ByteString));
+  unsigned char *batch_item_id_values = calloc(id_count, 4);
+  ResponseBatchItem *batch_items = calloc(id_count,
+                                          sizeof(ResponseBatchItem));
+
+  int result = 1;
+
+  if (byte_strings == NULL || key_values == NULL || key_blocks == NULL
+      || symmetric_keys == NULL || key_ids == NULL || payloads == NULL
+      || batch_item_ids == NULL || batch_item_id_values == NULL
+      || batch_items == NULL)
+  {
+    kmyth_log(LOG_ERR, "Failed to allocate the KMIP batch items.");
+    goto cleanup;
+  }
 
   // Build the KMIP Get response
   ProtocolVersion protocol_version = { 0 };
@@ -196,67 +473,68 @@ int build_kmip_get_response(KMIP * ctx,
 
   header.protocol_version = &protocol_version;
   header.time_stamp = time(NULL);
-  header.batch_count = 1;
+  header.batch_count = (int32) id_count;
 
-  ByteString byte_string = { 0 };
-  byte_string.size = key_len;
-  byte_string.value = key;
+  for (size_t i = 0; i < id_count; i++)
+  {
+    batch_items[i].operation = KMIP_OP_GET;
 
-  KeyValue key_value = { 0 };
-  key_value.key_material = &byte_string;
+    // Batch item IDs are required when a message has more than one item,
+    // and match the position of the Get in the request.
+    if (id_count > 1)
+    {
+      set_kmip_batch_item_id(&batch_item_ids[i],
+                             &batch_item_id_values[4 * i], i);
+      batch_items[i].unique_batch_item_id = &batch_item_ids[i];
+    }
 
-  KeyBlock key_block = { 0 };
-  key_block.key_format_type = KMIP_KEYFORMAT_RAW;
-  key_block.key_value = &key_value;
+    // A missing key is reported as a failed item rather than failing the
+    // whole batch.
+    if (keys[i] == NULL)
+    {
+      batch_items[i].result_status = KMIP_STATUS_OPERATION_FAILED;
+      batch_items[i].result_reason = KMIP_REASON_ITEM_NOT_FOUND;
+      continue;
+    }
 
-  SymmetricKey symmetric_key = { 0 };
-  symmetric_key.key_block = &key_block;
+    byte_strings[i].size = key_lens[i];
+    byte_strings[i].value = keys[i];
+    key_values[i].key_material = &byte_strings[i];
+    key_blocks[i].key_format_type = KMIP_KEYFORMAT_RAW;
+    key_blocks[i].key_value = &key_values[i];
+    symmetric_keys[i].key_block = &key_blocks[i];
 
-  TextString key_id = { 0 };
-  key_id.value = (char *) id;
-  key_id.size = id_len;
+    key_ids[i].value = (char *) ids[i];
+    key_ids[i].size = id_lens[i];
 
-  GetResponsePayload payload = { 0 };
-  payload.object_type = KMIP_OBJTYPE_SYMMETRIC_KEY;
-  payload.unique_identifier = &key_id;
-  payload.object = &symmetric_key;
+    payloads[i].object_type = KMIP_OBJTYPE_SYMMETRIC_KEY;
+    payloads[i].unique_identifier = &key_ids[i];
+    payloads[i].object = &symmetric_keys[i];
 
-  ResponseBatchItem batch_item = { 0 };
-  batch_item.operation = KMIP_OP_GET;
-  batch_item.result_status = KMIP_STATUS_SUCCESS;
-  batch_item.response_payload = &payload;
+    batch_items[i].result_status = KMIP_STATUS_SUCCESS;
+    batch_items[i].response_payload = &payloads[i];
+  }
 
   ResponseMessage message = { 0 };
   message.response_header = &header;
-  message.batch_items = &batch_item;
-  message.batch_count = 1;
-
-  int result = kmip_encode_response_message(ctx, &message);
-
-  if (result != KMIP_OK)
-  {
-    kmyth_log(LOG_ERR, "Failed to encode the KMIP Get response.");
-    kmyth_clear_and_free(encoding, buffer_total_size);
-    kmip_set_buffer(ctx, NULL, 0);
-    return 1;
-  }
-
-  // Set up the official response buffer and clean up.
-  *response_len = ctx->index - ctx->buffer;
-  *response = calloc(*response_len, sizeof(unsigned char));
-  if (response == NULL)
-  {
-    kmyth_log(LOG_ERR, "Failed to allocate the KMIP response buffer.");
-    kmyth_clear_and_free(encoding, buffer_total_size);
-    kmip_set_buffer(ctx, NULL, 0);
-    return 1;
-  }
-  memcpy(*response, encoding, *response_len);
-
-  kmyth_clear_and_free(encoding, buffer_total_size);
-  kmip_set_buffer(ctx, NULL, 0);
-
-  return 0;
+  message.batch_items = batch_items;
+  message.batch_count = id_count;
+
+  result = encode_kmip_message(ctx, 0, &message,
+                               buffer, buffer_size, response_len);
+
+cleanup:
+  free(byte_strings);
+  free(key_values);
+  free(key_blocks);
+  free(symmetric_keys);
+  free(key_ids);
+  free(payloads);
+  free(batch_item_ids);
+  free(batch_item_id_values);
+  free(batch_items);
+
+  return result;
 }
 
 //
@@ -310,15 +588,32 @@ int parse_kmip_get_response(KMIP * ctx,
 
   GetResponsePayload *payload =
     (GetResponsePayload *) batch_item.response_payload;
-  if (payload->object_type != KMIP_OBJTYPE_SYMMETRIC_KEY)
+  if (payload == NULL || payload->object_type != KMIP_OBJTYPE_SYMMETRIC_KEY)
   {
     kmyth_log(LOG_ERR, "The received KMIP object is not a symmetric key.");
     kmip_free_response_message(ctx, &message);
     kmip_set_buffer(ctx, NULL, 0);
     return 1;
   }
+  if (payload->unique_identifier == NULL)
+  {
+    kmyth_log(LOG_ERR, "The KMIP Get response has no unique identifier.");
+    kmip_free_response_message(ctx, &message);
+    kmip_set_buffer(ctx, NULL, 0);
+    return 1;
+  }
 
   SymmetricKey *symmetric_key = (SymmetricKey *) payload->object;
+
+  if (symmetric_key == NULL || symmetric_key->key_block == NULL
+      || symmetric_key->key_block->key_value == NULL
+      || symmetric_key->key_block->key_value->key_material == NULL)
+  {
+    kmyth_log(LOG_ERR, "The received KMIP symmetric key has no key value.");
+    kmip_free_response_message(ctx, &message);
+    kmip_set_buffer(ctx, NULL, 0);
+    return 1;
+  }
   KeyBlock *key_block = symmetric_key->key_block;
   KeyValue *key_value = key_block->key_value;
   ByteString *key_material = key_value->key_material;
@@ -354,3 +649,145 @@ int parse_kmip_get_response(KMIP * ctx,
 
   return 0;
 }
+
+//
+// parse_kmip_get_batch_response()
+//
+int parse_kmip_get_batch_response(KMIP * ctx,
+                                  unsigned char *response,
+                                  size_t response_len,
+                                  unsigned char **ids, size_t *id_lens,
+                                  size_t id_count,
+                                  unsigned char **keys, size_t *key_lens)
+{
+  for (size_t i = 0; i < id_count; i++)
+  {
+    keys[i] = NULL;
+    key_lens[i] = 0;
+  }
+
+  // Set up the decoding buffer and data structures.
+  kmip_reset(ctx);
+  kmip_set_buffer(ctx, response, response_len);
+  ResponseMessage message = { 0 };
+
+  // Parse the response message and handle errors.
+  int result = kmip_decode_response_message(ctx, &message);
+
+  if (result != KMIP_OK)
+  {
+    kmyth_log(LOG_ERR, "Failed to decode the KMIP response message.");
+    kmip_free_response_message(ctx, &message);
+    kmip_set_buffer(ctx, NULL, 0);
+    return 1;
+  }
+
+  if (message.batch_count != id_count)
+  {
+    kmyth_log(LOG_ERR, "Received %zu responses (expected %zu).",
+              message.batch_count, id_count);
+    kmip_free_response_message(ctx, &message);
+    kmip_set_buffer(ctx, NULL, 0);
+    return 1;
+  }
+
+  for (size_t i = 0; i < message.batch_count && result == KMIP_OK; i++)
+  {
+    ResponseBatchItem *batch_item = &message.batch_items[i];
+
+    // Map the response to its request: by batch item ID when present (the
+    // server may reorder items), otherwise by position.
+    size_t index = i;
+    ByteString *batch_item_id = batch_item->unique_batch_item_id;
+
+    if (batch_item_id != NULL)
+    {
+      if (batch_item_id->size != 4)
+      {
+        kmyth_log(LOG_ERR, "Unrecognized KMIP batch item ID.");
+        result = 1;
+        break;
+      }
+      index = ((size_t) batch_item_id->value[0] << 24)
+        | ((size_t) batch_item_id->value[1] << 16)
+        | ((size_t) batch_item_id->value[2] << 8)
+        | (size_t) batch_item_id->value[3];
+    }
+    if (index >= id_count || keys[index] != NULL)
+    {
+      kmyth_log(LOG_ERR, "Unexpected or duplicate KMIP batch item.");
+      result = 1;
+      break;
+    }
+
+    if (batch_item->operation != KMIP_OP_GET)
+    {
+      kmyth_log(LOG_ERR, "Did not receive a KMIP Get response.");
+      result = 1;
+      break;
+    }
+    if (batch_item->result_status != KMIP_STATUS_SUCCESS)
+    {
+      kmyth_log(LOG_ERR, "The KMIP Get request for %.*s failed.",
+                (int) id_lens[index], ids[index]);
+      result = 1;
+      break;
+    }
+
+    GetResponsePayload *payload =
+      (GetResponsePayload *) batch_item->response_payload;
+    if (payload == NULL || payload->object_type != KMIP_OBJTYPE_SYMMETRIC_KEY)
+    {
+      kmyth_log(LOG_ERR, "The received KMIP object is not a symmetric key.");
+      result = 1;
+      break;
+    }
+    if (payload->unique_identifier == NULL
+        || payload->unique_identifier->size != id_lens[index]
+        || memcmp(payload->unique_identifier->value, ids[index],
+                  id_lens[index]) != 0)
+    {
+      kmyth_log(LOG_ERR, "The KMIP Get response does not match its ID.");
+      result = 1;
+      break;
+    }
+
+    SymmetricKey *symmetric_key = (SymmetricKey *) payload->object;
+
+    if (symmetric_key == NULL || symmetric_key->key_block == NULL
+        || symmetric_key->key_block->key_value == NULL
+        || symmetric_key->key_block->key_value->key_material == NULL)
+    {
+      kmyth_log(LOG_ERR, "The received KMIP symmetric key has no key value.");
+      result = 1;
+      break;
+    }
+    ByteString *key_material = symmetric_key->key_block->key_value->key_material;
+
+    keys[index] = kmyth_secure_alloc(key_material->size);
+    if (keys[index] == NULL)
+    {
+      kmyth_log(LOG_ERR, "Failed to allocate the key buffer.");
+      result = 1;
+      break;
+    }
+    key_lens[index] = key_material->size;
+    memcpy(keys[index], key_material->value, key_lens[index]);
+  }
+
+  kmip_free_response_message(ctx, &message);
+  kmip_set_buffer(ctx, NULL, 0);
+
+  if (result != KMIP_OK)
+  {
+    for (size_t i = 0; i < id_count; i++)
+    {
+      kmyth_clear_and_free(keys[i], key_lens[i]);
+      keys[i] = NULL;
+      key_lens[i] = 0;
+    }
+    return 1;
+  }
+
+  return 0;
+}
@@ -10,9 +10,12 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include <openssl/rand.h>
+
 #include "defines.h"
 #include "file_io.h"
 #include "formatting_tools.h"
+#include "kmyth.h"
 #include "marshalling_tools.h"
 #include "memory_util.h"
 #include "object_tools.h"
@@ -21,6 +24,7 @@
 #include "tpm2_interface.h"
 
 #include "cipher/cipher.h"
+#include "cipher/envelope.h"
 
 /**
  * @brief The external list of valid (implemented and configured) symmetric
@@ -28,6 +32,18 @@
  */
 extern const cipher_t cipher_list[];
 
+//############################################################################
+// free_ski_array()
+//############################################################################
+static void free_ski_array(Ski * skis, size_t count)
+{
+  for (size_t i = 0; i < count; i++)
+  {
+    free_ski(&skis[i]);
+  }
+  free(skis);
+}
+
 //############################################################################
 // tpm2_kmyth_seal()
 //############################################################################
@@ -41,18 +57,6 @@ int tpm2_kmyth_seal(uint8_t * input,
                     size_t oa_bytes_len, int *pcrs, size_t pcrs_len,
                     char *cipher_string)
 {
-
-  //init connection to the resource manager
-  TSS2_SYS_CONTEXT *sapi_ctx = NULL;
-
-  if (init_tpm2_connection(&sapi_ctx))
-  {
-    kmyth_log(LOG_ERR, "unable to init connection to TPM2 resource manager");
-    free_tpm2_resources(&sapi_ctx);
-    return 1;
-  }
-  kmyth_log(LOG_DEBUG, "initialized connection to TPM 2.0 resource manager");
-
   Ski ski = get_default_ski();
 
   //obtain cipher function
@@ -65,11 +69,61 @@ int tpm2_kmyth_seal(uint8_t * input,
   if (ski.cipher.cipher_name == NULL)
   {
     kmyth_log(LOG_ERR, "invalid cipher: %s ... exiting", cipher_string);
-    free_tpm2_resources(&sapi_ctx);
     return 1;
   }
   kmyth_log(LOG_DEBUG, "cipher: %s", ski.cipher.cipher_name);
 
+  // validate non-empty plaintext buffer specified
+  if (input_len == 0 || input == NULL)
+  {
+    kmyth_log(LOG_ERR, "no input data ... exiting");
+    return 1;
+  }
+
+  // Wrap input data -
+  //   - The data to be encrypted is contained in a file and the path to that
+  //     file is specified by the user.
+  //   - The encryption uses the symmetric 'cipher' specified by the user.
+  //   - The symmetric wrapping key used for encryption
+  // This does not involve the TPM, so it is done before waiting for a turn
+  // to use it (concurrent callers encrypt in parallel).
+  kmyth_log(LOG_DEBUG, "wrapping input data");
+  size_t wrapKey_size = get_key_len_from_cipher(ski.cipher) / 8;
+  unsigned char *wrapKey = kmyth_secure_alloc(wrapKey_size);
+
+  if (wrapKey == NULL)
+  {
+    kmyth_log(LOG_ERR,
+              "unable to allocate memory for the wrapping key ... exiting");
+    return 1;
+  }
+
+  // encrypt (wrap) input data read in (e.g., client certificate private .pem)
+  if (kmyth_encrypt_data(input, input_len,
+                         ski.cipher, &ski.enc_data, &ski.enc_data_size,
+                         &wrapKey, &wrapKey_size))
+  {
+    kmyth_log(LOG_ERR, "unable to encrypt (wrap) data ... exiting");
+    kmyth_clear_and_free(wrapKey, wrapKey_size);
+    free_ski(&ski);
+    return 1;
+  }
+
+  kmyth_log(LOG_DEBUG, "input data wrapped");
+
+  //init connection to the resource manager
+  TSS2_SYS_CONTEXT *sapi_ctx = NULL;
+
+  if (init_tpm2_connection(&sapi_ctx))
+  {
+    kmyth_log(LOG_ERR, "unable to init connection to TPM2 resource manager");
+    kmyth_clear_and_free(wrapKey, wrapKey_size);
+    free_ski(&ski);
+    free_tpm2_resources(&sapi_ctx);
+    return 1;
+  }
+  kmyth_log(LOG_DEBUG, "initialized connection to TPM 2.0 resource manager");
+
   // Create owner (storage) hierarchy authorization structure
   TPM2B_AUTH ownerAuth;
 
@@ -95,6 +149,8 @@ int tpm2_kmyth_seal(uint8_t * input,
     // included this case for completenes
     kmyth_log(LOG_DEBUG,
               "bad size: auth string for TPM storage hierarchy ... exiting");
+    kmyth_clear_and_free(wrapKey, wrapKey_size);
+    free_ski(&ski);
     free_tpm2_resources(&sapi_ctx);
     return 1;
   }
@@ -108,6 +164,8 @@ int tpm2_kmyth_seal(uint8_t * input,
     kmyth_log(LOG_ERR, "error creating authorization value ... exiting");
     kmyth_clear(objAuthVal.buffer, objAuthVal.size);
     kmyth_clear(ownerAuth.buffer, ownerAuth.size);
+    kmyth_clear_and_free(wrapKey, wrapKey_size);
+    free_ski(&ski);
     free_tpm2_resources(&sapi_ctx);
     return 1;
   }
@@ -125,6 +183,8 @@ int tpm2_kmyth_seal(uint8_t * input,
     // clear potential 'auth' data, free TPM resources before exiting early
     kmyth_clear(objAuthVal.buffer, objAuthVal.size);
     kmyth_clear(ownerAuth.buffer, ownerAuth.size);
+    kmyth_clear_and_free(wrapKey, wrapKey_size);
+    free_ski(&ski);
     free_tpm2_resources(&sapi_ctx);
     return 1;
   }
@@ -147,6 +207,8 @@ int tpm2_kmyth_seal(uint8_t * input,
     // clear potential 'auth' data, free TPM resources before exiting early
     kmyth_clear(objAuthVal.buffer, objAuthVal.size);
     kmyth_clear(ownerAuth.buffer, ownerAuth.size);
+    kmyth_clear_and_free(wrapKey, wrapKey_size);
+    free_ski(&ski);
     free_tpm2_resources(&sapi_ctx);
     return 1;
   }
@@ -168,6 +230,8 @@ int tpm2_kmyth_seal(uint8_t * input,
     // clear potential 'auth' data, free TPM resources before exiting early
     kmyth_clear(objAuthVal.buffer, objAuthVal.size);
     kmyth_clear(ownerAuth.buffer, ownerAuth.size);
+    kmyth_clear_and_free(wrapKey, wrapKey_size);
+    free_ski(&ski);
     free_tpm2_resources(&sapi_ctx);
     return 1;
   }
@@ -191,6 +255,8 @@ int tpm2_kmyth_seal(uint8_t * input,
     // clear potential 'auth' data, free TPM resources before exiting early
     kmyth_clear(objAuthVal.buffer, objAuthVal.size);
     kmyth_clear(ownerAuth.buffer, ownerAuth.size);
+    kmyth_clear_and_free(wrapKey, wrapKey_size);
+    free_ski(&ski);
     free_tpm2_resources(&sapi_ctx);
     return 1;
   }
@@ -198,46 +264,6 @@ int tpm2_kmyth_seal(uint8_t * input,
   // Done with owner hierarchy authorization - SRK and SK available in TPM
   kmyth_clear(ownerAuth.buffer, ownerAuth.size);
 
-  // Wrap input data -
-  //   - The data to be encrypted is contained in a file and the path to that
-  //     file is specified by the user.
-  //   - The encryption uses the symmetric 'cipher' specified by the user.
-  //   - The symmetric wrapping key used for encryption
-  kmyth_log(LOG_DEBUG, "wrapping input data");
-  size_t wrapKey_size = get_key_len_from_cipher(ski.cipher) / 8;
-  unsigned char *wrapKey = calloc(wrapKey_size, sizeof(unsigned char));
-
-  if (wrapKey == NULL)
-  {
-    kmyth_log(LOG_ERR,
-              "unable to allocate memory for the wrapping key ... exiting");
-    kmyth_clear(objAuthVal.buffer, objAuthVal.size);
-    free_tpm2_resources(&sapi_ctx);
-    return 1;
-  }
-
-  // validate non-empty plaintext buffer specified
-  if (input_len == 0 || input == NULL)
-  {
-    kmyth_log(LOG_ERR, "no input data ... exiting");
-    kmyth_clear(objAuthVal.buffer, objAuthVal.size);
-    free_tpm2_resources(&sapi_ctx);
-    return 1;
-  }
-
-  // encrypt (wrap) input data read in (e.g., client certificate private .pem)
-  if (kmyth_encrypt_data(input, input_len,
-                         ski.cipher, &ski.enc_data, &ski.enc_data_size,
-                         &wrapKey, &wrapKey_size))
-  {
-    kmyth_log(LOG_ERR, "unable to encrypt (wrap) data ... exiting");
-    kmyth_clear(objAuthVal.buffer, objAuthVal.size);
-    free_tpm2_resources(&sapi_ctx);
-    return 1;
-  }
-
-  kmyth_log(LOG_DEBUG, "input data wrapped");
-
   // Seal the wrapping key to the TPM using the Storage Key (SK)
   if (tpm2_kmyth_seal_data(sapi_ctx,
                            wrapKey,
@@ -252,6 +278,7 @@ int tpm2_kmyth_seal(uint8_t * input,
     kmyth_log(LOG_ERR, "unable to seal data ... exiting");
     kmyth_clear_and_free(wrapKey, wrapKey_size);
     kmyth_clear(objAuthVal.buffer, objAuthVal.size);
+    free_ski(&ski);
     free_tpm2_resources(&sapi_ctx);
     return 1;
   }
@@ -259,19 +286,19 @@ int tpm2_kmyth_seal(uint8_t * input,
   // Clean-up:
   //   - done with unencrypted wrapping key (now have sealed version)
   //   - done with authVal
+  //   - done with the TPM (lets the next queued caller use it)
   kmyth_clear_and_free(wrapKey, wrapKey_size);
   kmyth_clear(objAuthVal.buffer, objAuthVal.size);
+  free_tpm2_resources(&sapi_ctx);
 
   if (create_ski_bytes(ski, output, output_len))
   {
     kmyth_log(LOG_ERR, "error writing data to .ski format ... exiting");
-    free_tpm2_resources(&sapi_ctx);
+    free_ski(&ski);
     return 1;
   }
 
   free_ski(&ski);
-  // done, so free any allocated resources that remain
-  free_tpm2_resources(&sapi_ctx);
 
   return 0;
 }
@@ -287,6 +314,86 @@ int tpm2_kmyth_unseal(uint8_t * input,
                       size_t auth_bytes_len,
                       uint8_t * owner_auth_bytes, size_t oa_bytes_len)
 {
+  // Unsealing a single .ski is the one element case of a multi-object unseal
+  return tpm2_kmyth_unseal_multi(&input, &input_len, 1,
+                                 output, output_len,
+                                 auth_bytes, auth_bytes_len,
+                                 owner_auth_bytes, oa_bytes_len);
+}
+
+//############################################################################
+// tpm2_kmyth_unseal_multi()
+//############################################################################
+int tpm2_kmyth_unseal_multi(uint8_t ** inputs,
+                            size_t *input_lens,
+                            size_t input_count,
+                            uint8_t ** outputs,
+                            size_t *output_lens,
+                            uint8_t * auth_bytes,
+                            size_t auth_bytes_len,
+                            uint8_t * owner_auth_bytes, size_t oa_bytes_len)
+{
+  if (inputs == NULL || input_lens == NULL || input_count == 0
+      || outputs == NULL || output_lens == NULL)
+  {
+    kmyth_log(LOG_ERR, "no input .ski data ... exiting");
+    return 1;
+  }
+
+  // Every output is NULL until it is unsealed, so that all of them are NULL
+  // on any failure (including the early returns below)
+  for (size_t i = 0; i < input_count; i++)
+  {
+    outputs[i] = NULL;
+    output_lens[i] = 0;
+  }
+
+  for (size_t i = 0; i < input_count; i++)
+  {
+    if (inputs[i] == NULL || input_lens[i] == 0)
+    {
+      kmyth_log(LOG_ERR, "empty input .ski data (index %zu) ... exiting", i);
+      return 1;
+    }
+  }
+
+  // Parse every input (host-side work) before waiting for the TPM, so that
+  // concurrent callers only serialize on the TPM commands themselves
+  Ski *skis = calloc(input_count, sizeof(Ski));
+  uint8_t **keys = calloc(input_count, sizeof(uint8_t *));
+  size_t *key_lens = calloc(input_count, sizeof(size_t));
+
+  if (skis == NULL || keys == NULL || key_lens == NULL)
+  {
+    kmyth_log(LOG_ERR, "unable to allocate memory ... exiting");
+    free(skis);
+    free(keys);
+    free(key_lens);
+    return 1;
+  }
+
+  int retval = 0;
+  size_t parsed_count = 0;
+
+  for (size_t i = 0; i < input_count && retval == 0; i++)
+  {
+    skis[i] = get_default_ski();
+    if (parse_ski_bytes(inputs[i], input_lens[i], &skis[i]))
+    {
+      kmyth_log(LOG_ERR, "error parsing ski string (index %zu) ... exiting",
+                i);
+      retval = 1;
+    }
+    parsed_count++;
+  }
+  if (retval)
+  {
+    free_ski_array(skis, parsed_count);
+    free(keys);
+    free(key_lens);
+    return 1;
+  }
+
   // Initialize connection to TPM 2.0 resource manager
   TSS2_SYS_CONTEXT *sapi_ctx = NULL;
 
@@ -294,6 +401,9 @@ int tpm2_kmyth_unseal(uint8_t * input,
   {
     kmyth_log(LOG_ERR, "unable to init connection to TPM2 resource manager");
     free_tpm2_resources(&sapi_ctx);
+    free_ski_array(skis, input_count);
+    free(keys);
+    free(key_lens);
     return 1;
   }
   kmyth_log(LOG_DEBUG, "initialized connection to TPM 2.0 resource manager");
@@ -329,6 +439,9 @@ int tpm2_kmyth_unseal(uint8_t * input,
     kmyth_clear(objAuthValue.buffer, objAuthValue.size);
     kmyth_clear(ownerAuth.buffer, ownerAuth.size);
     free_tpm2_resources(&sapi_ctx);
+    free_ski_array(skis, input_count);
+    free(keys);
+    free(key_lens);
     return 1;
   }
 
@@ -345,88 +458,139 @@ int tpm2_kmyth_unseal(uint8_t * input,
   if (get_srk_handle(sapi_ctx, &storageRootKey_handle, &ownerAuth))
   {
     kmyth_log(LOG_ERR, "error obtaining handle for SRK ... exiting");
+    kmyth_clear(objAuthValue.buffer, objAuthValue.size);
+    kmyth_clear(ownerAuth.buffer, ownerAuth.size);
     free_tpm2_resources(&sapi_ctx);
+    free_ski_array(skis, input_count);
+    free(keys);
+    free(key_lens);
     return 1;
   }
   kmyth_log(LOG_DEBUG, "retrieved SRK handle (0x%08X)", storageRootKey_handle);
 
-  Ski ski = get_default_ski();
+  // Start a single TPM 2.0 policy session that is used to authorize loading
+  // and unsealing every sealed wrapping key object. Between objects, the
+  // session's policy digest is reset (TPM2_PolicyRestart) rather than
+  // starting (and later flushing) a new session for each one.
+  SESSION unsealData_session;
 
-  if (parse_ski_bytes(input, input_len, &ski))
+  if (create_policy_auth_session(sapi_ctx, &unsealData_session))
   {
-    kmyth_log(LOG_ERR, "error parsing ski string ... exiting");
-    free_ski(&ski);
+    kmyth_log(LOG_ERR, "error starting auth policy session ... exiting");
+    kmyth_clear(objAuthValue.buffer, objAuthValue.size);
+    kmyth_clear(ownerAuth.buffer, ownerAuth.size);
     free_tpm2_resources(&sapi_ctx);
+    free_ski_array(skis, input_count);
+    free(keys);
+    free(key_lens);
     return 1;
   }
 
-  // The Storage Key (SK) will be used by the TPM to unseal the wrapping key.
-  // We have obtained its public and encrypted private blobs from
-  // the input .ski file and will now load the SK into the TPM.
-  TPM2_HANDLE storageKey_handle = 0;
-  TPML_PCR_SELECTION emptyPcrList = {.count = 0, };
-  if (load_kmyth_object(sapi_ctx,
-                        (SESSION *) NULL,
-                        storageRootKey_handle,
-                        ownerAuth,
-                        emptyPcrList,
-                        &ski.sk_priv, &ski.sk_pub, &storageKey_handle))
+  for (size_t i = 0; i < input_count; i++)
   {
-    kmyth_log(LOG_ERR, "error loading storage key ... exiting");
-    free_ski(&ski);
-    free_tpm2_resources(&sapi_ctx);
-    return 1;
+    Ski *ski = &skis[i];
+
+    // The Storage Key (SK) will be used by the TPM to unseal the wrapping
+    // key. We have obtained its public and encrypted private blobs from
+    // the input .ski file and will now load the SK into the TPM.
+    TPM2_HANDLE storageKey_handle = 0;
+    TPML_PCR_SELECTION emptyPcrList = {.count = 0, };
+    if (load_kmyth_object(sapi_ctx,
+                          (SESSION *) NULL,
+                          storageRootKey_handle,
+                          ownerAuth,
+                          emptyPcrList,
+                          &ski->sk_priv, &ski->sk_pub, &storageKey_handle))
+    {
+      kmyth_log(LOG_ERR, "error loading storage key ... exiting");
+      retval = 1;
+      break;
+    }
+    kmyth_log(LOG_DEBUG, "loaded SK at handle = 0x%08X", storageKey_handle);
+
+    // The policy session may have been used to authorize a previous object,
+    // so reset its policy digest before the policy is re-applied for this one
+    if (i > 0 && restart_policy_auth_session(sapi_ctx, &unsealData_session))
+    {
+      kmyth_log(LOG_ERR, "error restarting auth policy session ... exiting");
+      Tss2_Sys_FlushContext(sapi_ctx, storageKey_handle);
+      retval = 1;
+      break;
+    }
+
+    // Authorization for the use of all non-primary (other than SRK), Kmyth
+    // TPM 2.0 objects utilizes policy-based enhanced authorization critera.
+    // The policy is re-applied to the session (using the PCR selection
+    // from the .ski being processed) by the load and unseal commands.
+    TPM2B_DIGEST objAuthPolicy;
+
+    objAuthPolicy.size = 0;
+
+    // Perform "unseal" to recover the wrapping key
+    if (tpm2_kmyth_unseal_data_with_session(sapi_ctx,
+                                            &unsealData_session,
+                                            storageKey_handle,
+                                            ski->wk_pub,
+                                            ski->wk_priv,
+                                            objAuthValue,
+                                            ski->pcr_list,
+                                            objAuthPolicy, &keys[i],
+                                            &key_lens[i]))
+    {
+      kmyth_log(LOG_ERR, "error unsealing data ... exiting");
+      Tss2_Sys_FlushContext(sapi_ctx, storageKey_handle);
+      retval = 1;
+      break;
+    }
+
+    // Done with this object's SK - flush it so that the TPM's transient
+    // object slots are not exhausted when unsealing many objects
+    Tss2_Sys_FlushContext(sapi_ctx, storageKey_handle);
   }
-  kmyth_log(LOG_DEBUG, "loaded SK at handle = 0x%08X", storageKey_handle);
-
-  // Authorization for the use of all non-primary (other than SRK), Kmyth
-  // TPM 2.0 objects utilizes policy-based enhanced authorization critera.
-  // Therefore, we will calculate the authorization policy digest that
-  // results from applying the steps of our selected authorization policy.
-  // We pass this result to the kmyth_unseal_data() function where it is
-  // used in theinto the objects we create as the
-  // authorization policy digest value that must be regenerated to authorize
-  // use of these objects.
-  TPM2B_DIGEST objAuthPolicy;
 
-  objAuthPolicy.size = 0;
+  // done with the TPM, so free its resources (also flushes the policy
+  // session) and let the next queued caller use it
+  kmyth_clear(objAuthValue.buffer, objAuthValue.size);
+  kmyth_clear(ownerAuth.buffer, ownerAuth.size);
+  free_tpm2_resources(&sapi_ctx);
 
-  uint8_t *key = NULL;
-  size_t key_len;
+  // decrypt the wrapped data (host-side work) outside of the TPM queue
+  size_t done_count = 0;
 
-  // Perform "unseal" to recover data
-  if (tpm2_kmyth_unseal_data(sapi_ctx,
-                             storageKey_handle,
-                             ski.wk_pub,
-                             ski.wk_priv,
-                             objAuthValue,
-                             ski.pcr_list, objAuthPolicy, &key, &key_len))
+  for (size_t i = 0; i < input_count && retval == 0; i++)
   {
-    kmyth_log(LOG_ERR, "error unsealing data ... exiting");
-    free_ski(&ski);
-    free_tpm2_resources(&sapi_ctx);
-    kmyth_clear(key, key_len);
-    return 1;
+    if (kmyth_decrypt_data((unsigned char *) skis[i].enc_data,
+                           skis[i].enc_data_size,
+                           skis[i].cipher,
+                           (unsigned char *) keys[i], key_lens[i],
+                           &outputs[i], &output_lens[i]))
+    {
+      kmyth_log(LOG_ERR, "error decrypting data (index %zu) ... exiting", i);
+      retval = 1;
+    }
+    done_count++;
   }
 
-  if (kmyth_decrypt_data((unsigned char *) ski.enc_data,
-                         ski.enc_data_size,
-                         ski.cipher,
-                         (unsigned char *) key, key_len, output, output_len))
+  // on failure, do not return a partial set of (plaintext) results
+  if (retval)
   {
-    kmyth_log(LOG_ERR, "error decrypting data ... exiting");
-    free_ski(&ski);
-    free_tpm2_resources(&sapi_ctx);
-    kmyth_clear(key, key_len);
-    return 1;
+    for (size_t i = 0; i < done_count; i++)
+    {
+      kmyth_clear_and_free(outputs[i], output_lens[i]);
+      outputs[i] = NULL;
+      output_lens[i] = 0;
+    }
   }
 
-  // done, so free any allocated resources that remain
-  free_ski(&ski);
-  free_tpm2_resources(&sapi_ctx);
-  kmyth_clear(key, key_len);
+  for (size_t i = 0; i < input_count; i++)
+  {
+    kmyth_clear_and_free(keys[i], key_lens[i]);
+  }
+  free_ski_array(skis, input_count);
+  free(keys);
+  free(key_lens);
 
-  return 0;
+  return retval;
 }
 
 //############################################################################
@@ -514,6 +678,436 @@ int tpm2_kmyth_unseal_file(char *input_path,
   return 0;
 }
 
+//############################################################################
+// tpm2_kmyth_create_kek()
+//############################################################################
+int tpm2_kmyth_create_kek(uint8_t ** output,
+                          size_t * output_len,
+                          uint8_t * auth_bytes,
+                          size_t auth_bytes_len,
+                          uint8_t * owner_auth_bytes,
+                          size_t oa_bytes_len, int *pcrs, size_t pcrs_len)
+{
+  uint8_t *kek = kmyth_secure_alloc(KMYTH_ENVELOPE_KEK_LEN);
+
+  if (kek == NULL || !RAND_bytes(kek, KMYTH_ENVELOPE_KEK_LEN))
+  {
+    kmyth_log(LOG_ERR, "unable to create KEK ... exiting");
+    kmyth_clear_and_free(kek, KMYTH_ENVELOPE_KEK_LEN);
+    return 1;
+  }
+
+  // the KEK is sealed like any other kmyth-seal input - this is the only
+  // TPM-sealed object in envelope mode
+  if (tpm2_kmyth_seal(kek, KMYTH_ENVELOPE_KEK_LEN,
+                      output, output_len,
+                      auth_bytes, auth_bytes_len,
+                      owner_auth_bytes, oa_bytes_len,
+                      pcrs, pcrs_len, NULL))
+  {
+    kmyth_log(LOG_ERR, "unable to kmyth-seal KEK ... exiting");
+    kmyth_clear_and_free(kek, KMYTH_ENVELOPE_KEK_LEN);
+    return 1;
+  }
+
+  kmyth_clear_and_free(kek, KMYTH_ENVELOPE_KEK_LEN);
+  return 0;
+}
+
+//############################################################################
+// tpm2_kmyth_envelope_seal()
+//############################################################################
+int tpm2_kmyth_envelope_seal(uint8_t * kek_ski,
+                             size_t kek_ski_len,
+                             uint8_t ** inputs,
+                             size_t *input_lens,
+                             size_t input_count,
+                             uint8_t ** outputs,
+                             size_t *output_lens,
+                             uint8_t * auth_bytes,
+                             size_t auth_bytes_len,
+                             uint8_t * owner_auth_bytes,
+                             size_t oa_bytes_len, char *cipher_string)
+{
+  if (inputs == NULL || input_lens == NULL || input_count == 0
+      || outputs == NULL || output_lens == NULL)
+  {
+    kmyth_log(LOG_ERR, "no input data ... exiting");
+    return 1;
+  }
+
+  if (cipher_string == NULL)
+  {
+    cipher_string = KMYTH_DEFAULT_CIPHER;
+  }
+  cipher_t cipher_spec = kmyth_get_cipher_t_from_string(cipher_string);
+
+  if (cipher_spec.cipher_name == NULL)
+  {
+    kmyth_log(LOG_ERR, "invalid cipher: %s ... exiting", cipher_string);
+    return 1;
+  }
+
+  // the only TPM operation - recover the KEK
+  uint8_t *kek = NULL;
+  size_t kek_len = 0;
+
+  if (tpm2_kmyth_unseal(kek_ski, kek_ski_len, &kek, &kek_len,
+                        auth_bytes, auth_bytes_len,
+                        owner_auth_bytes, oa_bytes_len))
+  {
+    kmyth_log(LOG_ERR, "unable to unseal KEK ... exiting");
+    return 1;
+  }
+
+  int retval = 0;
+  size_t done_count = 0;
+
+  for (size_t i = 0; i < input_count; i++)
+  {
+    outputs[i] = NULL;
+    output_lens[i] = 0;
+
+    if (kmyth_envelope_encrypt(kek, kek_len, inputs[i], input_lens[i],
+                               cipher_spec, &outputs[i], &output_lens[i]))
+    {
+      kmyth_log(LOG_ERR, "unable to create envelope (index %zu) ... exiting",
+                i);
+      retval = 1;
+      break;
+    }
+    done_count++;
+  }
+  kmyth_clear_and_free(kek, kek_len);
+
+  // on failure, do not return a partial set of results
+  if (retval)
+  {
+    for (size_t i = 0; i < done_count; i++)
+    {
+      free(outputs[i]);
+      outputs[i] = NULL;
+      output_lens[i] = 0;
+    }
+  }
+
+  return retval;
+}
+
+//############################################################################
+// tpm2_kmyth_envelope_unseal()
+//############################################################################
+int tpm2_kmyth_envelope_unseal(uint8_t * kek_ski,
+                               size_t kek_ski_len,
+                               uint8_t ** inputs,
+                               size_t *input_lens,
+                               size_t input_count,
+                               uint8_t ** outputs,
+                               size_t *output_lens,
+                               uint8_t * auth_bytes,
+                               size_t auth_bytes_len,
+                               uint8_t * owner_auth_bytes, size_t oa_bytes_len)
+{
+  if (inputs == NULL || input_lens == NULL || input_count == 0
+      || outputs == NULL || output_lens == NULL)
+  {
+    kmyth_log(LOG_ERR, "no input envelope data ... exiting");
+    return 1;
+  }
+
+  // the only TPM operation - recover the KEK
+  uint8_t *kek = NULL;
+  size_t kek_len = 0;
+
+  if (tpm2_kmyth_unseal(kek_ski, kek_ski_len, &kek, &kek_len,
+                        auth_bytes, auth_bytes_len,
+                        owner_auth_bytes, oa_bytes_len))
+  {
+    kmyth_log(LOG_ERR, "unable to unseal KEK ... exiting");
+    return 1;
+  }
+
+  int retval = 0;
+  size_t done_count = 0;
+
+  for (size_t i = 0; i < input_count; i++)
+  {
+    outputs[i] = NULL;
+    output_lens[i] = 0;
+
+    if (kmyth_envelope_decrypt(kek, kek_len, inputs[i], input_lens[i],
+                               &outputs[i], &output_lens[i]))
+    {
+      kmyth_log(LOG_ERR, "unable to open envelope (index %zu) ... exiting",
+                i);
+      retval = 1;
+      break;
+    }
+    done_count++;
+  }
+  kmyth_clear_and_free(kek, kek_len);
+
+  // on failure, do not return a partial set of (plaintext) results
+  if (retval)
+  {
+    for (size_t i = 0; i < done_count; i++)
+    {
+      kmyth_clear_and_free(outputs[i], output_lens[i]);
+      outputs[i] = NULL;
+      output_lens[i] = 0;
+    }
+  }
+
+  return retval;
+}
+
+//############################################################################
+// tpm2_kmyth_reseal()
+//############################################################################
+int tpm2_kmyth_reseal(uint8_t ** inputs,
+                      size_t *input_lens,
+                      size_t input_count,
+                      uint8_t ** outputs,
+                      size_t *output_lens,
+                      uint8_t * auth_bytes,
+                      size_t auth_bytes_len,
+                      uint8_t * owner_auth_bytes,
+                      size_t oa_bytes_len, int *pcrs, size_t pcrs_len)
+{
+  if (inputs == NULL || input_lens == NULL || input_count == 0
+      || outputs == NULL || output_lens == NULL)
+  {
+    kmyth_log(LOG_ERR, "no input .ski data ... exiting");
+    return 1;
+  }
+  for (size_t i = 0; i < input_count; i++)
+  {
+    outputs[i] = NULL;
+    output_lens[i] = 0;
+    if (inputs[i] == NULL || input_lens[i] == 0)
+    {
+      kmyth_log(LOG_ERR, "empty input .ski data (index %zu) ... exiting", i);
+      return 1;
+    }
+  }
+
+  // Initialize connection to TPM 2.0 resource manager
+  TSS2_SYS_CONTEXT *sapi_ctx = NULL;
+
+  if (init_tpm2_connection(&sapi_ctx))
+  {
+    kmyth_log(LOG_ERR, "unable to init connection to TPM2 resource manager");
+    free_tpm2_resources(&sapi_ctx);
+    return 1;
+  }
+  kmyth_log(LOG_DEBUG, "initialized connection to TPM 2.0 resource manager");
+
+  // Create owner (storage) hierarchy authorization structure
+  TPM2B_AUTH ownerAuth;
+
+  ownerAuth.size = oa_bytes_len;
+  if (owner_auth_bytes != NULL && oa_bytes_len > 0)
+  {
+    memcpy(ownerAuth.buffer, owner_auth_bytes, ownerAuth.size);
+  }
+
+  // Create authorization value (authVal) - used both to authorize the
+  // existing objects and for the re-sealed ones
+  TPM2B_AUTH objAuthValue;
+
+  if (create_authVal(auth_bytes, auth_bytes_len, &objAuthValue))
+  {
+    kmyth_log(LOG_ERR, "error creating authorization value ... exiting");
+    kmyth_clear(objAuthValue.buffer, objAuthValue.size);
+    kmyth_clear(ownerAuth.buffer, ownerAuth.size);
+    free_tpm2_resources(&sapi_ctx);
+    return 1;
+  }
+
+  // Create the new PCR selection and the authorization policy digest
+  // that the re-sealed objects will be bound to
+  TPML_PCR_SELECTION newPcrList;
+  TPM2B_DIGEST newAuthPolicy;
+
+  newAuthPolicy.size = 0;
+  if (init_pcr_selection(sapi_ctx, pcrs, pcrs_len, &newPcrList)
+      || create_policy_digest(sapi_ctx, newPcrList, &newAuthPolicy))
+  {
+    kmyth_log(LOG_ERR, "error creating new auth policy ... exiting");
+    kmyth_clear(objAuthValue.buffer, objAuthValue.size);
+    kmyth_clear(ownerAuth.buffer, ownerAuth.size);
+    free_tpm2_resources(&sapi_ctx);
+    return 1;
+  }
+
+  TPM2_HANDLE storageRootKey_handle = 0;
+
+  if (get_srk_handle(sapi_ctx, &storageRootKey_handle, &ownerAuth))
+  {
+    kmyth_log(LOG_ERR, "error obtaining handle for SRK ... exiting");
+    kmyth_clear(objAuthValue.buffer, objAuthValue.size);
+    kmyth_clear(ownerAuth.buffer, ownerAuth.size);
+    free_tpm2_resources(&sapi_ctx);
+    return 1;
+  }
+  kmyth_log(LOG_DEBUG, "retrieved SRK handle (0x%08X)", storageRootKey_handle);
+
+  // Create a single new storage key (SK), bound to the new policy, that all
+  // of the re-sealed wrapping keys are sealed under
+  TPM2_HANDLE newStorageKey_handle = 0;
+  TPM2B_PUBLIC new_sk_pub = {.size = 0, };
+  TPM2B_PRIVATE new_sk_priv = {.size = 0, };
+
+  if (create_and_load_sk(sapi_ctx,
+                         storageRootKey_handle,
+                         ownerAuth,
+                         objAuthValue,
+                         newPcrList,
+                         newAuthPolicy,
+                         &newStorageKey_handle, &new_sk_priv, &new_sk_pub))
+  {
+    kmyth_log(LOG_ERR, "failed to create and load a storage key ... exiting");
+    kmyth_clear(objAuthValue.buffer, objAuthValue.size);
+    kmyth_clear(ownerAuth.buffer, ownerAuth.size);
+    free_tpm2_resources(&sapi_ctx);
+    return 1;
+  }
+  kmyth_log(LOG_DEBUG, "new SK loaded at handle = 0x%08X",
+            newStorageKey_handle);
+
+  // One policy session authorizes unsealing every existing wrapping key
+  SESSION unsealData_session;
+
+  if (create_policy_auth_session(sapi_ctx, &unsealData_session))
+  {
+    kmyth_log(LOG_ERR, "error starting auth policy session ... exiting");
+    kmyth_clear(objAuthValue.buffer, objAuthValue.size);
+    kmyth_clear(ownerAuth.buffer, ownerAuth.size);
+    free_tpm2_resources(&sapi_ctx);
+    return 1;
+  }
+
+  int retval = 0;
+  size_t done_count = 0;
+
+  for (size_t i = 0; i < input_count; i++)
+  {
+    Ski ski = get_default_ski();
+
+    if (parse_ski_bytes(inputs[i], input_lens[i], &ski))
+    {
+      kmyth_log(LOG_ERR, "error parsing ski string (index %zu) ... exiting",
+                i);
+      free_ski(&ski);
+      retval = 1;
+      break;
+    }
+
+    // Load the existing SK so that the existing wrapping key can be unsealed
+    TPM2_HANDLE storageKey_handle = 0;
+    TPML_PCR_SELECTION emptyPcrList = {.count = 0, };
+    if (load_kmyth_object(sapi_ctx,
+                          (SESSION *) NULL,
+                          storageRootKey_handle,
+                          ownerAuth,
+                          emptyPcrList,
+                          &ski.sk_priv, &ski.sk_pub, &storageKey_handle))
+    {
+      kmyth_log(LOG_ERR, "error loading storage key ... exiting");
+      free_ski(&ski);
+      retval = 1;
+      break;
+    }
+
+    if (i > 0 && restart_policy_auth_session(sapi_ctx, &unsealData_session))
+    {
+      kmyth_log(LOG_ERR, "error restarting auth policy session ... exiting");
+      Tss2_Sys_FlushContext(sapi_ctx, storageKey_handle);
+      free_ski(&ski);
+      retval = 1;
+      break;
+    }
+
+    // Unseal the wrapping key under the existing (old) policy
+    TPM2B_DIGEST objAuthPolicy;
+
+    objAuthPolicy.size = 0;
+
+    uint8_t *key = NULL;
+    size_t key_len = 0;
+
+    if (tpm2_kmyth_unseal_data_with_session(sapi_ctx,
+                                            &unsealData_session,
+                                            storageKey_handle,
+                                            ski.wk_pub,
+                                            ski.wk_priv,
+                                            objAuthValue,
+                                            ski.pcr_list,
+                                            objAuthPolicy, &key, &key_len))
+    {
+      kmyth_log(LOG_ERR, "error unsealing wrapping key ... exiting");
+      Tss2_Sys_FlushContext(sapi_ctx, storageKey_handle);
+      free_ski(&ski);
+      retval = 1;
+      break;
+    }
+    Tss2_Sys_FlushContext(sapi_ctx, storageKey_handle);
+
+    // Re-seal the wrapping key under the new SK and policy - the encrypted
+    // data (ski.enc_data) is carried through unchanged
+    ski.pcr_list = newPcrList;
+    ski.sk_pub = new_sk_pub;
+    ski.sk_priv = new_sk_priv;
+    if (tpm2_kmyth_seal_data(sapi_ctx,
+                             key,
+                             key_len,
+                             newStorageKey_handle,
+                             objAuthValue,
+                             newPcrList,
+                             objAuthValue,
+                             newPcrList,
+                             newAuthPolicy, &ski.wk_pub, &ski.wk_priv))
+    {
+      kmyth_log(LOG_ERR, "error re-sealing wrapping key ... exiting");
+      kmyth_clear_and_free(key, key_len);
+      free_ski(&ski);
+      retval = 1;
+      break;
+    }
+    kmyth_clear_and_free(key, key_len);
+
+    if (create_ski_bytes(ski, &outputs[i], &output_lens[i]))
+    {
+      kmyth_log(LOG_ERR, "error writing data to .ski format ... exiting");
+      free_ski(&ski);
+      retval = 1;
+      break;
+    }
+
+    free_ski(&ski);
+    done_count++;
+  }
+
+  // on failure, do not return a partial set of results
+  if (retval)
+  {
+    for (size_t i = 0; i <= done_count && i < input_count; i++)
+    {
+      free(outputs[i]);
+      outputs[i] = NULL;
+      output_lens[i] = 0;
+    }
+  }
+
+  // done, so free any allocated resources that remain (also flushes the
+  // policy session and new SK)
+  kmyth_clear(objAuthValue.buffer, objAuthValue.size);
+  kmyth_clear(ownerAuth.buffer, ownerAuth.size);
+  free_tpm2_resources(&sapi_ctx);
+
+  return retval;
+}
+
 //############################################################################
 // tpm2_kmyth_seal_data
 //############################################################################
@@ -628,12 +1222,71 @@ int tpm2_kmyth_unseal_data(TSS2_SYS_CONTEXT * sapi_ctx,
     return 1;
   }
 
+  if (tpm2_kmyth_unseal_data_with_session(sapi_ctx,
+                                          &unsealData_session,
+                                          sk_handle,
+                                          sdo_public,
+                                          sdo_private,
+                                          authVal,
+                                          pcrList,
+                                          authPolicy, result, result_size))
+  {
+    kmyth_log(LOG_ERR, "error unsealing data ... exiting");
+    Tss2_Sys_FlushContext(sapi_ctx, unsealData_session.sessionHandle);
+    return 1;
+  }
+
+  // Clean-up: done with the policy authorization session setup to enable
+  //           loading and unsealing of the sealed data object, so
+  //           flush it from the TPM
+  TSS2_RC rc = Tss2_Sys_FlushContext(sapi_ctx,
+                                     unsealData_session.sessionHandle);
+
+  if (rc != TSS2_RC_SUCCESS)
+  {
+    kmyth_log(LOG_ERR,
+              "Tss2_Sys_FlushContext(): rc = 0x%08X, %s",
+              rc, getErrorString(rc));
+    kmyth_log(LOG_ERR,
+              "error flushing policy session (handle = 0x%08X) ... exiting",
+              unsealData_session.sessionHandle);
+    kmyth_clear_and_free(*result, *result_size);
+    *result = NULL;
+    *result_size = 0;
+    return 1;
+  }
+  kmyth_log(LOG_DEBUG, "flushed policy auth session (handle = 0x%08X)",
+            unsealData_session.sessionHandle);
+
+  return 0;
+}
+
+//############################################################################
+// tpm2_kmyth_unseal_data_with_session()
+//############################################################################
+int tpm2_kmyth_unseal_data_with_session(TSS2_SYS_CONTEXT * sapi_ctx,
+                                        SESSION * unsealData_session,
+                                        TPM2_HANDLE sk_handle,
+                                        TPM2B_PUBLIC sdo_public,
+                                        TPM2B_PRIVATE sdo_private,
+                                        TPM2B_AUTH authVal,
+                                        TPML_PCR_SELECTION pcrList,
+                                        TPM2B_DIGEST authPolicy,
+                                        uint8_t ** result,
+                                        size_t * result_size)
+{
+  if (unsealData_session == NULL)
+  {
+    kmyth_log(LOG_ERR, "no policy session ... exiting");
+    return 1;
+  }
+
   // Load sealed data object into the TPM so that we can unseal it
   // It gets loaded under the storage key (authEntity for this command)
   TPM2_HANDLE sdo_handle = 0;
 
   if (load_kmyth_object(sapi_ctx,
-                        &unsealData_session,
+                        unsealData_session,
                         sk_handle,
                         authVal,
                         pcrList, &sdo_private, &sdo_public, &sdo_handle))
@@ -647,7 +1300,7 @@ int tpm2_kmyth_unseal_data(TSS2_SYS_CONTEXT * sapi_ctx,
   // Unseal the data object just loaded into the TPM (e.g., sealed wrap key)
   TPM2B_SENSITIVE_DATA unseal_sensitive = {.size = 0, };
   if (unseal_kmyth_object(sapi_ctx,
-                          &unsealData_session,
+                          unsealData_session,
                           sdo_handle, authVal, pcrList, &unseal_sensitive))
   {
     kmyth_log(LOG_ERR, "error unsealing ... exiting");
@@ -655,32 +1308,36 @@ int tpm2_kmyth_unseal_data(TSS2_SYS_CONTEXT * sapi_ctx,
     // overwrite any potentially unsealed data before exiting early due
     // to failed unseal
     kmyth_clear(unseal_sensitive.buffer, unseal_sensitive.size);
+    Tss2_Sys_FlushContext(sapi_ctx, sdo_handle);
     return 1;
   }
   kmyth_log(LOG_DEBUG, "unsealed data object (handle = 0x%08X)", sdo_handle);
 
-  // Clean-up: done with the policy authorization session setup to enable
-  //           loading and unsealing of the sealed data object, so
-  //           flush it from the TPM
-  TSS2_RC rc = Tss2_Sys_FlushContext(sapi_ctx,
-                                     unsealData_session.sessionHandle);
+  // Clean-up: done with the sealed data object, so flush it from the TPM
+  // (frees the transient object slot when the session is re-used to unseal
+  // additional objects)
+  TSS2_RC rc = Tss2_Sys_FlushContext(sapi_ctx, sdo_handle);
 
   if (rc != TSS2_RC_SUCCESS)
   {
-    kmyth_log(LOG_ERR,
-              "Tss2_Sys_FlushContext(): rc = 0x%08X, %s",
+    kmyth_log(LOG_ERR, "Tss2_Sys_FlushContext(): rc = 0x%08X, %s",
               rc, getErrorString(rc));
     kmyth_log(LOG_ERR,
-              "error flushing policy session (handle = 0x%08X) ... exiting",
-              unsealData_session.sessionHandle);
+              "error flushing sealed data object (handle = 0x%08X) ... exiting",
+              sdo_handle);
     kmyth_clear(unseal_sensitive.buffer, unseal_sensitive.size);
     return 1;
   }
-  kmyth_log(LOG_DEBUG, "flushed policy auth session (handle = 0x%08X)",
-            unsealData_session.sessionHandle);
 
   *result_size = unseal_sensitive.size;
-  *result = (uint8_t *) malloc(*result_size);
+  *result = kmyth_secure_alloc(*result_size);
+  if (*result == NULL)
+  {
+    kmyth_log(LOG_ERR, "allocation error for unsealed result ... exiting");
+    kmyth_clear(unseal_sensitive.buffer, unseal_sensitive.size);
+    *result_size = 0;
+    return 1;
+  }
 
   memcpy(*result, unseal_sensitive.buffer, *result_size);
   kmyth_clear(unseal_sensitive.buffer, unseal_sensitive.size);
@@ -32,184 +32,111 @@ int parse_ski_bytes(uint8_t * input, size_t input_length, Ski * output)
   size_t remaining = input_length;
   Ski temp_ski = get_default_ski();
 
-  // read in (parse out) 'raw' (encoded) PCR selection list block
-  uint8_t *raw_pcr_select_list_data = NULL;
-  size_t raw_pcr_select_list_size = 0;
-
-  if (get_block_bytes((char **) &position,
-                      &remaining,
-                      &raw_pcr_select_list_data,
-                      &raw_pcr_select_list_size,
-                      KMYTH_DELIM_PCR_SELECTION_LIST,
-                      strlen(KMYTH_DELIM_PCR_SELECTION_LIST),
-                      KMYTH_DELIM_STORAGE_KEY_PUBLIC,
-                      strlen(KMYTH_DELIM_STORAGE_KEY_PUBLIC)))
+  // locate each block - the views point into input, so no block is copied
+  block_view_t raw_pcr_select_list = {.data = NULL,.size = 0 };
+  block_view_t raw_sk_pub = {.data = NULL,.size = 0 };
+  block_view_t raw_sk_priv = {.data = NULL,.size = 0 };
+  block_view_t raw_cipher_str = {.data = NULL,.size = 0 };
+  block_view_t raw_sym_pub = {.data = NULL,.size = 0 };
+  block_view_t raw_sym_priv = {.data = NULL,.size = 0 };
+  block_view_t raw_enc = {.data = NULL,.size = 0 };
+
+  if (get_block_view(&position, &remaining, &raw_pcr_select_list,
+                     KMYTH_DELIM_PCR_SELECTION_LIST,
+                     strlen(KMYTH_DELIM_PCR_SELECTION_LIST),
+                     KMYTH_DELIM_STORAGE_KEY_PUBLIC,
+                     strlen(KMYTH_DELIM_STORAGE_KEY_PUBLIC)))
   {
     kmyth_log(LOG_ERR, "get PCR selection list error ... exiting");
-    free(raw_pcr_select_list_data);
     return 1;
   }
 
-  // read in (parse out) 'raw' (encoded) public data block for the storage key
-  uint8_t *raw_sk_pub_data = NULL;
-  size_t raw_sk_pub_size = 0;
-
-  if (get_block_bytes((char **) &position,
-                      &remaining,
-                      &raw_sk_pub_data,
-                      &raw_sk_pub_size,
-                      KMYTH_DELIM_STORAGE_KEY_PUBLIC,
-                      strlen(KMYTH_DELIM_STORAGE_KEY_PUBLIC),
-                      KMYTH_DELIM_STORAGE_KEY_PRIVATE,
-                      strlen(KMYTH_DELIM_STORAGE_KEY_PRIVATE)))
+  if (get_block_view(&position, &remaining, &raw_sk_pub,
+                     KMYTH_DELIM_STORAGE_KEY_PUBLIC,
+                     strlen(KMYTH_DELIM_STORAGE_KEY_PUBLIC),
+                     KMYTH_DELIM_STORAGE_KEY_PRIVATE,
+                     strlen(KMYTH_DELIM_STORAGE_KEY_PRIVATE)))
   {
     kmyth_log(LOG_ERR, "get storage key public error ... exiting");
-    free(raw_pcr_select_list_data);
-    free(raw_sk_pub_data);
     return 1;
   }
 
-  // read in (parse out) 'raw' (encoded) private data block for the storage key
-  uint8_t *raw_sk_priv_data = NULL;
-  size_t raw_sk_priv_size = 0;
-
-  if (get_block_bytes((char **) &position,
-                      &remaining,
-                      &raw_sk_priv_data,
-                      &raw_sk_priv_size,
-                      KMYTH_DELIM_STORAGE_KEY_PRIVATE,
-                      strlen(KMYTH_DELIM_STORAGE_KEY_PRIVATE),
-                      KMYTH_DELIM_CIPHER_SUITE,
-                      strlen(KMYTH_DELIM_CIPHER_SUITE)))
+  if (get_block_view(&position, &remaining, &raw_sk_priv,
+                     KMYTH_DELIM_STORAGE_KEY_PRIVATE,
+                     strlen(KMYTH_DELIM_STORAGE_KEY_PRIVATE),
+                     KMYTH_DELIM_CIPHER_SUITE,
+                     strlen(KMYTH_DELIM_CIPHER_SUITE)))
   {
     kmyth_log(LOG_ERR, "get storage key private error ... exiting");
-    free(raw_pcr_select_list_data);
-    free(raw_sk_pub_data);
-    free(raw_sk_priv_data);
     return 1;
   }
 
-  // read in (parse out) cipher suite string data block for the storage key
-  uint8_t *raw_cipher_str_data = NULL;
-  size_t raw_cipher_str_size = 0;
-
-  if (get_block_bytes((char **) &position,
-                      &remaining,
-                      &raw_cipher_str_data,
-                      &raw_cipher_str_size,
-                      KMYTH_DELIM_CIPHER_SUITE,
-                      strlen(KMYTH_DELIM_CIPHER_SUITE),
-                      KMYTH_DELIM_SYM_KEY_PUBLIC,
-                      strlen(KMYTH_DELIM_SYM_KEY_PUBLIC)))
+  if (get_block_view(&position, &remaining, &raw_cipher_str,
+                     KMYTH_DELIM_CIPHER_SUITE,
+                     strlen(KMYTH_DELIM_CIPHER_SUITE),
+                     KMYTH_DELIM_SYM_KEY_PUBLIC,
+                     strlen(KMYTH_DELIM_SYM_KEY_PUBLIC)))
   {
     kmyth_log(LOG_ERR, "get cipher string error ... exiting");
-    free(raw_pcr_select_list_data);
-    free(raw_sk_pub_data);
-    free(raw_sk_priv_data);
-    free(raw_cipher_str_data);
     return 1;
   }
 
-  // create cipher suite struct
-  raw_cipher_str_data[raw_cipher_str_size - 1] = '\0';
-  temp_ski.cipher =
-    kmyth_get_cipher_t_from_string((char *) raw_cipher_str_data);
-  if (temp_ski.cipher.cipher_name == NULL)
-  {
-    kmyth_log(LOG_ERR, "cipher_t init error ... exiting");
-    free_ski(&temp_ski);
-    free(raw_pcr_select_list_data);
-    free(raw_sk_pub_data);
-    free(raw_sk_priv_data);
-    free(raw_cipher_str_data);
-    return 1;
-  }
-  free(raw_cipher_str_data);
-  raw_cipher_str_data = NULL;
-  // read in (parse out) 'raw' (encoded) public data block for the wrapping key
-  uint8_t *raw_sym_pub_data = NULL;
-  size_t raw_sym_pub_size = 0;
-
-  if (get_block_bytes((char **) &position,
-                      &remaining,
-                      &raw_sym_pub_data,
-                      &raw_sym_pub_size,
-                      KMYTH_DELIM_SYM_KEY_PUBLIC,
-                      strlen(KMYTH_DELIM_SYM_KEY_PUBLIC),
-                      KMYTH_DELIM_SYM_KEY_PRIVATE,
-                      strlen(KMYTH_DELIM_SYM_KEY_PRIVATE)))
+  if (get_block_view(&position, &remaining, &raw_sym_pub,
+                     KMYTH_DELIM_SYM_KEY_PUBLIC,
+                     strlen(KMYTH_DELIM_SYM_KEY_PUBLIC),
+                     KMYTH_DELIM_SYM_KEY_PRIVATE,
+                     strlen(KMYTH_DELIM_SYM_KEY_PRIVATE)))
   {
     kmyth_log(LOG_ERR, "get symmetric key public error ... exiting");
-    free_ski(&temp_ski);
-    free(raw_pcr_select_list_data);
-    free(raw_sk_pub_data);
-    free(raw_sk_priv_data);
-    free(raw_sym_pub_data);
     return 1;
   }
 
-  // read in (parse out) raw (encoded) private data block for the wrapping key
-  unsigned char *raw_sym_priv_data = NULL;
-  size_t raw_sym_priv_size = 0;
-
-  if (get_block_bytes((char **) &position,
-                      &remaining,
-                      &raw_sym_priv_data,
-                      &raw_sym_priv_size,
-                      KMYTH_DELIM_SYM_KEY_PRIVATE,
-                      strlen(KMYTH_DELIM_SYM_KEY_PRIVATE),
-                      KMYTH_DELIM_ENC_DATA, strlen(KMYTH_DELIM_ENC_DATA)))
+  if (get_block_view(&position, &remaining, &raw_sym_priv,
+                     KMYTH_DELIM_SYM_KEY_PRIVATE,
+                     strlen(KMYTH_DELIM_SYM_KEY_PRIVATE),
+                     KMYTH_DELIM_ENC_DATA, strlen(KMYTH_DELIM_ENC_DATA)))
   {
     kmyth_log(LOG_ERR, "get symmetric key private error ... exiting");
-    free_ski(&temp_ski);
-    free(raw_pcr_select_list_data);
-    free(raw_sk_pub_data);
-    free(raw_sk_priv_data);
-    free(raw_sym_pub_data);
-    free(raw_sym_priv_data);
     return 1;
   }
 
-  // read in (parse out) raw (encoded) encrypted data block
-  unsigned char *raw_enc_data = NULL;
-  size_t raw_enc_size = 0;
-
-  if (get_block_bytes((char **) &position,
-                      &remaining,
-                      &raw_enc_data, &raw_enc_size,
-                      KMYTH_DELIM_ENC_DATA,
-                      strlen(KMYTH_DELIM_ENC_DATA),
-                      KMYTH_DELIM_END_FILE, strlen(KMYTH_DELIM_END_FILE)))
+  if (get_block_view(&position, &remaining, &raw_enc,
+                     KMYTH_DELIM_ENC_DATA,
+                     strlen(KMYTH_DELIM_ENC_DATA),
+                     KMYTH_DELIM_END_FILE, strlen(KMYTH_DELIM_END_FILE)))
   {
     kmyth_log(LOG_ERR, "getting encrypted data error ... exiting");
-    free_ski(&temp_ski);
-    free(raw_pcr_select_list_data);
-    free(raw_sk_pub_data);
-    free(raw_sk_priv_data);
-    free(raw_sym_pub_data);
-    free(raw_sym_priv_data);
-    free(raw_enc_data);
     return 1;
   }
 
-  if (strncmp
-      ((char *) position, KMYTH_DELIM_END_FILE, strlen(KMYTH_DELIM_END_FILE))
-      || remaining != strlen(KMYTH_DELIM_END_FILE))
+  if (remaining != strlen(KMYTH_DELIM_END_FILE)
+      || memcmp(position, KMYTH_DELIM_END_FILE, remaining))
   {
     kmyth_log(LOG_ERR, "unable to find the end delimiter ... exiting");
-    free_ski(&temp_ski);
-    free(raw_pcr_select_list_data);
-    free(raw_sk_pub_data);
-    free(raw_sk_priv_data);
-    free(raw_sym_pub_data);
-    free(raw_sym_priv_data);
-    free(raw_enc_data);
     return 1;
   }
 
   //We are done with position. It was marking our place in input, which is freed by the caller
   position = NULL;
 
+  // create cipher suite struct (the block ends with a newline, which is
+  // replaced by the string terminator)
+  char *cipher_str = strndup((char *) raw_cipher_str.data,
+                             raw_cipher_str.size - 1);
+
+  if (cipher_str == NULL)
+  {
+    kmyth_log(LOG_ERR, "unable to allocate cipher string ... exiting");
+    return 1;
+  }
+  temp_ski.cipher = kmyth_get_cipher_t_from_string(cipher_str);
+  free(cipher_str);
+  if (temp_ski.cipher.cipher_name == NULL)
+  {
+    kmyth_log(LOG_ERR, "cipher_t init error ... exiting");
+    return 1;
+  }
+
   int retval = 0;
 
   // decode PCR selection list struct
@@ -217,63 +144,51 @@ int parse_ski_bytes(uint8_t * input, size_t input_length, Ski * output)
   size_t decoded_pcr_select_list_size = 0;
   size_t decoded_pcr_select_list_offset = 0;
 
-  retval |= decodeBase64Data(raw_pcr_select_list_data,
-                             raw_pcr_select_list_size,
+  retval |= decodeBase64Data(raw_pcr_select_list.data,
+                             raw_pcr_select_list.size,
                              &decoded_pcr_select_list_data,
                              &decoded_pcr_select_list_size);
-  free(raw_pcr_select_list_data);
-  raw_pcr_select_list_data = NULL;
 
   // decode public data block for storage key
   uint8_t *decoded_sk_pub_data = NULL;
   size_t decoded_sk_pub_size = 0;
   size_t decoded_sk_pub_offset = 0;
 
-  retval |= decodeBase64Data(raw_sk_pub_data,
-                             raw_sk_pub_size,
+  retval |= decodeBase64Data(raw_sk_pub.data,
+                             raw_sk_pub.size,
                              &decoded_sk_pub_data, &decoded_sk_pub_size);
-  free(raw_sk_pub_data);
-  raw_sk_pub_data = NULL;
 
   // decode encrypted private data block for storage key
   uint8_t *decoded_sk_priv_data = NULL;
   size_t decoded_sk_priv_size = 0;
   size_t decoded_sk_priv_offset = 0;
 
-  retval |= decodeBase64Data(raw_sk_priv_data,
-                             raw_sk_priv_size,
+  retval |= decodeBase64Data(raw_sk_priv.data,
+                             raw_sk_priv.size,
                              &decoded_sk_priv_data, &decoded_sk_priv_size);
-  free(raw_sk_priv_data);
-  raw_sk_priv_data = NULL;
 
   // decode public data block for symmetric wrapping key
   uint8_t *decoded_sym_pub_data = NULL;
   size_t decoded_sym_pub_size = 0;
   size_t decoded_sym_pub_offset = 0;
 
-  retval |= decodeBase64Data(raw_sym_pub_data,
-                             raw_sym_pub_size,
+  retval |= decodeBase64Data(raw_sym_pub.data,
+                             raw_sym_pub.size,
                              &decoded_sym_pub_data, &decoded_sym_pub_size);
-  free(raw_sym_pub_data);
-  raw_sym_pub_data = NULL;
 
   // decode encrypted private data block for symmetric wrapping key
   uint8_t *decoded_sym_priv_data = NULL;
   size_t decoded_sym_priv_size = 0;
   size_t decoded_sym_priv_offset = 0;
 
-  retval |= decodeBase64Data(raw_sym_priv_data,
-                             raw_sym_priv_size,
+  retval |= decodeBase64Data(raw_sym_priv.data,
+                             raw_sym_priv.size,
                              &decoded_sym_priv_data, &decoded_sym_priv_size);
-  free(raw_sym_priv_data);
-  raw_sym_priv_data = NULL;
 
   // decode the encrypted data block
-  retval |= decodeBase64Data(raw_enc_data,
-                             raw_enc_size, &temp_ski.enc_data,
+  retval |= decodeBase64Data(raw_enc.data,
+                             raw_enc.size, &temp_ski.enc_data,
                              &temp_ski.enc_data_size);
-  free(raw_enc_data);
-  raw_enc_data = NULL;
 
   if (retval)
   {
@@ -443,113 +358,33 @@ int create_ski_bytes(Ski input, uint8_t ** output, size_t * output_length)
     return 1;
   }
 
-  //Encode each portion of the file in base64
-  uint8_t *pcr64_select_data = NULL;
-  size_t pcr64_select_size = 0;
-  uint8_t *sk64_pub_data = NULL;
-  size_t sk64_pub_size = 0;
-  uint8_t *sk64_priv_data = NULL;
-  size_t sk64_priv_size = 0;
-  uint8_t *wk64_pub_data = NULL;
-  size_t wk64_pub_size = 0;
-  uint8_t *wk64_priv_data = NULL;
-  size_t wk64_priv_size = 0;
-  uint8_t *enc64_data = NULL;
-  size_t enc64_data_size = 0;
-
-  if (encodeBase64Data
-      (pcr_select_data, pcr_select_size, &pcr64_select_data, &pcr64_select_size)
-      || encodeBase64Data(sk_pub_data, sk_pub_size, &sk64_pub_data,
-                          &sk64_pub_size)
-      || encodeBase64Data(sk_priv_data, sk_priv_size, &sk64_priv_data,
-                          &sk64_priv_size)
-      || encodeBase64Data(wk_pub_data, wk_pub_size, &wk64_pub_data,
-                          &wk64_pub_size)
-      || encodeBase64Data(wk_priv_data, wk_priv_size, &wk64_priv_data,
-                          &wk64_priv_size)
-      || encodeBase64Data(input.enc_data, input.enc_data_size, &enc64_data,
-                          &enc64_data_size))
-  {
-    kmyth_log(LOG_ERR, "error base64 encoding ski string ... exiting");
-    free(pcr_select_data);
-    free(sk_pub_data);
-    free(sk_priv_data);
-    free(wk_pub_data);
-    free(wk_priv_data);
-    free(pcr64_select_data);
-    free(sk64_pub_data);
-    free(sk64_priv_data);
-    free(wk64_pub_data);
-    free(wk64_priv_data);
-    free(enc64_data);
-    return 1;
+  // Serialize the blocks - the output size is computed up front so that it
+  // is allocated once and each block is base64 encoded in place
+  block_spec_t blocks[] = {
+    {KMYTH_DELIM_PCR_SELECTION_LIST, pcr_select_data, pcr_select_size, false},
+    {KMYTH_DELIM_STORAGE_KEY_PUBLIC, sk_pub_data, sk_pub_size, false},
+    {KMYTH_DELIM_STORAGE_KEY_PRIVATE, sk_priv_data, sk_priv_size, false},
+    {KMYTH_DELIM_CIPHER_SUITE, (uint8_t *) input.cipher.cipher_name,
+     strlen(input.cipher.cipher_name), true},
+    {KMYTH_DELIM_SYM_KEY_PUBLIC, wk_pub_data, wk_pub_size, false},
+    {KMYTH_DELIM_SYM_KEY_PRIVATE, wk_priv_data, wk_priv_size, false},
+    {KMYTH_DELIM_ENC_DATA, input.enc_data, input.enc_data_size, false},
+  };
+  int retval = create_block_bytes(blocks, sizeof(blocks) / sizeof(blocks[0]),
+                                  KMYTH_DELIM_END_FILE, output, output_length);
+
+  if (retval)
+  {
+    kmyth_log(LOG_ERR, "error creating ski string ... exiting");
   }
 
   free(pcr_select_data);
-  pcr_select_data = NULL;
   free(sk_pub_data);
-  sk_pub_data = NULL;
   free(sk_priv_data);
-  sk_priv_data = NULL;
   free(wk_pub_data);
-  wk_pub_data = NULL;
   free(wk_priv_data);
-  wk_priv_data = NULL;
-
-  //At this point the data is all formatted, it's time to create the string
-
-  uint8_t *out = NULL;
-  size_t out_length = 0;
-
-  concat(&out, &out_length, (uint8_t *) KMYTH_DELIM_PCR_SELECTION_LIST,
-         strlen(KMYTH_DELIM_PCR_SELECTION_LIST));
-  concat(&out, &out_length, pcr64_select_data, pcr64_select_size);
-  free(pcr64_select_data);
-  pcr64_select_data = NULL;
-
-  concat(&out, &out_length, (uint8_t *) KMYTH_DELIM_STORAGE_KEY_PUBLIC,
-         strlen(KMYTH_DELIM_STORAGE_KEY_PUBLIC));
-  concat(&out, &out_length, sk64_pub_data, sk64_pub_size);
-  free(sk64_pub_data);
-  sk64_pub_data = NULL;
-
-  concat(&out, &out_length, (uint8_t *) KMYTH_DELIM_STORAGE_KEY_PRIVATE,
-         strlen(KMYTH_DELIM_STORAGE_KEY_PRIVATE));
-  concat(&out, &out_length, sk64_priv_data, sk64_priv_size);
-  free(sk64_priv_data);
-  sk64_priv_data = NULL;
-
-  concat(&out, &out_length, (uint8_t *) KMYTH_DELIM_CIPHER_SUITE,
-         strlen(KMYTH_DELIM_CIPHER_SUITE));
-  concat(&out, &out_length, (uint8_t *) input.cipher.cipher_name,
-         strlen(input.cipher.cipher_name));
-  concat(&out, &out_length, (uint8_t *) "\n", 1);
-
-  concat(&out, &out_length, (uint8_t *) KMYTH_DELIM_SYM_KEY_PUBLIC,
-         strlen(KMYTH_DELIM_SYM_KEY_PUBLIC));
-  concat(&out, &out_length, wk64_pub_data, wk64_pub_size);
-  free(wk64_pub_data);
-  wk64_pub_data = NULL;
-
-  concat(&out, &out_length, (uint8_t *) KMYTH_DELIM_SYM_KEY_PRIVATE,
-         strlen(KMYTH_DELIM_SYM_KEY_PRIVATE));
-  concat(&out, &out_length, wk64_priv_data, wk64_priv_size);
-  free(wk64_priv_data);
-  wk64_priv_data = NULL;
-
-  concat(&out, &out_length, (uint8_t *) KMYTH_DELIM_ENC_DATA,
-         strlen(KMYTH_DELIM_ENC_DATA));
-  concat(&out, &out_length, enc64_data, enc64_data_size);
-  free(enc64_data);
-  enc64_data = NULL;
-
-  concat(&out, &out_length, (uint8_t *) KMYTH_DELIM_END_FILE,
-         strlen(KMYTH_DELIM_END_FILE));
-
-  *output = out;
-  *output_length = out_length;
 
-  return 0;
+  return retval;
 }
 
 void free_ski(Ski * ski)
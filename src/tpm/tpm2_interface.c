@@ -7,6 +7,7 @@
 
 #include "tpm2_interface.h"
 
+#include <pthread.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -30,6 +31,67 @@ const char *simulator_manufacturers[] = { "IBM",  // https://sourceforge.net/pro
   NULL
 };
 
+static int connect_tpm2(TSS2_SYS_CONTEXT ** sapi_ctx);
+
+/*
+ * TPM access queue: a ticket lock that hands the TPM to waiting threads in
+ * the order they asked for it. It is re-entrant for the thread holding it
+ * (depth counts nested acquisitions by the owner).
+ */
+static pthread_mutex_t tpm_queue_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t tpm_queue_cond = PTHREAD_COND_INITIALIZER;
+static unsigned long tpm_queue_next_ticket = 0;
+static unsigned long tpm_queue_now_serving = 0;
+static pthread_t tpm_queue_owner;
+static size_t tpm_queue_depth = 0;
+
+//############################################################################
+// acquire_tpm_queue()
+//############################################################################
+void acquire_tpm_queue(void)
+{
+  pthread_mutex_lock(&tpm_queue_mutex);
+
+  if (tpm_queue_depth > 0 && pthread_equal(tpm_queue_owner, pthread_self()))
+  {
+    tpm_queue_depth++;
+    pthread_mutex_unlock(&tpm_queue_mutex);
+    return;
+  }
+
+  unsigned long ticket = tpm_queue_next_ticket++;
+
+  while (ticket != tpm_queue_now_serving)
+  {
+    pthread_cond_wait(&tpm_queue_cond, &tpm_queue_mutex);
+  }
+  tpm_queue_owner = pthread_self();
+  tpm_queue_depth = 1;
+
+  pthread_mutex_unlock(&tpm_queue_mutex);
+}
+
+//############################################################################
+// release_tpm_queue()
+//############################################################################
+void release_tpm_queue(void)
+{
+  pthread_mutex_lock(&tpm_queue_mutex);
+
+  // ignore a release by a thread that does not hold the TPM
+  if (tpm_queue_depth > 0 && pthread_equal(tpm_queue_owner, pthread_self()))
+  {
+    tpm_queue_depth--;
+    if (tpm_queue_depth == 0)
+    {
+      tpm_queue_now_serving++;
+      pthread_cond_broadcast(&tpm_queue_cond);
+    }
+  }
+
+  pthread_mutex_unlock(&tpm_queue_mutex);
+}
+
 //############################################################################
 // init_tpm2_connection()
 //############################################################################
@@ -43,6 +105,24 @@ int init_tpm2_connection(TSS2_SYS_CONTEXT ** sapi_ctx)
     return 1;
   }
 
+  // Wait for this thread's turn to use the TPM. It is held until the
+  // connection is released by free_tpm2_resources().
+  acquire_tpm_queue();
+  if (connect_tpm2(sapi_ctx))
+  {
+    *sapi_ctx = NULL;
+    release_tpm_queue();
+    return 1;
+  }
+
+  return 0;
+}
+
+//############################################################################
+// connect_tpm2()
+//############################################################################
+static int connect_tpm2(TSS2_SYS_CONTEXT ** sapi_ctx)
+{
   // Step 1: Initialize TCTI context for connection to resource manager
   TSS2_TCTI_CONTEXT *tcti_ctx = NULL;
 
@@ -204,7 +284,8 @@ int init_sapi(TSS2_SYS_CONTEXT ** sapi_ctx, TSS2_TCTI_CONTEXT * tcti_ctx)
   {
     kmyth_log(LOG_ERR, "Tss2_Sys_Initialize(): rc = 0x%08X, %s", rc,
               getErrorString(rc));
-    free(sapi_ctx);
+    free(*sapi_ctx);
+    *sapi_ctx = NULL;
     return 1;
   }
   kmyth_log(LOG_DEBUG, "initialized SAPI context");
@@ -300,6 +381,9 @@ int free_tpm2_resources(TSS2_SYS_CONTEXT ** sapi_ctx)
   free(tcti_ctx);
   kmyth_log(LOG_DEBUG, "cleaned up TCTI context");
 
+  // let the next queued thread use the TPM
+  release_tpm_queue();
+
   return retval;
 }
 
@@ -1153,6 +1237,44 @@ int apply_policy(TSS2_SYS_CONTEXT * sapi_ctx,
   return 0;
 }
 
+//############################################################################
+// restart_policy_auth_session()
+//############################################################################
+int restart_policy_auth_session(TSS2_SYS_CONTEXT * sapi_ctx,
+                                SESSION * policySession)
+{
+  if (policySession == NULL)
+  {
+    kmyth_log(LOG_ERR, "no session ... exiting");
+    return 1;
+  }
+
+  // only a (non-trial) policy session is re-used for authorization
+  if (policySession->sessionType != TPM2_SE_POLICY)
+  {
+    kmyth_log(LOG_ERR, "invalid session type ... exiting");
+    return 1;
+  }
+
+  // reset the session's policyDigest - command requires no authorization
+  TSS2L_SYS_AUTH_COMMAND const *nullCmdAuths = NULL;
+  TSS2L_SYS_AUTH_RESPONSE *nullRspAuths = NULL;
+  TPM2_RC rc = Tss2_Sys_PolicyRestart(sapi_ctx,
+                                      policySession->sessionHandle,
+                                      nullCmdAuths, nullRspAuths);
+
+  if (rc != TPM2_RC_SUCCESS)
+  {
+    kmyth_log(LOG_ERR, "Tss2_Sys_PolicyRestart(): rc = 0x%08X, %s", rc,
+              getErrorString(rc));
+    return 1;
+  }
+  kmyth_log(LOG_DEBUG, "restarted policy session (0x%08X)",
+            policySession->sessionHandle);
+
+  return 0;
+}
+
 //############################################################################
 // create_caller_nonce()
 //############################################################################
@@ -0,0 +1,54 @@
+/**
+ * @file  aes_gcm_seg_test.h
+ *
+ * Provides unit tests for the kmyth segmented AES/GCM cipher functionality
+ * implemented in src/cipher/aes_gcm_seg.c
+ */
+
+#ifndef AES_GCM_SEG_TEST_H
+#define AES_GCM_SEG_TEST_H
+
+#include <CUnit/CUnit.h>
+
+//---------------------- Test Suite Setup ------------------------------------
+
+/**
+ * This function adds all of the tests contained in
+ * test/src/cipher/aes_gcm_seg_test.c to a test suite parameter passed in by
+ * the caller. This allows a top-level 'test-runner' application to include
+ * them in the set of tests that it runs.
+ *
+ * @param[out] suite  CUnit test suite that this function will add all of
+ *                    the kmyth segmented AES/GCM cipher tests to.
+ *
+ * @return     0 on success, 1 on error
+ */
+int aes_gcm_seg_add_tests(CU_pSuite suite);
+
+//---------------------- Tests -----------------------------------------------
+
+/**
+ * Tests segmented AES/GCM encryption and decryption (aes_gcm_seg_encrypt()
+ * and aes_gcm_seg_decrypt()) for empty, single segment, and multi-segment
+ * payloads
+ */
+void test_gcm_seg_encrypt_decrypt(void);
+
+/**
+ * Tests that modifying the key, the header, or a segment's ciphertext or
+ * tag causes segmented AES/GCM decryption to fail
+ */
+void test_gcm_seg_modification(void);
+
+/**
+ * Tests that truncating, extending, or reordering segments causes
+ * segmented AES/GCM decryption to fail
+ */
+void test_gcm_seg_truncation_reordering(void);
+
+/**
+ * Tests segmented AES/GCM handling of invalid parameters
+ */
+void test_gcm_seg_parameter_limits(void);
+
+#endif
@@ -0,0 +1,48 @@
+/**
+ * @file  aes_gcm_siv_test.h
+ *
+ * Provides unit tests for the kmyth AES-GCM-SIV cipher functionality
+ * implemented in src/cipher/aes_gcm_siv.c
+ */
+
+#ifndef AES_GCM_SIV_TEST_H
+#define AES_GCM_SIV_TEST_H
+
+#include <CUnit/CUnit.h>
+
+//---------------------- Test Suite Setup ------------------------------------
+
+/**
+ * This function adds all of the tests contained in
+ * test/src/cipher/aes_gcm_siv_test.c to a test suite parameter passed in by
+ * the caller. This allows a top-level 'test-runner' application to include
+ * them in the set of tests that it runs.
+ *
+ * @param[out] suite  CUnit test suite that this function will add all of
+ *                    the kmyth AES-GCM-SIV cipher tests to.
+ *
+ * @return     0 on success, 1 on error
+ */
+int aes_gcm_siv_add_tests(CU_pSuite suite);
+
+//---------------------- Tests -----------------------------------------------
+
+/**
+ * Tests AES-GCM-SIV encryption and decryption (aes_gcm_siv_encrypt() and
+ * aes_gcm_siv_decrypt()) for empty and non-empty payloads, or that both
+ * fail if the OpenSSL version in use does not provide AES-GCM-SIV
+ */
+void test_aes_gcm_siv_encrypt_decrypt(void);
+
+/**
+ * Tests that modifying the key, nonce, ciphertext, or tag causes
+ * AES-GCM-SIV decryption to fail
+ */
+void test_aes_gcm_siv_modification(void);
+
+/**
+ * Tests AES-GCM-SIV handling of invalid parameters
+ */
+void test_aes_gcm_siv_parameter_limits(void);
+
+#endif
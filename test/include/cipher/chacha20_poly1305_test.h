@@ -0,0 +1,48 @@
+/**
+ * @file  chacha20_poly1305_test.h
+ *
+ * Provides unit tests for the kmyth ChaCha20-Poly1305 cipher functionality
+ * implemented in src/cipher/chacha20_poly1305.c
+ */
+
+#ifndef CHACHA20_POLY1305_TEST_H
+#define CHACHA20_POLY1305_TEST_H
+
+#include <CUnit/CUnit.h>
+
+//---------------------- Test Suite Setup ------------------------------------
+
+/**
+ * This function adds all of the tests contained in
+ * test/src/cipher/chacha20_poly1305_test.c to a test suite parameter passed
+ * in by the caller. This allows a top-level 'test-runner' application to include
+ * them in the set of tests that it runs.
+ *
+ * @param[out] suite  CUnit test suite that this function will add all of
+ *                    the kmyth ChaCha20-Poly1305 cipher tests to.
+ *
+ * @return     0 on success, 1 on error
+ */
+int chacha20_poly1305_add_tests(CU_pSuite suite);
+
+//---------------------- Tests -----------------------------------------------
+
+/**
+ * Tests ChaCha20-Poly1305 encryption and decryption
+ * (chacha20_poly1305_encrypt() and chacha20_poly1305_decrypt()) for empty
+ * and non-empty payloads
+ */
+void test_chacha20_poly1305_encrypt_decrypt(void);
+
+/**
+ * Tests that modifying the key, nonce, ciphertext, or tag causes
+ * ChaCha20-Poly1305 decryption to fail
+ */
+void test_chacha20_poly1305_modification(void);
+
+/**
+ * Tests ChaCha20-Poly1305 handling of invalid parameters
+ */
+void test_chacha20_poly1305_parameter_limits(void);
+
+#endif
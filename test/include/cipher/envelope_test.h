@@ -0,0 +1,39 @@
+/**
+ * @file  envelope_test.h
+ *
+ * Provides unit tests for the kmyth envelope (KEK) mode functionality
+ * implemented in tpm2/src/cipher/envelope.c
+ */
+
+#ifndef ENVELOPE_TEST_H
+#define ENVELOPE_TEST_H
+
+/**
+ * This function adds all of the tests contained in
+ * tpm2/test/cipher/envelope_test.c to a test suite parameter passed in by the
+ * caller. This allows a top-level 'test-runner' application to include them
+ * in the set of tests that it runs.
+ *
+ * @param[out] suite  CUnit test suite that this function will add all of
+ *                    the kmyth envelope mode tests to.
+ *
+ * @return     0 on success, 1 on error
+ */
+int envelope_add_tests(CU_pSuite suite);
+
+/**
+ * Tests for HKDF data key derivation in derive_envelope_key()
+ */
+void test_derive_envelope_key(void);
+
+/**
+ * Tests for creating envelopes in kmyth_envelope_encrypt()
+ */
+void test_kmyth_envelope_encrypt(void);
+
+/**
+ * Tests for opening envelopes in kmyth_envelope_decrypt()
+ */
+void test_kmyth_envelope_decrypt(void);
+
+#endif
@@ -0,0 +1,52 @@
+/**
+ * @file  socket_util_test.h
+ *
+ * Provides unit tests for the socket utility functions implemented in
+ * src/network/socket_util.c
+ */
+
+#ifndef SOCKET_UTIL_TEST__H
+#define SOCKET_UTIL_TEST__H
+
+/**
+ * This function adds all of the tests contained in socket_util_test.c to a
+ * test suite parameter passed in by the caller. This allows a top-level
+ * 'test-runner' application to include them in the set of tests that it runs
+ *
+ * @param[out] suite  CUnit test suite that this function will add all of the
+ *                    socket utility tests to
+ *
+ * @return     0 on success, 1 on failure
+ */
+int socket_util_add_tests(CU_pSuite suite);
+
+//****************************************************************************
+// Tests
+//****************************************************************************
+
+/**
+ * Tests for racing connection attempts in connect_client_socket()
+ */
+void test_connect_client_socket(void);
+
+/**
+ * Tests for resolving and connecting in setup_client_socket()
+ */
+void test_setup_client_socket(void);
+
+/**
+ * Tests for sending gathered messages in send_socket_frame()
+ */
+void test_send_socket_frame(void);
+
+/**
+ * Tests for exact-length receives in recv_socket_exact()
+ */
+void test_recv_socket_exact(void);
+
+/**
+ * Tests for TCP latency options in set_socket_tcp_options()
+ */
+void test_set_socket_tcp_options(void);
+
+#endif
@@ -39,6 +39,12 @@ void test_tls_set_context(void);
  */
 void test_get_key_from_tls_server(void);
 
+/**
+ * Tests for getting a length-prefixed response from a TLS server in
+ * get_framed_key_from_tls_server()
+ */
+void test_get_framed_key_from_tls_server(void);
+
 /**
  * Tests for getting a key from a KMIP server in get_key_from_kmip_server()
  */
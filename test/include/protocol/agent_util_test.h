@@ -0,0 +1,48 @@
+/**
+ * @file  agent_util_test.h
+ *
+ * Provides unit tests for the kmyth-agent protocol functions implemented in
+ * src/protocol/agent_util.c
+ */
+
+#ifndef AGENT_UTIL_TEST_H
+#define AGENT_UTIL_TEST_H
+
+/**
+ * This function adds all of the tests contained in agent_util_test.c to a
+ * test suite parameter passed in by the caller. This allows a top-level
+ * 'test-runner' application to include them in the set of tests that it runs
+ *
+ * @param[out] suite  CUnit test suite that this function will add all of the
+ *                    agent protocol tests to
+ *
+ * @return     0 on success, 1 on failure
+ */
+int agent_util_add_tests(CU_pSuite suite);
+
+//****************************************************************************
+// Tests
+//****************************************************************************
+
+/**
+ * Tests for message framing in send_agent_message() and
+ * recv_agent_message()
+ */
+void test_send_recv_agent_message(void);
+
+/**
+ * Tests for build_agent_unseal_request() and parse_agent_unseal_request()
+ */
+void test_agent_unseal_request(void);
+
+/**
+ * Tests for the kmyth_agent_unseal() client (against a mock agent)
+ */
+void test_kmyth_agent_unseal(void);
+
+/**
+ * Tests for the kmyth_agent_flush() client (against a mock agent)
+ */
+void test_kmyth_agent_flush(void);
+
+#endif
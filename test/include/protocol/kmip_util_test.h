@@ -0,0 +1,45 @@
+/**
+ * @file  kmip_util_test.h
+ *
+ * Provides unit tests for the KMIP protocol utility functions implemented in
+ * src/protocol/kmip_util.c
+ */
+
+#ifndef KMIP_UTIL_TEST_H
+#define KMIP_UTIL_TEST_H
+
+/**
+ * This function adds all of the tests contained in kmip_util_test.c to a
+ * test suite parameter passed in by the caller. This allows a top-level
+ * 'test-runner' application to include them in the set of tests that it runs
+ *
+ * @param[out] suite  CUnit test suite that this function will add all of the
+ *                    KMIP utility tests to
+ *
+ * @return     0 on success, 1 on failure
+ */
+int kmip_util_add_tests(CU_pSuite suite);
+
+//****************************************************************************
+// Tests
+//****************************************************************************
+
+/**
+ * Tests for single Get messages (build/parse_kmip_get_request() and
+ * build/parse_kmip_get_response())
+ */
+void test_kmip_get_message(void);
+
+/**
+ * Tests for build_kmip_get_batch_request() and
+ * parse_kmip_get_batch_request()
+ */
+void test_kmip_get_batch_request(void);
+
+/**
+ * Tests for build_kmip_get_batch_response() and
+ * parse_kmip_get_batch_response()
+ */
+void test_kmip_get_batch_response(void);
+
+#endif
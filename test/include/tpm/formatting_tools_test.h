@@ -108,9 +108,19 @@ void test_create_ski_bytes(void);
 void test_free_ski(void);
 void test_get_default_ski(void);
 void test_get_block_bytes(void);
+void test_find_delim(void);
+void test_get_block_view(void);
+void test_block_stream(void);
+void test_parse_pcrs_string(void);
+void test_parse_unsigned_string(void);
 void test_create_nkl_bytes(void);
 void test_encodeBase64Data(void);
 void test_decodeBase64Data(void);
+void test_getBase64EncodedSize(void);
+void test_encodeBase64DataToBuffer(void);
+void test_get_block_bytes_size(void);
+void test_create_block_bytes(void);
+void test_write_block_bytes_to_fd(void);
 void test_concat(void);
 
 #endif
@@ -26,8 +26,14 @@ int kmyth_seal_unseal_impl_add_tests(CU_pSuite suite);
 //********************************************************************************
 void test_tpm2_kmyth_seal(void);
 void test_tpm2_kmyth_unseal(void);
+void test_tpm2_kmyth_unseal_multi(void);
+void test_tpm2_kmyth_concurrent_seal_unseal(void);
 void test_tpm2_kmyth_seal_file(void);
 void test_tpm2_kmyth_unseal_file(void);
+void test_tpm2_kmyth_create_kek(void);
+void test_tpm2_kmyth_envelope_seal(void);
+void test_tpm2_kmyth_envelope_unseal(void);
+void test_tpm2_kmyth_reseal(void);
 void test_tpm2_kmyth_seal_data(void);
 void test_tpm2_kmyth_unseal_data(void);
 #endif
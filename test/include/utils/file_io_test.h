@@ -49,6 +49,18 @@ void test_read_bytes_from_file(void);
  */
 void test_write_bytes_to_file(void);
 
+/**
+ * Tests for the functionality to atomically replace a file implemented
+ * in function write_bytes_to_file_atomic()
+ */
+void test_write_bytes_to_file_atomic(void);
+
+/**
+ * Tests for the functionality to write bytes to a sealed memfd implemented
+ * in function write_bytes_to_memfd()
+ */
+void test_write_bytes_to_memfd(void);
+
 /**
  * Tests for the functionality to print information to the STDOUT stream
  * implemented in function print_to_stdout()
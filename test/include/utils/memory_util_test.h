@@ -37,6 +37,13 @@ void test_kmyth_clear(void);
  */
 void test_kmyth_clear_and_free(void);
 
+/**
+ * Tests for the secure arena allocation functionality implemented in
+ * function kmyth_secure_alloc() (and the arena-aware release performed
+ * by kmyth_clear_and_free())
+ */
+void test_kmyth_secure_alloc(void);
+
 /**
  * Tests for the secure memory set functionality implemented
  * in function secure_memset()
@@ -0,0 +1,245 @@
+//############################################################################
+// aes_gcm_seg_test.c
+//
+// Tests for kmyth segmented AES/GCM functionality in src/cipher/aes_gcm_seg.c
+//############################################################################
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <CUnit/CUnit.h>
+
+#include "aes_gcm_seg_test.h"
+#include "cipher/aes_gcm_seg.h"
+#include "memory_util.h"
+
+//----------------------------------------------------------------------------
+// aes_gcm_seg_add_tests()
+//----------------------------------------------------------------------------
+int aes_gcm_seg_add_tests(CU_pSuite suite)
+{
+  if (NULL == CU_add_test(suite, "Test AES/GCM-SEG encryption/decryption",
+                          test_gcm_seg_encrypt_decrypt))
+  {
+    return 1;
+  }
+
+  if (NULL == CU_add_test(suite, "Test AES/GCM-SEG modification",
+                          test_gcm_seg_modification))
+  {
+    return 1;
+  }
+
+  if (NULL == CU_add_test(suite, "Test AES/GCM-SEG truncation/reordering",
+                          test_gcm_seg_truncation_reordering))
+  {
+    return 1;
+  }
+
+  if (NULL == CU_add_test(suite, "Test AES/GCM-SEG parameter limits",
+                          test_gcm_seg_parameter_limits))
+  {
+    return 1;
+  }
+
+  return 0;
+}
+
+//----------------------------------------------------------------------------
+// test_gcm_seg_encrypt_decrypt()
+//----------------------------------------------------------------------------
+void test_gcm_seg_encrypt_decrypt(void)
+{
+  unsigned char key[32] = { 0 };
+  size_t sizes[] = { 0, 1, GCM_SEG_SIZE, (3 * GCM_SEG_SIZE) + 5 };
+  size_t max_size = sizes[3];
+  unsigned char *plaintext = malloc(max_size);
+
+  for (size_t i = 0; i < max_size; i++)
+  {
+    plaintext[i] = (unsigned char) (i * 7);
+  }
+
+  for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+  {
+    size_t segment_count = (sizes[i] + GCM_SEG_SIZE - 1) / GCM_SEG_SIZE;
+    unsigned char *ciphertext = NULL;
+    unsigned char *decrypt = NULL;
+    size_t ciphertext_len = 0;
+    size_t decrypt_len = 0;
+
+    if (segment_count == 0)
+    {
+      segment_count = 1;
+    }
+
+    CU_ASSERT(aes_gcm_seg_encrypt(key, sizeof(key), plaintext, sizes[i],
+                                  &ciphertext, &ciphertext_len) == 0);
+    CU_ASSERT(ciphertext_len == GCM_SEG_HEADER_LEN + sizes[i] +
+              segment_count * GCM_TAG_LEN);
+    CU_ASSERT(aes_gcm_seg_decrypt(key, sizeof(key), ciphertext,
+                                  ciphertext_len, &decrypt,
+                                  &decrypt_len) == 0);
+    CU_ASSERT(decrypt_len == sizes[i]);
+    CU_ASSERT(memcmp(plaintext, decrypt, decrypt_len) == 0);
+
+    free(ciphertext);
+    kmyth_clear_and_free(decrypt, decrypt_len);
+  }
+
+  free(plaintext);
+}
+
+//----------------------------------------------------------------------------
+// test_gcm_seg_modification()
+//----------------------------------------------------------------------------
+void test_gcm_seg_modification(void)
+{
+  unsigned char key[32] = { 0 };
+  size_t plaintext_len = (2 * GCM_SEG_SIZE) + 100;
+  unsigned char *plaintext = calloc(plaintext_len, 1);
+  unsigned char *ciphertext = NULL;
+  unsigned char *decrypt = NULL;
+  size_t ciphertext_len = 0;
+  size_t decrypt_len = 0;
+
+  CU_ASSERT(aes_gcm_seg_encrypt(key, sizeof(key), plaintext, plaintext_len,
+                                &ciphertext, &ciphertext_len) == 0);
+
+  // offsets of: base IV, second segment ciphertext, last segment tag
+  size_t offsets[] = { 0,
+    GCM_SEG_HEADER_LEN + GCM_SEG_SIZE + GCM_TAG_LEN + 10,
+    ciphertext_len - 1
+  };
+
+  for (size_t i = 0; i < sizeof(offsets) / sizeof(offsets[0]); i++)
+  {
+    ciphertext[offsets[i]] ^= 1;
+    CU_ASSERT(aes_gcm_seg_decrypt(key, sizeof(key), ciphertext,
+                                  ciphertext_len, &decrypt,
+                                  &decrypt_len) == 1);
+    CU_ASSERT(decrypt == NULL);
+    ciphertext[offsets[i]] ^= 1;
+  }
+
+  // modify a single key bit
+  key[0] ^= 1;
+  CU_ASSERT(aes_gcm_seg_decrypt(key, sizeof(key), ciphertext, ciphertext_len,
+                                &decrypt, &decrypt_len) == 1);
+  key[0] ^= 1;
+
+  // unmodified input still decrypts
+  CU_ASSERT(aes_gcm_seg_decrypt(key, sizeof(key), ciphertext, ciphertext_len,
+                                &decrypt, &decrypt_len) == 0);
+
+  kmyth_clear_and_free(decrypt, decrypt_len);
+  free(ciphertext);
+  free(plaintext);
+}
+
+//----------------------------------------------------------------------------
+// test_gcm_seg_truncation_reordering()
+//----------------------------------------------------------------------------
+void test_gcm_seg_truncation_reordering(void)
+{
+  unsigned char key[32] = { 0 };
+  size_t plaintext_len = 3 * GCM_SEG_SIZE;
+  size_t stride = GCM_SEG_SIZE + GCM_TAG_LEN;
+  unsigned char *plaintext = malloc(plaintext_len);
+  unsigned char *ciphertext = NULL;
+  unsigned char *decrypt = NULL;
+  size_t ciphertext_len = 0;
+  size_t decrypt_len = 0;
+
+  for (size_t i = 0; i < plaintext_len; i++)
+  {
+    plaintext[i] = (unsigned char) (i / GCM_SEG_SIZE);
+  }
+
+  CU_ASSERT(aes_gcm_seg_encrypt(key, sizeof(key), plaintext, plaintext_len,
+                                &ciphertext, &ciphertext_len) == 0);
+
+  // drop the last segment
+  CU_ASSERT(aes_gcm_seg_decrypt(key, sizeof(key), ciphertext,
+                                ciphertext_len - stride, &decrypt,
+                                &decrypt_len) == 1);
+
+  // drop the last segment and rewrite the header's plaintext length to match
+  unsigned char *truncated = malloc(ciphertext_len);
+
+  memcpy(truncated, ciphertext, ciphertext_len - stride);
+  truncated[GCM_SEG_HEADER_LEN - 3] ^= 0x10;  // 0x300000 -> 0x200000 bytes
+  CU_ASSERT(aes_gcm_seg_decrypt(key, sizeof(key), truncated,
+                                ciphertext_len - stride, &decrypt,
+                                &decrypt_len) == 1);
+
+  // append a copy of the last segment
+  unsigned char *extended = malloc(ciphertext_len + stride);
+
+  memcpy(extended, ciphertext, ciphertext_len);
+  memcpy(extended + ciphertext_len, ciphertext + ciphertext_len - stride,
+         stride);
+  CU_ASSERT(aes_gcm_seg_decrypt(key, sizeof(key), extended,
+                                ciphertext_len + stride, &decrypt,
+                                &decrypt_len) == 1);
+
+  // swap the first and second segments
+  unsigned char *reordered = malloc(ciphertext_len);
+
+  memcpy(reordered, ciphertext, ciphertext_len);
+  memcpy(reordered + GCM_SEG_HEADER_LEN,
+         ciphertext + GCM_SEG_HEADER_LEN + stride, stride);
+  memcpy(reordered + GCM_SEG_HEADER_LEN + stride,
+         ciphertext + GCM_SEG_HEADER_LEN, stride);
+  CU_ASSERT(aes_gcm_seg_decrypt(key, sizeof(key), reordered, ciphertext_len,
+                                &decrypt, &decrypt_len) == 1);
+  CU_ASSERT(decrypt == NULL);
+
+  free(reordered);
+  free(extended);
+  free(truncated);
+  free(ciphertext);
+  free(plaintext);
+}
+
+//----------------------------------------------------------------------------
+// test_gcm_seg_parameter_limits()
+//----------------------------------------------------------------------------
+void test_gcm_seg_parameter_limits(void)
+{
+  unsigned char key[32] = { 0 };
+  unsigned char plaintext[16] = { 0 };
+  unsigned char *ciphertext = NULL;
+  unsigned char *decrypt = NULL;
+  size_t ciphertext_len = 0;
+  size_t decrypt_len = 0;
+
+  // NULL or empty key, NULL input
+  CU_ASSERT(aes_gcm_seg_encrypt(NULL, sizeof(key), plaintext,
+                                sizeof(plaintext), &ciphertext,
+                                &ciphertext_len) == 1);
+  CU_ASSERT(aes_gcm_seg_encrypt(key, 0, plaintext, sizeof(plaintext),
+                                &ciphertext, &ciphertext_len) == 1);
+  CU_ASSERT(aes_gcm_seg_encrypt(key, sizeof(key), NULL, sizeof(plaintext),
+                                &ciphertext, &ciphertext_len) == 1);
+
+  // unsupported key length
+  CU_ASSERT(aes_gcm_seg_encrypt(key, 20, plaintext, sizeof(plaintext),
+                                &ciphertext, &ciphertext_len) == 1);
+
+  CU_ASSERT(aes_gcm_seg_encrypt(key, sizeof(key), plaintext,
+                                sizeof(plaintext), &ciphertext,
+                                &ciphertext_len) == 0);
+
+  // input shorter than a header and one tag
+  CU_ASSERT(aes_gcm_seg_decrypt(key, sizeof(key), ciphertext,
+                                GCM_SEG_HEADER_LEN + GCM_TAG_LEN - 1,
+                                &decrypt, &decrypt_len) == 1);
+
+  // zero segment size in header
+  memset(ciphertext + GCM_IV_LEN, 0, 4);
+  CU_ASSERT(aes_gcm_seg_decrypt(key, sizeof(key), ciphertext,
+                                ciphertext_len, &decrypt, &decrypt_len) == 1);
+
+  free(ciphertext);
+}
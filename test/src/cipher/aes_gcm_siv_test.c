@@ -0,0 +1,180 @@
+//############################################################################
+// aes_gcm_siv_test.c
+//
+// Tests for kmyth AES-GCM-SIV functionality in src/cipher/aes_gcm_siv.c
+//############################################################################
+
+#include <stdlib.h>
+#include <string.h>
+#include <CUnit/CUnit.h>
+
+#include "aes_gcm_siv_test.h"
+#include "cipher/aes_gcm_siv.h"
+#include "memory_util.h"
+
+//----------------------------------------------------------------------------
+// aes_gcm_siv_add_tests()
+//----------------------------------------------------------------------------
+int aes_gcm_siv_add_tests(CU_pSuite suite)
+{
+  if (NULL == CU_add_test(suite, "Test AES-GCM-SIV encryption/decryption",
+                          test_aes_gcm_siv_encrypt_decrypt))
+  {
+    return 1;
+  }
+
+  if (NULL == CU_add_test(suite, "Test AES-GCM-SIV modification",
+                          test_aes_gcm_siv_modification))
+  {
+    return 1;
+  }
+
+  if (NULL == CU_add_test(suite, "Test AES-GCM-SIV parameter limits",
+                          test_aes_gcm_siv_parameter_limits))
+  {
+    return 1;
+  }
+
+  return 0;
+}
+
+//----------------------------------------------------------------------------
+// test_aes_gcm_siv_encrypt_decrypt()
+//----------------------------------------------------------------------------
+void test_aes_gcm_siv_encrypt_decrypt(void)
+{
+  unsigned char key[32] = { 0 };
+  unsigned char plaintext[1000];
+  size_t sizes[] = { 0, 1, 64, sizeof(plaintext) };
+
+  for (size_t i = 0; i < sizeof(plaintext); i++)
+  {
+    plaintext[i] = (unsigned char) i;
+  }
+
+#ifndef KMYTH_AES_GCM_SIV_SUPPORTED
+  // OpenSSL older than 3.2 does not provide AES-GCM-SIV
+  unsigned char *unsupported = NULL;
+  size_t unsupported_len = 0;
+
+  CU_ASSERT(aes_gcm_siv_encrypt(key, sizeof(key), plaintext,
+                                sizeof(plaintext), &unsupported,
+                                &unsupported_len) == 1);
+  return;
+#endif
+
+  for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+  {
+    unsigned char *ciphertext = NULL;
+    unsigned char *decrypt = NULL;
+    size_t ciphertext_len = 0;
+    size_t decrypt_len = 0;
+
+    CU_ASSERT(aes_gcm_siv_encrypt(key, sizeof(key), plaintext,
+                                  sizes[i], &ciphertext,
+                                  &ciphertext_len) == 0);
+    CU_ASSERT(ciphertext_len == GCM_SIV_NONCE_LEN + sizes[i] +
+              GCM_SIV_TAG_LEN);
+    CU_ASSERT(aes_gcm_siv_decrypt(key, sizeof(key), ciphertext,
+                                  ciphertext_len, &decrypt,
+                                  &decrypt_len) == 0);
+    CU_ASSERT(decrypt_len == sizes[i]);
+    CU_ASSERT(memcmp(plaintext, decrypt, decrypt_len) == 0);
+
+    free(ciphertext);
+    kmyth_clear_and_free(decrypt, decrypt_len);
+  }
+}
+
+//----------------------------------------------------------------------------
+// test_aes_gcm_siv_modification()
+//----------------------------------------------------------------------------
+void test_aes_gcm_siv_modification(void)
+{
+#ifndef KMYTH_AES_GCM_SIV_SUPPORTED
+  return;
+#endif
+
+  unsigned char key[32] = { 0 };
+  unsigned char plaintext[64] = { 0 };
+  unsigned char *ciphertext = NULL;
+  unsigned char *decrypt = NULL;
+  size_t ciphertext_len = 0;
+  size_t decrypt_len = 0;
+
+  CU_ASSERT(aes_gcm_siv_encrypt(key, sizeof(key), plaintext,
+                                sizeof(plaintext), &ciphertext,
+                                &ciphertext_len) == 0);
+
+  // offsets of: nonce, ciphertext, tag
+  size_t offsets[] = { 0, GCM_SIV_NONCE_LEN + 10,
+    ciphertext_len - 1
+  };
+
+  for (size_t i = 0; i < sizeof(offsets) / sizeof(offsets[0]); i++)
+  {
+    ciphertext[offsets[i]] ^= 1;
+    CU_ASSERT(aes_gcm_siv_decrypt(key, sizeof(key), ciphertext,
+                                  ciphertext_len, &decrypt,
+                                  &decrypt_len) == 1);
+    CU_ASSERT(decrypt == NULL);
+    ciphertext[offsets[i]] ^= 1;
+  }
+
+  // modify a single key bit
+  key[0] ^= 1;
+  CU_ASSERT(aes_gcm_siv_decrypt(key, sizeof(key), ciphertext,
+                                ciphertext_len, &decrypt,
+                                &decrypt_len) == 1);
+  key[0] ^= 1;
+
+  // unmodified input still decrypts
+  CU_ASSERT(aes_gcm_siv_decrypt(key, sizeof(key), ciphertext,
+                                ciphertext_len, &decrypt,
+                                &decrypt_len) == 0);
+
+  kmyth_clear_and_free(decrypt, decrypt_len);
+  free(ciphertext);
+}
+
+//----------------------------------------------------------------------------
+// test_aes_gcm_siv_parameter_limits()
+//----------------------------------------------------------------------------
+void test_aes_gcm_siv_parameter_limits(void)
+{
+#ifndef KMYTH_AES_GCM_SIV_SUPPORTED
+  return;
+#endif
+
+  unsigned char key[32] = { 0 };
+  unsigned char plaintext[16] = { 0 };
+  unsigned char *ciphertext = NULL;
+  unsigned char *decrypt = NULL;
+  size_t ciphertext_len = 0;
+  size_t decrypt_len = 0;
+
+  // NULL key, NULL input
+  CU_ASSERT(aes_gcm_siv_encrypt(NULL, sizeof(key), plaintext,
+                                sizeof(plaintext), &ciphertext,
+                                &ciphertext_len) == 1);
+  CU_ASSERT(aes_gcm_siv_encrypt(key, sizeof(key), NULL,
+                                sizeof(plaintext), &ciphertext,
+                                &ciphertext_len) == 1);
+
+  // unsupported key length
+  CU_ASSERT(aes_gcm_siv_encrypt(key, 20, plaintext, sizeof(plaintext),
+                                &ciphertext, &ciphertext_len) == 1);
+
+  CU_ASSERT(aes_gcm_siv_encrypt(key, sizeof(key), plaintext,
+                                sizeof(plaintext), &ciphertext,
+                                &ciphertext_len) == 0);
+  CU_ASSERT(aes_gcm_siv_decrypt(key, 20, ciphertext, ciphertext_len,
+                                &decrypt, &decrypt_len) == 1);
+
+  // input shorter than a nonce and tag
+  CU_ASSERT(aes_gcm_siv_decrypt(key, sizeof(key), ciphertext,
+                                GCM_SIV_NONCE_LEN + GCM_SIV_TAG_LEN - 1,
+                                &decrypt, &decrypt_len) == 1);
+
+  free(ciphertext);
+}
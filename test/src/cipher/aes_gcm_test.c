@@ -11,6 +11,7 @@
 #include "aes_gcm_test.h"
 #include "cipher_test.h"
 #include "aes_gcm.h"
+#include "memory_util.h"
 
 //----------------------------------------------------------------------------
 // aes_gcm_add_tests()
@@ -437,7 +438,7 @@ void test_aes_gcm_decrypt_vectors(void)
           // clean-up output_data byte array
           if (rc == 0)
           {
-            free(output_data);
+            kmyth_clear_and_free(output_data, output_data_len);
           }
         }
 
@@ -497,7 +498,7 @@ void test_gcm_encrypt_decrypt(void)
   CU_ASSERT(decrypt_len == plaintext_len);
   CU_ASSERT(memcmp(plaintext, decrypt, plaintext_len) == 0);
 
-  free(decrypt);
+  kmyth_clear_and_free(decrypt, decrypt_len);
   free(key);
   free(plaintext);
   free(ciphertext);
@@ -526,7 +527,7 @@ void test_gcm_key_modification(void)
   CU_ASSERT(aes_gcm_decrypt(key, key_len, ciphertext, ciphertext_len,
                             &decrypt, &decrypt_len) == 0);
 
-  free(decrypt);
+  kmyth_clear_and_free(decrypt, decrypt_len);
   decrypt = NULL;
   decrypt_len = 0;
 
@@ -563,7 +564,7 @@ void test_gcm_tag_modification(void)
   CU_ASSERT(aes_gcm_decrypt(key, key_len, ciphertext, ciphertext_len,
                             &decrypt, &decrypt_len) == 0);
 
-  free(decrypt);
+  kmyth_clear_and_free(decrypt, decrypt_len);
   decrypt = NULL;
   decrypt_len = 0;
 
@@ -606,7 +607,7 @@ void test_gcm_iv_modification(void)
   CU_ASSERT(aes_gcm_decrypt(key, key_len, ciphertext, ciphertext_len,
                             &decrypt, &decrypt_len) == 0);
 
-  free(decrypt);
+  kmyth_clear_and_free(decrypt, decrypt_len);
   decrypt = NULL;
   decrypt_len = 0;
 
@@ -651,7 +652,7 @@ void test_gcm_cipher_modification(void)
   CU_ASSERT(aes_gcm_decrypt(key, key_len, ciphertext, ciphertext_len,
                             &decrypt, &decrypt_len) == 0);
 
-  free(decrypt);
+  kmyth_clear_and_free(decrypt, decrypt_len);
   decrypt = NULL;
   decrypt_len = 0;
 
@@ -715,12 +716,12 @@ void test_gcm_parameter_limits(void)
   // produces empty (zero length) plaintext result
   inData_len = outData_len;
   memcpy(inData, outData, outData_len);
-  free(outData);
+  kmyth_clear_and_free(outData, outData_len);
   outData = NULL;
   CU_ASSERT(aes_gcm_decrypt(key, key_len, inData, inData_len,
                             &outData, &outData_len) == 0);
   CU_ASSERT(outData_len == 0);
-  free(outData);
+  kmyth_clear_and_free(outData, outData_len);
   outData = NULL;
 
   // check that a completely empty (but non-NULL) data input to decrypt errors
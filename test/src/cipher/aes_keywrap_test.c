@@ -15,6 +15,7 @@
 #include "cipher_test.h"
 #include "aes_keywrap_3394nopad.h"
 #include "aes_keywrap_5649pad.h"
+#include "memory_util.h"
 
 #define AES_KW_VECTOR_PATH "test/vectors/kwtestvectors"
 
@@ -504,7 +505,7 @@ void test_aes_keywrap_vectors(void)
             // clean-up output_data byte array
             if (rc == 0)
             {
-              free(out);
+              kmyth_clear_and_free(out, out_len);
             }
           }
           else
@@ -0,0 +1,163 @@
+//############################################################################
+// chacha20_poly1305_test.c
+//
+// Tests for kmyth ChaCha20-Poly1305 functionality in
+// src/cipher/chacha20_poly1305.c
+//############################################################################
+
+#include <stdlib.h>
+#include <string.h>
+#include <CUnit/CUnit.h>
+
+#include "chacha20_poly1305_test.h"
+#include "cipher/chacha20_poly1305.h"
+#include "memory_util.h"
+
+//----------------------------------------------------------------------------
+// chacha20_poly1305_add_tests()
+//----------------------------------------------------------------------------
+int chacha20_poly1305_add_tests(CU_pSuite suite)
+{
+  if (NULL == CU_add_test(suite, "Test ChaCha20-Poly1305 encryption/decryption",
+                          test_chacha20_poly1305_encrypt_decrypt))
+  {
+    return 1;
+  }
+
+  if (NULL == CU_add_test(suite, "Test ChaCha20-Poly1305 modification",
+                          test_chacha20_poly1305_modification))
+  {
+    return 1;
+  }
+
+  if (NULL == CU_add_test(suite, "Test ChaCha20-Poly1305 parameter limits",
+                          test_chacha20_poly1305_parameter_limits))
+  {
+    return 1;
+  }
+
+  return 0;
+}
+
+//----------------------------------------------------------------------------
+// test_chacha20_poly1305_encrypt_decrypt()
+//----------------------------------------------------------------------------
+void test_chacha20_poly1305_encrypt_decrypt(void)
+{
+  unsigned char key[32] = { 0 };
+  unsigned char plaintext[1000];
+  size_t sizes[] = { 0, 1, 64, sizeof(plaintext) };
+
+  for (size_t i = 0; i < sizeof(plaintext); i++)
+  {
+    plaintext[i] = (unsigned char) i;
+  }
+
+  for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+  {
+    unsigned char *ciphertext = NULL;
+    unsigned char *decrypt = NULL;
+    size_t ciphertext_len = 0;
+    size_t decrypt_len = 0;
+
+    CU_ASSERT(chacha20_poly1305_encrypt(key, sizeof(key), plaintext,
+                                        sizes[i], &ciphertext,
+                                        &ciphertext_len) == 0);
+    CU_ASSERT(ciphertext_len == CHACHA20_POLY1305_NONCE_LEN + sizes[i] +
+              CHACHA20_POLY1305_TAG_LEN);
+    CU_ASSERT(chacha20_poly1305_decrypt(key, sizeof(key), ciphertext,
+                                        ciphertext_len, &decrypt,
+                                        &decrypt_len) == 0);
+    CU_ASSERT(decrypt_len == sizes[i]);
+    CU_ASSERT(memcmp(plaintext, decrypt, decrypt_len) == 0);
+
+    free(ciphertext);
+    kmyth_clear_and_free(decrypt, decrypt_len);
+  }
+}
+
+//----------------------------------------------------------------------------
+// test_chacha20_poly1305_modification()
+//----------------------------------------------------------------------------
+void test_chacha20_poly1305_modification(void)
+{
+  unsigned char key[32] = { 0 };
+  unsigned char plaintext[64] = { 0 };
+  unsigned char *ciphertext = NULL;
+  unsigned char *decrypt = NULL;
+  size_t ciphertext_len = 0;
+  size_t decrypt_len = 0;
+
+  CU_ASSERT(chacha20_poly1305_encrypt(key, sizeof(key), plaintext,
+                                      sizeof(plaintext), &ciphertext,
+                                      &ciphertext_len) == 0);
+
+  // offsets of: nonce, ciphertext, tag
+  size_t offsets[] = { 0, CHACHA20_POLY1305_NONCE_LEN + 10,
+    ciphertext_len - 1
+  };
+
+  for (size_t i = 0; i < sizeof(offsets) / sizeof(offsets[0]); i++)
+  {
+    ciphertext[offsets[i]] ^= 1;
+    CU_ASSERT(chacha20_poly1305_decrypt(key, sizeof(key), ciphertext,
+                                        ciphertext_len, &decrypt,
+                                        &decrypt_len) == 1);
+    CU_ASSERT(decrypt == NULL);
+    ciphertext[offsets[i]] ^= 1;
+  }
+
+  // modify a single key bit
+  key[0] ^= 1;
+  CU_ASSERT(chacha20_poly1305_decrypt(key, sizeof(key), ciphertext,
+                                      ciphertext_len, &decrypt,
+                                      &decrypt_len) == 1);
+  key[0] ^= 1;
+
+  // unmodified input still decrypts
+  CU_ASSERT(chacha20_poly1305_decrypt(key, sizeof(key), ciphertext,
+                                      ciphertext_len, &decrypt,
+                                      &decrypt_len) == 0);
+
+  kmyth_clear_and_free(decrypt, decrypt_len);
+  free(ciphertext);
+}
+
+//----------------------------------------------------------------------------
+// test_chacha20_poly1305_parameter_limits()
+//----------------------------------------------------------------------------
+void test_chacha20_poly1305_parameter_limits(void)
+{
+  unsigned char key[32] = { 0 };
+  unsigned char plaintext[16] = { 0 };
+  unsigned char *ciphertext = NULL;
+  unsigned char *decrypt = NULL;
+  size_t ciphertext_len = 0;
+  size_t decrypt_len = 0;
+
+  // NULL key, NULL input
+  CU_ASSERT(chacha20_poly1305_encrypt(NULL, sizeof(key), plaintext,
+                                      sizeof(plaintext), &ciphertext,
+                                      &ciphertext_len) == 1);
+  CU_ASSERT(chacha20_poly1305_encrypt(key, sizeof(key), NULL,
+                                      sizeof(plaintext), &ciphertext,
+                                      &ciphertext_len) == 1);
+
+  // ChaCha20 only supports 256-bit keys
+  CU_ASSERT(chacha20_poly1305_encrypt(key, 16, plaintext, sizeof(plaintext),
+                                      &ciphertext, &ciphertext_len) == 1);
+
+  CU_ASSERT(chacha20_poly1305_encrypt(key, sizeof(key), plaintext,
+                                      sizeof(plaintext), &ciphertext,
+                                      &ciphertext_len) == 0);
+  CU_ASSERT(chacha20_poly1305_decrypt(key, 16, ciphertext, ciphertext_len,
+                                      &decrypt, &decrypt_len) == 1);
+
+  // input shorter than a nonce and tag
+  CU_ASSERT(chacha20_poly1305_decrypt(key, sizeof(key), ciphertext,
+                                      CHACHA20_POLY1305_NONCE_LEN +
+                                      CHACHA20_POLY1305_TAG_LEN - 1,
+                                      &decrypt, &decrypt_len) == 1);
+
+  free(ciphertext);
+}
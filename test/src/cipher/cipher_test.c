@@ -11,6 +11,7 @@
 #include "cipher/aes_gcm.h"
 #include "cipher/cipher.h"
 #include "cipher_test.h"
+#include "memory_util.h"
 
 //############ General Utilities supporting Cipher Testing ###################
 
@@ -425,5 +426,5 @@ void test_kmyth_decrypt_data(void)
   free(data_g);
   free(enc_data_g);
   free(key_g);
-  free(results_g);
+  kmyth_clear_and_free(results_g, result_size_g);
 }
@@ -0,0 +1,192 @@
+//############################################################################
+// envelope_test.c
+//
+// Tests for kmyth envelope (KEK) mode functionality in
+// tpm2/src/cipher/envelope.c
+//############################################################################
+
+#include <string.h>
+#include <stdio.h>
+#include <CUnit/CUnit.h>
+
+#include "envelope_test.h"
+#include "cipher/cipher.h"
+#include "cipher/envelope.h"
+#include "formatting_tools.h"
+#include "memory_util.h"
+
+//----------------------------------------------------------------------------
+// envelope_add_tests()
+//----------------------------------------------------------------------------
+int envelope_add_tests(CU_pSuite suite)
+{
+  if (NULL == CU_add_test(suite, "derive_envelope_key() Tests",
+                          test_derive_envelope_key))
+  {
+    return 1;
+  }
+
+  if (NULL == CU_add_test(suite, "kmyth_envelope_encrypt() Tests",
+                          test_kmyth_envelope_encrypt))
+  {
+    return 1;
+  }
+
+  if (NULL == CU_add_test(suite, "kmyth_envelope_decrypt() Tests",
+                          test_kmyth_envelope_decrypt))
+  {
+    return 1;
+  }
+
+  return 0;
+}
+
+//----------------------------------------------------------------------------
+// test_derive_envelope_key()
+//----------------------------------------------------------------------------
+void test_derive_envelope_key(void)
+{
+  unsigned char kek[KMYTH_ENVELOPE_KEK_LEN] = { 0x01 };
+  unsigned char salt[KMYTH_ENVELOPE_SALT_LEN] = { 0x02 };
+  cipher_t gcm256 = kmyth_get_cipher_t_from_string("AES/GCM/NoPadding/256");
+  cipher_t gcm128 = kmyth_get_cipher_t_from_string("AES/GCM/NoPadding/128");
+
+  unsigned char *key1 = NULL;
+  size_t key1_len = 0;
+  unsigned char *key2 = NULL;
+  size_t key2_len = 0;
+
+  // Check that the derived key length matches the cipher key length
+  CU_ASSERT(derive_envelope_key(kek, sizeof(kek), salt, sizeof(salt), gcm256,
+                                &key1, &key1_len) == 0);
+  CU_ASSERT(key1_len == 32);
+  CU_ASSERT(derive_envelope_key(kek, sizeof(kek), salt, sizeof(salt), gcm128,
+                                &key2, &key2_len) == 0);
+  CU_ASSERT(key2_len == 16);
+
+  // Check that the key is bound to the cipher (not just truncated)
+  CU_ASSERT(memcmp(key1, key2, key2_len) != 0);
+  kmyth_clear_and_free(key2, key2_len);
+
+  // Check that derivation is deterministic
+  CU_ASSERT(derive_envelope_key(kek, sizeof(kek), salt, sizeof(salt), gcm256,
+                                &key2, &key2_len) == 0);
+  CU_ASSERT(key2_len == key1_len);
+  CU_ASSERT(memcmp(key1, key2, key1_len) == 0);
+  kmyth_clear_and_free(key2, key2_len);
+
+  // Check that a different salt produces a different key
+  salt[0] ^= 0x01;
+  CU_ASSERT(derive_envelope_key(kek, sizeof(kek), salt, sizeof(salt), gcm256,
+                                &key2, &key2_len) == 0);
+  CU_ASSERT(memcmp(key1, key2, key1_len) != 0);
+  kmyth_clear_and_free(key2, key2_len);
+  kmyth_clear_and_free(key1, key1_len);
+
+  // Check invalid parameters
+  CU_ASSERT(derive_envelope_key(NULL, sizeof(kek), salt, sizeof(salt), gcm256,
+                                &key1, &key1_len) == 1);
+  CU_ASSERT(derive_envelope_key(kek, 0, salt, sizeof(salt), gcm256,
+                                &key1, &key1_len) == 1);
+  CU_ASSERT(derive_envelope_key(kek, sizeof(kek), NULL, sizeof(salt), gcm256,
+                                &key1, &key1_len) == 1);
+  CU_ASSERT(derive_envelope_key(kek, sizeof(kek), salt, 0, gcm256,
+                                &key1, &key1_len) == 1);
+  cipher_t bad_cipher = {.cipher_name = NULL };
+  CU_ASSERT(derive_envelope_key(kek, sizeof(kek), salt, sizeof(salt),
+                                bad_cipher, &key1, &key1_len) == 1);
+}
+
+//----------------------------------------------------------------------------
+// test_kmyth_envelope_encrypt()
+//----------------------------------------------------------------------------
+void test_kmyth_envelope_encrypt(void)
+{
+  unsigned char kek[KMYTH_ENVELOPE_KEK_LEN] = { 0x01 };
+  uint8_t data[16] = { 0x03 };
+  cipher_t cipher_spec = kmyth_get_cipher_t_from_string(KMYTH_DEFAULT_CIPHER);
+
+  uint8_t *out1 = NULL;
+  size_t out1_len = 0;
+  uint8_t *out2 = NULL;
+  size_t out2_len = 0;
+
+  // Check that the envelope is created with the expected header
+  CU_ASSERT(kmyth_envelope_encrypt(kek, sizeof(kek), data, sizeof(data),
+                                   cipher_spec, &out1, &out1_len) == 0);
+  CU_ASSERT(out1_len > strlen(KMYTH_DELIM_ENVELOPE_SALT));
+  CU_ASSERT(strncmp((char *) out1, KMYTH_DELIM_ENVELOPE_SALT,
+                    strlen(KMYTH_DELIM_ENVELOPE_SALT)) == 0);
+
+  // Check that each envelope uses a fresh salt
+  CU_ASSERT(kmyth_envelope_encrypt(kek, sizeof(kek), data, sizeof(data),
+                                   cipher_spec, &out2, &out2_len) == 0);
+  CU_ASSERT(out1_len == out2_len);
+  CU_ASSERT(memcmp(out1, out2, out1_len) != 0);
+  free(out1);
+  free(out2);
+
+  // Check invalid parameters
+  CU_ASSERT(kmyth_envelope_encrypt(kek, sizeof(kek), NULL, sizeof(data),
+                                   cipher_spec, &out1, &out1_len) == 1);
+  CU_ASSERT(kmyth_envelope_encrypt(kek, sizeof(kek), data, 0,
+                                   cipher_spec, &out1, &out1_len) == 1);
+  CU_ASSERT(kmyth_envelope_encrypt(NULL, sizeof(kek), data, sizeof(data),
+                                   cipher_spec, &out1, &out1_len) == 1);
+  cipher_t bad_cipher = {.cipher_name = NULL };
+  CU_ASSERT(kmyth_envelope_encrypt(kek, sizeof(kek), data, sizeof(data),
+                                   bad_cipher, &out1, &out1_len) == 1);
+}
+
+//----------------------------------------------------------------------------
+// test_kmyth_envelope_decrypt()
+//----------------------------------------------------------------------------
+void test_kmyth_envelope_decrypt(void)
+{
+  unsigned char kek[KMYTH_ENVELOPE_KEK_LEN] = { 0x01 };
+  uint8_t data[16] = { 0x03, 0x04, 0x05 };
+  cipher_t cipher_spec = kmyth_get_cipher_t_from_string(KMYTH_DEFAULT_CIPHER);
+
+  uint8_t *envelope = NULL;
+  size_t envelope_len = 0;
+
+  kmyth_envelope_encrypt(kek, sizeof(kek), data, sizeof(data), cipher_spec,
+                         &envelope, &envelope_len);
+
+  uint8_t *output = NULL;
+  size_t output_len = 0;
+
+  // Check that the envelope opens under the KEK it was created with
+  CU_ASSERT(kmyth_envelope_decrypt(kek, sizeof(kek), envelope, envelope_len,
+                                   &output, &output_len) == 0);
+  CU_ASSERT(output_len == sizeof(data));
+  CU_ASSERT(memcmp(output, data, sizeof(data)) == 0);
+  kmyth_clear_and_free(output, output_len);
+  output = NULL;
+
+  // Check that the envelope does not open under a different KEK
+  kek[0] ^= 0x01;
+  CU_ASSERT(kmyth_envelope_decrypt(kek, sizeof(kek), envelope, envelope_len,
+                                   &output, &output_len) == 1);
+  kek[0] ^= 0x01;
+
+  // Check that a modified salt prevents recovery of the data
+  size_t salt_offset = strlen(KMYTH_DELIM_ENVELOPE_SALT);
+
+  envelope[salt_offset] = (envelope[salt_offset] == 'A') ? 'B' : 'A';
+  CU_ASSERT(kmyth_envelope_decrypt(kek, sizeof(kek), envelope, envelope_len,
+                                   &output, &output_len) == 1);
+
+  // Check that a truncated envelope is rejected
+  CU_ASSERT(kmyth_envelope_decrypt(kek, sizeof(kek), envelope,
+                                   envelope_len - 1, &output,
+                                   &output_len) == 1);
+
+  // Check invalid parameters
+  CU_ASSERT(kmyth_envelope_decrypt(kek, sizeof(kek), NULL, envelope_len,
+                                   &output, &output_len) == 1);
+  CU_ASSERT(kmyth_envelope_decrypt(kek, sizeof(kek), envelope, 0,
+                                   &output, &output_len) == 1);
+
+  free(envelope);
+}
@@ -5,6 +5,9 @@
  * Incorporates the following test suites:
  *   - File I/O Utility (tests in util/file_io_test.c)
  *   - TLS Utility (tests in util/tls_util_test.c)
+ *   - Socket Utility (tests in network/socket_util_test.c)
+ *   - Agent Protocol (tests in protocol/agent_util_test.c)
+ *   - KMIP Utility (tests in protocol/kmip_util_test.c)
  */
 
 #include <stdio.h>
@@ -18,13 +21,20 @@
 #include "object_tools_test.h"
 #include "formatting_tools_test.h"
 #include "tls_util_test.h"
+#include "socket_util_test.h"
+#include "agent_util_test.h"
+#include "kmip_util_test.h"
 #include "aes_gcm_test.h"
+#include "aes_gcm_seg_test.h"
+#include "aes_gcm_siv_test.h"
+#include "chacha20_poly1305_test.h"
 #include "aes_keywrap_test.h"
 #include "tpm2_interface_test.h"
 #include "storage_key_tools_test.h"
 #include "pcrs_test.h"
 #include "kmyth_seal_unseal_impl_test.h"
 #include "cipher_test.h"
+#include "envelope_test.h"
 
 /**
  * Use trivial (do nothing) init_suite and clean_suite functionality
@@ -147,6 +157,54 @@ int main(int argc, char **argv)
     return CU_get_error();
   }
 
+  // Create and configure socket utility test suite
+  CU_pSuite socket_util_test_suite = NULL;
+
+  socket_util_test_suite = CU_add_suite("Socket Utility Test Suite",
+                                        init_suite, clean_suite);
+  if (NULL == socket_util_test_suite)
+  {
+    CU_cleanup_registry();
+    return CU_get_error();
+  }
+  if (socket_util_add_tests(socket_util_test_suite))
+  {
+    CU_cleanup_registry();
+    return CU_get_error();
+  }
+
+  // Create and configure kmyth-agent protocol test suite
+  CU_pSuite agent_util_test_suite = NULL;
+
+  agent_util_test_suite = CU_add_suite("Agent Protocol Test Suite",
+                                       init_suite, clean_suite);
+  if (NULL == agent_util_test_suite)
+  {
+    CU_cleanup_registry();
+    return CU_get_error();
+  }
+  if (agent_util_add_tests(agent_util_test_suite))
+  {
+    CU_cleanup_registry();
+    return CU_get_error();
+  }
+
+  // Create and configure KMIP utility test suite
+  CU_pSuite kmip_util_test_suite = NULL;
+
+  kmip_util_test_suite = CU_add_suite("KMIP Utility Test Suite",
+                                      init_suite, clean_suite);
+  if (NULL == kmip_util_test_suite)
+  {
+    CU_cleanup_registry();
+    return CU_get_error();
+  }
+  if (kmip_util_add_tests(kmip_util_test_suite))
+  {
+    CU_cleanup_registry();
+    return CU_get_error();
+  }
+
   // Create and configure the AES/GCM cipher test suite
   CU_pSuite aes_gcm_test_suite = NULL;
 
@@ -163,6 +221,55 @@ int main(int argc, char **argv)
     return CU_get_error();
   }
 
+  // Create and configure the segmented AES/GCM cipher test suite
+  CU_pSuite aes_gcm_seg_test_suite = NULL;
+
+  aes_gcm_seg_test_suite = CU_add_suite("AES/GCM-SEG Cipher Test Suite",
+                                        init_suite, clean_suite);
+  if (NULL == aes_gcm_seg_test_suite)
+  {
+    CU_cleanup_registry();
+    return CU_get_error();
+  }
+  if (aes_gcm_seg_add_tests(aes_gcm_seg_test_suite))
+  {
+    CU_cleanup_registry();
+    return CU_get_error();
+  }
+
+  // Create and configure the AES-GCM-SIV cipher test suite
+  CU_pSuite aes_gcm_siv_test_suite = NULL;
+
+  aes_gcm_siv_test_suite = CU_add_suite("AES-GCM-SIV Cipher Test Suite",
+                                        init_suite, clean_suite);
+  if (NULL == aes_gcm_siv_test_suite)
+  {
+    CU_cleanup_registry();
+    return CU_get_error();
+  }
+  if (aes_gcm_siv_add_tests(aes_gcm_siv_test_suite))
+  {
+    CU_cleanup_registry();
+    return CU_get_error();
+  }
+
+  // Create and configure the ChaCha20-Poly1305 cipher test suite
+  CU_pSuite chacha20_poly1305_test_suite = NULL;
+
+  chacha20_poly1305_test_suite =
+    CU_add_suite("ChaCha20-Poly1305 Cipher Test Suite", init_suite,
+                 clean_suite);
+  if (NULL == chacha20_poly1305_test_suite)
+  {
+    CU_cleanup_registry();
+    return CU_get_error();
+  }
+  if (chacha20_poly1305_add_tests(chacha20_poly1305_test_suite))
+  {
+    CU_cleanup_registry();
+    return CU_get_error();
+  }
+
   // Create and configure the AES Key Wrap cipher test suite
   CU_pSuite aes_keywrap_test_suite = NULL;
 
@@ -226,6 +333,22 @@ int main(int argc, char **argv)
     return CU_get_error();
   }
 
+  // Create and configure envelope (KEK) mode test suite
+  CU_pSuite envelope_test_suite = NULL;
+
+  envelope_test_suite = CU_add_suite("Envelope Mode Test Suite", init_suite,
+                                     clean_suite);
+  if (NULL == envelope_test_suite)
+  {
+    CU_cleanup_registry();
+    return CU_get_error();
+  }
+  if (envelope_add_tests(envelope_test_suite))
+  {
+    CU_cleanup_registry();
+    return CU_get_error();
+  }
+
   // Run tests using basic interface
   CU_basic_run_tests();
 
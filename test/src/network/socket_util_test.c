@@ -0,0 +1,377 @@
+//############################################################################
+// socket_util_test.c
+//
+// Tests for socket utility functions in src/network/socket_util.c
+//############################################################################
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <CUnit/CUnit.h>
+
+#include "socket_util_test.h"
+#include "socket_util.h"
+
+//----------------------------------------------------------------------------
+// socket_util_add_tests()
+//----------------------------------------------------------------------------
+int socket_util_add_tests(CU_pSuite suite)
+{
+  if (NULL == CU_add_test(suite, "connect_client_socket() Tests",
+                          test_connect_client_socket))
+  {
+    return 1;
+  }
+
+  if (NULL == CU_add_test(suite, "setup_client_socket() Tests",
+                          test_setup_client_socket))
+  {
+    return 1;
+  }
+
+  if (NULL == CU_add_test(suite, "send_socket_frame() Tests",
+                          test_send_socket_frame))
+  {
+    return 1;
+  }
+
+  if (NULL == CU_add_test(suite, "recv_socket_exact() Tests",
+                          test_recv_socket_exact))
+  {
+    return 1;
+  }
+
+  if (NULL == CU_add_test(suite, "set_socket_tcp_options() Tests",
+                          test_set_socket_tcp_options))
+  {
+    return 1;
+  }
+
+  return 0;
+}
+
+//----------------------------------------------------------------------------
+// make_loopback_socket()
+//
+// Creates a TCP socket bound to an ephemeral port on the IPv4 or IPv6
+// loopback address, and fills in an addrinfo entry for that address.
+//   - listening with a backlog of at least one gives a live address
+//   - listening with a zero backlog, after one connection has filled the
+//     accept queue (*filler), gives a blackhole: the kernel drops further
+//     SYNs, so connections hang as they would to an unreachable host
+//   - not listening at all gives an address that refuses connections
+// Returns the socket, or -1 if the address family is not available.
+//----------------------------------------------------------------------------
+static int make_loopback_socket(int family, int backlog, int *filler,
+                                struct sockaddr_storage *addr,
+                                struct addrinfo *ai)
+{
+  socklen_t addr_len = (family == AF_INET6)
+    ? sizeof(struct sockaddr_in6) : sizeof(struct sockaddr_in);
+  int fd = socket(family, SOCK_STREAM, 0);
+
+  memset(addr, 0, sizeof(struct sockaddr_storage));
+  if (family == AF_INET6)
+  {
+    ((struct sockaddr_in6 *) addr)->sin6_family = AF_INET6;
+    ((struct sockaddr_in6 *) addr)->sin6_addr = in6addr_loopback;
+  }
+  else
+  {
+    ((struct sockaddr_in *) addr)->sin_family = AF_INET;
+    ((struct sockaddr_in *) addr)->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  }
+
+  if (fd == -1 || bind(fd, (struct sockaddr *) addr, addr_len)
+      || getsockname(fd, (struct sockaddr *) addr, &addr_len)
+      || (backlog >= 0 && listen(fd, backlog)))
+  {
+    if (fd != -1)
+    {
+      close(fd);
+    }
+    return -1;
+  }
+
+  if (filler != NULL)
+  {
+    *filler = socket(family, SOCK_STREAM, 0);
+    if (*filler == -1
+        || connect(*filler, (struct sockaddr *) addr, addr_len))
+    {
+      close(fd);
+      return -1;
+    }
+  }
+
+  memset(ai, 0, sizeof(struct addrinfo));
+  ai->ai_family = family;
+  ai->ai_socktype = SOCK_STREAM;
+  ai->ai_addr = (struct sockaddr *) addr;
+  ai->ai_addrlen = addr_len;
+
+  return fd;
+}
+
+//----------------------------------------------------------------------------
+// elapsed_ms()
+//----------------------------------------------------------------------------
+static long elapsed_ms(const struct timespec *start)
+{
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (now.tv_sec - start->tv_sec) * 1000
+    + (now.tv_nsec - start->tv_nsec) / 1000000;
+}
+
+//----------------------------------------------------------------------------
+// peer_port()
+//----------------------------------------------------------------------------
+static int peer_port(int fd)
+{
+  struct sockaddr_storage peer;
+  socklen_t peer_len = sizeof(peer);
+
+  if (getpeername(fd, (struct sockaddr *) &peer, &peer_len))
+  {
+    return -1;
+  }
+  if (peer.ss_family == AF_INET6)
+  {
+    return ntohs(((struct sockaddr_in6 *) &peer)->sin6_port);
+  }
+  return ntohs(((struct sockaddr_in *) &peer)->sin_port);
+}
+
+//----------------------------------------------------------------------------
+// test_connect_client_socket()
+//----------------------------------------------------------------------------
+void test_connect_client_socket(void)
+{
+  struct sockaddr_storage live_addr, hole_addr, refused_addr, live6_addr;
+  struct addrinfo live, hole, hole2, refused, live6;
+  int filler = -1;
+  int fd = -1;
+  int optval = 0;
+  socklen_t optlen = sizeof(optval);
+  struct timespec start;
+
+  int live_fd = make_loopback_socket(AF_INET, 8, NULL, &live_addr, &live);
+  int hole_fd = make_loopback_socket(AF_INET, 0, &filler, &hole_addr, &hole);
+  int refused_fd = make_loopback_socket(AF_INET, -1, NULL,
+                                        &refused_addr, &refused);
+
+  CU_ASSERT_FATAL(live_fd != -1 && hole_fd != -1 && refused_fd != -1);
+  int live_port = ntohs(((struct sockaddr_in *) &live_addr)->sin_port);
+
+  hole2 = hole;
+
+  // A blackholed first address should only cost one attempt delay, and the
+  // winning socket should be blocking, with TCP_NODELAY set
+  hole.ai_next = &live;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  CU_ASSERT(connect_client_socket(&hole, 100, 5000, &fd) == 0);
+  CU_ASSERT(elapsed_ms(&start) < 1000);
+  CU_ASSERT(peer_port(fd) == live_port);
+  CU_ASSERT((fcntl(fd, F_GETFL, 0) & O_NONBLOCK) == 0);
+  CU_ASSERT(getsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &optval, &optlen) == 0);
+  CU_ASSERT(optval != 0);
+  close(fd);
+  fd = -1;
+
+  // A refused address should move on to the next one without waiting
+  refused.ai_next = &live;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  CU_ASSERT(connect_client_socket(&refused, 2000, 5000, &fd) == 0);
+  CU_ASSERT(elapsed_ms(&start) < 1000);
+  CU_ASSERT(peer_port(fd) == live_port);
+  close(fd);
+  fd = -1;
+
+  // With only unreachable addresses, the overall deadline should apply
+  hole.ai_next = &hole2;
+  hole2.ai_next = NULL;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  CU_ASSERT(connect_client_socket(&hole, 50, 300, &fd) == 1);
+  CU_ASSERT(elapsed_ms(&start) >= 290);
+  CU_ASSERT(elapsed_ms(&start) < 2000);
+  CU_ASSERT(fd == -1);
+
+  // With only refused addresses, the failure should be immediate
+  refused.ai_next = NULL;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  CU_ASSERT(connect_client_socket(&refused, 2000, 5000, &fd) == 1);
+  CU_ASSERT(elapsed_ms(&start) < 1000);
+  CU_ASSERT(fd == -1);
+
+  // An empty address list should produce an error
+  CU_ASSERT(connect_client_socket(NULL, 100, 1000, &fd) == 1);
+
+  // The address families should be interleaved, so an IPv6 address listed
+  // after two blackholed IPv4 addresses is tried second (skipped where
+  // IPv6 loopback is unavailable)
+  int live6_fd = make_loopback_socket(AF_INET6, 8, NULL, &live6_addr, &live6);
+
+  if (live6_fd != -1)
+  {
+    hole.ai_next = &hole2;
+    hole2.ai_next = &live6;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    CU_ASSERT(connect_client_socket(&hole, 300, 5000, &fd) == 0);
+    CU_ASSERT(elapsed_ms(&start) < 550);
+    CU_ASSERT(peer_port(fd) ==
+              ntohs(((struct sockaddr_in6 *) &live6_addr)->sin6_port));
+    close(fd);
+    fd = -1;
+    close(live6_fd);
+  }
+
+  close(filler);
+  close(hole_fd);
+  close(refused_fd);
+  close(live_fd);
+}
+
+//----------------------------------------------------------------------------
+// test_setup_client_socket()
+//----------------------------------------------------------------------------
+void test_setup_client_socket(void)
+{
+  struct sockaddr_storage live_addr;
+  struct addrinfo live;
+  char port[8];
+  int fd = -1;
+
+  int live_fd = make_loopback_socket(AF_INET, 8, NULL, &live_addr, &live);
+
+  CU_ASSERT_FATAL(live_fd != -1);
+  snprintf(port, sizeof(port), "%d",
+           ntohs(((struct sockaddr_in *) &live_addr)->sin_port));
+
+  // A numeric address should connect
+  CU_ASSERT(setup_client_socket("127.0.0.1", port, &fd) == 0);
+  CU_ASSERT(fd != -1);
+  close(fd);
+  fd = -1;
+
+  // An unknown service should produce an error
+  CU_ASSERT(setup_client_socket("127.0.0.1", "no-such-service", &fd) == 1);
+  CU_ASSERT(fd == -1);
+
+  close(live_fd);
+}
+
+//----------------------------------------------------------------------------
+// test_send_socket_frame()
+//----------------------------------------------------------------------------
+void test_send_socket_frame(void)
+{
+  int fds[2] = { -1, -1 };
+  size_t header = 5;
+  unsigned char payload[4096];
+  unsigned int trailer = 0xA5A5A5A5;
+  unsigned char received[sizeof(header) + sizeof(payload) + sizeof(trailer)];
+  struct iovec iov[SOCKET_FRAME_MAX_IOV + 1];
+
+  CU_ASSERT_FATAL(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+
+  for (size_t i = 0; i < sizeof(payload); i++)
+  {
+    payload[i] = (unsigned char) i;
+  }
+  iov[0].iov_base = &header;
+  iov[0].iov_len = sizeof(header);
+  iov[1].iov_base = payload;
+  iov[1].iov_len = sizeof(payload);
+  iov[2].iov_base = &trailer;
+  iov[2].iov_len = sizeof(trailer);
+
+  // The buffers should arrive back to back, in order, and the caller's
+  // iovec array should be left untouched
+  CU_ASSERT(send_socket_frame(fds[0], iov, 3) == 0);
+  CU_ASSERT(iov[1].iov_base == payload && iov[1].iov_len == sizeof(payload));
+  CU_ASSERT(recv_socket_exact(fds[1], received, sizeof(received)) == 0);
+  CU_ASSERT(memcmp(received, &header, sizeof(header)) == 0);
+  CU_ASSERT(memcmp(received + sizeof(header), payload, sizeof(payload)) == 0);
+  CU_ASSERT(memcmp(received + sizeof(header) + sizeof(payload),
+                   &trailer, sizeof(trailer)) == 0);
+
+  // Empty buffers within a frame are allowed
+  iov[1].iov_len = 0;
+  CU_ASSERT(send_socket_frame(fds[0], iov, 3) == 0);
+  CU_ASSERT(recv_socket_exact(fds[1], received,
+                              sizeof(header) + sizeof(trailer)) == 0);
+  CU_ASSERT(memcmp(received + sizeof(header), &trailer, sizeof(trailer)) == 0);
+
+  // Invalid buffer lists should produce errors
+  CU_ASSERT(send_socket_frame(fds[0], NULL, 1) == 1);
+  CU_ASSERT(send_socket_frame(fds[0], iov, 0) == 1);
+  CU_ASSERT(send_socket_frame(fds[0], iov, SOCKET_FRAME_MAX_IOV + 1) == 1);
+
+  // Sending to a closed peer should produce an error (not a SIGPIPE)
+  close(fds[1]);
+  CU_ASSERT(send_socket_frame(fds[0], iov, 3) == 1);
+  close(fds[0]);
+}
+
+//----------------------------------------------------------------------------
+// test_recv_socket_exact()
+//----------------------------------------------------------------------------
+void test_recv_socket_exact(void)
+{
+  int fds[2] = { -1, -1 };
+  unsigned char msg[64];
+  unsigned char received[sizeof(msg)];
+
+  CU_ASSERT_FATAL(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+  for (size_t i = 0; i < sizeof(msg); i++)
+  {
+    msg[i] = (unsigned char) (0xFF - i);
+  }
+
+  // A message sent in pieces should be reassembled
+  CU_ASSERT(write(fds[0], msg, 10) == 10);
+  CU_ASSERT(write(fds[0], msg + 10, sizeof(msg) - 10) == sizeof(msg) - 10);
+  CU_ASSERT(recv_socket_exact(fds[1], received, sizeof(received)) == 0);
+  CU_ASSERT(memcmp(received, msg, sizeof(msg)) == 0);
+
+  // A zero-length receive trivially succeeds
+  CU_ASSERT(recv_socket_exact(fds[1], received, 0) == 0);
+
+  // The peer closing the connection part way through should be an error
+  CU_ASSERT(write(fds[0], msg, 10) == 10);
+  close(fds[0]);
+  CU_ASSERT(recv_socket_exact(fds[1], received, sizeof(received)) == 1);
+  close(fds[1]);
+
+  // An invalid socket should produce an error
+  CU_ASSERT(recv_socket_exact(-1, received, sizeof(received)) == 1);
+}
+
+//----------------------------------------------------------------------------
+// test_set_socket_tcp_options()
+//----------------------------------------------------------------------------
+void test_set_socket_tcp_options(void)
+{
+  int tcp_fd = socket(AF_INET, SOCK_STREAM, 0);
+  int fds[2] = { -1, -1 };
+
+  CU_ASSERT_FATAL(tcp_fd != -1);
+  CU_ASSERT(set_socket_tcp_options(tcp_fd, 1, 1) == 0);
+  CU_ASSERT(set_socket_tcp_options(tcp_fd, 0, 0) == 0);
+  close(tcp_fd);
+
+  // TCP options do not apply to other kinds of sockets
+  CU_ASSERT_FATAL(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+  CU_ASSERT(set_socket_tcp_options(fds[0], 1, 0) == 1);
+  close(fds[0]);
+  close(fds[1]);
+}
@@ -6,11 +6,14 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <CUnit/CUnit.h>
 #include <openssl/ssl.h>
 
 #include "tls_util_test.h"
 #include "tls_util.h"
+#include "defines.h"
+#include "memory_util.h"
 
 //----------------------------------------------------------------------------
 // tls_util_add_tests()
@@ -35,6 +38,12 @@ int tls_util_add_tests(CU_pSuite suite)
     return 1;
   }
 
+  if (NULL == CU_add_test(suite, "get_framed_key_from_tls_server() Tests",
+                          test_get_framed_key_from_tls_server))
+  {
+    return 1;
+  }
+
   if (NULL == CU_add_test(suite, "get_key_from_kmip_server() Tests",
                           test_get_key_from_kmip_server))
   {
@@ -150,6 +159,86 @@ void test_get_key_from_tls_server(void)
   BIO_free_all(bio);
 }
 
+//----------------------------------------------------------------------------
+// test_get_framed_key_from_tls_server()
+//----------------------------------------------------------------------------
+void test_get_framed_key_from_tls_server(void)
+{
+  char *message = "key-id";
+  size_t message_length = strlen(message);
+  unsigned char *key = NULL;
+  size_t key_size = 0;
+
+  // A null BIO should produce an error
+  CU_ASSERT(get_framed_key_from_tls_server((BIO *) NULL,
+                                           message, message_length,
+                                           &key, &key_size));
+
+  // A response larger than the fixed receive buffer is read in full (the
+  // memory BIO already holds the "server" response when the request is
+  // written after it)
+  size_t response_len = 64 * KMYTH_GETKEY_RX_BUFFER_SIZE + 3;
+  unsigned char *response = malloc(response_len);
+  unsigned char prefix[4] = {
+    (unsigned char) (response_len >> 24), (unsigned char) (response_len >> 16),
+    (unsigned char) (response_len >> 8), (unsigned char) response_len
+  };
+
+  CU_ASSERT_FATAL(response != NULL);
+  for (size_t i = 0; i < response_len; i++)
+  {
+    response[i] = (unsigned char) i;
+  }
+
+  BIO *bio = BIO_new(BIO_s_mem());
+
+  BIO_write(bio, prefix, sizeof(prefix));
+  BIO_write(bio, response, (int) response_len);
+  CU_ASSERT(get_framed_key_from_tls_server(bio, message, message_length,
+                                           &key, &key_size) == 0);
+  CU_ASSERT(key_size == response_len);
+  CU_ASSERT(key != NULL && memcmp(key, response, response_len) == 0);
+  kmyth_clear_and_free(key, key_size);
+  key = NULL;
+
+  // The request was sent after its length
+  unsigned char request[64] = { 0 };
+
+  CU_ASSERT(BIO_read(bio, request, sizeof(request))
+            == (int) (4 + message_length));
+  CU_ASSERT(request[3] == message_length);
+  CU_ASSERT(memcmp(request + 4, message, message_length) == 0);
+  BIO_free_all(bio);
+
+  // A truncated response should produce an error (short by more than the
+  // request written after it)
+  bio = BIO_new(BIO_s_mem());
+  BIO_write(bio, prefix, sizeof(prefix));
+  BIO_write(bio, response, (int) response_len - 64);
+  CU_ASSERT(get_framed_key_from_tls_server(bio, message, message_length,
+                                           &key, &key_size));
+  CU_ASSERT(key == NULL);
+  BIO_free_all(bio);
+
+  // An empty or oversized response should produce an error
+  unsigned char empty[4] = { 0, 0, 0, 0 };
+  unsigned char oversized[4] = { 0xff, 0xff, 0xff, 0xff };
+
+  bio = BIO_new(BIO_s_mem());
+  BIO_write(bio, empty, sizeof(empty));
+  CU_ASSERT(get_framed_key_from_tls_server(bio, message, message_length,
+                                           &key, &key_size));
+  BIO_free_all(bio);
+
+  bio = BIO_new(BIO_s_mem());
+  BIO_write(bio, oversized, sizeof(oversized));
+  CU_ASSERT(get_framed_key_from_tls_server(bio, message, message_length,
+                                           &key, &key_size));
+  BIO_free_all(bio);
+
+  free(response);
+}
+
 //----------------------------------------------------------------------------
 // test_get_key_from_kmip_server()
 //----------------------------------------------------------------------------
@@ -0,0 +1,331 @@
+//############################################################################
+// agent_util_test.c
+//
+// Tests for kmyth-agent protocol functions in src/protocol/agent_util.c
+//############################################################################
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <CUnit/CUnit.h>
+
+#include "agent_util_test.h"
+#include "agent_util.h"
+#include "memory_util.h"
+#include "socket_util.h"
+
+//----------------------------------------------------------------------------
+// agent_util_add_tests()
+//----------------------------------------------------------------------------
+int agent_util_add_tests(CU_pSuite suite)
+{
+  if (NULL == CU_add_test(suite, "send/recv_agent_message() Tests",
+                          test_send_recv_agent_message))
+  {
+    return 1;
+  }
+
+  if (NULL == CU_add_test(suite, "agent unseal request Tests",
+                          test_agent_unseal_request))
+  {
+    return 1;
+  }
+
+  if (NULL == CU_add_test(suite, "kmyth_agent_unseal() Tests",
+                          test_kmyth_agent_unseal))
+  {
+    return 1;
+  }
+
+  if (NULL == CU_add_test(suite, "kmyth_agent_flush() Tests",
+                          test_kmyth_agent_flush))
+  {
+    return 1;
+  }
+
+  return 0;
+}
+
+//----------------------------------------------------------------------------
+// mock_agent (serves one connection for the client tests)
+//----------------------------------------------------------------------------
+typedef struct
+{
+  int listen_fd;
+  uint8_t status;
+  uint8_t op;
+} mock_agent_t;
+
+static void *mock_agent(void *arg)
+{
+  mock_agent_t *mock = (mock_agent_t *) arg;
+  int fd = accept(mock->listen_fd, NULL, NULL);
+
+  if (fd < 0)
+  {
+    return NULL;
+  }
+
+  uint8_t *request = NULL;
+  size_t request_len = 0;
+
+  if (recv_agent_message(fd, &mock->op, &request, &request_len) == 0)
+  {
+    uint8_t *ski = NULL;
+    size_t ski_len = 0;
+    uint8_t *auth = NULL;
+    size_t auth_len = 0;
+    uint32_t ttl = 0;
+
+    // "unseal" by echoing the .ski contents back
+    if (mock->op == KMYTH_AGENT_OP_UNSEAL
+        && parse_agent_unseal_request(request, request_len, &ski, &ski_len,
+                                      &auth, &auth_len, &ttl) == 0
+        && mock->status == KMYTH_AGENT_STATUS_OK)
+    {
+      send_agent_message(fd, mock->status, ski, ski_len);
+    }
+    else
+    {
+      send_agent_message(fd, mock->status, NULL, 0);
+    }
+  }
+
+  kmyth_clear_and_free(request, request_len);
+  close(fd);
+  return NULL;
+}
+
+static int start_mock_agent(char *dir, char *path, size_t path_size,
+                            mock_agent_t * mock, pthread_t * thread)
+{
+  if (mkdtemp(dir) == NULL)
+  {
+    return 1;
+  }
+  snprintf(path, path_size, "%s/agent", dir);
+  if (setup_unix_server_socket(path, &mock->listen_fd))
+  {
+    rmdir(dir);
+    return 1;
+  }
+  if (pthread_create(thread, NULL, mock_agent, mock))
+  {
+    close(mock->listen_fd);
+    unlink(path);
+    rmdir(dir);
+    return 1;
+  }
+  return 0;
+}
+
+static void stop_mock_agent(char *dir, char *path, mock_agent_t * mock,
+                            pthread_t thread)
+{
+  pthread_join(thread, NULL);
+  close(mock->listen_fd);
+  unlink(path);
+  rmdir(dir);
+}
+
+//----------------------------------------------------------------------------
+// test_send_recv_agent_message()
+//----------------------------------------------------------------------------
+void test_send_recv_agent_message(void)
+{
+  int fds[2];
+
+  CU_ASSERT(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+
+  uint8_t payload[5] = { 1, 2, 3, 4, 5 };
+  uint8_t type = 0;
+  uint8_t *received = NULL;
+  size_t received_len = 0;
+
+  // Check a message with a payload round trips
+  CU_ASSERT(send_agent_message(fds[0], 7, payload, sizeof(payload)) == 0);
+  CU_ASSERT(recv_agent_message(fds[1], &type, &received, &received_len) == 0);
+  CU_ASSERT(type == 7);
+  CU_ASSERT(received_len == sizeof(payload));
+  CU_ASSERT(memcmp(received, payload, sizeof(payload)) == 0);
+  kmyth_clear_and_free(received, received_len);
+
+  // Check an empty payload round trips
+  CU_ASSERT(send_agent_message(fds[0], 3, NULL, 0) == 0);
+  CU_ASSERT(recv_agent_message(fds[1], &type, &received, &received_len) == 0);
+  CU_ASSERT(type == 3);
+  CU_ASSERT(received == NULL);
+  CU_ASSERT(received_len == 0);
+
+  // Check a non-empty length with a NULL payload is rejected
+  CU_ASSERT(send_agent_message(fds[0], 3, NULL, 4) == 1);
+
+  // Check an unsupported protocol version is rejected
+  uint8_t bad_version[KMYTH_AGENT_HEADER_LEN] = { 9, 1, 0, 0, 0, 0 };
+  CU_ASSERT(write(fds[0], bad_version, sizeof(bad_version)) ==
+            sizeof(bad_version));
+  CU_ASSERT(recv_agent_message(fds[1], &type, &received, &received_len) == 1);
+
+  // Check an oversized payload length is rejected before allocating it
+  uint8_t too_long[KMYTH_AGENT_HEADER_LEN] = {
+    KMYTH_AGENT_PROTOCOL_VERSION, 1, 0xFF, 0xFF, 0xFF, 0xFF
+  };
+  CU_ASSERT(write(fds[0], too_long, sizeof(too_long)) == sizeof(too_long));
+  CU_ASSERT(recv_agent_message(fds[1], &type, &received, &received_len) == 1);
+
+  // Check a connection closed mid-message is an error
+  uint8_t truncated[KMYTH_AGENT_HEADER_LEN + 1] = {
+    KMYTH_AGENT_PROTOCOL_VERSION, 1, 0, 0, 0, 4, 0xAA
+  };
+  CU_ASSERT(write(fds[0], truncated, sizeof(truncated)) == sizeof(truncated));
+  close(fds[0]);
+  CU_ASSERT(recv_agent_message(fds[1], &type, &received, &received_len) == 1);
+  CU_ASSERT(received == NULL);
+  close(fds[1]);
+}
+
+//----------------------------------------------------------------------------
+// test_agent_unseal_request()
+//----------------------------------------------------------------------------
+void test_agent_unseal_request(void)
+{
+  uint8_t ski[6] = { 's', 'k', 'i', 'd', 'a', 't' };
+  uint8_t auth[3] = { 'p', 'w', 'd' };
+  uint8_t *request = NULL;
+  size_t request_len = 0;
+
+  uint8_t *ski_out = NULL;
+  size_t ski_out_len = 0;
+  uint8_t *auth_out = NULL;
+  size_t auth_out_len = 0;
+  uint32_t ttl = 0;
+
+  // Check a request with an authorization string round trips
+  CU_ASSERT(build_agent_unseal_request(ski, sizeof(ski), auth, sizeof(auth),
+                                       60, &request, &request_len) == 0);
+  CU_ASSERT(request_len == 8 + sizeof(auth) + sizeof(ski));
+  CU_ASSERT(parse_agent_unseal_request(request, request_len,
+                                       &ski_out, &ski_out_len,
+                                       &auth_out, &auth_out_len, &ttl) == 0);
+  CU_ASSERT(ttl == 60);
+  CU_ASSERT(auth_out_len == sizeof(auth));
+  CU_ASSERT(memcmp(auth_out, auth, sizeof(auth)) == 0);
+  CU_ASSERT(ski_out_len == sizeof(ski));
+  CU_ASSERT(memcmp(ski_out, ski, sizeof(ski)) == 0);
+
+  // Check an authorization length running past the .ski is rejected
+  request[7] = (uint8_t) (sizeof(auth) + sizeof(ski));
+  CU_ASSERT(parse_agent_unseal_request(request, request_len,
+                                       &ski_out, &ski_out_len,
+                                       &auth_out, &auth_out_len, &ttl) == 1);
+  free(request);
+
+  // Check a request without an authorization string round trips
+  CU_ASSERT(build_agent_unseal_request(ski, sizeof(ski), NULL, 0, 0,
+                                       &request, &request_len) == 0);
+  CU_ASSERT(parse_agent_unseal_request(request, request_len,
+                                       &ski_out, &ski_out_len,
+                                       &auth_out, &auth_out_len, &ttl) == 0);
+  CU_ASSERT(ttl == 0);
+  CU_ASSERT(auth_out == NULL);
+  CU_ASSERT(auth_out_len == 0);
+  CU_ASSERT(ski_out_len == sizeof(ski));
+
+  // Check a truncated request is rejected
+  CU_ASSERT(parse_agent_unseal_request(request, 7, &ski_out, &ski_out_len,
+                                       &auth_out, &auth_out_len, &ttl) == 1);
+  free(request);
+
+  // Check an empty .ski is rejected
+  CU_ASSERT(build_agent_unseal_request(ski, 0, NULL, 0, 0,
+                                       &request, &request_len) == 1);
+  CU_ASSERT(build_agent_unseal_request(NULL, 4, NULL, 0, 0,
+                                       &request, &request_len) == 1);
+}
+
+//----------------------------------------------------------------------------
+// test_kmyth_agent_unseal()
+//----------------------------------------------------------------------------
+void test_kmyth_agent_unseal(void)
+{
+  char dir[] = "/tmp/kmyth-test-XXXXXX";
+  char path[64];
+  mock_agent_t mock = {.listen_fd = -1,.status = KMYTH_AGENT_STATUS_OK };
+  pthread_t thread;
+  uint8_t ski[4] = { 0xA, 0xB, 0xC, 0xD };
+  uint8_t *output = NULL;
+  size_t output_len = 0;
+
+  // Check a successful request returns the agent's response
+  if (start_mock_agent(dir, path, sizeof(path), &mock, &thread))
+  {
+    CU_FAIL("unable to start mock agent");
+    return;
+  }
+  CU_ASSERT(kmyth_agent_unseal(path, ski, sizeof(ski), NULL, 0, 0,
+                               &output, &output_len) == 0);
+  stop_mock_agent(dir, path, &mock, thread);
+  CU_ASSERT(mock.op == KMYTH_AGENT_OP_UNSEAL);
+  CU_ASSERT(output_len == sizeof(ski));
+  CU_ASSERT(output != NULL && memcmp(output, ski, sizeof(ski)) == 0);
+  kmyth_clear_and_free(output, output_len);
+
+  // Check a refused request fails and returns no output
+  strcpy(dir, "/tmp/kmyth-test-XXXXXX");
+  mock.status = KMYTH_AGENT_STATUS_DENIED;
+  if (start_mock_agent(dir, path, sizeof(path), &mock, &thread))
+  {
+    CU_FAIL("unable to start mock agent");
+    return;
+  }
+  CU_ASSERT(kmyth_agent_unseal(path, ski, sizeof(ski), NULL, 0, 0,
+                               &output, &output_len) == 1);
+  stop_mock_agent(dir, path, &mock, thread);
+  CU_ASSERT(output == NULL);
+  CU_ASSERT(output_len == 0);
+
+  // Check a missing agent fails
+  CU_ASSERT(kmyth_agent_unseal(path, ski, sizeof(ski), NULL, 0, 0,
+                               &output, &output_len) == 1);
+
+  // Check no socket (none given, none in the environment) fails
+  char *saved = getenv(KMYTH_AGENT_SOCK_ENV);
+
+  saved = (saved != NULL) ? strdup(saved) : NULL;
+  unsetenv(KMYTH_AGENT_SOCK_ENV);
+  CU_ASSERT(get_agent_socket_path() == NULL);
+  CU_ASSERT(kmyth_agent_unseal(NULL, ski, sizeof(ski), NULL, 0, 0,
+                               &output, &output_len) == 1);
+  if (saved != NULL)
+  {
+    setenv(KMYTH_AGENT_SOCK_ENV, saved, 1);
+    free(saved);
+  }
+}
+
+//----------------------------------------------------------------------------
+// test_kmyth_agent_flush()
+//----------------------------------------------------------------------------
+void test_kmyth_agent_flush(void)
+{
+  char dir[] = "/tmp/kmyth-test-XXXXXX";
+  char path[64];
+  mock_agent_t mock = {.listen_fd = -1,.status = KMYTH_AGENT_STATUS_OK };
+  pthread_t thread;
+
+  // Check a flush request is sent and acknowledged
+  if (start_mock_agent(dir, path, sizeof(path), &mock, &thread))
+  {
+    CU_FAIL("unable to start mock agent");
+    return;
+  }
+  CU_ASSERT(kmyth_agent_flush(path) == 0);
+  stop_mock_agent(dir, path, &mock, thread);
+  CU_ASSERT(mock.op == KMYTH_AGENT_OP_FLUSH);
+
+  // Check a missing agent fails
+  CU_ASSERT(kmyth_agent_flush(path) == 1);
+}
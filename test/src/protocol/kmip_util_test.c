@@ -0,0 +1,272 @@
+//############################################################################
+// kmip_util_test.c
+//
+// Tests for KMIP protocol utility functions in src/protocol/kmip_util.c
+//############################################################################
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <CUnit/CUnit.h>
+#include <kmip/kmip.h>
+
+#include "kmip_util_test.h"
+#include "kmip_util.h"
+#include "memory_util.h"
+
+//----------------------------------------------------------------------------
+// kmip_util_add_tests()
+//----------------------------------------------------------------------------
+int kmip_util_add_tests(CU_pSuite suite)
+{
+  if (NULL == CU_add_test(suite, "KMIP Get message Tests",
+                          test_kmip_get_message))
+  {
+    return 1;
+  }
+
+  if (NULL == CU_add_test(suite, "KMIP batch Get request Tests",
+                          test_kmip_get_batch_request))
+  {
+    return 1;
+  }
+
+  if (NULL == CU_add_test(suite, "KMIP batch Get response Tests",
+                          test_kmip_get_batch_response))
+  {
+    return 1;
+  }
+
+  return 0;
+}
+
+//----------------------------------------------------------------------------
+// test_kmip_get_message()
+//----------------------------------------------------------------------------
+void test_kmip_get_message(void)
+{
+  KMIP ctx = { 0 };
+  kmip_init(&ctx, NULL, 0, KMIP_1_0);
+
+  unsigned char id[] = "key-1";
+  size_t id_len = strlen((char *) id);
+  unsigned char key[32];
+
+  memset(key, 0xa5, sizeof(key));
+
+  // request round trip
+  unsigned char *request = NULL;
+  size_t request_len = 0;
+  unsigned char *parsed_id = NULL;
+  size_t parsed_id_len = 0;
+
+  CU_ASSERT(build_kmip_get_request(&ctx, id, id_len,
+                                   &request, &request_len) == 0);
+  CU_ASSERT(parse_kmip_get_request(&ctx, request, request_len,
+                                   &parsed_id, &parsed_id_len) == 0);
+  CU_ASSERT(parsed_id_len == id_len);
+  CU_ASSERT(memcmp(parsed_id, id, id_len) == 0);
+  free(parsed_id);
+  free(request);
+
+  // response round trip
+  unsigned char *response = NULL;
+  size_t response_len = 0;
+  unsigned char *parsed_key = NULL;
+  size_t parsed_key_len = 0;
+
+  CU_ASSERT(build_kmip_get_response(&ctx, id, id_len, key, sizeof(key),
+                                    &response, &response_len) == 0);
+  CU_ASSERT(parse_kmip_get_response(&ctx, response, response_len,
+                                    &parsed_id, &parsed_id_len,
+                                    &parsed_key, &parsed_key_len) == 0);
+  CU_ASSERT(parsed_id_len == id_len);
+  CU_ASSERT(memcmp(parsed_id, id, id_len) == 0);
+  CU_ASSERT(parsed_key_len == sizeof(key));
+  CU_ASSERT(memcmp(parsed_key, key, sizeof(key)) == 0);
+  free(parsed_id);
+  free(parsed_key);
+  kmyth_clear_and_free(response, response_len);
+
+  // a successful Get response without a payload is rejected
+  ProtocolVersion protocol_version = { 0 };
+  kmip_init_protocol_version(&protocol_version, ctx.version);
+
+  ResponseHeader header = { 0 };
+  kmip_init_response_header(&header);
+  header.protocol_version = &protocol_version;
+  header.batch_count = 1;
+
+  ResponseBatchItem batch_item = { 0 };
+  batch_item.operation = KMIP_OP_GET;
+  batch_item.result_status = KMIP_STATUS_SUCCESS;
+
+  ResponseMessage message = { 0 };
+  message.response_header = &header;
+  message.batch_items = &batch_item;
+  message.batch_count = 1;
+
+  unsigned char encoding[512];
+
+  kmip_reset(&ctx);
+  kmip_set_buffer(&ctx, encoding, sizeof(encoding));
+  CU_ASSERT_FATAL(kmip_encode_response_message(&ctx, &message) == KMIP_OK);
+  response_len = (size_t) (ctx.index - ctx.buffer);
+  kmip_set_buffer(&ctx, NULL, 0);
+
+  parsed_id = NULL;
+  parsed_key = NULL;
+  CU_ASSERT(parse_kmip_get_response(&ctx, encoding, response_len,
+                                    &parsed_id, &parsed_id_len,
+                                    &parsed_key, &parsed_key_len) == 1);
+  CU_ASSERT(parsed_id == NULL);
+  CU_ASSERT(parsed_key == NULL);
+
+  kmip_destroy(&ctx);
+}
+
+//----------------------------------------------------------------------------
+// test_kmip_get_batch_request()
+//----------------------------------------------------------------------------
+void test_kmip_get_batch_request(void)
+{
+  KMIP ctx = { 0 };
+  kmip_init(&ctx, NULL, 0, KMIP_1_0);
+
+  // enough IDs that the encoding outgrows its initial buffer
+  size_t count = 200;
+  unsigned char *ids[200];
+  size_t id_lens[200];
+  char id_values[200][16];
+
+  for (size_t i = 0; i < count; i++)
+  {
+    id_lens[i] = (size_t) snprintf(id_values[i], sizeof(id_values[i]),
+                                   "key-%zu", i);
+    ids[i] = (unsigned char *) id_values[i];
+  }
+
+  unsigned char *buffer = NULL;
+  size_t buffer_size = 0;
+  size_t request_len = 0;
+
+  CU_ASSERT(build_kmip_get_batch_request(&ctx, ids, id_lens, count,
+                                         &buffer, &buffer_size,
+                                         &request_len) == 0);
+  CU_ASSERT(buffer_size > KMIP_ENCODING_BLOCK_SIZE);
+  CU_ASSERT(request_len <= buffer_size);
+
+  unsigned char **parsed_ids = NULL;
+  size_t *parsed_id_lens = NULL;
+  size_t parsed_count = 0;
+
+  CU_ASSERT(parse_kmip_get_batch_request(&ctx, buffer, request_len,
+                                         &parsed_ids, &parsed_id_lens,
+                                         &parsed_count) == 0);
+  CU_ASSERT(parsed_count == count);
+  for (size_t i = 0; i < parsed_count; i++)
+  {
+    CU_ASSERT(parsed_id_lens[i] == id_lens[i]);
+    CU_ASSERT(strcmp((char *) parsed_ids[i], id_values[i]) == 0);
+    free(parsed_ids[i]);
+  }
+  free(parsed_ids);
+  free(parsed_id_lens);
+
+  // the buffer is reused (not reallocated) for a smaller message
+  unsigned char *reused = buffer;
+  size_t reused_size = buffer_size;
+
+  CU_ASSERT(build_kmip_get_batch_request(&ctx, ids, id_lens, 2,
+                                         &buffer, &buffer_size,
+                                         &request_len) == 0);
+  CU_ASSERT(buffer == reused);
+  CU_ASSERT(buffer_size == reused_size);
+
+  // invalid counts are rejected
+  CU_ASSERT(build_kmip_get_batch_request(&ctx, ids, id_lens, 0,
+                                         &buffer, &buffer_size,
+                                         &request_len) == 1);
+
+  kmyth_clear_and_free(buffer, buffer_size);
+  kmip_destroy(&ctx);
+}
+
+//----------------------------------------------------------------------------
+// test_kmip_get_batch_response()
+//----------------------------------------------------------------------------
+void test_kmip_get_batch_response(void)
+{
+  KMIP ctx = { 0 };
+  kmip_init(&ctx, NULL, 0, KMIP_1_0);
+
+  size_t count = 3;
+  char *id_values[] = { "alpha", "bravo", "charlie" };
+  unsigned char *ids[3];
+  size_t id_lens[3];
+  unsigned char key_values[3][32];
+  unsigned char *keys[3];
+  size_t key_lens[3];
+
+  for (size_t i = 0; i < count; i++)
+  {
+    ids[i] = (unsigned char *) id_values[i];
+    id_lens[i] = strlen(id_values[i]);
+    memset(key_values[i], (int) i + 1, sizeof(key_values[i]));
+    keys[i] = key_values[i];
+    key_lens[i] = sizeof(key_values[i]);
+  }
+
+  unsigned char *buffer = NULL;
+  size_t buffer_size = 0;
+  size_t response_len = 0;
+  unsigned char *parsed_keys[3];
+  size_t parsed_key_lens[3];
+
+  // every key is mapped back to its ID
+  CU_ASSERT(build_kmip_get_batch_response(&ctx, ids, id_lens, keys, key_lens,
+                                          count, &buffer, &buffer_size,
+                                          &response_len) == 0);
+  CU_ASSERT(parse_kmip_get_batch_response(&ctx, buffer, response_len,
+                                          ids, id_lens, count,
+                                          parsed_keys,
+                                          parsed_key_lens) == 0);
+  for (size_t i = 0; i < count; i++)
+  {
+    CU_ASSERT(parsed_key_lens[i] == key_lens[i]);
+    CU_ASSERT(memcmp(parsed_keys[i], keys[i], key_lens[i]) == 0);
+    kmyth_clear_and_free(parsed_keys[i], parsed_key_lens[i]);
+  }
+
+  // a response for a different number of IDs is rejected
+  CU_ASSERT(parse_kmip_get_batch_response(&ctx, buffer, response_len,
+                                          ids, id_lens, count - 1,
+                                          parsed_keys,
+                                          parsed_key_lens) == 1);
+
+  // a response for different IDs is rejected
+  unsigned char *other_ids[3] = { ids[1], ids[0], ids[2] };
+  size_t other_id_lens[3] = { id_lens[1], id_lens[0], id_lens[2] };
+
+  CU_ASSERT(parse_kmip_get_batch_response(&ctx, buffer, response_len,
+                                          other_ids, other_id_lens, count,
+                                          parsed_keys,
+                                          parsed_key_lens) == 1);
+
+  // a missing key fails the batch, and no keys are returned
+  keys[1] = NULL;
+  CU_ASSERT(build_kmip_get_batch_response(&ctx, ids, id_lens, keys, key_lens,
+                                          count, &buffer, &buffer_size,
+                                          &response_len) == 0);
+  CU_ASSERT(parse_kmip_get_batch_response(&ctx, buffer, response_len,
+                                          ids, id_lens, count,
+                                          parsed_keys,
+                                          parsed_key_lens) == 1);
+  for (size_t i = 0; i < count; i++)
+  {
+    CU_ASSERT(parsed_keys[i] == NULL);
+  }
+
+  kmyth_clear_and_free(buffer, buffer_size);
+  kmip_destroy(&ctx);
+}
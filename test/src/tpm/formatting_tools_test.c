@@ -5,6 +5,7 @@
 //                                        and in tpm2/src/util/formatting_tools.c
 //############################################################################
 
+#include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <CUnit/CUnit.h>
@@ -135,6 +136,35 @@ int formatting_tools_add_tests(CU_pSuite suite)
     return 1;
   }
 
+  if (NULL == CU_add_test(suite, "find_delim() Tests", test_find_delim))
+  {
+    return 1;
+  }
+
+  if (NULL ==
+      CU_add_test(suite, "get_block_view() Tests", test_get_block_view))
+  {
+    return 1;
+  }
+
+  if (NULL ==
+      CU_add_test(suite, "block_stream_*() Tests", test_block_stream))
+  {
+    return 1;
+  }
+
+  if (NULL ==
+      CU_add_test(suite, "parse_pcrs_string() Tests", test_parse_pcrs_string))
+  {
+    return 1;
+  }
+
+  if (NULL == CU_add_test(suite, "parse_unsigned_string() Tests",
+                          test_parse_unsigned_string))
+  {
+    return 1;
+  }
+
   if (NULL ==
       CU_add_test(suite, "create_nkl_bytes() Tests", test_create_nkl_bytes))
   {
@@ -153,6 +183,40 @@ int formatting_tools_add_tests(CU_pSuite suite)
     return 1;
   }
 
+  if (NULL ==
+      CU_add_test(suite, "getBase64EncodedSize() Tests",
+                  test_getBase64EncodedSize))
+  {
+    return 1;
+  }
+
+  if (NULL ==
+      CU_add_test(suite, "encodeBase64DataToBuffer() Tests",
+                  test_encodeBase64DataToBuffer))
+  {
+    return 1;
+  }
+
+  if (NULL ==
+      CU_add_test(suite, "get_block_bytes_size() Tests",
+                  test_get_block_bytes_size))
+  {
+    return 1;
+  }
+
+  if (NULL ==
+      CU_add_test(suite, "create_block_bytes() Tests", test_create_block_bytes))
+  {
+    return 1;
+  }
+
+  if (NULL ==
+      CU_add_test(suite, "write_block_bytes_to_fd() Tests",
+                  test_write_block_bytes_to_fd))
+  {
+    return 1;
+  }
+
   if (NULL == CU_add_test(suite, "concat() Tests", test_concat))
   {
     return 1;
@@ -1813,6 +1877,265 @@ void test_get_block_bytes(void)
   free(sb);
 }
 
+//----------------------------------------------------------------------------
+// test_find_delim
+//----------------------------------------------------------------------------
+void test_find_delim(void)
+{
+  uint8_t *data = (uint8_t *) "AB-CD--\n-----END-----\n";
+  size_t data_len = strlen((char *) data);
+
+  //Test that partial matches are skipped and the delimiter is found
+  CU_ASSERT(find_delim(data, data_len, "-----END-----\n", 14) == data + 8);
+  CU_ASSERT(find_delim(data, data_len, "-CD", 3) == data + 2);
+
+  //Test delimiters that are absent or don't fit in the data
+  CU_ASSERT(find_delim(data, data_len, "-----NONE-----\n", 15) == NULL);
+  CU_ASSERT(find_delim(data, 21, "-----END-----\n", 14) == NULL);
+  CU_ASSERT(find_delim(NULL, data_len, "-CD", 3) == NULL);
+  CU_ASSERT(find_delim(data, data_len, "", 0) == NULL);
+}
+
+//----------------------------------------------------------------------------
+// test_get_block_view
+//----------------------------------------------------------------------------
+void test_get_block_view(void)
+{
+  uint8_t *position = (uint8_t *) CONST_SKI_BYTES;
+  size_t remaining = strlen(CONST_SKI_BYTES);
+  block_view_t view = {.data = NULL,.size = 0 };
+
+  //Test valid block - view points into the input, which is advanced to the
+  //next delimiter
+  CU_ASSERT(get_block_view(&position, &remaining, &view,
+                           KMYTH_DELIM_PCR_SELECTION_LIST,
+                           strlen(KMYTH_DELIM_PCR_SELECTION_LIST),
+                           KMYTH_DELIM_STORAGE_KEY_PUBLIC,
+                           strlen(KMYTH_DELIM_STORAGE_KEY_PUBLIC)) == 0);
+  CU_ASSERT(view.data == (uint8_t *) CONST_SKI_BYTES +
+            strlen(KMYTH_DELIM_PCR_SELECTION_LIST));
+  CU_ASSERT(position == view.data + view.size);
+  CU_ASSERT(remaining == strlen(CONST_SKI_BYTES) - view.size -
+            strlen(KMYTH_DELIM_PCR_SELECTION_LIST));
+  CU_ASSERT(strncmp((char *) position, KMYTH_DELIM_STORAGE_KEY_PUBLIC,
+                    strlen(KMYTH_DELIM_STORAGE_KEY_PUBLIC)) == 0);
+
+  //Test that the view matches the copy made by get_block_bytes()
+  char *contents = (char *) CONST_SKI_BYTES;
+  size_t contents_len = strlen(CONST_SKI_BYTES);
+  uint8_t *block = NULL;
+  size_t blocksize = 0;
+
+  CU_ASSERT(get_block_bytes(&contents, &contents_len, &block, &blocksize,
+                            KMYTH_DELIM_PCR_SELECTION_LIST,
+                            strlen(KMYTH_DELIM_PCR_SELECTION_LIST),
+                            KMYTH_DELIM_STORAGE_KEY_PUBLIC,
+                            strlen(KMYTH_DELIM_STORAGE_KEY_PUBLIC)) == 0);
+  CU_ASSERT(blocksize == view.size);
+  CU_ASSERT(memcmp(block, view.data, view.size) == 0);
+  free(block);
+
+  //Test wrong delimiter, missing next delimiter, and empty block
+  uint8_t *start = position;
+  size_t start_remaining = remaining;
+
+  CU_ASSERT(get_block_view(&position, &remaining, &view,
+                           KMYTH_DELIM_ENC_DATA, strlen(KMYTH_DELIM_ENC_DATA),
+                           KMYTH_DELIM_END_FILE,
+                           strlen(KMYTH_DELIM_END_FILE)) == 1);
+  CU_ASSERT(get_block_view(&position, &remaining, &view,
+                           KMYTH_DELIM_STORAGE_KEY_PUBLIC,
+                           strlen(KMYTH_DELIM_STORAGE_KEY_PUBLIC),
+                           KMYTH_DELIM_END_NKL,
+                           strlen(KMYTH_DELIM_END_NKL)) == 1);
+  CU_ASSERT(position == start);
+  CU_ASSERT(remaining == start_remaining);
+
+  uint8_t *empty = (uint8_t *) "-----NKL DATA-----\n-----NKL END-----\n";
+  size_t empty_len = strlen((char *) empty);
+
+  CU_ASSERT(get_block_view(&empty, &empty_len, &view,
+                           KMYTH_DELIM_NKL_DATA, strlen(KMYTH_DELIM_NKL_DATA),
+                           KMYTH_DELIM_END_NKL,
+                           strlen(KMYTH_DELIM_END_NKL)) == 1);
+}
+
+//----------------------------------------------------------------------------
+// test_block_stream (and its content callback)
+//----------------------------------------------------------------------------
+typedef struct
+{
+  uint8_t *data[8];
+  size_t len[8];
+} stream_blocks_t;
+
+static int collect_stream_block(void *ctx, size_t block_index,
+                                uint8_t * data, size_t data_len)
+{
+  stream_blocks_t *blocks = (stream_blocks_t *) ctx;
+
+  return concat(&blocks->data[block_index], &blocks->len[block_index], data,
+                data_len);
+}
+
+void test_block_stream(void)
+{
+  char *delims[] = {
+    KMYTH_DELIM_PCR_SELECTION_LIST, KMYTH_DELIM_STORAGE_KEY_PUBLIC,
+    KMYTH_DELIM_STORAGE_KEY_PRIVATE, KMYTH_DELIM_CIPHER_SUITE,
+    KMYTH_DELIM_SYM_KEY_PUBLIC, KMYTH_DELIM_SYM_KEY_PRIVATE,
+    KMYTH_DELIM_ENC_DATA, KMYTH_DELIM_END_FILE
+  };
+  uint8_t *ski = (uint8_t *) CONST_SKI_BYTES;
+  size_t ski_len = strlen(CONST_SKI_BYTES);
+  block_stream_t stream;
+  stream_blocks_t blocks = { {NULL}, {0} };
+
+  //Test that a .ski fed in small (delimiter splitting) pieces produces the
+  //same blocks as get_block_view()
+  CU_ASSERT(block_stream_init(&stream, delims, 8, collect_stream_block,
+                              &blocks) == 0);
+  for (size_t i = 0; i < ski_len; i += 7)
+  {
+    size_t piece = (ski_len - i < 7) ? ski_len - i : 7;
+
+    CU_ASSERT(block_stream_update(&stream, ski + i, piece) == 0);
+  }
+  CU_ASSERT(block_stream_final(&stream) == 0);
+
+  uint8_t *position = ski;
+  size_t remaining = ski_len;
+
+  for (size_t i = 0; i < 7; i++)
+  {
+    block_view_t view = {.data = NULL,.size = 0 };
+
+    CU_ASSERT(get_block_view(&position, &remaining, &view, delims[i],
+                             strlen(delims[i]), delims[i + 1],
+                             strlen(delims[i + 1])) == 0);
+    CU_ASSERT(blocks.len[i] == view.size);
+    CU_ASSERT(memcmp(blocks.data[i], view.data, view.size) == 0);
+    free(blocks.data[i]);
+    blocks.data[i] = NULL;
+    blocks.len[i] = 0;
+  }
+
+  //Test that data after the end delimiter fails
+  CU_ASSERT(block_stream_update(&stream, (uint8_t *) "x", 1) == 1);
+
+  //Test that a truncated stream fails
+  CU_ASSERT(block_stream_init(&stream, delims, 8, collect_stream_block,
+                              &blocks) == 0);
+  CU_ASSERT(block_stream_update(&stream, ski, ski_len - 1) == 0);
+  CU_ASSERT(block_stream_final(&stream) == 1);
+  for (size_t i = 0; i < 8; i++)
+  {
+    free(blocks.data[i]);
+    blocks.data[i] = NULL;
+    blocks.len[i] = 0;
+  }
+
+  //Test unexpected first delimiter and empty block
+  char *nkl_delims[] = { KMYTH_DELIM_NKL_DATA, KMYTH_DELIM_END_NKL };
+  char *empty = "-----NKL DATA-----\n-----NKL END-----\n";
+
+  CU_ASSERT(block_stream_init(&stream, nkl_delims, 2, collect_stream_block,
+                              &blocks) == 0);
+  CU_ASSERT(block_stream_update(&stream, ski, ski_len) == 1);
+  CU_ASSERT(block_stream_init(&stream, nkl_delims, 2, collect_stream_block,
+                              &blocks) == 0);
+  CU_ASSERT(block_stream_update(&stream, (uint8_t *) empty, strlen(empty))
+            == 1);
+
+  //Test invalid initialization
+  CU_ASSERT(block_stream_init(&stream, nkl_delims, 1, collect_stream_block,
+                              &blocks) == 1);
+  CU_ASSERT(block_stream_init(&stream, nkl_delims, 2, NULL, &blocks) == 1);
+}
+
+//----------------------------------------------------------------------------
+// test_parse_pcrs_string
+//----------------------------------------------------------------------------
+void test_parse_pcrs_string(void)
+{
+  int *pcrs = NULL;
+  int pcrs_len = -1;
+
+  // NULL string selects no PCRs
+  CU_ASSERT(parse_pcrs_string(NULL, &pcrs, &pcrs_len) == 0);
+  CU_ASSERT(pcrs_len == 0);
+  CU_ASSERT(pcrs == NULL);
+
+  // Blank and comma separators (and combinations) are accepted
+  char valid[] = "0, 1 2,,7";
+
+  CU_ASSERT(parse_pcrs_string(valid, &pcrs, &pcrs_len) == 0);
+  CU_ASSERT(pcrs_len == 4);
+  CU_ASSERT(pcrs[0] == 0);
+  CU_ASSERT(pcrs[1] == 1);
+  CU_ASSERT(pcrs[2] == 2);
+  CU_ASSERT(pcrs[3] == 7);
+  free(pcrs);
+  pcrs = NULL;
+
+  // More entries than the initial allocation forces the array to grow
+  char long_list[] = "0 1 2 3 4 5 6 7 8 9 10 11 12 13 14 15 16 17 18 19 20 21 "
+    "22 23 0 1 2 3";
+
+  CU_ASSERT(parse_pcrs_string(long_list, &pcrs, &pcrs_len) == 0);
+  CU_ASSERT(pcrs_len == 28);
+  CU_ASSERT(pcrs[23] == 23);
+  CU_ASSERT(pcrs[27] == 3);
+  free(pcrs);
+  pcrs = NULL;
+
+  // Disallowed characters and non-numeric entries are rejected
+  char bad_char[] = "0;1";
+
+  CU_ASSERT(parse_pcrs_string(bad_char, &pcrs, &pcrs_len) == 1);
+  CU_ASSERT(pcrs_len == 0);
+
+  char not_a_number[] = "zero";
+
+  CU_ASSERT(parse_pcrs_string(not_a_number, &pcrs, &pcrs_len) == 1);
+  CU_ASSERT(pcrs_len == 0);
+}
+
+//----------------------------------------------------------------------------
+// test_parse_unsigned_string
+//----------------------------------------------------------------------------
+void test_parse_unsigned_string(void)
+{
+  unsigned long value = 0;
+
+  // In-range values, including the bounds, are accepted
+  CU_ASSERT(parse_unsigned_string("42", 1, 100, &value) == 0);
+  CU_ASSERT(value == 42);
+  CU_ASSERT(parse_unsigned_string("1", 1, 100, &value) == 0);
+  CU_ASSERT(value == 1);
+  CU_ASSERT(parse_unsigned_string("100", 1, 100, &value) == 0);
+  CU_ASSERT(value == 100);
+
+  // Out-of-range values are rejected and leave the output untouched
+  value = 7;
+  CU_ASSERT(parse_unsigned_string("0", 1, 100, &value) == 1);
+  CU_ASSERT(parse_unsigned_string("101", 1, 100, &value) == 1);
+  CU_ASSERT(parse_unsigned_string("99999999999999999999999", 0, ULONG_MAX,
+                                  &value) == 1);
+  CU_ASSERT(value == 7);
+
+  // Empty, signed, padded, and non-numeric strings are rejected
+  CU_ASSERT(parse_unsigned_string("", 0, 100, &value) == 1);
+  CU_ASSERT(parse_unsigned_string("-1", 0, ULONG_MAX, &value) == 1);
+  CU_ASSERT(parse_unsigned_string("+1", 0, 100, &value) == 1);
+  CU_ASSERT(parse_unsigned_string(" 1", 0, 100, &value) == 1);
+  CU_ASSERT(parse_unsigned_string("1 ", 0, 100, &value) == 1);
+  CU_ASSERT(parse_unsigned_string("12abc", 0, 100, &value) == 1);
+  CU_ASSERT(parse_unsigned_string("foo", 0, 100, &value) == 1);
+  CU_ASSERT(parse_unsigned_string(NULL, 0, 100, &value) == 1);
+  CU_ASSERT(value == 7);
+}
+
 //----------------------------------------------------------------------------
 // test_create_nkl_bytes
 //----------------------------------------------------------------------------
@@ -1956,6 +2279,164 @@ void test_decodeBase64Data(void)
   free(pcr);
 }
 
+//----------------------------------------------------------------------------
+// test_getBase64EncodedSize()
+//----------------------------------------------------------------------------
+void test_getBase64EncodedSize(void)
+{
+  // Test that the computed size matches the encodeBase64Data() result
+  CU_ASSERT(getBase64EncodedSize(RAW_PCR_LEN) == strlen(RAW_PCR64));
+
+  // Test line boundaries: 48 bytes fill exactly one 64 symbol line
+  CU_ASSERT(getBase64EncodedSize(1) == 5);
+  CU_ASSERT(getBase64EncodedSize(48) == 65);
+  CU_ASSERT(getBase64EncodedSize(49) == 70);
+
+  // Test empty and overflowing inputs
+  CU_ASSERT(getBase64EncodedSize(0) == 0);
+  CU_ASSERT(getBase64EncodedSize(SIZE_MAX) == 0);
+}
+
+//----------------------------------------------------------------------------
+// test_encodeBase64DataToBuffer()
+//----------------------------------------------------------------------------
+void test_encodeBase64DataToBuffer(void)
+{
+  size_t pcr64_len = strlen(RAW_PCR64);
+  uint8_t *pcr64 = malloc(pcr64_len);
+
+  //Test valid encode matches encodeBase64Data()
+  CU_ASSERT(encodeBase64DataToBuffer(RAW_PCR, RAW_PCR_LEN, pcr64, pcr64_len)
+            == 0);
+  CU_ASSERT(memcmp(pcr64, RAW_PCR64, pcr64_len) == 0);
+
+  //Test empty input
+  CU_ASSERT(encodeBase64DataToBuffer(NULL, RAW_PCR_LEN, pcr64, pcr64_len)
+            == 1);
+  CU_ASSERT(encodeBase64DataToBuffer(RAW_PCR, 0, pcr64, pcr64_len) == 1);
+
+  //Test output buffer too small
+  CU_ASSERT(encodeBase64DataToBuffer(RAW_PCR, RAW_PCR_LEN, pcr64,
+                                     pcr64_len - 1) == 1);
+  free(pcr64);
+}
+
+//----------------------------------------------------------------------------
+// test_get_block_bytes_size()
+//----------------------------------------------------------------------------
+void test_get_block_bytes_size(void)
+{
+  block_spec_t blocks[] = {
+    {KMYTH_DELIM_PCR_SELECTION_LIST, RAW_PCR, RAW_PCR_LEN, false},
+    {KMYTH_DELIM_CIPHER_SUITE, (uint8_t *) "AES/GCM/NoPadding/256", 21, true},
+  };
+  size_t size = 0;
+
+  //Test valid block list
+  CU_ASSERT(get_block_bytes_size(blocks, 2, KMYTH_DELIM_END_FILE, &size) == 0);
+  CU_ASSERT(size == strlen(KMYTH_DELIM_PCR_SELECTION_LIST) + strlen(RAW_PCR64)
+            + strlen(KMYTH_DELIM_CIPHER_SUITE) + 22
+            + strlen(KMYTH_DELIM_END_FILE));
+
+  //Test invalid block lists
+  CU_ASSERT(get_block_bytes_size(NULL, 2, KMYTH_DELIM_END_FILE, &size) == 1);
+  CU_ASSERT(get_block_bytes_size(blocks, 0, KMYTH_DELIM_END_FILE, &size) == 1);
+  CU_ASSERT(get_block_bytes_size(blocks, 2, NULL, &size) == 1);
+  blocks[1].data_len = 0;
+  CU_ASSERT(get_block_bytes_size(blocks, 2, KMYTH_DELIM_END_FILE, &size) == 1);
+}
+
+//----------------------------------------------------------------------------
+// test_create_block_bytes()
+//----------------------------------------------------------------------------
+void test_create_block_bytes(void)
+{
+  block_spec_t blocks[] = {
+    {KMYTH_DELIM_PCR_SELECTION_LIST, RAW_PCR, RAW_PCR_LEN, false},
+    {KMYTH_DELIM_CIPHER_SUITE, (uint8_t *) "AES/GCM/NoPadding/256", 21, true},
+  };
+  uint8_t *out = NULL;
+  size_t out_len = 0;
+
+  //Test valid block list produces the same output as concatenating the
+  //delimiters and encoded blocks
+  uint8_t *expected = NULL;
+  size_t expected_len = 0;
+
+  concat(&expected, &expected_len, (uint8_t *) KMYTH_DELIM_PCR_SELECTION_LIST,
+         strlen(KMYTH_DELIM_PCR_SELECTION_LIST));
+  concat(&expected, &expected_len, (uint8_t *) RAW_PCR64, strlen(RAW_PCR64));
+  concat(&expected, &expected_len, (uint8_t *) KMYTH_DELIM_CIPHER_SUITE,
+         strlen(KMYTH_DELIM_CIPHER_SUITE));
+  concat(&expected, &expected_len, (uint8_t *) "AES/GCM/NoPadding/256\n",
+         22);
+  concat(&expected, &expected_len, (uint8_t *) KMYTH_DELIM_END_FILE,
+         strlen(KMYTH_DELIM_END_FILE));
+
+  CU_ASSERT(create_block_bytes(blocks, 2, KMYTH_DELIM_END_FILE, &out,
+                               &out_len) == 0);
+  CU_ASSERT(out_len == expected_len);
+  CU_ASSERT(memcmp(out, expected, expected_len) == 0);
+  free(out);
+  free(expected);
+  out = NULL;
+  out_len = 0;
+
+  //Test that an empty block fails and output is not changed
+  blocks[0].data = NULL;
+  CU_ASSERT(create_block_bytes(blocks, 2, KMYTH_DELIM_END_FILE, &out,
+                               &out_len) == 1);
+  CU_ASSERT(out == NULL);
+  CU_ASSERT(out_len == 0);
+}
+
+//----------------------------------------------------------------------------
+// test_write_block_bytes_to_fd()
+//----------------------------------------------------------------------------
+void test_write_block_bytes_to_fd(void)
+{
+  // use an input spanning several encoding chunks
+  size_t data_len = 200000;
+  uint8_t *data = malloc(data_len);
+
+  for (size_t i = 0; i < data_len; i++)
+  {
+    data[i] = (uint8_t) (i * 7);
+  }
+
+  block_spec_t blocks[] = {
+    {KMYTH_DELIM_CIPHER_SUITE, (uint8_t *) "AES/GCM/NoPadding/256", 21, true},
+    {KMYTH_DELIM_ENC_DATA, data, data_len, false},
+  };
+  uint8_t *expected = NULL;
+  size_t expected_len = 0;
+
+  CU_ASSERT(create_block_bytes(blocks, 2, KMYTH_DELIM_END_FILE, &expected,
+                               &expected_len) == 0);
+
+  //Test that the streamed output matches create_block_bytes()
+  FILE *file = tmpfile();
+
+  CU_ASSERT(file != NULL);
+  CU_ASSERT(write_block_bytes_to_fd(fileno(file), blocks, 2,
+                                    KMYTH_DELIM_END_FILE) == 0);
+  rewind(file);
+
+  uint8_t *written = malloc(expected_len + 1);
+  size_t written_len = fread(written, 1, expected_len + 1, file);
+
+  CU_ASSERT(written_len == expected_len);
+  CU_ASSERT(memcmp(written, expected, expected_len) == 0);
+  fclose(file);
+
+  //Test invalid file descriptor
+  CU_ASSERT(write_block_bytes_to_fd(-1, blocks, 2, KMYTH_DELIM_END_FILE) == 1);
+
+  free(written);
+  free(expected);
+  free(data);
+}
+
 //----------------------------------------------------------------------------
 // test_concat()
 //----------------------------------------------------------------------------
@@ -4,9 +4,11 @@
 // Tests kmyth seal/unseal functions in tpm2/src/tpm/kmyth_seal_unseal_implc.
 //################################################################################
 
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <string.h>
 #include <CUnit/CUnit.h>
 
 #include "kmyth.h"
@@ -17,6 +19,9 @@
 #include "tpm2_interface.h"
 #include "kmyth_seal_unseal_impl.h"
 #include "kmyth_seal_unseal_impl_test.h"
+#include "memory_util.h"
+
+#include "cipher/envelope.h"
 
 //--------------------------------------------------------------------------------
 // kmyth_seal_unseal_impl_add_tests()
@@ -30,6 +35,7 @@ int kmyth_seal_unseal_impl_add_tests(CU_pSuite suite)
   bool emulator = true;
 
   get_tpm2_impl_type(sapi_ctx, &emulator);
+  free_tpm2_resources(&sapi_ctx);
   if (!emulator)
   {
     return (0);
@@ -45,6 +51,18 @@ int kmyth_seal_unseal_impl_add_tests(CU_pSuite suite)
   {
     return 1;
   }
+  if (NULL ==
+      CU_add_test(suite, "tpm2_kmyth_unseal_multi() Tests",
+                  test_tpm2_kmyth_unseal_multi))
+  {
+    return 1;
+  }
+  if (NULL ==
+      CU_add_test(suite, "Concurrent seal/unseal Tests",
+                  test_tpm2_kmyth_concurrent_seal_unseal))
+  {
+    return 1;
+  }
   if (NULL ==
       CU_add_test(suite, "tpm2_kmyth_seal_file() Tests",
                   test_tpm2_kmyth_seal_file))
@@ -58,6 +76,31 @@ int kmyth_seal_unseal_impl_add_tests(CU_pSuite suite)
     return 1;
   }
 
+  if (NULL ==
+      CU_add_test(suite, "tpm2_kmyth_create_kek() Tests",
+                  test_tpm2_kmyth_create_kek))
+  {
+    return 1;
+  }
+  if (NULL ==
+      CU_add_test(suite, "tpm2_kmyth_envelope_seal() Tests",
+                  test_tpm2_kmyth_envelope_seal))
+  {
+    return 1;
+  }
+  if (NULL ==
+      CU_add_test(suite, "tpm2_kmyth_envelope_unseal() Tests",
+                  test_tpm2_kmyth_envelope_unseal))
+  {
+    return 1;
+  }
+
+  if (NULL ==
+      CU_add_test(suite, "tpm2_kmyth_reseal() Tests", test_tpm2_kmyth_reseal))
+  {
+    return 1;
+  }
+
   if (NULL ==
       CU_add_test(suite, "tpm2_kmyth_seal_data() Tests",
                   test_tpm2_kmyth_seal_data))
@@ -134,7 +177,7 @@ void test_tpm2_kmyth_seal(void)
   CU_ASSERT(memcmp(plaintext, input, input_len) == 0);
 
   free(output);
-  free(plaintext);
+  kmyth_clear_and_free(plaintext, plaintext_len);
 }
 
 //--------------------------------------------------------------------------------
@@ -178,6 +221,153 @@ void test_tpm2_kmyth_unseal(void)
   // tests for tpm2_kmyth_seal.
 }
 
+//--------------------------------------------------------------------------------
+// test_tpm2_kmyth_unseal_multi
+//--------------------------------------------------------------------------------
+void test_tpm2_kmyth_unseal_multi(void)
+{
+  uint8_t input0[8] = { 0, 1, 2, 3, 4, 5, 6, 7 };
+  uint8_t input1[4] = { 8, 9, 10, 11 };
+
+  uint8_t *auth_bytes = NULL;
+  size_t auth_bytes_len = 0;
+
+  uint8_t *owner_auth_bytes = NULL;
+  size_t oa_bytes_len = 0;
+
+  uint8_t *sealed[3] = { NULL };
+  size_t sealed_len[3] = { 0 };
+
+  tpm2_kmyth_seal(input0, 8, &sealed[0], &sealed_len[0], auth_bytes,
+                  auth_bytes_len, owner_auth_bytes, oa_bytes_len, NULL, 0,
+                  NULL);
+  tpm2_kmyth_seal(input1, 4, &sealed[1], &sealed_len[1], auth_bytes,
+                  auth_bytes_len, owner_auth_bytes, oa_bytes_len, NULL, 0,
+                  NULL);
+  tpm2_kmyth_seal(input0, 8, &sealed[2], &sealed_len[2], auth_bytes,
+                  auth_bytes_len, owner_auth_bytes, oa_bytes_len, NULL, 0,
+                  NULL);
+
+  uint8_t *output[3] = { NULL };
+  size_t output_len[3] = { 0 };
+
+  // Check that multiple inputs unseal correctly (using one policy session)
+  CU_ASSERT(tpm2_kmyth_unseal_multi
+            (sealed, sealed_len, 3, output, output_len, auth_bytes,
+             auth_bytes_len, owner_auth_bytes, oa_bytes_len) == 0);
+  CU_ASSERT(output_len[0] == 8);
+  CU_ASSERT(memcmp(output[0], input0, 8) == 0);
+  CU_ASSERT(output_len[1] == 4);
+  CU_ASSERT(memcmp(output[1], input1, 4) == 0);
+  CU_ASSERT(output_len[2] == 8);
+  CU_ASSERT(memcmp(output[2], input0, 8) == 0);
+  for (int i = 0; i < 3; i++)
+  {
+    kmyth_clear_and_free(output[i], output_len[i]);
+    output[i] = NULL;
+    output_len[i] = 0;
+  }
+
+  // Check that a failure on any input fails the whole request and returns
+  // no results
+  size_t bad_len = sealed_len[1];
+
+  sealed_len[1] = 5;
+  CU_ASSERT(tpm2_kmyth_unseal_multi
+            (sealed, sealed_len, 3, output, output_len, auth_bytes,
+             auth_bytes_len, owner_auth_bytes, oa_bytes_len) == 1);
+  CU_ASSERT(output[0] == NULL);
+  CU_ASSERT(output_len[0] == 0);
+  sealed_len[1] = bad_len;
+
+  // Check that an empty input list fails
+  CU_ASSERT(tpm2_kmyth_unseal_multi
+            (sealed, sealed_len, 0, output, output_len, auth_bytes,
+             auth_bytes_len, owner_auth_bytes, oa_bytes_len) == 1);
+
+  for (int i = 0; i < 3; i++)
+  {
+    free(sealed[i]);
+  }
+}
+
+//--------------------------------------------------------------------------------
+// concurrent_round_trips (worker for test_tpm2_kmyth_concurrent_seal_unseal)
+//--------------------------------------------------------------------------------
+#define CONCURRENT_THREADS 4
+#define CONCURRENT_ROUND_TRIPS 4
+
+typedef struct
+{
+  uint8_t id;
+  size_t failures;
+} concurrent_work_t;
+
+static void *concurrent_round_trips(void *arg)
+{
+  concurrent_work_t *work = (concurrent_work_t *) arg;
+  uint8_t input[4096];
+
+  // give each thread its own payload so mixed-up results are detected
+  memset(input, work->id, sizeof(input));
+  for (size_t i = 0; i < CONCURRENT_ROUND_TRIPS; i++)
+  {
+    uint8_t *sealed = NULL;
+    size_t sealed_len = 0;
+    uint8_t *output = NULL;
+    size_t output_len = 0;
+
+    input[0] = (uint8_t) i;
+    if (tpm2_kmyth_seal(input, sizeof(input), &sealed, &sealed_len,
+                        NULL, 0, NULL, 0, NULL, 0, NULL)
+        || tpm2_kmyth_unseal(sealed, sealed_len, &output, &output_len,
+                             NULL, 0, NULL, 0)
+        || output_len != sizeof(input)
+        || memcmp(output, input, sizeof(input)))
+    {
+      work->failures++;
+    }
+    free(sealed);
+    kmyth_clear_and_free(output, output_len);
+  }
+  return NULL;
+}
+
+//--------------------------------------------------------------------------------
+// test_tpm2_kmyth_concurrent_seal_unseal
+//--------------------------------------------------------------------------------
+void test_tpm2_kmyth_concurrent_seal_unseal(void)
+{
+  pthread_t threads[CONCURRENT_THREADS];
+  concurrent_work_t work[CONCURRENT_THREADS];
+  bool started[CONCURRENT_THREADS] = { false };
+
+  // Check that seal/unseal round trips from several threads at once all
+  // succeed (TPM access is serialized internally)
+  for (size_t t = 0; t < CONCURRENT_THREADS; t++)
+  {
+    work[t].id = (uint8_t) (t + 1);
+    work[t].failures = 0;
+    started[t] = (pthread_create(&threads[t], NULL, concurrent_round_trips,
+                                 &work[t]) == 0);
+    CU_ASSERT(started[t]);
+  }
+  for (size_t t = 0; t < CONCURRENT_THREADS; t++)
+  {
+    if (started[t])
+    {
+      pthread_join(threads[t], NULL);
+    }
+    CU_ASSERT(work[t].failures == 0);
+  }
+
+  // Check that the TPM is available again once all of the threads are done
+  TSS2_SYS_CONTEXT *sapi_ctx = NULL;
+
+  CU_ASSERT(init_tpm2_connection(&sapi_ctx) == 0);
+  free_tpm2_resources(&sapi_ctx);
+}
+
 //--------------------------------------------------------------------------------
 // test_tpm2_kmyth_seal_file
 //--------------------------------------------------------------------------------
@@ -236,6 +426,209 @@ void test_tpm2_kmyth_unseal_file(void)
   CU_ASSERT(output_len == 0);
 }
 
+//--------------------------------------------------------------------------------
+// test_tpm2_kmyth_create_kek
+//--------------------------------------------------------------------------------
+void test_tpm2_kmyth_create_kek(void)
+{
+  uint8_t *kek_ski = NULL;
+  size_t kek_ski_len = 0;
+
+  // Check that a KEK is created and sealed in .ski format
+  CU_ASSERT(tpm2_kmyth_create_kek(&kek_ski, &kek_ski_len, NULL, 0, NULL, 0,
+                                  NULL, 0) == 0);
+  CU_ASSERT(kek_ski != NULL);
+  CU_ASSERT(kek_ski_len > 0);
+
+  // Check that the sealed KEK unseals to a key of the expected length
+  uint8_t *kek = NULL;
+  size_t kek_len = 0;
+
+  CU_ASSERT(tpm2_kmyth_unseal(kek_ski, kek_ski_len, &kek, &kek_len, NULL, 0,
+                              NULL, 0) == 0);
+  CU_ASSERT(kek_len == KMYTH_ENVELOPE_KEK_LEN);
+
+  kmyth_clear_and_free(kek, kek_len);
+  free(kek_ski);
+}
+
+//--------------------------------------------------------------------------------
+// test_tpm2_kmyth_envelope_seal
+//--------------------------------------------------------------------------------
+void test_tpm2_kmyth_envelope_seal(void)
+{
+  uint8_t input0[8] = { 0, 1, 2, 3, 4, 5, 6, 7 };
+  uint8_t input1[4] = { 8, 9, 10, 11 };
+  uint8_t *inputs[2] = { input0, input1 };
+  size_t input_lens[2] = { 8, 4 };
+
+  uint8_t *kek_ski = NULL;
+  size_t kek_ski_len = 0;
+
+  tpm2_kmyth_create_kek(&kek_ski, &kek_ski_len, NULL, 0, NULL, 0, NULL, 0);
+
+  uint8_t *output[2] = { NULL };
+  size_t output_len[2] = { 0 };
+
+  // Check that each input is protected in its own envelope
+  CU_ASSERT(tpm2_kmyth_envelope_seal(kek_ski, kek_ski_len, inputs, input_lens,
+                                     2, output, output_len, NULL, 0, NULL, 0,
+                                     NULL) == 0);
+  CU_ASSERT(output[0] != NULL && output_len[0] > 0);
+  CU_ASSERT(output[1] != NULL && output_len[1] > 0);
+  free(output[0]);
+  free(output[1]);
+
+  // Check that an invalid cipher fails
+  CU_ASSERT(tpm2_kmyth_envelope_seal(kek_ski, kek_ski_len, inputs, input_lens,
+                                     2, output, output_len, NULL, 0, NULL, 0,
+                                     "fake cipher") == 1);
+
+  // Check that an invalid sealed KEK fails and returns no results
+  CU_ASSERT(tpm2_kmyth_envelope_seal(kek_ski, 5, inputs, input_lens,
+                                     2, output, output_len, NULL, 0, NULL, 0,
+                                     NULL) == 1);
+
+  // Check that an empty input list fails
+  CU_ASSERT(tpm2_kmyth_envelope_seal(kek_ski, kek_ski_len, inputs, input_lens,
+                                     0, output, output_len, NULL, 0, NULL, 0,
+                                     NULL) == 1);
+
+  free(kek_ski);
+}
+
+//--------------------------------------------------------------------------------
+// test_tpm2_kmyth_envelope_unseal
+//--------------------------------------------------------------------------------
+void test_tpm2_kmyth_envelope_unseal(void)
+{
+  uint8_t input0[8] = { 0, 1, 2, 3, 4, 5, 6, 7 };
+  uint8_t input1[4] = { 8, 9, 10, 11 };
+  uint8_t *inputs[2] = { input0, input1 };
+  size_t input_lens[2] = { 8, 4 };
+
+  uint8_t *kek_ski = NULL;
+  size_t kek_ski_len = 0;
+
+  tpm2_kmyth_create_kek(&kek_ski, &kek_ski_len, NULL, 0, NULL, 0, NULL, 0);
+
+  uint8_t *envelopes[2] = { NULL };
+  size_t envelope_lens[2] = { 0 };
+
+  tpm2_kmyth_envelope_seal(kek_ski, kek_ski_len, inputs, input_lens, 2,
+                           envelopes, envelope_lens, NULL, 0, NULL, 0, NULL);
+
+  uint8_t *output[2] = { NULL };
+  size_t output_len[2] = { 0 };
+
+  // Check that all envelopes are recovered with a single KEK unseal
+  CU_ASSERT(tpm2_kmyth_envelope_unseal(kek_ski, kek_ski_len, envelopes,
+                                       envelope_lens, 2, output, output_len,
+                                       NULL, 0, NULL, 0) == 0);
+  CU_ASSERT(output_len[0] == 8);
+  CU_ASSERT(memcmp(output[0], input0, 8) == 0);
+  CU_ASSERT(output_len[1] == 4);
+  CU_ASSERT(memcmp(output[1], input1, 4) == 0);
+  kmyth_clear_and_free(output[0], output_len[0]);
+  kmyth_clear_and_free(output[1], output_len[1]);
+  output[0] = NULL;
+  output[1] = NULL;
+
+  // Check that envelopes do not open under a different KEK
+  uint8_t *other_kek_ski = NULL;
+  size_t other_kek_ski_len = 0;
+
+  tpm2_kmyth_create_kek(&other_kek_ski, &other_kek_ski_len, NULL, 0, NULL, 0,
+                        NULL, 0);
+  CU_ASSERT(tpm2_kmyth_envelope_unseal(other_kek_ski, other_kek_ski_len,
+                                       envelopes, envelope_lens, 2, output,
+                                       output_len, NULL, 0, NULL, 0) == 1);
+  CU_ASSERT(output[0] == NULL);
+  CU_ASSERT(output[1] == NULL);
+
+  free(other_kek_ski);
+  free(envelopes[0]);
+  free(envelopes[1]);
+  free(kek_ski);
+}
+
+//--------------------------------------------------------------------------------
+// test_tpm2_kmyth_reseal
+//--------------------------------------------------------------------------------
+void test_tpm2_kmyth_reseal(void)
+{
+  uint8_t input0[8] = { 0, 1, 2, 3, 4, 5, 6, 7 };
+  uint8_t input1[4] = { 8, 9, 10, 11 };
+
+  uint8_t *sealed[2] = { NULL };
+  size_t sealed_len[2] = { 0 };
+
+  tpm2_kmyth_seal(input0, 8, &sealed[0], &sealed_len[0], NULL, 0, NULL, 0,
+                  NULL, 0, NULL);
+  tpm2_kmyth_seal(input1, 4, &sealed[1], &sealed_len[1], NULL, 0, NULL, 0,
+                  NULL, 0, NULL);
+
+  uint8_t *resealed[2] = { NULL };
+  size_t resealed_len[2] = { 0 };
+  int pcrs[1] = { 0 };
+
+  // Check that a batch re-seals under a new PCR selection
+  CU_ASSERT(tpm2_kmyth_reseal(sealed, sealed_len, 2, resealed, resealed_len,
+                              NULL, 0, NULL, 0, pcrs, 1) == 0);
+
+  // Check that the new PCR selection was applied, and that the encrypted
+  // data was copied through unchanged
+  Ski old_ski = get_default_ski();
+  Ski new_ski = get_default_ski();
+
+  CU_ASSERT(parse_ski_bytes(sealed[0], sealed_len[0], &old_ski) == 0);
+  CU_ASSERT(parse_ski_bytes(resealed[0], resealed_len[0], &new_ski) == 0);
+  CU_ASSERT(old_ski.pcr_list.pcrSelections[0].pcrSelect[0] == 0);
+  CU_ASSERT(new_ski.pcr_list.pcrSelections[0].pcrSelect[0] == 1);
+  CU_ASSERT(new_ski.enc_data_size == old_ski.enc_data_size);
+  CU_ASSERT(memcmp(new_ski.enc_data, old_ski.enc_data,
+                   old_ski.enc_data_size) == 0);
+  free_ski(&old_ski);
+  free_ski(&new_ski);
+
+  // Check that the re-sealed results unseal to the original data
+  uint8_t *output[2] = { NULL };
+  size_t output_len[2] = { 0 };
+
+  CU_ASSERT(tpm2_kmyth_unseal_multi(resealed, resealed_len, 2, output,
+                                    output_len, NULL, 0, NULL, 0) == 0);
+  CU_ASSERT(output_len[0] == 8);
+  CU_ASSERT(memcmp(output[0], input0, 8) == 0);
+  CU_ASSERT(output_len[1] == 4);
+  CU_ASSERT(memcmp(output[1], input1, 4) == 0);
+  kmyth_clear_and_free(output[0], output_len[0]);
+  kmyth_clear_and_free(output[1], output_len[1]);
+  free(resealed[0]);
+  free(resealed[1]);
+  resealed[0] = NULL;
+  resealed[1] = NULL;
+  resealed_len[0] = 0;
+  resealed_len[1] = 0;
+
+  // Check that a failure on any input fails the whole batch and returns
+  // no results
+  size_t good_len = sealed_len[1];
+
+  sealed_len[1] = 5;
+  CU_ASSERT(tpm2_kmyth_reseal(sealed, sealed_len, 2, resealed, resealed_len,
+                              NULL, 0, NULL, 0, pcrs, 1) == 1);
+  CU_ASSERT(resealed[0] == NULL);
+  CU_ASSERT(resealed_len[0] == 0);
+  sealed_len[1] = good_len;
+
+  // Check that an empty input list fails
+  CU_ASSERT(tpm2_kmyth_reseal(sealed, sealed_len, 0, resealed, resealed_len,
+                              NULL, 0, NULL, 0, pcrs, 1) == 1);
+
+  free(sealed[0]);
+  free(sealed[1]);
+}
+
 //--------------------------------------------------------------------------------
 // test_tpm2_kmyth_seal_data
 //--------------------------------------------------------------------------------
@@ -340,7 +733,7 @@ void test_tpm2_kmyth_unseal_data(void)
   CU_ASSERT(output_data_len == 8);
   CU_ASSERT(memcmp(output_data, input_data, 8) == 0);
 
-  free(output_data);
+  kmyth_clear_and_free(output_data, output_data_len);
   output_data = NULL;
   output_data_len = 0;
 
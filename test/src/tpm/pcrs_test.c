@@ -44,6 +44,7 @@ void test_init_pcr_selection(void)
   get_tpm2_impl_type(sapi_ctx, &emulator);
   if (!emulator)
   {
+    free_tpm2_resources(&sapi_ctx);
     return;
   }
 
@@ -76,6 +77,8 @@ void test_init_pcr_selection(void)
 
   //NULL TPM context
   CU_ASSERT(init_pcr_selection(NULL, pcrs, 2, &pcrs_struct) != 0);
+
+  free_tpm2_resources(&sapi_ctx);
 }
 
 //----------------------------------------------------------------------------
@@ -91,6 +94,7 @@ void test_get_pcr_count(void)
   get_tpm2_impl_type(sapi_ctx, &emulator);
   if (!emulator)
   {
+    free_tpm2_resources(&sapi_ctx);
     return;
   }
 
@@ -102,4 +106,6 @@ void test_get_pcr_count(void)
 
   //Test NULL context
   CU_ASSERT(get_pcr_count(NULL, &count) == 1);
+
+  free_tpm2_resources(&sapi_ctx);
 }
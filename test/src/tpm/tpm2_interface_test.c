@@ -25,6 +25,7 @@ int tpm2_interface_add_tests(CU_pSuite suite)
   bool emulator = true;
 
   get_tpm2_impl_type(sapi_ctx, &emulator);
+  free_tpm2_resources(&sapi_ctx);
   if (!emulator)
   {
     return (0);
@@ -145,6 +146,13 @@ int tpm2_interface_add_tests(CU_pSuite suite)
     return 1;
   }
 
+  if (NULL ==
+      CU_add_test(suite, "restart_policy_auth_session() Tests",
+                  test_restart_policy_auth_session))
+  {
+    return 1;
+  }
+
   if (NULL ==
       CU_add_test(suite, "create_caller_nonce() Tests",
                   test_create_caller_nonce))
@@ -694,6 +702,43 @@ void test_apply_policy(void)
   free_tpm2_resources(&sapi_ctx);
 }
 
+//----------------------------------------------------------------------------
+// test_restart_policy_auth_session
+//----------------------------------------------------------------------------
+void test_restart_policy_auth_session(void)
+{
+  SESSION session;
+  TSS2_SYS_CONTEXT *sapi_ctx = NULL;
+
+  init_tpm2_connection(&sapi_ctx);
+
+  //Valid test - restart after policy applied, then re-apply policy
+  create_policy_auth_session(sapi_ctx, &session);
+  TPML_PCR_SELECTION pcrs_struct = {.count = 0, };
+  apply_policy(sapi_ctx, session.sessionHandle, pcrs_struct);
+  CU_ASSERT(restart_policy_auth_session(sapi_ctx, &session) == 0);
+  CU_ASSERT(apply_policy(sapi_ctx, session.sessionHandle, pcrs_struct) == 0);
+
+  //Restart leaves the session nonce state intact
+  TPM2B_NONCE nonceNewer = session.nonceNewer;
+
+  CU_ASSERT(restart_policy_auth_session(sapi_ctx, &session) == 0);
+  CU_ASSERT(memcmp(nonceNewer.buffer, session.nonceNewer.buffer,
+                   KMYTH_DIGEST_SIZE) == 0);
+
+  //NULL session
+  CU_ASSERT(restart_policy_auth_session(sapi_ctx, NULL) != 0);
+
+  //NULL context
+  CU_ASSERT(restart_policy_auth_session(NULL, &session) != 0);
+
+  //Trial sessions are not restarted
+  session.sessionType = TPM2_SE_TRIAL;
+  CU_ASSERT(restart_policy_auth_session(sapi_ctx, &session) != 0);
+
+  free_tpm2_resources(&sapi_ctx);
+}
+
 //----------------------------------------------------------------------------
 // test_create_caller_nonce
 //----------------------------------------------------------------------------
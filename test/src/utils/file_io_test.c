@@ -7,6 +7,8 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <unistd.h>
 #include <CUnit/CUnit.h>
@@ -43,6 +45,18 @@ int file_io_add_tests(CU_pSuite suite)
     return 1;
   }
 
+  if (NULL == CU_add_test(suite, "write_bytes_to_file_atomic() Tests",
+                          test_write_bytes_to_file_atomic))
+  {
+    return 1;
+  }
+
+  if (NULL == CU_add_test(suite, "write_bytes_to_memfd() Tests",
+                          test_write_bytes_to_memfd))
+  {
+    return 1;
+  }
+
   if (NULL == CU_add_test(suite, "print_to_stdout() Tests",
                           test_print_to_stdout))
   {
@@ -198,6 +212,101 @@ void test_write_bytes_to_file(void)
   remove("testfile");
 }
 
+//----------------------------------------------------------------------------
+// test_write_bytes_to_file_atomic()
+//----------------------------------------------------------------------------
+void test_write_bytes_to_file_atomic(void)
+{
+  uint8_t *testdata1 = (uint8_t *) "Testing 123 ...";
+  size_t testdata1_len = strlen((char *) testdata1);
+  uint8_t *testdata2 = (uint8_t *) "And now for something different!\n";
+  size_t testdata2_len = strlen((char *) testdata2);
+  uint8_t *filedata = NULL;
+  size_t filedata_len = 0;
+  struct stat st = { 0 };
+
+  // Trying to write to NULL output path should result in error
+  CU_ASSERT(write_bytes_to_file_atomic(NULL, testdata1, testdata1_len) == 1);
+
+  // Writing a new file should produce expected file
+  CU_ASSERT(write_bytes_to_file_atomic("testfile", testdata1,
+                                       testdata1_len) == 0);
+  read_bytes_from_file("testfile", &filedata, &filedata_len);
+  CU_ASSERT(filedata_len == testdata1_len);
+  CU_ASSERT(strncmp((char *) testdata1, (char *) filedata, filedata_len) == 0);
+  free(filedata);
+  filedata = NULL;
+
+  // Replacing an existing file should keep its permissions
+  chmod("testfile", 0640);
+  CU_ASSERT(write_bytes_to_file_atomic("testfile", testdata2,
+                                       testdata2_len) == 0);
+  read_bytes_from_file("testfile", &filedata, &filedata_len);
+  CU_ASSERT(filedata_len == testdata2_len);
+  CU_ASSERT(strncmp((char *) testdata2, (char *) filedata, filedata_len) == 0);
+  CU_ASSERT(stat("testfile", &st) == 0);
+  CU_ASSERT((st.st_mode & 07777) == 0640);
+  free(filedata);
+
+  // Test cleanup
+  remove("testfile");
+}
+
+//----------------------------------------------------------------------------
+// test_write_bytes_to_memfd()
+//----------------------------------------------------------------------------
+void test_write_bytes_to_memfd(void)
+{
+  uint8_t *testdata = (uint8_t *) "Testing 123 ...";
+  size_t testdata_len = strlen((char *) testdata);
+  int memfd = -1;
+
+  // NULL data of non-zero length should error (and not return a memfd)
+  CU_ASSERT(write_bytes_to_memfd("test", NULL, 1, &memfd) == 1);
+  CU_ASSERT(memfd == -1);
+
+  // Writing test data should produce a sealed memfd holding exactly that data
+  CU_ASSERT(write_bytes_to_memfd("test", testdata, testdata_len, &memfd) == 0);
+  CU_ASSERT(memfd >= 0);
+  CU_ASSERT(fcntl(memfd, F_GET_SEALS) ==
+            (F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL));
+  CU_ASSERT(fcntl(memfd, F_GETFD) & FD_CLOEXEC);
+
+  struct stat st = { 0 };
+
+  CU_ASSERT(fstat(memfd, &st) == 0);
+  CU_ASSERT(st.st_size == (off_t) testdata_len);
+
+  // A consumer reading the descriptor (e.g., an exec'd child inheriting
+  // it) should see the data from the start
+  uint8_t readback[64] = { 0 };
+
+  CU_ASSERT(read(memfd, readback, sizeof(readback)) == (ssize_t) testdata_len);
+  CU_ASSERT(memcmp(readback, testdata, testdata_len) == 0);
+
+  uint8_t *mapped = mmap(NULL, testdata_len, PROT_READ, MAP_SHARED, memfd, 0);
+
+  CU_ASSERT(mapped != MAP_FAILED);
+  if (mapped != MAP_FAILED)
+  {
+    CU_ASSERT(memcmp(mapped, testdata, testdata_len) == 0);
+    munmap(mapped, testdata_len);
+  }
+
+  // The seals should refuse any modification of the contents
+  CU_ASSERT(pwrite(memfd, "x", 1, 0) == -1);
+  CU_ASSERT(ftruncate(memfd, 0) == -1);
+  CU_ASSERT(mmap(NULL, testdata_len, PROT_READ | PROT_WRITE, MAP_SHARED,
+                 memfd, 0) == MAP_FAILED);
+  close(memfd);
+
+  // Empty data should still produce a (sealed, empty) memfd
+  CU_ASSERT(write_bytes_to_memfd("test", NULL, 0, &memfd) == 0);
+  CU_ASSERT(fstat(memfd, &st) == 0);
+  CU_ASSERT(st.st_size == 0);
+  close(memfd);
+}
+
 //----------------------------------------------------------------------------
 // test_print_to_stdout()
 //----------------------------------------------------------------------------
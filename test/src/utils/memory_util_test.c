@@ -9,6 +9,8 @@
 #include <stdbool.h>
 #include <sys/stat.h>
 #include <limits.h>
+#include <stdint.h>
+#include <string.h>
 #include <CUnit/CUnit.h>
 
 #include "memory_util_test.h"
@@ -30,6 +32,12 @@ int memory_util_add_tests(CU_pSuite suite)
     return 1;
   }
 
+  if (NULL == CU_add_test(suite, "Kmyth Secure Arena Allocation Tests",
+                          test_kmyth_secure_alloc))
+  {
+    return 1;
+  }
+
 //  if (NULL == CU_add_test(suite, "Kmyth Secure Memory Set Tests",
 //                          test_secure_memset))
 //  {
@@ -103,6 +111,81 @@ void test_kmyth_clear_and_free(void)
   CU_ASSERT(true);              // if execution reaches here, test did not crash
 }
 
+//----------------------------------------------------------------------------
+// test_kmyth_secure_alloc()
+//----------------------------------------------------------------------------
+void test_kmyth_secure_alloc(void)
+{
+  // Exercise the smallest and largest size classes, and a dedicated mapping
+  size_t sizes[] = { 0, 1, 16, 100, 4096, 32 * 1024 - 16, 100 * 1024 };
+  size_t num_sizes = sizeof(sizes) / sizeof(sizes[0]);
+  uint8_t *blocks[sizeof(sizes) / sizeof(sizes[0])] = { 0 };
+
+  for (size_t i = 0; i < num_sizes; i++)
+  {
+    blocks[i] = kmyth_secure_alloc(sizes[i]);
+    CU_ASSERT(blocks[i] != NULL);
+    if (blocks[i] == NULL)
+    {
+      continue;
+    }
+
+    // memory should be zero-initialized and 16-byte aligned
+    bool zeroed = true;
+
+    for (size_t j = 0; j < sizes[i]; j++)
+    {
+      if (blocks[i][j] != 0)
+      {
+        zeroed = false;
+        break;
+      }
+    }
+    CU_ASSERT(zeroed);
+    CU_ASSERT(((uintptr_t) blocks[i] % 16) == 0);
+    memset(blocks[i], 0xa5, sizes[i]);
+  }
+
+  // blocks should not overlap (each still holds its own fill pattern)
+  for (size_t i = 0; i < num_sizes; i++)
+  {
+    if (blocks[i] != NULL && sizes[i] > 0)
+    {
+      CU_ASSERT(blocks[i][0] == 0xa5 && blocks[i][sizes[i] - 1] == 0xa5);
+    }
+    kmyth_clear_and_free(blocks[i], sizes[i]);
+  }
+
+  // a released block is reused, cleared, for the next request of its class
+  uint8_t *first = kmyth_secure_alloc(100);
+
+  CU_ASSERT(first != NULL);
+  memset(first, 0xff, 100);
+  kmyth_clear_and_free(first, 100);
+
+  uint8_t *second = kmyth_secure_alloc(90);
+
+  CU_ASSERT(second == first);
+  bool cleared = true;
+
+  for (size_t j = 0; j < 90; j++)
+  {
+    if (second[j] != 0)
+    {
+      cleared = false;
+      break;
+    }
+  }
+  CU_ASSERT(cleared);
+  kmyth_clear_and_free(second, 90);
+
+  // kmyth_clear_and_free() should still release ordinary heap memory
+  uint8_t *heap = malloc(32);
+
+  CU_ASSERT(heap != NULL);
+  kmyth_clear_and_free(heap, 32);
+}
+
 //----------------------------------------------------------------------------
 // test_secure_memset()
 //----------------------------------------------------------------------------
@@ -74,6 +74,25 @@ int read_bytes_from_file(char *input_path, uint8_t ** data,
 int write_bytes_to_file(char *output_path,
                         uint8_t * bytes, size_t bytes_length);
 
+/**
+ * @brief Verifies output_path is valid, then replaces the file atomically:
+ *        the bytes are written to a temporary file in the same directory,
+ *        flushed to disk (fsync()), and renamed over output_path. A crash
+ *        or failed write leaves any existing file at output_path intact.
+ *        An existing file's permissions are kept.
+ *
+ * @param[in]  output_path         String containing the path to the
+ *                                 output file
+ *
+ * @param[in]  bytes               Bytes to be written
+ *
+ * @param[in]  bytes_length        Number of bytes to be written
+ *
+ * @return 0 if success, 1 if error
+ */
+int write_bytes_to_file_atomic(char *output_path,
+                               uint8_t * bytes, size_t bytes_length);
+
 /**
  * @brief Prints raw bytes to standard out.
  * 
@@ -86,6 +105,35 @@ int write_bytes_to_file(char *output_path,
 int print_to_stdout(unsigned char *plain_text_data,
                     size_t plain_text_data_size);
 
+/**
+ * @brief Writes bytes into a new, anonymous memory file (memfd_create())
+ *        and seals it, so the data can be handed to a consumer without
+ *        touching the filesystem or a pipe.
+ *
+ * The memfd is sealed against writes and size changes (F_SEAL_WRITE,
+ * F_SEAL_GROW, F_SEAL_SHRINK, and F_SEAL_SEAL), so a consumer receiving it
+ * (inherited across exec or sent over a Unix domain socket) can mmap() the
+ * contents read-only and rely on them not changing. The descriptor is
+ * created close-on-exec; clear FD_CLOEXEC to pass it to an exec'd program.
+ *
+ * @param[in]  name          Name of the memfd (for debugging, e.g. as shown
+ *                           in /proc/self/fd) - not a filesystem path. At
+ *                           most 249 bytes, and readable by anyone who can
+ *                           list the holder's descriptors, so it should not
+ *                           carry user-supplied data (e.g., a file path)
+ *
+ * @param[in]  bytes         Bytes to be written
+ *
+ * @param[in]  bytes_length  Number of bytes to be written
+ *
+ * @param[out] memfd         The sealed memfd - passed as a pointer to the
+ *                           descriptor (the caller must close it)
+ *
+ * @return 0 if success, 1 if error
+ */
+int write_bytes_to_memfd(const char *name,
+                         uint8_t * bytes, size_t bytes_length, int *memfd);
+
 #ifdef __cplusplus
 }
 #endif
@@ -7,6 +7,7 @@
 #ifndef FORMATTING_TOOLS_H
 #define FORMATTING_TOOLS_H
 
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 
@@ -93,6 +94,58 @@ extern "C" {
  */
 #define KMYTH_DELIM_END_NKL "-----NKL END-----\n"
 
+/**
+ * @ingroup block_delim
+ *
+ * @brief   Indicates the start of one chunk of a chunked (streaming)
+ *          nickel file
+ */
+#define KMYTH_DELIM_NKL_CHUNK "-----NKL CHUNK-----\n"
+
+/**
+ * @ingroup block_delim
+ *
+ * @brief   Indicates the start of the per-file salt block of an envelope
+ *          (KEK-mode) file
+ */
+#define KMYTH_DELIM_ENVELOPE_SALT "-----ENVELOPE SALT-----\n"
+
+/**
+ * @ingroup block_delim
+ *
+ * @brief   Indicates the end of an envelope (KEK-mode) file
+ */
+#define KMYTH_DELIM_END_ENVELOPE "-----ENVELOPE END-----\n"
+
+/**
+ * @brief   Number of symbols on each line of a base-64 encoded block
+ *          (matches the OpenSSL base-64 BIO output used by encodeBase64Data())
+ */
+#define KMYTH_BASE64_LINE_LEN 64
+
+/**
+ * @brief Describes one block of a block-delimited (e.g., .ski or .nkl)
+ *        output for the single-allocation serializer (create_block_bytes()
+ *        and write_block_bytes_to_fd()).
+ */
+typedef struct
+{
+  /** delimiter string that starts the block */
+  char *delim;
+
+  /** block contents */
+  uint8_t *data;
+
+  /** size, in bytes, of data */
+  size_t data_len;
+
+  /**
+   * if true, data is written as-is followed by a newline,
+   * otherwise data is written base-64 encoded
+   */
+  bool raw;
+} block_spec_t;
+
 /**
  * @brief Retrieves the contents of the next "block" in the data read from a 
  *         block file, if the delimiter for the current file block matches the
@@ -134,6 +187,206 @@ int get_block_bytes(char **contents,
                     char *delim, size_t delim_len,
                     char *next_delim, size_t next_delim_len);
 
+/**
+ * @brief Maximum length of a block delimiter supported by the streaming
+ *        block tokenizer (block_stream_t)
+ */
+#define KMYTH_MAX_DELIM_LEN 64
+
+/**
+ * @brief A "view" of a block within a block file buffer - points into the
+ *        parsed buffer rather than holding a copy, so it is only valid
+ *        while that buffer is.
+ */
+typedef struct
+{
+  /** start of the block contents (within the parsed buffer) */
+  uint8_t *data;
+
+  /** size, in bytes, of the block contents */
+  size_t size;
+} block_view_t;
+
+/**
+ * @brief Finds the first occurrence of a delimiter in a data buffer.
+ *
+ * Candidate positions are located with memchr() on the delimiter's first
+ * character, so the search is a (vectorized) scan of the buffer rather than
+ * a comparison at every byte offset.
+ *
+ * @param[in]  data          Data buffer to be searched
+ *
+ * @param[in]  data_len      Size, in bytes, of data
+ *
+ * @param[in]  delim         Delimiter to be found
+ *
+ * @param[in]  delim_len     Length of delim
+ *
+ * @return pointer to the start of the delimiter within data, or NULL if
+ *         it was not found
+ */
+uint8_t *find_delim(uint8_t * data, size_t data_len,
+                    char *delim, size_t delim_len);
+
+/**
+ * @brief Retrieves a view of the contents of the next "block" in the data
+ *        read from a block file. Same as get_block_bytes(), except that no
+ *        copy of the block is made.
+ *
+ * @param[in/out] contents   Data buffer containing the (remaining) contents
+ *                           of a block file - passed as a pointer to the
+ *                           address of the data buffer (updated by this
+ *                           function to the start of the next block)
+ *
+ * @param[in/out] remaining  Count of bytes remaining in data buffer -
+ *                           passed as a pointer to the count value (updated
+ *                           by this function)
+ *
+ * @param[out] block         View of the retrieved block (points into
+ *                           *contents)
+ *
+ * @param[in]  delim         Expected delimiter (for the block type being
+ *                           retrieved)
+ *
+ * @param[in]  delim_len     Length of the expected delimiter
+ *
+ * @param[in]  next_delim    Next expected delimiter
+ *
+ * @param[in]  next_delim_len Length of the next expected delimiter
+ *
+ * @return 0 on success, 1 on failure
+ */
+int get_block_view(uint8_t ** contents, size_t * remaining,
+                   block_view_t * block,
+                   char *delim, size_t delim_len,
+                   char *next_delim, size_t next_delim_len);
+
+/**
+ * Function signature for the block_stream_t content callback. It is passed
+ * consecutive pieces of the contents of block 'block_index' (the block
+ * started by delims[block_index]) as they are parsed.
+ */
+typedef int (*block_stream_fn) (void *ctx, size_t block_index,
+                                uint8_t * data, size_t data_len);
+
+/**
+ * @brief State for incrementally tokenizing a block file as it is read
+ *        (e.g., from a file descriptor) rather than from a single buffer.
+ */
+typedef struct
+{
+  /** expected delimiters, in order - the last one ends the stream */
+  char **delims;
+
+  /** number of elements in delims */
+  size_t delim_count;
+
+  /** index of the delimiter currently being matched */
+  size_t index;
+
+  /** true once the opening delimiter has been matched */
+  bool in_block;
+
+  /** number of content bytes seen in the current block */
+  size_t block_len;
+
+  /** bytes that may be the start of a delimiter split across updates */
+  uint8_t carry[KMYTH_MAX_DELIM_LEN];
+
+  /** number of bytes in carry */
+  size_t carry_len;
+
+  /** content callback */
+  block_stream_fn fn;
+
+  /** context passed to fn */
+  void *ctx;
+} block_stream_t;
+
+/**
+ * @brief Initializes a streaming block tokenizer.
+ *
+ * @param[out] stream        Tokenizer state to be initialized
+ *
+ * @param[in]  delims        Expected delimiters, in order (e.g., the .ski
+ *                           block delimiters followed by
+ *                           KMYTH_DELIM_END_FILE)
+ *
+ * @param[in]  delim_count   Number of elements in delims (at least two)
+ *
+ * @param[in]  fn            Callback passed the contents of each block
+ *
+ * @param[in]  ctx           Context passed to fn
+ *
+ * @return 0 on success, 1 on error
+ */
+int block_stream_init(block_stream_t * stream, char **delims,
+                      size_t delim_count, block_stream_fn fn, void *ctx);
+
+/**
+ * @brief Tokenizes the next piece of a block file. Delimiters may be split
+ *        across calls. Block contents are passed to the callback without
+ *        being buffered.
+ *
+ * @param[in/out] stream     Tokenizer state
+ *
+ * @param[in]  data          Next piece of the block file
+ *
+ * @param[in]  data_len      Size, in bytes, of data
+ *
+ * @return 0 on success, 1 on error (unexpected delimiter, empty block,
+ *         data after the end delimiter, or a callback error)
+ */
+int block_stream_update(block_stream_t * stream, uint8_t * data,
+                        size_t data_len);
+
+/**
+ * @brief Checks that a streamed block file was complete (i.e., that the
+ *        final delimiter has been seen).
+ *
+ * @param[in]  stream        Tokenizer state
+ *
+ * @return 0 on success, 1 on error
+ */
+int block_stream_final(block_stream_t * stream);
+
+/**
+ * @brief Parses a user-specified PCR selection string (e.g., "0, 1, 2") into
+ *        an array of PCR indices.
+ *
+ * @param[in]  pcrs_string    PCR selection string - PCR indices separated by
+ *                            blanks and/or commas. If NULL, no PCRs are
+ *                            selected (pcrs_len is set to zero).
+ *
+ * @param[out] pcrs           Array of parsed PCR indices - passed as a
+ *                            pointer to the address of the array
+ *                            (allocated here, must be freed by the caller)
+ *
+ * @param[out] pcrs_len       Number of PCR indices in pcrs - passed as a
+ *                            pointer to the length value
+ *
+ * @return 0 on success, 1 on error
+ */
+int parse_pcrs_string(char *pcrs_string, int **pcrs, int *pcrs_len);
+
+/**
+ * @brief Parses a user-specified decimal value (e.g., a command-line option
+ *        argument) into an unsigned integer, rejecting empty strings,
+ *        signs, trailing characters, and values outside [min, max].
+ *
+ * @param[in]  str            Decimal string to parse
+ *
+ * @param[in]  min            Smallest accepted value
+ *
+ * @param[in]  max            Largest accepted value
+ *
+ * @param[out] value          Parsed value - only written on success
+ *
+ * @return 0 on success, 1 on error
+ */
+int parse_unsigned_string(const char *str, unsigned long min,
+                          unsigned long max, unsigned long *value);
+
 /**
  * @brief Creates a byte array in .nkl format from a input string
  *
@@ -197,6 +450,98 @@ int decodeBase64Data(unsigned char *base64_data,
                      size_t base64_data_size, unsigned char **raw_data,
                      size_t * raw_data_size);
 
+/**
+ * @brief Computes the exact size of the base-64 encoding of a data buffer,
+ *        as produced by encodeBase64Data() (64 symbol lines, each terminated
+ *        by a newline, and no null terminator).
+ *
+ * @param[in]  raw_data_size    Size, in bytes, of the "raw" data to be encoded
+ *
+ * @return size, in bytes, of the encoded result (0 if raw_data_size is
+ *         zero or the result would overflow a size_t)
+ */
+size_t getBase64EncodedSize(size_t raw_data_size);
+
+/**
+ * @brief Base-64 encodes a data buffer directly into a caller supplied
+ *        buffer, using the same format as encodeBase64Data(), without any
+ *        intermediate allocation.
+ *
+ * @param[in]  raw_data         The "raw" input data (hex bytes)
+ *
+ * @param[in]  raw_data_size    Size, in bytes, of raw_data
+ *
+ * @param[out] base64_data      Destination buffer - must hold at least
+ *                              getBase64EncodedSize(raw_data_size) bytes
+ *
+ * @param[in]  base64_data_size Size, in bytes, of the destination buffer
+ *
+ * @return 0 if success, 1 if error
+ */
+int encodeBase64DataToBuffer(uint8_t * raw_data, size_t raw_data_size,
+                             uint8_t * base64_data, size_t base64_data_size);
+
+/**
+ * @brief Computes the exact size of the block-delimited output that
+ *        create_block_bytes() produces for a list of blocks.
+ *
+ * @param[in]  blocks           Array of blocks, in output order
+ *
+ * @param[in]  block_count      Number of elements in blocks
+ *
+ * @param[in]  end_delim        Delimiter string that terminates the output
+ *
+ * @param[out] output_length    Size, in bytes, of the output
+ *
+ * @return 0 if success, 1 if error
+ */
+int get_block_bytes_size(block_spec_t * blocks, size_t block_count,
+                         char *end_delim, size_t * output_length);
+
+/**
+ * @brief Serializes a list of blocks into block-delimited format (each block
+ *        is its delimiter followed by its base-64 encoded, or raw, data, and
+ *        the output ends with end_delim).
+ *
+ * The output size is computed first, so the result is allocated exactly
+ * once and each block is encoded directly into its final position.
+ *
+ * @param[in]  blocks           Array of blocks, in output order
+ *
+ * @param[in]  block_count      Number of elements in blocks
+ *
+ * @param[in]  end_delim        Delimiter string that terminates the output
+ *
+ * @param[out] output           The block-delimited bytes - passed as a
+ *                              pointer to the address of the output buffer
+ *                              (allocated here, must be freed by the caller)
+ *
+ * @param[out] output_length    The number of bytes in output
+ *
+ * @return 0 if success, 1 if error
+ */
+int create_block_bytes(block_spec_t * blocks, size_t block_count,
+                       char *end_delim, uint8_t ** output,
+                       size_t * output_length);
+
+/**
+ * @brief Writes the same output as create_block_bytes() straight to a file
+ *        descriptor, encoding through a small fixed-size buffer so that no
+ *        copy of the output is held in memory.
+ *
+ * @param[in]  fd               File descriptor open for writing
+ *
+ * @param[in]  blocks           Array of blocks, in output order
+ *
+ * @param[in]  block_count      Number of elements in blocks
+ *
+ * @param[in]  end_delim        Delimiter string that terminates the output
+ *
+ * @return 0 if success, 1 if error
+ */
+int write_block_bytes_to_fd(int fd, block_spec_t * blocks,
+                            size_t block_count, char *end_delim);
+
 /**
  * @brief Concatinates two arrays of type uint8_t
  *
@@ -33,6 +33,9 @@ void kmyth_clear(void *v, size_t size);
  *         If the size is incorrectly specified, behavior can be unpredictable. If a NULL pointer 
  *         is handled, the function simply returns.
  *
+ *         Memory obtained from kmyth_secure_alloc() is recognized and returned (cleared in
+ *         full, whatever the size given) to the secure arena instead of being passed to free().
+ *
  * @param[in,out] v    The pointer to be cleared from memory then freed
  *
  * @param[in]     size The size of the pointer to be cleared then freed
@@ -54,6 +57,27 @@ void kmyth_clear_and_free(void *v, size_t size);
  */
 void *secure_memset(void *v, int c, size_t n);
 
+/**
+ * @brief Allocates zero-initialized memory for key material from the secure arena.
+ *
+ *        The arena is made of anonymous mappings that are locked into RAM (mlock) and
+ *        excluded from core dumps (MADV_DONTDUMP) once, when they are mapped, so individual
+ *        secrets cost no system calls. Small requests are served from per-size-class free
+ *        lists; large ones get a dedicated locked mapping. If the memory cannot be locked
+ *        (e.g., RLIMIT_MEMLOCK is too small) a warning is logged once and the (unlocked,
+ *        but still non-dumpable) memory is used anyway.
+ *
+ *        Memory from this function must be released with kmyth_clear_and_free(), never
+ *        with free(). The arena is safe for use by multiple threads. (In SGX enclave builds,
+ *        where enclave memory is already protected, this is plain enclave heap memory.)
+ *
+ * @param[in]     size The number of bytes needed
+ *
+ * @return pointer to the memory, or NULL on error (as for malloc(), a zero size still
+ *         yields a unique pointer)
+ */
+void *kmyth_secure_alloc(size_t size);
+
 #ifdef __cplusplus
 }
 #endif
@@ -7,11 +7,15 @@
 
 #include "file_io.h"
 
+#include <errno.h>
+#include <fcntl.h>
 #include <libgen.h>
 #include <stdio.h>
+#include <string.h>
 #include <unistd.h>
 
 #include <openssl/bio.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 
 #include "defines.h"
@@ -248,6 +252,168 @@ int write_bytes_to_file(char *output_path, uint8_t * bytes, size_t bytes_length)
   return 0;
 }
 
+//############################################################################
+// write_bytes_to_file_atomic
+//############################################################################
+int write_bytes_to_file_atomic(char *output_path,
+                               uint8_t * bytes, size_t bytes_length)
+{
+  if (verifyOutputFilePath(output_path))
+  {
+    kmyth_log(LOG_ERR, "invalid output path (%s) ... exiting", output_path);
+    return 1;
+  }
+
+  // the temporary file must be in the same directory (file system) as the
+  // output for rename() to replace it atomically
+  char *tmp_path = NULL;
+
+  if (asprintf(&tmp_path, "%s.XXXXXX", output_path) < 0)
+  {
+    kmyth_log(LOG_ERR, "unable to create temporary file path ... exiting");
+    return 1;
+  }
+
+  int fd = mkstemp(tmp_path);
+
+  if (fd == -1)
+  {
+    kmyth_log(LOG_ERR, "unable to create temporary file for %s ... exiting",
+              output_path);
+    free(tmp_path);
+    return 1;
+  }
+
+  // keep the permissions of the file being replaced (mkstemp() uses 0600)
+  struct stat st = { 0 };
+
+  if (stat(output_path, &st) == 0)
+  {
+    fchmod(fd, st.st_mode & 07777);
+  }
+
+  size_t written = 0;
+
+  while (written < bytes_length)
+  {
+    ssize_t n = write(fd, bytes + written, bytes_length - written);
+
+    if (n < 0 && errno == EINTR)
+    {
+      continue;
+    }
+    if (n <= 0)
+    {
+      break;
+    }
+    written += n;
+  }
+
+  if (written != bytes_length || fsync(fd) != 0)
+  {
+    kmyth_log(LOG_ERR, "error writing temporary file %s ... exiting",
+              tmp_path);
+    close(fd);
+    unlink(tmp_path);
+    free(tmp_path);
+    return 1;
+  }
+
+  if (close(fd) != 0 || rename(tmp_path, output_path) != 0)
+  {
+    kmyth_log(LOG_ERR, "unable to replace %s ... exiting", output_path);
+    unlink(tmp_path);
+    free(tmp_path);
+    return 1;
+  }
+  free(tmp_path);
+
+  // flush the directory entry too, so the rename itself survives a crash
+  char *dir_copy = NULL;
+
+  if (asprintf(&dir_copy, "%s", output_path) >= 0)
+  {
+    int dir_fd = open(dirname(dir_copy), O_RDONLY | O_DIRECTORY);
+
+    if (dir_fd != -1)
+    {
+      fsync(dir_fd);
+      close(dir_fd);
+    }
+    free(dir_copy);
+  }
+
+  return 0;
+}
+
+//############################################################################
+// write_bytes_to_memfd()
+//############################################################################
+int write_bytes_to_memfd(const char *name,
+                         uint8_t * bytes, size_t bytes_length, int *memfd)
+{
+  *memfd = -1;
+  if (bytes == NULL && bytes_length > 0)
+  {
+    kmyth_log(LOG_ERR, "no data to write to memfd ... exiting");
+    return 1;
+  }
+
+  int fd = memfd_create(name, MFD_CLOEXEC | MFD_ALLOW_SEALING);
+
+  if (fd < 0)
+  {
+    kmyth_log(LOG_ERR, "unable to create memfd: %s ... exiting",
+              strerror(errno));
+    return 1;
+  }
+
+  // write() rather than a shared mapping, because F_SEAL_WRITE cannot be
+  // applied while any writable shared mapping of the memfd exists
+  size_t written = 0;
+
+  while (written < bytes_length)
+  {
+    ssize_t rc = write(fd, bytes + written, bytes_length - written);
+
+    if (rc < 0 && errno == EINTR)
+    {
+      continue;
+    }
+    if (rc <= 0)
+    {
+      kmyth_log(LOG_ERR, "error writing memfd ... exiting");
+      close(fd);
+      return 1;
+    }
+    written += (size_t) rc;
+  }
+
+  if (fcntl(fd, F_ADD_SEALS,
+            F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL))
+  {
+    kmyth_log(LOG_ERR, "unable to seal memfd: %s ... exiting",
+              strerror(errno));
+    close(fd);
+    return 1;
+  }
+
+  // the descriptor (and its offset) is shared with the consumer, which
+  // should read the data from the start
+  if (lseek(fd, 0, SEEK_SET) != 0)
+  {
+    kmyth_log(LOG_ERR, "unable to rewind memfd: %s ... exiting",
+              strerror(errno));
+    close(fd);
+    return 1;
+  }
+  kmyth_log(LOG_DEBUG, "wrote %zu bytes to sealed memfd (fd = %d)",
+            bytes_length, fd);
+
+  *memfd = fd;
+  return 0;
+}
+
 //############################################################################
 // print_to_stdout()
 //############################################################################
@@ -6,7 +6,11 @@
 
 #include "formatting_tools.h"
 
+#include <ctype.h>
+#include <errno.h>
+#include <limits.h>
 #include <string.h>
+#include <unistd.h>
 
 #include <openssl/bio.h>
 #include <openssl/buffer.h>
@@ -14,6 +18,90 @@
 
 #include "defines.h"
 
+/**
+ * @brief Number of base-64 lines encoded per write() by
+ *        write_block_bytes_to_fd() (1024 lines = 48 KiB of input)
+ */
+#define KMYTH_BASE64_FD_CHUNK_LINES 1024
+
+//############################################################################
+// find_delim()
+//############################################################################
+uint8_t *find_delim(uint8_t * data, size_t data_len,
+                    char *delim, size_t delim_len)
+{
+  if (data == NULL || delim == NULL || delim_len == 0 || delim_len > data_len)
+  {
+    return NULL;
+  }
+
+  // only positions holding the delimiter's first character are compared
+  uint8_t *last = data + (data_len - delim_len);
+  uint8_t *candidate = data;
+
+  while (candidate <= last)
+  {
+    candidate = memchr(candidate, delim[0], (size_t) (last - candidate) + 1);
+    if (candidate == NULL)
+    {
+      return NULL;
+    }
+    if (memcmp(candidate, delim, delim_len) == 0)
+    {
+      return candidate;
+    }
+    candidate++;
+  }
+
+  return NULL;
+}
+
+//############################################################################
+// get_block_view()
+//############################################################################
+int get_block_view(uint8_t ** contents,
+                   size_t * remaining,
+                   block_view_t * block,
+                   char *delim, size_t delim_len,
+                   char *next_delim, size_t next_delim_len)
+{
+  // check that next (current) block begins with expected delimiter
+  if (*remaining < delim_len || memcmp(*contents, delim, delim_len))
+  {
+    kmyth_log(LOG_ERR, "unexpected delimiter ... exiting");
+    return 1;
+  }
+
+  // find the end of the block
+  uint8_t *start = *contents + delim_len;
+  size_t available = *remaining - delim_len;
+  uint8_t *end = find_delim(start, available, next_delim, next_delim_len);
+
+  if (end == NULL)
+  {
+    kmyth_log(LOG_ERR, "unexpectedly reached end of file ... exiting");
+    return 1;
+  }
+
+  // check that the block is not empty
+  if (end == start)
+  {
+    kmyth_log(LOG_ERR, "empty block ... exiting");
+    return 1;
+  }
+
+  // update output parameters before exiting
+  //   - block      : view of the block just parsed
+  //   - *contents  : pointer to start of next block in file buffer
+  //   - *remaining : count of bytes yet to be parsed in file buffer
+  block->data = start;
+  block->size = (size_t) (end - start);
+  *contents = end;
+  *remaining -= delim_len + block->size;
+
+  return 0;
+}
+
 //############################################################################
 // get_block_bytes()
 //############################################################################
@@ -23,63 +111,333 @@ int get_block_bytes(char **contents,
                     char *delim, size_t delim_len,
                     char *next_delim, size_t next_delim_len)
 {
-  // check that next (current) block begins with expected delimiter
-  if (strncmp(*contents, delim, delim_len))
+  block_view_t view = {.data = NULL,.size = 0 };
+  uint8_t *position = (uint8_t *) * contents;
+  size_t left = *remaining;
+
+  if (get_block_view(&position, &left, &view, delim, delim_len,
+                     next_delim, next_delim_len))
   {
-    kmyth_log(LOG_ERR, "unexpected delimiter ... exiting");
     return 1;
   }
-  *contents += delim_len;
-  (*remaining) -= delim_len;
 
-  // find the end of the block 
-  size_t size = 0;
+  // allocate enough memory for output parameter to hold parsed block data
+  //   - must be allocated here because size is calculated here
+  //   - must be freed by caller because data must be passed back
+  *block = (uint8_t *) malloc(view.size);
+  if (*block == NULL)
+  {
+    kmyth_log(LOG_ERR, "malloc (%lu bytes) error ... exiting", view.size);
+    return 1;
+  }
+  memcpy(*block, view.data, view.size);
+  *blocksize = view.size;
+  *contents = (char *) position;
+  *remaining = left;
 
-  if (next_delim_len > *remaining)
+  return 0;
+}
+
+//############################################################################
+// block_stream_init()
+//############################################################################
+int block_stream_init(block_stream_t * stream, char **delims,
+                      size_t delim_count, block_stream_fn fn, void *ctx)
+{
+  if (stream == NULL || delims == NULL || delim_count < 2 || fn == NULL)
   {
-    kmyth_log(LOG_ERR, "unexpectedly reached end of file ... exiting");
+    kmyth_log(LOG_ERR, "invalid block stream parameters ... exiting");
     return 1;
   }
-  while (strncmp(*contents + size, next_delim, next_delim_len))
+  for (size_t i = 0; i < delim_count; i++)
   {
-    size++;
-    if (size + next_delim_len > *remaining)
+    if (delims[i] == NULL || strlen(delims[i]) == 0
+        || strlen(delims[i]) > KMYTH_MAX_DELIM_LEN)
     {
-      kmyth_log(LOG_ERR, "unexpectedly reached end of file ... exiting");
+      kmyth_log(LOG_ERR, "invalid block stream delimiter ... exiting");
       return 1;
     }
   }
 
-  // check that the block is not empty
-  if (size == 0)
+  stream->delims = delims;
+  stream->delim_count = delim_count;
+  stream->index = 0;
+  stream->in_block = false;
+  stream->block_len = 0;
+  stream->carry_len = 0;
+  stream->fn = fn;
+  stream->ctx = ctx;
+
+  return 0;
+}
+
+//############################################################################
+// block_stream_emit()
+//############################################################################
+static int block_stream_emit(block_stream_t * stream, uint8_t * data,
+                             size_t data_len)
+{
+  if (data_len == 0)
   {
-    kmyth_log(LOG_ERR, "empty block ... exiting");
+    return 0;
+  }
+  stream->block_len += data_len;
+  return stream->fn(stream->ctx, stream->index - 1, data, data_len);
+}
+
+//############################################################################
+// block_stream_update()
+//############################################################################
+int block_stream_update(block_stream_t * stream, uint8_t * data,
+                        size_t data_len)
+{
+  while (data_len > 0)
+  {
+    if (stream->index == stream->delim_count)
+    {
+      kmyth_log(LOG_ERR, "data after end delimiter ... exiting");
+      return 1;
+    }
+
+    char *delim = stream->delims[stream->index];
+    size_t delim_len = strlen(delim);
+
+    // outside of a delimiter match, pass contents straight through up to
+    // the next possible delimiter start
+    if (stream->in_block && stream->carry_len == 0)
+    {
+      uint8_t *next = memchr(data, delim[0], data_len);
+      size_t content_len = (next == NULL) ? data_len : (size_t) (next - data);
+
+      if (block_stream_emit(stream, data, content_len))
+      {
+        return 1;
+      }
+      data += content_len;
+      data_len -= content_len;
+      if (data_len == 0)
+      {
+        return 0;
+      }
+    }
+
+    // extend the (possible) delimiter match with as many bytes as needed
+    size_t take = delim_len - stream->carry_len;
+
+    take = (take < data_len) ? take : data_len;
+    memcpy(stream->carry + stream->carry_len, data, take);
+
+    if (memcmp(stream->carry, delim, stream->carry_len + take) == 0)
+    {
+      data += take;
+      data_len -= take;
+      stream->carry_len += take;
+      if (stream->carry_len < delim_len)
+      {
+        // partial match at the end of this piece of the stream
+        continue;
+      }
+
+      // delimiter matched - it ends the current block and starts the next
+      if (stream->in_block && stream->block_len == 0)
+      {
+        kmyth_log(LOG_ERR, "empty block ... exiting");
+        return 1;
+      }
+      stream->index++;
+      stream->in_block = true;
+      stream->block_len = 0;
+      stream->carry_len = 0;
+      continue;
+    }
+
+    if (!stream->in_block)
+    {
+      kmyth_log(LOG_ERR, "unexpected delimiter ... exiting");
+      return 1;
+    }
+
+    // not a delimiter - the first byte examined is block content, and any
+    // held bytes after it are re-examined from the next possible delimiter
+    // start
+    if (stream->carry_len == 0)
+    {
+      if (block_stream_emit(stream, data, 1))
+      {
+        return 1;
+      }
+      data++;
+      data_len--;
+      continue;
+    }
+
+    uint8_t *next = memchr(stream->carry + 1, delim[0],
+                           stream->carry_len - 1);
+    size_t content_len = (next == NULL) ? stream->carry_len :
+      (size_t) (next - stream->carry);
+
+    if (block_stream_emit(stream, stream->carry, content_len))
+    {
+      return 1;
+    }
+    memmove(stream->carry, stream->carry + content_len,
+            stream->carry_len - content_len);
+    stream->carry_len -= content_len;
+  }
+
+  return 0;
+}
+
+//############################################################################
+// block_stream_final()
+//############################################################################
+int block_stream_final(block_stream_t * stream)
+{
+  if (stream->index != stream->delim_count)
+  {
+    kmyth_log(LOG_ERR, "unexpectedly reached end of stream ... exiting");
+    return 1;
+  }
+  return 0;
+}
+
+//############################################################################
+// parse_pcrs_string()
+//############################################################################
+int parse_pcrs_string(char *pcrs_string, int **pcrs, int *pcrs_len)
+{
+  *pcrs_len = 0;
+
+  if (pcrs_string == NULL)
+  {
+    return 0;
+  }
+
+  kmyth_log(LOG_DEBUG, "parsing PCR selection string");
+
+  *pcrs = NULL;
+  *pcrs = malloc(24 * sizeof(int));
+  size_t pcrs_array_size = 24;
+
+  if (*pcrs == NULL)
+  {
+    kmyth_log(LOG_ERR,
+              "failed to allocate memory to parse PCR string ... exiting");
     return 1;
   }
 
-  else
+  char *pcrs_string_cur = pcrs_string;
+  char *pcrs_string_next = NULL;
+
+  long pcrIndex;
+
+  while (*pcrs_string_cur != '\0')
   {
-    // allocate enough memory for output parameter to hold parsed block data
-    //   - must be allocated here because size is calculated here
-    //   - must be freed by caller because data must be passed back
-    *block = (uint8_t *) malloc(size);
-    if (*block == NULL)
+    pcrIndex = strtol(pcrs_string_cur, &pcrs_string_next, 10);
+
+    // Check for overflow or underflow on the strtol call. There
+    // really shouldn't be, because the number of PCRs is small.
+    if ((pcrIndex == LONG_MIN) || (pcrIndex == LONG_MAX))
+    {
+      kmyth_log(LOG_ERR, "invalid PCR value specified ... exiting");
+      free(*pcrs);
+      *pcrs_len = 0;
+      return 1;
+    }
+
+    // Check that strtol didn't fail to parse an integer, which is the only
+    // condition that would cause the pointers to match.
+    if (pcrs_string_cur == pcrs_string_next)
     {
-      kmyth_log(LOG_ERR, "malloc (%d bytes) error ... exiting", size);
+      kmyth_log(LOG_ERR, "error parsing PCR string ... exiting");
+      free(*pcrs);
+      *pcrs_len = 0;
       return 1;
     }
 
-    // update output parameters before exiting
-    //   - *block      : block data (for block just parsed)
-    //   - *blocksize  : block data size (for block just parsed)
-    //   - *contents   : pointer to start of next block in .ski file buffer
-    //   - *remaining  : count of bytes yet to be parsed in .ski file buffer
-    memcpy(*block, *contents, size);
-    *blocksize = size;
-    *contents += size;
-    *remaining -= size;
+    // Look at the first invalid character from the last call to strtol
+    // and confirm it's a blank, a comma, or '\0'. If not there's a disallowed
+    // character in the PCR string.
+    if (!isblank(*pcrs_string_next) && (*pcrs_string_next != ',')
+        && (*pcrs_string_next != '\0'))
+    {
+      kmyth_log(LOG_ERR, "invalid character (%c) in PCR string ... exiting",
+                *pcrs_string_next);
+      free(*pcrs);
+      *pcrs_len = 0;
+      return 1;
+    }
+
+    // Step past the invalid characters, checking not to skip past the
+    // end of the string.
+    while ((*pcrs_string_next != '\0')
+           && (isblank(*pcrs_string_next) || (*pcrs_string_next == ',')))
+    {
+      pcrs_string_next++;
+    }
+
+    if (*pcrs_len == pcrs_array_size)
+    {
+      int *new_pcrs = NULL;
+
+      new_pcrs = realloc(*pcrs, pcrs_array_size * 2 * sizeof(int));
+      if (new_pcrs == NULL)
+      {
+        kmyth_log(LOG_ERR, "Ran out of memory ... exiting");
+        free(*pcrs);
+        *pcrs_len = 0;
+        return 1;
+      }
+      *pcrs = new_pcrs;
+      pcrs_array_size *= 2;
+    }
+    (*pcrs)[*pcrs_len] = (int) pcrIndex;
+    (*pcrs_len)++;
+    pcrs_string_cur = pcrs_string_next;
+    pcrs_string_next = NULL;
+  }
+
+  return 0;
+}
+
+//############################################################################
+// parse_unsigned_string()
+//############################################################################
+int parse_unsigned_string(const char *str, unsigned long min,
+                          unsigned long max, unsigned long *value)
+{
+  if (str == NULL || value == NULL)
+  {
+    return 1;
+  }
+
+  // strtoul() skips leading whitespace and silently negates a leading '-',
+  // so only accept strings that start with a digit.
+  if (!isdigit((unsigned char) str[0]))
+  {
+    kmyth_log(LOG_ERR, "invalid numeric value (%s) ... exiting", str);
+    return 1;
   }
 
+  char *end = NULL;
+
+  errno = 0;
+  unsigned long parsed = strtoul(str, &end, 10);
+
+  if (errno != 0 || *end != '\0')
+  {
+    kmyth_log(LOG_ERR, "invalid numeric value (%s) ... exiting", str);
+    return 1;
+  }
+
+  if (parsed < min || parsed > max)
+  {
+    kmyth_log(LOG_ERR, "value %lu outside allowed range [%lu, %lu] ... exiting",
+              parsed, min, max);
+    return 1;
+  }
+
+  *value = parsed;
   return 0;
 }
 
@@ -96,34 +454,17 @@ int create_nkl_bytes(uint8_t * input, size_t input_length,
     return 1;
   }
 
-  //Encode each portion of the file in base64
-  uint8_t *nkl_data = NULL;
-  size_t nkl_data_size = 0;
+  block_spec_t blocks[] = {
+    {KMYTH_DELIM_NKL_DATA, input, input_length, false},
+  };
 
-  if (encodeBase64Data(input, input_length, &nkl_data, &nkl_data_size))
+  if (create_block_bytes(blocks, 1, KMYTH_DELIM_END_NKL, output,
+                         output_length))
   {
-    kmyth_log(LOG_ERR, "error base64 encoding nkl string ... exiting");
-    free(nkl_data);
+    kmyth_log(LOG_ERR, "error creating nkl string ... exiting");
     return 1;
   }
 
-  //At this point the data is all formatted, it's time to create the string
-
-  uint8_t *out = NULL;
-  size_t out_length = 0;
-
-  concat(&out, &out_length, (uint8_t *) KMYTH_DELIM_NKL_DATA,
-         strlen(KMYTH_DELIM_NKL_DATA));
-  concat(&out, &out_length, nkl_data, nkl_data_size);
-  free(nkl_data);
-  nkl_data = NULL;
-
-  concat(&out, &out_length, (uint8_t *) KMYTH_DELIM_END_NKL,
-         strlen(KMYTH_DELIM_END_NKL));
-
-  *output = out;
-  *output_length = out_length;
-
   return 0;
 }
 
@@ -284,6 +625,264 @@ int decodeBase64Data(uint8_t * base64_data,
   return 0;
 }
 
+//############################################################################
+// getBase64EncodedSize()
+//############################################################################
+size_t getBase64EncodedSize(size_t raw_data_size)
+{
+  if (raw_data_size == 0 || raw_data_size > SIZE_MAX / 2)
+  {
+    return 0;
+  }
+
+  // four symbols per (started) three input bytes, plus a newline ending
+  // each (started) line of KMYTH_BASE64_LINE_LEN symbols
+  size_t symbols = ((raw_data_size + 2) / 3) * 4;
+
+  return symbols + (symbols + KMYTH_BASE64_LINE_LEN - 1) /
+    KMYTH_BASE64_LINE_LEN;
+}
+
+//############################################################################
+// encodeBase64DataToBuffer()
+//############################################################################
+int encodeBase64DataToBuffer(uint8_t * raw_data, size_t raw_data_size,
+                             uint8_t * base64_data, size_t base64_data_size)
+{
+  size_t encoded_size = getBase64EncodedSize(raw_data_size);
+
+  if (raw_data == NULL || base64_data == NULL || encoded_size == 0)
+  {
+    kmyth_log(LOG_ERR, "no input data ... exiting");
+    return 1;
+  }
+  if (base64_data_size < encoded_size)
+  {
+    kmyth_log(LOG_ERR, "output buffer (%lu bytes) too small for %lu bytes "
+              "of base-64 data ... exiting", base64_data_size, encoded_size);
+    return 1;
+  }
+
+  // EVP_EncodeBlock() does not insert line breaks (and null terminates its
+  // output), so encode one line at a time - the terminator it writes lands
+  // on the newline position and is then overwritten
+  size_t raw_line_len = (KMYTH_BASE64_LINE_LEN / 4) * 3;
+  uint8_t *dest = base64_data;
+
+  while (raw_data_size > 0)
+  {
+    size_t in_len = (raw_data_size < raw_line_len) ? raw_data_size :
+      raw_line_len;
+    int out_len = EVP_EncodeBlock(dest, raw_data, (int) in_len);
+
+    dest += out_len;
+    *dest++ = '\n';
+    raw_data += in_len;
+    raw_data_size -= in_len;
+  }
+
+  return 0;
+}
+
+//############################################################################
+// get_block_bytes_size()
+//############################################################################
+int get_block_bytes_size(block_spec_t * blocks, size_t block_count,
+                         char *end_delim, size_t * output_length)
+{
+  if (blocks == NULL || block_count == 0 || end_delim == NULL)
+  {
+    kmyth_log(LOG_ERR, "no blocks to size ... exiting");
+    return 1;
+  }
+
+  size_t total = strlen(end_delim);
+
+  for (size_t i = 0; i < block_count; i++)
+  {
+    if (blocks[i].delim == NULL || blocks[i].data == NULL
+        || blocks[i].data_len == 0)
+    {
+      kmyth_log(LOG_ERR, "cannot write empty sections ... exiting");
+      return 1;
+    }
+
+    size_t block_size = blocks[i].raw ? blocks[i].data_len + 1 :
+      getBase64EncodedSize(blocks[i].data_len);
+    size_t delim_size = strlen(blocks[i].delim);
+
+    if (block_size == 0 || block_size < blocks[i].data_len
+        || SIZE_MAX - total < block_size + delim_size)
+    {
+      kmyth_log(LOG_ERR, "maximum output size exceeded ... exiting");
+      return 1;
+    }
+    total += delim_size + block_size;
+  }
+
+  *output_length = total;
+  return 0;
+}
+
+//############################################################################
+// create_block_bytes()
+//############################################################################
+int create_block_bytes(block_spec_t * blocks, size_t block_count,
+                       char *end_delim, uint8_t ** output,
+                       size_t * output_length)
+{
+  // first pass - compute the exact output size
+  size_t out_length = 0;
+
+  if (get_block_bytes_size(blocks, block_count, end_delim, &out_length))
+  {
+    kmyth_log(LOG_ERR, "unable to compute output size ... exiting");
+    return 1;
+  }
+
+  uint8_t *out = malloc(out_length);
+
+  if (out == NULL)
+  {
+    kmyth_log(LOG_ERR, "malloc error (%lu bytes) ... exiting", out_length);
+    return 1;
+  }
+
+  // second pass - write each block directly into its final position
+  uint8_t *position = out;
+  size_t remaining = out_length;
+
+  for (size_t i = 0; i < block_count; i++)
+  {
+    size_t delim_len = strlen(blocks[i].delim);
+
+    memcpy(position, blocks[i].delim, delim_len);
+    position += delim_len;
+    remaining -= delim_len;
+
+    if (blocks[i].raw)
+    {
+      memcpy(position, blocks[i].data, blocks[i].data_len);
+      position[blocks[i].data_len] = '\n';
+      position += blocks[i].data_len + 1;
+      remaining -= blocks[i].data_len + 1;
+    }
+    else
+    {
+      size_t encoded_size = getBase64EncodedSize(blocks[i].data_len);
+
+      if (encodeBase64DataToBuffer(blocks[i].data, blocks[i].data_len,
+                                   position, remaining))
+      {
+        kmyth_log(LOG_ERR, "error base64 encoding block ... exiting");
+        free(out);
+        return 1;
+      }
+      position += encoded_size;
+      remaining -= encoded_size;
+    }
+  }
+  memcpy(position, end_delim, remaining);
+
+  *output = out;
+  *output_length = out_length;
+  return 0;
+}
+
+//############################################################################
+// write_all_to_fd()
+//############################################################################
+static int write_all_to_fd(int fd, uint8_t * data, size_t data_len)
+{
+  while (data_len > 0)
+  {
+    ssize_t written = write(fd, data, data_len);
+
+    if (written < 0)
+    {
+      if (errno == EINTR)
+      {
+        continue;
+      }
+      kmyth_log(LOG_ERR, "write error (%s) ... exiting", strerror(errno));
+      return 1;
+    }
+    data += written;
+    data_len -= (size_t) written;
+  }
+  return 0;
+}
+
+//############################################################################
+// write_block_bytes_to_fd()
+//############################################################################
+int write_block_bytes_to_fd(int fd, block_spec_t * blocks,
+                            size_t block_count, char *end_delim)
+{
+  size_t out_length = 0;
+
+  if (get_block_bytes_size(blocks, block_count, end_delim, &out_length))
+  {
+    kmyth_log(LOG_ERR, "invalid block list ... exiting");
+    return 1;
+  }
+
+  // encode whole lines, KMYTH_BASE64_FD_CHUNK_LINES at a time
+  size_t raw_chunk_len =
+    (KMYTH_BASE64_LINE_LEN / 4) * 3 * KMYTH_BASE64_FD_CHUNK_LINES;
+  size_t buf_len = getBase64EncodedSize(raw_chunk_len);
+  uint8_t *buf = malloc(buf_len);
+
+  if (buf == NULL)
+  {
+    kmyth_log(LOG_ERR, "malloc error (%lu bytes) ... exiting", buf_len);
+    return 1;
+  }
+
+  for (size_t i = 0; i < block_count; i++)
+  {
+    if (write_all_to_fd(fd, (uint8_t *) blocks[i].delim,
+                        strlen(blocks[i].delim)))
+    {
+      free(buf);
+      return 1;
+    }
+
+    if (blocks[i].raw)
+    {
+      if (write_all_to_fd(fd, blocks[i].data, blocks[i].data_len)
+          || write_all_to_fd(fd, (uint8_t *) "\n", 1))
+      {
+        free(buf);
+        return 1;
+      }
+      continue;
+    }
+
+    uint8_t *data = blocks[i].data;
+    size_t data_len = blocks[i].data_len;
+
+    while (data_len > 0)
+    {
+      size_t in_len = (data_len < raw_chunk_len) ? data_len : raw_chunk_len;
+      size_t encoded_size = getBase64EncodedSize(in_len);
+
+      if (encodeBase64DataToBuffer(data, in_len, buf, buf_len)
+          || write_all_to_fd(fd, buf, encoded_size))
+      {
+        kmyth_log(LOG_ERR, "error writing base64 block ... exiting");
+        free(buf);
+        return 1;
+      }
+      data += in_len;
+      data_len -= in_len;
+    }
+  }
+  free(buf);
+
+  return write_all_to_fd(fd, (uint8_t *) end_delim, strlen(end_delim));
+}
+
 //############################################################################
 // concat()
 //############################################################################
@@ -8,6 +8,18 @@
 #include "memory_util.h"
 
 #include <stdlib.h>
+#include <string.h>
+
+#ifndef KMYTH_SGX
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <unistd.h>
+
+#include <sys/mman.h>
+
+#include "defines.h"
+#endif
 
 //############################################################################
 // kmyth_clear()
@@ -17,10 +29,287 @@ void kmyth_clear(void *v, size_t size)
   if (v == NULL)
     return;
 
-  volatile unsigned char *p = v;
+  // memset() runs at full (vectorized) speed; the empty asm statement that
+  // "uses" the buffer keeps the compiler from eliding it as a dead store
+  // (the explicit_bzero() technique)
+  memset(v, 0, size);
+  __asm__ __volatile__("": :"r"(v):"memory");
+}
+
+#ifdef KMYTH_SGX
+
+// Enclave memory is already kept out of swap (pages leaving the EPC are
+// encrypted) and out of core dumps, so inside an enclave the "secure arena"
+// is simply the enclave heap.
+
+//############################################################################
+// kmyth_secure_alloc()
+//############################################################################
+void *kmyth_secure_alloc(size_t size)
+{
+  return calloc(1, (size > 0) ? size : 1);
+}
+
+//############################################################################
+// kmyth_clear_and_free()
+//############################################################################
+void kmyth_clear_and_free(void *v, size_t size)
+{
+  if (v == NULL)
+    return;
+  kmyth_clear(v, size);
+  free(v);
+}
+
+#else
+
+/// Size of each mapping the small size classes are carved from
+#define SECURE_ARENA_CHUNK_SIZE (256 * 1024)
+
+/// Smallest size class (header included) is 2^5 = 32 bytes
+#define SECURE_ARENA_MIN_CLASS_SHIFT 5
+
+/// Largest size class (header included) is 2^15 = 32 KiB
+#define SECURE_ARENA_MAX_CLASS_SHIFT 15
+
+#define SECURE_ARENA_NUM_CLASSES \
+  (SECURE_ARENA_MAX_CLASS_SHIFT - SECURE_ARENA_MIN_CLASS_SHIFT + 1)
+
+/// Marks the header of a block handed out by the secure arena
+#define SECURE_ARENA_MAGIC 0x4b4d5341u
+
+/// Class index recorded in the header of a dedicated (large) mapping
+#define SECURE_ARENA_LARGE_CLASS UINT32_MAX
+
+/**
+ * @brief Header preceding every block (16 bytes, so blocks stay 16-byte
+ *        aligned). block_len is the full length of the block (header
+ *        included), which is the mapping length for large blocks.
+ */
+typedef struct secure_block_header
+{
+  _Alignas(16) uint32_t magic;
+  uint32_t class_idx;
+  size_t block_len;
+} secure_block_header;
+
+/**
+ * @brief A mapping owned by the arena: a chunk carved into small blocks or
+ *        the dedicated mapping of one large block
+ */
+typedef struct secure_region
+{
+  uint8_t *base;
+  size_t len;
+  struct secure_region *next;
+} secure_region;
+
+/**
+ * @brief A freed small block, linked through its (cleared) user area
+ */
+typedef struct secure_free_block
+{
+  struct secure_free_block *next;
+} secure_free_block;
+
+static struct
+{
+  pthread_mutex_t lock;
+  secure_region *regions;
+  secure_free_block *free_lists[SECURE_ARENA_NUM_CLASSES];
+  uint8_t *cursor;
+  uint8_t *end;
+  bool lock_warned;
+} secure_arena = {.lock = PTHREAD_MUTEX_INITIALIZER };
+
+//############################################################################
+// secure_region_map()
+//############################################################################
+static secure_region *secure_region_map(size_t len)
+{
+  secure_region *region = malloc(sizeof(secure_region));
+
+  if (region == NULL)
+  {
+    return NULL;
+  }
+
+  void *base = mmap(NULL, len, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+  if (base == MAP_FAILED)
+  {
+    kmyth_log(LOG_ERR, "unable to map secure memory");
+    free(region);
+    return NULL;
+  }
+
+  // keeping the secrets out of core dumps is best effort, as is locking
+  madvise(base, len, MADV_DONTDUMP);
+  if (mlock(base, len) && !secure_arena.lock_warned)
+  {
+    kmyth_log(LOG_WARNING,
+              "unable to lock secure memory (check RLIMIT_MEMLOCK), "
+              "secrets may be swapped to disk");
+    secure_arena.lock_warned = true;
+  }
+
+  region->base = base;
+  region->len = len;
+  region->next = secure_arena.regions;
+  secure_arena.regions = region;
+
+  return region;
+}
+
+//############################################################################
+// kmyth_secure_alloc()
+//############################################################################
+void *kmyth_secure_alloc(size_t size)
+{
+  size_t header_len = sizeof(secure_block_header);
+  size_t page_size = (size_t) sysconf(_SC_PAGESIZE);
+
+  if (size > SIZE_MAX - header_len - page_size)
+  {
+    return NULL;
+  }
+
+  size_t needed = size + header_len;
+  uint32_t class_idx = 0;
+
+  while (class_idx < SECURE_ARENA_NUM_CLASSES
+         && ((size_t) 1 << (SECURE_ARENA_MIN_CLASS_SHIFT + class_idx)) <
+         needed)
+  {
+    class_idx++;
+  }
+
+  secure_block_header *header = NULL;
+
+  pthread_mutex_lock(&secure_arena.lock);
+
+  if (class_idx == SECURE_ARENA_NUM_CLASSES)
+  {
+    // too big for the size classes: dedicated mapping (whole pages)
+    size_t block_len = (needed + page_size - 1) / page_size * page_size;
+    secure_region *region = secure_region_map(block_len);
+
+    if (region != NULL)
+    {
+      header = (secure_block_header *) region->base;
+      header->class_idx = SECURE_ARENA_LARGE_CLASS;
+      header->block_len = block_len;
+    }
+  }
+  else
+  {
+    size_t block_len = (size_t) 1 << (SECURE_ARENA_MIN_CLASS_SHIFT
+                                      + class_idx);
+    secure_free_block *block = secure_arena.free_lists[class_idx];
+
+    if (block != NULL)
+    {
+      // freed blocks were cleared, apart from the free list link
+      secure_arena.free_lists[class_idx] = block->next;
+      block->next = NULL;
+      header = (secure_block_header *) block - 1;
+    }
+    else
+    {
+      if (secure_arena.cursor == NULL
+          || (size_t) (secure_arena.end - secure_arena.cursor) < block_len)
+      {
+        secure_region *region = secure_region_map(SECURE_ARENA_CHUNK_SIZE);
 
-  while (size--)
-    *p++ = '\0';
+        if (region != NULL)
+        {
+          secure_arena.cursor = region->base;
+          secure_arena.end = region->base + region->len;
+        }
+      }
+      if (secure_arena.cursor != NULL
+          && (size_t) (secure_arena.end - secure_arena.cursor) >= block_len)
+      {
+        header = (secure_block_header *) secure_arena.cursor;
+        secure_arena.cursor += block_len;
+        header->class_idx = class_idx;
+        header->block_len = block_len;
+      }
+    }
+  }
+
+  if (header != NULL)
+  {
+    header->magic = SECURE_ARENA_MAGIC;
+  }
+
+  pthread_mutex_unlock(&secure_arena.lock);
+
+  return (header == NULL) ? NULL : (void *) (header + 1);
+}
+
+//############################################################################
+// secure_arena_release()
+//############################################################################
+static bool secure_arena_release(void *v)
+{
+  uint8_t *p = v;
+  secure_region **link = NULL;
+  bool found = false;
+
+  pthread_mutex_lock(&secure_arena.lock);
+
+  for (link = &secure_arena.regions; *link != NULL; link = &(*link)->next)
+  {
+    if (p >= (*link)->base && p < (*link)->base + (*link)->len)
+    {
+      found = true;
+      break;
+    }
+  }
+
+  if (!found)
+  {
+    pthread_mutex_unlock(&secure_arena.lock);
+    return false;
+  }
+
+  secure_block_header *header = (secure_block_header *) v - 1;
+
+  if (p < (*link)->base + sizeof(secure_block_header)
+      || header->magic != SECURE_ARENA_MAGIC)
+  {
+    // not the start of a block: leave it alone rather than corrupt the arena
+    pthread_mutex_unlock(&secure_arena.lock);
+    kmyth_log(LOG_ERR, "invalid pointer into secure memory not released");
+    return true;
+  }
+
+  kmyth_clear(v, header->block_len - sizeof(secure_block_header));
+
+  if (header->class_idx == SECURE_ARENA_LARGE_CLASS)
+  {
+    secure_region *region = *link;
+
+    *link = region->next;
+    munlock(region->base, region->len);
+    munmap(region->base, region->len);
+    free(region);
+  }
+  else
+  {
+    secure_free_block *block = v;
+
+    // (a second release of the block is then caught by the magic check)
+    header->magic = 0;
+    block->next = secure_arena.free_lists[header->class_idx];
+    secure_arena.free_lists[header->class_idx] = block;
+  }
+
+  pthread_mutex_unlock(&secure_arena.lock);
+
+  return true;
 }
 
 //############################################################################
@@ -30,19 +319,21 @@ void kmyth_clear_and_free(void *v, size_t size)
 {
   if (v == NULL)
     return;
+  if (secure_arena_release(v))
+    return;
   kmyth_clear(v, size);
   free(v);
 }
 
+#endif
+
 //############################################################################
 // secure_memset()
 //############################################################################
 void *secure_memset(void *v, int c, size_t n)
 {
-  volatile unsigned char *p = v;
-
-  while (n--)
-    *p++ = c;
+  memset(v, c, n);
+  __asm__ __volatile__("": :"r"(v):"memory");
 
   return v;
 }